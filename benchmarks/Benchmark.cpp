@@ -0,0 +1,136 @@
+////////////////////////////////////////////////////////////////////////////////////////////////////
+//                                                                                                //
+//    _)  |  |            _)                This code may be used and modified under the terms    //
+//     |  |  |  |  | (_-<  |   _ \    \     of the MIT license. See the LICENSE file for details. //
+//    _| _| _| \_,_| ___/ _| \___/ _| _|    Copyright (c) 2018-2019 Simon Schneegans              //
+//                                                                                                //
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include "Benchmark.hpp"
+
+#include <Illusion/Graphics/Device.hpp>
+#include <Illusion/Graphics/Instance.hpp>
+
+#include <algorithm>
+
+namespace Illusion::Benchmarks {
+
+namespace {
+
+std::vector<BenchmarkInfo>& getRegistry() {
+  static std::vector<BenchmarkInfo> registry;
+  return registry;
+}
+
+} // namespace
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+State::State(uint64_t maxIterations)
+    : mMaxIterations(maxIterations) {
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+bool State::keepRunning() {
+  if (mIterations == 0 && !mRunning) {
+    resumeTiming();
+  }
+
+  if (mIterations < mMaxIterations) {
+    ++mIterations;
+    return true;
+  }
+
+  pauseTiming();
+  return false;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void State::pauseTiming() {
+  if (mRunning) {
+    mElapsed += Clock::now() - mStart;
+    mCpuElapsed += std::clock() - mCpuStart;
+    mRunning = false;
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void State::resumeTiming() {
+  if (!mRunning) {
+    mStart    = Clock::now();
+    mCpuStart = std::clock();
+    mRunning  = true;
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void State::setItemsProcessed(uint64_t items) {
+  mItemsProcessed = items;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+uint64_t State::getMaxIterations() const {
+  return mMaxIterations;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+uint64_t State::getItemsProcessed() const {
+  return mItemsProcessed;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+double State::getElapsedSeconds() const {
+  return std::chrono::duration<double>(mElapsed).count();
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+double State::getCpuSeconds() const {
+  return static_cast<double>(mCpuElapsed) / CLOCKS_PER_SEC;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+bool registerBenchmark(std::string const& name, std::function<void(State&)> const& function) {
+  getRegistry().push_back({name, function});
+  return true;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+std::vector<BenchmarkInfo> getBenchmarks() {
+  auto benchmarks = getRegistry();
+  std::sort(benchmarks.begin(), benchmarks.end(),
+      [](BenchmarkInfo const& a, BenchmarkInfo const& b) { return a.mName < b.mName; });
+  return benchmarks;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+Context const& getContext() {
+  static Context context = []() {
+    Context result;
+    result.mInstance = Graphics::Instance::create("Illusion Benchmarks", false, true);
+    result.mDevice   = Graphics::Device::create(result.mInstance->getPhysicalDevice({}));
+    return result;
+  }();
+
+  return context;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+std::string getDataDirectory() {
+  return ILLUSION_BENCHMARK_DATA_DIRECTORY;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+} // namespace Illusion::Benchmarks
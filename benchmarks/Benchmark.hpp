@@ -0,0 +1,101 @@
+////////////////////////////////////////////////////////////////////////////////////////////////////
+//                                                                                                //
+//    _)  |  |            _)                This code may be used and modified under the terms    //
+//     |  |  |  |  | (_-<  |   _ \    \     of the MIT license. See the LICENSE file for details. //
+//    _| _| _| \_,_| ___/ _| \___/ _| _|    Copyright (c) 2018-2019 Simon Schneegans              //
+//                                                                                                //
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#ifndef ILLUSION_BENCHMARKS_BENCHMARK_HPP
+#define ILLUSION_BENCHMARKS_BENCHMARK_HPP
+
+#include <Illusion/Graphics/fwd.hpp>
+
+#include <chrono>
+#include <cstdint>
+#include <ctime>
+#include <functional>
+#include <string>
+#include <vector>
+
+namespace Illusion::Benchmarks {
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// A minimal benchmark harness in the style of Google Benchmark. A benchmark is a function which  //
+// runs its measured code in a loop like this:                                                    //
+// void BM_Something(State& state) {                                                              //
+//   // setup                                                                                     //
+//   while (state.keepRunning()) {                                                                //
+//     // measured code                                                                           //
+//   }                                                                                            //
+// }                                                                                              //
+// ILLUSION_BENCHMARK(BM_Something);                                                              //
+// The runner calls each benchmark with a growing number of iterations until the measured time    //
+// exceeds the minimum time and reports the time per iteration. With --format=json, the results   //
+// are written in the JSON format of Google Benchmark, so that existing tools can compare runs.   //
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+class State {
+
+ public:
+  explicit State(uint64_t maxIterations);
+
+  // The timer is started by the first call; returns false once the iterations are done.
+  bool keepRunning();
+
+  // Code between these calls is not measured, for example a per-iteration reset.
+  void pauseTiming();
+  void resumeTiming();
+
+  // If set, the number of items per second is reported as well.
+  void setItemsProcessed(uint64_t items);
+
+  uint64_t getMaxIterations() const;
+  uint64_t getItemsProcessed() const;
+  double   getElapsedSeconds() const;
+
+  // The processor time of the whole process, including other threads.
+  double getCpuSeconds() const;
+
+ private:
+  typedef std::chrono::steady_clock Clock;
+
+  uint64_t          mMaxIterations;
+  uint64_t          mIterations     = 0;
+  uint64_t          mItemsProcessed = 0;
+  bool              mRunning        = false;
+  Clock::time_point mStart;
+  Clock::duration   mElapsed{0};
+  std::clock_t      mCpuStart   = 0;
+  std::clock_t      mCpuElapsed = 0;
+};
+
+struct BenchmarkInfo {
+  std::string                 mName;
+  std::function<void(State&)> mFunction;
+};
+
+// Adds a benchmark to the global list; use ILLUSION_BENCHMARK instead.
+bool registerBenchmark(std::string const& name, std::function<void(State&)> const& function);
+
+// Returns all registered benchmarks, sorted by name.
+std::vector<BenchmarkInfo> getBenchmarks();
+
+// The Vulkan objects which are shared by all benchmarks. They are created on first use, headless
+// and with the validation layers disabled.
+struct Context {
+  Graphics::InstancePtr mInstance;
+  Graphics::DevicePtr   mDevice;
+};
+
+Context const& getContext();
+
+// The directory of the example data, which is used for the model loading benchmarks.
+std::string getDataDirectory();
+
+} // namespace Illusion::Benchmarks
+
+#define ILLUSION_BENCHMARK(function)                                                               \
+  static bool function##Registered = Illusion::Benchmarks::registerBenchmark(#function, function)
+
+#endif // ILLUSION_BENCHMARKS_BENCHMARK_HPP
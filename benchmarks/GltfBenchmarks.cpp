@@ -0,0 +1,184 @@
+////////////////////////////////////////////////////////////////////////////////////////////////////
+//                                                                                                //
+//    _)  |  |            _)                This code may be used and modified under the terms    //
+//     |  |  |  |  | (_-<  |   _ \    \     of the MIT license. See the LICENSE file for details. //
+//    _| _| _| \_,_| ___/ _| \___/ _| _|    Copyright (c) 2018-2019 Simon Schneegans              //
+//                                                                                                //
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include "Benchmark.hpp"
+
+#include <Illusion/Graphics/GltfModel.hpp>
+
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <vector>
+
+namespace {
+
+using namespace Illusion;
+
+void loadModel(Benchmarks::State& state, Graphics::Gltf::LoadOptions options) {
+  auto const& device   = Benchmarks::getContext().mDevice;
+  auto        fileName = Benchmarks::getDataDirectory() + "/models/DamagedHelmet.glb";
+
+  while (state.keepRunning()) {
+    auto model = Graphics::Gltf::Model::create(device, fileName, options);
+
+    // the destruction of the Model and its buffers is not part of the measurement
+    state.pauseTiming();
+    model.reset();
+    state.resumeTiming();
+  }
+}
+
+std::string encodeBase64(std::vector<uint8_t> const& data) {
+  static const char* chars = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+  std::string result;
+
+  for (size_t i(0); i < data.size(); i += 3) {
+    uint32_t bytes = uint32_t(data[i]) << 16;
+    if (i + 1 < data.size()) {
+      bytes |= uint32_t(data[i + 1]) << 8;
+    }
+    if (i + 2 < data.size()) {
+      bytes |= uint32_t(data[i + 2]);
+    }
+
+    result += chars[(bytes >> 18) & 63];
+    result += chars[(bytes >> 12) & 63];
+    result += i + 1 < data.size() ? chars[(bytes >> 6) & 63] : '=';
+    result += i + 2 < data.size() ? chars[bytes & 63] : '=';
+  }
+
+  return result;
+}
+
+// The example data contains no animated model, hence a chain of nodes is generated instead. Each
+// node has a linearly interpolated translation, rotation and scale channel; the channels of all
+// nodes share the same three samplers with the given number of key frames. The file is written to
+// the working directory, loaded and removed again.
+Graphics::Gltf::ModelPtr createAnimatedChain(uint32_t nodeCount, uint32_t keyFrameCount) {
+  std::vector<float> times, translations, rotations, scales;
+
+  for (uint32_t k(0); k < keyFrameCount; ++k) {
+    float t     = static_cast<float>(k) / static_cast<float>(keyFrameCount - 1);
+    float angle = t * 3.14159265f;
+
+    times.push_back(t);
+    translations.insert(translations.end(), {0.f, 1.f + t, 0.f});
+    rotations.insert(rotations.end(), {0.f, 0.f, std::sin(angle * 0.5f), std::cos(angle * 0.5f)});
+    scales.insert(scales.end(), {1.f, 1.f - 0.5f * t, 1.f});
+  }
+
+  std::vector<uint8_t> buffer;
+  std::vector<size_t>  offsets;
+
+  for (auto const* values : {&times, &translations, &rotations, &scales}) {
+    offsets.push_back(buffer.size());
+    buffer.resize(buffer.size() + values->size() * sizeof(float));
+    std::memcpy(buffer.data() + offsets.back(), values->data(), values->size() * sizeof(float));
+  }
+
+  std::stringstream json;
+  json << R"({"asset": {"version": "2.0"}, "scene": 0, "scenes": [{"nodes": [0]}], "nodes": [)";
+
+  for (uint32_t i(0); i < nodeCount; ++i) {
+    json << (i > 0 ? "," : "") << "{";
+    if (i + 1 < nodeCount) {
+      json << R"("children": [)" << i + 1 << "]";
+    }
+    json << "}";
+  }
+
+  json << R"(], "buffers": [{"byteLength": )" << buffer.size()
+       << R"(, "uri": "data:application/octet-stream;base64,)" << encodeBase64(buffer)
+       << R"("}], "bufferViews": [)";
+
+  char const* types[]      = {"SCALAR", "VEC3", "VEC4", "VEC3"};
+  size_t      components[] = {1, 3, 4, 3};
+
+  for (size_t i(0); i < 4; ++i) {
+    json << (i > 0 ? "," : "") << R"({"buffer": 0, "byteOffset": )" << offsets[i]
+         << R"(, "byteLength": )" << keyFrameCount * components[i] * sizeof(float) << "}";
+  }
+
+  json << R"(], "accessors": [)";
+
+  for (size_t i(0); i < 4; ++i) {
+    json << (i > 0 ? "," : "") << R"({"bufferView": )" << i
+         << R"(, "componentType": 5126, "count": )" << keyFrameCount << R"(, "type": ")"
+         << types[i] << """ << (i == 0 ? R"(, "min": [0], "max": [1])" : "") << "}";
+  }
+
+  json << R"(], "animations": [{"samplers": [)";
+
+  for (size_t i(1); i < 4; ++i) {
+    json << (i > 1 ? "," : "") << R"({"input": 0, "output": )" << i << "}";
+  }
+
+  json << R"(], "channels": [)";
+
+  char const* paths[] = {"translation", "rotation", "scale"};
+
+  for (uint32_t n(0); n < nodeCount; ++n) {
+    for (uint32_t c(0); c < 3; ++c) {
+      json << (n > 0 || c > 0 ? "," : "") << R"({"sampler": )" << c
+           << R"(, "target": {"node": )" << n << R"(, "path": ")" << paths[c] << R"("}})";
+    }
+  }
+
+  json << "]}]}";
+
+  std::string fileName = "illusion-benchmark-animation.gltf";
+  std::ofstream(fileName) << json.str();
+
+  auto model = Graphics::Gltf::Model::create(
+      Benchmarks::getContext().mDevice, fileName, Graphics::Gltf::LoadOptionBits::eAnimations);
+
+  std::remove(fileName.c_str());
+
+  return model;
+}
+
+} // namespace
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void Gltf_loadModel(Benchmarks::State& state) {
+  loadModel(state, Graphics::Gltf::LoadOptionBits::eAll);
+}
+
+ILLUSION_BENCHMARK(Gltf_loadModel);
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+// Only the meshes and materials, without decoding and uploading any texture.
+void Gltf_loadGeometry(Benchmarks::State& state) {
+  loadModel(state, Graphics::Gltf::LoadOptionBits::eNone);
+}
+
+ILLUSION_BENCHMARK(Gltf_loadGeometry);
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+// Samples all channels of a chain of 64 Nodes and updates their transformations. The time advances
+// by a non-integral number of key frames per iteration, so that the key frame search and the
+// interpolation are exercised.
+void Gltf_setAnimationTime(Benchmarks::State& state) {
+  auto  model = createAnimatedChain(64, 100);
+  float time  = 0.f;
+
+  while (state.keepRunning()) {
+    model->setAnimationTime(0, time);
+    time = std::fmod(time + 0.0137f, 1.f);
+  }
+
+  state.setItemsProcessed(state.getMaxIterations() * 64 * 3);
+}
+
+ILLUSION_BENCHMARK(Gltf_setAnimationTime);
@@ -0,0 +1,164 @@
+////////////////////////////////////////////////////////////////////////////////////////////////////
+//                                                                                                //
+//    _)  |  |            _)                This code may be used and modified under the terms    //
+//     |  |  |  |  | (_-<  |   _ \    \     of the MIT license. See the LICENSE file for details. //
+//    _| _| _| \_,_| ___/ _| \___/ _| _|    Copyright (c) 2018-2019 Simon Schneegans              //
+//                                                                                                //
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include "Benchmark.hpp"
+
+#include <Illusion/Graphics/CoherentUniformBuffer.hpp>
+#include <Illusion/Graphics/CommandBuffer.hpp>
+#include <Illusion/Graphics/DescriptorSetCache.hpp>
+#include <Illusion/Graphics/Device.hpp>
+#include <Illusion/Graphics/GraphicsState.hpp>
+#include <Illusion/Graphics/PipelineCache.hpp>
+#include <Illusion/Graphics/Shader.hpp>
+#include <Illusion/Graphics/ShaderSource.hpp>
+
+#include <glm/glm.hpp>
+
+namespace {
+
+using namespace Illusion;
+
+// A compute shader with one uniform buffer and one storage buffer. It is used by all benchmarks
+// which need a pipeline or descriptor sets.
+Graphics::ShaderPtr createComputeShader() {
+  static Graphics::ShaderPtr shader;
+
+  if (!shader) {
+    shader = Graphics::Shader::create(Benchmarks::getContext().mDevice);
+    shader->addModule(vk::ShaderStageFlagBits::eCompute, Graphics::GlslCode::create(R"(
+      #version 450
+      layout(local_size_x = 64) in;
+      layout(set = 0, binding = 0) uniform Parameters { float mFactor; } parameters;
+      layout(set = 0, binding = 1) buffer Data { float mValues[]; } data;
+      void main() {
+        data.mValues[gl_GlobalInvocationID.x] *= parameters.mFactor;
+      }
+    )", "BenchmarkCompute"));
+  }
+
+  return shader;
+}
+
+} // namespace
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void GraphicsState_getHash(Benchmarks::State& state) {
+  Graphics::GraphicsState graphicsState(Benchmarks::getContext().mDevice);
+  graphicsState.addBlendAttachment({});
+  graphicsState.addViewport({glm::vec2(1920, 1080)});
+  graphicsState.addScissor({glm::uvec2(1920, 1080)});
+  graphicsState.setDepthTestEnable(true);
+
+  float depth = 0.f;
+
+  while (state.keepRunning()) {
+    // modify the state, else only the cached hash would be returned
+    graphicsState.setMinDepthBounds(depth += 0.001f);
+    auto hash = graphicsState.getHash();
+    (void)hash;
+  }
+}
+
+ILLUSION_BENCHMARK(GraphicsState_getHash);
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void PipelineCache_getComputePipeline(Benchmarks::State& state) {
+  auto const& cache  = Benchmarks::getContext().mDevice->getPipelineCache();
+  auto        shader = createComputeShader();
+
+  // the first call creates the pipeline, all following calls are cache hits
+  cache->getComputePipeline(shader);
+
+  while (state.keepRunning()) {
+    auto pipeline = cache->getComputePipeline(shader);
+    (void)pipeline;
+  }
+}
+
+ILLUSION_BENCHMARK(PipelineCache_getComputePipeline);
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void DescriptorSetCache_acquireHandle(Benchmarks::State& state) {
+  Graphics::DescriptorSetCache cache(Benchmarks::getContext().mDevice);
+  auto const& reflection = createComputeShader()->getDescriptorSetReflections()[0];
+
+  const uint64_t setsPerIteration = 64;
+
+  while (state.keepRunning()) {
+    for (uint64_t i = 0; i < setsPerIteration; ++i) {
+      auto set = cache.acquireHandle(reflection);
+      (void)set;
+    }
+    cache.releaseAll();
+  }
+
+  state.setItemsProcessed(state.getMaxIterations() * setsPerIteration);
+}
+
+ILLUSION_BENCHMARK(DescriptorSetCache_acquireHandle);
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void CommandBuffer_dispatch(Benchmarks::State& state) {
+  auto const& device   = Benchmarks::getContext().mDevice;
+  auto        cmd      = Graphics::CommandBuffer::create(device);
+  auto        uniforms = device->createUniformBuffer(sizeof(float));
+  auto        data     = device->createBackedBuffer(vk::BufferUsageFlagBits::eStorageBuffer,
+      vk::MemoryPropertyFlagBits::eDeviceLocal, 64 * sizeof(float));
+
+  cmd->setShader(createComputeShader());
+
+  const uint64_t dispatchesPerIteration = 256;
+
+  while (state.keepRunning()) {
+    state.pauseTiming();
+    cmd->reset();
+    cmd->begin();
+    state.resumeTiming();
+
+    // the bindings change each time, so that each dispatch writes and binds a descriptor set
+    for (uint64_t i = 0; i < dispatchesPerIteration; ++i) {
+      cmd->bindingState().setUniformBuffer(uniforms, sizeof(float), 0, 0, 0);
+      cmd->bindingState().setStorageBuffer(data, 64 * sizeof(float), 0, 0, 1);
+      cmd->dispatch(1);
+      cmd->bindingState().reset(0);
+    }
+
+    state.pauseTiming();
+    cmd->end();
+    state.resumeTiming();
+  }
+
+  state.setItemsProcessed(state.getMaxIterations() * dispatchesPerIteration);
+}
+
+ILLUSION_BENCHMARK(CommandBuffer_dispatch);
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void CoherentUniformBuffer_addData(Benchmarks::State& state) {
+  auto const& device = Benchmarks::getContext().mDevice;
+  auto        buffer = Graphics::CoherentUniformBuffer::create(device, 1024 * 1024, 256);
+
+  const uint64_t blocksPerIteration = 1024;
+  glm::mat4      block(1.f);
+
+  while (state.keepRunning()) {
+    for (uint64_t i = 0; i < blocksPerIteration; ++i) {
+      buffer->addData(block);
+    }
+    buffer->reset();
+  }
+
+  state.setItemsProcessed(state.getMaxIterations() * blocksPerIteration);
+}
+
+ILLUSION_BENCHMARK(CoherentUniformBuffer_addData);
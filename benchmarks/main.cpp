@@ -0,0 +1,197 @@
+////////////////////////////////////////////////////////////////////////////////////////////////////
+//                                                                                                //
+//    _)  |  |            _)                This code may be used and modified under the terms    //
+//     |  |  |  |  | (_-<  |   _ \    \     of the MIT license. See the LICENSE file for details. //
+//    _| _| _| \_,_| ___/ _| \___/ _| _|    Copyright (c) 2018-2019 Simon Schneegans              //
+//                                                                                                //
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include "Benchmark.hpp"
+
+#include <Illusion/Core/CommandLineOptions.hpp>
+#include <Illusion/Core/Logger.hpp>
+
+#include <algorithm>
+#include <ctime>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <regex>
+#include <thread>
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// Runs all registered benchmarks whose name matches the filter. Each benchmark is repeated with  //
+// a growing number of iterations until it ran for at least the minimum time. The results are     //
+// printed as a table or, with --format=json, in the JSON format of Google Benchmark, so that     //
+// tools like Google Benchmark's compare.py can be used to track regressions between releases.    //
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+namespace {
+
+struct Result {
+  std::string mName;
+  uint64_t    mIterations;
+  double      mRealTime; // nanoseconds per iteration
+  double      mCpuTime;  // nanoseconds per iteration
+  double      mItemsPerSecond;
+};
+
+Result run(Illusion::Benchmarks::BenchmarkInfo const& benchmark, double minTime) {
+  uint64_t iterations = 1;
+
+  while (true) {
+    Illusion::Benchmarks::State state(iterations);
+    benchmark.mFunction(state);
+
+    double seconds = state.getElapsedSeconds();
+
+    if (seconds >= minTime || iterations >= 1000000000) {
+      Result result;
+      result.mName           = benchmark.mName;
+      result.mIterations     = iterations;
+      result.mRealTime       = seconds * 1e9 / iterations;
+      result.mCpuTime        = state.getCpuSeconds() * 1e9 / iterations;
+      result.mItemsPerSecond = seconds > 0 ? state.getItemsProcessed() / seconds : 0.0;
+      return result;
+    }
+
+    // aim a bit above the minimum time, but grow by at most one order of magnitude per run
+    double factor = seconds > 0.0 ? minTime * 1.4 / seconds : 10.0;
+    iterations    = static_cast<uint64_t>(iterations * std::clamp(factor, 2.0, 10.0));
+  }
+}
+
+void writeJson(
+    std::ostream& os, std::vector<Result> const& results, std::string const& executable) {
+  std::time_t now = std::time(nullptr);
+
+  os << "{" << std::endl;
+  os << "  \"context\": {" << std::endl;
+  os << "    \"date\": \"" << std::put_time(std::localtime(&now), "%F %T") << "\"," << std::endl;
+  os << "    \"executable\": \"" << executable << "\"," << std::endl;
+  os << "    \"num_cpus\": " << std::thread::hardware_concurrency() << std::endl;
+  os << "  }," << std::endl;
+  os << "  \"benchmarks\": [" << std::endl;
+
+  for (size_t i = 0; i < results.size(); ++i) {
+    auto const& result = results[i];
+    os << "    {" << std::endl;
+    os << "      \"name\": \"" << result.mName << "\"," << std::endl;
+    os << "      \"run_name\": \"" << result.mName << "\"," << std::endl;
+    os << "      \"run_type\": \"iteration\"," << std::endl;
+    os << "      \"iterations\": " << result.mIterations << "," << std::endl;
+    os << "      \"real_time\": " << result.mRealTime << "," << std::endl;
+    os << "      \"cpu_time\": " << result.mCpuTime << "," << std::endl;
+
+    if (result.mItemsPerSecond > 0.0) {
+      os << "      \"items_per_second\": " << result.mItemsPerSecond << "," << std::endl;
+    }
+
+    os << "      \"time_unit\": \"ns\"" << std::endl;
+    os << "    }" << (i + 1 < results.size() ? "," : "") << std::endl;
+  }
+
+  os << "  ]" << std::endl;
+  os << "}" << std::endl;
+}
+
+void writeTable(std::ostream& os, std::vector<Result> const& results) {
+  os << std::left << std::setw(50) << "Benchmark" << std::right << std::setw(15) << "Time"
+     << std::setw(15) << "CPU" << std::setw(15) << "Iterations" << std::endl;
+  os << std::string(95, '-') << std::endl;
+
+  for (auto const& result : results) {
+    os << std::left << std::setw(50) << result.mName << std::right << std::fixed
+       << std::setprecision(0) << std::setw(12) << result.mRealTime << " ns" << std::setw(12)
+       << result.mCpuTime << " ns" << std::setw(15) << result.mIterations;
+
+    if (result.mItemsPerSecond > 0.0) {
+      os << "   " << std::setprecision(2) << result.mItemsPerSecond * 1e-6 << "M items/s";
+    }
+
+    os << std::endl;
+  }
+}
+
+} // namespace
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+int main(int argc, char* argv[]) {
+
+  std::string filter    = ".*";
+  std::string format    = "console";
+  std::string out       = "";
+  double      minTime   = 0.5;
+  bool        list      = false;
+  bool        printHelp = false;
+
+  // clang-format off
+  Illusion::Core::CommandLineOptions args("Benchmarks for the hot paths of Illusion::Graphics.");
+  args.addOption({"-h", "--help"},     &printHelp, "Print this help");
+  args.addOption({"-l", "--list"},     &list,      "Print the names of all benchmarks");
+  args.addOption({"-f", "--filter"},   &filter,    "Only run benchmarks whose name matches this regular expression");
+  args.addOption({"-t", "--min-time"}, &minTime,   "Minimum time in seconds each benchmark is run. Default: 0.5");
+  args.addOption({"--format"},         &format,    "Output format: console or json. Default: console");
+  args.addOption({"-o", "--out"},      &out,       "Write the results to this file instead of the console");
+  // clang-format on
+
+  args.parse(argc, argv);
+
+  if (printHelp) {
+    args.printHelp();
+    return 0;
+  }
+
+  if (format != "console" && format != "json") {
+    ILLUSION_ERROR << "Unknown output format " << format << "!" << std::endl;
+    return 1;
+  }
+
+  std::regex          regex(filter);
+  std::vector<Result> results;
+
+  for (auto const& benchmark : Illusion::Benchmarks::getBenchmarks()) {
+    if (!std::regex_search(benchmark.mName, regex)) {
+      continue;
+    }
+
+    if (list) {
+      std::cout << benchmark.mName << std::endl;
+      continue;
+    }
+
+    ILLUSION_MESSAGE << "Running " << benchmark.mName << "..." << std::endl;
+
+    try {
+      results.push_back(run(benchmark, minTime));
+    } catch (std::exception const& e) {
+      ILLUSION_ERROR << "Benchmark " << benchmark.mName << " failed: " << e.what() << std::endl;
+    }
+  }
+
+  if (list) {
+    return 0;
+  }
+
+  std::ofstream file;
+
+  if (!out.empty()) {
+    file.open(out);
+
+    if (!file) {
+      ILLUSION_ERROR << "Failed to open " << out << " for writing!" << std::endl;
+      return 1;
+    }
+  }
+
+  std::ostream& os = out.empty() ? std::cout : file;
+
+  if (format == "json") {
+    writeJson(os, results, argv[0]);
+  } else {
+    writeTable(os, results);
+  }
+
+  return 0;
+}
@@ -10,38 +10,42 @@
 #define GLM_ENABLE_EXPERIMENTAL
 
 #include <Illusion/Core/CommandLineOptions.hpp>
+#include <Illusion/Core/FPSCounter.hpp>
 #include <Illusion/Core/Logger.hpp>
 #include <Illusion/Core/RingBuffer.hpp>
 #include <Illusion/Core/Timer.hpp>
-#include <Illusion/Graphics/CoherentUniformBuffer.hpp>
 #include <Illusion/Graphics/CommandBuffer.hpp>
+#include <Illusion/Graphics/GltfCuller.hpp>
 #include <Illusion/Graphics/GltfModel.hpp>
+#include <Illusion/Graphics/GltfMorpher.hpp>
+#include <Illusion/Graphics/GltfShadowMap.hpp>
+#include <Illusion/Graphics/IblBaker.hpp>
 #include <Illusion/Graphics/Instance.hpp>
+#include <Illusion/Graphics/LightClusterer.hpp>
 #include <Illusion/Graphics/PhysicalDevice.hpp>
+#include <Illusion/Graphics/PipelineCache.hpp>
+#include <Illusion/Graphics/PostProcessor.hpp>
 #include <Illusion/Graphics/RenderPass.hpp>
+#include <Illusion/Graphics/RenderQueue.hpp>
+#include <Illusion/Graphics/ResolutionScaler.hpp>
 #include <Illusion/Graphics/Shader.hpp>
+#include <Illusion/Graphics/ShaderSource.hpp>
+#include <Illusion/Graphics/ShaderVariants.hpp>
 #include <Illusion/Graphics/Texture.hpp>
+#include <Illusion/Graphics/TextureStreamer.hpp>
+#include <Illusion/Graphics/TransientAllocator.hpp>
 #include <Illusion/Graphics/Window.hpp>
 
+#include <algorithm>
+#include <array>
 #include <glm/gtx/io.hpp>
 #include <glm/gtx/transform.hpp>
+#include <iomanip>
+#include <random>
+#include <set>
+#include <sstream>
 #include <thread>
-
-struct PushConstants {
-  glm::mat4 mModelMatrix;
-  glm::vec4 mAlbedoFactor;
-  glm::vec3 mEmissiveFactor;
-  bool      mSpecularGlossinessWorkflow;
-  glm::vec3 mMetallicRoughnessFactor;
-  float     mNormalScale;
-  float     mOcclusionStrength;
-  float     mAlphaCutoff;
-  int       mVertexAttributes;
-};
-
-struct SkinUniforms {
-  glm::mat4 mJointMatrices[256];
-};
+#include <unordered_map>
 
 struct CameraUniforms {
   glm::vec4 mPosition;
@@ -50,97 +54,238 @@ struct CameraUniforms {
 };
 
 struct FrameResources {
-  FrameResources(Illusion::Graphics::DevicePtr const& device, vk::DeviceSize uboAlignment)
+  // The depth attachment is only needed after the RenderPass if the Culler samples it. With more
+  // than one sample, the model is drawn to a transient multisampled color attachment which is
+  // resolved into the first attachment at the end of the RenderPass. With a view mask, all
+  // attachments have one layer per eye. With post-processing, the color attachment stores HDR
+  // colors which are tone mapped by a PostProcessor.
+  FrameResources(Illusion::Graphics::DevicePtr const& device, bool transientDepth,
+      vk::SampleCountFlagBits samples, bool dynamicRendering, uint32_t viewMask,
+      bool postProcessing)
       : mCmd(Illusion::Graphics::CommandBuffer::create(device))
       , mRenderPass(Illusion::Graphics::RenderPass::create(device))
-      , mUniformBuffer(Illusion::Graphics::CoherentUniformBuffer::create(
-            device, std::pow(2, 20), uboAlignment))
+      , mUniformData(Illusion::Graphics::TransientAllocator::create(device, std::pow(2, 20)))
       , mRenderFinishedFence(device->createFence())
-      , mRenderFinishedSemaphore(device->createSemaphore()) {
+      , mRenderFinishedSemaphore(device->createSemaphore())
+      , mTimestamps(device->createQueryPool({{}, vk::QueryType::eTimestamp, 2}))
+      , mLightClusterer(Illusion::Graphics::LightClusterer::create(device)) {
+
+    // The skybox covers the entire color attachment, so its old content is never needed.
+    Illusion::Graphics::RenderPass::Attachment color;
+    color.mFormat = postProcessing ? vk::Format::eR16G16B16A16Sfloat : vk::Format::eR8G8B8A8Unorm;
+    color.mLoadOp = vk::AttachmentLoadOp::eDontCare;
+
+    mRenderPass->addAttachment(color);
+
+    Illusion::Graphics::RenderPass::Attachment depth;
+    depth.mFormat    = vk::Format::eD32Sfloat;
+    depth.mTransient = transientDepth;
+    depth.mSamples   = samples;
+    mRenderPass->addAttachment(depth);
+
+    if (samples != vk::SampleCountFlagBits::e1) {
+      Illusion::Graphics::RenderPass::Attachment msaaColor = color;
+      msaaColor.mTransient                                 = true;
+      msaaColor.mSamples                                   = samples;
+      msaaColor.mResolveAttachment                         = 0;
+      mRenderPass->addAttachment(msaaColor);
+    }
+
+    mRenderPass->setDynamicRendering(dynamicRendering);
+    mRenderPass->setViewMask(viewMask);
 
-    mRenderPass->addAttachment(vk::Format::eR8G8B8A8Unorm);
-    mRenderPass->addAttachment(vk::Format::eD32Sfloat);
+    // this matches the exposure of the tone mapping in the shaders
+    if (postProcessing) {
+      mPostProcessor = Illusion::Graphics::PostProcessor::create(device);
+      mPostProcessor->setExposure(2.f);
+    }
   }
 
-  Illusion::Graphics::CommandBufferPtr         mCmd;
-  Illusion::Graphics::RenderPassPtr            mRenderPass;
-  Illusion::Graphics::CoherentUniformBufferPtr mUniformBuffer;
-  vk::FencePtr                                 mRenderFinishedFence;
-  vk::SemaphorePtr                             mRenderFinishedSemaphore;
+  Illusion::Graphics::CommandBufferPtr      mCmd;
+  Illusion::Graphics::RenderPassPtr         mRenderPass;
+  Illusion::Graphics::TransientAllocatorPtr mUniformData;
+  vk::FencePtr                              mRenderFinishedFence;
+  vk::SemaphorePtr                          mRenderFinishedSemaphore;
+
+  // The GPU time of the model is measured with these if --gpu-timing is given.
+  vk::QueryPoolPtr mTimestamps;
+  bool             mTimestampsWritten = false;
+
+  // The clusters of the --point-lights are stored per frame, as they are written each frame.
+  Illusion::Graphics::LightClustererPtr mLightClusterer;
+
+  // The cascades of the --shadows are rendered each frame as well. Without it, this is nullptr.
+  Illusion::Graphics::Gltf::ShadowMapPtr mShadowMap;
+
+  // The intermediate images of the --post-processing are written each frame, too.
+  Illusion::Graphics::PostProcessorPtr mPostProcessor;
 };
 
-void drawNodes(std::vector<std::shared_ptr<Illusion::Graphics::Gltf::Node>> const& nodes,
-    glm::mat4 const& viewMatrix, glm::mat4 const& modelMatrix, bool doAlphaBlending,
-    vk::DeviceSize emptySkinDynamicOffset, FrameResources const& res) {
+// All Batches of the DrawList are sorted by the RenderQueue: opaque Batches are grouped by their
+// shader variant, their GraphicsState and their Material, transparent Batches are drawn last. If
+// meshletShaders are given, Batches with Meshlets are drawn with these. The keywords are added to
+// the mask of the shader variants of all Batches.
+void drawModel(Illusion::Graphics::Gltf::Model const& model,
+    Illusion::Graphics::Gltf::DrawList const& drawList, Illusion::Graphics::ShaderVariants& shaders,
+    Illusion::Graphics::ShaderVariantsPtr const& meshletShaders, uint64_t keywords,
+    Illusion::Graphics::RenderQueue& queue, FrameResources const& res) {
+
+  res.mCmd->bindingState().setStorageBuffer(drawList.mInstances.mBuffer,
+      drawList.mInstances.mSize, drawList.mInstances.mOffset, 2, 0);
+  res.mCmd->bindingState().setStorageBuffer(drawList.mJointMatrices.mBuffer,
+      drawList.mJointMatrices.mSize, drawList.mJointMatrices.mOffset, 2, 1);
+  res.mCmd->bindingState().setStorageBuffer(model.getMaterialBuffer(),
+      model.getMaterialBuffer()->mBufferInfo.size, 0, 2, 6);
+
+  // the mesh shaders read the vertices directly from the vertex buffer
+  bool useMeshlets = meshletShaders && model.getMeshletBuffer();
+
+  if (useMeshlets) {
+    uint32_t binding = 2;
+    for (auto const& buffer : {model.getMeshletBuffer(), model.getMeshletVertexBuffer(),
+             model.getMeshletTriangleBuffer(), model.getVertexBuffer()}) {
+      res.mCmd->bindingState().setStorageBuffer(buffer, buffer->mBufferInfo.size, 0, 2, binding++);
+    }
+  }
 
-  res.mCmd->graphicsState().setBlendAttachments({{doAlphaBlending}});
+  std::unordered_map<Illusion::Graphics::Gltf::Material const*, uint16_t> materialKeys;
 
-  for (auto const& n : nodes) {
+  queue.clear();
 
-    glm::mat4 nodeMatrix = n->mGlobalTransform;
+  // As a Batch contains the Primitives of many Nodes, no depth is given; transparent Batches are
+  // drawn in the order of the DrawList.
+  for (uint32_t i = 0; i < drawList.mBatches.size(); ++i) {
+    auto const& batch    = drawList.mBatches[i];
+    auto const& m        = batch.mMaterial;
+    bool        meshlets = useMeshlets && batch.mMeshlets;
 
-    if (n->mSkin) {
-      SkinUniforms skin;
-      auto         jointMatrices = n->mSkin->getJointMatrices(nodeMatrix);
+    Illusion::Graphics::RenderQueue::Packet packet;
+    packet.mPipelineKey = static_cast<uint16_t>(batch.mVertexAttributes |
+                                                (static_cast<int>(batch.mTopology) << 3) |
+                                                (static_cast<int>(m->mDoubleSided) << 7) |
+                                                (static_cast<int>(meshlets) << 8));
+    packet.mMaterialKey =
+        materialKeys.emplace(m.get(), static_cast<uint16_t>(materialKeys.size())).first->second;
+    packet.mTransparent = m->mDoAlphaBlending;
+    packet.mUserData    = i;
 
-      for (size_t i(0); i < jointMatrices.size() && i < 256; ++i) {
-        skin.mJointMatrices[i] = jointMatrices[i];
-      }
+    queue.add(packet);
+  }
 
-      auto skinDynamicOffset = res.mUniformBuffer->addData(skin);
-      res.mCmd->bindingState().setDynamicUniformBuffer(res.mUniformBuffer->getBuffer(),
-          sizeof(SkinUniforms), static_cast<uint32_t>(skinDynamicOffset), 2, 0);
+  // all Primitives sharing the same Material and topology are drawn with one indirect draw call
+  queue.replay(*res.mCmd, [&](Illusion::Graphics::CommandBuffer& cmd,
+                              Illusion::Graphics::RenderQueue::Packet const& packet) {
+    auto const& batch = drawList.mBatches[packet.mUserData];
+    auto const& m     = batch.mMaterial;
+
+    // the bits of mVertexAttributes are in the same order as the keywords of the variants
+    auto attributes = static_cast<uint64_t>(batch.mVertexAttributes) | keywords;
+    bool meshlets   = useMeshlets && batch.mMeshlets;
+    cmd.setShader(meshlets ? meshletShaders->get(attributes) : shaders.get(attributes));
+    cmd.bindingState().setTexture(m->mAlbedoTexture, 3, 0);
+    cmd.bindingState().setTexture(m->mMetallicRoughnessTexture, 3, 1);
+    cmd.bindingState().setTexture(m->mNormalTexture, 3, 2);
+    cmd.bindingState().setTexture(m->mOcclusionTexture, 3, 3);
+    cmd.bindingState().setTexture(m->mEmissiveTexture, 3, 4);
+    cmd.graphicsState().setBlendAttachments({{packet.mTransparent}});
+    cmd.graphicsState().setTopology(batch.mTopology);
+    cmd.graphicsState().setCullMode(
+        m->mDoubleSided ? vk::CullModeFlagBits::eNone : vk::CullModeFlagBits::eBack);
+
+    // the task shader skips the normal cone test for double-sided Materials
+    if (meshlets) {
+      cmd.specializationState().set(0u, m->mDoubleSided);
+      drawList.drawMeshlets(cmd, batch);
     } else {
-      res.mCmd->bindingState().setDynamicUniformBuffer(res.mUniformBuffer->getBuffer(),
-          sizeof(SkinUniforms), static_cast<uint32_t>(emptySkinDynamicOffset), 2, 0);
-    }
-
-    if (n->mMesh) {
-
-      for (auto const& p : n->mMesh->mPrimitives) {
-
-        if (p.mMaterial->mDoAlphaBlending == doAlphaBlending) {
-          PushConstants pushConstants;
-          pushConstants.mModelMatrix                = modelMatrix * nodeMatrix;
-          pushConstants.mAlbedoFactor               = p.mMaterial->mAlbedoFactor;
-          pushConstants.mEmissiveFactor             = p.mMaterial->mEmissiveFactor;
-          pushConstants.mSpecularGlossinessWorkflow = p.mMaterial->mSpecularGlossinessWorkflow;
-          pushConstants.mMetallicRoughnessFactor    = p.mMaterial->mMetallicRoughnessFactor;
-          pushConstants.mNormalScale                = p.mMaterial->mNormalScale;
-          pushConstants.mOcclusionStrength          = p.mMaterial->mOcclusionStrength;
-          pushConstants.mAlphaCutoff                = p.mMaterial->mAlphaCutoff;
-          pushConstants.mVertexAttributes           = (int)p.mVertexAttributes;
-          res.mCmd->pushConstants(pushConstants);
-
-          res.mCmd->bindingState().setTexture(p.mMaterial->mAlbedoTexture, 3, 0);
-          res.mCmd->bindingState().setTexture(p.mMaterial->mMetallicRoughnessTexture, 3, 1);
-          res.mCmd->bindingState().setTexture(p.mMaterial->mNormalTexture, 3, 2);
-          res.mCmd->bindingState().setTexture(p.mMaterial->mOcclusionTexture, 3, 3);
-          res.mCmd->bindingState().setTexture(p.mMaterial->mEmissiveTexture, 3, 4);
-          res.mCmd->graphicsState().setTopology(p.mTopology);
-          res.mCmd->graphicsState().setCullMode(p.mMaterial->mDoubleSided
-                                                    ? vk::CullModeFlagBits::eNone
-                                                    : vk::CullModeFlagBits::eBack);
-          res.mCmd->drawIndexed(p.mIndexCount, 1, p.mIndexOffset, 0, 0);
-        }
-      }
+      drawList.draw(cmd, batch);
     }
+  });
+}
 
-    drawNodes(n->mChildren, viewMatrix, modelMatrix, doAlphaBlending, emptySkinDynamicOffset, res);
+// Prints the median, the 95th and the 99th percentile and the maximum of the given frame times.
+void printStatistics(std::string const& name, Illusion::Core::FPSCounter::Statistics const& stats) {
+  if (stats.mSamples == 0) {
+    return;
   }
-};
+
+  ILLUSION_MESSAGE << name << " (ms): p50 " << stats.mP50 << ", p95 " << stats.mP95 << ", p99 "
+                   << stats.mP99 << ", max " << stats.mMax << std::endl;
+}
+
+// Creates a shading rate image with the given number of texels. The center of the image is shaded
+// at full rate, the periphery with one fragment per 2x2 pixels.
+Illusion::Graphics::BackedImagePtr createShadingRateImage(
+    Illusion::Graphics::DevicePtr const& device, glm::uvec2 const& size) {
+
+  std::vector<uint8_t> rates(size.x * size.y);
+  for (uint32_t y = 0; y < size.y; ++y) {
+    for (uint32_t x = 0; x < size.x; ++x) {
+      glm::vec2 position    = (glm::vec2(x, y) + 0.5f) / glm::vec2(size) * 2.f - 1.f;
+      rates[y * size.x + x] = glm::length(position) < 0.7f ? 0 : (1 << 2 | 1);
+    }
+  }
+
+  vk::ImageCreateInfo info;
+  info.imageType     = vk::ImageType::e2D;
+  info.format        = vk::Format::eR8Uint;
+  info.extent.width  = size.x;
+  info.extent.height = size.y;
+  info.extent.depth  = 1;
+  info.mipLevels     = 1;
+  info.arrayLayers   = 1;
+  info.samples       = vk::SampleCountFlagBits::e1;
+  info.tiling        = vk::ImageTiling::eOptimal;
+  info.usage         = vk::ImageUsageFlagBits::eFragmentShadingRateAttachmentKHR |
+                       vk::ImageUsageFlagBits::eTransferDst;
+  info.sharingMode   = vk::SharingMode::eExclusive;
+  info.initialLayout = vk::ImageLayout::eUndefined;
+
+  return device->createBackedImage(info, vk::ImageViewType::e2D, vk::ImageAspectFlagBits::eColor,
+      vk::MemoryPropertyFlagBits::eDeviceLocal,
+      vk::ImageLayout::eFragmentShadingRateAttachmentOptimalKHR, vk::ComponentMapping(),
+      rates.size(), rates.data());
+}
 
 int main(int argc, char* argv[]) {
 
   struct {
-    std::string mModelFile   = "data/models/DamagedHelmet.glb";
-    std::string mSkyboxFile  = "data/textures/sunset_fairway_1k.hdr";
-    std::string mTexChannels = "rgb";
-    int         mAnimation   = 0;
-    bool        mNoSkins     = false;
-    bool        mNoTextures  = false;
-    bool        mPrintInfo   = false;
-    bool        mPrintHelp   = false;
+    std::string mModelFile            = "data/models/DamagedHelmet.glb";
+    std::string mSkyboxFile           = "data/textures/sunset_fairway_1k.hdr";
+    std::string mTexChannels          = "rgb";
+    std::string mPipelineCacheFile    = "GltfViewer.pipelinecache";
+    std::string mPipelineManifestFile = "GltfViewer.pipelines";
+    std::string mIblCacheFile         = "GltfViewer.iblcache";
+    std::string mShaderCacheDirectory = "GltfViewer.shadercache";
+    std::string mShaderOptimization   = "none";
+    int         mAnimation            = 0;
+    int         mSamples              = 1;
+    int         mPointLights          = 0;
+    int         mTextureBudget        = 0;
+    int         mFrames               = 0;
+    int         mWidth                = 1920;
+    int         mHeight               = 1080;
+    float       mTargetGpuTime        = 0.f;
+    bool        mNoSkins              = false;
+    bool        mNoTextures           = false;
+    bool        mAsyncPipelines       = false;
+    bool        mDynamicRendering     = false;
+    bool        mCulling              = false;
+    bool        mAsyncLoading         = false;
+    bool        mCompactVertices      = false;
+    bool        mOptimizeMeshes       = false;
+    bool        mLods                 = false;
+    bool        mMeshShaders          = false;
+    bool        mShadows              = false;
+    bool        mStereo               = false;
+    bool        mShadingRate          = false;
+    bool        mPostProcessing       = false;
+    bool        mGeometryArena        = false;
+    bool        mCache                = false;
+    bool        mCompressTextures     = false;
+    bool        mGpuTiming            = false;
+    bool        mHeadless             = false;
+    bool        mPrintInfo            = false;
+    bool        mPrintHelp            = false;
   } options;
 
   // clang-format off
@@ -149,9 +294,38 @@ int main(int argc, char* argv[]) {
   args.addOption({"-i",  "--info"},        &options.mPrintInfo,  "Print information on the loaded model");
   args.addOption({"-m",  "--model"},       &options.mModelFile,  "GLTF model (.gltf or .glb)");
   args.addOption({"-e",  "--environment"}, &options.mSkyboxFile, "Skybox image (in equirectangular projection)");
+  args.addOption({"-ic", "--ibl-cache"},   &options.mIblCacheFile, "File for storing the prefiltered environment. Use an empty string to disable the cache.");
   args.addOption({"-a",  "--animation"},   &options.mAnimation,  "Index of the animation to play. Default: 0, Use -1 to disable animations.");
   args.addOption({"-ns", "--no-skins"},    &options.mNoSkins,    "Disable loading of skins");
   args.addOption({"-nt", "--no-textures"}, &options.mNoTextures, "Disable loading of textures");
+  args.addOption({"-p",  "--pipeline-cache"}, &options.mPipelineCacheFile, "File for storing compiled pipelines. Use an empty string to disable the cache.");
+  args.addOption({"-sc", "--shader-cache"}, &options.mShaderCacheDirectory, "Directory for storing compiled Spir-V code. Use an empty string to disable the cache.");
+  args.addOption({"-so", "--shader-optimization"}, &options.mShaderOptimization, "Optimization of the Spir-V code of the shaders: none, dce, performance or size. Default: none");
+  args.addOption({"-gt", "--gpu-timing"},   &options.mGpuTiming,  "Print the average GPU time of the model every 100 frames, e.g. to compare shader optimizations");
+  args.addOption({"-pm", "--pipeline-manifest"}, &options.mPipelineManifestFile, "File for storing used pipeline states. These are compiled at startup. Use an empty string to disable the manifest.");
+  args.addOption({"-ap", "--async-pipelines"}, &options.mAsyncPipelines, "Skip draw calls while their pipelines are compiled in the background");
+  args.addOption({"-c",  "--culling"},      &options.mCulling,    "Cull primitives on the GPU against the view frustum and the depth of the last frame");
+  args.addOption({"-al", "--async-loading"}, &options.mAsyncLoading, "Start rendering while the model is still being loaded");
+  args.addOption({"-ga", "--geometry-arena"}, &options.mGeometryArena, "Store the vertices and indices in the buffers shared by all models instead of buffers of their own");
+  args.addOption({"-cv", "--compact-vertices"}, &options.mCompactVertices, "Use a quantized vertex format which requires less memory bandwidth");
+  args.addOption({"-om", "--optimize-meshes"}, &options.mOptimizeMeshes, "Reorder the vertices and triangles of the model for faster rendering");
+  args.addOption({"-msh", "--mesh-shaders"}, &options.mMeshShaders, "Draw static triangle meshes as meshlets with task and mesh shaders if VK_EXT_mesh_shader is supported");
+  args.addOption({"-l",  "--lods"},         &options.mLods,       "Generate simplified versions of the meshes and draw them when they are far away");
+  args.addOption({"-cc", "--cache"},        &options.mCache,      "Store the processed model in a cache file next to it and load it from there next time");
+  args.addOption({"-ct", "--compress-textures"}, &options.mCompressTextures, "Compress the textures of the model to BC1 or BC3 when loading");
+  args.addOption({"-tb", "--texture-budget"}, &options.mTextureBudget, "Stream the mipmap levels of the textures with the given budget in MB. Default: 0, Use 0 to upload all levels at once.");
+  args.addOption({"-f",  "--frames"},       &options.mFrames,     "Render this many frames along a fixed camera path and print percentiles of the CPU and GPU frame times. Default: 0, Use 0 to run until the window is closed.");
+  args.addOption({"-hl", "--headless"},     &options.mHeadless,   "Render to offscreen images without opening a window. Runs for 1000 frames if --frames is not given.");
+  args.addOption({"-rw", "--width"},        &options.mWidth,      "Width of the offscreen images in headless mode. Default: 1920");
+  args.addOption({"-rh", "--height"},       &options.mHeight,     "Height of the offscreen images in headless mode. Default: 1080");
+  args.addOption({"-dr", "--dynamic-rendering"}, &options.mDynamicRendering, "Use VK_KHR_dynamic_rendering instead of vk::RenderPass objects if it is supported");
+  args.addOption({"-ms", "--msaa"},         &options.mSamples,    "Number of samples for multisample anti-aliasing. It is reduced to the maximum supported by the GPU. Default: 1");
+  args.addOption({"-pl", "--point-lights"}, &options.mPointLights, "Number of animated point lights around the model. They are binned into view space clusters by a compute shader. Default: 0");
+  args.addOption({"-sh", "--shadows"},      &options.mShadows,    "Add a sun which casts cascaded shadows. All cascades are rendered in one layered pass, this requires geometry shaders");
+  args.addOption({"-dres", "--dynamic-resolution"}, &options.mTargetGpuTime, "Reduce the resolution while the GPU time of the model exceeds this many milliseconds. Default: 0, Use 0 to disable it.");
+  args.addOption({"-vrs", "--shading-rate"}, &options.mShadingRate, "Shade the periphery of the image with one fragment per 2x2 pixels. This requires --dynamic-rendering and VK_KHR_fragment_shading_rate");
+  args.addOption({"-st", "--stereo"},       &options.mStereo,     "Render a view for each eye in a single multiview pass, the window shows the left one. This disables --culling, --mesh-shaders, --point-lights and --post-processing");
+  args.addOption({"-pp", "--post-processing"}, &options.mPostProcessing, "Render HDR colors and apply bloom, tone mapping and FXAA with fused compute passes afterwards");
   args.addOption({"-t",  "--trace"},        &Illusion::Core::Logger::enableTrace, "Print trace output");
   // clang-format on
 
@@ -162,9 +336,41 @@ int main(int argc, char* argv[]) {
     return 0;
   }
 
-  auto instance = Illusion::Graphics::Instance::create("Simple GLTF Loader");
-  auto device   = Illusion::Graphics::Device::create(instance->getPhysicalDevice());
-  auto window   = Illusion::Graphics::Window::create(instance, device);
+  if (options.mHeadless && options.mFrames <= 0) {
+    options.mFrames = 1000;
+  }
+
+  Illusion::Graphics::ShaderSource::setCacheDirectory(options.mShaderCacheDirectory);
+
+  const std::unordered_map<std::string, Illusion::Graphics::ShaderOptimization> optimizations = {
+      {"none", Illusion::Graphics::ShaderOptimization::eNone},
+      {"dce", Illusion::Graphics::ShaderOptimization::eDeadCodeElimination},
+      {"performance", Illusion::Graphics::ShaderOptimization::ePerformance},
+      {"size", Illusion::Graphics::ShaderOptimization::eSize}};
+
+  auto optimization = optimizations.find(options.mShaderOptimization);
+  if (optimization == optimizations.end()) {
+    ILLUSION_ERROR << "Unknown shader optimization " << options.mShaderOptimization << "!"
+                   << std::endl;
+    return 1;
+  }
+
+  Illusion::Graphics::ShaderSource::setDefaultOptimization(optimization->second);
+
+  // Without a window, no surface and no swapchain are required.
+  auto instance =
+      Illusion::Graphics::Instance::create("Simple GLTF Loader", true, options.mHeadless);
+  auto device = Illusion::Graphics::Device::create(
+      instance->getPhysicalDevice(), options.mPipelineCacheFile);
+
+  Illusion::Graphics::WindowPtr window;
+  if (!options.mHeadless) {
+    window = Illusion::Graphics::Window::create(instance, device);
+  }
+
+  // The environment is baked on the compute queue while the model is loaded.
+  auto iblBaker = Illusion::Graphics::IblBaker::create(device);
+  iblBaker->bake(options.mSkyboxFile, {}, options.mIblCacheFile);
 
   Illusion::Graphics::Gltf::LoadOptions loadOptions;
   if (options.mAnimation >= 0) {
@@ -176,98 +382,450 @@ int main(int argc, char* argv[]) {
   if (!options.mNoTextures) {
     loadOptions |= Illusion::Graphics::Gltf::LoadOptionBits::eTextures;
   }
+  if (options.mAsyncLoading) {
+    loadOptions |= Illusion::Graphics::Gltf::LoadOptionBits::eAsync;
+  }
+  if (options.mCompactVertices) {
+    loadOptions |= Illusion::Graphics::Gltf::LoadOptionBits::eCompactVertices;
+  }
+  if (options.mOptimizeMeshes) {
+    loadOptions |= Illusion::Graphics::Gltf::LoadOptionBits::eOptimizeMeshes;
+  }
+  if (options.mLods) {
+    loadOptions |= Illusion::Graphics::Gltf::LoadOptionBits::eGenerateLods;
+  }
+  if (options.mCache) {
+    loadOptions |= Illusion::Graphics::Gltf::LoadOptionBits::eCache;
+  }
+  if (options.mCompressTextures) {
+    loadOptions |= Illusion::Graphics::Gltf::LoadOptionBits::eCompressTextures;
+  }
+  if (options.mGeometryArena) {
+    loadOptions |= Illusion::Graphics::Gltf::LoadOptionBits::eGeometryArena;
+  }
 
-  auto model = Illusion::Graphics::Gltf::Model::create(device, options.mModelFile, loadOptions);
+  if (options.mMeshShaders && !device->getPhysicalDevice()->supportsMeshShaders()) {
+    ILLUSION_WARNING << "VK_EXT_mesh_shader is not supported, using vertex shaders." << std::endl;
+    options.mMeshShaders = false;
+  }
+
+  if (options.mStereo && !device->getPhysicalDevice()->supportsMultiview()) {
+    ILLUSION_WARNING << "VK_KHR_multiview is not supported, stereo rendering is disabled."
+                     << std::endl;
+    options.mStereo = false;
+  }
+
+  // The Culler, the LightClusterer and the task shaders only know a single camera; the
+  // PostProcessor only processes single-layered images.
+  if (options.mStereo && (options.mCulling || options.mMeshShaders || options.mPointLights > 0 ||
+                             options.mPostProcessing)) {
+    ILLUSION_WARNING << "Culling, mesh shaders, point lights and post-processing are disabled as "
+                        "--stereo is given."
+                     << std::endl;
+    options.mCulling        = false;
+    options.mMeshShaders    = false;
+    options.mPointLights    = 0;
+    options.mPostProcessing = false;
+  }
+
+  if (options.mMeshShaders) {
+    loadOptions |= Illusion::Graphics::Gltf::LoadOptionBits::eMeshlets;
+  }
+
+  if (options.mShadows && !device->getEnabledFeatures().geometryShader) {
+    ILLUSION_WARNING << "Geometry shaders are not supported, shadows are disabled." << std::endl;
+    options.mShadows = false;
+  }
+
+  Illusion::Core::Timer loadingTimer;
+
+  Illusion::Graphics::TextureStreamerPtr textureStreamer;
+  if (options.mTextureBudget > 0) {
+    textureStreamer = Illusion::Graphics::TextureStreamer::create(
+        device, static_cast<vk::DeviceSize>(options.mTextureBudget) * 1024 * 1024);
+  }
+
+  auto model = Illusion::Graphics::Gltf::Model::create(
+      device, options.mModelFile, loadOptions, textureStreamer);
+  model->sOnLoaded.connect([&loadingTimer]() {
+    ILLUSION_MESSAGE << "Model loaded after " << loadingTimer.getElapsed() << " s." << std::endl;
+    return false;
+  });
 
   if (options.mPrintInfo) {
     model->printInfo();
   }
 
-  auto      modelBBox   = model->getRoot()->getBoundingBox();
+  auto      modelBBox   = model->getBoundingBox();
   float     modelSize   = glm::length(modelBBox.mMin - modelBBox.mMax);
   glm::vec3 modelCenter = (modelBBox.mMin + modelBBox.mMax) * 0.5f;
   glm::mat4 modelMatrix = glm::scale(glm::vec3(1.f / modelSize));
   modelMatrix           = glm::translate(modelMatrix, -modelCenter);
 
-  auto brdflut = Illusion::Graphics::Texture::createBRDFLuT(device, 128);
-  auto skybox  = Illusion::Graphics::Texture::createCubemapFrom360PanoramaFile(
-      device, options.mSkyboxFile, 1024);
-  auto prefilteredIrradiance =
-      Illusion::Graphics::Texture::createPrefilteredIrradianceCubemap(device, 64, skybox);
-  auto prefilteredReflection =
-      Illusion::Graphics::Texture::createPrefilteredReflectionCubemap(device, 128, skybox);
+  // The point lights are scattered in the bounding box of the scaled model and rotate around it.
+  // A fixed seed is used so that runs with --frames can be compared.
+  std::vector<Illusion::Graphics::LightClusterer::PointLight> pointLights(
+      static_cast<size_t>(std::max(options.mPointLights, 0)));
+  {
+    std::mt19937                          generator(0);
+    std::uniform_real_distribution<float> position(-0.5f, 0.5f);
+    std::uniform_real_distribution<float> color(0.2f, 1.f);
+    std::uniform_real_distribution<float> radius(0.05f, 0.2f);
+
+    for (auto& light : pointLights) {
+      light.mPosition  = glm::vec3(position(generator), position(generator), position(generator));
+      light.mRadius    = radius(generator);
+      light.mColor     = glm::vec3(color(generator), color(generator), color(generator));
+      light.mIntensity = 2.f;
+    }
+  }
 
-  auto pbrShader = Illusion::Graphics::Shader::createFromFiles(
-      device, {"data/shaders/GltfShader.vert", "data/shaders/GltfShader.frag"}, {"SkinUniforms"});
+  // If the panorama has been decoded already, this submits the bake so that it is executed while
+  // the pipelines are compiled.
+  iblBaker->update();
+
+  // The first keywords are in the order of the bits of Gltf::Primitive::VertexAttributeBits.
+  auto pbrShaders = Illusion::Graphics::ShaderVariants::create(device,
+      std::vector<std::string>{options.mCompactVertices ? "data/shaders/GltfShaderCompact.vert"
+                                                        : "data/shaders/GltfShader.vert",
+          "data/shaders/GltfShader.frag"},
+      std::vector<std::string>{
+          "HAS_NORMALS", "HAS_TEXCOORDS", "HAS_SKINS", "CLUSTERED_LIGHTS", "SHADOWS",
+          "MULTIVIEW", "HDR_OUTPUT"});
+
+  // this is added to the mask of all variants
+  uint64_t keywords = 0;
+  if (options.mPointLights > 0) {
+    keywords |= pbrShaders->getMask({"CLUSTERED_LIGHTS"});
+  }
+  if (options.mShadows) {
+    keywords |= pbrShaders->getMask({"SHADOWS"});
+  }
+  if (options.mStereo) {
+    keywords |= pbrShaders->getMask({"MULTIVIEW"});
+  }
+  if (options.mPostProcessing) {
+    keywords |= pbrShaders->getMask({"HDR_OUTPUT"});
+  }
+
+  // the material textures change with almost every draw call, they are pushed directly if
+  // VK_KHR_push_descriptor is available
+  pbrShaders->setPerDrawSet(3);
+
+  // The fragment stage is shared with the vertex shader path. Meshlets are never skinned.
+  Illusion::Graphics::ShaderVariantsPtr meshletShaders;
+  if (options.mMeshShaders) {
+    meshletShaders = Illusion::Graphics::ShaderVariants::create(device,
+        std::vector<std::string>{"data/shaders/GltfShader.task",
+            options.mCompactVertices ? "data/shaders/GltfShaderCompact.mesh"
+                                     : "data/shaders/GltfShader.mesh",
+            "data/shaders/GltfShader.frag"},
+        pbrShaders->getKeywords());
+    meshletShaders->setPerDrawSet(3);
+  }
+
+  std::set<std::string> skyDefines;
+  if (options.mStereo) {
+    skyDefines.insert("MULTIVIEW");
+  }
+  if (options.mPostProcessing) {
+    skyDefines.insert("HDR_OUTPUT");
+  }
 
   auto skyShader = Illusion::Graphics::Shader::createFromFiles(
-      device, {"data/shaders/Quad.vert", "data/shaders/Skybox.frag"});
+      device, {"data/shaders/Quad.vert", "data/shaders/Skybox.frag"}, {}, true, skyDefines);
+
+  // compile the shaders on worker threads while the scene is being prepared; Primitives of Nodes
+  // without a Skin are drawn without HAS_SKINS
+  auto skins =
+      static_cast<uint64_t>(Illusion::Graphics::Gltf::Primitive::VertexAttributeBits::eSkins);
+  for (auto const& mesh : model->getMeshes()) {
+    for (auto const& primitive : mesh->mPrimitives) {
+      auto attributes = static_cast<uint64_t>(static_cast<int32_t>(primitive.mVertexAttributes));
+      pbrShaders->get(attributes | keywords);
+      pbrShaders->get((attributes & ~skins) | keywords);
+      if (meshletShaders) {
+        meshletShaders->get((attributes & ~skins) | keywords);
+      }
+    }
+  }
+  skyShader->prepareAsync();
+
+  auto culler      = Illusion::Graphics::Gltf::Culler::create(device);
+  auto morpher     = Illusion::Graphics::Gltf::Morpher::create(device);
+  auto renderQueue = Illusion::Graphics::RenderQueue::create();
+
+  // The Culler cannot build its depth pyramid from a multisampled depth attachment.
+  auto samples = device->getPhysicalDevice()->getMaxSampleCount(
+      static_cast<vk::SampleCountFlagBits>(std::max(options.mSamples, 1)));
+
+  if (options.mCulling && samples != vk::SampleCountFlagBits::e1) {
+    ILLUSION_WARNING << "Multisample anti-aliasing is disabled as --culling is given." << std::endl;
+    samples = vk::SampleCountFlagBits::e1;
+  }
+
+  if (options.mDynamicRendering && !device->getPhysicalDevice()->supportsDynamicRendering()) {
+    ILLUSION_WARNING << "VK_KHR_dynamic_rendering is not supported, using a vk::RenderPass."
+                     << std::endl;
+    options.mDynamicRendering = false;
+  }
+
+  if (options.mShadingRate && (!options.mDynamicRendering ||
+                                  !device->getPhysicalDevice()->supportsFragmentShadingRate())) {
+    ILLUSION_WARNING << "VK_KHR_fragment_shading_rate is not supported or --dynamic-rendering is "
+                        "not given, shading at full rate."
+                     << std::endl;
+    options.mShadingRate = false;
+  }
+
+  // Each texel of the shading rate images covers 16x16 pixels, if this is supported.
+  glm::uvec2 shadingRateTexelSize(16);
+  if (options.mShadingRate) {
+    auto const& properties = device->getPhysicalDevice()->getFragmentShadingRateProperties();
+    auto        minSize    = properties.minFragmentShadingRateAttachmentTexelSize;
+    auto        maxSize    = properties.maxFragmentShadingRateAttachmentTexelSize;
+
+    shadingRateTexelSize = glm::clamp(shadingRateTexelSize,
+        glm::uvec2(minSize.width, minSize.height), glm::uvec2(maxSize.width, maxSize.height));
+  }
+
+  Illusion::Graphics::ResolutionScalerPtr resolutionScaler;
+  if (options.mTargetGpuTime > 0.f) {
+    resolutionScaler = Illusion::Graphics::ResolutionScaler::create(options.mTargetGpuTime);
+  }
 
-  auto uboAlignment =
-      instance->getPhysicalDevice()->getProperties().limits.minUniformBufferOffsetAlignment;
+  // The first view is the left eye, the second the right eye.
+  uint32_t viewMask = options.mStereo ? 0b11 : 0;
 
   Illusion::Core::RingBuffer<FrameResources, 2> frameResources{
-      FrameResources(device, uboAlignment), FrameResources(device, uboAlignment)};
+      FrameResources(device, !options.mCulling, samples, options.mDynamicRendering, viewMask,
+          options.mPostProcessing),
+      FrameResources(device, !options.mCulling, samples, options.mDynamicRendering, viewMask,
+          options.mPostProcessing)};
 
   glm::vec3 cameraPolar(0.f, 0.f, 1.5f);
 
-  window->sOnMouseEvent.connect([&cameraPolar, &window](Illusion::Input::MouseEvent const& e) {
-    if (e.mType == Illusion::Input::MouseEvent::Type::eMove) {
-      static int lastX = e.mX;
-      static int lastY = e.mY;
+  // In headless mode, the offscreen images have a fixed size.
+  auto getExtent = [&window, &options]() {
+    return window ? window->pExtent.get()
+                  : glm::uvec2(std::max(options.mWidth, 1), std::max(options.mHeight, 1));
+  };
 
-      if (window->buttonPressed(Illusion::Input::Button::eButton1)) {
-        int dX = lastX - e.mX;
-        int dY = lastY - e.mY;
+  if (window) {
+    window->sOnMouseEvent.connect([&cameraPolar, &window](Illusion::Input::MouseEvent const& e) {
+      if (e.mType == Illusion::Input::MouseEvent::Type::eMove) {
+        static int lastX = e.mX;
+        static int lastY = e.mY;
 
-        cameraPolar.x += dX * 0.005f;
-        cameraPolar.y += dY * 0.005f;
+        if (window->buttonPressed(Illusion::Input::Button::eButton1)) {
+          int dX = lastX - e.mX;
+          int dY = lastY - e.mY;
 
-        cameraPolar.y = glm::clamp(
-            cameraPolar.y, -glm::pi<float>() * 0.5f + 0.1f, glm::pi<float>() * 0.5f - 0.1f);
+          cameraPolar.x += dX * 0.005f;
+          cameraPolar.y += dY * 0.005f;
+
+          cameraPolar.y = glm::clamp(
+              cameraPolar.y, -glm::pi<float>() * 0.5f + 0.1f, glm::pi<float>() * 0.5f - 0.1f);
+        }
+
+        lastX = e.mX;
+        lastY = e.mY;
+      } else if (e.mType == Illusion::Input::MouseEvent::Type::eScroll) {
+        cameraPolar.z -= e.mY * 0.01;
+        cameraPolar.z = std::max(cameraPolar.z, 0.01f);
       }
 
-      lastX = e.mX;
-      lastY = e.mY;
-    } else if (e.mType == Illusion::Input::MouseEvent::Type::eScroll) {
-      cameraPolar.z -= e.mY * 0.01;
-      cameraPolar.z = std::max(cameraPolar.z, 0.01f);
+      return true;
+    });
+
+    window->open();
+  }
+
+  // Compile all pipelines used in the last session on the worker threads of the PipelineCache.
+  // The RenderPasses need their final extent, else they would be re-created in the first frame.
+  if (!options.mPipelineManifestFile.empty()) {
+    std::vector<Illusion::Graphics::RenderPassPtr> renderPasses;
+    for (int i = 0; i < 2; ++i) {
+      auto& res = frameResources.next();
+      res.mRenderPass->setExtent(getExtent());
+      renderPasses.push_back(res.mRenderPass);
+    }
+    auto shaders = pbrShaders->getShaders();
+    shaders.push_back(skyShader);
+    if (meshletShaders) {
+      auto meshlets = meshletShaders->getShaders();
+      shaders.insert(shaders.end(), meshlets.begin(), meshlets.end());
     }
+    device->getPipelineCache()->prewarm(options.mPipelineManifestFile, shaders, renderPasses);
 
-    return true;
-  });
+    if (!options.mAsyncPipelines) {
+      device->getPipelineCache()->waitForPendingPipelines();
+    }
+  }
+
+  // Viewport and scissor are dynamic so that resizing the window does not require new pipelines.
+  // If supported, so are the cull mode and the topology which change per batch.
+  std::set<vk::DynamicState> dynamicState = {
+      vk::DynamicState::eViewport, vk::DynamicState::eScissor};
+  if (device->getPhysicalDevice()->supportsExtendedDynamicState()) {
+    dynamicState.insert(vk::DynamicState::eCullModeEXT);
+    dynamicState.insert(vk::DynamicState::ePrimitiveTopologyEXT);
+  }
+
+  for (int i = 0; i < 2; ++i) {
+    auto& res = frameResources.next();
+    res.mCmd->setAsyncPipelineCreation(options.mAsyncPipelines);
+    res.mCmd->graphicsState().setDynamicState(dynamicState);
+
+    if (options.mShadows) {
+      res.mShadowMap = Illusion::Graphics::Gltf::ShadowMap::create(device);
+    }
+  }
 
-  window->open();
+  iblBaker->waitIdle();
+
+  auto skybox                = iblBaker->getSkybox();
+  auto brdflut               = iblBaker->getBRDFLuT();
+  auto prefilteredIrradiance = iblBaker->getIrradiance();
+  auto prefilteredReflection = iblBaker->getReflection();
 
   Illusion::Core::Timer timer;
 
-  while (!window->shouldClose()) {
+  // the timestamps are given in multiples of this many nanoseconds
+  float    timestampPeriod = instance->getPhysicalDevice()->getProperties().limits.timestampPeriod;
+  double   gpuTime         = 0.0;
+  uint32_t gpuTimeFrames   = 0;
+
+  // With --frames, the camera path and the animation time depend only on the frame index, so that
+  // the results of several runs can be compared. The GPU time is measured for each frame then.
+  bool gpuTiming = options.mGpuTiming || options.mFrames > 0 || resolutionScaler;
+  int  frame     = 0;
+
+  // With --frames, the statistics cover all frames. Else the window title shows the frame rate,
+  // the 99th percentile of the CPU and GPU frame times of the last 1024 frames and the number of
+  // hitches every 100 frames.
+  Illusion::Core::FPSCounter fpsCounter(
+      100, true, options.mFrames > 0 ? static_cast<uint32_t>(options.mFrames) : 1024);
+
+  if (window) {
+    fpsCounter.pFPS.onChange().connect([&](float fps) {
+      auto cpu = fpsCounter.getStatistics(Illusion::Core::FPSCounter::Channel::eCpuTime);
+      auto gpu = fpsCounter.getStatistics(Illusion::Core::FPSCounter::Channel::eGpuTime);
+
+      std::stringstream title;
+      title << std::fixed << std::setprecision(1) << "Illusion - " << fps << " fps, CPU p99 "
+            << cpu.mP99 << " ms";
+      if (gpu.mSamples > 0) {
+        title << ", GPU p99 " << gpu.mP99 << " ms";
+      }
+      title << ", " << fpsCounter.getHitchCount() << " hitches";
+
+      window->pTitle = title.str();
+      return true;
+    });
+  }
+
+  auto readGpuTime = [&](FrameResources& res) {
+    if (!res.mTimestampsWritten) {
+      return;
+    }
+
+    std::array<uint64_t, 2> timestamps;
+    device->getHandle()->getQueryPoolResults(*res.mTimestamps, 0, 2, sizeof(timestamps),
+        timestamps.data(), sizeof(uint64_t), vk::QueryResultFlagBits::e64);
+
+    double milliseconds    = (timestamps[1] - timestamps[0]) * timestampPeriod * 1e-6;
+    res.mTimestampsWritten = false;
+
+    fpsCounter.addGpuTime(milliseconds);
+
+    if (resolutionScaler && resolutionScaler->addGpuTime(milliseconds)) {
+      ILLUSION_MESSAGE << "Resolution scale: " << resolutionScaler->getScale() << std::endl;
+    }
+
+    if (options.mGpuTiming) {
+      gpuTime += milliseconds;
+
+      if (++gpuTimeFrames == 100) {
+        ILLUSION_MESSAGE << "Average GPU time of the model: " << gpuTime / gpuTimeFrames << " ms."
+                         << std::endl;
+        gpuTime       = 0.0;
+        gpuTimeFrames = 0;
+      }
+    }
+  };
+
+  while ((!window || !window->shouldClose()) && (options.mFrames <= 0 || frame < options.mFrames)) {
+
+    Illusion::Core::Timer frameTimer;
 
-    window->update();
+    if (window) {
+      window->update();
+    }
+
+    if (options.mFrames > 0) {
+      float progress = static_cast<float>(frame) / static_cast<float>(options.mFrames);
+      cameraPolar.x  = progress * 2.f * glm::pi<float>();
+      cameraPolar.y  = std::sin(progress * 4.f * glm::pi<float>()) * 0.4f;
+    }
+
+    // uploads the data which has been loaded in the background
+    model->update();
+
+    float time = options.mFrames > 0 ? frame / 60.f : (float)timer.getElapsed();
 
     if (options.mAnimation >= 0 &&
         static_cast<size_t>(options.mAnimation) < model->getAnimations().size()) {
-      auto const& anim         = model->getAnimations()[options.mAnimation];
-      float modelAnimationTime = std::fmod((float)timer.getElapsed(), anim->mEnd - anim->mStart);
+      auto const& anim = model->getAnimations()[options.mAnimation];
+      float modelAnimationTime = std::fmod(time, anim->mEnd - anim->mStart);
       modelAnimationTime += anim->mStart;
       model->setAnimationTime(options.mAnimation, modelAnimationTime);
     }
 
     auto& res = frameResources.next();
 
+    // the time spent waiting for the GPU is not part of the CPU frame time
+    Illusion::Core::Timer fenceTimer;
     device->waitForFences(*res.mRenderFinishedFence);
     device->resetFences(*res.mRenderFinishedFence);
+    double fenceTime = fenceTimer.getElapsed();
+
+    readGpuTime(res);
 
     res.mCmd->reset();
     res.mCmd->begin();
 
-    res.mRenderPass->setExtent(window->pExtent.get());
-    res.mCmd->graphicsState().setViewports({{glm::vec2(window->pExtent.get())}});
+    res.mTimestampsWritten = gpuTiming;
+    if (gpuTiming) {
+      res.mCmd->resetQueryPool(res.mTimestamps, 0, 2);
+    }
+
+    glm::uvec2 extent = getExtent();
+    if (resolutionScaler) {
+      extent = resolutionScaler->getExtent(extent);
+    }
+
+    res.mRenderPass->setExtent(extent);
+
+    // The shading rate image has to cover the extent, it is re-created when the extent changes.
+    if (options.mShadingRate) {
+      glm::uvec2  size  = (extent + shadingRateTexelSize - 1u) / shadingRateTexelSize;
+      auto const& image = res.mRenderPass->getShadingRateImage();
+      if (!image || image->mImageInfo.extent.width != size.x ||
+          image->mImageInfo.extent.height != size.y) {
+        res.mRenderPass->setShadingRateImage(
+            createShadingRateImage(device, size), shadingRateTexelSize);
+      }
+    }
+    res.mCmd->graphicsState().setViewports({{glm::vec2(extent)}});
+    res.mCmd->graphicsState().setRasterizationSamples(res.mRenderPass->getSampleCount());
+
+    const float nearClip = 0.01f;
+    const float farClip  = 10.f;
 
     CameraUniforms camera;
     camera.mProjectionMatrix = glm::perspectiveZO(glm::radians(50.f),
-        static_cast<float>(window->pExtent.get().x) / static_cast<float>(window->pExtent.get().y),
-        0.01f, 10.0f);
+        static_cast<float>(extent.x) / static_cast<float>(extent.y), nearClip, farClip);
     camera.mProjectionMatrix[1][1] *= -1;
 
     camera.mPosition =
@@ -276,16 +834,93 @@ int main(int argc, char* argv[]) {
                       cameraPolar.z,
             1.0);
 
-    res.mUniformBuffer->reset();
+    // The GPU has finished the last frame which used these resources, so the data can be reused.
+    res.mUniformData->reset();
 
     camera.mViewMatrix =
         glm::lookAt(camera.mPosition.xyz(), glm::vec3(0.f), glm::vec3(0.f, 1.f, 0.f));
-    res.mUniformBuffer->addData(camera);
+
+    // In stereo mode, the eyes are moved sideways from the camera. Everything else, like the Lods
+    // and the shadow cascades, uses the camera in between.
+    Illusion::Graphics::TransientAllocator::Allocation cameraData;
+
+    if (options.mStereo) {
+      const float eyeSeparation = 0.03f;
+
+      std::array<CameraUniforms, 2> eyes{camera, camera};
+
+      glm::vec3 right(camera.mViewMatrix[0][0], camera.mViewMatrix[1][0], camera.mViewMatrix[2][0]);
+
+      for (int i = 0; i < 2; ++i) {
+        float offset = (i == 0 ? -0.5f : 0.5f) * eyeSeparation;
+        eyes[i].mPosition   = camera.mPosition + glm::vec4(right * offset, 0.f);
+        eyes[i].mViewMatrix = glm::translate(glm::vec3(-offset, 0.f, 0.f)) * camera.mViewMatrix;
+      }
+
+      cameraData = res.mUniformData->addData(eyes);
+    } else {
+      cameraData = res.mUniformData->addData(camera);
+    }
+
+    // The Lods are chosen so that their error is less than one pixel.
+    std::optional<Illusion::Graphics::Gltf::LodSelection> lodSelection;
+    if (options.mLods) {
+      lodSelection                   = Illusion::Graphics::Gltf::LodSelection();
+      lodSelection->mEyePosition     = camera.mPosition.xyz();
+      lodSelection->mProjectionScale =
+          std::abs(camera.mProjectionMatrix[1][1]) * static_cast<float>(extent.y) * 0.5f;
+    }
+
+    // The Textures are replaced before they are bound for this frame.
+    if (textureStreamer) {
+      model->requestTextureResolutions(camera.mPosition.xyz(),
+          std::abs(camera.mProjectionMatrix[1][1]) * static_cast<float>(extent.y) * 0.5f,
+          modelMatrix);
+      textureStreamer->update();
+    }
+
+    // The shared buffers are compacted after the uploads of model->update() have been issued and
+    // before the DrawList of this frame is created.
+    if (model->getGeometryArena()) {
+      model->getGeometryArena()->update(*res.mCmd);
+    }
+
+    // The bounding boxes of the DrawList are in world space already.
+    glm::mat4 viewProjection = camera.mProjectionMatrix * camera.mViewMatrix;
+    auto      drawList       = model->createDrawList(*res.mUniformData, modelMatrix, lodSelection);
+
+    // The morphed vertices are written before they are drawn in the RenderPass.
+    morpher->morph(*res.mCmd, *model, *res.mUniformData);
+
+    // The shadows are rendered with the draw commands of all Primitives, hence before they are
+    // culled for the camera. The morphed vertices and the joint matrices of the DrawList are
+    // reused.
+    if (res.mShadowMap) {
+      res.mShadowMap->render(*res.mCmd, *model, drawList, *res.mUniformData, camera.mViewMatrix,
+          camera.mProjectionMatrix, nearClip, farClip, glm::vec3(1.f, 2.f, 1.f),
+          modelBBox.getTransformed(modelMatrix));
+    }
+
+    if (options.mCulling) {
+      culler->cull(*res.mCmd, drawList, *res.mUniformData, viewProjection);
+    }
+
+    if (!pointLights.empty()) {
+      glm::mat4 rotation = glm::rotate(time * 0.3f, glm::vec3(0.f, 1.f, 0.f));
+
+      std::vector<Illusion::Graphics::LightClusterer::PointLight> lights(pointLights);
+      for (auto& light : lights) {
+        light.mPosition = (rotation * glm::vec4(light.mPosition, 1.f)).xyz();
+      }
+
+      res.mLightClusterer->cluster(*res.mCmd, *res.mUniformData, lights, camera.mViewMatrix,
+          camera.mProjectionMatrix, extent, nearClip, farClip);
+    }
 
     res.mCmd->beginRenderPass(res.mRenderPass);
 
     res.mCmd->bindingState().setUniformBuffer(
-        res.mUniformBuffer->getBuffer(), sizeof(CameraUniforms), 0, 0, 0);
+        cameraData.mBuffer, cameraData.mSize, cameraData.mOffset, 0, 0);
 
     res.mCmd->setShader(skyShader);
     res.mCmd->bindingState().setTexture(skybox, 1, 0);
@@ -299,40 +934,92 @@ int main(int argc, char* argv[]) {
 
     res.mCmd->bindingState().reset(1);
 
-    res.mCmd->setShader(pbrShader);
     res.mCmd->bindingState().setTexture(brdflut, 1, 0);
     res.mCmd->bindingState().setTexture(prefilteredIrradiance, 1, 1);
     res.mCmd->bindingState().setTexture(prefilteredReflection, 1, 2);
+    if (!pointLights.empty()) {
+      res.mLightClusterer->bind(*res.mCmd, 1, 3);
+    }
+    if (res.mShadowMap) {
+      res.mShadowMap->bind(*res.mCmd, 1, 7);
+    }
     res.mCmd->graphicsState().setDepthTestEnable(true);
     res.mCmd->graphicsState().setDepthWriteEnable(true);
     res.mCmd->graphicsState().setVertexInputAttributes(
-        Illusion::Graphics::Gltf::Model::getVertexInputAttributes());
+        Illusion::Graphics::Gltf::Model::getVertexInputAttributes(model->getVertexLayout()));
     res.mCmd->graphicsState().setVertexInputBindings(
-        Illusion::Graphics::Gltf::Model::getVertexInputBindings());
+        Illusion::Graphics::Gltf::Model::getVertexInputBindings(model->getVertexLayout()));
 
-    res.mCmd->bindVertexBuffers(0, {model->getVertexBuffer()});
-    res.mCmd->bindIndexBuffer(model->getIndexBuffer(), 0, vk::IndexType::eUint32);
+    if (model->getSkinBuffer()) {
+      res.mCmd->bindVertexBuffers(0, {model->getVertexBuffer(), model->getSkinBuffer()});
+    } else {
+      res.mCmd->bindVertexBuffers(0, {model->getVertexBuffer()});
+    }
+    res.mCmd->bindIndexBuffer(model->getIndexBuffer(), 0, model->getIndexType());
 
-    SkinUniforms ubo;
-    uint32_t     emptySkinDynamicOffset = res.mUniformBuffer->addData(ubo);
+    if (gpuTiming) {
+      res.mCmd->writeTimestamp(vk::PipelineStageFlagBits::eTopOfPipe, res.mTimestamps, 0);
+    }
 
-    drawNodes(model->getRoot()->mChildren, camera.mViewMatrix, modelMatrix, false,
-        emptySkinDynamicOffset, res);
-    drawNodes(model->getRoot()->mChildren, camera.mViewMatrix, modelMatrix, true,
-        emptySkinDynamicOffset, res);
+    drawModel(*model, drawList, *pbrShaders, meshletShaders, keywords, *renderQueue, res);
+
+    if (gpuTiming) {
+      res.mCmd->writeTimestamp(vk::PipelineStageFlagBits::eBottomOfPipe, res.mTimestamps, 1);
+    }
 
     res.mCmd->endRenderPass();
+
+    if (options.mCulling) {
+      culler->updateHiZ(
+          *res.mCmd, res.mRenderPass->getFramebuffer()->getImages()[1], viewProjection);
+    }
+
+    // The Swapchain expects the presented image to be a color attachment.
+    Illusion::Graphics::BackedImagePtr output = res.mRenderPass->getFramebuffer()->getImages()[0];
+    if (res.mPostProcessor) {
+      output = res.mPostProcessor->process(*res.mCmd, *res.mUniformData, output);
+      res.mCmd->transitionImage(output, vk::ImageLayout::eColorAttachmentOptimal,
+          vk::PipelineStageFlagBits::eColorAttachmentOutput,
+          vk::AccessFlagBits::eColorAttachmentWrite);
+    }
+
     res.mCmd->end();
 
-    res.mCmd->submit({}, {}, {*res.mRenderFinishedSemaphore});
+    if (window) {
+      res.mCmd->submit({}, {}, {*res.mRenderFinishedSemaphore});
+      window->present(output, res.mRenderFinishedSemaphore, res.mRenderFinishedFence);
+    } else {
+      res.mCmd->submit({}, {}, {}, *res.mRenderFinishedFence);
+    }
 
-    window->present(res.mRenderPass->getFramebuffer()->getImages()[0], res.mRenderFinishedSemaphore,
-        res.mRenderFinishedFence);
+    fpsCounter.addCpuTime((frameTimer.getElapsed() - fenceTime) * 1000.0);
+    fpsCounter.step();
 
-    std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    if (options.mFrames > 0) {
+      ++frame;
+    } else {
+      std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    }
   }
 
   device->waitIdle();
 
+  if (options.mFrames > 0) {
+    for (int i = 0; i < 2; ++i) {
+      readGpuTime(frameResources.next());
+    }
+
+    ILLUSION_MESSAGE << "Rendered " << frame << " frames." << std::endl;
+    using Channel = Illusion::Core::FPSCounter::Channel;
+    printStatistics("CPU frame time", fpsCounter.getStatistics(Channel::eCpuTime));
+    printStatistics("GPU frame time", fpsCounter.getStatistics(Channel::eGpuTime));
+    printStatistics("Present interval", fpsCounter.getStatistics(Channel::ePresentInterval));
+    ILLUSION_MESSAGE << "Hitches: " << fpsCounter.getHitchCount() << std::endl;
+  }
+
+  if (!options.mPipelineManifestFile.empty()) {
+    device->getPipelineCache()->saveManifest(options.mPipelineManifestFile);
+  }
+
   return 0;
 }
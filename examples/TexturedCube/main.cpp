@@ -7,10 +7,10 @@
 ////////////////////////////////////////////////////////////////////////////////////////////////////
 
 #include <Illusion/Core/Logger.hpp>
-#include <Illusion/Core/RingBuffer.hpp>
 #include <Illusion/Core/Timer.hpp>
 #include <Illusion/Graphics/CoherentUniformBuffer.hpp>
 #include <Illusion/Graphics/CommandBuffer.hpp>
+#include <Illusion/Graphics/FrameContext.hpp>
 #include <Illusion/Graphics/Instance.hpp>
 #include <Illusion/Graphics/RenderPass.hpp>
 #include <Illusion/Graphics/Shader.hpp>
@@ -22,9 +22,9 @@
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////
 // When compared to the ShaderSandbox example, this example is a bit more involved in several     //
-// ways. On the one hand, we use actual vertex and index buffers, on the other, we use a set of   //
-// per-frame resources so that we can start recording the next frame while the last one is still  //
-// being processed.                                                                               //
+// ways. On the one hand, we use actual vertex and index buffers, on the other, we use a          //
+// FrameContext with per-frame resources so that we can start recording the next frame while the  //
+// last one is still being processed.                                                             //
 ////////////////////////////////////////////////////////////////////////////////////////////////////
 
 // clang-format off
@@ -60,50 +60,6 @@ const std::array<uint32_t, 36> INDICES = {
 };
 // clang-format on
 
-////////////////////////////////////////////////////////////////////////////////////////////////////
-// This struct contains all resources we will need for one frame. While one frame is processed by //
-// the GPU, we will acquire a instance of FrameResources and work with that one. We will store    //
-// the FrameResources in a ring-buffer and re-use older FrameResources after some frames when the //
-// GPU is likely to be finished processing it anyways.                                            //
-// The FrameResources contain a command buffer, a render pass, a uniform buffer (for the          //
-// projection matrix), a semaphore indicating when rendering has finished and the frame buffer is //
-// ready for presentation and a fence telling us when the FrameResources are ready to be re-used. //
-////////////////////////////////////////////////////////////////////////////////////////////////////
-
-struct FrameResources {
-  FrameResources(Illusion::Graphics::DevicePtr const& device)
-      : mCmd(Illusion::Graphics::CommandBuffer::create(device))
-      , mRenderPass(Illusion::Graphics::RenderPass::create(device))
-      , mUniformBuffer(Illusion::Graphics::CoherentUniformBuffer::create(device, sizeof(glm::mat4)))
-      , mFrameFinishedFence(device->createFence())
-      , mRenderFinishedSemaphore(device->createSemaphore()) {
-
-    // In addition to a color buffer we will need a depth buffer for depth testing.
-    mRenderPass->addAttachment(vk::Format::eR8G8B8A8Unorm);
-    mRenderPass->addAttachment(vk::Format::eD32Sfloat);
-
-    // The indices are provided as a triangle list
-    mCmd->graphicsState().setTopology(vk::PrimitiveTopology::eTriangleList);
-
-    // Here we define what kind of vertex buffers will be bound. The vertex data (positions, normals
-    // and texture coordinates) actually comes from three different vertex buffer objects.
-    mCmd->graphicsState().setVertexInputBindings(
-        {{0, sizeof(glm::vec3), vk::VertexInputRate::eVertex},
-            {1, sizeof(glm::vec3), vk::VertexInputRate::eVertex},
-            {2, sizeof(glm::vec2), vk::VertexInputRate::eVertex}});
-
-    // Here we define which vertex attribute comes from which vertex buffer.
-    mCmd->graphicsState().setVertexInputAttributes({{0, 0, vk::Format::eR32G32B32Sfloat, 0},
-        {1, 1, vk::Format::eR32G32B32Sfloat, 0}, {2, 2, vk::Format::eR32G32Sfloat, 0}});
-  }
-
-  Illusion::Graphics::CommandBufferPtr         mCmd;
-  Illusion::Graphics::RenderPassPtr            mRenderPass;
-  Illusion::Graphics::CoherentUniformBufferPtr mUniformBuffer;
-  vk::FencePtr                                 mFrameFinishedFence;
-  vk::SemaphorePtr                             mRenderFinishedSemaphore;
-};
-
 ////////////////////////////////////////////////////////////////////////////////////////////////////
 
 int main() {
@@ -126,12 +82,24 @@ int main() {
   auto texcoordBuffer = device->createVertexBuffer(TEXCOORDS);
   auto indexBuffer    = device->createIndexBuffer(INDICES);
 
-  // Now we create a RingBuffer of FrameResources. We use only two entries in this example but you
-  // could change this number to whatever you like. Three or four could improve the performance in
-  // some cases, but this will use more memory and could also lead to some input lag. Usually two or
-  // three will be a could choice.
-  Illusion::Core::RingBuffer<FrameResources, 2> frameResources{
-      FrameResources(device), FrameResources(device)};
+  // Now we create a FrameContext. It contains a command buffer, a uniform buffer (for the
+  // projection matrix), a semaphore indicating when rendering has finished and a fence telling us
+  // when the resources are ready to be re-used for each frame in flight. We use only two frames in
+  // this example but you could use up to four. This could improve the performance in some cases,
+  // but this will use more memory and could also lead to some input lag.
+  auto frameContext = Illusion::Graphics::FrameContext::create(device, 2, sizeof(glm::mat4));
+
+  // The color attachment of a render pass is presented while the next frame is being rendered,
+  // hence we need one render pass for each frame in flight. In addition to a color buffer we will
+  // need a depth buffer for depth testing. It is not used after the render pass, so it can be
+  // transient.
+  std::vector<Illusion::Graphics::RenderPassPtr> renderPasses;
+  for (uint32_t i = 0; i < frameContext->getFrameCount(); ++i) {
+    auto renderPass = Illusion::Graphics::RenderPass::create(device);
+    renderPass->addAttachment(vk::Format::eR8G8B8A8Unorm);
+    renderPass->addAttachment(vk::Format::eD32Sfloat, true);
+    renderPasses.push_back(renderPass);
+  }
 
   // Use a timer to get the current system time at each frame.
   Illusion::Core::Timer timer;
@@ -146,28 +114,34 @@ int main() {
     // actually returns true when the user closed the window.
     window->update();
 
-    // First, we acquire the next FrameResources instance from our RingBuffer.
-    auto& res = frameResources.next();
-
-    // Then we have to wait until the GPU has finished processing the corresponding frame. Usually
-    // this should return instantly because, thanks to the RingBuffer there was at least one frame
-    // in between.
-    device->waitForFences(*res.mFrameFinishedFence);
-    device->resetFences(*res.mFrameFinishedFence);
+    // First, we begin the next frame. This waits until the GPU has finished processing the last
+    // frame which used the same resources. Usually this should return instantly, because there was
+    // at least one frame in between. Then the command buffer is reset and begun.
+    auto& res        = frameContext->beginFrame();
+    auto& renderPass = renderPasses[res.mSlot];
 
     // Get the current time for animations.
     float time = timer.getElapsed();
 
-    // As we are re-recording our command buffer, we have to reset it before starting to record new
-    // commands.
-    res.mCmd->reset();
-    res.mCmd->begin();
+    // The indices are provided as a triangle list
+    res.mCmd->graphicsState().setTopology(vk::PrimitiveTopology::eTriangleList);
+
+    // Here we define what kind of vertex buffers will be bound. The vertex data (positions, normals
+    // and texture coordinates) actually comes from three different vertex buffer objects.
+    res.mCmd->graphicsState().setVertexInputBindings(
+        {{0, sizeof(glm::vec3), vk::VertexInputRate::eVertex},
+            {1, sizeof(glm::vec3), vk::VertexInputRate::eVertex},
+            {2, sizeof(glm::vec2), vk::VertexInputRate::eVertex}});
+
+    // Here we define which vertex attribute comes from which vertex buffer.
+    res.mCmd->graphicsState().setVertexInputAttributes({{0, 0, vk::Format::eR32G32B32Sfloat, 0},
+        {1, 1, vk::Format::eR32G32B32Sfloat, 0}, {2, 2, vk::Format::eR32G32Sfloat, 0}});
 
     // Set the shader to be used.
     res.mCmd->setShader(shader);
 
     // Adapt the render pass and viewport sizes.
-    res.mRenderPass->setExtent(window->pExtent.get());
+    renderPass->setExtent(window->pExtent.get());
     res.mCmd->graphicsState().setViewports({{glm::vec2(window->pExtent.get())}});
 
     // Compute a projection matrix and write the data to our uniform buffer.
@@ -185,7 +159,7 @@ int main() {
     res.mCmd->bindingState().setTexture(texture, 1, 0);
 
     // Begin our render pass.
-    res.mCmd->beginRenderPass(res.mRenderPass);
+    res.mCmd->beginRenderPass(renderPass);
 
     // Compute a modelView matrix based on the simulation time (this makes th cube spin). Then
     // upload this matrix via push constants.
@@ -202,19 +176,13 @@ int main() {
     // Do the actual drawing.
     res.mCmd->drawIndexed(static_cast<uint32_t>(INDICES.size()), 1, 0, 0, 0);
 
-    // End the render pass and finish recording of the command buffer.
+    // End the render pass.
     res.mCmd->endRenderPass();
-    res.mCmd->end();
-
-    // Now we can just submit the command buffer. Once it has been processed, the
-    // renderFinishedSemaphore will be signaled.
-    res.mCmd->submit({}, {}, {*res.mRenderFinishedSemaphore});
 
-    // Present the color attachment of the render pass on the window. This operation will wait for
-    // the renderFinishedSemaphore and signal the frameFinishedFence so that we know when to start
-    // the next frame.
-    window->present(res.mRenderPass->getFramebuffer()->getImages()[0], res.mRenderFinishedSemaphore,
-        res.mFrameFinishedFence);
+    // Now we end the frame. This submits the command buffer and presents the color attachment of
+    // the render pass on the window once rendering has finished. Afterwards the fence of the frame
+    // will be signaled so that we know when we can re-use its resources.
+    frameContext->endFrame(window, renderPass->getFramebuffer()->getImages()[0]);
 
     // Prevent the GPU from over-heating :)
     std::this_thread::sleep_for(std::chrono::milliseconds(5));
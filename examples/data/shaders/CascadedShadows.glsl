@@ -0,0 +1,72 @@
+////////////////////////////////////////////////////////////////////////////////////////////////////
+//                                                                                                //
+//    _)  |  |            _)                This code may be used and modified under the terms    //
+//     |  |  |  |  | (_-<  |   _ \    \     of the MIT license. See the LICENSE file for details. //
+//    _| _| _| \_,_| ___/ _| \___/ _| _|    Copyright (c) 2018-2019 Simon Schneegans              //
+//                                                                                                //
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+// This file contains the shader side of the Gltf::ShadowMap. The ShadowMap binds its uniforms and
+// its depth image to two consecutive bindings of one descriptor set, by default these are the
+// bindings 7 and 8 of set 1. This can be changed by defining CASCADED_SHADOWS_SET and
+// CASCADED_SHADOWS_BINDING before including this file. getShadow() returns the fraction of light
+// which reaches a world space position; getLightDirection() points towards the light.
+
+#ifndef CASCADED_SHADOWS_SET
+#define CASCADED_SHADOWS_SET 1
+#endif
+
+#ifndef CASCADED_SHADOWS_BINDING
+#define CASCADED_SHADOWS_BINDING 7
+#endif
+
+// This matches the ShadowUniforms of the Gltf::ShadowMap. The following member is only used for
+// culling, it is not declared here.
+layout(set = CASCADED_SHADOWS_SET, binding = CASCADED_SHADOWS_BINDING) uniform ShadowUniforms {
+  mat4 mViewProjections[4];
+  vec4 mSplits;
+  vec4 mLightDirection;
+}
+shadowUniforms;
+
+layout(set = CASCADED_SHADOWS_SET,
+    binding = CASCADED_SHADOWS_BINDING + 1) uniform sampler2DArrayShadow uShadowMap;
+
+vec3 getLightDirection() {
+  return shadowUniforms.mLightDirection.xyz;
+}
+
+// The viewDepth is the positive distance to the camera along the viewing direction. The position
+// is moved along the normal by one texel of the cascade to avoid shadow acne on steep surfaces.
+// Each lookup of the comparison sampler filters four depth tests, so the 3x3 kernel below covers
+// 4x4 texels. Positions beyond the last cascade are not shadowed.
+float getShadow(vec3 position, vec3 normal, float viewDepth) {
+  int cascadeCount = int(shadowUniforms.mLightDirection.w);
+  int cascade      = 0;
+
+  while (cascade < cascadeCount && viewDepth > shadowUniforms.mSplits[cascade]) {
+    ++cascade;
+  }
+
+  if (cascade == cascadeCount) {
+    return 1.0;
+  }
+
+  mat4  viewProjection = shadowUniforms.mViewProjections[cascade];
+  vec2  texelSize      = 1.0 / vec2(textureSize(uShadowMap, 0).xy);
+  float worldTexel     = 2.0 * texelSize.x /
+                     length(vec3(viewProjection[0][0], viewProjection[1][0], viewProjection[2][0]));
+
+  vec4 p  = viewProjection * vec4(position + normal * worldTexel, 1.0);
+  vec2 uv = p.xy * 0.5 + 0.5;
+
+  float shadow = 0.0;
+
+  for (int y = -1; y <= 1; ++y) {
+    for (int x = -1; x <= 1; ++x) {
+      shadow += texture(uShadowMap, vec4(uv + vec2(x, y) * texelSize, cascade, p.z));
+    }
+  }
+
+  return shadow / 9.0;
+}
@@ -0,0 +1,89 @@
+////////////////////////////////////////////////////////////////////////////////////////////////////
+//                                                                                                //
+//    _)  |  |            _)                This code may be used and modified under the terms    //
+//     |  |  |  |  | (_-<  |   _ \    \     of the MIT license. See the LICENSE file for details. //
+//    _| _| _| \_,_| ___/ _| \___/ _| _|    Copyright (c) 2018-2019 Simon Schneegans              //
+//                                                                                                //
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+// This file contains the shader side of the Graphics::LightClusterer. The LightClusterer binds its
+// data to four consecutive bindings of one descriptor set, by default these are the bindings 3 to
+// 6 of set 1. This can be changed by defining CLUSTERED_LIGHTS_SET and CLUSTERED_LIGHTS_BINDING
+// before including this file. getClusterIndex() returns the cluster of a fragment, its lights can
+// be iterated like this:
+//
+// uint cluster = getClusterIndex(gl_FragCoord.xy, viewDepth);
+// for (uint i = 0; i < getLightCount(cluster); ++i) {
+//   PointLight light = getLight(cluster, i);
+//   ...
+// }
+
+#ifndef CLUSTERED_LIGHTS_SET
+#define CLUSTERED_LIGHTS_SET 1
+#endif
+
+#ifndef CLUSTERED_LIGHTS_BINDING
+#define CLUSTERED_LIGHTS_BINDING 3
+#endif
+
+// This has to match LightClusterer::MAX_LIGHTS_PER_CLUSTER.
+const uint MAX_LIGHTS_PER_CLUSTER = 128;
+
+// This matches the LightClusterer::PointLight struct.
+struct PointLight {
+  vec3  mPosition;
+  float mRadius;
+  vec3  mColor;
+  float mIntensity;
+};
+
+layout(set = CLUSTERED_LIGHTS_SET, binding = CLUSTERED_LIGHTS_BINDING) uniform ClusterUniforms {
+  mat4  mViewMatrix;
+  mat4  mInverseProjection;
+  uvec4 mGridSize;
+  vec4  mDepthSlicing;
+  vec2  mExtent;
+  uint  mLightCount;
+}
+clusterUniforms;
+
+layout(set = CLUSTERED_LIGHTS_SET, binding = CLUSTERED_LIGHTS_BINDING + 1,
+    std430) readonly buffer Lights {
+  PointLight lights[];
+};
+
+layout(set = CLUSTERED_LIGHTS_SET, binding = CLUSTERED_LIGHTS_BINDING + 2,
+    std430) readonly buffer LightCounts {
+  uint lightCounts[];
+};
+
+layout(set = CLUSTERED_LIGHTS_SET, binding = CLUSTERED_LIGHTS_BINDING + 3,
+    std430) readonly buffer LightIndices {
+  uint lightIndices[];
+};
+
+// The viewDepth is the positive distance to the camera along the viewing direction.
+uint getClusterIndex(vec2 fragCoord, float viewDepth) {
+  uvec3 grid  = clusterUniforms.mGridSize.xyz;
+  uvec2 tile  = min(uvec2(fragCoord) / clusterUniforms.mGridSize.w, grid.xy - 1);
+  float slice = log(max(viewDepth, 1e-6)) * clusterUniforms.mDepthSlicing.x +
+                clusterUniforms.mDepthSlicing.y;
+  uint z = uint(clamp(slice, 0.0, float(grid.z - 1)));
+  return tile.x + grid.x * (tile.y + grid.y * z);
+}
+
+uint getLightCount(uint cluster) {
+  return lightCounts[cluster];
+}
+
+PointLight getLight(uint cluster, uint i) {
+  return lights[lightIndices[cluster * MAX_LIGHTS_PER_CLUSTER + i]];
+}
+
+// A smooth falloff which reaches zero at the radius of the light, see "Real Shading in Unreal
+// Engine 4" by Brian Karis.
+float getAttenuation(PointLight light, float distance) {
+  float ratio   = distance / light.mRadius;
+  float falloff = clamp(1.0 - ratio * ratio * ratio * ratio, 0.0, 1.0);
+  return falloff * falloff / (distance * distance + 1.0);
+}
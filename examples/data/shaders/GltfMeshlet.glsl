@@ -0,0 +1,90 @@
+////////////////////////////////////////////////////////////////////////////////////////////////////
+//                                                                                                //
+//    _)  |  |            _)                This code may be used and modified under the terms    //
+//     |  |  |  |  | (_-<  |   _ \    \     of the MIT license. See the LICENSE file for details. //
+//    _| _| _| \_,_| ___/ _| \___/ _| _|    Copyright (c) 2018-2019 Simon Schneegans              //
+//                                                                                                //
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+// This file contains the declarations which are shared by the task and mesh stages of the
+// GltfShader. These draw the Meshlets of a Gltf::Model (see Gltf::DrawList::drawMeshlets())
+// instead of the vertex stage; the fragment stage is the same as for the indexed draws.
+
+#extension GL_EXT_mesh_shader : require
+
+// The GltfShader uses four descriptor sets:
+// 0: Camera information
+// 1: BRDF textures (BRDFLuT + filtered environment textures)
+// 2: Model information, this is the instance data of the Gltf::DrawList and the joint matrices.
+//    For Meshlets, this contains the meshlet buffers and the vertex buffer of the Model as well.
+// 3: Material information, this is only textures since all other values are part of the instances
+
+layout(set = 0, binding = 0) uniform CameraUniforms {
+  vec4 mPosition;
+  mat4 mViewMatrix;
+  mat4 mProjectionMatrix;
+}
+camera;
+
+// This matches the Gltf::DrawList::Instance struct.
+struct Instance {
+  mat4 mModelMatrix;
+  int  mMaterialIndex;
+  int  mVertexAttributes;
+  int  mJointOffset;
+  int  mPadding;
+};
+
+// This matches the MeshOptimizer::Meshlet struct.
+struct Meshlet {
+  vec3  mCenter;
+  float mRadius;
+  vec3  mConeAxis;
+  float mConeCutoff;
+  uint  mVertexOffset;
+  uint  mTriangleOffset;
+  uint  mVertexCount;
+  uint  mTriangleCount;
+};
+
+layout(set = 2, binding = 0, std430) readonly buffer Instances {
+  Instance instances[];
+};
+
+layout(set = 2, binding = 2, std430) readonly buffer Meshlets {
+  Meshlet meshlets[];
+};
+
+layout(set = 2, binding = 3, std430) readonly buffer MeshletVertices {
+  uint meshletVertices[];
+};
+
+layout(set = 2, binding = 4, std430) readonly buffer MeshletTriangles {
+  uint meshletTriangles[];
+};
+
+// The vertex buffer of the Model is read as raw 32 bit words. They are decoded by GltfShader.mesh
+// or GltfShaderCompact.mesh, depending on the vertex layout.
+layout(set = 2, binding = 5, std430) readonly buffer Vertices {
+  uint vertices[];
+};
+
+// This matches the Gltf::DrawList::MeshletDraw struct. There are
+// ceil(mMeshletCount / MESHLETS_PER_TASK) x mInstanceCount task shader workgroups per draw.
+layout(push_constant, std430) uniform PushConstants {
+  uint mFirstMeshlet;
+  uint mMeshletCount;
+  int  mVertexOffset;
+  uint mFirstInstance;
+  uint mInstanceCount;
+}
+draw;
+
+// This has to match Gltf::DrawList::MESHLETS_PER_TASK.
+#define MESHLETS_PER_TASK 32
+
+// Each task shader workgroup launches one mesh shader workgroup for each of its visible Meshlets.
+struct Payload {
+  uint mInstance;
+  uint mMeshlets[MESHLETS_PER_TASK];
+};
@@ -0,0 +1,61 @@
+////////////////////////////////////////////////////////////////////////////////////////////////////
+//                                                                                                //
+//    _)  |  |            _)                This code may be used and modified under the terms    //
+//     |  |  |  |  | (_-<  |   _ \    \     of the MIT license. See the LICENSE file for details. //
+//    _| _| _| \_,_| ___/ _| \___/ _| _|    Copyright (c) 2018-2019 Simon Schneegans              //
+//                                                                                                //
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+// This file contains everything of the GltfShader's mesh stage which does not depend on the vertex
+// layout. It is included by GltfShader.mesh and GltfShaderCompact.mesh; these have to declare the
+// functions getPosition(), getNormal() and getTexcoords() which read a vertex from the vertex
+// buffer of the Model.
+// Each workgroup outputs one Meshlet. The outputs are the same as those of GltfVertex.glsl, so
+// GltfShader.frag can be used. Meshlets are only built for Primitives without skins and morph
+// targets, hence HAS_SKINS is never used.
+
+layout(local_size_x = 32) in;
+layout(triangles, max_vertices = 64, max_primitives = 124) out;
+
+taskPayloadSharedEXT Payload payload;
+
+layout(location = 0) out vec3 vPosition[];
+layout(location = 1) out vec3 vNormal[];
+layout(location = 2) out vec2 vTexcoords[];
+layout(location = 3) flat out int vInstance[];
+
+void main() {
+  Meshlet meshlet  = meshlets[payload.mMeshlets[gl_WorkGroupID.x]];
+  uint    instance = payload.mInstance;
+
+  mat4 modelMatrix    = instances[instance].mModelMatrix;
+  mat4 viewProjection = camera.mProjectionMatrix * camera.mViewMatrix;
+
+  SetMeshOutputsEXT(meshlet.mVertexCount, meshlet.mTriangleCount);
+
+  for (uint i = gl_LocalInvocationIndex; i < meshlet.mVertexCount; i += 32) {
+    uint v = uint(draw.mVertexOffset) + meshletVertices[meshlet.mVertexOffset + i];
+
+    vPosition[i] = (modelMatrix * vec4(getPosition(v), 1.0)).xyz;
+    vInstance[i] = int(instance);
+
+#ifdef HAS_NORMALS
+    vNormal[i] = inverse(transpose(mat3(modelMatrix))) * getNormal(v);
+#else
+    vNormal[i] = vec3(0.0);
+#endif
+
+#ifdef HAS_TEXCOORDS
+    vTexcoords[i] = getTexcoords(v);
+#else
+    vTexcoords[i] = vec2(0.0);
+#endif
+
+    gl_MeshVerticesEXT[i].gl_Position = viewProjection * vec4(vPosition[i], 1.0);
+  }
+
+  for (uint i = gl_LocalInvocationIndex; i < meshlet.mTriangleCount; i += 32) {
+    uint t = meshletTriangles[meshlet.mTriangleOffset + i];
+    gl_PrimitiveTriangleIndicesEXT[i] = uvec3(t & 0xff, (t >> 8) & 0xff, (t >> 16) & 0xff);
+  }
+}
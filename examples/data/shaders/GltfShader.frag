@@ -14,25 +14,57 @@
 layout(location = 0) in vec3 vPosition;
 layout(location = 1) in vec3 vNormal;
 layout(location = 2) in vec2 vTexcoords;
+layout(location = 3) flat in int vInstance;
 
 // The GltfShader uses four descriptor sets:
 // 0: Camera information
-// 1: BRDF textures (BRDFLuT + filtered environment textures)
-// 2: Model information, in this case the joint matrices
-// 3: Material information, this is only textures since all other values are set via push constants
+// 1: BRDF textures (BRDFLuT + filtered environment textures), the clustered lights and the shadows
+// 2: Model information, this is the instance data of the Gltf::DrawList, the joint matrices and
+//    the factors of all Materials of the Gltf::Model
+// 3: Material information, this is only textures since the factors are stored in set 2
 
+// With MULTIVIEW, the RenderPass has a view mask and this is drawn once for each eye. The uniform
+// buffer contains both cameras and gl_ViewIndex selects the current one.
+#ifdef MULTIVIEW
+#extension GL_EXT_multiview : require
+
+struct Camera {
+  vec4 mPosition;
+  mat4 mViewMatrix;
+  mat4 mProjectionMatrix;
+};
+
+layout(set = 0, binding = 0) uniform CameraUniforms {
+  Camera cameras[2];
+};
+
+#define camera cameras[gl_ViewIndex]
+#else
 layout(set = 0, binding = 0) uniform CameraUniforms {
   vec4 mPosition;
   mat4 mViewMatrix;
   mat4 mProjectionMatrix;
 }
 camera;
+#endif
 
 // BRDF textures
 layout(set = 1, binding = 0) uniform sampler2D uBRDFLuT;
 layout(set = 1, binding = 1) uniform samplerCube uPrefilteredIrradiance;
 layout(set = 1, binding = 2) uniform samplerCube uPrefilteredReflection;
 
+// Point lights which have been binned by the Graphics::LightClusterer, these use the bindings 3 to
+// 6 of set 1.
+#ifdef CLUSTERED_LIGHTS
+#include "ClusteredLights.glsl"
+#endif
+
+// The cascaded shadow map of the sun which has been rendered by the Gltf::ShadowMap, this uses the
+// bindings 7 and 8 of set 1.
+#ifdef SHADOWS
+#include "CascadedShadows.glsl"
+#endif
+
 // Material textures. These are always set, even if the Gltf::Model actually does not have a
 // corresponding texture. In this case, a default 1x1 pixel texture will be used.
 layout(set = 3, binding = 0) uniform sampler2D uAlbedoTexture;
@@ -41,14 +73,26 @@ layout(set = 3, binding = 2) uniform sampler2D mNormalTexture;
 layout(set = 3, binding = 3) uniform sampler2D uOcclusionTexture;
 layout(set = 3, binding = 4) uniform sampler2D uEmissiveTexture;
 
-// These three bits are potentially set in the mVertexAttributes member of the push constants. Use
-// them in order to know which vertex attributes are actually set.
-const int HAS_NORMALS   = 1 << 0;
-const int HAS_TEXCOORDS = 1 << 1;
-const int HAS_SKINS     = 1 << 2;
-
-layout(push_constant, std430) uniform PushConstants {
-  mat4  mModelMatrix;
+// The ShaderVariants of the GltfViewer define HAS_NORMALS, HAS_TEXCOORDS and HAS_SKINS depending
+// on the vertex attributes of the drawn Gltf::DrawList::Batch. These correspond to the bits of the
+// mVertexAttributes member of the instances. CLUSTERED_LIGHTS is defined if point lights are used,
+// SHADOWS if the model is lit by a sun which casts shadows.
+
+// This matches the Gltf::DrawList::Instance struct.
+struct Instance {
+  mat4 mModelMatrix;
+  int  mMaterialIndex;
+  int  mVertexAttributes;
+  int  mJointOffset;
+  int  mPadding;
+};
+
+layout(set = 2, binding = 0, std430) readonly buffer Instances {
+  Instance instances[];
+};
+
+// This matches the Gltf::Material::Parameters struct.
+struct Material {
   vec4  mAlbedoFactor;
   vec3  mEmissiveFactor;
   bool  mSpecularGlossinessWorkflow;
@@ -56,9 +100,12 @@ layout(push_constant, std430) uniform PushConstants {
   float mNormalScale;
   float mOcclusionStrength;
   float mAlphaCutoff;
-  int   mVertexAttributes;
-}
-pushConstants;
+};
+
+// The binding 6 is used as the bindings in between are used by the mesh shaders.
+layout(set = 2, binding = 6, std430) readonly buffer Materials {
+  Material materials[];
+};
 
 // outputs
 layout(location = 0) out vec4 outColor;
@@ -178,11 +225,13 @@ float convertMetallic(vec3 diffuse, vec3 specular, float maxSpecular) {
 }
 
 void main() {
+  Material material = materials[instances[vInstance].mMaterialIndex];
+
   // Get base color, converted to linear space
-  vec4 albedo = sRGBtoLinear(texture(uAlbedoTexture, vTexcoords)) * pushConstants.mAlbedoFactor;
+  vec4 albedo = sRGBtoLinear(texture(uAlbedoTexture, vTexcoords)) * material.mAlbedoFactor;
 
   // Discard if below alpha threshold. mAlphaCutoff will be set to zero if this feature is disabled.
-  if (albedo.a < pushConstants.mAlphaCutoff) {
+  if (albedo.a < material.mAlphaCutoff) {
     discard;
   }
 
@@ -191,17 +240,17 @@ void main() {
 
   // Compute surface normal. This is either provided as vertex attribute or computed via the local
   // derivation of the world space positions.
-  vec3 normal;
-  if ((pushConstants.mVertexAttributes & HAS_NORMALS) > 0) {
-    normal = normalize(vNormal);
-  } else {
-    normal = normalize(cross(dFdy(vPosition), dFdx(vPosition)));
-  }
+#ifdef HAS_NORMALS
+  vec3 normal = normalize(vNormal);
+#else
+  vec3 normal = normalize(cross(dFdy(vPosition), dFdx(vPosition)));
+#endif
 
   // If we have texture coordinates we can use the normal map to disturb this normal
-  if ((pushConstants.mVertexAttributes & HAS_TEXCOORDS) > 0) {
+#ifdef HAS_TEXCOORDS
+  {
     vec3 tangentNormal = texture(mNormalTexture, vTexcoords).rgb * 2.0 - 1.0;
-    tangentNormal.xy *= pushConstants.mNormalScale;
+    tangentNormal.xy *= material.mNormalScale;
 
     // Flip normal and tangent space for back faces
     if (dot(normal, viewDir) < 0) {
@@ -212,13 +261,14 @@ void main() {
     }
     normal = perturbNormal(normal, tangentNormal, vPosition, vTexcoords);
   }
+#endif
 
   // Compute the metallic and roughness values. They are either provided by the material
   // (metallic-roughness workflow) or have to be computed (specular-glossiness workflow).
   float roughness = 1.0;
   float metallic  = 1.0;
 
-  if (pushConstants.mSpecularGlossinessWorkflow) {
+  if (material.mSpecularGlossinessWorkflow) {
 
     // Convert roughness value from specular glossiness inputs
     roughness = 1.0 - texture(mMetallicRoughnessTexture, vTexcoords).a;
@@ -232,16 +282,16 @@ void main() {
     const float e = 1e-6;
 
     vec3 baseColorDiffuse = albedo.rgb * ((1.0 - maxSpecular) / (1 - 0.04) / max(1 - metallic, e)) *
-                            pushConstants.mAlbedoFactor.rgb;
+                            material.mAlbedoFactor.rgb;
 
     vec3 baseColorSpecular = specular - (vec3(0.04) * (1 - metallic) * (1 / max(metallic, e))) *
-                                            pushConstants.mMetallicRoughnessFactor.rgb;
+                                            material.mMetallicRoughnessFactor.rgb;
 
     albedo = vec4(mix(baseColorDiffuse, baseColorSpecular, metallic * metallic), albedo.a);
 
   } else {
     vec3 metallicRoughness =
-        texture(mMetallicRoughnessTexture, vTexcoords).rgb * pushConstants.mMetallicRoughnessFactor;
+        texture(mMetallicRoughnessTexture, vTexcoords).rgb * material.mMetallicRoughnessFactor;
     roughness = clamp(metallicRoughness.g, 0.04, 1);
     metallic  = clamp(metallicRoughness.b, 0, 1);
   }
@@ -251,26 +301,62 @@ void main() {
 
   vec3 f0 = mix(vec3(0.04), albedo.rgb, metallic);
 
-  // Add direct lighting
-  // vec3 lightDir = normalize(vec3(0, 1, 1));
-  // outColor.rgb += directLighting(lightDir, viewDir, normal, f0, albedo.rgb, metallic,
-  // roughness);
+  // Add direct lighting of the sun
+#ifdef SHADOWS
+  {
+    const float sunIntensity = 3.0;
+
+    float viewDepth = -(camera.mViewMatrix * vec4(vPosition, 1.0)).z;
+    float shadow    = getShadow(vPosition, normal, viewDepth);
+
+    if (shadow > 0.0) {
+      outColor.rgb += directLighting(getLightDirection(), viewDir, normal, f0, albedo.rgb, metallic,
+                          roughness) *
+                      shadow * sunIntensity;
+    }
+  }
+#endif
 
   // Add image based lighting
   outColor.rgb += imageBasedLighting(viewDir, normal, f0, albedo.rgb, metallic, roughness);
 
+  // Add the point lights of the cluster of this fragment
+#ifdef CLUSTERED_LIGHTS
+  {
+    float viewDepth = -(camera.mViewMatrix * vec4(vPosition, 1.0)).z;
+    uint  cluster   = getClusterIndex(gl_FragCoord.xy, viewDepth);
+
+    for (uint i = 0; i < getLightCount(cluster); ++i) {
+      PointLight light    = getLight(cluster, i);
+      vec3       toLight  = light.mPosition - vPosition;
+      float      distance = length(toLight);
+
+      if (distance < light.mRadius) {
+        vec3 lightDir = toLight / distance;
+        outColor.rgb += directLighting(lightDir, viewDir, normal, f0, albedo.rgb, metallic,
+                            roughness) *
+                        light.mColor * light.mIntensity * getAttenuation(light, distance);
+      }
+    }
+  }
+#endif
+
   // Apply occlusion
   outColor.rgb *=
-      mix(1.0, texture(uOcclusionTexture, vTexcoords).r, pushConstants.mOcclusionStrength);
+      mix(1.0, texture(uOcclusionTexture, vTexcoords).r, material.mOcclusionStrength);
 
   // Add emissive color
   outColor.rgb +=
-      sRGBtoLinear(texture(uEmissiveTexture, vTexcoords)).rgb * pushConstants.mEmissiveFactor;
+      sRGBtoLinear(texture(uEmissiveTexture, vTexcoords)).rgb * material.mEmissiveFactor;
 
+  // With HDR_OUTPUT, tone mapping and gamma correction are done by a PostProcessor
+#ifndef HDR_OUTPUT
   // Apply tone mapping
   outColor.rgb = Uncharted2Tonemap(outColor.rgb, 2);
 
   // Apply gamma correction
-  outColor   = linearToSRGB(outColor);
+  outColor = linearToSRGB(outColor);
+#endif
+
   outColor.a = albedo.a;
 }
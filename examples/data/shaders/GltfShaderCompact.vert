@@ -0,0 +1,37 @@
+////////////////////////////////////////////////////////////////////////////////////////////////////
+//                                                                                                //
+//    _)  |  |            _)                This code may be used and modified under the terms    //
+//     |  |  |  |  | (_-<  |   _ \    \     of the MIT license. See the LICENSE file for details. //
+//    _| _| _| \_,_| ___/ _| \___/ _| _|    Copyright (c) 2018-2019 Simon Schneegans              //
+//                                                                                                //
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#version 450
+
+// This is used for Gltf::Models which have been loaded with LoadOptionBits::eCompactVertices. The
+// normals are octahedron-encoded, the texture coordinates are half floats and the joints and
+// weights are read from a separate stream. See Gltf::CompactVertex and Gltf::SkinVertex.
+
+layout(location = 0) in vec3  inPosition;
+layout(location = 1) in vec2  inNormal;
+layout(location = 2) in vec2  inTexcoords;
+layout(location = 3) in uvec4 inJoint;
+layout(location = 4) in vec4  inWeight;
+
+vec3 getNormal() {
+  vec3 n = vec3(inNormal, 1.0 - abs(inNormal.x) - abs(inNormal.y));
+  if (n.z < 0.0) {
+    n.xy = (1.0 - abs(n.yx)) * vec2(n.x >= 0.0 ? 1.0 : -1.0, n.y >= 0.0 ? 1.0 : -1.0);
+  }
+  return normalize(n);
+}
+
+vec4 getJoint() {
+  return vec4(inJoint);
+}
+
+vec4 getWeight() {
+  return inWeight;
+}
+
+#include "GltfVertex.glsl"
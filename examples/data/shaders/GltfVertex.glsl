@@ -0,0 +1,109 @@
+////////////////////////////////////////////////////////////////////////////////////////////////////
+//                                                                                                //
+//    _)  |  |            _)                This code may be used and modified under the terms    //
+//     |  |  |  |  | (_-<  |   _ \    \     of the MIT license. See the LICENSE file for details. //
+//    _| _| _| \_,_| ___/ _| \___/ _| _|    Copyright (c) 2018-2019 Simon Schneegans              //
+//                                                                                                //
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+// This file contains everything of the GltfShader's vertex stage which does not depend on the
+// vertex layout. It is included by GltfShader.vert and GltfShaderCompact.vert; these have to
+// declare the vertex inputs and the functions getNormal(), getJoint() and getWeight().
+
+// The GltfShader uses four descriptor sets:
+// 0: Camera information
+// 1: BRDF textures (BRDFLuT + filtered environment textures)
+// 2: Model information, this is the instance data of the Gltf::DrawList and the joint matrices
+// 3: Material information, this is only textures since all other values are part of the instances
+
+// With MULTIVIEW, the RenderPass has a view mask and this is drawn once for each eye. The uniform
+// buffer contains both cameras and gl_ViewIndex selects the current one.
+#ifdef MULTIVIEW
+#extension GL_EXT_multiview : require
+
+struct Camera {
+  vec4 mPosition;
+  mat4 mViewMatrix;
+  mat4 mProjectionMatrix;
+};
+
+layout(set = 0, binding = 0) uniform CameraUniforms {
+  Camera cameras[2];
+};
+
+#define camera cameras[gl_ViewIndex]
+#else
+layout(set = 0, binding = 0) uniform CameraUniforms {
+  vec4 mPosition;
+  mat4 mViewMatrix;
+  mat4 mProjectionMatrix;
+}
+camera;
+#endif
+
+// This matches the Gltf::DrawList::Instance struct. The primitives are drawn indirectly and the
+// firstInstance of each draw command is the index of its instance.
+struct Instance {
+  mat4 mModelMatrix;
+  int  mMaterialIndex;
+  int  mVertexAttributes;
+  int  mJointOffset;
+  int  mPadding;
+};
+
+layout(set = 2, binding = 0, std430) readonly buffer Instances {
+  Instance instances[];
+};
+
+layout(set = 2, binding = 1, std430) readonly buffer JointMatrices {
+  mat4 jointMatrices[];
+};
+
+// The ShaderVariants of the GltfViewer define HAS_NORMALS, HAS_TEXCOORDS and HAS_SKINS depending
+// on the vertex attributes of the drawn Gltf::DrawList::Batch. These correspond to the bits of the
+// mVertexAttributes member of the instances.
+
+// Texture coordinates, world space positions and normals are passed to the fragment shader.
+layout(location = 0) out vec3 vPosition;
+layout(location = 1) out vec3 vNormal;
+layout(location = 2) out vec2 vTexcoords;
+layout(location = 3) flat out int vInstance;
+
+void main() {
+
+  // just forward the texture coordinates and the instance index
+  vTexcoords = inTexcoords;
+  vInstance  = gl_InstanceIndex;
+
+  Instance instance = instances[gl_InstanceIndex];
+
+  // compute the skin matrix and multiply it with the model matrix if the model is skinned
+  mat4 modelMatrix = instance.mModelMatrix;
+
+#ifdef HAS_SKINS
+  {
+    int  o       = instance.mJointOffset;
+    vec4 joint   = getJoint();
+    vec4 weight  = getWeight();
+    mat4 skinMat = weight.x * jointMatrices[o + int(joint.x)] +
+                   weight.y * jointMatrices[o + int(joint.y)] +
+                   weight.z * jointMatrices[o + int(joint.z)] +
+                   weight.w * jointMatrices[o + int(joint.w)];
+
+    modelMatrix = modelMatrix * skinMat;
+  }
+#endif
+
+  // transform to world space
+  vPosition = (modelMatrix * vec4(inPosition, 1.0)).xyz;
+
+  // if there are normals, transform the to world space as well
+#ifdef HAS_NORMALS
+  vNormal = inverse(transpose(mat3(modelMatrix))) * getNormal();
+#else
+  vNormal = vec3(0.0);
+#endif
+
+  // transform to projection space
+  gl_Position = camera.mProjectionMatrix * camera.mViewMatrix * vec4(vPosition, 1.0);
+}
@@ -14,12 +14,30 @@
 layout(location = 0) in vec2 vTexcoords;
 
 // uniforms
+// With MULTIVIEW, the RenderPass has a view mask and the skybox is drawn for each eye. The uniform
+// buffer contains both cameras and gl_ViewIndex selects the current one.
+#ifdef MULTIVIEW
+#extension GL_EXT_multiview : require
+
+struct Camera {
+  vec4 mPosition;
+  mat4 mViewMatrix;
+  mat4 mProjectionMatrix;
+};
+
+layout(set = 0, binding = 0) uniform CameraUniforms {
+  Camera cameras[2];
+};
+
+#define camera cameras[gl_ViewIndex]
+#else
 layout(set = 0, binding = 0) uniform CameraUniforms {
   vec4 mPosition;
   mat4 mViewMatrix;
   mat4 mProjectionMatrix;
 }
 camera;
+#endif
 
 layout(set = 1, binding = 0) uniform samplerCube texEnvironmentMap;
 
@@ -37,9 +55,11 @@ void main() {
   // into the input cubemap
   outColor = texture(texEnvironmentMap, normalize((farPos - camera.mPosition).xyz));
 
+#ifndef HDR_OUTPUT
   // Tone mapping
   outColor.rgb = Uncharted2Tonemap(outColor.rgb, 2);
 
   // Gamma correction
   outColor = linearToSRGB(outColor);
+#endif
 }
@@ -9,14 +9,23 @@
 #ifndef ILLUSION_CORE_ANIMATED_PROPERTY_HPP
 #define ILLUSION_CORE_ANIMATED_PROPERTY_HPP
 
+#include "ChangeBatch.hpp"
 #include "Property.hpp"
 
 #include <glm/glm.hpp>
 
+#include <algorithm>
+#include <limits>
+#include <unordered_set>
+
 namespace Illusion::Core {
 
+template <typename T>
+class Animator;
+
 ////////////////////////////////////////////////////////////////////////////////////////////////////
-// A class for smooth value interpolation.                                                        //
+// A class for smooth value interpolation. Each AnimatedProperty can be advanced with update(),   //
+// or many of them can be added to an Animator, which advances all of them at once.               //
 ////////////////////////////////////////////////////////////////////////////////////////////////////
 
 enum class AnimationDirection { eIn, eOut, eInOut, eOutIn, eLinear };
@@ -60,12 +69,51 @@ class AnimatedProperty : public Property<T> {
       , mEnd(end) {
   }
 
+  // A copy takes over the value and the animation state, but it is not added to the Animator of
+  // the original. As these are user-declared, moving an AnimatedProperty copies it as well.
+  AnimatedProperty(AnimatedProperty const& other)
+      : Property<T>(other)
+      , mDirection(other.mDirection)
+      , mLoop(other.mLoop)
+      , mDuration(other.mDuration)
+      , mExponent(other.mExponent)
+      , mDelay(other.mDelay)
+      , mStart(other.mStart)
+      , mEnd(other.mEnd)
+      , mState(other.mState) {
+  }
+
+  // The assigned AnimatedProperty stays in its own Animator (if any), which continues the copied
+  // animation.
+  AnimatedProperty& operator=(AnimatedProperty const& other) {
+    if (this != &other) {
+      mDirection = other.mDirection;
+      mLoop      = other.mLoop;
+      mDuration  = other.mDuration;
+      mExponent  = other.mExponent;
+      mDelay     = other.mDelay;
+      mStart     = other.mStart;
+      mEnd       = other.mEnd;
+      mState     = other.mState;
+      Property<T>::set(other.get());
+      sync();
+    }
+    return *this;
+  }
+
+  virtual ~AnimatedProperty() {
+    if (mAnimator) {
+      mAnimator->remove(*this);
+    }
+  }
+
   void set(T const& value, double dur, double del = 0.0) {
     mStart    = this->get();
     mEnd      = value;
     mDuration = dur;
     mState    = 0.0;
     mDelay    = del;
+    sync();
   }
 
   void set(T const& value) override {
@@ -74,10 +122,16 @@ class AnimatedProperty : public Property<T> {
     mDuration = 0.0;
     mState    = -1.0;
     mDelay    = 0.0;
+    sync();
     Property<T>::set(value);
   }
 
+  // This does nothing while the AnimatedProperty is added to an Animator.
   void update(double time) {
+    if (mAnimator) {
+      return;
+    }
+
     if (mDuration == 0.0 && mState != -1.0) {
       mState = 1.0;
     }
@@ -108,16 +162,7 @@ class AnimatedProperty : public Property<T> {
       }
     } else if (mState != -1.0) {
       Property<T>::set(mEnd);
-      mState = -1.0;
-      onFinish.emit();
-
-      if (mLoop == AnimationLoop::eRepeat) {
-        Property<T>::set(mStart);
-        set(mEnd, mDuration);
-
-      } else if (mLoop == AnimationLoop::eToggle) {
-        set(mStart, mDuration);
-      }
+      finish();
     }
   }
 
@@ -163,8 +208,255 @@ class AnimatedProperty : public Property<T> {
       return updateEaseIn(t * 2 - 1, s + (e - s) * 0.5f, e);
   }
 
+  // Called once the end value has been set.
+  void finish() {
+    mState = -1.0;
+    onFinish.emit();
+
+    if (mLoop == AnimationLoop::eRepeat) {
+      Property<T>::set(mStart);
+      set(mEnd, mDuration);
+
+    } else if (mLoop == AnimationLoop::eToggle) {
+      set(mStart, mDuration);
+    }
+  }
+
+  // Hands the current animation state over to the Animator, if there is one.
+  void sync() {
+    if (mAnimator) {
+      mAnimator->sync(*this);
+    }
+  }
+
   T      mStart, mEnd;
   double mState = 0.0;
+
+ private:
+  friend class Animator<T>;
+
+  Animator<T>* mAnimator     = nullptr;
+  int64_t      mAnimatorSlot = -1;
+};
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// An Animator advances all AnimatedProperties which have been added to it with one call to       //
+// update(), which is much cheaper than calling AnimatedProperty::update() for thousands of them. //
+// The state of all running animations is stored contiguously in one array per attribute, so the  //
+// progress and the easing of all of them are computed in tight loops over plain doubles. The new //
+// values are then set inside a ChangeBatch, hence each AnimatedProperty emits its Signals once   //
+// per update(), after all values have been written. Finished animations emit onFinish afterwards //
+// and leave the arrays, so idle AnimatedProperties cost nothing.                                 //
+// The duration, delay, direction and exponent of an animation are captured when it is started    //
+// with AnimatedProperty::set(); changing them in between has no effect on the running animation. //
+// An AnimatedProperty can only be added to one Animator at a time. Both can be destroyed in any  //
+// order, but an Animator is not thread-safe.                                                     //
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+template <typename T>
+class Animator {
+
+ public:
+  Animator() = default;
+
+  Animator(Animator const& other) = delete;
+  Animator& operator=(Animator const& other) = delete;
+
+  virtual ~Animator() {
+    for (auto property : mProperties) {
+      property->mAnimator     = nullptr;
+      property->mAnimatorSlot = -1;
+    }
+  }
+
+  // If the AnimatedProperty is already animating, the animation is continued by this Animator.
+  void add(AnimatedProperty<T>& property) {
+    if (property.mAnimator == this) {
+      return;
+    }
+
+    if (property.mAnimator) {
+      property.mAnimator->remove(property);
+    }
+
+    property.mAnimator = this;
+    mProperties.insert(&property);
+    sync(property);
+  }
+
+  void remove(AnimatedProperty<T>& property) {
+    if (property.mAnimator != this) {
+      return;
+    }
+
+    stop(property);
+    property.mAnimator = nullptr;
+    mProperties.erase(&property);
+  }
+
+  // Returns the number of AnimatedProperties which are currently animating.
+  size_t getActiveCount() const {
+    return mActive.size();
+  }
+
+  // Advances all running animations by the given time in seconds.
+  void update(double time) {
+    size_t count = mActive.size();
+
+    // advance the animations ----------------------------------------------------------------------
+    // The part of the time which exceeds the delay is used for the animation already.
+    for (size_t i = 0; i < count; ++i) {
+      double elapsed = std::max(time - mDelays[i], 0.0);
+      mDelays[i]     = std::max(mDelays[i] - time, 0.0);
+      mStates[i]     = std::min(mStates[i] + elapsed * mSteps[i], 1.0);
+    }
+
+    for (size_t i = 0; i < count; ++i) {
+      mFactors[i] = ease(mDirections[i], mExponents[i], mStates[i]);
+    }
+
+    for (size_t i = 0; i < count; ++i) {
+      mValues[i] = static_cast<T>(mStarts[i] + (mEnds[i] - mStarts[i]) * mFactors[i]);
+    }
+
+    // notify the AnimatedProperties ---------------------------------------------------------------
+    std::vector<AnimatedProperty<T>*> finished;
+
+    {
+      ChangeBatch batch;
+
+      for (size_t i = 0; i < count; ++i) {
+        auto property    = mActive[i];
+        property->mState = mStates[i];
+        property->mDelay = mDelays[i];
+        property->Property<T>::set(mValues[i]);
+
+        if (mStates[i] >= 1.0) {
+          finished.push_back(property);
+        }
+      }
+    }
+
+    // finish the animations -----------------------------------------------------------------------
+    // onFinish callbacks may remove or restart other AnimatedProperties, hence each of them is
+    // checked again before it is finished.
+    for (auto property : finished) {
+      if (mProperties.count(property) && property->mState >= 1.0) {
+        stop(*property);
+        property->finish();
+      }
+    }
+  }
+
+ private:
+  friend class AnimatedProperty<T>;
+
+  // Maps the progress in [0, 1] to the eased progress; this is the factor the AnimatedProperty
+  // methods apply to the difference of start and end value.
+  static double ease(AnimationDirection direction, double exponent, double t) {
+    auto easeIn  = [exponent](double x) { return x * x * ((exponent + 1) * x - exponent); };
+    auto easeOut = [exponent](double x) {
+      return (x - 1) * (x - 1) * ((exponent + 1) * (x - 1) + exponent) + 1;
+    };
+
+    switch (direction) {
+    case AnimationDirection::eIn:
+      return easeIn(t);
+    case AnimationDirection::eOut:
+      return easeOut(t);
+    case AnimationDirection::eInOut:
+      return t < 0.5 ? easeIn(t * 2) * 0.5 : 0.5 + easeOut(t * 2 - 1) * 0.5;
+    case AnimationDirection::eOutIn:
+      return t < 0.5 ? easeOut(t * 2) * 0.5 : 0.5 + easeIn(t * 2 - 1) * 0.5;
+    default:
+      return t;
+    }
+  }
+
+  // Starts, restarts or stops the animation of the property according to its current state.
+  void sync(AnimatedProperty<T>& property) {
+    if (property.mState < 0.0 || property.mState >= 1.0) {
+      stop(property);
+      return;
+    }
+
+    if (property.mAnimatorSlot < 0) {
+      property.mAnimatorSlot = static_cast<int64_t>(mActive.size());
+      mActive.push_back(&property);
+      mStarts.emplace_back();
+      mEnds.emplace_back();
+      mValues.emplace_back();
+      mStates.emplace_back();
+      mDelays.emplace_back();
+      mSteps.emplace_back();
+      mExponents.emplace_back();
+      mFactors.emplace_back();
+      mDirections.emplace_back();
+    }
+
+    // the numerical limit instead of infinity avoids 0 * inf for zero durations; animations
+    // without duration and delay are finished by the next update()
+    size_t slot       = static_cast<size_t>(property.mAnimatorSlot);
+    mStarts[slot]     = property.mStart;
+    mEnds[slot]       = property.mEnd;
+    mStates[slot]     = property.mDuration > 0.0 || property.mDelay > 0.0 ? property.mState : 1.0;
+    mDelays[slot]     = std::max(property.mDelay, 0.0);
+    mSteps[slot]      = property.mDuration > 0.0 ? 1.0 / property.mDuration
+                                                 : std::numeric_limits<double>::max();
+    mExponents[slot]  = property.mExponent;
+    mDirections[slot] = property.mDirection;
+  }
+
+  // Removes the animation of the property from the arrays by moving the last one to its slot.
+  void stop(AnimatedProperty<T>& property) {
+    if (property.mAnimatorSlot < 0) {
+      return;
+    }
+
+    size_t slot = static_cast<size_t>(property.mAnimatorSlot);
+    size_t last = mActive.size() - 1;
+
+    if (slot != last) {
+      mActive[slot]                = mActive[last];
+      mActive[slot]->mAnimatorSlot = static_cast<int64_t>(slot);
+      mStarts[slot]                = mStarts[last];
+      mEnds[slot]                  = mEnds[last];
+      mValues[slot]                = mValues[last];
+      mStates[slot]                = mStates[last];
+      mDelays[slot]                = mDelays[last];
+      mSteps[slot]                 = mSteps[last];
+      mExponents[slot]             = mExponents[last];
+      mFactors[slot]               = mFactors[last];
+      mDirections[slot]            = mDirections[last];
+    }
+
+    mActive.pop_back();
+    mStarts.pop_back();
+    mEnds.pop_back();
+    mValues.pop_back();
+    mStates.pop_back();
+    mDelays.pop_back();
+    mSteps.pop_back();
+    mExponents.pop_back();
+    mFactors.pop_back();
+    mDirections.pop_back();
+
+    property.mAnimatorSlot = -1;
+  }
+
+  std::unordered_set<AnimatedProperty<T>*> mProperties;
+
+  // one element for each running animation
+  std::vector<AnimatedProperty<T>*> mActive;
+  std::vector<T>                    mStarts;
+  std::vector<T>                    mEnds;
+  std::vector<T>                    mValues;
+  std::vector<double>               mStates;
+  std::vector<double>               mDelays;
+  std::vector<double>               mSteps;
+  std::vector<double>               mExponents;
+  std::vector<double>               mFactors;
+  std::vector<AnimationDirection>   mDirections;
 };
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -200,6 +492,7 @@ class AnimatedFloat : public AnimatedProperty<float> {
     mEnd       = other.mEnd;
     mState     = other.mState;
 
+    sync();
     Property<float>::set(other.get());
 
     return *this;
@@ -232,6 +525,7 @@ class AnimatedDouble : public AnimatedProperty<double> {
     mEnd       = other.mEnd;
     mState     = other.mState;
 
+    sync();
     Property<double>::set(other.get());
 
     return *this;
@@ -9,16 +9,18 @@
 #ifndef ILLUSION_CORE_BITHASH_HPP
 #define ILLUSION_CORE_BITHASH_HPP
 
+#include <algorithm>
 #include <cstdint>
 #include <cstring>
+#include <functional>
 #include <vector>
 
 namespace Illusion::Core {
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////
 // A small class which can be used to create hashes for complex objects. This is done by pushing  //
-// individual bits of the members of the object into an std::vector<bool>. For example consider a //
-// struct like this:                                                                              //
+// individual bits of the members of the object into a densely packed array of 64 bit words. For  //
+// example consider a struct like this:                                                           //
 //                                                                                                //
 // struct Vehicle {                                                                               //
 //   enum class Type { eBike = 0, eCar = 1, eBoot = 2, eAirplane = 3 };                           //
@@ -32,13 +34,15 @@ namespace Illusion::Core {
 // hash.push<32>(vehicle.mPrice); // mPrice is a uint32_t, therefore we have to push 32 bits      //
 // hash.push<2>(vehicle.mType);   // mType only needs 2 bits                                      //
 //                                                                                                //
-// Then we can store our Vehicles in a maplike this:                                              //
+// Then we can store our Vehicles in a map like this:                                             //
 //                                                                                                //
-// std::map<BitHash, Vehicle> mCache;                                                             //
+// std::unordered_map<BitHash, Vehicle> mCache;                                                   //
 //                                                                                                //
+// Equality comparisons are done word-by-word; getHash() folds all words into a single 64 bit     //
+// value. A std::map can be used as well, as a strict weak ordering is provided.                  //
 ////////////////////////////////////////////////////////////////////////////////////////////////////
 
-class BitHash : public std::vector<bool> {
+class BitHash {
 
  public:
   template <uint32_t bitCount, typename T>
@@ -47,18 +51,88 @@ class BitHash : public std::vector<bool> {
     static_assert(bitCount <= 64, "Cannot push more than 64 bits into BitHash!");
     static_assert(bitCount <= sizeof(T) * 8, "Cannot push more bits into the BitHash than T has!");
 
-    uint64_t mask(1);
     uint64_t castedValue(0);
+    std::memcpy(&castedValue, &value, std::min(sizeof(T), sizeof(uint64_t)));
 
-    std::memcpy(&castedValue, &value, sizeof(T));
+    if constexpr (bitCount < 64) {
+      castedValue &= (uint64_t(1) << bitCount) - 1;
+    }
+
+    uint32_t offset = mBitCount % 64;
+
+    if (offset == 0) {
+      mWords.push_back(castedValue);
+    } else {
+      mWords.back() |= castedValue << offset;
+
+      if (offset + bitCount > 64) {
+        mWords.push_back(castedValue >> (64 - offset));
+      }
+    }
+
+    mBitCount += bitCount;
+  }
 
-    for (uint32_t i(0); i < bitCount; ++i) {
-      push_back((castedValue & mask));
-      mask = mask << 1;
+  // Removes all pushed bits.
+  void clear() {
+    mWords.clear();
+    mBitCount = 0;
+  }
+
+  // Returns the number of pushed bits.
+  size_t size() const {
+    return mBitCount;
+  }
+
+  // Mixes all words into a single 64 bit value. The mixing is done with multiply-xorshift steps
+  // similar to the finalizers of wyhash and splitmix64.
+  uint64_t getHash() const {
+    uint64_t h = 0x9e3779b97f4a7c15ull ^ mBitCount;
+
+    for (uint64_t word : mWords) {
+      h ^= word;
+      h *= 0xbf58476d1ce4e5b9ull;
+      h ^= h >> 31;
     }
+
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdull;
+    h ^= h >> 33;
+
+    return h;
   }
+
+  bool operator==(BitHash const& other) const {
+    return mBitCount == other.mBitCount && mWords == other.mWords;
+  }
+
+  bool operator!=(BitHash const& other) const {
+    return !(*this == other);
+  }
+
+  bool operator<(BitHash const& other) const {
+    if (mBitCount != other.mBitCount) {
+      return mBitCount < other.mBitCount;
+    }
+    return mWords < other.mWords;
+  }
+
+ private:
+  std::vector<uint64_t> mWords;
+  size_t                mBitCount = 0;
 };
 
 } // namespace Illusion::Core
 
+namespace std {
+
+template <>
+struct hash<Illusion::Core::BitHash> {
+  size_t operator()(Illusion::Core::BitHash const& hash) const {
+    return static_cast<size_t>(hash.getHash());
+  }
+};
+
+} // namespace std
+
 #endif // ILLUSION_CORE_BITHASH_HPP
@@ -0,0 +1,77 @@
+////////////////////////////////////////////////////////////////////////////////////////////////////
+//                                                                                                //
+//    _)  |  |            _)                This code may be used and modified under the terms    //
+//     |  |  |  |  | (_-<  |   _ \    \     of the MIT license. See the LICENSE file for details. //
+//    _| _| _| \_,_| ___/ _| \___/ _| _|    Copyright (c) 2018-2019 Simon Schneegans              //
+//                                                                                                //
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include "ChangeBatch.hpp"
+
+namespace Illusion::Core {
+
+namespace {
+
+thread_local ChangeBatch* tCurrentBatch = nullptr;
+
+} // namespace
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+ChangeBatch::ChangeBatch()
+    : mPrevious(tCurrentBatch) {
+  tCurrentBatch = this;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+ChangeBatch::~ChangeBatch() {
+  // changes made by the callbacks are emitted by the enclosing batch, or right away
+  tCurrentBatch = mPrevious;
+  flush();
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void ChangeBatch::flush() {
+  // The callbacks may add further entries or remove() pending ones, so the vector may change
+  // during the loop.
+  size_t count = mPending.size();
+
+  for (size_t i = 0; i < count; ++i) {
+    auto notify = std::move(mPending[i].second);
+    mPending[i].second = nullptr;
+
+    if (notify) {
+      notify();
+    }
+  }
+
+  mPending.erase(mPending.begin(), mPending.begin() + count);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+ChangeBatch* ChangeBatch::getCurrent() {
+  return tCurrentBatch;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void ChangeBatch::add(void const* owner, std::function<void()> const& notify) {
+  mPending.emplace_back(owner, notify);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void ChangeBatch::remove(void const* owner) {
+  for (auto& entry : mPending) {
+    if (entry.first == owner) {
+      entry.second = nullptr;
+    }
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+} // namespace Illusion::Core
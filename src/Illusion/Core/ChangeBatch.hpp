@@ -0,0 +1,55 @@
+////////////////////////////////////////////////////////////////////////////////////////////////////
+//                                                                                                //
+//    _)  |  |            _)                This code may be used and modified under the terms    //
+//     |  |  |  |  | (_-<  |   _ \    \     of the MIT license. See the LICENSE file for details. //
+//    _| _| _| \_,_| ___/ _| \___/ _| _|    Copyright (c) 2018-2019 Simon Schneegans              //
+//                                                                                                //
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#ifndef ILLUSION_CORE_CHANGE_BATCH_HPP
+#define ILLUSION_CORE_CHANGE_BATCH_HPP
+
+#include <functional>
+#include <vector>
+
+namespace Illusion::Core {
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// While a ChangeBatch exists, Properties which are changed by its thread do not emit their       //
+// Signals right away. Instead, each changed Property emits beforeChange() and onChange() once    //
+// with its final value when the ChangeBatch is flushed or destroyed. This way, a Property which  //
+// is changed many times in a frame (for example by an AnimatedProperty) notifies its listeners   //
+// only once. Note that beforeChange() is emitted after the value has changed then.               //
+// ChangeBatches may be nested; the innermost one is used. They have to be created on the stack,  //
+// since they are only valid for the thread which created them.                                   //
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+class ChangeBatch {
+
+ public:
+  ChangeBatch();
+  virtual ~ChangeBatch();
+
+  ChangeBatch(ChangeBatch const& other) = delete;
+  ChangeBatch& operator=(ChangeBatch const& other) = delete;
+
+  // Emits the Signals of all Properties which have been changed since the last flush. Changes made
+  // by the callbacks are collected for the next flush.
+  void flush();
+
+  // Returns the innermost ChangeBatch of the calling thread, or nullptr if there is none.
+  static ChangeBatch* getCurrent();
+
+  // Used by the Properties: The notify function of a changed Property is stored until the next
+  // flush; a Property which is destroyed before has to remove() itself.
+  void add(void const* owner, std::function<void()> const& notify);
+  void remove(void const* owner);
+
+ private:
+  std::vector<std::pair<void const*, std::function<void()>>> mPending;
+  ChangeBatch*                                               mPrevious;
+};
+
+} // namespace Illusion::Core
+
+#endif // ILLUSION_CORE_CHANGE_BATCH_HPP
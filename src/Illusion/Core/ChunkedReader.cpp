@@ -0,0 +1,143 @@
+////////////////////////////////////////////////////////////////////////////////////////////////////
+//                                                                                                //
+//    _)  |  |            _)                This code may be used and modified under the terms    //
+//     |  |  |  |  | (_-<  |   _ \    \     of the MIT license. See the LICENSE file for details. //
+//    _| _| _| \_,_| ___/ _| \___/ _| _|    Copyright (c) 2018-2019 Simon Schneegans              //
+//                                                                                                //
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include "ChunkedReader.hpp"
+
+#include <algorithm>
+
+namespace Illusion::Core {
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+ChunkedReader::ChunkedReader(
+    std::shared_ptr<MappedFile const> file, size_t chunkSize, ThreadPool& threadPool)
+    : mQueue(std::make_shared<Queue>())
+    , mThreadPool(threadPool) {
+
+  mQueue->mFile      = std::move(file);
+  mQueue->mChunkSize = std::max<size_t>(chunkSize, 1);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+ChunkedReader::~ChunkedReader() {
+  std::unique_lock<std::mutex> lock(mQueue->mMutex);
+  mQueue->mReads.clear();
+  mQueue->mCondition.wait(lock, [this]() { return !mQueue->mBusy; });
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void ChunkedReader::read(size_t offset, size_t size, ChunkCallback const& onChunk,
+    std::function<void()> const& onFinished) {
+
+  auto const& file     = mQueue->mFile;
+  size_t      fileSize = file ? file->getSize() : 0;
+  offset               = std::min(offset, fileSize);
+  size                 = std::min(size, fileSize - offset);
+
+  bool start = false;
+
+  {
+    std::unique_lock<std::mutex> lock(mQueue->mMutex);
+    mQueue->mReads.push_back({offset, size, onChunk, onFinished});
+    start               = !mQueue->mProcessing;
+    mQueue->mProcessing = true;
+  }
+
+  // The first chunk is requested right away, the task may not be started immediately.
+  if (start) {
+    if (file) {
+      file->prefetch(offset, std::min(size, mQueue->mChunkSize));
+    }
+
+    mThreadPool.enqueue([queue = mQueue]() { process(queue); });
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void ChunkedReader::cancel() {
+  std::unique_lock<std::mutex> lock(mQueue->mMutex);
+  mQueue->mReads.clear();
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void ChunkedReader::wait() {
+  std::unique_lock<std::mutex> lock(mQueue->mMutex);
+  mQueue->mCondition.wait(lock, [this]() { return !mQueue->mProcessing; });
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+bool ChunkedReader::isIdle() const {
+  std::unique_lock<std::mutex> lock(mQueue->mMutex);
+  return !mQueue->mProcessing;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+std::shared_ptr<MappedFile const> const& ChunkedReader::getFile() const {
+  return mQueue->mFile;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void ChunkedReader::process(std::shared_ptr<Queue> const& queue) {
+  auto const& file = queue->mFile;
+
+  while (true) {
+    Read read;
+
+    {
+      std::unique_lock<std::mutex> lock(queue->mMutex);
+      queue->mBusy = false;
+
+      if (queue->mReads.empty()) {
+        queue->mProcessing = false;
+        queue->mCondition.notify_all();
+        return;
+      }
+
+      read = std::move(queue->mReads.front());
+      queue->mReads.pop_front();
+      queue->mBusy = true;
+    }
+
+    size_t end = read.mOffset + read.mSize;
+
+    for (size_t offset(read.mOffset); offset < end; offset += queue->mChunkSize) {
+      size_t         size = std::min(queue->mChunkSize, end - offset);
+      uint8_t const* data = file->getData() + offset;
+
+      // the next chunk is read by the operating system while this one is processed
+      file->prefetch(offset + size, std::min(queue->mChunkSize, end - offset - size));
+
+      // Touching one byte of each page loads the whole chunk; a stride smaller than the actual
+      // page size does not hurt.
+      volatile uint8_t sink = 0;
+      for (size_t i(0); i < size; i += 4096) {
+        sink = data[i];
+      }
+      (void)sink;
+
+      if (read.mOnChunk) {
+        read.mOnChunk(offset, data, size);
+      }
+    }
+
+    if (read.mOnFinished) {
+      read.mOnFinished();
+    }
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+} // namespace Illusion::Core
@@ -0,0 +1,95 @@
+////////////////////////////////////////////////////////////////////////////////////////////////////
+//                                                                                                //
+//    _)  |  |            _)                This code may be used and modified under the terms    //
+//     |  |  |  |  | (_-<  |   _ \    \     of the MIT license. See the LICENSE file for details. //
+//    _| _| _| \_,_| ___/ _| \___/ _| _|    Copyright (c) 2018-2019 Simon Schneegans              //
+//                                                                                                //
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#ifndef ILLUSION_CORE_CHUNKED_READER_HPP
+#define ILLUSION_CORE_CHUNKED_READER_HPP
+
+#include "MappedFile.hpp"
+#include "ThreadPool.hpp"
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+
+namespace Illusion::Core {
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// Reads ranges of a MappedFile asynchronously in chunks. The reads are processed one after       //
+// another by a task of a ThreadPool: while a chunk is read, the next one is prefetched with      //
+// MappedFile::prefetch() and the pages of the chunk are touched, so that they are resident       //
+// afterwards. Then the chunk is handed to a callback as a pointer into the mapping. Nothing is   //
+// copied on the way, the callback can pass the data directly to staging memory (for example with //
+// UploadManager::uploadToBuffer()) without blocking on disc I/O. The callbacks are called by the //
+// worker thread, they must not throw and must not destroy the ChunkedReader. When the            //
+// ChunkedReader is destroyed, reads which have not been started yet are discarded and the        //
+// destructor blocks until the current read has finished.                                         //
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+class ChunkedReader {
+
+ public:
+  // The offset is relative to the beginning of the file, data points into the MappedFile.
+  typedef std::function<void(size_t offset, uint8_t const* data, size_t size)> ChunkCallback;
+
+  // The file is kept alive by the ChunkedReader. Each chunk has at most chunkSize bytes.
+  explicit ChunkedReader(std::shared_ptr<MappedFile const> file,
+      size_t chunkSize = 4 * 1024 * 1024, ThreadPool& threadPool = ThreadPool::getShared());
+  virtual ~ChunkedReader();
+
+  ChunkedReader(ChunkedReader const& other) = delete;
+  ChunkedReader& operator=(ChunkedReader const& other) = delete;
+
+  // Enqueues a read of the given range, which is clamped to the size of the file. onChunk is
+  // called for each chunk in order, onFinished once after the last chunk; both may be empty.
+  void read(size_t offset, size_t size, ChunkCallback const& onChunk,
+      std::function<void()> const& onFinished = nullptr);
+
+  // Discards all reads which have not been started yet.
+  void cancel();
+
+  // Blocks until all enqueued reads have been finished.
+  void wait();
+
+  // Returns true if there are no enqueued reads.
+  bool isIdle() const;
+
+  std::shared_ptr<MappedFile const> const& getFile() const;
+
+ private:
+  struct Read {
+    size_t                mOffset = 0;
+    size_t                mSize   = 0;
+    ChunkCallback         mOnChunk;
+    std::function<void()> mOnFinished;
+  };
+
+  // This is shared with the task of the ThreadPool, which may still be enqueued when the
+  // ChunkedReader is destroyed. mProcessing is true while the task is enqueued or running, mBusy
+  // while it processes a Read.
+  struct Queue {
+    std::shared_ptr<MappedFile const> mFile;
+    size_t                            mChunkSize;
+    std::deque<Read>                  mReads;
+    bool                              mProcessing = false;
+    bool                              mBusy       = false;
+    std::mutex                        mMutex;
+    std::condition_variable           mCondition;
+  };
+
+  // Processes the enqueued reads until there are none left, this is executed by the ThreadPool.
+  static void process(std::shared_ptr<Queue> const& queue);
+
+  std::shared_ptr<Queue> mQueue;
+  ThreadPool&            mThreadPool;
+};
+
+} // namespace Illusion::Core
+
+#endif // ILLUSION_CORE_CHUNKED_READER_HPP
@@ -8,12 +8,16 @@
 
 #include "FPSCounter.hpp"
 
+#include <algorithm>
+#include <numeric>
+
 namespace Illusion::Core {
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////
 
-FPSCounter::FPSCounter(unsigned t, bool autoStart)
-    : mDelay(t) {
+FPSCounter::FPSCounter(unsigned t, bool autoStart, uint32_t historySize)
+    : mDelay(t)
+    , mHistorySize(std::max(historySize, 1u)) {
 
   if (autoStart) {
     start();
@@ -24,6 +28,8 @@ FPSCounter::FPSCounter(unsigned t, bool autoStart)
 
 void FPSCounter::start() {
   mTimer.start();
+  mIntervalTimer.start();
+  mFirstStep = true;
 }
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -34,6 +40,106 @@ void FPSCounter::step() {
     mTimer.reset();
     mFrameCount = 0;
   }
+
+  double interval = mIntervalTimer.reset() * 1000.0;
+
+  // the first interval includes everything which happened before the first frame
+  if (mFirstStep) {
+    mFirstStep = false;
+    return;
+  }
+
+  addPresentInterval(interval);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void FPSCounter::addPresentInterval(double milliseconds) {
+  addSample(Channel::ePresentInterval, milliseconds);
+
+  if (mAverageInterval <= 0.0) {
+    mAverageInterval = milliseconds;
+    return;
+  }
+
+  double limit = mHitchFactor * mAverageInterval;
+
+  if (milliseconds > limit) {
+    ++mHitchCount;
+    sOnHitch.emit(milliseconds, mAverageInterval);
+  }
+
+  // hitches are clamped before they are blended into the moving average; a single hitch barely
+  // moves it, but after a lasting drop of the frame rate it catches up within a few frames
+  mAverageInterval = mAverageInterval * 0.9 + std::min(milliseconds, limit) * 0.1;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void FPSCounter::addCpuTime(double milliseconds) {
+  addSample(Channel::eCpuTime, milliseconds);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void FPSCounter::addGpuTime(double milliseconds) {
+  addSample(Channel::eGpuTime, milliseconds);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+FPSCounter::Statistics FPSCounter::getStatistics(Channel channel) const {
+  std::vector<double> samples = mHistories[static_cast<size_t>(channel)].mSamples;
+  Statistics          result;
+
+  if (samples.empty()) {
+    return result;
+  }
+
+  std::sort(samples.begin(), samples.end());
+
+  auto percentile = [&samples](double p) {
+    return samples[std::min(samples.size() - 1, static_cast<size_t>(p * samples.size()))];
+  };
+
+  result.mSamples = static_cast<uint32_t>(samples.size());
+  result.mAverage = std::accumulate(samples.begin(), samples.end(), 0.0) / samples.size();
+  result.mP50     = percentile(0.5);
+  result.mP95     = percentile(0.95);
+  result.mP99     = percentile(0.99);
+  result.mMax     = samples.back();
+
+  return result;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void FPSCounter::resetStatistics() {
+  for (auto& history : mHistories) {
+    history.mSamples.clear();
+    history.mNext = 0;
+  }
+
+  mHitchCount      = 0;
+  mAverageInterval = 0.0;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void FPSCounter::setHitchFactor(double factor) {
+  mHitchFactor = factor;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+double FPSCounter::getHitchFactor() const {
+  return mHitchFactor;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+uint64_t FPSCounter::getHitchCount() const {
+  return mHitchCount;
 }
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -44,4 +150,19 @@ unsigned FPSCounter::getFrameCount() const {
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////
 
+void FPSCounter::addSample(Channel channel, double milliseconds) {
+  auto& history = mHistories[static_cast<size_t>(channel)];
+
+  // the history grows until it is full, then the oldest sample is overwritten
+  if (history.mSamples.size() < mHistorySize) {
+    history.mSamples.push_back(milliseconds);
+  } else {
+    history.mSamples[history.mNext] = milliseconds;
+  }
+
+  history.mNext = (history.mNext + 1) % mHistorySize;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
 } // namespace Illusion::Core
@@ -10,21 +10,53 @@
 #define ILLUSION_CORE_FPS_COUNTER_HPP
 
 #include "Property.hpp"
+#include "Signal.hpp"
 #include "Timer.hpp"
 
+#include <array>
+#include <cstdint>
+#include <vector>
+
 namespace Illusion::Core {
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////
+// The FPSCounter measures the frame rate and keeps the frame times of the last frames for frame  //
+// pacing analysis. step() has to be called once a frame, usually right after presenting; the     //
+// time between two calls is recorded as the present interval. The CPU time and the GPU time of a //
+// frame (for example from a GpuProfiler or a timestamp query) can be added as well. For each of  //
+// these channels, getStatistics() computes the average, the percentiles and the maximum of the   //
+// last historySize samples.                                                                      //
+// A present interval which is more than getHitchFactor() times longer than the moving average of //
+// the previous intervals is counted as a hitch and reported with sOnHitch. Hitches are clamped   //
+// to this limit before they are blended into the average, so after a lasting drop of the frame   //
+// rate the average catches up and only the first few frames are reported.                        //
 ////////////////////////////////////////////////////////////////////////////////////////////////////
 
 class FPSCounter {
 
  public:
+  enum class Channel { eCpuTime, eGpuTime, ePresentInterval };
+
+  // All times are in milliseconds.
+  struct Statistics {
+    uint32_t mSamples = 0;
+    double   mAverage = 0.0;
+    double   mP50     = 0.0;
+    double   mP95     = 0.0;
+    double   mP99     = 0.0;
+    double   mMax     = 0.0;
+  };
+
   // This property contains the current frames per seconds.
   Float pFPS = 0.f;
 
-  // Every t frames the Fps property is updated.
-  explicit FPSCounter(unsigned t = 100, bool autoStart = true);
+  // This is emitted by step() when a hitch has been detected. The parameters are the present
+  // interval of the hitch and the moving average it was compared to, both in milliseconds.
+  Signal<double, double> sOnHitch;
+
+  // Every t frames the Fps property is updated. The last historySize samples of each channel are
+  // used for the statistics.
+  explicit FPSCounter(unsigned t = 100, bool autoStart = true, uint32_t historySize = 1024);
 
   // Call this after creation of this counter.
   void start();
@@ -32,13 +64,50 @@ class FPSCounter {
   // Call this once a frame.
   void step();
 
+  // step() calls this with the time since the last step(). It can also be called directly, for
+  // example with present timings reported by the swapchain, in milliseconds.
+  void addPresentInterval(double milliseconds);
+
+  // Adds the CPU or GPU time of a frame, in milliseconds.
+  void addCpuTime(double milliseconds);
+  void addGpuTime(double milliseconds);
+
+  // Computes the statistics of the samples currently in the history of the given channel. This
+  // sorts a copy of the history, so it should not be called every frame.
+  Statistics getStatistics(Channel channel) const;
+
+  // Clears the history of all channels and the hitch count.
+  void resetStatistics();
+
+  // The default is 2.0, so a frame which takes twice as long as usual is considered a hitch.
+  void   setHitchFactor(double factor);
+  double getHitchFactor() const;
+
+  // The number of hitches since the creation or the last resetStatistics().
+  uint64_t getHitchCount() const;
+
   // returns the number of times step() has been called
   unsigned getFrameCount() const;
 
  private:
+  struct History {
+    std::vector<double> mSamples;
+    size_t              mNext = 0;
+  };
+
+  void addSample(Channel channel, double milliseconds);
+
   unsigned mFrameCount = 0;
   unsigned mDelay      = 10;
   Timer    mTimer;
+
+  uint32_t               mHistorySize;
+  std::array<History, 3> mHistories;
+  Timer                  mIntervalTimer;
+  bool                   mFirstStep       = true;
+  double                 mAverageInterval = 0.0;
+  double                 mHitchFactor     = 2.0;
+  uint64_t               mHitchCount      = 0;
 };
 } // namespace Illusion::Core
 
@@ -22,6 +22,9 @@
 // auto content = file.getContent<std::string>(); // reads the content as a std::string           //
 // auto content = file.getContent<std::vector<uint8_t>>(); // reads the content as a byte array   //
 //                                                                                                //
+// getContent() copies the whole file into a new container. Large binary files such as images or  //
+// glTF files should be read with a MappedFile instead, it hands out pointers into the file.      //
+//                                                                                                //
 ////////////////////////////////////////////////////////////////////////////////////////////////////
 
 namespace Illusion::Core {
@@ -0,0 +1,306 @@
+////////////////////////////////////////////////////////////////////////////////////////////////////
+//                                                                                                //
+//    _)  |  |            _)                This code may be used and modified under the terms    //
+//     |  |  |  |  | (_-<  |   _ \    \     of the MIT license. See the LICENSE file for details. //
+//    _| _| _| \_,_| ___/ _| \___/ _| _|    Copyright (c) 2018-2019 Simon Schneegans              //
+//                                                                                                //
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include "FileWatcher.hpp"
+
+#include "Logger.hpp"
+#include "filesystem.hpp"
+
+#if defined(__linux__)
+#include <poll.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#elif defined(WIN32)
+#include <windows.h>
+#endif
+
+#include <chrono>
+#include <iostream>
+#include <utility>
+#include <vector>
+
+namespace Illusion::Core {
+
+namespace {
+
+// If nothing can be waited for, the modification times are compared in this interval.
+const std::chrono::milliseconds POLL_INTERVAL(500);
+
+// Splits the given path into its directory and file name.
+std::pair<std::string, std::string> splitPath(std::string const& fileName) {
+  auto pos = fileName.find_last_of("/\\");
+
+  if (pos == std::string::npos) {
+    return {".", fileName};
+  }
+
+  if (pos == 0) {
+    return {"/", fileName.substr(1)};
+  }
+
+  return {fileName.substr(0, pos), fileName.substr(pos + 1)};
+}
+
+} // namespace
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+FileWatcher::FileWatcher() {
+#if defined(__linux__)
+  mInotify = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+  if (mInotify < 0) {
+    ILLUSION_WARNING << "Failed to initialize inotify, files will be polled for changes instead!"
+                     << std::endl;
+  }
+#endif
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+FileWatcher::~FileWatcher() {
+  {
+    std::unique_lock<std::mutex> lock(mMutex);
+    mStop = true;
+  }
+
+  mStopCondition.notify_all();
+
+  if (mThread.joinable()) {
+    mThread.join();
+  }
+
+#if defined(__linux__)
+  if (mInotify >= 0) {
+    close(mInotify);
+  }
+#elif defined(WIN32)
+  for (auto const& handle : mDirectoryHandles) {
+    FindCloseChangeNotification(reinterpret_cast<HANDLE>(handle.second));
+  }
+#endif
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+uint32_t FileWatcher::watch(std::string const& fileName, std::function<void()> const& callback) {
+  std::unique_lock<std::mutex> lock(mMutex);
+
+  auto [directory, name] = splitPath(fileName);
+
+  if (mDirectoryUsers[directory]++ == 0) {
+    addDirectory(directory);
+  }
+
+  uint32_t handle = mNextHandle++;
+  mEntries.emplace(handle,
+      Entry{fileName, directory, name, callback, FileSystem::getLastWriteTime(fileName)});
+
+  if (!mThread.joinable()) {
+    mThread = std::thread([this]() { work(); });
+  }
+
+  return handle;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void FileWatcher::unwatch(uint32_t handle) {
+  std::unique_lock<std::mutex> lock(mMutex);
+
+  auto entry = mEntries.find(handle);
+  if (entry == mEntries.end()) {
+    return;
+  }
+
+  auto users = mDirectoryUsers.find(entry->second.mDirectory);
+  if (--users->second == 0) {
+    removeDirectory(users->first);
+    mDirectoryUsers.erase(users);
+  }
+
+  mEntries.erase(entry);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void FileWatcher::work() {
+  while (true) {
+    bool waited = false;
+
+#if defined(__linux__)
+    if (mInotify >= 0) {
+      waited = true;
+
+      pollfd descriptor{mInotify, POLLIN, 0};
+      if (poll(&descriptor, 1, static_cast<int>(POLL_INTERVAL.count())) > 0) {
+        std::vector<std::pair<int, std::string>> events;
+
+        alignas(inotify_event) char buffer[4096];
+        ssize_t                     length;
+
+        while ((length = read(mInotify, buffer, sizeof(buffer))) > 0) {
+          for (char* current = buffer; current < buffer + length;) {
+            auto event = reinterpret_cast<inotify_event*>(current);
+            if (event->len > 0) {
+              events.emplace_back(event->wd, event->name);
+            }
+            current += sizeof(inotify_event) + event->len;
+          }
+        }
+
+        std::unique_lock<std::mutex> lock(mMutex);
+        for (auto const& event : events) {
+          for (auto const& handle : mDirectoryHandles) {
+            if (handle.second == event.first) {
+              checkFiles(handle.first, event.second);
+            }
+          }
+        }
+      }
+    }
+#elif defined(WIN32)
+    std::vector<HANDLE>      handles;
+    std::vector<std::string> directories;
+
+    {
+      std::unique_lock<std::mutex> lock(mMutex);
+      for (auto const& handle : mDirectoryHandles) {
+        directories.push_back(handle.first);
+        handles.push_back(reinterpret_cast<HANDLE>(handle.second));
+      }
+    }
+
+    if (!handles.empty()) {
+      waited = true;
+
+      DWORD result = WaitForMultipleObjects(static_cast<DWORD>(handles.size()), handles.data(),
+          FALSE, static_cast<DWORD>(POLL_INTERVAL.count()));
+
+      if (result >= WAIT_OBJECT_0 && result < WAIT_OBJECT_0 + handles.size()) {
+        size_t i = result - WAIT_OBJECT_0;
+        FindNextChangeNotification(handles[i]);
+
+        // Change notifications do not tell which file has been modified, therefore the
+        // modification times of all files in the directory are compared.
+        std::unique_lock<std::mutex> lock(mMutex);
+        checkFiles(directories[i]);
+      }
+    }
+#endif
+
+    std::unique_lock<std::mutex> lock(mMutex);
+
+    if (!waited) {
+      mStopCondition.wait_for(lock, POLL_INTERVAL, [this]() { return mStop; });
+    }
+
+    if (mStop) {
+      return;
+    }
+
+    // Directories which could not be watched are polled.
+    for (auto const& directory : mDirectoryUsers) {
+      if (mDirectoryHandles.find(directory.first) == mDirectoryHandles.end()) {
+        checkFiles(directory.first);
+      }
+    }
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void FileWatcher::checkFiles(std::string const& directory, std::string const& name) {
+  for (auto& entry : mEntries) {
+    auto& file = entry.second;
+
+    if (file.mDirectory != directory || (!name.empty() && file.mName != name)) {
+      continue;
+    }
+
+    auto lastWriteTime = FileSystem::getLastWriteTime(file.mFileName);
+
+    if (name.empty() && lastWriteTime == file.mLastWriteTime) {
+      continue;
+    }
+
+    file.mLastWriteTime = lastWriteTime;
+
+    try {
+      file.mCallback();
+    } catch (std::exception const& e) {
+      ILLUSION_ERROR << "Callback of FileWatcher failed: " << e.what() << std::endl;
+    }
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void FileWatcher::addDirectory(std::string const& directory) {
+  if (mDirectoryHandles.find(directory) != mDirectoryHandles.end()) {
+    return;
+  }
+
+#if defined(__linux__)
+  if (mInotify >= 0) {
+    // Editors often write a temporary file and rename it, hence IN_MOVED_TO.
+    int descriptor =
+        inotify_add_watch(mInotify, directory.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO);
+
+    if (descriptor >= 0) {
+      mDirectoryHandles[directory] = descriptor;
+    } else {
+      ILLUSION_WARNING << "Failed to watch directory \"" << directory
+                       << "\", it will be polled for changes instead!" << std::endl;
+    }
+  }
+#elif defined(WIN32)
+  if (mDirectoryHandles.size() < MAXIMUM_WAIT_OBJECTS) {
+    HANDLE handle = FindFirstChangeNotificationA(directory.c_str(), FALSE,
+        FILE_NOTIFY_CHANGE_LAST_WRITE | FILE_NOTIFY_CHANGE_FILE_NAME);
+
+    if (handle != INVALID_HANDLE_VALUE) {
+      mDirectoryHandles[directory] = reinterpret_cast<intptr_t>(handle);
+    } else {
+      ILLUSION_WARNING << "Failed to watch directory \"" << directory
+                       << "\", it will be polled for changes instead!" << std::endl;
+    }
+  }
+#endif
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void FileWatcher::removeDirectory(std::string const& directory) {
+#if defined(__linux__)
+  auto handle = mDirectoryHandles.find(directory);
+  if (handle == mDirectoryHandles.end()) {
+    return;
+  }
+
+  int descriptor = static_cast<int>(handle->second);
+  mDirectoryHandles.erase(handle);
+
+  // Different paths to the same directory share one watch descriptor.
+  for (auto const& other : mDirectoryHandles) {
+    if (other.second == descriptor) {
+      return;
+    }
+  }
+
+  inotify_rm_watch(mInotify, descriptor);
+#else
+  // On Windows, the worker thread may currently wait for the change notification handle. As it
+  // cannot be closed safely here, it is kept until the FileWatcher is destroyed and reused if the
+  // directory is watched again.
+  (void)directory;
+#endif
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+} // namespace Illusion::Core
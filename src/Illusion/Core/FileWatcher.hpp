@@ -0,0 +1,87 @@
+////////////////////////////////////////////////////////////////////////////////////////////////////
+//                                                                                                //
+//    _)  |  |            _)                This code may be used and modified under the terms    //
+//     |  |  |  |  | (_-<  |   _ \    \     of the MIT license. See the LICENSE file for details. //
+//    _| _| _| \_,_| ___/ _| \___/ _| _|    Copyright (c) 2018-2019 Simon Schneegans              //
+//                                                                                                //
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#ifndef ILLUSION_CORE_FILE_WATCHER_HPP
+#define ILLUSION_CORE_FILE_WATCHER_HPP
+
+#include <condition_variable>
+#include <cstdint>
+#include <ctime>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+
+namespace Illusion::Core {
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// The FileWatcher notifies callbacks when files are modified. It watches the directories of the  //
+// files with inotify on Linux and with change notifications on Windows, so the files do not have //
+// to be polled; on other platforms, the modification times are compared twice a second. As       //
+// directories are watched, files which are replaced by editors (by writing a new file and        //
+// renaming it) are detected as well. The callbacks are executed by a background thread which is  //
+// started with the first call to watch(). They must not call watch() or unwatch() and should     //
+// return quickly, e.g. by setting a flag which is checked by another thread. All methods are     //
+// thread-safe.                                                                                   //
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+class FileWatcher {
+
+ public:
+  FileWatcher();
+  virtual ~FileWatcher();
+
+  FileWatcher(FileWatcher const& other) = delete;
+  FileWatcher& operator=(FileWatcher const& other) = delete;
+
+  // Calls the callback whenever the given file is modified. The returned handle can be passed to
+  // unwatch().
+  uint32_t watch(std::string const& fileName, std::function<void()> const& callback);
+
+  // Removes the given watch. Once this returns, the callback is not running anymore and it will
+  // not be called again.
+  void unwatch(uint32_t handle);
+
+ private:
+  struct Entry {
+    std::string           mFileName;
+    std::string           mDirectory;
+    std::string           mName;
+    std::function<void()> mCallback;
+    time_t                mLastWriteTime;
+  };
+
+  void work();
+
+  // Calls the callbacks of the files in the given directory. If a name is given, only the file with
+  // this name is considered modified; else all files whose modification times have changed. mMutex
+  // has to be locked.
+  void checkFiles(std::string const& directory, std::string const& name = "");
+
+  // These add or remove the system specific watch of a directory. mMutex has to be locked.
+  void addDirectory(std::string const& directory);
+  void removeDirectory(std::string const& directory);
+
+  std::map<uint32_t, Entry>       mEntries;
+  std::map<std::string, int>      mDirectoryUsers;
+  std::map<std::string, intptr_t> mDirectoryHandles;
+  uint32_t                        mNextHandle = 0;
+
+  // On Linux, this is the file descriptor of the inotify instance.
+  int mInotify = -1;
+
+  std::thread             mThread;
+  bool                    mStop = false;
+  std::condition_variable mStopCondition;
+  mutable std::mutex      mMutex;
+};
+
+} // namespace Illusion::Core
+
+#endif // ILLUSION_CORE_FILE_WATCHER_HPP
@@ -0,0 +1,41 @@
+////////////////////////////////////////////////////////////////////////////////////////////////////
+//                                                                                                //
+//    _)  |  |            _)                This code may be used and modified under the terms    //
+//     |  |  |  |  | (_-<  |   _ \    \     of the MIT license. See the LICENSE file for details. //
+//    _| _| _| \_,_| ___/ _| \___/ _| _|    Copyright (c) 2018-2019 Simon Schneegans              //
+//                                                                                                //
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#ifndef ILLUSION_CORE_HASH_HPP
+#define ILLUSION_CORE_HASH_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+namespace Illusion::Core {
+
+// A simple and fast 64 bit hash which can be used for the keys of cache files. This is not meant
+// to be secure in any way, it is only used to detect modified source files. Larger inputs can be
+// hashed piece by piece by passing the result of the previous call as hash.
+inline uint64_t hashBytes(uint64_t hash, void const* data, size_t size) {
+  auto   bytes = static_cast<uint8_t const*>(data);
+  size_t i     = 0;
+
+  for (; i + sizeof(uint64_t) <= size; i += sizeof(uint64_t)) {
+    uint64_t word;
+    std::memcpy(&word, bytes + i, sizeof(uint64_t));
+    hash = (hash ^ word) * 0x9e3779b97f4a7c15ull;
+    hash ^= hash >> 29;
+  }
+
+  for (; i < size; ++i) {
+    hash = (hash ^ bytes[i]) * 0x100000001b3ull;
+  }
+
+  return hash ^ size;
+}
+
+} // namespace Illusion::Core
+
+#endif // ILLUSION_CORE_HASH_HPP
@@ -0,0 +1,276 @@
+////////////////////////////////////////////////////////////////////////////////////////////////////
+//                                                                                                //
+//    _)  |  |            _)                This code may be used and modified under the terms    //
+//     |  |  |  |  | (_-<  |   _ \    \     of the MIT license. See the LICENSE file for details. //
+//    _| _| _| \_,_| ___/ _| \___/ _| _|    Copyright (c) 2018-2019 Simon Schneegans              //
+//                                                                                                //
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include "JobSystem.hpp"
+
+#include "Logger.hpp"
+#include "ThreadPool.hpp"
+
+#include <algorithm>
+#include <iostream>
+
+namespace Illusion::Core {
+
+namespace {
+
+// Each worker thread stores the JobSystem it belongs to and its index, so that jobs started by a
+// worker can be pushed to its own deque.
+thread_local JobSystem const* tJobSystem   = nullptr;
+thread_local int32_t          tWorkerIndex = -1;
+
+} // namespace
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+uint32_t JobSystem::Counter::get() const {
+  return mValue;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+JobSystem::JobSystem(uint32_t threadCount, std::function<void(uint32_t)> const& threadInit)
+    : mThreadInit(threadInit) {
+
+  if (threadCount == 0) {
+    uint32_t cores = std::thread::hardware_concurrency();
+    cores          = cores > 1 ? cores - 1 : 1u;
+    threadCount    = std::max(cores - std::min(cores, ThreadPool::getDefaultThreadCount()), 1u);
+  }
+
+  // all queues have to exist before the first thread starts stealing
+  for (uint32_t i = 0; i < threadCount; ++i) {
+    mQueues.emplace_back(std::make_unique<WorkerQueue>());
+  }
+
+  for (uint32_t i = 0; i < threadCount; ++i) {
+    mThreads.emplace_back([this, i]() { work(i); });
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+JobSystem::~JobSystem() {
+  {
+    std::unique_lock<std::mutex> lock(mMutex);
+    mStop = true;
+  }
+
+  mWakeCondition.notify_all();
+
+  for (auto& thread : mThreads) {
+    thread.join();
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void JobSystem::run(std::function<void()> job, Counter* counter) {
+  if (counter) {
+    ++counter->mValue;
+  }
+
+  push({std::move(job), counter});
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void JobSystem::runAfter(Counter& dependency, std::function<void()> job, Counter* counter) {
+  if (counter) {
+    ++counter->mValue;
+  }
+
+  {
+    // the dependency is decremented while its mutex is locked, hence it cannot reach zero after
+    // this check without running the continuation
+    std::unique_lock<std::mutex> lock(dependency.mMutex);
+
+    if (dependency.mValue > 0) {
+      dependency.mContinuations.emplace_back(std::move(job), counter);
+      return;
+    }
+  }
+
+  push({std::move(job), counter});
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void JobSystem::wait(Counter& counter) {
+  while (counter.mValue > 0) {
+    Job job;
+
+    if (pop(job)) {
+      execute(job);
+      continue;
+    }
+
+    std::unique_lock<std::mutex> lock(mMutex);
+    mWakeCondition.wait(
+        lock, [this, &counter]() { return counter.mValue == 0 || mQueuedJobs > 0; });
+  }
+
+  // The thread which decremented the Counter to zero may still be scheduling its continuations.
+  // Once it has released the mutex, it will not access the Counter anymore, so the Counter can be
+  // destroyed after this.
+  std::unique_lock<std::mutex> lock(counter.mMutex);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void JobSystem::parallelFor(
+    size_t count, size_t chunkSize, std::function<void(size_t, size_t)> const& func) {
+
+  chunkSize = std::max<size_t>(chunkSize, 1);
+
+  Counter counter;
+
+  for (size_t begin = chunkSize; begin < count; begin += chunkSize) {
+    size_t end = std::min(begin + chunkSize, count);
+    run([&func, begin, end]() { func(begin, end); }, &counter);
+  }
+
+  if (count > 0) {
+    func(0, std::min(chunkSize, count));
+  }
+
+  wait(counter);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+uint32_t JobSystem::getThreadCount() const {
+  return static_cast<uint32_t>(mThreads.size());
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+int32_t JobSystem::getWorkerIndex() const {
+  return tJobSystem == this ? tWorkerIndex : -1;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void JobSystem::work(uint32_t index) {
+  tJobSystem   = this;
+  tWorkerIndex = static_cast<int32_t>(index);
+
+  if (mThreadInit) {
+    mThreadInit(index);
+  }
+
+  while (true) {
+    Job job;
+
+    if (pop(job)) {
+      execute(job);
+      continue;
+    }
+
+    std::unique_lock<std::mutex> lock(mMutex);
+    mWakeCondition.wait(lock, [this]() { return mStop || mQueuedJobs > 0; });
+
+    // queued jobs are still executed when the JobSystem is destroyed, the worker which executes
+    // the last one executes the continuations it starts as well
+    if (mStop && mQueuedJobs == 0) {
+      return;
+    }
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void JobSystem::push(Job&& job) {
+  int32_t worker = getWorkerIndex();
+  size_t  index  = worker >= 0 ? worker : mNextQueue++ % mQueues.size();
+
+  {
+    std::unique_lock<std::mutex> lock(mQueues[index]->mMutex);
+    mQueues[index]->mJobs.push_back(std::move(job));
+  }
+
+  {
+    std::unique_lock<std::mutex> lock(mMutex);
+    ++mQueuedJobs;
+  }
+
+  mWakeCondition.notify_all();
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+bool JobSystem::pop(Job& job) {
+  int32_t worker = getWorkerIndex();
+
+  // the newest job of the own deque
+  if (worker >= 0) {
+    auto&                        queue = *mQueues[worker];
+    std::unique_lock<std::mutex> lock(queue.mMutex);
+
+    if (!queue.mJobs.empty()) {
+      job = std::move(queue.mJobs.back());
+      queue.mJobs.pop_back();
+      --mQueuedJobs;
+      return true;
+    }
+  }
+
+  // the oldest job of another deque, starting with the next one
+  size_t first = worker >= 0 ? worker + 1 : 0;
+
+  for (size_t i = 0; i < mQueues.size(); ++i) {
+    auto&                        queue = *mQueues[(first + i) % mQueues.size()];
+    std::unique_lock<std::mutex> lock(queue.mMutex);
+
+    if (!queue.mJobs.empty()) {
+      job = std::move(queue.mJobs.front());
+      queue.mJobs.pop_front();
+      --mQueuedJobs;
+      return true;
+    }
+  }
+
+  return false;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void JobSystem::execute(Job& job) {
+  try {
+    job.mFunction();
+  } catch (std::exception const& e) {
+    ILLUSION_ERROR << "Job of JobSystem failed: " << e.what() << std::endl;
+  }
+
+  if (!job.mCounter) {
+    return;
+  }
+
+  std::vector<std::pair<std::function<void()>, Counter*>> continuations;
+
+  {
+    std::unique_lock<std::mutex> lock(job.mCounter->mMutex);
+    if (--job.mCounter->mValue == 0) {
+      std::swap(continuations, job.mCounter->mContinuations);
+    }
+  }
+
+  for (auto& continuation : continuations) {
+    push({std::move(continuation.first), continuation.second});
+  }
+
+  // wake the threads which are waiting for the Counter
+  {
+    std::unique_lock<std::mutex> lock(mMutex);
+  }
+
+  mWakeCondition.notify_all();
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+} // namespace Illusion::Core
@@ -0,0 +1,122 @@
+////////////////////////////////////////////////////////////////////////////////////////////////////
+//                                                                                                //
+//    _)  |  |            _)                This code may be used and modified under the terms    //
+//     |  |  |  |  | (_-<  |   _ \    \     of the MIT license. See the LICENSE file for details. //
+//    _| _| _| \_,_| ___/ _| \___/ _| _|    Copyright (c) 2018-2019 Simon Schneegans              //
+//                                                                                                //
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#ifndef ILLUSION_CORE_JOB_SYSTEM_HPP
+#define ILLUSION_CORE_JOB_SYSTEM_HPP
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace Illusion::Core {
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// A scheduler for many small jobs. Each worker thread has its own deque of jobs: jobs which are  //
+// started by a worker are pushed to the back of its deque and the worker takes its own jobs from //
+// the back as well, which keeps the data of recently created jobs in its cache. If the deque of  //
+// a worker is empty, it steals the oldest job from the front of the deque of another worker.     //
+// Jobs started by other threads are distributed round-robin over the workers.                    //
+// The completion of jobs is tracked with Counters. A Counter is incremented when a job is        //
+// started with it and decremented when the job has finished; other jobs can be started once a    //
+// Counter has reached zero with runAfter(). There are no fibers: a thread which wait()s for a    //
+// Counter executes other jobs in the meantime, so jobs may wait for jobs they have started       //
+// without blocking a worker.                                                                     //
+// Exceptions thrown by jobs are caught and logged. When the JobSystem is destroyed, the          //
+// destructor blocks until all queued jobs, including the jobs they start, have been executed.    //
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+class JobSystem {
+
+ public:
+  // A Counter must outlive all jobs which have been started with it. It may be reused once it has
+  // reached zero.
+  class Counter {
+   public:
+    // Returns the number of jobs which have been started with this Counter but not finished yet.
+    uint32_t get() const;
+
+   private:
+    friend class JobSystem;
+
+    std::atomic<uint32_t> mValue{0};
+
+    // The jobs which have been started with runAfter() and are waiting for this Counter.
+    std::mutex                                              mMutex;
+    std::vector<std::pair<std::function<void()>, Counter*>> mContinuations;
+  };
+
+  // If threadCount is zero, the cores which are neither used by the calling thread nor by a
+  // default ThreadPool are used (but at least one thread), see
+  // ThreadPool::getDefaultThreadCount(). Hence a JobSystem and ThreadPool::getShared() do not
+  // oversubscribe the cores. The threadInit callback is called by each worker thread with its
+  // index before it executes any job. It can be used to set the affinity or the priority of the
+  // thread with platform-specific API.
+  explicit JobSystem(
+      uint32_t threadCount = 0, std::function<void(uint32_t)> const& threadInit = nullptr);
+  virtual ~JobSystem();
+
+  // The job will be executed by one of the worker threads. If a Counter is given, it is
+  // incremented now and decremented once the job has finished.
+  void run(std::function<void()> job, Counter* counter = nullptr);
+
+  // Like run(), but the job is not started before the dependency has reached zero. The counter is
+  // incremented immediately.
+  void runAfter(Counter& dependency, std::function<void()> job, Counter* counter = nullptr);
+
+  // Blocks until the Counter has reached zero. In the meantime, the calling thread executes other
+  // jobs; this may be any thread, including the worker threads.
+  void wait(Counter& counter);
+
+  // Calls func(begin, end) for consecutive ranges of at most chunkSize of the indices [0, count)
+  // in parallel and blocks until all of them have been processed. The first range is processed by
+  // the calling thread.
+  void parallelFor(
+      size_t count, size_t chunkSize, std::function<void(size_t, size_t)> const& func);
+
+  uint32_t getThreadCount() const;
+
+  // Returns the index of the calling worker thread of this JobSystem, or -1 if the calling thread
+  // is not one of them.
+  int32_t getWorkerIndex() const;
+
+ private:
+  struct Job {
+    std::function<void()> mFunction;
+    Counter*              mCounter = nullptr;
+  };
+
+  struct WorkerQueue {
+    std::mutex      mMutex;
+    std::deque<Job> mJobs;
+  };
+
+  void work(uint32_t index);
+  void push(Job&& job);
+  bool pop(Job& job);
+  void execute(Job& job);
+
+  std::vector<std::thread>                  mThreads;
+  std::vector<std::unique_ptr<WorkerQueue>> mQueues;
+  std::function<void(uint32_t)>             mThreadInit;
+  std::atomic<uint32_t>                     mNextQueue{0};
+
+  // mQueuedJobs is only incremented while mMutex is locked, so that no wake-up gets lost.
+  std::atomic<uint32_t>   mQueuedJobs{0};
+  bool                    mStop = false;
+  std::mutex              mMutex;
+  std::condition_variable mWakeCondition;
+};
+
+} // namespace Illusion::Core
+
+#endif // ILLUSION_CORE_JOB_SYSTEM_HPP
@@ -9,8 +9,16 @@
 // ---------------------------------------------------------------------------------------- includes
 #include "Logger.hpp"
 
+#include "MPMCQueue.hpp"
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
 #include <iostream>
+#include <mutex>
 #include <sstream>
+#include <thread>
 
 namespace Illusion::Core {
 
@@ -61,74 +69,208 @@ const std::string Logger::PRINT_RESET = "\x001b[0m";
 
 namespace {
 
-class NullBuffer : public std::streambuf {
+// The stream of each thread is re-used for all of its records. mInUse is set while a Record is
+// being formatted; a Record created meanwhile (for example by an operator<< which logs itself) gets
+// a stream of its own.
+struct ThreadBuffer {
+  std::ostringstream mStream;
+  bool               mInUse = false;
+};
+
+thread_local ThreadBuffer tBuffer;
+
+// Set once the Writer has been destroyed at exit; records are written synchronously from then on.
+std::atomic<bool> writerDestroyed{false};
+
+// Pops the records from the queue and writes them to std::cout on a thread of its own. When the
+// queue is empty, it waits for a notification or at most a few milliseconds, so that a missed
+// notification only delays the output.
+class Writer {
  public:
-  int overflow(int c) {
-    return c;
+  Writer()
+      : mQueue(4096)
+      , mThread([this]() { run(); }) {
+  }
+
+  ~Writer() {
+    mStop = true;
+    mWake.notify_one();
+    mThread.join();
+    writerDestroyed = true;
   }
-};
 
-NullBuffer   nullBuffer;
-std::ostream devNull(&nullBuffer);
+  void push(std::string&& text) {
+    // The queue is only full if thousands of records are logged in a burst. Then the calling thread
+    // has to wait for the Writer.
+    while (!mQueue.push(std::move(text))) {
+      mWake.notify_one();
+      std::this_thread::yield();
+    }
 
-std::string locationString(const char* f, int l) {
-  if (!Logger::printFile && !Logger::printLine) {
-    return "";
+    ++mPushed;
+    mWake.notify_one();
   }
 
-  std::stringstream sstr;
+  void flush() {
+    uint64_t target = mPushed;
+    mWake.notify_one();
+
+    std::unique_lock<std::mutex> lock(mMutex);
+    mDone.wait(lock, [this, target]() { return mWritten >= target; });
+  }
 
-  sstr << "[";
+ private:
+  void run() {
+    std::array<std::string, 64> records;
 
-  if (Logger::printFile)
-    sstr << std::string(f);
-  if (Logger::printFile && Logger::printLine)
-    sstr << ":";
-  if (Logger::printLine)
-    sstr << l;
+    while (true) {
+      size_t count = mQueue.pop(records.data(), records.size());
 
-  sstr << "]";
-  return sstr.str();
+      if (count == 0) {
+        if (mStop) {
+          return;
+        }
+
+        std::unique_lock<std::mutex> lock(mMutex);
+        mWake.wait_for(lock, std::chrono::milliseconds(10),
+            [this]() { return mStop || !mQueue.empty(); });
+        continue;
+      }
+
+      for (size_t i = 0; i < count; ++i) {
+        std::cout << records[i];
+        records[i].clear();
+      }
+
+      std::cout.flush();
+
+      {
+        std::unique_lock<std::mutex> lock(mMutex);
+        mWritten += count;
+      }
+      mDone.notify_all();
+    }
+  }
+
+  MPMCQueue<std::string>  mQueue;
+  std::atomic<uint64_t>   mPushed{0};
+  uint64_t                mWritten = 0;
+  std::atomic<bool>       mStop{false};
+  std::mutex              mMutex;
+  std::condition_variable mWake;
+  std::condition_variable mDone;
+  std::thread             mThread;
+};
+
+Writer& getWriter() {
+  static Writer writer;
+  return writer;
 }
 
-std::ostream& print(
-    bool enable, std::string const& header, std::string const& color, const char* file, int line) {
-  if (enable) {
-    return std::cout << color << header << locationString(file, line) << Logger::PRINT_RESET << " ";
-  } else {
-    return devNull;
+struct Header {
+  const char*        mText;
+  std::string const& mColor;
+};
+
+Header getHeader(Logger::Level level) {
+  switch (level) {
+  case Logger::Level::eTrace:
+    return {"[ILLUSION][T]", Logger::PRINT_TURQUOISE};
+  case Logger::Level::eDebug:
+    return {"[ILLUSION][D]", Logger::PRINT_BLUE};
+  case Logger::Level::eMessage:
+    return {"[ILLUSION][M]", Logger::PRINT_GREEN};
+  case Logger::Level::eWarning:
+    return {"[ILLUSION][W]", Logger::PRINT_YELLOW};
+  default:
+    return {"[ILLUSION][E]", Logger::PRINT_RED};
   }
 }
+
 } // namespace
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////
 
-std::ostream& Logger::traceImpl(const char* file, int line) {
-  return print(enableTrace, "[ILLUSION][T]", PRINT_TURQUOISE, file, line);
+Logger::Record::Record(Level level, const char* file, int line)
+    : mLevel(level) {
+
+  if (tBuffer.mInUse) {
+    mOwnStream = std::make_unique<std::ostringstream>();
+    mStream    = mOwnStream.get();
+  } else {
+    tBuffer.mInUse = true;
+    mStream        = &tBuffer.mStream;
+  }
+
+  auto header = getHeader(level);
+  *mStream << header.mColor << header.mText;
+
+  if (printFile || printLine) {
+    *mStream << "[";
+    if (printFile) {
+      *mStream << file;
+    }
+    if (printFile && printLine) {
+      *mStream << ":";
+    }
+    if (printLine) {
+      *mStream << line;
+    }
+    *mStream << "]";
+  }
+
+  *mStream << PRINT_RESET << " ";
 }
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////
 
-std::ostream& Logger::debugImpl(const char* file, int line) {
-  return print(enableDebug, "[ILLUSION][D]", PRINT_BLUE, file, line);
+Logger::Record::~Record() {
+  auto&       stream = static_cast<std::ostringstream&>(*mStream);
+  std::string text   = stream.str();
+
+  // reset the thread's stream for the next record, including any formatting flags
+  if (!mOwnStream) {
+    static const std::ostringstream defaultStream;
+    stream.str("");
+    stream.clear();
+    stream.copyfmt(defaultStream);
+    tBuffer.mInUse = false;
+  }
+
+  if (writerDestroyed) {
+    std::cout << text << std::flush;
+    return;
+  }
+
+  auto& writer = getWriter();
+  writer.push(std::move(text));
+
+  // make sure that errors are visible, even if the application crashes right afterwards
+  if (mLevel == Level::eError) {
+    writer.flush();
+  }
 }
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////
 
-std::ostream& Logger::messageImpl(const char* file, int line) {
-  return print(enableMessage, "[ILLUSION][M]", PRINT_GREEN, file, line);
+Logger::Record& Logger::Record::operator<<(std::ostream& (*manipulator)(std::ostream&)) {
+  manipulator(*mStream);
+  return *this;
 }
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////
 
-std::ostream& Logger::warningImpl(const char* file, int line) {
-  return print(enableWarning, "[ILLUSION][W]", PRINT_YELLOW, file, line);
+Logger::Record& Logger::Record::operator<<(std::ios_base& (*manipulator)(std::ios_base&)) {
+  manipulator(*mStream);
+  return *this;
 }
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////
 
-std::ostream& Logger::errorImpl(const char* file, int line) {
-  return print(enableError, "[ILLUSION][E]", PRINT_RED, file, line);
+void Logger::flush() {
+  if (!writerDestroyed) {
+    getWriter().flush();
+  }
 }
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////
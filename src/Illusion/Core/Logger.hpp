@@ -9,15 +9,36 @@
 #ifndef ILLUSION_LOGGER_HPP
 #define ILLUSION_LOGGER_HPP
 
-#include <iosfwd>
+#include <memory>
+#include <ostream>
 #include <string>
 
+// Statements below this level are removed at compile time, see the macros at the bottom of this
+// file. The CMake variable ILLUSION_LOG_LEVEL sets this for all targets.
+#define ILLUSION_LOG_LEVEL_TRACE 0
+#define ILLUSION_LOG_LEVEL_DEBUG 1
+#define ILLUSION_LOG_LEVEL_MESSAGE 2
+#define ILLUSION_LOG_LEVEL_WARNING 3
+#define ILLUSION_LOG_LEVEL_ERROR 4
+#define ILLUSION_LOG_LEVEL_NONE 5
+
+#ifndef ILLUSION_LOG_LEVEL
+#define ILLUSION_LOG_LEVEL ILLUSION_LOG_LEVEL_TRACE
+#endif
+
 namespace Illusion::Core {
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////
 // Prints beautiful messages to the console output. You can use the macros at the bottom of this  //
 // file like this:                                                                                //
 // ILLUSION_MESSAGE << "hello world" << std::endl;                                                //
+// Each statement is one record. It is formatted into a buffer of the calling thread and pushed   //
+// to a lock-free queue when the statement ends; a background thread writes the records to        //
+// std::cout. Hence logging does not block the calling thread on console I/O and records of       //
+// different threads do not interleave. Error records are written before the statement returns.   //
+// Output written directly to std::cout may appear out of order; call flush() before if needed.   //
+// If a level is disabled at runtime, its statements only cost a branch - the operands are not    //
+// evaluated. Levels below ILLUSION_LOG_LEVEL are removed by the compiler altogether.             //
 ////////////////////////////////////////////////////////////////////////////////////////////////////
 
 class Logger {
@@ -51,23 +72,83 @@ class Logger {
   static bool enableWarning;
   static bool enableError;
 
-  // These are used by the marcos below. You can also use them directly, however using the macros
-  // might be a better idea.
-  static std::ostream& traceImpl(const char* file, int line);
-  static std::ostream& debugImpl(const char* file, int line);
-  static std::ostream& messageImpl(const char* file, int line);
-  static std::ostream& warningImpl(const char* file, int line);
-  static std::ostream& errorImpl(const char* file, int line);
+  enum class Level { eTrace, eDebug, eMessage, eWarning, eError };
+
+  // One log statement. The header is written by the constructor, the destructor hands the
+  // formatted text to the background thread. These are created by the macros below; you can also
+  // use them directly, however using the macros might be a better idea.
+  class Record {
+   public:
+    Record(Level level, const char* file, int line);
+    ~Record();
+
+    Record(Record const& other) = delete;
+    Record& operator=(Record const& other) = delete;
+
+    template <typename T>
+    Record& operator<<(T const& value) {
+      *mStream << value;
+      return *this;
+    }
+
+    // for manipulators like std::endl and std::fixed
+    Record& operator<<(std::ostream& (*manipulator)(std::ostream&));
+    Record& operator<<(std::ios_base& (*manipulator)(std::ios_base&));
+
+   private:
+    Level                         mLevel;
+    std::ostream*                 mStream;
+    std::unique_ptr<std::ostream> mOwnStream;
+  };
+
+  // Used by the macros to turn a Record expression into void.
+  struct Voidify {
+    void operator&(Record const&) const {
+    }
+  };
+
+  // Blocks until all records which have been logged so far are written to std::cout.
+  static void flush();
 };
 
 } // namespace Illusion::Core
 
 // Use these macros in your code like this:
-// LOG_MESSAGE << "hello world" << std::endl;
-#define ILLUSION_TRACE Illusion::Core::Logger::traceImpl(__FILE__, __LINE__)
-#define ILLUSION_DEBUG Illusion::Core::Logger::debugImpl(__FILE__, __LINE__)
-#define ILLUSION_MESSAGE Illusion::Core::Logger::messageImpl(__FILE__, __LINE__)
-#define ILLUSION_WARNING Illusion::Core::Logger::warningImpl(__FILE__, __LINE__)
-#define ILLUSION_ERROR Illusion::Core::Logger::errorImpl(__FILE__, __LINE__)
+// ILLUSION_MESSAGE << "hello world" << std::endl;
+#define ILLUSION_LOG_IMPL(level, enabled)                                                          \
+  !(enabled) ? (void)0                                                                             \
+             : Illusion::Core::Logger::Voidify() &                                                 \
+                   Illusion::Core::Logger::Record(                                                 \
+                       Illusion::Core::Logger::Level::level, __FILE__, __LINE__)
+
+#if ILLUSION_LOG_LEVEL <= ILLUSION_LOG_LEVEL_TRACE
+#define ILLUSION_TRACE ILLUSION_LOG_IMPL(eTrace, Illusion::Core::Logger::enableTrace)
+#else
+#define ILLUSION_TRACE ILLUSION_LOG_IMPL(eTrace, false)
+#endif
+
+#if ILLUSION_LOG_LEVEL <= ILLUSION_LOG_LEVEL_DEBUG
+#define ILLUSION_DEBUG ILLUSION_LOG_IMPL(eDebug, Illusion::Core::Logger::enableDebug)
+#else
+#define ILLUSION_DEBUG ILLUSION_LOG_IMPL(eDebug, false)
+#endif
+
+#if ILLUSION_LOG_LEVEL <= ILLUSION_LOG_LEVEL_MESSAGE
+#define ILLUSION_MESSAGE ILLUSION_LOG_IMPL(eMessage, Illusion::Core::Logger::enableMessage)
+#else
+#define ILLUSION_MESSAGE ILLUSION_LOG_IMPL(eMessage, false)
+#endif
+
+#if ILLUSION_LOG_LEVEL <= ILLUSION_LOG_LEVEL_WARNING
+#define ILLUSION_WARNING ILLUSION_LOG_IMPL(eWarning, Illusion::Core::Logger::enableWarning)
+#else
+#define ILLUSION_WARNING ILLUSION_LOG_IMPL(eWarning, false)
+#endif
+
+#if ILLUSION_LOG_LEVEL <= ILLUSION_LOG_LEVEL_ERROR
+#define ILLUSION_ERROR ILLUSION_LOG_IMPL(eError, Illusion::Core::Logger::enableError)
+#else
+#define ILLUSION_ERROR ILLUSION_LOG_IMPL(eError, false)
+#endif
 
 #endif // ILLUSION_LOGGER_HPP
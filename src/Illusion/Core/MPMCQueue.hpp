@@ -0,0 +1,176 @@
+////////////////////////////////////////////////////////////////////////////////////////////////////
+//                                                                                                //
+//    _)  |  |            _)                This code may be used and modified under the terms    //
+//     |  |  |  |  | (_-<  |   _ \    \     of the MIT license. See the LICENSE file for details. //
+//    _| _| _| \_,_| ___/ _| \___/ _| _|    Copyright (c) 2018-2019 Simon Schneegans              //
+//                                                                                                //
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#ifndef ILLUSION_CORE_MPMC_QUEUE_HPP
+#define ILLUSION_CORE_MPMC_QUEUE_HPP
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+
+namespace Illusion::Core {
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// A bounded lock-free queue for multiple producer and multiple consumer threads. The elements    //
+// are stored in a ring of cells; each cell has a sequence number which tells whether it can be   //
+// written or read in the current round. A producer (or consumer) claims a cell by advancing the  //
+// enqueue (or dequeue) position with a compare-and-swap and then moves its element in or out,    //
+// so threads never wait for each other's locks. The batch versions of push() and pop() claim     //
+// several consecutive cells with one compare-and-swap.                                           //
+// The capacity is rounded up to the next power of two. T has to be default constructible; the    //
+// elements are moved into and out of the cells.                                                  //
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+template <typename T>
+class MPMCQueue {
+
+ public:
+  explicit MPMCQueue(size_t capacity) {
+    size_t size = 1;
+    while (size < capacity) {
+      size *= 2;
+    }
+
+    mMask  = size - 1;
+    mCells = std::make_unique<Cell[]>(size);
+
+    for (size_t i = 0; i < size; ++i) {
+      mCells[i].mSequence.store(i, std::memory_order_relaxed);
+    }
+  }
+
+  MPMCQueue(MPMCQueue const& other) = delete;
+  MPMCQueue& operator=(MPMCQueue const& other) = delete;
+
+  // Returns false if the queue is full.
+  bool push(T const& value) {
+    T copy(value);
+    return push(&copy, 1) == 1;
+  }
+
+  bool push(T&& value) {
+    return push(&value, 1) == 1;
+  }
+
+  // Moves up to count elements from values into the queue and returns the number of elements which
+  // have been pushed; this is less than count if the queue is full.
+  size_t push(T* values, size_t count) {
+    size_t position = mEnqueuePosition.load(std::memory_order_relaxed);
+
+    while (true) {
+      // count the consecutive cells which are free in this round
+      size_t available = 0;
+      while (available < count && isReady(position + available, 0)) {
+        ++available;
+      }
+
+      if (available == 0) {
+        // if the first cell is still used by a consumer of the previous round, the queue is full;
+        // else another producer has claimed it already
+        if (getDistance(position, 0) < 0) {
+          return 0;
+        }
+        position = mEnqueuePosition.load(std::memory_order_relaxed);
+        continue;
+      }
+
+      if (mEnqueuePosition.compare_exchange_weak(
+              position, position + available, std::memory_order_relaxed)) {
+        for (size_t i = 0; i < available; ++i) {
+          Cell& cell = mCells[(position + i) & mMask];
+          cell.mData = std::move(values[i]);
+          cell.mSequence.store(position + i + 1, std::memory_order_release);
+        }
+        return available;
+      }
+    }
+  }
+
+  // Returns false if the queue is empty.
+  bool pop(T& value) {
+    return pop(&value, 1) == 1;
+  }
+
+  // Moves up to count elements from the queue to values and returns the number of elements which
+  // have been popped; this is less than count if the queue contains fewer elements.
+  size_t pop(T* values, size_t count) {
+    size_t position = mDequeuePosition.load(std::memory_order_relaxed);
+
+    while (true) {
+      // count the consecutive cells which have been written in this round
+      size_t available = 0;
+      while (available < count && isReady(position + available, 1)) {
+        ++available;
+      }
+
+      if (available == 0) {
+        // if the first cell has not been written yet, the queue is empty; else another consumer
+        // has claimed it already
+        if (getDistance(position, 1) < 0) {
+          return 0;
+        }
+        position = mDequeuePosition.load(std::memory_order_relaxed);
+        continue;
+      }
+
+      if (mDequeuePosition.compare_exchange_weak(
+              position, position + available, std::memory_order_relaxed)) {
+        for (size_t i = 0; i < available; ++i) {
+          Cell& cell = mCells[(position + i) & mMask];
+          values[i]  = std::move(cell.mData);
+          cell.mSequence.store(position + i + mMask + 1, std::memory_order_release);
+        }
+        return available;
+      }
+    }
+  }
+
+  // The result is only a snapshot, as other threads may push or pop concurrently.
+  bool empty() const {
+    return size() == 0;
+  }
+
+  size_t size() const {
+    size_t enqueue = mEnqueuePosition.load(std::memory_order_relaxed);
+    size_t dequeue = mDequeuePosition.load(std::memory_order_relaxed);
+    return enqueue > dequeue ? enqueue - dequeue : 0;
+  }
+
+  size_t capacity() const {
+    return mMask + 1;
+  }
+
+ private:
+  // A cell at position p can be written if its sequence is p and read if its sequence is p + 1.
+  struct Cell {
+    std::atomic<size_t> mSequence;
+    T                   mData;
+  };
+
+  // Returns the difference between the sequence of the cell at the given position and position +
+  // offset. It is zero if the cell is ready and negative if it is still used by the last round.
+  std::ptrdiff_t getDistance(size_t position, size_t offset) const {
+    return static_cast<std::ptrdiff_t>(
+        mCells[position & mMask].mSequence.load(std::memory_order_acquire) - (position + offset));
+  }
+
+  bool isReady(size_t position, size_t offset) const {
+    return getDistance(position, offset) == 0;
+  }
+
+  std::unique_ptr<Cell[]> mCells;
+  size_t                  mMask = 0;
+
+  // the positions are on separate cache lines, so that producers and consumers do not interfere
+  alignas(64) std::atomic<size_t> mEnqueuePosition{0};
+  alignas(64) std::atomic<size_t> mDequeuePosition{0};
+};
+
+} // namespace Illusion::Core
+
+#endif // ILLUSION_CORE_MPMC_QUEUE_HPP
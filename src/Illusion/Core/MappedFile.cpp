@@ -0,0 +1,139 @@
+////////////////////////////////////////////////////////////////////////////////////////////////////
+//                                                                                                //
+//    _)  |  |            _)                This code may be used and modified under the terms    //
+//     |  |  |  |  | (_-<  |   _ \    \     of the MIT license. See the LICENSE file for details. //
+//    _| _| _| \_,_| ___/ _| \___/ _| _|    Copyright (c) 2018-2019 Simon Schneegans              //
+//                                                                                                //
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include "MappedFile.hpp"
+
+#include <algorithm>
+
+#ifdef WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace Illusion::Core {
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+MappedFile::MappedFile(std::string const& fileName) {
+#ifdef WIN32
+  HANDLE file = CreateFileA(fileName.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+      FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+
+  if (file == INVALID_HANDLE_VALUE) {
+    return;
+  }
+
+  LARGE_INTEGER size;
+  if (!GetFileSizeEx(file, &size) || size.QuadPart == 0) {
+    CloseHandle(file);
+    return;
+  }
+
+  HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+  if (!mapping) {
+    CloseHandle(file);
+    return;
+  }
+
+  mData    = static_cast<uint8_t const*>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+  mFile    = file;
+  mMapping = mapping;
+
+  if (mData) {
+    mSize = static_cast<size_t>(size.QuadPart);
+  }
+#else
+  int file = open(fileName.c_str(), O_RDONLY);
+
+  if (file < 0) {
+    return;
+  }
+
+  struct stat info;
+  if (fstat(file, &info) == 0 && info.st_size > 0) {
+    void* data = mmap(nullptr, info.st_size, PROT_READ, MAP_PRIVATE, file, 0);
+
+    if (data != MAP_FAILED) {
+      madvise(data, info.st_size, MADV_SEQUENTIAL);
+      mData = static_cast<uint8_t const*>(data);
+      mSize = static_cast<size_t>(info.st_size);
+    }
+  }
+
+  // the mapping stays valid after the file has been closed
+  close(file);
+#endif
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+MappedFile::~MappedFile() {
+#ifdef WIN32
+  if (mData) {
+    UnmapViewOfFile(mData);
+  }
+  if (mMapping) {
+    CloseHandle(mMapping);
+  }
+  if (mFile) {
+    CloseHandle(mFile);
+  }
+#else
+  if (mData) {
+    munmap(const_cast<uint8_t*>(mData), mSize);
+  }
+#endif
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+bool MappedFile::isValid() const {
+  return mData != nullptr;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+uint8_t const* MappedFile::getData() const {
+  return mData;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+size_t MappedFile::getSize() const {
+  return mSize;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void MappedFile::prefetch(size_t offset, size_t size) const {
+  if (!mData || offset >= mSize) {
+    return;
+  }
+
+  size = std::min(size, mSize - offset);
+
+#ifdef WIN32
+  WIN32_MEMORY_RANGE_ENTRY range;
+  range.VirtualAddress = const_cast<uint8_t*>(mData + offset);
+  range.NumberOfBytes  = size;
+  PrefetchVirtualMemory(GetCurrentProcess(), 1, &range, 0);
+#else
+  // madvise() requires a page-aligned address; the mapping itself starts at a page boundary
+  size_t pageSize = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+  size_t begin    = offset / pageSize * pageSize;
+  madvise(const_cast<uint8_t*>(mData + begin), offset + size - begin, MADV_WILLNEED);
+#endif
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+} // namespace Illusion::Core
@@ -0,0 +1,60 @@
+////////////////////////////////////////////////////////////////////////////////////////////////////
+//                                                                                                //
+//    _)  |  |            _)                This code may be used and modified under the terms    //
+//     |  |  |  |  | (_-<  |   _ \    \     of the MIT license. See the LICENSE file for details. //
+//    _| _| _| \_,_| ___/ _| \___/ _| _|    Copyright (c) 2018-2019 Simon Schneegans              //
+//                                                                                                //
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#ifndef ILLUSION_CORE_MAPPED_FILE_HPP
+#define ILLUSION_CORE_MAPPED_FILE_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace Illusion::Core {
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// A read-only view of a file which is mapped into the address space of the process. Pages are    //
+// loaded by the operating system when they are accessed for the first time, so data can be       //
+// copied directly from the file to its destination (e.g. staging memory) without reading it into //
+// an intermediate buffer first. The file must not be modified while it is mapped.                //
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+class MappedFile {
+
+ public:
+  // Maps the given file. If this fails (for example because the file does not exist or is empty),
+  // isValid() returns false.
+  explicit MappedFile(std::string const& fileName);
+  virtual ~MappedFile();
+
+  MappedFile(MappedFile const& other) = delete;
+  MappedFile& operator=(MappedFile const& other) = delete;
+
+  bool isValid() const;
+
+  // The data is valid as long as this MappedFile exists.
+  uint8_t const* getData() const;
+  size_t         getSize() const;
+
+  // Asks the operating system to read the given range of the file in the background, this returns
+  // immediately. Accessing the range afterwards does not block on disc I/O once the read has
+  // finished. The ChunkedReader uses this to load the next chunk of a large file while the current
+  // one is copied to staging memory. The range is clamped to the size of the file.
+  void prefetch(size_t offset, size_t size) const;
+
+ private:
+  uint8_t const* mData = nullptr;
+  size_t         mSize = 0;
+
+#ifdef WIN32
+  void* mFile    = nullptr;
+  void* mMapping = nullptr;
+#endif
+};
+
+} // namespace Illusion::Core
+
+#endif // ILLUSION_CORE_MAPPED_FILE_HPP
@@ -9,6 +9,7 @@
 #ifndef ILLUSION_CORE_PROPERTY_HPP
 #define ILLUSION_CORE_PROPERTY_HPP
 
+#include "ChangeBatch.hpp"
 #include "Signal.hpp"
 
 #include <glm/glm.hpp>
@@ -44,7 +45,11 @@ class Property {
       : mValue(std::move(toCopy.mValue)) {
   }
 
-  virtual ~Property() = default;
+  virtual ~Property() {
+    if (mPendingBatch) {
+      mPendingBatch->remove(this);
+    }
+  }
 
   // Returns a Signal which is fired when the internal value will be changed.
   // The old value is passed as parameter.
@@ -58,9 +63,26 @@ class Property {
     return mOnChange;
   }
 
-  // Sets the Property to a new value. beforeChange() and onChange() will be emitted.
+  // Sets the Property to a new value. beforeChange() and onChange() will be emitted. If there is
+  // a ChangeBatch on the calling thread, they are emitted once when it is flushed.
   virtual void set(T const& value) {
     if (value != mValue) {
+      ChangeBatch* batch = ChangeBatch::getCurrent();
+
+      if (batch) {
+        mValue = value;
+
+        if (!mPendingBatch) {
+          mPendingBatch = batch;
+          batch->add(this, [this]() {
+            mPendingBatch = nullptr;
+            touch();
+          });
+        }
+
+        return;
+      }
+
       mBeforeChange.emit(value);
       mValue = value;
       mOnChange.emit(value);
@@ -154,6 +176,9 @@ class Property {
 
   Property<T> const* mConnection   = nullptr;
   int                mConnectionId = -1;
+
+  // The ChangeBatch which will emit the Signals of this Property, if any.
+  ChangeBatch* mPendingBatch = nullptr;
 };
 
 // stream operators
@@ -0,0 +1,117 @@
+////////////////////////////////////////////////////////////////////////////////////////////////////
+//                                                                                                //
+//    _)  |  |            _)                This code may be used and modified under the terms    //
+//     |  |  |  |  | (_-<  |   _ \    \     of the MIT license. See the LICENSE file for details. //
+//    _| _| _| \_,_| ___/ _| \___/ _| _|    Copyright (c) 2018-2019 Simon Schneegans              //
+//                                                                                                //
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#ifndef ILLUSION_CORE_SPSC_QUEUE_HPP
+#define ILLUSION_CORE_SPSC_QUEUE_HPP
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <memory>
+
+namespace Illusion::Core {
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// A bounded lock-free queue for exactly one producer and one consumer thread. This is cheaper    //
+// than the MPMCQueue, as no compare-and-swap is required: the producer only writes the write     //
+// position and the consumer only writes the read position.                                       //
+// The capacity is rounded up to the next power of two. T has to be default constructible; the    //
+// elements are moved into and out of the ring.                                                   //
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+template <typename T>
+class SPSCQueue {
+
+ public:
+  explicit SPSCQueue(size_t capacity) {
+    size_t size = 1;
+    while (size < capacity) {
+      size *= 2;
+    }
+
+    mMask     = size - 1;
+    mElements = std::make_unique<T[]>(size);
+  }
+
+  SPSCQueue(SPSCQueue const& other) = delete;
+  SPSCQueue& operator=(SPSCQueue const& other) = delete;
+
+  // Returns false if the queue is full. This must only be called by the producer thread.
+  bool push(T const& value) {
+    T copy(value);
+    return push(&copy, 1) == 1;
+  }
+
+  bool push(T&& value) {
+    return push(&value, 1) == 1;
+  }
+
+  // Moves up to count elements from values into the queue and returns the number of elements which
+  // have been pushed; this is less than count if the queue is full.
+  size_t push(T* values, size_t count) {
+    size_t write = mWritePosition.load(std::memory_order_relaxed);
+    size_t read  = mReadPosition.load(std::memory_order_acquire);
+
+    count = std::min(count, mMask + 1 - (write - read));
+
+    for (size_t i = 0; i < count; ++i) {
+      mElements[(write + i) & mMask] = std::move(values[i]);
+    }
+
+    mWritePosition.store(write + count, std::memory_order_release);
+    return count;
+  }
+
+  // Returns false if the queue is empty. This must only be called by the consumer thread.
+  bool pop(T& value) {
+    return pop(&value, 1) == 1;
+  }
+
+  // Moves up to count elements from the queue to values and returns the number of elements which
+  // have been popped; this is less than count if the queue contains fewer elements.
+  size_t pop(T* values, size_t count) {
+    size_t read  = mReadPosition.load(std::memory_order_relaxed);
+    size_t write = mWritePosition.load(std::memory_order_acquire);
+
+    count = std::min(count, write - read);
+
+    for (size_t i = 0; i < count; ++i) {
+      values[i] = std::move(mElements[(read + i) & mMask]);
+    }
+
+    mReadPosition.store(read + count, std::memory_order_release);
+    return count;
+  }
+
+  // The result is only a snapshot, as the other thread may push or pop concurrently.
+  bool empty() const {
+    return size() == 0;
+  }
+
+  size_t size() const {
+    return mWritePosition.load(std::memory_order_acquire) -
+           mReadPosition.load(std::memory_order_acquire);
+  }
+
+  size_t capacity() const {
+    return mMask + 1;
+  }
+
+ private:
+  std::unique_ptr<T[]> mElements;
+  size_t               mMask = 0;
+
+  // the positions are on separate cache lines, so that the producer and the consumer do not
+  // interfere
+  alignas(64) std::atomic<size_t> mWritePosition{0};
+  alignas(64) std::atomic<size_t> mReadPosition{0};
+};
+
+} // namespace Illusion::Core
+
+#endif // ILLUSION_CORE_SPSC_QUEUE_HPP
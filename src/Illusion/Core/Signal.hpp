@@ -9,9 +9,13 @@
 #ifndef ILLUSION_CORE_SIGNAL_HPP
 #define ILLUSION_CORE_SIGNAL_HPP
 
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
 #include <functional>
-#include <map>
+#include <memory>
 #include <mutex>
+#include <vector>
 
 namespace Illusion::Core {
 
@@ -21,6 +25,13 @@ namespace Illusion::Core {
 // argument passed to emit() will be passed to the given function. Connect and disconnect methods //
 // may be called from different threads, but the callbacks will be called from the thread calling //
 // emit().                                                                                        //
+// The connected callbacks are stored in an immutable vector which is replaced whenever a         //
+// callback is connected or disconnected (copy-on-write). emit() does not lock anything: it       //
+// registers itself in an atomic counter, loads the current vector through an atomic pointer and  //
+// calls the callbacks in the order of connection. Replaced vectors are retired under mMutex and  //
+// freed by a later connect() or disconnect() which finds no emit() in flight, or by the          //
+// destructor. Callbacks may connect and disconnect callbacks of the same Signal, this affects    //
+// the next emit(). Signals without callbacks return from emit() after a single atomic load.      //
 ////////////////////////////////////////////////////////////////////////////////////////////////////
 
 template <typename... Parameters>
@@ -33,44 +44,65 @@ class Signal {
   Signal(Signal const& other) {
   }
 
+  ~Signal() {
+    delete mSlots.load();
+    for (auto slots : mRetired) {
+      delete slots;
+    }
+  }
+
   // connects a member function of a given object to this Signal
   template <typename F, typename... Args>
   int connectMember(F&& f, Args&&... a) const {
-    std::unique_lock<std::mutex> lock(mMutex);
-    mCallbacks.insert(std::make_pair(++mCurrentId, std::bind(f, a...)));
-    return mCurrentId;
+    return connect(std::bind(f, a...));
   }
 
   // connects a std::function to the signal. The returned value can be used to
   // disconnect the function again
   int connect(std::function<bool(Parameters...)> const& callback) const {
     std::unique_lock<std::mutex> lock(mMutex);
-    mCallbacks.insert(std::make_pair(++mCurrentId, callback));
+    auto                         slots = copySlots();
+    slots->push_back({++mCurrentId, callback});
+    storeSlots(std::move(slots));
     return mCurrentId;
   }
 
   // disconnects a previously connected function
   void disconnect(int id) const {
     std::unique_lock<std::mutex> lock(mMutex);
-    mCallbacks.erase(id);
+    auto                         slots = copySlots();
+    slots->erase(std::remove_if(slots->begin(), slots->end(),
+                     [id](Slot const& slot) { return slot.mId == id; }),
+        slots->end());
+    storeSlots(std::move(slots));
   }
 
   // disconnects all previously connected functions
   void disconnectAll() const {
     std::unique_lock<std::mutex> lock(mMutex);
-    mCallbacks.clear();
+    storeSlots(nullptr);
     mCurrentId = 0;
   }
 
-  // calls all connected functions
+  // calls all connected functions; those which return false are disconnected
   void emit(Parameters... p) {
-    std::unique_lock<std::mutex> lock(mMutex);
-    auto                         it(mCallbacks.begin());
-    while (it != mCallbacks.end()) {
-      if (it->second(p...)) {
-        ++it;
-      } else {
-        it = mCallbacks.erase(it);
+    if (mSlots.load(std::memory_order_acquire) == nullptr) {
+      return;
+    }
+
+    // The counter has to be incremented before the pointer is loaded: storeSlots() publishes the
+    // new vector before it reads the counter, so either it sees this emit() and keeps the retired
+    // vectors, or this emit() loads the new vector. Hence these four operations are sequentially
+    // consistent.
+    EmitGuard guard(mEmitting);
+
+    Slots const* slots = mSlots.load();
+
+    if (slots) {
+      for (auto const& slot : *slots) {
+        if (!slot.mCallback(p...)) {
+          disconnect(slot.mId);
+        }
       }
     }
   }
@@ -78,11 +110,62 @@ class Signal {
   // assignment creates new Signal
   Signal& operator=(Signal const& other) {
     disconnectAll();
+    return *this;
   }
 
  private:
-  mutable std::map<int, std::function<bool(Parameters...)>> mCallbacks;
-  mutable int                                               mCurrentId = 0;
+  struct Slot {
+    int                                mId;
+    std::function<bool(Parameters...)> mCallback;
+  };
+
+  typedef std::vector<Slot> Slots;
+
+  // Counts an emit() as in flight for its lifetime, even if a callback throws.
+  struct EmitGuard {
+    explicit EmitGuard(std::atomic<uint32_t>& counter)
+        : mCounter(counter) {
+      mCounter.fetch_add(1);
+    }
+
+    ~EmitGuard() {
+      mCounter.fetch_sub(1, std::memory_order_release);
+    }
+
+    std::atomic<uint32_t>& mCounter;
+  };
+
+  // These must only be called while mMutex is locked.
+  std::unique_ptr<Slots> copySlots() const {
+    Slots const* slots = mSlots.load(std::memory_order_relaxed);
+    return slots ? std::make_unique<Slots>(*slots) : std::make_unique<Slots>();
+  }
+
+  void storeSlots(std::unique_ptr<Slots>&& slots) const {
+    if (slots && slots->empty()) {
+      slots.reset();
+    }
+
+    Slots const* oldSlots = mSlots.exchange(slots.release());
+
+    if (oldSlots) {
+      mRetired.push_back(oldSlots);
+    }
+
+    // Emits which start after the exchange above load the new vector, which is not retired. So if
+    // no emit() is in flight now, nobody can read the retired vectors anymore.
+    if (mEmitting.load() == 0) {
+      for (auto retired : mRetired) {
+        delete retired;
+      }
+      mRetired.clear();
+    }
+  }
+
+  mutable std::atomic<Slots const*> mSlots{nullptr};
+  mutable std::atomic<uint32_t>     mEmitting{0};
+  mutable std::vector<Slots const*> mRetired;
+  mutable int                       mCurrentId = 0;
 
   mutable std::mutex mMutex;
 };
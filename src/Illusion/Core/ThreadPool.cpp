@@ -0,0 +1,126 @@
+////////////////////////////////////////////////////////////////////////////////////////////////////
+//                                                                                                //
+//    _)  |  |            _)                This code may be used and modified under the terms    //
+//     |  |  |  |  | (_-<  |   _ \    \     of the MIT license. See the LICENSE file for details. //
+//    _| _| _| \_,_| ___/ _| \___/ _| _|    Copyright (c) 2018-2019 Simon Schneegans              //
+//                                                                                                //
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include "ThreadPool.hpp"
+
+#include "Logger.hpp"
+
+#include <algorithm>
+
+namespace Illusion::Core {
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+ThreadPool& ThreadPool::getShared() {
+  static ThreadPool threadPool;
+  return threadPool;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+uint32_t ThreadPool::getDefaultThreadCount() {
+  uint32_t cores = std::thread::hardware_concurrency();
+  cores          = cores > 1 ? cores - 1 : 1u;
+  return std::max(cores / 2, 1u);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+ThreadPool::ThreadPool(uint32_t threadCount) {
+  if (threadCount == 0) {
+    threadCount = getDefaultThreadCount();
+  }
+
+  for (uint32_t i = 0; i < threadCount; ++i) {
+    mThreads.emplace_back([this]() { work(); });
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+ThreadPool::~ThreadPool() {
+  {
+    std::unique_lock<std::mutex> lock(mMutex);
+    mStop = true;
+  }
+
+  mTasksCondition.notify_all();
+
+  for (auto& thread : mThreads) {
+    thread.join();
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void ThreadPool::enqueue(std::function<void()> const& task) {
+  {
+    std::unique_lock<std::mutex> lock(mMutex);
+    mTasks.push(task);
+    ++mPendingTasks;
+  }
+
+  mTasksCondition.notify_one();
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void ThreadPool::waitIdle() {
+  std::unique_lock<std::mutex> lock(mMutex);
+  mIdleCondition.wait(lock, [this]() { return mPendingTasks == 0; });
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+uint32_t ThreadPool::getPendingTaskCount() const {
+  std::unique_lock<std::mutex> lock(mMutex);
+  return mPendingTasks;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+uint32_t ThreadPool::getThreadCount() const {
+  return static_cast<uint32_t>(mThreads.size());
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void ThreadPool::work() {
+  while (true) {
+    std::function<void()> task;
+
+    {
+      std::unique_lock<std::mutex> lock(mMutex);
+      mTasksCondition.wait(lock, [this]() { return mStop || !mTasks.empty(); });
+
+      if (mStop) {
+        return;
+      }
+
+      task = std::move(mTasks.front());
+      mTasks.pop();
+    }
+
+    try {
+      task();
+    } catch (std::exception const& e) {
+      ILLUSION_ERROR << "Task of ThreadPool failed: " << e.what() << std::endl;
+    }
+
+    {
+      std::unique_lock<std::mutex> lock(mMutex);
+      --mPendingTasks;
+    }
+
+    mIdleCondition.notify_all();
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+} // namespace Illusion::Core
@@ -0,0 +1,72 @@
+////////////////////////////////////////////////////////////////////////////////////////////////////
+//                                                                                                //
+//    _)  |  |            _)                This code may be used and modified under the terms    //
+//     |  |  |  |  | (_-<  |   _ \    \     of the MIT license. See the LICENSE file for details. //
+//    _| _| _| \_,_| ___/ _| \___/ _| _|    Copyright (c) 2018-2019 Simon Schneegans              //
+//                                                                                                //
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#ifndef ILLUSION_CORE_THREAD_POOL_HPP
+#define ILLUSION_CORE_THREAD_POOL_HPP
+
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <vector>
+
+namespace Illusion::Core {
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// A simple pool of worker threads which execute enqueued tasks in FIFO order. Exceptions thrown  //
+// by tasks are caught and logged. Background tasks should be enqueued to getShared() instead of  //
+// creating more ThreadPools, which would oversubscribe the cores. When the ThreadPool is         //
+// destroyed, tasks which have not been started yet are discarded and the destructor blocks until //
+// all running tasks have finished.                                                               //
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+class ThreadPool {
+
+ public:
+  // If threadCount is zero, half of the cores which are not used by the calling thread are used
+  // (but at least one thread). A JobSystem uses the other half by default, so that both can be
+  // busy at the same time without oversubscribing the cores.
+  explicit ThreadPool(uint32_t threadCount = 0);
+  virtual ~ThreadPool();
+
+  // The background tasks of the Graphics module, like loading Gltf::Models or compiling Shaders,
+  // are executed by this ThreadPool. It is created with the default number of threads on first
+  // use.
+  static ThreadPool& getShared();
+
+  // Returns the number of threads a ThreadPool uses if threadCount is zero.
+  static uint32_t getDefaultThreadCount();
+
+  // The task will be executed by one of the worker threads.
+  void enqueue(std::function<void()> const& task);
+
+  // Blocks until all enqueued tasks have been executed.
+  void waitIdle();
+
+  // Returns the number of tasks which have been enqueued but not finished yet.
+  uint32_t getPendingTaskCount() const;
+
+  uint32_t getThreadCount() const;
+
+ private:
+  void work();
+
+  std::vector<std::thread>          mThreads;
+  std::queue<std::function<void()>> mTasks;
+  uint32_t                          mPendingTasks = 0;
+  bool                              mStop         = false;
+
+  mutable std::mutex      mMutex;
+  std::condition_variable mTasksCondition;
+  std::condition_variable mIdleCondition;
+};
+
+} // namespace Illusion::Core
+
+#endif // ILLUSION_CORE_THREAD_POOL_HPP
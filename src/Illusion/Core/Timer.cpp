@@ -50,9 +50,10 @@ bool Timer::isRunning() const {
 ////////////////////////////////////////////////////////////////////////////////////////////////////
 
 double Timer::getNow() {
-  auto time       = std::chrono::system_clock::now();
+  // the steady clock is not affected by adjustments of the system time
+  auto time       = std::chrono::steady_clock::now();
   auto sinceEpoch = time.time_since_epoch();
-  return std::chrono::duration_cast<std::chrono::microseconds>(sinceEpoch).count() * 0.000001;
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(sinceEpoch).count() * 1e-9;
 }
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////
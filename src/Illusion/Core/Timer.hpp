@@ -28,6 +28,7 @@ class Timer {
 
   bool isRunning() const;
 
+  // In seconds, with nanosecond resolution. This is only meaningful relative to other values.
   static double getNow();
 
  private:
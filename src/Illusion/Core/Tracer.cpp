@@ -0,0 +1,223 @@
+////////////////////////////////////////////////////////////////////////////////////////////////////
+//                                                                                                //
+//    _)  |  |            _)                This code may be used and modified under the terms    //
+//     |  |  |  |  | (_-<  |   _ \    \     of the MIT license. See the LICENSE file for details. //
+//    _| _| _| \_,_| ___/ _| \___/ _| _|    Copyright (c) 2018-2019 Simon Schneegans              //
+//                                                                                                //
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include "Tracer.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <fstream>
+#include <iomanip>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <vector>
+
+namespace Illusion::Core {
+
+namespace {
+
+// One recorded zone, the times are in nanoseconds.
+struct Event {
+  char const* mName;
+  int64_t     mStart;
+  int64_t     mDuration;
+};
+
+// The zones of one thread. The mutex is only contended while the zones are exported or cleared.
+struct ThreadBuffer {
+  std::mutex         mMutex;
+  std::vector<Event> mEvents;
+  size_t             mNext    = 0;
+  bool               mWrapped = false;
+  std::string        mName;
+  uint32_t           mThreadId = 0;
+};
+
+std::atomic<bool>     enabled{true};
+std::atomic<uint32_t> bufferSize{65536};
+
+// The buffers outlive their threads, so that the zones of finished threads can be exported.
+std::mutex& getRegistryMutex() {
+  static std::mutex mutex;
+  return mutex;
+}
+
+std::vector<std::shared_ptr<ThreadBuffer>>& getRegistry() {
+  static std::vector<std::shared_ptr<ThreadBuffer>> registry;
+  return registry;
+}
+
+thread_local std::shared_ptr<ThreadBuffer> tBuffer;
+
+ThreadBuffer& getThreadBuffer() {
+  if (!tBuffer) {
+    tBuffer = std::make_shared<ThreadBuffer>();
+    tBuffer->mEvents.resize(std::max(bufferSize.load(), 1u));
+
+    std::unique_lock<std::mutex> lock(getRegistryMutex());
+    tBuffer->mThreadId = static_cast<uint32_t>(getRegistry().size());
+    tBuffer->mName     = "Thread " + std::to_string(tBuffer->mThreadId);
+    getRegistry().push_back(tBuffer);
+  }
+
+  return *tBuffer;
+}
+
+int64_t getNow() {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+      std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+void writeEscaped(std::ostream& os, std::string const& value) {
+  os << '"';
+  for (char c : value) {
+    if (c == '"' || c == '\\') {
+      os << '\\' << c;
+    } else if (static_cast<unsigned char>(c) >= 0x20) {
+      os << c;
+    }
+  }
+  os << '"';
+}
+
+} // namespace
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+Tracer::Zone::Zone(char const* name)
+    : mName(name)
+    , mStart(enabled.load(std::memory_order_relaxed) ? getNow() : -1) {
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+Tracer::Zone::~Zone() {
+  if (mStart < 0) {
+    return;
+  }
+
+  int64_t duration = getNow() - mStart;
+  auto&   buffer   = getThreadBuffer();
+
+  std::unique_lock<std::mutex> lock(buffer.mMutex);
+  buffer.mEvents[buffer.mNext] = {mName, mStart, duration};
+
+  if (++buffer.mNext == buffer.mEvents.size()) {
+    buffer.mNext    = 0;
+    buffer.mWrapped = true;
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void Tracer::setEnabled(bool value) {
+  enabled = value;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+bool Tracer::getEnabled() {
+  return enabled;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void Tracer::setBufferSize(uint32_t zones) {
+  bufferSize = zones;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+uint32_t Tracer::getBufferSize() {
+  return bufferSize;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void Tracer::setThreadName(std::string const& name) {
+  auto&                        buffer = getThreadBuffer();
+  std::unique_lock<std::mutex> lock(buffer.mMutex);
+  buffer.mName = name;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void Tracer::writeChromeTrace(std::string const& fileName) {
+  std::ofstream file(fileName);
+
+  if (!file) {
+    throw std::runtime_error("Failed to write trace to \"" + fileName + "\"!");
+  }
+
+  std::vector<std::shared_ptr<ThreadBuffer>> buffers;
+  {
+    std::unique_lock<std::mutex> lock(getRegistryMutex());
+    buffers = getRegistry();
+  }
+
+  // The timestamps are given in microseconds, relative to the first zone.
+  int64_t origin = INT64_MAX;
+
+  for (auto const& buffer : buffers) {
+    std::unique_lock<std::mutex> lock(buffer->mMutex);
+    size_t count = buffer->mWrapped ? buffer->mEvents.size() : buffer->mNext;
+    for (size_t i = 0; i < count; ++i) {
+      origin = std::min(origin, buffer->mEvents[i].mStart);
+    }
+  }
+
+  file << "{\"traceEvents\":[" << std::endl;
+  file << std::fixed << std::setprecision(3);
+
+  bool first = true;
+
+  for (auto const& buffer : buffers) {
+    std::unique_lock<std::mutex> lock(buffer->mMutex);
+
+    file << (first ? "" : ",\n") << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":"
+         << buffer->mThreadId << ",\"args\":{\"name\":";
+    writeEscaped(file, buffer->mName);
+    file << "}}";
+    first = false;
+
+    // the oldest zone is at mNext once the ring has been wrapped
+    size_t count = buffer->mWrapped ? buffer->mEvents.size() : buffer->mNext;
+    size_t begin = buffer->mWrapped ? buffer->mNext : 0;
+
+    for (size_t i = 0; i < count; ++i) {
+      auto const& event = buffer->mEvents[(begin + i) % buffer->mEvents.size()];
+
+      file << ",\n{\"name\":";
+      writeEscaped(file, event.mName);
+      file << ",\"ph\":\"X\",\"pid\":0,\"tid\":" << buffer->mThreadId
+           << ",\"ts\":" << (event.mStart - origin) * 0.001
+           << ",\"dur\":" << event.mDuration * 0.001 << "}";
+    }
+  }
+
+  file << std::endl << "]}" << std::endl;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void Tracer::clear() {
+  std::unique_lock<std::mutex> lock(getRegistryMutex());
+
+  for (auto const& buffer : getRegistry()) {
+    std::unique_lock<std::mutex> bufferLock(buffer->mMutex);
+    buffer->mNext    = 0;
+    buffer->mWrapped = false;
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+} // namespace Illusion::Core
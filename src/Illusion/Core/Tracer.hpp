@@ -0,0 +1,79 @@
+////////////////////////////////////////////////////////////////////////////////////////////////////
+//                                                                                                //
+//    _)  |  |            _)                This code may be used and modified under the terms    //
+//     |  |  |  |  | (_-<  |   _ \    \     of the MIT license. See the LICENSE file for details. //
+//    _| _| _| \_,_| ___/ _| \___/ _| _|    Copyright (c) 2018-2019 Simon Schneegans              //
+//                                                                                                //
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#ifndef ILLUSION_CORE_TRACER_HPP
+#define ILLUSION_CORE_TRACER_HPP
+
+#include <cstdint>
+#include <string>
+
+namespace Illusion::Core {
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// The Tracer records when named zones of code begin and end, so that many frames can be examined //
+// in a timeline viewer afterwards. You can use the macro at the bottom of this file like this:   //
+// ILLUSION_ZONE("Upload Textures");                                                              //
+// A zone lasts until the end of the enclosing scope. Each thread writes its zones to a ring      //
+// buffer of its own, so recording a zone costs two clock reads and one uncontended lock. Once a  //
+// ring buffer is full, the oldest zones are overwritten. The names are not copied, they have to  //
+// be string literals (or have static storage duration otherwise).                                //
+// writeChromeTrace() exports the recorded zones of all threads to the JSON format of Chrome's    //
+// about:tracing. Tracy can load these files with its import-chrome tool.                         //
+// The macro does nothing unless ILLUSION_ENABLE_TRACING is defined; the CMake option of the same //
+// name defines it for all but release builds. Recording can be paused with setEnabled() as well. //
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+class Tracer {
+
+ public:
+  // Records the time between its construction and destruction. Use ILLUSION_ZONE instead.
+  class Zone {
+   public:
+    explicit Zone(char const* name);
+    virtual ~Zone();
+
+    Zone(Zone const& other) = delete;
+    Zone& operator=(Zone const& other) = delete;
+
+   private:
+    char const* mName;
+    int64_t     mStart;
+  };
+
+  // Zones are only recorded while the Tracer is enabled, which is the default.
+  static void setEnabled(bool enabled);
+  static bool getEnabled();
+
+  // The number of zones each thread can store; this affects only threads which record their first
+  // zone afterwards. The default is 65536.
+  static void     setBufferSize(uint32_t zones);
+  static uint32_t getBufferSize();
+
+  // The name of the calling thread in the exported trace.
+  static void setThreadName(std::string const& name);
+
+  // Writes the zones of all threads to the given file. Throws a std::runtime_error if the file
+  // cannot be written. The zones are kept.
+  static void writeChromeTrace(std::string const& fileName);
+
+  // Forgets all recorded zones.
+  static void clear();
+};
+
+} // namespace Illusion::Core
+
+#ifdef ILLUSION_ENABLE_TRACING
+#define ILLUSION_ZONE_CONCAT_IMPL(a, b) a##b
+#define ILLUSION_ZONE_CONCAT(a, b) ILLUSION_ZONE_CONCAT_IMPL(a, b)
+#define ILLUSION_ZONE(name)                                                                        \
+  Illusion::Core::Tracer::Zone ILLUSION_ZONE_CONCAT(illusionZone, __LINE__)(name)
+#else
+#define ILLUSION_ZONE(name)
+#endif
+
+#endif // ILLUSION_CORE_TRACER_HPP
@@ -8,8 +8,15 @@
 
 #include "filesystem.hpp"
 
+#include <cstdio>
+#include <functional>
+#include <sstream>
 #include <sys/types.h>
-#ifndef WIN32
+#include <thread>
+#ifdef WIN32
+#include <direct.h>
+#include <process.h>
+#else
 #include <unistd.h>
 #endif
 
@@ -28,4 +35,51 @@ time_t getLastWriteTime(std::string const& filename) {
   return 0;
 }
 
+uint64_t getFileSize(std::string const& filename) {
+#ifdef WIN32
+  struct _stat64 result;
+  if (_stat64(filename.c_str(), &result) == 0) {
+#else
+  struct stat result;
+  if (stat(filename.c_str(), &result) == 0) {
+#endif
+    return static_cast<uint64_t>(result.st_size);
+  }
+  return 0;
+}
+
+bool createDirectory(std::string const& path) {
+#ifdef WIN32
+  _mkdir(path.c_str());
+  struct _stat result;
+  return _stat(path.c_str(), &result) == 0 && (result.st_mode & _S_IFDIR);
+#else
+  mkdir(path.c_str(), 0755);
+  struct stat result;
+  return stat(path.c_str(), &result) == 0 && S_ISDIR(result.st_mode);
+#endif
+}
+
+std::string getTemporaryFileName(std::string const& filename) {
+#ifdef WIN32
+  auto pid = _getpid();
+#else
+  auto pid = getpid();
+#endif
+  std::stringstream name;
+  name << filename << "." << pid << "." << std::hash<std::thread::id>()(std::this_thread::get_id())
+       << ".tmp";
+  return name.str();
+}
+
+bool replaceFile(std::string const& source, std::string const& target) {
+  // on some platforms, rename fails if the target exists already
+  std::remove(target.c_str());
+  if (std::rename(source.c_str(), target.c_str()) != 0) {
+    std::remove(source.c_str());
+    return false;
+  }
+  return true;
+}
+
 } // namespace Illusion::Core::FileSystem
@@ -9,6 +9,7 @@
 #ifndef ILLUSION_GRAPHICS_FILE_SYSTEM_HPP
 #define ILLUSION_GRAPHICS_FILE_SYSTEM_HPP
 
+#include <cstdint>
 #include <string>
 #include <sys/stat.h>
 
@@ -16,6 +17,22 @@ namespace Illusion::Core::FileSystem {
 
 time_t getLastWriteTime(std::string const& filename);
 
+// Returns the size of the given file in bytes or zero if it does not exist.
+uint64_t getFileSize(std::string const& filename);
+
+// Creates the given directory; its parent directory has to exist already. Returns true if the
+// directory exists afterwards.
+bool createDirectory(std::string const& path);
+
+// Returns a file name next to the given file which is unique for the calling process and thread.
+// Files which are shared between processes (like caches) should be written to such a file first and
+// then be moved into place with replaceFile(), so that other processes never see partial files.
+std::string getTemporaryFileName(std::string const& filename);
+
+// Renames source to target, replacing target if it exists already. If this fails, source is deleted
+// and false is returned.
+bool replaceFile(std::string const& source, std::string const& target);
+
 } // namespace Illusion::Core::FileSystem
 
 #endif // ILLUSION_GRAPHICS_FILE_SYSTEM_HPP
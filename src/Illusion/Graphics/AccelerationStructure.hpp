@@ -0,0 +1,35 @@
+////////////////////////////////////////////////////////////////////////////////////////////////////
+//                                                                                                //
+//    _)  |  |            _)                This code may be used and modified under the terms    //
+//     |  |  |  |  | (_-<  |   _ \    \     of the MIT license. See the LICENSE file for details. //
+//    _| _| _| \_,_| ___/ _| \___/ _| _|    Copyright (c) 2018-2019 Simon Schneegans              //
+//                                                                                                //
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#ifndef ILLUSION_GRAPHICS_ACCELERATION_STRUCTURE_HPP
+#define ILLUSION_GRAPHICS_ACCELERATION_STRUCTURE_HPP
+
+#include "fwd.hpp"
+
+namespace Illusion::Graphics {
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// An AccelerationStructure stores a vk::AccelerationStructureKHR and the BackedBuffer it lives   //
+// in. Use Device::createAccelerationStructure() to create one and                                //
+// CommandBuffer::buildAccelerationStructure() to fill it. Shaders access top-level structures    //
+// with ray queries, see BindingState::setAccelerationStructure(). The barriers of builds and     //
+// traversals are tracked for mBuffer.                                                            //
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+struct AccelerationStructure {
+  vk::AccelerationStructureKHRPtr  mAccelerationStructure;
+  BackedBufferPtr                  mBuffer;
+  vk::AccelerationStructureTypeKHR mType = vk::AccelerationStructureTypeKHR::eTopLevel;
+
+  // This is stored in the instances of top-level structures which reference this one.
+  vk::DeviceAddress mDeviceAddress = 0;
+};
+
+} // namespace Illusion::Graphics
+
+#endif // ILLUSION_GRAPHICS_ACCELERATION_STRUCTURE_HPP
@@ -0,0 +1,187 @@
+////////////////////////////////////////////////////////////////////////////////////////////////////
+//                                                                                                //
+//    _)  |  |            _)                This code may be used and modified under the terms    //
+//     |  |  |  |  | (_-<  |   _ \    \     of the MIT license. See the LICENSE file for details. //
+//    _| _| _| \_,_| ___/ _| \___/ _| _|    Copyright (c) 2018-2019 Simon Schneegans              //
+//                                                                                                //
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include "AssetManager.hpp"
+
+#include "../Core/Logger.hpp"
+#include "Shader.hpp"
+
+#include <iostream>
+
+namespace Illusion::Graphics {
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+bool AssetManager::TextureOptions::operator==(TextureOptions const& other) const {
+  return mSamplerInfo == other.mSamplerInfo && mGenerateMipmaps == other.mGenerateMipmaps &&
+         mComponentMapping == other.mComponentMapping &&
+         mCompressedFormat == other.mCompressedFormat;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+bool AssetManager::Request::operator<(Request const& other) const {
+  if (mPriority != other.mPriority) {
+    return mPriority < other.mPriority;
+  }
+
+  return mSequence > other.mSequence;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+AssetManager::AssetManager(DevicePtr const& device, Core::JobSystem& jobSystem)
+    : mDevice(device)
+    , mJobSystem(jobSystem) {
+
+  ILLUSION_TRACE << "Creating AssetManager." << std::endl;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+AssetManager::~AssetManager() {
+  ILLUSION_TRACE << "Deleting AssetManager." << std::endl;
+
+  // The queued jobs find no requests and return immediately.
+  {
+    std::unique_lock<std::mutex> lock(mMutex);
+    mQueue = std::priority_queue<Request>();
+  }
+
+  mJobSystem.wait(mJobs);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+AssetManager::Handle<Texture> AssetManager::loadTexture(
+    std::string const& fileName, TextureOptions const& options, Priority priority) {
+
+  return request<Texture>(mTextures, fileName, options, priority, [this, fileName, options]() {
+    ILLUSION_TRACE << "AssetManager: Loading texture " << fileName << "." << std::endl;
+    return Texture::createFromFile(mDevice, fileName, options.mSamplerInfo,
+        options.mGenerateMipmaps, options.mComponentMapping, options.mCompressedFormat);
+  });
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+AssetManager::Handle<Gltf::Model> AssetManager::loadModel(
+    std::string const& fileName, Gltf::LoadOptions options, Priority priority) {
+
+  options &= ~Gltf::LoadOptions(Gltf::LoadOptionBits::eAsync);
+
+  return request<Gltf::Model>(mModels, fileName, options, priority, [this, fileName, options]() {
+    ILLUSION_TRACE << "AssetManager: Loading model " << fileName << "." << std::endl;
+    return Gltf::Model::create(mDevice, fileName, options);
+  });
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+AssetManager::Handle<Shader> AssetManager::loadShader(std::vector<std::string> const& fileNames,
+    std::set<std::string> const& dynamicBuffers, std::set<std::string> const& defines,
+    Priority priority) {
+
+  std::string key;
+  for (auto const& fileName : fileNames) {
+    key += fileName + ";";
+  }
+
+  return request<Shader>(mShaders, key, std::make_pair(dynamicBuffers, defines), priority,
+      [this, fileNames, dynamicBuffers, defines]() {
+        ILLUSION_TRACE << "AssetManager: Loading shader " << fileNames.front() << "." << std::endl;
+        auto shader = Shader::createFromFiles(mDevice, fileNames, dynamicBuffers, true, defines);
+        shader->prepareAsync().wait();
+        return shader;
+      });
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+uint32_t AssetManager::getQueuedCount() const {
+  std::unique_lock<std::mutex> lock(mMutex);
+  return static_cast<uint32_t>(mQueue.size());
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+template <typename T, typename Options>
+AssetManager::Handle<T> AssetManager::request(Cache<T, Options>& cache, std::string const& key,
+    Options const& options, Priority priority, std::function<std::shared_ptr<T>()> const& load) {
+
+  std::unique_lock<std::mutex> lock(mMutex);
+
+  Handle<T> handle;
+  auto&     entries = cache[key];
+
+  // Remove the entries of assets which are not used anymore and look for a matching one.
+  for (auto it = entries.begin(); it != entries.end();) {
+    auto state = it->second.lock();
+
+    if (!state) {
+      it = entries.erase(it);
+      continue;
+    }
+
+    if (it->first == options) {
+      handle.mState = state;
+    }
+
+    ++it;
+  }
+
+  if (handle.mState) {
+    return handle;
+  }
+
+  auto state    = std::make_shared<typename Handle<T>::State>();
+  handle.mState = state;
+  entries.emplace_back(options, state);
+
+  // The request keeps the State alive until the asset has been loaded, even if all Handles have
+  // been dropped in the meantime.
+  mQueue.push({priority, mNextSequence++, [state, load, key]() {
+                 try {
+                   state->mAsset = load();
+                 } catch (std::exception const& e) {
+                   ILLUSION_ERROR << "AssetManager: Failed to load " << key << ": " << e.what()
+                                  << std::endl;
+                   state->mError = e.what();
+                 }
+                 state->mDone.store(true, std::memory_order_release);
+               }});
+
+  lock.unlock();
+
+  mJobSystem.run([this]() { runNext(); }, &mJobs);
+
+  return handle;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void AssetManager::runNext() {
+  std::function<void()> load;
+
+  {
+    std::unique_lock<std::mutex> lock(mMutex);
+
+    if (mQueue.empty()) {
+      return;
+    }
+
+    load = mQueue.top().mLoad;
+    mQueue.pop();
+  }
+
+  load();
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+} // namespace Illusion::Graphics
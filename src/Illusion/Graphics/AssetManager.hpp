@@ -0,0 +1,163 @@
+////////////////////////////////////////////////////////////////////////////////////////////////////
+//                                                                                                //
+//    _)  |  |            _)                This code may be used and modified under the terms    //
+//     |  |  |  |  | (_-<  |   _ \    \     of the MIT license. See the LICENSE file for details. //
+//    _| _| _| \_,_| ___/ _| \___/ _| _|    Copyright (c) 2018-2019 Simon Schneegans              //
+//                                                                                                //
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#ifndef ILLUSION_GRAPHICS_ASSET_MANAGER_HPP
+#define ILLUSION_GRAPHICS_ASSET_MANAGER_HPP
+
+#include "../Core/JobSystem.hpp"
+#include "GltfModel.hpp"
+#include "Texture.hpp"
+
+#include <atomic>
+#include <map>
+#include <mutex>
+#include <queue>
+#include <set>
+#include <string>
+#include <vector>
+
+namespace Illusion::Graphics {
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// The AssetManager loads Textures, Gltf::Models and Shaders in the background and shares them:   //
+// requesting the same file with the same options again returns a Handle to the asset which is    //
+// already loaded (or still loading) instead of loading it a second time. Assets are reference    //
+// counted by their Handles; once the last Handle of an asset is gone, it is destroyed and a      //
+// later request loads it again.                                                                  //
+// The loading is done by the jobs of a Core::JobSystem. Requests are queued by priority, each    //
+// job takes the request with the highest priority when it starts, so requests with a high        //
+// priority overtake earlier requests with lower priorities which have not been started yet.      //
+// Models are loaded completely by the job (without LoadOptionBits::eAsync), so that they do not  //
+// need Model::update() calls. All methods are thread-safe.                                       //
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+class AssetManager {
+
+ public:
+  enum class Priority { eLow = 0, eNormal = 1, eHigh = 2 };
+
+  // A Handle refers to an asset which may still be loading. It becomes valid once loading has
+  // finished successfully; until then, get() returns nullptr. Copies refer to the same asset.
+  template <typename T>
+  class Handle {
+   public:
+    Handle() = default;
+
+    // Returns true once the asset has been loaded successfully.
+    bool isValid() const {
+      return mState && mState->mDone.load(std::memory_order_acquire) && mState->mAsset;
+    }
+
+    // Returns true if loading has finished, either successfully or with an error.
+    bool isDone() const {
+      return mState && mState->mDone.load(std::memory_order_acquire);
+    }
+
+    // The asset is nullptr until isValid() returns true.
+    std::shared_ptr<T> get() const {
+      return isValid() ? mState->mAsset : nullptr;
+    }
+
+    // If loading failed, this contains the message of the exception which was thrown.
+    std::string getError() const {
+      return isDone() ? mState->mError : "";
+    }
+
+   private:
+    friend class AssetManager;
+
+    // mAsset and mError are written before mDone is set and not modified afterwards.
+    struct State {
+      std::shared_ptr<T> mAsset;
+      std::string        mError;
+      std::atomic<bool>  mDone{false};
+    };
+
+    std::shared_ptr<State> mState;
+  };
+
+  // Everything which affects the result of Texture::createFromFile().
+  struct TextureOptions {
+    vk::SamplerCreateInfo mSamplerInfo      = Device::createSamplerInfo();
+    bool                  mGenerateMipmaps  = true;
+    vk::ComponentMapping  mComponentMapping = vk::ComponentMapping();
+    vk::Format            mCompressedFormat = vk::Format::eUndefined;
+
+    bool operator==(TextureOptions const& other) const;
+  };
+
+  // Syntactic sugar to create a std::shared_ptr for this class
+  template <typename... Args>
+  static AssetManagerPtr create(Args&&... args) {
+    return std::make_shared<AssetManager>(args...);
+  };
+
+  // The JobSystem has to outlive the AssetManager. On destruction, requests which have not been
+  // started yet are discarded (their Handles never become done) and the destructor blocks until
+  // the running ones have finished.
+  AssetManager(DevicePtr const& device, Core::JobSystem& jobSystem);
+  virtual ~AssetManager();
+
+  // Loads the file with Texture::createFromFile().
+  Handle<Texture> loadTexture(std::string const& fileName,
+      TextureOptions const& options = TextureOptions(), Priority priority = Priority::eNormal);
+
+  // Loads the file with the given options. LoadOptionBits::eAsync is ignored.
+  Handle<Gltf::Model> loadModel(std::string const& fileName,
+      Gltf::LoadOptions options  = Gltf::LoadOptionBits::eAll,
+      Priority          priority = Priority::eNormal);
+
+  // Creates the Shader with Shader::createFromFiles() and compiles all its stages.
+  Handle<Shader> loadShader(std::vector<std::string> const& fileNames,
+      std::set<std::string> const& dynamicBuffers = {}, std::set<std::string> const& defines = {},
+      Priority priority = Priority::eNormal);
+
+  // The number of requests which have not been started yet.
+  uint32_t getQueuedCount() const;
+
+ private:
+  struct Request {
+    Priority              mPriority;
+    uint64_t              mSequence;
+    std::function<void()> mLoad;
+
+    // the highest priority first, requests of the same priority in order
+    bool operator<(Request const& other) const;
+  };
+
+  // For each key, the options and the States of all assets requested with this key. The States
+  // are weak, so they expire once all Handles and the loading job are gone.
+  template <typename T, typename Options>
+  using Cache = std::map<std::string,
+      std::vector<std::pair<Options, std::weak_ptr<typename Handle<T>::State>>>>;
+
+  // Returns a Handle of the cached asset with the given key and options. If there is none, a new
+  // one is added to the cache and the load function is queued; its result is stored in the Handle.
+  template <typename T, typename Options>
+  Handle<T> request(Cache<T, Options>& cache, std::string const& key, Options const& options,
+      Priority priority, std::function<std::shared_ptr<T>()> const& load);
+
+  // Executed by the jobs, this runs the queued request with the highest priority.
+  void runNext();
+
+  DevicePtr        mDevice;
+  Core::JobSystem& mJobSystem;
+
+  Cache<Texture, TextureOptions>                                         mTextures;
+  Cache<Gltf::Model, Gltf::LoadOptions>                                  mModels;
+  Cache<Shader, std::pair<std::set<std::string>, std::set<std::string>>> mShaders;
+
+  std::priority_queue<Request> mQueue;
+  uint64_t                     mNextSequence = 0;
+  Core::JobSystem::Counter     mJobs;
+  mutable std::mutex           mMutex;
+};
+
+} // namespace Illusion::Graphics
+
+#endif // ILLUSION_GRAPHICS_ASSET_MANAGER_HPP
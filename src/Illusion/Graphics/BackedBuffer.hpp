@@ -17,11 +17,27 @@ namespace Illusion::Graphics {
 // A BackedBuffer stores a vk::Buffer and some vk::DeviceMemory attached to this buffer.          //
 // Additionally all create-info objects are stored in order to access the properties of the       //
 // buffer and the memory. Use the Device class to easily create a BackedBuffer.                   //
+// The memory is usually a range of a larger vk::DeviceMemory block, mMemoryOffset is the start   //
+// of this range and mMemoryInfo.allocationSize its size.                                         //
 ////////////////////////////////////////////////////////////////////////////////////////////////////
 
 struct BackedBuffer {
   vk::BufferPtr       mBuffer;
   vk::DeviceMemoryPtr mMemory;
+  vk::DeviceSize      mMemoryOffset = 0;
+
+  // If the memory is eHostVisible, this points to the persistently mapped range of the buffer.
+  uint8_t* mMappedData = nullptr;
+
+  // If data was uploaded with a staging buffer, this can be passed to the UploadManager of the
+  // Device in order to wait for the upload to finish.
+  uint64_t mUploadTicket = 0;
+
+  // If the bindless mode of the Device is enabled and the buffer has the eStorageBuffer usage, this
+  // is the index of the buffer in the array of storage buffers of the BindlessDescriptorSet. The
+  // index is released when mBindlessSlot is destroyed.
+  uint32_t              mBindlessIndex = ~0u;
+  std::shared_ptr<void> mBindlessSlot;
 
   vk::BufferCreateInfo   mBufferInfo;
   vk::MemoryAllocateInfo mMemoryInfo;
@@ -17,19 +17,25 @@ namespace Illusion::Graphics {
 // A BackedImage stores a vk::Image, a vk::ImageView for this image and the vk::DeviceMemory      //
 // backing the image. Additionally all create-info objects are stored in order to access the      //
 // properties of the  image, the view and the memory. Use the Device class to easily create a     //
-// BackedImage.                                                                                   //
+// BackedImage. The memory is usually a range starting at mMemoryOffset of a larger               //
+// vk::DeviceMemory block.                                                                        //
 ////////////////////////////////////////////////////////////////////////////////////////////////////
 
 struct BackedImage {
   vk::ImagePtr        mImage;
   vk::ImageViewPtr    mView;
   vk::DeviceMemoryPtr mMemory;
+  vk::DeviceSize      mMemoryOffset = 0;
 
   vk::ImageCreateInfo     mImageInfo;
   vk::ImageViewCreateInfo mViewInfo;
   vk::MemoryAllocateInfo  mMemoryInfo;
 
   vk::ImageLayout mCurrentLayout = vk::ImageLayout::eUndefined;
+
+  // This can be passed to the UploadManager of the Device in order to wait for the initial upload
+  // or layout transition to finish.
+  uint64_t mUploadTicket = 0;
 };
 
 } // namespace Illusion::Graphics
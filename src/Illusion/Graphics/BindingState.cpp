@@ -8,14 +8,28 @@
 
 #include "BindingState.hpp"
 
+#include <stdexcept>
+#include <string>
+
 namespace Illusion::Graphics {
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////
 
 void BindingState::setBinding(BindingType const& value, uint32_t set, uint32_t binding) {
-  if (getBinding(set, binding) != value) {
-    mSetBindings[set][binding] = value;
-    mDirtySetBindings.insert(set);
+  if (set >= MAX_SETS || binding >= MAX_BINDINGS) {
+    throw std::runtime_error("Failed to set binding " + std::to_string(binding) + " of set " +
+                             std::to_string(set) + ": Only " + std::to_string(MAX_SETS) +
+                             " sets with " + std::to_string(MAX_BINDINGS) +
+                             " bindings each are supported!");
+  }
+
+  auto&    state = mSets[set];
+  uint32_t bit   = 1u << binding;
+
+  if (!(state.mBindingMask & bit) || state.mBindings[binding] != value) {
+    state.mBindings[binding] = value;
+    state.mBindingMask |= bit;
+    mDirtySets |= 1u << set;
   }
 }
 
@@ -40,6 +54,13 @@ void BindingState::setStorageImage(
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////
 
+void BindingState::setInputAttachment(
+    BackedImagePtr const& image, uint32_t set, uint32_t binding) {
+  setBinding(InputAttachmentBinding{image}, set, binding);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
 void BindingState::setUniformBuffer(BackedBufferPtr const& buffer, vk::DeviceSize size,
     vk::DeviceSize offset, uint32_t set, uint32_t binding) {
   setBinding(UniformBufferBinding{buffer, size, offset}, set, binding);
@@ -50,11 +71,7 @@ void BindingState::setUniformBuffer(BackedBufferPtr const& buffer, vk::DeviceSiz
 void BindingState::setDynamicUniformBuffer(BackedBufferPtr const& buffer, vk::DeviceSize size,
     uint32_t offset, uint32_t set, uint32_t binding) {
   setBinding(DynamicUniformBufferBinding{buffer, size}, set, binding);
-
-  if (getDynamicOffset(set, binding) != offset) {
-    mDynamicOffsets[set][binding] = offset;
-    mDirtyDynamicOffsets.insert(set);
-  }
+  setDynamicOffset(offset, set, binding);
 }
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -69,161 +86,122 @@ void BindingState::setStorageBuffer(BackedBufferPtr const& buffer, vk::DeviceSiz
 void BindingState::setDynamicStorageBuffer(BackedBufferPtr const& buffer, vk::DeviceSize size,
     uint32_t offset, uint32_t set, uint32_t binding) {
   setBinding(DynamicStorageBufferBinding{buffer, size}, set, binding);
+  setDynamicOffset(offset, set, binding);
+}
 
-  if (getDynamicOffset(set, binding) != offset) {
-    mDynamicOffsets[set][binding] = offset;
-    mDirtyDynamicOffsets.insert(set);
-  }
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void BindingState::setAccelerationStructure(
+    AccelerationStructurePtr const& accelerationStructure, uint32_t set, uint32_t binding) {
+  setBinding(AccelerationStructureBinding{accelerationStructure}, set, binding);
 }
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////
 
 void BindingState::reset(uint32_t set, uint32_t binding) {
-  {
-    auto setIt = mSetBindings.find(set);
-
-    if (setIt != mSetBindings.end()) {
-      auto bindingIt = setIt->second.find(binding);
-      if (bindingIt != setIt->second.end()) {
-        setIt->second.erase(bindingIt);
-        mDirtySetBindings.insert(set);
-      }
-    }
+  if (set >= MAX_SETS || binding >= MAX_BINDINGS) {
+    return;
   }
 
-  {
-    auto offsetIt = mDynamicOffsets.find(set);
+  auto&    state = mSets[set];
+  uint32_t bit   = 1u << binding;
+
+  if (state.mBindingMask & bit) {
+    // this releases the referenced resources
+    state.mBindings[binding] = BindingType();
+    state.mBindingMask &= ~bit;
+    mDirtySets |= 1u << set;
+  }
 
-    if (offsetIt != mDynamicOffsets.end()) {
-      auto bindingIt = offsetIt->second.find(binding);
-      if (bindingIt != offsetIt->second.end()) {
-        offsetIt->second.erase(bindingIt);
-        mDirtyDynamicOffsets.insert(set);
-      }
-    }
+  if (state.mDynamicOffsetMask & bit) {
+    state.mDynamicOffsets[binding] = 0;
+    state.mDynamicOffsetMask &= ~bit;
+    mDirtyDynamicOffsets |= 1u << set;
   }
 }
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////
 
 void BindingState::reset(uint32_t set) {
-  {
-    auto setIt = mSetBindings.find(set);
-
-    if (setIt != mSetBindings.end()) {
-      mSetBindings.erase(setIt);
-      mDirtySetBindings.insert(set);
-    }
+  if (set >= MAX_SETS) {
+    return;
   }
 
-  {
-    auto offsetIt = mDynamicOffsets.find(set);
-
-    if (offsetIt != mDynamicOffsets.end()) {
-      mDynamicOffsets.erase(offsetIt);
-      mDirtyDynamicOffsets.insert(set);
-    }
+  for (uint32_t binding = 0; binding < MAX_BINDINGS; ++binding) {
+    reset(set, binding);
   }
 }
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////
 
 void BindingState::reset() {
-  for (auto const& setIt : mSetBindings) {
-    mDirtySetBindings.insert(setIt.first);
+  for (uint32_t set = 0; set < MAX_SETS; ++set) {
+    reset(set);
   }
-  mSetBindings.clear();
-
-  for (auto const& offsetIt : mDynamicOffsets) {
-    mDirtyDynamicOffsets.insert(offsetIt.first);
-  }
-  mDynamicOffsets.clear();
 }
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////
 
-std::optional<BindingType> BindingState::getBinding(uint32_t set, uint32_t binding) {
-  auto setIt = mSetBindings.find(set);
-
-  if (setIt == mSetBindings.end()) {
-    return {};
-  }
-
-  auto bindingIt = setIt->second.find(binding);
-
-  if (bindingIt == setIt->second.end()) {
-    return {};
-  }
-
-  return bindingIt->second;
+uint32_t BindingState::getBindingMask(uint32_t set) const {
+  return set < MAX_SETS ? mSets[set].mBindingMask : 0;
 }
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////
 
-std::map<uint32_t, BindingType> const& BindingState::getBindings(uint32_t set) {
-  auto setIt = mSetBindings.find(set);
-
-  if (setIt == mSetBindings.end()) {
-    static std::map<uint32_t, BindingType> empty;
-    return empty;
+BindingType const* BindingState::getBinding(uint32_t set, uint32_t binding) const {
+  if (set >= MAX_SETS || binding >= MAX_BINDINGS || !(mSets[set].mBindingMask & (1u << binding))) {
+    return nullptr;
   }
 
-  return setIt->second;
+  return &mSets[set].mBindings[binding];
 }
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////
 
-std::set<uint32_t> const& BindingState::getDirtySets() const {
-  return mDirtySetBindings;
+uint32_t BindingState::getDirtySets() const {
+  return mDirtySets;
 }
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////
 
 void BindingState::clearDirtySets() {
-  mDirtySetBindings.clear();
+  mDirtySets = 0;
 }
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////
 
-uint32_t BindingState::getDynamicOffset(uint32_t set, uint32_t binding) {
-  auto setIt = mDynamicOffsets.find(set);
-
-  if (setIt == mDynamicOffsets.end()) {
-    return 0;
-  }
-
-  auto bindingIt = setIt->second.find(binding);
-
-  if (bindingIt == setIt->second.end()) {
+uint32_t BindingState::getDynamicOffset(uint32_t set, uint32_t binding) const {
+  if (set >= MAX_SETS || binding >= MAX_BINDINGS) {
     return 0;
   }
 
-  return bindingIt->second;
+  return mSets[set].mDynamicOffsets[binding];
 }
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////
 
-std::map<uint32_t, uint32_t> const& BindingState::getDynamicOffsets(uint32_t set) {
-  auto setIt = mDynamicOffsets.find(set);
-
-  if (setIt == mDynamicOffsets.end()) {
-    static std::map<uint32_t, uint32_t> empty;
-    return empty;
-  }
-
-  return setIt->second;
+uint32_t BindingState::getDirtyDynamicOffsets() const {
+  return mDirtyDynamicOffsets;
 }
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////
 
-std::set<uint32_t> const& BindingState::getDirtyDynamicOffsets() const {
-  return mDirtyDynamicOffsets;
+void BindingState::clearDirtyDynamicOffsets() {
+  mDirtyDynamicOffsets = 0;
 }
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////
 
-void BindingState::clearDirtyDynamicOffsets() {
-  mDirtyDynamicOffsets.clear();
+void BindingState::setDynamicOffset(uint32_t offset, uint32_t set, uint32_t binding) {
+  auto&    state = mSets[set];
+  uint32_t bit   = 1u << binding;
+
+  if (state.mDynamicOffsets[binding] != offset) {
+    state.mDynamicOffsets[binding] = offset;
+    mDirtyDynamicOffsets |= 1u << set;
+  }
+
+  state.mDynamicOffsetMask |= bit;
 }
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////
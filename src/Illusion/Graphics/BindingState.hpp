@@ -12,25 +12,31 @@
 #include "../Core/BitHash.hpp"
 #include "BindingTypes.hpp"
 
-#include <map>
-#include <optional>
-#include <set>
+#include <array>
+#include <cstdint>
 
 namespace Illusion::Graphics {
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////
-// This class is used by the CommandBuffer to track the descriptor set binding state.             //
-// The BindingState stores what is bound to each descriptor set number. Whenever a binding        //
-// changes, a dirty flag is set. This can be used to trigger descriptor set updates.              //
+// This class is used by the CommandBuffer to track the descriptor set binding state. The         //
+// BindingState stores what is bound to each descriptor set number. Whenever a binding changes, a //
+// dirty flag is set. This can be used to trigger descriptor set updates.                         //
 // In addition to to the bindings, dynamic offsets are be stored separately for each binding of   //
 // each set. This means when a dynamic binding changes only by its offset (dynamic uniform buffer //
 // or dynamic storage buffer), the corresponding set will not be flagged as dirty. Instead, the   //
 // dynamic offset will be flagged as dirty which can be used to trigger a re-binding of the       //
 // currently bound descriptor set.                                                                //
+// As this is accessed for every draw call, the state is stored in fixed-size arrays for MAX_SETS //
+// sets with MAX_BINDINGS bindings each. Bound bindings and dirty sets are tracked with bit       //
+// masks, hence neither setting nor reading the state allocates memory.                           //
 ////////////////////////////////////////////////////////////////////////////////////////////////////
 
 class BindingState {
  public:
+  // Trying to set bindings of larger set or binding numbers will throw a std::runtime_error.
+  static const uint32_t MAX_SETS     = 8;
+  static const uint32_t MAX_BINDINGS = 32;
+
   // Methods for setting the binding state ---------------------------------------------------------
 
   // BindingType is defined BindingTypes.hpp and is a std::variant containing one of the possible
@@ -51,6 +57,10 @@ class BindingState {
   void setStorageImage(
       TexturePtr const& image, vk::ImageViewPtr const& view, uint32_t set, uint32_t binding);
 
+  // Stores the given BackedImage as InputAttachmentBinding. The image has to be an attachment of
+  // the current RenderPass which is read by the current subpass.
+  void setInputAttachment(BackedImagePtr const& image, uint32_t set, uint32_t binding);
+
   // Stores the given BackedBuffer range as UniformBufferBinding.
   void setUniformBuffer(BackedBufferPtr const& buffer, vk::DeviceSize size, vk::DeviceSize offset,
       uint32_t set, uint32_t binding);
@@ -73,6 +83,11 @@ class BindingState {
   void setDynamicStorageBuffer(BackedBufferPtr const& buffer, vk::DeviceSize size, uint32_t offset,
       uint32_t set, uint32_t binding);
 
+  // Stores the given top-level AccelerationStructure as AccelerationStructureBinding, it can be
+  // traversed with ray queries (GL_EXT_ray_query) by all shader stages.
+  void setAccelerationStructure(
+      AccelerationStructurePtr const& accelerationStructure, uint32_t set, uint32_t binding);
+
   // Removes the given binding for the given set. The dynamic offset (if set) will be removed as
   // well. The set and the dynamic offsets will be flagged as being dirty.
   void reset(uint32_t set, uint32_t binding);
@@ -87,35 +102,39 @@ class BindingState {
 
   // Methods for reading the binding state ---------------------------------------------------------
 
-  // Retrieve all or specific bindings of given descriptor set numbers.
-  std::optional<BindingType>             getBinding(uint32_t set, uint32_t binding);
-  std::map<uint32_t, BindingType> const& getBindings(uint32_t set);
+  // Returns a bit mask where bit i is set if something is bound to binding i of the given set.
+  uint32_t getBindingMask(uint32_t set) const;
+
+  // Returns the given binding or nullptr if nothing is bound to it.
+  BindingType const* getBinding(uint32_t set, uint32_t binding) const;
 
-  // Get or clear the list of sets which have changed bindings.
-  std::set<uint32_t> const& getDirtySets() const;
-  void                      clearDirtySets();
+  // Get or clear the bit mask of sets which have changed bindings.
+  uint32_t getDirtySets() const;
+  void     clearDirtySets();
 
-  // Retrieve all or specific dynamic offsets of given descriptor set numbers. This will return
-  // zero if the requested binding is actually not dynamic
-  uint32_t                            getDynamicOffset(uint32_t set, uint32_t binding);
-  std::map<uint32_t, uint32_t> const& getDynamicOffsets(uint32_t set);
+  // Retrieve the dynamic offset of a binding. This will return zero if the requested binding is
+  // actually not dynamic.
+  uint32_t getDynamicOffset(uint32_t set, uint32_t binding) const;
 
-  // Get or clear the list of sets which have changed dynamic offsets amongst their bindings.
-  std::set<uint32_t> const& getDirtyDynamicOffsets() const;
-  void                      clearDirtyDynamicOffsets();
+  // Get or clear the bit mask of sets which have changed dynamic offsets amongst their bindings.
+  uint32_t getDirtyDynamicOffsets() const;
+  void     clearDirtyDynamicOffsets();
 
  private:
-  // Stores for each set number a map which stores for each binding number a BindingType
-  std::map<uint32_t, std::map<uint32_t, BindingType>> mSetBindings;
+  void setDynamicOffset(uint32_t offset, uint32_t set, uint32_t binding);
 
-  // Stores set numbers of descriptor sets with changed bindings
-  std::set<uint32_t> mDirtySetBindings;
+  struct SetState {
+    std::array<BindingType, MAX_BINDINGS> mBindings;
+    std::array<uint32_t, MAX_BINDINGS>    mDynamicOffsets{};
+    uint32_t                              mBindingMask       = 0;
+    uint32_t                              mDynamicOffsetMask = 0;
+  };
 
-  // Stores for each set number a map which stores for each dynamic binding an offset
-  std::map<uint32_t, std::map<uint32_t, uint32_t>> mDynamicOffsets;
+  std::array<SetState, MAX_SETS> mSets;
 
-  // Stores set numbers of descriptor sets with changed dynamic offsets
-  std::set<uint32_t> mDirtyDynamicOffsets;
+  // Bit masks of descriptor set numbers with changed bindings or dynamic offsets
+  uint32_t mDirtySets           = 0;
+  uint32_t mDirtyDynamicOffsets = 0;
 };
 
 } // namespace Illusion::Graphics
@@ -32,6 +32,16 @@ bool CombinedImageSamplerBinding::operator!=(CombinedImageSamplerBinding const&
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////
 
+bool InputAttachmentBinding::operator==(InputAttachmentBinding const& other) const {
+  return mImage == other.mImage;
+}
+
+bool InputAttachmentBinding::operator!=(InputAttachmentBinding const& other) const {
+  return !(*this == other);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
 bool UniformBufferBinding::operator==(UniformBufferBinding const& other) const {
   return mBuffer == other.mBuffer && mSize == other.mSize && mOffset == other.mOffset;
 }
@@ -72,4 +82,14 @@ bool DynamicStorageBufferBinding::operator!=(DynamicStorageBufferBinding const&
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////
 
+bool AccelerationStructureBinding::operator==(AccelerationStructureBinding const& other) const {
+  return mAccelerationStructure == other.mAccelerationStructure;
+}
+
+bool AccelerationStructureBinding::operator!=(AccelerationStructureBinding const& other) const {
+  return !(*this == other);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
 } // namespace Illusion::Graphics
@@ -40,6 +40,15 @@ struct CombinedImageSamplerBinding {
 
 // -------------------------------------------------------------------------------------------------
 
+struct InputAttachmentBinding {
+  BackedImagePtr mImage;
+
+  bool operator==(InputAttachmentBinding const& other) const;
+  bool operator!=(InputAttachmentBinding const& other) const;
+};
+
+// -------------------------------------------------------------------------------------------------
+
 struct UniformBufferBinding {
   BackedBufferPtr mBuffer;
   vk::DeviceSize  mSize;
@@ -82,8 +91,18 @@ struct DynamicStorageBufferBinding {
 
 // -------------------------------------------------------------------------------------------------
 
-typedef std::variant<StorageImageBinding, CombinedImageSamplerBinding, UniformBufferBinding,
-    DynamicUniformBufferBinding, StorageBufferBinding, DynamicStorageBufferBinding>
+struct AccelerationStructureBinding {
+  AccelerationStructurePtr mAccelerationStructure;
+
+  bool operator==(AccelerationStructureBinding const& other) const;
+  bool operator!=(AccelerationStructureBinding const& other) const;
+};
+
+// -------------------------------------------------------------------------------------------------
+
+typedef std::variant<StorageImageBinding, CombinedImageSamplerBinding, InputAttachmentBinding,
+    UniformBufferBinding, DynamicUniformBufferBinding, StorageBufferBinding,
+    DynamicStorageBufferBinding, AccelerationStructureBinding>
     BindingType;
 
 } // namespace Illusion::Graphics
@@ -0,0 +1,346 @@
+////////////////////////////////////////////////////////////////////////////////////////////////////
+//                                                                                                //
+//    _)  |  |            _)                This code may be used and modified under the terms    //
+//     |  |  |  |  | (_-<  |   _ \    \     of the MIT license. See the LICENSE file for details. //
+//    _| _| _| \_,_| ___/ _| \___/ _| _|    Copyright (c) 2018-2019 Simon Schneegans              //
+//                                                                                                //
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include "BindlessDescriptorSet.hpp"
+
+#include "../Core/Logger.hpp"
+#include "BackedBuffer.hpp"
+#include "Device.hpp"
+#include "PhysicalDevice.hpp"
+#include "Texture.hpp"
+#include "VulkanPtr.hpp"
+
+#include <algorithm>
+
+namespace Illusion::Graphics {
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+namespace {
+const uint32_t STORAGE_BUFFER_BINDING = 0;
+const uint32_t TEXTURE_BINDING        = 1;
+
+// Returns a previously released index or appends a new slot. If all slots are occupied, maxSlots
+// is returned.
+template <typename T>
+uint32_t acquireSlot(std::vector<uint32_t>& freeSlots, std::vector<T>& infos, uint32_t maxSlots) {
+  if (!freeSlots.empty()) {
+    uint32_t index = freeSlots.back();
+    freeSlots.pop_back();
+    return index;
+  }
+
+  if (infos.size() >= maxSlots) {
+    return maxSlots;
+  }
+
+  infos.emplace_back();
+  return static_cast<uint32_t>(infos.size() - 1);
+}
+} // namespace
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+BindlessDescriptorSet::BindlessDescriptorSet(Device const* device, uint32_t maxTextures,
+    uint32_t maxStorageBuffers, uint32_t initialTextureCapacity)
+    : mDevice(device) {
+
+  ILLUSION_TRACE << "Creating BindlessDescriptorSet." << std::endl;
+
+  auto const& limits = mDevice->getPhysicalDevice()->getDescriptorIndexingProperties();
+
+  mMaxTextures = std::min({maxTextures, limits.maxDescriptorSetUpdateAfterBindSampledImages,
+      limits.maxDescriptorSetUpdateAfterBindSamplers,
+      limits.maxPerStageDescriptorUpdateAfterBindSampledImages,
+      limits.maxPerStageDescriptorUpdateAfterBindSamplers});
+
+  mMaxStorageBuffers = std::min({maxStorageBuffers,
+      limits.maxDescriptorSetUpdateAfterBindStorageBuffers,
+      limits.maxPerStageDescriptorUpdateAfterBindStorageBuffers});
+
+  // both arrays may contain unwritten slots and may be updated while the set is bound; only the
+  // last binding can have a variable size
+  vk::DescriptorBindingFlagsEXT flags = vk::DescriptorBindingFlagBitsEXT::ePartiallyBound |
+                                        vk::DescriptorBindingFlagBitsEXT::eUpdateAfterBind |
+                                        vk::DescriptorBindingFlagBitsEXT::eUpdateUnusedWhilePending;
+
+  std::array<vk::DescriptorBindingFlagsEXT, 2> bindingFlags = {
+      flags, flags | vk::DescriptorBindingFlagBitsEXT::eVariableDescriptorCount};
+
+  std::array<vk::DescriptorSetLayoutBinding, 2> bindings;
+  bindings[0] = {STORAGE_BUFFER_BINDING, vk::DescriptorType::eStorageBuffer, mMaxStorageBuffers,
+      vk::ShaderStageFlagBits::eAll};
+  bindings[1] = {TEXTURE_BINDING, vk::DescriptorType::eCombinedImageSampler, mMaxTextures,
+      vk::ShaderStageFlagBits::eAll};
+
+  vk::DescriptorSetLayoutBindingFlagsCreateInfoEXT bindingFlagsInfo;
+  bindingFlagsInfo.bindingCount  = static_cast<uint32_t>(bindingFlags.size());
+  bindingFlagsInfo.pBindingFlags = bindingFlags.data();
+
+  vk::DescriptorSetLayoutCreateInfo layoutInfo;
+  layoutInfo.pNext        = &bindingFlagsInfo;
+  layoutInfo.flags        = vk::DescriptorSetLayoutCreateFlagBits::eUpdateAfterBindPoolEXT;
+  layoutInfo.bindingCount = static_cast<uint32_t>(bindings.size());
+  layoutInfo.pBindings    = bindings.data();
+
+  mLayout = mDevice->createDescriptorSetLayout(layoutInfo);
+
+  allocate(std::max(1u, std::min(initialTextureCapacity, mMaxTextures)));
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+BindlessDescriptorSet::~BindlessDescriptorSet() {
+  ILLUSION_TRACE << "Deleting BindlessDescriptorSet." << std::endl;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+uint32_t BindlessDescriptorSet::addTexture(TexturePtr const& texture) {
+
+  if (texture->mBindlessSlot) {
+    updateTexture(texture);
+    return texture->mBindlessIndex;
+  }
+
+  std::unique_lock<std::mutex> lock(mMutex);
+
+  uint32_t index = acquireSlot(mFreeTextureSlots, mTextureInfos, mMaxTextures);
+
+  if (index == mMaxTextures) {
+    throw std::runtime_error(
+        "Failed to add Texture to BindlessDescriptorSet: Maximum number of textures reached!");
+  }
+
+  // grow the texture array; the new set will contain all occupied slots
+  if (index >= mTextureCapacity) {
+    allocate(std::min(mTextureCapacity * 2, mMaxTextures));
+  }
+
+  mTextureInfos[index] = {*texture->mSampler, *texture->mView, texture->mCurrentLayout};
+  writeTexture(index, mTextureInfos[index]);
+  ++mTextureCount;
+
+  // the slot is released when the last copy of this handle is destroyed
+  std::weak_ptr<BindlessDescriptorSet> weakThis(shared_from_this());
+
+  texture->mBindlessIndex = index;
+  texture->mBindlessSlot  = std::make_shared<Slot>([weakThis, index]() {
+    auto self = weakThis.lock();
+    if (self) {
+      self->releaseTexture(index);
+    }
+  });
+
+  return index;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void BindlessDescriptorSet::updateTexture(TexturePtr const& texture) {
+  if (!texture->mBindlessSlot) {
+    throw std::runtime_error(
+        "Failed to update Texture in BindlessDescriptorSet: Texture has not been added!");
+  }
+
+  std::unique_lock<std::mutex> lock(mMutex);
+
+  auto index           = texture->mBindlessIndex;
+  mTextureInfos[index] = {*texture->mSampler, *texture->mView, texture->mCurrentLayout};
+  writeTexture(index, mTextureInfos[index]);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+uint32_t BindlessDescriptorSet::addStorageBuffer(BackedBufferPtr const& buffer) {
+
+  if (!(buffer->mBufferInfo.usage & vk::BufferUsageFlagBits::eStorageBuffer)) {
+    throw std::runtime_error("Failed to add BackedBuffer to BindlessDescriptorSet: Buffer has no "
+                             "eStorageBuffer usage!");
+  }
+
+  if (buffer->mBindlessSlot) {
+    return buffer->mBindlessIndex;
+  }
+
+  std::unique_lock<std::mutex> lock(mMutex);
+
+  uint32_t index = acquireSlot(mFreeStorageBufferSlots, mStorageBufferInfos, mMaxStorageBuffers);
+
+  if (index == mMaxStorageBuffers) {
+    throw std::runtime_error("Failed to add BackedBuffer to BindlessDescriptorSet: Maximum number "
+                             "of storage buffers reached!");
+  }
+
+  mStorageBufferInfos[index] = {*buffer->mBuffer, 0, VK_WHOLE_SIZE};
+  writeStorageBuffer(index, mStorageBufferInfos[index]);
+  ++mStorageBufferCount;
+
+  std::weak_ptr<BindlessDescriptorSet> weakThis(shared_from_this());
+
+  buffer->mBindlessIndex = index;
+  buffer->mBindlessSlot  = std::make_shared<Slot>([weakThis, index]() {
+    auto self = weakThis.lock();
+    if (self) {
+      self->releaseStorageBuffer(index);
+    }
+  });
+
+  return index;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+vk::DescriptorSetPtr BindlessDescriptorSet::getHandle() const {
+  std::unique_lock<std::mutex> lock(mMutex);
+  return mSet;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+vk::DescriptorSetLayoutPtr const& BindlessDescriptorSet::getLayout() const {
+  return mLayout;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+uint32_t BindlessDescriptorSet::getTextureCount() const {
+  std::unique_lock<std::mutex> lock(mMutex);
+  return mTextureCount;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+uint32_t BindlessDescriptorSet::getTextureCapacity() const {
+  std::unique_lock<std::mutex> lock(mMutex);
+  return mTextureCapacity;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+uint32_t BindlessDescriptorSet::getStorageBufferCount() const {
+  std::unique_lock<std::mutex> lock(mMutex);
+  return mStorageBufferCount;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+BindlessDescriptorSet::Slot::Slot(std::function<void()> const& release)
+    : mRelease(release) {
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+BindlessDescriptorSet::Slot::~Slot() {
+  mRelease();
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void BindlessDescriptorSet::allocate(uint32_t textureCapacity) {
+
+  std::array<vk::DescriptorPoolSize, 2> poolSizes;
+  poolSizes[0] = {vk::DescriptorType::eStorageBuffer, mMaxStorageBuffers};
+  poolSizes[1] = {vk::DescriptorType::eCombinedImageSampler, textureCapacity};
+
+  vk::DescriptorPoolCreateInfo poolInfo;
+  poolInfo.flags         = vk::DescriptorPoolCreateFlagBits::eUpdateAfterBindEXT;
+  poolInfo.maxSets       = 1;
+  poolInfo.poolSizeCount = static_cast<uint32_t>(poolSizes.size());
+  poolInfo.pPoolSizes    = poolSizes.data();
+
+  auto pool = mDevice->createDescriptorPool(poolInfo);
+
+  vk::DescriptorSetVariableDescriptorCountAllocateInfoEXT countInfo;
+  countInfo.descriptorSetCount = 1;
+  countInfo.pDescriptorCounts  = &textureCapacity;
+
+  vk::DescriptorSetLayout descriptorSetLayouts[] = {*mLayout};
+
+  vk::DescriptorSetAllocateInfo info;
+  info.pNext              = &countInfo;
+  info.descriptorPool     = *pool;
+  info.descriptorSetCount = 1;
+  info.pSetLayouts        = descriptorSetLayouts;
+
+  ILLUSION_TRACE << "Allocating BindlessDescriptorSet with " << textureCapacity
+                 << " texture slots." << std::endl;
+
+  // the set is freed together with its pool
+  auto set = VulkanPtr::create(mDevice->getHandle()->allocateDescriptorSets(info)[0],
+      [pool](vk::DescriptorSet* obj) { delete obj; });
+
+  // Pending CommandBuffers may still use the previous set. Its pool is destroyed by the
+  // DeletionQueue once the current frame has been processed by the GPU.
+  mSet             = set;
+  mTextureCapacity = textureCapacity;
+
+  for (uint32_t i = 0; i < mTextureInfos.size(); ++i) {
+    if (mTextureInfos[i].imageView) {
+      writeTexture(i, mTextureInfos[i]);
+    }
+  }
+
+  for (uint32_t i = 0; i < mStorageBufferInfos.size(); ++i) {
+    if (mStorageBufferInfos[i].buffer) {
+      writeStorageBuffer(i, mStorageBufferInfos[i]);
+    }
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void BindlessDescriptorSet::releaseTexture(uint32_t index) {
+  std::unique_lock<std::mutex> lock(mMutex);
+  mTextureInfos[index] = vk::DescriptorImageInfo();
+  mFreeTextureSlots.push_back(index);
+  --mTextureCount;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void BindlessDescriptorSet::releaseStorageBuffer(uint32_t index) {
+  std::unique_lock<std::mutex> lock(mMutex);
+  mStorageBufferInfos[index] = vk::DescriptorBufferInfo();
+  mFreeStorageBufferSlots.push_back(index);
+  --mStorageBufferCount;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void BindlessDescriptorSet::writeTexture(
+    uint32_t index, vk::DescriptorImageInfo const& info) const {
+  vk::WriteDescriptorSet writeInfo;
+  writeInfo.dstSet          = *mSet;
+  writeInfo.dstBinding      = TEXTURE_BINDING;
+  writeInfo.dstArrayElement = index;
+  writeInfo.descriptorCount = 1;
+  writeInfo.descriptorType  = vk::DescriptorType::eCombinedImageSampler;
+  writeInfo.pImageInfo      = &info;
+
+  mDevice->getHandle()->updateDescriptorSets(writeInfo, nullptr);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void BindlessDescriptorSet::writeStorageBuffer(
+    uint32_t index, vk::DescriptorBufferInfo const& info) const {
+  vk::WriteDescriptorSet writeInfo;
+  writeInfo.dstSet          = *mSet;
+  writeInfo.dstBinding      = STORAGE_BUFFER_BINDING;
+  writeInfo.dstArrayElement = index;
+  writeInfo.descriptorCount = 1;
+  writeInfo.descriptorType  = vk::DescriptorType::eStorageBuffer;
+  writeInfo.pBufferInfo     = &info;
+
+  mDevice->getHandle()->updateDescriptorSets(writeInfo, nullptr);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+} // namespace Illusion::Graphics
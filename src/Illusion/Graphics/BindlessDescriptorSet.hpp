@@ -0,0 +1,112 @@
+////////////////////////////////////////////////////////////////////////////////////////////////////
+//                                                                                                //
+//    _)  |  |            _)                This code may be used and modified under the terms    //
+//     |  |  |  |  | (_-<  |   _ \    \     of the MIT license. See the LICENSE file for details. //
+//    _| _| _| \_,_| ___/ _| \___/ _| _|    Copyright (c) 2018-2019 Simon Schneegans              //
+//                                                                                                //
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#ifndef ILLUSION_GRAPHICS_BINDLESS_DESCRIPTOR_SET_HPP
+#define ILLUSION_GRAPHICS_BINDLESS_DESCRIPTOR_SET_HPP
+
+#include "fwd.hpp"
+
+#include <functional>
+#include <mutex>
+
+namespace Illusion::Graphics {
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// The BindlessDescriptorSet is created by the Device when the bindless mode is enabled. It       //
+// contains a global array of storage buffers at binding 0 and a global array of combined image   //
+// samplers at binding 1. Each Texture and each BackedBuffer with the eStorageBuffer usage which  //
+// is created by the Device is written to a free slot of the corresponding array; the index of    //
+// this slot is stored in its mBindlessIndex and stays the same for the lifetime of the resource. //
+// Shaders can declare runtime arrays with the layout above and access resources by indices which //
+// are passed via push constants. Such sets are bound automatically by the CommandBuffer, the     //
+// BindingState is not used for them.                                                             //
+// The texture array grows on demand: a vk::DescriptorSet with twice the capacity is allocated    //
+// and all living textures are written to it. The previous set is destroyed by the DeletionQueue, //
+// as it may still be used by pending CommandBuffers. The storage buffer array has a fixed        //
+// capacity. All methods are thread-safe.                                                         //
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+class BindlessDescriptorSet : public std::enable_shared_from_this<BindlessDescriptorSet> {
+
+ public:
+  // Syntactic sugar to create a std::shared_ptr for this class
+  template <typename... Args>
+  static BindlessDescriptorSetPtr create(Args&&... args) {
+    return std::make_shared<BindlessDescriptorSet>(args...);
+  };
+
+  // The BindlessDescriptorSet is owned by the given Device, hence it only stores a raw pointer to
+  // it. The given capacities are clamped to the descriptor indexing limits of the PhysicalDevice.
+  BindlessDescriptorSet(Device const* device, uint32_t maxTextures = 16384,
+      uint32_t maxStorageBuffers = 4096, uint32_t initialTextureCapacity = 256);
+  virtual ~BindlessDescriptorSet();
+
+  // Writes the texture to a free slot and assigns the mBindlessIndex and mBindlessSlot of the
+  // texture. The slot is released once the texture is destroyed. Calling this for a texture which
+  // already has a slot is the same as calling updateTexture().
+  uint32_t addTexture(TexturePtr const& texture);
+
+  // Re-writes the slot of the texture. This is required if the view, the sampler or the layout of
+  // the texture has been changed.
+  void updateTexture(TexturePtr const& texture);
+
+  // Writes the buffer to a free slot and assigns the mBindlessIndex and mBindlessSlot of the
+  // buffer. The slot is released once the buffer is destroyed. The buffer must have been created
+  // with vk::BufferUsageFlagBits::eStorageBuffer.
+  uint32_t addStorageBuffer(BackedBufferPtr const& buffer);
+
+  // The returned set changes whenever the texture array grows.
+  vk::DescriptorSetPtr              getHandle() const;
+  vk::DescriptorSetLayoutPtr const& getLayout() const;
+
+  uint32_t getTextureCount() const;
+  uint32_t getTextureCapacity() const;
+  uint32_t getStorageBufferCount() const;
+
+ private:
+  // The mBindlessSlot of the resources points to such an object. Its destructor releases the slot.
+  struct Slot {
+    explicit Slot(std::function<void()> const& release);
+    ~Slot();
+
+    std::function<void()> mRelease;
+  };
+
+  // Allocates a new vk::DescriptorSet with the given texture capacity and writes all occupied
+  // slots to it.
+  void allocate(uint32_t textureCapacity);
+
+  void releaseTexture(uint32_t index);
+  void releaseStorageBuffer(uint32_t index);
+
+  void writeTexture(uint32_t index, vk::DescriptorImageInfo const& info) const;
+  void writeStorageBuffer(uint32_t index, vk::DescriptorBufferInfo const& info) const;
+
+  Device const*              mDevice;
+  uint32_t                   mMaxTextures;
+  uint32_t                   mMaxStorageBuffers;
+  vk::DescriptorSetLayoutPtr mLayout;
+
+  vk::DescriptorSetPtr mSet;
+  uint32_t             mTextureCapacity = 0;
+
+  // The infos are stored so that they can be written again when the texture array grows. Null
+  // handles mark unoccupied slots.
+  std::vector<vk::DescriptorImageInfo>  mTextureInfos;
+  std::vector<vk::DescriptorBufferInfo> mStorageBufferInfos;
+  std::vector<uint32_t>                 mFreeTextureSlots;
+  std::vector<uint32_t>                 mFreeStorageBufferSlots;
+  uint32_t                              mTextureCount       = 0;
+  uint32_t                              mStorageBufferCount = 0;
+
+  mutable std::mutex mMutex;
+};
+
+} // namespace Illusion::Graphics
+
+#endif // ILLUSION_GRAPHICS_BINDLESS_DESCRIPTOR_SET_HPP
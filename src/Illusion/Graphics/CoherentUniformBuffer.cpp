@@ -8,29 +8,61 @@
 
 #include "CoherentUniformBuffer.hpp"
 
+#include "../Core/Logger.hpp"
 #include "BackedBuffer.hpp"
 #include "Device.hpp"
+#include "PhysicalDevice.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <iostream>
 
 namespace Illusion::Graphics {
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////
 
 CoherentUniformBuffer::CoherentUniformBuffer(
-    DevicePtr const& device, vk::DeviceSize size, vk::DeviceSize alignment)
+    DevicePtr const& device, vk::DeviceSize size, vk::DeviceSize alignment, Memory memory)
     : mDevice(device)
-    , mBuffer(device->createBackedBuffer(vk::BufferUsageFlagBits::eUniformBuffer,
-          vk::MemoryPropertyFlagBits::eHostCoherent | vk::MemoryPropertyFlagBits::eHostVisible,
-          size))
     , mAlignment(alignment) {
 
-  mMappedData = (uint8_t*)mDevice->getHandle()->mapMemory(
-      *mBuffer->mMemory, 0, mBuffer->mMemoryInfo.allocationSize);
+  vk::MemoryPropertyFlags properties =
+      vk::MemoryPropertyFlagBits::eHostCoherent | vk::MemoryPropertyFlagBits::eHostVisible;
+
+  if (memory == Memory::eHostCached) {
+    properties = vk::MemoryPropertyFlagBits::eHostCached | vk::MemoryPropertyFlagBits::eHostVisible;
+  } else if (memory == Memory::eDeviceLocal) {
+    properties =
+        vk::MemoryPropertyFlagBits::eDeviceLocal | vk::MemoryPropertyFlagBits::eHostVisible;
+  }
+
+  try {
+    mBuffer = device->createBackedBuffer(vk::BufferUsageFlagBits::eUniformBuffer, properties, size);
+  } catch (std::exception const& e) {
+    if (memory == Memory::eHostCoherent) {
+      throw;
+    }
+
+    ILLUSION_WARNING << "Failed to allocate requested memory for CoherentUniformBuffer ("
+                     << e.what() << "). Using host-coherent memory instead." << std::endl;
+
+    mBuffer = device->createBackedBuffer(vk::BufferUsageFlagBits::eUniformBuffer,
+        vk::MemoryPropertyFlagBits::eHostCoherent | vk::MemoryPropertyFlagBits::eHostVisible,
+        size);
+  }
+
+  auto const& memoryProperties = device->getPhysicalDevice()->getMemoryProperties();
+  mIsCoherent = static_cast<bool>(
+      memoryProperties.memoryTypes[mBuffer->mMemoryInfo.memoryTypeIndex].propertyFlags &
+      vk::MemoryPropertyFlagBits::eHostCoherent);
+
+  // host visible memory is persistently mapped by the MemoryAllocator of the Device
+  mMappedData = mBuffer->mMappedData;
 }
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////
 
 CoherentUniformBuffer::~CoherentUniformBuffer() {
-  mDevice->getHandle()->unmapMemory(*mBuffer->mMemory);
 }
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -63,6 +95,46 @@ void CoherentUniformBuffer::updateData(
   }
 
   std::memcpy(mMappedData + offset, data, count);
+
+  if (!mIsCoherent) {
+    mDirtyBegin = std::min(mDirtyBegin, offset);
+    mDirtyEnd   = std::max(mDirtyEnd, offset + count);
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void CoherentUniformBuffer::flush() {
+  if (mIsCoherent || mDirtyBegin >= mDirtyEnd) {
+    return;
+  }
+
+  // The range has to be aligned to the nonCoherentAtomSize and is relative to the start of the
+  // vk::DeviceMemory block the buffer was sub-allocated from.
+  auto atomSize = mDevice->getPhysicalDevice()->getProperties().limits.nonCoherentAtomSize;
+  auto begin    = (mBuffer->mMemoryOffset + mDirtyBegin) / atomSize * atomSize;
+  auto end      = (mBuffer->mMemoryOffset + mDirtyEnd + atomSize - 1) / atomSize * atomSize;
+
+  vk::MappedMemoryRange range;
+  range.memory = *mBuffer->mMemory;
+  range.offset = begin;
+  range.size   = end - begin;
+
+  // The rounded range may exceed a dedicated allocation.
+  if (end > mBuffer->mMemoryOffset + mBuffer->mMemoryInfo.allocationSize) {
+    range.size = VK_WHOLE_SIZE;
+  }
+
+  mDevice->getHandle()->flushMappedMemoryRanges(range);
+
+  mDirtyBegin = ~0ull;
+  mDirtyEnd   = 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+bool CoherentUniformBuffer::getIsCoherent() const {
+  return mIsCoherent;
 }
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////
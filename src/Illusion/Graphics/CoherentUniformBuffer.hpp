@@ -14,16 +14,35 @@
 namespace Illusion::Graphics {
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////
+// The CoherentUniformBuffer is a persistently mapped BackedBuffer for uniform data which is      //
+// written by the CPU. By default it uses host-coherent memory. Alternatively, cached memory      //
+// (faster to write on many discrete GPUs) or device-local, host-visible memory (ReBAR, faster to //
+// read by the GPU) can be requested. If the memory turns out to be non-coherent, the ranges      //
+// written since the last call to flush() are flushed by flush(); this has to be called before    //
+// the CommandBuffers using the data are submitted. The FrameContext does this in endFrame().     //
 ////////////////////////////////////////////////////////////////////////////////////////////////////
 
 class CoherentUniformBuffer {
  public:
+  enum class Memory {
+    // eHostVisible | eHostCoherent
+    eHostCoherent,
+
+    // eHostVisible | eHostCached, this may be non-coherent.
+    eHostCached,
+
+    // eDeviceLocal | eHostVisible, this may be non-coherent. If no such memory type exists or its
+    // heap is exhausted, eHostCoherent memory is used instead.
+    eDeviceLocal
+  };
+
   template <typename... Args>
   static CoherentUniformBufferPtr create(Args&&... args) {
     return std::make_shared<CoherentUniformBuffer>(args...);
   };
 
-  CoherentUniformBuffer(DevicePtr const& device, vk::DeviceSize size, vk::DeviceSize alignment = 0);
+  CoherentUniformBuffer(DevicePtr const& device, vk::DeviceSize size, vk::DeviceSize alignment = 0,
+      Memory memory = Memory::eHostCoherent);
   virtual ~CoherentUniformBuffer();
 
   void reset();
@@ -42,6 +61,13 @@ class CoherentUniformBuffer {
     updateData((uint8_t*)&data, sizeof(data), offset);
   }
 
+  // Flushes the range which has been written since the last call. This does nothing if the memory
+  // is host-coherent or nothing has been written.
+  void flush();
+
+  // Returns true if the memory has the eHostCoherent property.
+  bool getIsCoherent() const;
+
   BackedBufferPtr const& getBuffer() const;
 
  private:
@@ -50,6 +76,12 @@ class CoherentUniformBuffer {
   uint8_t*        mMappedData         = nullptr;
   vk::DeviceSize  mCurrentWriteOffset = 0;
   vk::DeviceSize  mAlignment          = 0;
+  bool            mIsCoherent         = true;
+
+  // The range written since the last flush(), mDirtyBegin >= mDirtyEnd means that nothing has been
+  // written.
+  vk::DeviceSize mDirtyBegin = ~0ull;
+  vk::DeviceSize mDirtyEnd   = 0;
 };
 
 } // namespace Illusion::Graphics
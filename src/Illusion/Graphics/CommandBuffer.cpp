@@ -9,18 +9,159 @@
 #include "CommandBuffer.hpp"
 
 #include "../Core/Logger.hpp"
+#include "../Core/Tracer.hpp"
+#include "AccelerationStructure.hpp"
 #include "BackedBuffer.hpp"
+#include "BindlessDescriptorSet.hpp"
 #include "Device.hpp"
+#include "PassStatistics.hpp"
+#include "PhysicalDevice.hpp"
+#include "PipelineCache.hpp"
 #include "PipelineReflection.hpp"
+#include "PipelineState.hpp"
+#include "QueuePool.hpp"
 #include "RenderPass.hpp"
 #include "Shader.hpp"
 #include "ShaderModule.hpp"
 #include "Texture.hpp"
+#include "UploadManager.hpp"
+#include "Utils.hpp"
 
+#include <algorithm>
+#include <array>
+#include <cstring>
 #include <iostream>
+#include <variant>
 
 namespace Illusion::Graphics {
 
+namespace {
+
+// Calls the given function with the index of each set bit of the mask, in ascending order.
+template <typename F>
+void forEachBit(uint32_t mask, F const& function) {
+  for (uint32_t i = 0; mask != 0; ++i, mask >>= 1) {
+    if (mask & 1u) {
+      function(i);
+    }
+  }
+}
+
+// Returns true for bindings which require a dynamic offset.
+bool isDynamic(BindingType const& binding) {
+  return std::holds_alternative<DynamicUniformBufferBinding>(binding) ||
+         std::holds_alternative<DynamicStorageBufferBinding>(binding);
+}
+
+// This is used with std::visit to fill the vk::WriteDescriptorSet of a binding, std::visit uses a
+// jump table on the type of the binding. It returns true if the binding requires a dynamic offset.
+struct DescriptorWriter {
+  vk::WriteDescriptorSet&                         mWrite;
+  vk::DescriptorImageInfo&                        mImage;
+  vk::DescriptorBufferInfo&                       mBuffer;
+  vk::WriteDescriptorSetAccelerationStructureKHR& mAccelerationStructure;
+
+  bool operator()(CombinedImageSamplerBinding const& value) const {
+    mImage.imageLayout    = value.mTexture->mCurrentLayout;
+    mImage.imageView      = *value.mTexture->mView;
+    mImage.sampler        = *value.mTexture->mSampler;
+    mWrite.descriptorType = vk::DescriptorType::eCombinedImageSampler;
+    mWrite.pImageInfo     = &mImage;
+    return false;
+  }
+
+  bool operator()(StorageImageBinding const& value) const {
+    mImage.imageLayout    = value.mImage->mCurrentLayout;
+    mImage.imageView      = *(value.mView ? value.mView : value.mImage->mView);
+    mImage.sampler        = *value.mImage->mSampler;
+    mWrite.descriptorType = vk::DescriptorType::eStorageImage;
+    mWrite.pImageInfo     = &mImage;
+    return false;
+  }
+
+  bool operator()(InputAttachmentBinding const& value) const {
+    mImage.imageLayout    = vk::ImageLayout::eShaderReadOnlyOptimal;
+    mImage.imageView      = *value.mImage->mView;
+    mWrite.descriptorType = vk::DescriptorType::eInputAttachment;
+    mWrite.pImageInfo     = &mImage;
+    return false;
+  }
+
+  bool operator()(UniformBufferBinding const& value) const {
+    mBuffer.buffer        = *value.mBuffer->mBuffer;
+    mBuffer.offset        = value.mOffset;
+    mBuffer.range         = value.mSize;
+    mWrite.descriptorType = vk::DescriptorType::eUniformBuffer;
+    mWrite.pBufferInfo    = &mBuffer;
+    return false;
+  }
+
+  bool operator()(DynamicUniformBufferBinding const& value) const {
+    mBuffer.buffer        = *value.mBuffer->mBuffer;
+    mBuffer.range         = value.mSize;
+    mWrite.descriptorType = vk::DescriptorType::eUniformBufferDynamic;
+    mWrite.pBufferInfo    = &mBuffer;
+    return true;
+  }
+
+  bool operator()(StorageBufferBinding const& value) const {
+    mBuffer.buffer        = *value.mBuffer->mBuffer;
+    mBuffer.offset        = value.mOffset;
+    mBuffer.range         = value.mSize;
+    mWrite.descriptorType = vk::DescriptorType::eStorageBuffer;
+    mWrite.pBufferInfo    = &mBuffer;
+    return false;
+  }
+
+  bool operator()(DynamicStorageBufferBinding const& value) const {
+    mBuffer.buffer        = *value.mBuffer->mBuffer;
+    mBuffer.range         = value.mSize;
+    mWrite.descriptorType = vk::DescriptorType::eStorageBufferDynamic;
+    mWrite.pBufferInfo    = &mBuffer;
+    return true;
+  }
+
+  bool operator()(AccelerationStructureBinding const& value) const {
+    mAccelerationStructure.accelerationStructureCount = 1;
+    mAccelerationStructure.pAccelerationStructures =
+        value.mAccelerationStructure->mAccelerationStructure.get();
+    mWrite.descriptorType = vk::DescriptorType::eAccelerationStructureKHR;
+    mWrite.pNext          = &mAccelerationStructure;
+    return false;
+  }
+};
+
+// This is used with std::visit to collect the resources a descriptor set depends on.
+struct DependencyCollector {
+  std::vector<std::weak_ptr<void>>& mDependencies;
+
+  void operator()(CombinedImageSamplerBinding const& value) const {
+    mDependencies.push_back(value.mTexture);
+  }
+
+  void operator()(StorageImageBinding const& value) const {
+    mDependencies.push_back(value.mImage);
+    if (value.mView) {
+      mDependencies.push_back(value.mView);
+    }
+  }
+
+  void operator()(InputAttachmentBinding const& value) const {
+    mDependencies.push_back(value.mImage);
+  }
+
+  void operator()(AccelerationStructureBinding const& value) const {
+    mDependencies.push_back(value.mAccelerationStructure->mAccelerationStructure);
+  }
+
+  template <typename T>
+  void operator()(T const& value) const {
+    mDependencies.push_back(value.mBuffer);
+  }
+};
+
+} // namespace
+
 ////////////////////////////////////////////////////////////////////////////////////////////////////
 
 CommandBuffer::CommandBuffer(DevicePtr const& device, QueueType type, vk::CommandBufferLevel level)
@@ -36,24 +177,104 @@ CommandBuffer::CommandBuffer(DevicePtr const& device, QueueType type, vk::Comman
 
 void CommandBuffer::reset() {
   mBindingState.reset();
-  mCurrentDescriptorSets.clear();
+  invalidateBoundState();
+  mSkippedCommands = {};
   mDescriptorSetCache.releaseAll();
   mCurrentRenderPass.reset();
   mCurrentSubPass = 0;
 
+  mImageStates.clear();
+  mBufferStates.clear();
+  mPendingImageBarriers.clear();
+  mPendingBufferBarriers.clear();
+  mPendingSrcStages = vk::PipelineStageFlags();
+  mPendingDstStages = vk::PipelineStageFlags();
+
   mVkCmd->reset({});
 }
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////
 
-void CommandBuffer::begin(vk::CommandBufferUsageFlagBits usage) const {
+void CommandBuffer::begin(vk::CommandBufferUsageFlagBits usage) {
+  invalidateBoundState();
+  mStatistics = {};
   mVkCmd->begin({usage});
 }
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////
 
-void CommandBuffer::end() const {
+void CommandBuffer::begin(
+    RenderPassPtr const& renderPass, uint32_t subPass, vk::CommandBufferUsageFlags usage) {
+
+  if (mLevel != vk::CommandBufferLevel::eSecondary) {
+    throw std::runtime_error(
+        "Failed to begin CommandBuffer: Only secondary CommandBuffers can continue a RenderPass!");
+  }
+
+  vk::CommandBufferInheritanceInfo inheritanceInfo;
+
+  // without a vk::RenderPass, the formats of the attachments are inherited instead
+  vk::CommandBufferInheritanceRenderingInfoKHR renderingInfo;
+  std::vector<vk::Format>                      colorFormats;
+
+  if (renderPass->getDynamicRendering()) {
+    auto const& attachments = renderPass->getAttachments();
+    auto        depth       = renderPass->getDepthAttachment();
+
+    for (uint32_t i : renderPass->getColorAttachments()) {
+      colorFormats.push_back(attachments[i].mFormat);
+    }
+
+    renderingInfo.colorAttachmentCount    = static_cast<uint32_t>(colorFormats.size());
+    renderingInfo.pColorAttachmentFormats = colorFormats.data();
+    renderingInfo.rasterizationSamples    = renderPass->getSampleCount();
+    renderingInfo.viewMask                = renderPass->getViewMask();
+
+    if (depth) {
+      renderingInfo.depthAttachmentFormat = attachments[*depth].mFormat;
+      if (Utils::isDepthStencilFormat(attachments[*depth].mFormat)) {
+        renderingInfo.stencilAttachmentFormat = attachments[*depth].mFormat;
+      }
+    }
+
+    inheritanceInfo.pNext = &renderingInfo;
+  } else {
+    inheritanceInfo.renderPass  = *renderPass->getHandle();
+    inheritanceInfo.subpass     = subPass;
+    inheritanceInfo.framebuffer = *renderPass->getFramebuffer()->getHandle();
+  }
+
+  // allows the execution inside the scopes of the PassStatistics
+  auto const& features = mDevice->getEnabledFeatures();
+  if (features.inheritedQueries) {
+    inheritanceInfo.occlusionQueryEnable = true;
+
+    if (features.pipelineStatisticsQuery) {
+      inheritanceInfo.pipelineStatistics = PassStatistics::getStatisticFlags();
+    }
+  }
+
+  invalidateBoundState();
+  mStatistics = {};
+
+  vk::CommandBufferBeginInfo info;
+  info.flags            = usage | vk::CommandBufferUsageFlagBits::eRenderPassContinue;
+  info.pInheritanceInfo = &inheritanceInfo;
+
+  mVkCmd->begin(info);
+
+  mCurrentRenderPass = renderPass;
+  mCurrentSubPass    = subPass;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void CommandBuffer::end() {
+  flushBarriers();
   mVkCmd->end();
+
+  mDevice->getFrameStatistics()->add(mStatistics);
+  mStatistics = {};
 }
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -62,6 +283,10 @@ void CommandBuffer::submit(std::vector<vk::Semaphore> const& waitSemaphores,
     std::vector<vk::PipelineStageFlags> const&               waitStages,
     std::vector<vk::Semaphore> const& signalSemaphores, vk::Fence const& fence) const {
 
+  // Make sure that all pending uploads are submitted before; their barriers make the uploaded
+  // resources available to this CommandBuffer.
+  mDevice->getUploadManager()->flush();
+
   vk::CommandBuffer bufs[] = {*mVkCmd};
 
   vk::SubmitInfo info;
@@ -73,38 +298,59 @@ void CommandBuffer::submit(std::vector<vk::Semaphore> const& waitSemaphores,
   info.waitSemaphoreCount   = static_cast<uint32_t>(waitSemaphores.size());
   info.pWaitSemaphores      = waitSemaphores.data();
 
-  mDevice->getQueue(mType).submit(info, fence);
+  mDevice->getQueuePool()->lock(mType)->submit(info, fence);
+  mDevice->getFrameStatistics()->add(&FrameStatistics::Counters::mSubmits);
 }
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////
 
 void CommandBuffer::waitIdle() const {
-  mDevice->getQueue(mType).waitIdle();
+  mDevice->getQueuePool()->lock(mType)->waitIdle();
 }
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////
 
-void CommandBuffer::beginRenderPass(RenderPassPtr const& renderPass) {
-  renderPass->init();
+vk::CommandBufferPtr const& CommandBuffer::getHandle() const {
+  return mVkCmd;
+}
 
-  vk::RenderPassBeginInfo passInfo;
-  passInfo.renderPass               = *renderPass->getHandle();
-  passInfo.framebuffer              = *renderPass->getFramebuffer()->getHandle();
-  passInfo.renderArea.offset        = vk::Offset2D(0, 0);
-  passInfo.renderArea.extent.width  = renderPass->getExtent().x;
-  passInfo.renderArea.extent.height = renderPass->getExtent().y;
+////////////////////////////////////////////////////////////////////////////////////////////////////
 
-  std::vector<vk::ClearValue> clearValues;
-  clearValues.push_back(vk::ClearColorValue(std::array<float, 4>{{0.f, 0.f, 0.f, 0.f}}));
+QueueType CommandBuffer::getQueueType() const {
+  return mType;
+}
 
-  if (renderPass->hasDepthAttachment()) {
-    clearValues.push_back(vk::ClearDepthStencilValue(1.f, 0u));
-  }
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void CommandBuffer::beginRenderPass(
+    RenderPassPtr const& renderPass, vk::SubpassContents contents) {
+  renderPass->init();
+
+  // barriers cannot be recorded inside the RenderPass
+  flushBarriers();
 
-  passInfo.clearValueCount = static_cast<uint32_t>(clearValues.size());
-  passInfo.pClearValues    = clearValues.data();
+  if (mPassStatistics && !mPassStatistics->isScopeOpen()) {
+    mPassStatistics->beginScope(*this, renderPass->getName());
+    mPassStatisticsScope = true;
+  }
 
-  mVkCmd->beginRenderPass(passInfo, vk::SubpassContents::eInline);
+  if (renderPass->getDynamicRendering()) {
+    beginRendering(renderPass, contents);
+  } else {
+    vk::RenderPassBeginInfo passInfo;
+    passInfo.renderPass               = *renderPass->getHandle();
+    passInfo.framebuffer              = *renderPass->getFramebuffer()->getHandle();
+    passInfo.renderArea.offset        = vk::Offset2D(0, 0);
+    passInfo.renderArea.extent.width  = renderPass->getExtent().x;
+    passInfo.renderArea.extent.height = renderPass->getExtent().y;
+
+    // the clear values are ignored for attachments which are not cleared
+    auto const& clearValues  = renderPass->getClearValues();
+    passInfo.clearValueCount = static_cast<uint32_t>(clearValues.size());
+    passInfo.pClearValues    = clearValues.data();
+
+    mVkCmd->beginRenderPass(passInfo, contents);
+  }
 
   mCurrentRenderPass = renderPass;
   mCurrentSubPass    = 0;
@@ -112,9 +358,47 @@ void CommandBuffer::beginRenderPass(RenderPassPtr const& renderPass) {
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////
 
+void CommandBuffer::nextSubPass(vk::SubpassContents contents) {
+  if (mCurrentRenderPass && mCurrentRenderPass->getDynamicRendering()) {
+    throw std::runtime_error(
+        "Failed to advance to next subpass: Dynamic rendering does not support subpasses!");
+  }
+
+  mVkCmd->nextSubpass(contents);
+  ++mCurrentSubPass;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
 void CommandBuffer::endRenderPass() {
-  mVkCmd->endRenderPass();
+  if (mCurrentRenderPass && mCurrentRenderPass->getDynamicRendering()) {
+    endRendering();
+  } else {
+    mVkCmd->endRenderPass();
+  }
+
   mCurrentRenderPass.reset();
+
+  if (mPassStatisticsScope) {
+    mPassStatistics->endScope(*this);
+    mPassStatisticsScope = false;
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void CommandBuffer::execute(std::vector<CommandBufferPtr> const& secondaryCommandBuffers) {
+  std::vector<vk::CommandBuffer> handles;
+  handles.reserve(secondaryCommandBuffers.size());
+
+  for (auto const& cmd : secondaryCommandBuffers) {
+    handles.push_back(*cmd->mVkCmd);
+  }
+
+  mVkCmd->executeCommands(handles);
+
+  // the secondary CommandBuffers may have bound anything
+  invalidateBoundState();
 }
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -137,8 +421,18 @@ BindingState const& CommandBuffer::bindingState() const {
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////
 
+SpecializationState& CommandBuffer::specializationState() {
+  return mSpecializationState;
+}
+SpecializationState const& CommandBuffer::specializationState() const {
+  return mSpecializationState;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
 void CommandBuffer::setShader(ShaderPtr const& val) {
   mCurrentShader = val;
+  mCurrentPipelineState.reset();
 }
 ShaderPtr const& CommandBuffer::getShader() const {
   return mCurrentShader;
@@ -146,15 +440,54 @@ ShaderPtr const& CommandBuffer::getShader() const {
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////
 
+void CommandBuffer::bindPipelineState(PipelineStatePtr const& state) {
+  mCurrentPipelineState = state;
+
+  if (state) {
+    mCurrentShader = state->getShader();
+
+    if (state->getBindPoint() == vk::PipelineBindPoint::eGraphics) {
+      mGraphicsState = state->getGraphicsState();
+    }
+  }
+}
+PipelineStatePtr const& CommandBuffer::getPipelineState() const {
+  return mCurrentPipelineState;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void CommandBuffer::setAsyncPipelineCreation(bool enable) {
+  mAsyncPipelineCreation = enable;
+}
+bool CommandBuffer::getAsyncPipelineCreation() const {
+  return mAsyncPipelineCreation;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
 void CommandBuffer::bindIndexBuffer(
-    BackedBufferPtr const& buffer, vk::DeviceSize offset, vk::IndexType indexType) const {
-  mVkCmd->bindIndexBuffer(*buffer->mBuffer, offset, indexType);
+    BackedBufferPtr const& buffer, vk::DeviceSize offset, vk::IndexType indexType) {
+
+  vk::Buffer handle = *buffer->mBuffer;
+
+  if (handle == mCurrentIndexBuffer && offset == mCurrentIndexOffset &&
+      indexType == mCurrentIndexType) {
+    ++mSkippedCommands.mIndexBufferBinds;
+    return;
+  }
+
+  mVkCmd->bindIndexBuffer(handle, offset, indexType);
+
+  mCurrentIndexBuffer = handle;
+  mCurrentIndexOffset = offset;
+  mCurrentIndexType   = indexType;
 }
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////
 
 void CommandBuffer::bindVertexBuffers(uint32_t                     firstBinding,
-    std::vector<std::pair<BackedBufferPtr, vk::DeviceSize>> const& buffersAndOffsets) const {
+    std::vector<std::pair<BackedBufferPtr, vk::DeviceSize>> const& buffersAndOffsets) {
 
   std::vector<vk::Buffer>     buffers;
   std::vector<vk::DeviceSize> offsets;
@@ -164,13 +497,13 @@ void CommandBuffer::bindVertexBuffers(uint32_t                     firstBinding,
     offsets.emplace_back(v.second);
   }
 
-  mVkCmd->bindVertexBuffers(firstBinding, buffers, offsets);
+  recordVertexBuffers(firstBinding, buffers, offsets);
 }
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////
 
 void CommandBuffer::bindVertexBuffers(
-    uint32_t firstBinding, std::vector<BackedBufferPtr> const& buffs) const {
+    uint32_t firstBinding, std::vector<BackedBufferPtr> const& buffs) {
 
   std::vector<vk::Buffer>     buffers;
   std::vector<vk::DeviceSize> offsets;
@@ -180,12 +513,12 @@ void CommandBuffer::bindVertexBuffers(
     offsets.emplace_back(0uL);
   }
 
-  mVkCmd->bindVertexBuffers(firstBinding, buffers, offsets);
+  recordVertexBuffers(firstBinding, buffers, offsets);
 }
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////
 
-void CommandBuffer::pushConstants(const void* data, uint32_t size, uint32_t offset) const {
+void CommandBuffer::pushConstants(const void* data, uint32_t size, uint32_t offset) {
   auto const& reflection = mCurrentShader->getReflection();
   auto constants = reflection->getResources(PipelineResource::ResourceType::ePushConstantBuffer);
 
@@ -194,552 +527,1555 @@ void CommandBuffer::pushConstants(const void* data, uint32_t size, uint32_t offs
                              "PushConstantBuffer defined in the pipeline reflection!");
   }
 
+  // the pushed values are only known for the pipeline layout they have been pushed with
+  if (reflection->getLayout() != mPushConstantLayout) {
+    mPushConstantLayout = reflection->getLayout();
+    mPushConstantBegin  = 0;
+    mPushConstantEnd    = 0;
+  }
+
+  uint32_t end = offset + size;
+
+  if (offset >= mPushConstantBegin && end <= mPushConstantEnd &&
+      std::memcmp(mPushConstants.data() + offset, data, size) == 0) {
+    ++mSkippedCommands.mPushConstants;
+    return;
+  }
+
   mVkCmd->pushConstants(
       *reflection->getLayout(), constants.begin()->second.mStages, offset, size, data);
+
+  if (mPushConstants.size() < end) {
+    mPushConstants.resize(end);
+  }
+
+  std::memcpy(mPushConstants.data() + offset, data, size);
+
+  // the known range is extended if the new data overlaps or touches it, else it is replaced
+  if (mPushConstantBegin == mPushConstantEnd || offset > mPushConstantEnd ||
+      end < mPushConstantBegin) {
+    mPushConstantBegin = offset;
+    mPushConstantEnd   = end;
+  } else {
+    mPushConstantBegin = std::min(mPushConstantBegin, offset);
+    mPushConstantEnd   = std::max(mPushConstantEnd, end);
+  }
 }
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////
 
 void CommandBuffer::draw(
     uint32_t vertexCount, uint32_t instanceCount, uint32_t firstVertex, uint32_t firstInstance) {
-  flush();
-  mVkCmd->draw(vertexCount, instanceCount, firstVertex, firstInstance);
+  if (flush(vk::PipelineBindPoint::eGraphics)) {
+    mVkCmd->draw(vertexCount, instanceCount, firstVertex, firstInstance);
+    ++mStatistics.mDraws;
+  }
 }
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////
 
 void CommandBuffer::drawIndexed(uint32_t indexCount, uint32_t instanceCount, uint32_t firstIndex,
     int32_t vertexOffset, uint32_t firstInstance) {
-  flush();
-  mVkCmd->drawIndexed(indexCount, instanceCount, firstIndex, vertexOffset, firstInstance);
+  if (flush(vk::PipelineBindPoint::eGraphics)) {
+    mVkCmd->drawIndexed(indexCount, instanceCount, firstIndex, vertexOffset, firstInstance);
+    ++mStatistics.mDraws;
+  }
 }
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////
 
-void CommandBuffer::dispatch(uint32_t groupCountX, uint32_t groupCountY, uint32_t groupCountZ) {
-  flush();
-  mVkCmd->dispatch(groupCountX, groupCountY, groupCountZ);
+void CommandBuffer::drawIndexedIndirect(
+    BackedBufferPtr const& buffer, vk::DeviceSize offset, uint32_t drawCount, uint32_t stride) {
+
+  if (!mCurrentRenderPass) {
+    accessBuffer(
+        buffer, vk::PipelineStageFlagBits::eDrawIndirect, vk::AccessFlagBits::eIndirectCommandRead);
+  }
+
+  if (!flush(vk::PipelineBindPoint::eGraphics)) {
+    return;
+  }
+
+  ++mStatistics.mDraws;
+
+  if (drawCount <= 1 || mDevice->getEnabledFeatures().multiDrawIndirect) {
+    mVkCmd->drawIndexedIndirect(*buffer->mBuffer, offset, drawCount, stride);
+    return;
+  }
+
+  for (uint32_t i(0); i < drawCount; ++i) {
+    mVkCmd->drawIndexedIndirect(*buffer->mBuffer, offset + i * stride, 1, stride);
+  }
 }
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////
 
-void CommandBuffer::transitionImageLayout(vk::Image image, vk::ImageLayout oldLayout,
-    vk::ImageLayout newLayout, vk::PipelineStageFlagBits srcStage,
-    vk::PipelineStageFlagBits dstStage, vk::ImageSubresourceRange range) const {
-
-  // clang-format off
-  static const std::unordered_map<vk::ImageLayout, vk::AccessFlags> accessMapping = {
-    {vk::ImageLayout::eUndefined,                     vk::AccessFlags()},
-    {vk::ImageLayout::eGeneral,                       vk::AccessFlagBits::eShaderRead | vk::AccessFlagBits::eShaderWrite},
-    {vk::ImageLayout::eColorAttachmentOptimal,        vk::AccessFlagBits::eColorAttachmentRead | vk::AccessFlagBits::eColorAttachmentWrite},
-    {vk::ImageLayout::eDepthStencilReadOnlyOptimal,   vk::AccessFlagBits::eDepthStencilAttachmentRead},
-    {vk::ImageLayout::eDepthStencilAttachmentOptimal, vk::AccessFlagBits::eDepthStencilAttachmentRead | vk::AccessFlagBits::eDepthStencilAttachmentWrite},
-    {vk::ImageLayout::eShaderReadOnlyOptimal,         vk::AccessFlagBits::eShaderRead},
-    {vk::ImageLayout::eTransferDstOptimal,            vk::AccessFlagBits::eTransferWrite},
-    {vk::ImageLayout::eTransferSrcOptimal,            vk::AccessFlagBits::eTransferRead},
-    {vk::ImageLayout::ePresentSrcKHR,                 vk::AccessFlagBits::eMemoryRead}
-  };
-  // clang-format on
+void CommandBuffer::drawIndexedIndirectCount(BackedBufferPtr const& buffer, vk::DeviceSize offset,
+    BackedBufferPtr const& countBuffer, vk::DeviceSize countOffset, uint32_t maxDrawCount,
+    uint32_t stride) {
 
-  auto srcAccess = accessMapping.find(oldLayout);
-  auto dstAccess = accessMapping.find(newLayout);
+  auto drawIndexedIndirectCount = mDevice->getDrawIndexedIndirectCountFunction();
 
-  if (srcAccess == accessMapping.end() || dstAccess == accessMapping.end()) {
-    throw std::runtime_error("Failed to transition image layout: Unsupported transition!");
+  if (!drawIndexedIndirectCount) {
+    throw std::runtime_error(
+        "Failed to record indirect draw: VK_KHR_draw_indirect_count is not supported!");
   }
 
-  vk::ImageMemoryBarrier barrier;
-  barrier.oldLayout           = oldLayout;
-  barrier.newLayout           = newLayout;
-  barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-  barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-  barrier.image               = image;
-  barrier.subresourceRange    = range;
-  barrier.srcAccessMask       = srcAccess->second;
-  barrier.dstAccessMask       = dstAccess->second;
+  if (!mCurrentRenderPass) {
+    accessBuffer(
+        buffer, vk::PipelineStageFlagBits::eDrawIndirect, vk::AccessFlagBits::eIndirectCommandRead);
+    accessBuffer(countBuffer, vk::PipelineStageFlagBits::eDrawIndirect,
+        vk::AccessFlagBits::eIndirectCommandRead);
+  }
 
-  mVkCmd->pipelineBarrier(srcStage, dstStage, vk::DependencyFlagBits(), nullptr, nullptr, barrier);
+  if (flush(vk::PipelineBindPoint::eGraphics)) {
+    drawIndexedIndirectCount(*mVkCmd, *buffer->mBuffer, offset, *countBuffer->mBuffer, countOffset,
+        maxDrawCount, stride);
+    ++mStatistics.mDraws;
+  }
 }
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////
 
-void CommandBuffer::copyImage(vk::Image src, vk::Image dst, glm::uvec2 const& size) const {
+void CommandBuffer::drawMeshTasks(
+    uint32_t groupCountX, uint32_t groupCountY, uint32_t groupCountZ) {
 
-  vk::ImageSubresourceLayers subResource;
-  subResource.aspectMask     = vk::ImageAspectFlagBits::eColor;
-  subResource.baseArrayLayer = 0;
-  subResource.mipLevel       = 0;
-  subResource.layerCount     = 1;
+  auto drawMeshTasks = mDevice->getDrawMeshTasksFunction();
 
-  vk::ImageCopy region;
-  region.srcSubresource = subResource;
-  region.dstSubresource = subResource;
-  region.srcOffset      = vk::Offset3D(0, 0, 0);
-  region.dstOffset      = vk::Offset3D(0, 0, 0);
-  region.extent.width   = size.x;
-  region.extent.height  = size.y;
-  region.extent.depth   = 1;
+  if (!drawMeshTasks) {
+    throw std::runtime_error("Failed to record mesh tasks: VK_EXT_mesh_shader is not supported!");
+  }
 
-  mVkCmd->copyImage(
-      src, vk::ImageLayout::eTransferSrcOptimal, dst, vk::ImageLayout::eTransferDstOptimal, region);
+  if (flush(vk::PipelineBindPoint::eGraphics)) {
+    drawMeshTasks(*mVkCmd, groupCountX, groupCountY, groupCountZ);
+    ++mStatistics.mDraws;
+  }
 }
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////
 
-void CommandBuffer::blitImage(vk::Image src, vk::Image dst, glm::uvec2 const& srcSize,
-    glm::uvec2 const& dstSize, vk::Filter filter) const {
-
-  blitImage(src, 0, dst, 0, srcSize, dstSize, 1, filter);
+void CommandBuffer::dispatch(uint32_t groupCountX, uint32_t groupCountY, uint32_t groupCountZ) {
+  if (flush(vk::PipelineBindPoint::eCompute)) {
+    mVkCmd->dispatch(groupCountX, groupCountY, groupCountZ);
+    ++mStatistics.mDispatches;
+  }
 }
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////
 
-void CommandBuffer::blitImage(vk::Image src, uint32_t srcMipmapLevel, vk::Image dst,
-    uint32_t dstMipmapLevel, glm::uvec2 const& srcSize, glm::uvec2 const& dstSize,
-    uint32_t layerCount, vk::Filter filter) const {
+void CommandBuffer::transitionImage(BackedImagePtr const& image, vk::ImageLayout layout,
+    vk::PipelineStageFlags stages, vk::AccessFlags access) {
 
-  vk::ImageBlit info;
-  info.srcSubresource.aspectMask = vk::ImageAspectFlagBits::eColor;
-  info.srcSubresource.layerCount = layerCount;
-  info.srcSubresource.mipLevel   = srcMipmapLevel;
-  info.srcOffsets[0]             = vk::Offset3D(0, 0, 0);
-  info.srcOffsets[1]             = vk::Offset3D(srcSize.x, srcSize.y, 1);
-  info.dstSubresource.aspectMask = vk::ImageAspectFlagBits::eColor;
-  info.dstSubresource.layerCount = layerCount;
-  info.dstSubresource.mipLevel   = dstMipmapLevel;
-  info.dstOffsets[0]             = vk::Offset3D(0, 0, 0);
-  info.dstOffsets[1]             = vk::Offset3D(dstSize.x, dstSize.y, 1);
+  vk::ImageSubresourceRange range;
+  range.aspectMask     = image->mViewInfo.subresourceRange.aspectMask;
+  range.baseMipLevel   = 0;
+  range.levelCount     = image->mImageInfo.mipLevels;
+  range.baseArrayLayer = 0;
+  range.layerCount     = image->mImageInfo.arrayLayers;
 
-  mVkCmd->blitImage(src, vk::ImageLayout::eTransferSrcOptimal, dst,
-      vk::ImageLayout::eTransferDstOptimal, info, filter);
+  transitionImage(image, layout, stages, access, range);
 }
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////
 
-void CommandBuffer::resolveImage(vk::Image src, vk::ImageLayout srcLayout, vk::Image dst,
-    vk::ImageLayout dstLayout, vk::ImageResolve region) const {
-  mVkCmd->resolveImage(src, srcLayout, dst, dstLayout, region);
-}
+void CommandBuffer::transitionImage(BackedImagePtr const& image, vk::ImageLayout layout,
+    vk::PipelineStageFlags stages, vk::AccessFlags access, vk::ImageSubresourceRange const& range) {
 
-////////////////////////////////////////////////////////////////////////////////////////////////////
+  uint32_t layers = image->mImageInfo.arrayLayers;
 
-void CommandBuffer::copyBuffer(vk::Buffer src, vk::Buffer dst, vk::DeviceSize size) const {
-  vk::BufferCopy region;
-  region.size = size;
+  auto& states = mImageStates[image];
+  if (states.empty()) {
+    AccessState state;
+    state.mLayout = image->mCurrentLayout;
+    states.resize(image->mImageInfo.mipLevels * layers, state);
+  }
 
-  mVkCmd->copyBuffer(src, dst, 1, &region);
-}
+  uint32_t levelCount = range.levelCount == VK_REMAINING_MIP_LEVELS
+                            ? image->mImageInfo.mipLevels - range.baseMipLevel
+                            : range.levelCount;
+  uint32_t layerCount = range.layerCount == VK_REMAINING_ARRAY_LAYERS
+                            ? layers - range.baseArrayLayer
+                            : range.layerCount;
+
+  // The barriers of one vkCmdPipelineBarrier are not ordered. Hence, if one of the subresources is
+  // already part of the pending barriers, these have to be flushed first.
+  for (uint32_t mip = range.baseMipLevel; mip < range.baseMipLevel + levelCount; ++mip) {
+    for (uint32_t layer = range.baseArrayLayer; layer < range.baseArrayLayer + layerCount;
+         ++layer) {
+      if (states[mip * layers + layer].mBatch == mCurrentBatch) {
+        flushBarriers();
+      }
+    }
+  }
 
-////////////////////////////////////////////////////////////////////////////////////////////////////
+  for (uint32_t mip = range.baseMipLevel; mip < range.baseMipLevel + levelCount; ++mip) {
+    for (uint32_t layer = range.baseArrayLayer; layer < range.baseArrayLayer + layerCount;
+         ++layer) {
 
-void CommandBuffer::copyBufferToImage(vk::Buffer src, vk::Image dst, vk::ImageLayout dstLayout,
-    std::vector<vk::BufferImageCopy> const& infos) const {
+      auto&                  state     = states[mip * layers + layer];
+      vk::ImageLayout        oldLayout = state.mLayout;
+      vk::PipelineStageFlags srcStages;
+      vk::AccessFlags        srcAccess;
 
-  mVkCmd->copyBufferToImage(src, dst, dstLayout, infos);
-}
+      if (!updateState(state, layout, stages, access, srcStages, srcAccess)) {
+        continue;
+      }
 
-////////////////////////////////////////////////////////////////////////////////////////////////////
+      state.mBatch = mCurrentBatch;
 
-void CommandBuffer::flush() {
+      vk::ImageMemoryBarrier barrier;
+      barrier.oldLayout           = oldLayout;
+      barrier.newLayout           = layout;
+      barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+      barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+      barrier.image               = *image->mImage;
+      barrier.subresourceRange    = {range.aspectMask, mip, 1, layer, 1};
+      barrier.srcAccessMask       = srcAccess;
+      barrier.dstAccessMask       = access;
 
-  vk::PipelineBindPoint bindPoint = mType == QueueType::eCompute ? vk::PipelineBindPoint::eCompute
-                                                                 : vk::PipelineBindPoint::eGraphics;
+      addImageBarrier(barrier);
 
-  // create (or retrieve from cache) and bind a pipeline -------------------------------------------
-  auto pipeline = getPipelineHandle();
-  mVkCmd->bindPipeline(bindPoint, *pipeline);
+      mPendingSrcStages |= srcStages;
+      mPendingDstStages |= stages;
+    }
+  }
 
-  // now bind and update all descriptor sets -------------------------------------------------------
+  // the tracked layout is stored in the image if it is the same for all subresources
+  bool uniform = true;
+  for (auto const& state : states) {
+    uniform &= state.mLayout == layout;
+  }
 
-  // the logic is roughly as follows:
+  if (uniform) {
+    image->mCurrentLayout = layout;
+  }
+}
 
-  // for each descriptor set number of the current program
-  //   if binding state of this set number is dirty (a binding for this set has been changed)
-  //     or no descriptor set is currently bound for this set
-  //     or the layout of the currently bound descriptor set is incompatible to the current program
-  //       acquire new descriptor set
-  //       update descriptor set
-  //       bind descriptor set
-  //       store hash for compatibility checks
-  //   else if a dynamic offset has been changed
-  //       re-bind current descriptor set
+////////////////////////////////////////////////////////////////////////////////////////////////////
 
-  // get descriptor set layouts of the current program
-  auto const& setReflections = mCurrentShader->getDescriptorSetReflections();
+void CommandBuffer::accessBuffer(
+    BackedBufferPtr const& buffer, vk::PipelineStageFlags stages, vk::AccessFlags access) {
 
-  for (uint32_t setNum = 0; setNum < setReflections.size(); ++setNum) {
+  auto& state = mBufferStates[buffer];
+
+  if (state.mBatch == mCurrentBatch) {
+    flushBarriers();
+  }
+
+  vk::PipelineStageFlags srcStages;
+  vk::AccessFlags        srcAccess;
+
+  if (!updateState(state, vk::ImageLayout::eUndefined, stages, access, srcStages, srcAccess)) {
+    return;
+  }
+
+  state.mBatch = mCurrentBatch;
+
+  vk::BufferMemoryBarrier barrier;
+  barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  barrier.buffer              = *buffer->mBuffer;
+  barrier.offset              = 0;
+  barrier.size                = VK_WHOLE_SIZE;
+  barrier.srcAccessMask       = srcAccess;
+  barrier.dstAccessMask       = access;
+
+  mPendingBufferBarriers.push_back(barrier);
+
+  mPendingSrcStages |= srcStages;
+  mPendingDstStages |= stages;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void CommandBuffer::flushBarriers() {
+  if (mPendingImageBarriers.empty() && mPendingBufferBarriers.empty()) {
+    return;
+  }
+
+  // the source stage mask must not be empty, this happens when nothing has been accessed before
+  if (!mPendingSrcStages) {
+    mPendingSrcStages = vk::PipelineStageFlagBits::eTopOfPipe;
+  }
+
+  mVkCmd->pipelineBarrier(mPendingSrcStages, mPendingDstStages, vk::DependencyFlags(), nullptr,
+      mPendingBufferBarriers, mPendingImageBarriers);
+  ++mStatistics.mBarriers;
+
+  mPendingImageBarriers.clear();
+  mPendingBufferBarriers.clear();
+  mPendingSrcStages = vk::PipelineStageFlags();
+  mPendingDstStages = vk::PipelineStageFlags();
+
+  // this marks all states as not pending
+  ++mCurrentBatch;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void CommandBuffer::releaseImage(BackedImagePtr const& image, QueueType dstType) {
+  uint32_t srcFamily = mDevice->getPhysicalDevice()->getQueueFamily(mType);
+  uint32_t dstFamily = mDevice->getPhysicalDevice()->getQueueFamily(dstType);
+
+  if (srcFamily == dstFamily || image->mImageInfo.sharingMode != vk::SharingMode::eExclusive) {
+    return;
+  }
+
+  flushBarriers();
+
+  // the release has to wait for all tracked accesses; if there are none, the writes of previous
+  // submissions are made available by the semaphore which is signaled afterwards
+  vk::PipelineStageFlags srcStages;
+  vk::AccessFlags        srcAccess;
+
+  for (auto& state : mImageStates[image]) {
+    srcStages |= state.mWriteStages | state.mReadStages;
+    srcAccess |= state.mWriteAccess;
+
+    state.mWriteStages = vk::PipelineStageFlags();
+    state.mWriteAccess = vk::AccessFlags();
+    state.mReadStages  = vk::PipelineStageFlags();
+  }
+
+  vk::ImageMemoryBarrier barrier;
+  barrier.oldLayout           = image->mCurrentLayout;
+  barrier.newLayout           = image->mCurrentLayout;
+  barrier.srcQueueFamilyIndex = srcFamily;
+  barrier.dstQueueFamilyIndex = dstFamily;
+  barrier.image               = *image->mImage;
+  barrier.subresourceRange    = image->mViewInfo.subresourceRange;
+  barrier.srcAccessMask       = srcAccess;
+
+  mVkCmd->pipelineBarrier(srcStages ? srcStages : vk::PipelineStageFlagBits::eTopOfPipe,
+      vk::PipelineStageFlagBits::eBottomOfPipe, vk::DependencyFlags(), nullptr, nullptr, barrier);
+  ++mStatistics.mBarriers;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void CommandBuffer::acquireImage(BackedImagePtr const& image, QueueType srcType,
+    vk::PipelineStageFlags stages, vk::AccessFlags access) {
+
+  uint32_t srcFamily = mDevice->getPhysicalDevice()->getQueueFamily(srcType);
+  uint32_t dstFamily = mDevice->getPhysicalDevice()->getQueueFamily(mType);
+
+  if (srcFamily == dstFamily || image->mImageInfo.sharingMode != vk::SharingMode::eExclusive) {
+    transitionImage(image, image->mCurrentLayout, stages, access);
+    return;
+  }
+
+  flushBarriers();
+
+  vk::ImageMemoryBarrier barrier;
+  barrier.oldLayout           = image->mCurrentLayout;
+  barrier.newLayout           = image->mCurrentLayout;
+  barrier.srcQueueFamilyIndex = srcFamily;
+  barrier.dstQueueFamilyIndex = dstFamily;
+  barrier.image               = *image->mImage;
+  barrier.subresourceRange    = image->mViewInfo.subresourceRange;
+  barrier.dstAccessMask       = access;
+
+  mVkCmd->pipelineBarrier(vk::PipelineStageFlagBits::eTopOfPipe, stages, vk::DependencyFlags(),
+      nullptr, nullptr, barrier);
+  ++mStatistics.mBarriers;
+
+  // the acquire counts as a write in the given stages, so that other stages wait for it
+  AccessState state;
+  state.mLayout      = image->mCurrentLayout;
+  state.mWriteStages = stages;
+  state.mReadStages  = stages;
+
+  auto& states = mImageStates[image];
+  states.assign(image->mImageInfo.mipLevels * image->mImageInfo.arrayLayers, state);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void CommandBuffer::releaseBuffer(BackedBufferPtr const& buffer, QueueType dstType) {
+  uint32_t srcFamily = mDevice->getPhysicalDevice()->getQueueFamily(mType);
+  uint32_t dstFamily = mDevice->getPhysicalDevice()->getQueueFamily(dstType);
+
+  if (srcFamily == dstFamily || buffer->mBufferInfo.sharingMode != vk::SharingMode::eExclusive) {
+    return;
+  }
+
+  flushBarriers();
+
+  auto& state     = mBufferStates[buffer];
+  auto  srcStages = state.mWriteStages | state.mReadStages;
+
+  vk::BufferMemoryBarrier barrier;
+  barrier.srcQueueFamilyIndex = srcFamily;
+  barrier.dstQueueFamilyIndex = dstFamily;
+  barrier.buffer              = *buffer->mBuffer;
+  barrier.offset              = 0;
+  barrier.size                = VK_WHOLE_SIZE;
+  barrier.srcAccessMask       = state.mWriteAccess;
+
+  mVkCmd->pipelineBarrier(srcStages ? srcStages : vk::PipelineStageFlagBits::eTopOfPipe,
+      vk::PipelineStageFlagBits::eBottomOfPipe, vk::DependencyFlags(), nullptr, barrier, nullptr);
+  ++mStatistics.mBarriers;
+
+  state = AccessState();
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void CommandBuffer::acquireBuffer(BackedBufferPtr const& buffer, QueueType srcType,
+    vk::PipelineStageFlags stages, vk::AccessFlags access) {
+
+  uint32_t srcFamily = mDevice->getPhysicalDevice()->getQueueFamily(srcType);
+  uint32_t dstFamily = mDevice->getPhysicalDevice()->getQueueFamily(mType);
+
+  if (srcFamily == dstFamily || buffer->mBufferInfo.sharingMode != vk::SharingMode::eExclusive) {
+    accessBuffer(buffer, stages, access);
+    return;
+  }
+
+  flushBarriers();
+
+  vk::BufferMemoryBarrier barrier;
+  barrier.srcQueueFamilyIndex = srcFamily;
+  barrier.dstQueueFamilyIndex = dstFamily;
+  barrier.buffer              = *buffer->mBuffer;
+  barrier.offset              = 0;
+  barrier.size                = VK_WHOLE_SIZE;
+  barrier.dstAccessMask       = access;
+
+  mVkCmd->pipelineBarrier(vk::PipelineStageFlagBits::eTopOfPipe, stages, vk::DependencyFlags(),
+      nullptr, barrier, nullptr);
+  ++mStatistics.mBarriers;
+
+  // the acquire counts as a write in the given stages, so that other stages wait for it
+  auto& state        = mBufferStates[buffer];
+  state              = AccessState();
+  state.mWriteStages = stages;
+  state.mReadStages  = stages;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void CommandBuffer::transitionImageLayout(vk::Image image, vk::ImageLayout oldLayout,
+    vk::ImageLayout newLayout, vk::PipelineStageFlagBits srcStage,
+    vk::PipelineStageFlagBits dstStage, vk::ImageSubresourceRange range) {
+
+  flushBarriers();
+
+  // clang-format off
+  static const std::unordered_map<vk::ImageLayout, vk::AccessFlags> accessMapping = {
+    {vk::ImageLayout::eUndefined,                     vk::AccessFlags()},
+    {vk::ImageLayout::eGeneral,                       vk::AccessFlagBits::eShaderRead | vk::AccessFlagBits::eShaderWrite},
+    {vk::ImageLayout::eColorAttachmentOptimal,        vk::AccessFlagBits::eColorAttachmentRead | vk::AccessFlagBits::eColorAttachmentWrite},
+    {vk::ImageLayout::eDepthStencilReadOnlyOptimal,   vk::AccessFlagBits::eDepthStencilAttachmentRead},
+    {vk::ImageLayout::eDepthStencilAttachmentOptimal, vk::AccessFlagBits::eDepthStencilAttachmentRead | vk::AccessFlagBits::eDepthStencilAttachmentWrite},
+    {vk::ImageLayout::eShaderReadOnlyOptimal,         vk::AccessFlagBits::eShaderRead},
+    {vk::ImageLayout::eTransferDstOptimal,            vk::AccessFlagBits::eTransferWrite},
+    {vk::ImageLayout::eTransferSrcOptimal,            vk::AccessFlagBits::eTransferRead},
+    {vk::ImageLayout::ePresentSrcKHR,                 vk::AccessFlagBits::eMemoryRead}
+  };
+  // clang-format on
+
+  auto srcAccess = accessMapping.find(oldLayout);
+  auto dstAccess = accessMapping.find(newLayout);
+
+  if (srcAccess == accessMapping.end() || dstAccess == accessMapping.end()) {
+    throw std::runtime_error("Failed to transition image layout: Unsupported transition!");
+  }
+
+  vk::ImageMemoryBarrier barrier;
+  barrier.oldLayout           = oldLayout;
+  barrier.newLayout           = newLayout;
+  barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  barrier.image               = image;
+  barrier.subresourceRange    = range;
+  barrier.srcAccessMask       = srcAccess->second;
+  barrier.dstAccessMask       = dstAccess->second;
+
+  mVkCmd->pipelineBarrier(srcStage, dstStage, vk::DependencyFlagBits(), nullptr, nullptr, barrier);
+  ++mStatistics.mBarriers;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void CommandBuffer::copyImage(vk::Image src, vk::Image dst, glm::uvec2 const& size) const {
+
+  vk::ImageSubresourceLayers subResource;
+  subResource.aspectMask     = vk::ImageAspectFlagBits::eColor;
+  subResource.baseArrayLayer = 0;
+  subResource.mipLevel       = 0;
+  subResource.layerCount     = 1;
+
+  vk::ImageCopy region;
+  region.srcSubresource = subResource;
+  region.dstSubresource = subResource;
+  region.srcOffset      = vk::Offset3D(0, 0, 0);
+  region.dstOffset      = vk::Offset3D(0, 0, 0);
+  region.extent.width   = size.x;
+  region.extent.height  = size.y;
+  region.extent.depth   = 1;
+
+  mVkCmd->copyImage(
+      src, vk::ImageLayout::eTransferSrcOptimal, dst, vk::ImageLayout::eTransferDstOptimal, region);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void CommandBuffer::blitImage(vk::Image src, vk::Image dst, glm::uvec2 const& srcSize,
+    glm::uvec2 const& dstSize, vk::Filter filter) const {
+
+  blitImage(src, 0, dst, 0, srcSize, dstSize, 1, filter);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void CommandBuffer::blitImage(vk::Image src, uint32_t srcMipmapLevel, vk::Image dst,
+    uint32_t dstMipmapLevel, glm::uvec2 const& srcSize, glm::uvec2 const& dstSize,
+    uint32_t layerCount, vk::Filter filter) const {
+
+  vk::ImageBlit info;
+  info.srcSubresource.aspectMask = vk::ImageAspectFlagBits::eColor;
+  info.srcSubresource.layerCount = layerCount;
+  info.srcSubresource.mipLevel   = srcMipmapLevel;
+  info.srcOffsets[0]             = vk::Offset3D(0, 0, 0);
+  info.srcOffsets[1]             = vk::Offset3D(srcSize.x, srcSize.y, 1);
+  info.dstSubresource.aspectMask = vk::ImageAspectFlagBits::eColor;
+  info.dstSubresource.layerCount = layerCount;
+  info.dstSubresource.mipLevel   = dstMipmapLevel;
+  info.dstOffsets[0]             = vk::Offset3D(0, 0, 0);
+  info.dstOffsets[1]             = vk::Offset3D(dstSize.x, dstSize.y, 1);
+
+  mVkCmd->blitImage(src, vk::ImageLayout::eTransferSrcOptimal, dst,
+      vk::ImageLayout::eTransferDstOptimal, info, filter);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void CommandBuffer::resolveImage(vk::Image src, vk::ImageLayout srcLayout, vk::Image dst,
+    vk::ImageLayout dstLayout, vk::ImageResolve region) const {
+  mVkCmd->resolveImage(src, srcLayout, dst, dstLayout, region);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void CommandBuffer::copyBuffer(vk::Buffer src, vk::Buffer dst, vk::DeviceSize size) const {
+  vk::BufferCopy region;
+  region.size = size;
+
+  mVkCmd->copyBuffer(src, dst, 1, &region);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void CommandBuffer::copyBufferToImage(vk::Buffer src, vk::Image dst, vk::ImageLayout dstLayout,
+    std::vector<vk::BufferImageCopy> const& infos) const {
+
+  mVkCmd->copyBufferToImage(src, dst, dstLayout, infos);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void CommandBuffer::copyImageToBuffer(vk::Image src, vk::ImageLayout srcLayout, vk::Buffer dst,
+    std::vector<vk::BufferImageCopy> const& infos) const {
+
+  mVkCmd->copyImageToBuffer(src, srcLayout, dst, infos);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+CommandBuffer::SkippedCommands const& CommandBuffer::getSkippedCommands() const {
+  return mSkippedCommands;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+FrameStatistics::Counters const& CommandBuffer::getStatistics() const {
+  return mStatistics;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void CommandBuffer::resetQueryPool(
+    vk::QueryPoolPtr const& pool, uint32_t firstQuery, uint32_t queryCount) const {
+  mVkCmd->resetQueryPool(*pool, firstQuery, queryCount);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void CommandBuffer::writeTimestamp(
+    vk::PipelineStageFlagBits stage, vk::QueryPoolPtr const& pool, uint32_t query) const {
+  mVkCmd->writeTimestamp(stage, *pool, query);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void CommandBuffer::beginQuery(
+    vk::QueryPoolPtr const& pool, uint32_t query, vk::QueryControlFlags flags) const {
+  mVkCmd->beginQuery(*pool, query, flags);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void CommandBuffer::endQuery(vk::QueryPoolPtr const& pool, uint32_t query) const {
+  mVkCmd->endQuery(*pool, query);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void CommandBuffer::setPassStatistics(PassStatisticsPtr const& statistics) {
+  mPassStatistics = statistics;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+PassStatisticsPtr const& CommandBuffer::getPassStatistics() const {
+  return mPassStatistics;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void CommandBuffer::copyImage(
+    BackedImagePtr const& src, BackedImagePtr const& dst, glm::uvec2 const& size) {
+
+  transitionImage(src, vk::ImageLayout::eTransferSrcOptimal, vk::PipelineStageFlagBits::eTransfer,
+      vk::AccessFlagBits::eTransferRead, {vk::ImageAspectFlagBits::eColor, 0, 1, 0, 1});
+  transitionImage(dst, vk::ImageLayout::eTransferDstOptimal, vk::PipelineStageFlagBits::eTransfer,
+      vk::AccessFlagBits::eTransferWrite, {vk::ImageAspectFlagBits::eColor, 0, 1, 0, 1});
+  flushBarriers();
+
+  copyImage(*src->mImage, *dst->mImage, size);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void CommandBuffer::blitImage(BackedImagePtr const& src, uint32_t srcMipmapLevel,
+    BackedImagePtr const& dst, uint32_t dstMipmapLevel, glm::uvec2 const& srcSize,
+    glm::uvec2 const& dstSize, vk::Filter filter) {
+
+  uint32_t layerCount = src->mImageInfo.arrayLayers;
+
+  transitionImage(src, vk::ImageLayout::eTransferSrcOptimal, vk::PipelineStageFlagBits::eTransfer,
+      vk::AccessFlagBits::eTransferRead,
+      {vk::ImageAspectFlagBits::eColor, srcMipmapLevel, 1, 0, layerCount});
+  transitionImage(dst, vk::ImageLayout::eTransferDstOptimal, vk::PipelineStageFlagBits::eTransfer,
+      vk::AccessFlagBits::eTransferWrite,
+      {vk::ImageAspectFlagBits::eColor, dstMipmapLevel, 1, 0, layerCount});
+  flushBarriers();
+
+  blitImage(*src->mImage, srcMipmapLevel, *dst->mImage, dstMipmapLevel, srcSize, dstSize,
+      layerCount, filter);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void CommandBuffer::copyBuffer(
+    BackedBufferPtr const& src, BackedBufferPtr const& dst, vk::DeviceSize size) {
+
+  accessBuffer(src, vk::PipelineStageFlagBits::eTransfer, vk::AccessFlagBits::eTransferRead);
+  accessBuffer(dst, vk::PipelineStageFlagBits::eTransfer, vk::AccessFlagBits::eTransferWrite);
+  flushBarriers();
+
+  copyBuffer(*src->mBuffer, *dst->mBuffer, size);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void CommandBuffer::copyBuffer(BackedBufferPtr const& src, BackedBufferPtr const& dst,
+    std::vector<vk::BufferCopy> const& regions) {
+
+  accessBuffer(src, vk::PipelineStageFlagBits::eTransfer, vk::AccessFlagBits::eTransferRead);
+  accessBuffer(dst, vk::PipelineStageFlagBits::eTransfer, vk::AccessFlagBits::eTransferWrite);
+  flushBarriers();
+
+  mVkCmd->copyBuffer(*src->mBuffer, *dst->mBuffer, regions);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void CommandBuffer::copyBufferToImage(BackedBufferPtr const& src, BackedImagePtr const& dst,
+    std::vector<vk::BufferImageCopy> const& infos) {
+
+  accessBuffer(src, vk::PipelineStageFlagBits::eTransfer, vk::AccessFlagBits::eTransferRead);
+
+  for (auto const& info : infos) {
+    transitionImage(dst, vk::ImageLayout::eTransferDstOptimal,
+        vk::PipelineStageFlagBits::eTransfer, vk::AccessFlagBits::eTransferWrite,
+        {info.imageSubresource.aspectMask, info.imageSubresource.mipLevel, 1,
+            info.imageSubresource.baseArrayLayer, info.imageSubresource.layerCount});
+  }
+
+  flushBarriers();
+
+  copyBufferToImage(*src->mBuffer, *dst->mImage, vk::ImageLayout::eTransferDstOptimal, infos);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void CommandBuffer::copyImageToBuffer(BackedImagePtr const& src, BackedBufferPtr const& dst,
+    std::vector<vk::BufferImageCopy> const& infos) {
+
+  for (auto const& info : infos) {
+    transitionImage(src, vk::ImageLayout::eTransferSrcOptimal,
+        vk::PipelineStageFlagBits::eTransfer, vk::AccessFlagBits::eTransferRead,
+        {info.imageSubresource.aspectMask, info.imageSubresource.mipLevel, 1,
+            info.imageSubresource.baseArrayLayer, info.imageSubresource.layerCount});
+  }
+
+  accessBuffer(dst, vk::PipelineStageFlagBits::eTransfer, vk::AccessFlagBits::eTransferWrite);
+
+  flushBarriers();
+
+  copyImageToBuffer(*src->mImage, vk::ImageLayout::eTransferSrcOptimal, *dst->mBuffer, infos);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void CommandBuffer::buildAccelerationStructure(AccelerationStructurePtr const& dst,
+    vk::AccelerationStructureBuildGeometryInfoKHR                  info,
+    std::vector<vk::AccelerationStructureBuildRangeInfoKHR> const& ranges,
+    std::vector<BackedBufferPtr> const& inputs, BackedBufferPtr const& scratch,
+    AccelerationStructurePtr const& src) {
+
+  auto const& functions = mDevice->getAccelerationStructureFunctions();
+
+  if (!functions.mCmdBuild) {
+    throw std::runtime_error(
+        "Failed to build acceleration structure: VK_KHR_ray_query is not supported!");
+  }
+
+  auto stage = vk::PipelineStageFlagBits::eAccelerationStructureBuildKHR;
+
+  // bottom-level structures referenced by instances are read by the build itself
+  for (auto const& input : inputs) {
+    if (input->mBufferInfo.usage & vk::BufferUsageFlagBits::eAccelerationStructureStorageKHR) {
+      accessBuffer(input, stage, vk::AccessFlagBits::eAccelerationStructureReadKHR);
+    } else {
+      accessBuffer(input, stage, vk::AccessFlagBits::eShaderRead);
+    }
+  }
+
+  accessBuffer(scratch, stage,
+      vk::AccessFlagBits::eAccelerationStructureReadKHR |
+          vk::AccessFlagBits::eAccelerationStructureWriteKHR);
+
+  if (src && src != dst) {
+    accessBuffer(src->mBuffer, stage, vk::AccessFlagBits::eAccelerationStructureReadKHR);
+    accessBuffer(dst->mBuffer, stage, vk::AccessFlagBits::eAccelerationStructureWriteKHR);
+  } else if (src) {
+    accessBuffer(dst->mBuffer, stage,
+        vk::AccessFlagBits::eAccelerationStructureReadKHR |
+            vk::AccessFlagBits::eAccelerationStructureWriteKHR);
+  } else {
+    accessBuffer(dst->mBuffer, stage, vk::AccessFlagBits::eAccelerationStructureWriteKHR);
+  }
+
+  flushBarriers();
+
+  // the scratch memory has to be aligned more strictly than buffers usually are
+  vk::DeviceAddress alignment = mDevice->getPhysicalDevice()
+                                    ->getAccelerationStructureProperties()
+                                    .minAccelerationStructureScratchOffsetAlignment;
+  vk::DeviceAddress address = mDevice->getBufferDeviceAddress(scratch);
+
+  info.dstAccelerationStructure  = *dst->mAccelerationStructure;
+  info.srcAccelerationStructure  = src ? *src->mAccelerationStructure : nullptr;
+  info.scratchData.deviceAddress = (address + alignment - 1) / alignment * alignment;
+
+  auto const* rangeInfos =
+      reinterpret_cast<VkAccelerationStructureBuildRangeInfoKHR const*>(ranges.data());
+
+  functions.mCmdBuild(*mVkCmd, 1,
+      reinterpret_cast<VkAccelerationStructureBuildGeometryInfoKHR const*>(&info), &rangeInfos);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void CommandBuffer::copyAccelerationStructure(AccelerationStructurePtr const& src,
+    AccelerationStructurePtr const& dst, vk::CopyAccelerationStructureModeKHR mode) {
+
+  auto const& functions = mDevice->getAccelerationStructureFunctions();
+
+  if (!functions.mCmdCopy) {
+    throw std::runtime_error(
+        "Failed to copy acceleration structure: VK_KHR_ray_query is not supported!");
+  }
+
+  auto stage = vk::PipelineStageFlagBits::eAccelerationStructureBuildKHR;
+  accessBuffer(src->mBuffer, stage, vk::AccessFlagBits::eAccelerationStructureReadKHR);
+  accessBuffer(dst->mBuffer, stage, vk::AccessFlagBits::eAccelerationStructureWriteKHR);
+  flushBarriers();
+
+  vk::CopyAccelerationStructureInfoKHR info;
+  info.src  = *src->mAccelerationStructure;
+  info.dst  = *dst->mAccelerationStructure;
+  info.mode = mode;
+
+  functions.mCmdCopy(
+      *mVkCmd, reinterpret_cast<VkCopyAccelerationStructureInfoKHR const*>(&info));
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void CommandBuffer::writeCompactedSize(AccelerationStructurePtr const& accelerationStructure,
+    vk::QueryPoolPtr const& pool, uint32_t query) {
+
+  auto const& functions = mDevice->getAccelerationStructureFunctions();
+
+  if (!functions.mCmdWriteProperties) {
+    throw std::runtime_error(
+        "Failed to query acceleration structure size: VK_KHR_ray_query is not supported!");
+  }
+
+  accessBuffer(accelerationStructure->mBuffer,
+      vk::PipelineStageFlagBits::eAccelerationStructureBuildKHR,
+      vk::AccessFlagBits::eAccelerationStructureReadKHR);
+  flushBarriers();
+
+  VkAccelerationStructureKHR handle = *accelerationStructure->mAccelerationStructure;
+
+  functions.mCmdWriteProperties(*mVkCmd, 1, &handle,
+      VK_QUERY_TYPE_ACCELERATION_STRUCTURE_COMPACTED_SIZE_KHR, *pool, query);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+bool CommandBuffer::flush(vk::PipelineBindPoint bindPoint) {
+  ILLUSION_ZONE("CommandBuffer::flush");
+
+  // create (or retrieve from cache) and bind a pipeline -------------------------------------------
+  vk::PipelinePtr pipeline;
+
+  // a bound PipelineState is used as it is, only its compatibility is checked
+  if (mCurrentPipelineState) {
+    if (mCurrentPipelineState->getBindPoint() != bindPoint) {
+      throw std::runtime_error(
+          "Failed to flush CommandBuffer: The bound PipelineState has another bind point!");
+    }
+
+    if (bindPoint == vk::PipelineBindPoint::eGraphics &&
+        (mCurrentPipelineState->getRenderPass() != mCurrentRenderPass ||
+            mCurrentPipelineState->getSubPass() != mCurrentSubPass)) {
+      throw std::runtime_error("Failed to flush CommandBuffer: The bound PipelineState has been "
+                               "created for another RenderPass or subpass!");
+    }
+
+    pipeline = mCurrentPipelineState->getHandle();
+  } else {
+    pipeline = getPipelineHandle(bindPoint);
+    ++mStatistics.mPipelineLookups;
+  }
+
+  // the pipeline is still being created asynchronously, the draw call will be skipped
+  if (!pipeline) {
+    return false;
+  }
+
+  // declare the accesses of all bound resources and record the required barriers - this is not
+  // possible inside of RenderPasses
+  uint32_t changedSets = 0;
+
+  if (!mCurrentRenderPass) {
+    changedSets = trackBindings();
+    flushBarriers();
+  }
+
+  auto& currentPipeline = mCurrentPipelines[bindPoint];
+
+  if (pipeline == currentPipeline) {
+    ++mSkippedCommands.mPipelineBinds;
+  } else {
+    mVkCmd->bindPipeline(bindPoint, *pipeline);
+    currentPipeline = pipeline;
+    ++mStatistics.mPipelineBinds;
+  }
+
+  // push constants are not preserved when a pipeline with a different layout is used
+  if (mCurrentShader->getReflection()->getLayout() != mPushConstantLayout) {
+    mPushConstantLayout.reset();
+  }
+
+  if (bindPoint == vk::PipelineBindPoint::eGraphics) {
+    recordDynamicState(pipeline);
+  }
+
+  // descriptor sets are bound separately for compute and graphics pipelines
+  if (bindPoint != mCurrentBindPoint) {
+    mCurrentDescriptorSets.clear();
+    mCurrentBindPoint = bindPoint;
+  }
+
+  // now bind and update all descriptor sets -------------------------------------------------------
+
+  // the logic is roughly as follows:
+
+  // for each descriptor set number of the current program
+  //   if this is a bindless set
+  //     bind the BindlessDescriptorSet of the device if it is not bound already
+  //   else if binding state of this set number is dirty (a binding for this set has been changed)
+  //     or no descriptor set is currently bound for this set
+  //     or the layout of the currently bound descriptor set is incompatible to the current program
+  //       if this is the per-draw set of the program and push descriptors are available
+  //         push the descriptors
+  //       else
+  //         find a descriptor set which has been written with the same bindings before
+  //         or acquire new descriptor set and update it
+  //         bind descriptor set
+  //       store hash for compatibility checks
+  //   else if a dynamic offset has been changed
+  //       re-bind current descriptor set
+
+  // get descriptor set layouts of the current program
+  auto const& setReflections = mCurrentShader->getDescriptorSetReflections();
+
+  // a descriptor set stays valid when a new program is bound if the push constant ranges and the
+  // layouts of all sets up to and including this set number are the same, see
+  // PipelineReflection::getCompatibilityHashes()
+  auto const& compatibilityHashes = mCurrentShader->getReflection()->getCompatibilityHashes();
+
+  for (uint32_t setNum = 0; setNum < setReflections.size(); ++setNum) {
 
     // ignore empty descriptor sets
     if (setReflections[setNum]->getResources().size() == 0) {
       continue;
     }
 
+    // bindless sets do not use the BindingState, the BindlessDescriptorSet of the Device is bound
+    // if it is not bound yet or if it has grown in the meantime
+    if (setReflections[setNum]->isBindless()) {
+      auto descriptorSet = mDevice->getBindlessDescriptorSet()->getHandle();
+      auto currentSetIt  = mCurrentDescriptorSets.find(setNum);
+
+      if (currentSetIt == mCurrentDescriptorSets.end() ||
+          currentSetIt->second.mSet != descriptorSet ||
+          currentSetIt->second.mSetLayoutHash != compatibilityHashes[setNum]) {
+
+        mVkCmd->bindDescriptorSets(bindPoint, *mCurrentShader->getReflection()->getLayout(),
+            setNum, *descriptorSet, nullptr);
+        mCurrentDescriptorSets[setNum] = {descriptorSet, compatibilityHashes[setNum]};
+        ++mStatistics.mDescriptorSetBinds;
+      } else {
+        ++mSkippedCommands.mDescriptorSetBinds;
+      }
+
+      continue;
+    }
+
     // there is nothing to bind, most likely the user forgot to bind something - but it may also be
     // on purpose when the current program actually does not need this set
-    if (mBindingState.getBindings(setNum).size() == 0) {
+    uint32_t setBit      = 1u << setNum;
+    uint32_t bindingMask = mBindingState.getBindingMask(setNum);
+
+    if (bindingMask == 0) {
       continue;
     }
 
+    // bindings which are not declared by the current shader (for example because they have been
+    // removed by the ShaderOptimization) are not written
+    uint32_t writeMask = bindingMask & setReflections[setNum]->getBindingMask();
+
     // get hash of the currently bound descriptor set (if any) to check if it is compatible with the
     // descriptor set layout of the currently bound program
     auto currentSetIt = mCurrentDescriptorSets.find(setNum);
 
     // we need to bind a new descriptor set if
     //   binding state of this set number is dirty (a binding for this set has been changed)
+    //   or the layout of one of its images has been changed
     //   or no descriptor set is currently bound for this set
     //   or the layout of the currently bound descriptor set is incompatible to the current program
-    if (mBindingState.getDirtySets().find(setNum) != mBindingState.getDirtySets().end() ||
+    if ((mBindingState.getDirtySets() & setBit) || (changedSets & setBit) ||
         currentSetIt == mCurrentDescriptorSets.end() ||
-        currentSetIt->second.mSetLayoutHash != setReflections[setNum]->getHash()) {
-
-      // acquire an unused descriptor set
-      auto descriptorSet = mDescriptorSetCache.acquireHandle(
-          mCurrentShader->getDescriptorSetReflections().at(setNum));
+        currentSetIt->second.mSetLayoutHash != compatibilityHashes[setNum]) {
 
-      // get all bindings of the current descriptor set
-      auto const& bindings     = mBindingState.getBindings(setNum);
-      size_t      bindingCount = bindings.size();
+      // these are allocated on the stack, there is at most one descriptor per binding
+      std::array<vk::WriteDescriptorSet, BindingState::MAX_BINDINGS>   writeInfos;
+      std::array<vk::DescriptorImageInfo, BindingState::MAX_BINDINGS>  imageInfos;
+      std::array<vk::DescriptorBufferInfo, BindingState::MAX_BINDINGS> bufferInfos;
+      std::array<vk::WriteDescriptorSetAccelerationStructureKHR, BindingState::MAX_BINDINGS>
+          accelerationStructureInfos;
 
       // this will store the offsets of dynamic uniform and storage buffers
-      std::vector<uint32_t> dynamicOffsets;
-
-      // write descriptor set for each binding
-      vk::WriteDescriptorSet defaulWriteInfo;
-      defaulWriteInfo.dstSet          = *descriptorSet;
-      defaulWriteInfo.dstArrayElement = 0;
-      defaulWriteInfo.descriptorCount = 1;
-
-      std::vector<vk::WriteDescriptorSet>   writeInfos(bindingCount, defaulWriteInfo);
-      std::vector<vk::DescriptorImageInfo>  imageInfos(bindingCount);
-      std::vector<vk::DescriptorBufferInfo> bufferInfos(bindingCount);
-
-      uint32_t i = 0;
-
-      for (auto const& binding : bindings) {
-
-        writeInfos[i].dstBinding = binding.first;
-
-        if (std::holds_alternative<CombinedImageSamplerBinding>(binding.second)) {
-
-          auto value                   = std::get<CombinedImageSamplerBinding>(binding.second);
-          imageInfos[i].imageLayout    = value.mTexture->mCurrentLayout;
-          imageInfos[i].imageView      = *value.mTexture->mView;
-          imageInfos[i].sampler        = *value.mTexture->mSampler;
-          writeInfos[i].descriptorType = vk::DescriptorType::eCombinedImageSampler;
-          writeInfos[i].pImageInfo     = &imageInfos[i];
-
-        } else if (std::holds_alternative<StorageImageBinding>(binding.second)) {
+      std::array<uint32_t, BindingState::MAX_BINDINGS> dynamicOffsets;
 
-          auto value                   = std::get<StorageImageBinding>(binding.second);
-          imageInfos[i].imageLayout    = value.mImage->mCurrentLayout;
-          imageInfos[i].imageView      = *(value.mView ? value.mView : value.mImage->mView);
-          imageInfos[i].sampler        = *value.mImage->mSampler;
-          writeInfos[i].descriptorType = vk::DescriptorType::eStorageImage;
-          writeInfos[i].pImageInfo     = &imageInfos[i];
+      uint32_t writeCount         = 0;
+      uint32_t dynamicOffsetCount = 0;
 
-        } else if (std::holds_alternative<UniformBufferBinding>(binding.second)) {
-
-          auto value                   = std::get<UniformBufferBinding>(binding.second);
-          bufferInfos[i].buffer        = *value.mBuffer->mBuffer;
-          bufferInfos[i].offset        = value.mOffset;
-          bufferInfos[i].range         = value.mSize;
-          writeInfos[i].descriptorType = vk::DescriptorType::eUniformBuffer;
-          writeInfos[i].pBufferInfo    = &bufferInfos[i];
+      // write descriptor set for each binding
+      forEachBit(writeMask, [&](uint32_t binding) {
+        auto& writeInfo           = writeInfos[writeCount];
+        writeInfo.dstBinding      = binding;
+        writeInfo.dstArrayElement = 0;
+        writeInfo.descriptorCount = 1;
+
+        bool dynamic = std::visit(
+            DescriptorWriter{writeInfo, imageInfos[writeCount], bufferInfos[writeCount],
+                accelerationStructureInfos[writeCount]},
+            *mBindingState.getBinding(setNum, binding));
+
+        if (dynamic) {
+          dynamicOffsets[dynamicOffsetCount++] = mBindingState.getDynamicOffset(setNum, binding);
+        }
 
-        } else if (std::holds_alternative<DynamicUniformBufferBinding>(binding.second)) {
+        ++writeCount;
+      });
+
+      // per-draw sets of the Shader are pushed directly, no descriptor set is allocated for them
+      if (setReflections[setNum]->isPushDescriptor()) {
+        if (writeCount > 0) {
+          auto pushDescriptorSet = mDevice->getPushDescriptorSetFunction();
+          pushDescriptorSet(*mVkCmd, static_cast<VkPipelineBindPoint>(bindPoint),
+              *mCurrentShader->getReflection()->getLayout(), setNum, writeCount,
+              reinterpret_cast<VkWriteDescriptorSet const*>(writeInfos.data()));
+          ++mStatistics.mDescriptorSetUpdates;
+          mStatistics.mDescriptorWrites += writeCount;
+        }
 
-          auto value                   = std::get<DynamicUniformBufferBinding>(binding.second);
-          bufferInfos[i].buffer        = *value.mBuffer->mBuffer;
-          bufferInfos[i].range         = value.mSize;
-          writeInfos[i].descriptorType = vk::DescriptorType::eUniformBufferDynamic;
-          writeInfos[i].pBufferInfo    = &bufferInfos[i];
+        mCurrentDescriptorSets[setNum] = {nullptr, compatibilityHashes[setNum]};
+        continue;
+      }
 
-          dynamicOffsets.push_back(mBindingState.getDynamicOffset(setNum, binding.first));
+      // descriptor sets are cached based on the actually written handles; dynamic offsets are not
+      // part of the descriptor set, they are passed when binding it
+      Core::BitHash contentHash;
+      for (uint32_t j = 0; j < writeCount; ++j) {
+        contentHash.push<32>(writeInfos[j].dstBinding);
+        contentHash.push<32>(writeInfos[j].descriptorType);
+        if (writeInfos[j].pImageInfo) {
+          contentHash.push<64>(imageInfos[j].imageView);
+          contentHash.push<64>(imageInfos[j].sampler);
+          contentHash.push<32>(imageInfos[j].imageLayout);
+        } else if (writeInfos[j].pNext) {
+          contentHash.push<64>(*accelerationStructureInfos[j].pAccelerationStructures);
+        } else {
+          contentHash.push<64>(bufferInfos[j].buffer);
+          contentHash.push<64>(bufferInfos[j].offset);
+          contentHash.push<64>(bufferInfos[j].range);
+        }
+      }
 
-        } else if (std::holds_alternative<StorageBufferBinding>(binding.second)) {
+      // re-use a descriptor set which has been written with the same content before, else acquire
+      // an unused descriptor set and write it
+      auto descriptorSet = mDescriptorSetCache.findHandle(setReflections[setNum], contentHash);
 
-          auto value                   = std::get<StorageBufferBinding>(binding.second);
-          bufferInfos[i].buffer        = *value.mBuffer->mBuffer;
-          bufferInfos[i].offset        = value.mOffset;
-          bufferInfos[i].range         = value.mSize;
-          writeInfos[i].descriptorType = vk::DescriptorType::eStorageBuffer;
-          writeInfos[i].pBufferInfo    = &bufferInfos[i];
+      if (!descriptorSet) {
 
-        } else if (std::holds_alternative<DynamicStorageBufferBinding>(binding.second)) {
+        // the descriptor set becomes invalid if any of these is destroyed
+        std::vector<std::weak_ptr<void>> dependencies;
+        forEachBit(writeMask, [&](uint32_t binding) {
+          std::visit(DependencyCollector{dependencies}, *mBindingState.getBinding(setNum, binding));
+        });
 
-          auto value                   = std::get<DynamicStorageBufferBinding>(binding.second);
-          bufferInfos[i].buffer        = *value.mBuffer->mBuffer;
-          bufferInfos[i].range         = value.mSize;
-          writeInfos[i].descriptorType = vk::DescriptorType::eStorageBufferDynamic;
-          writeInfos[i].pBufferInfo    = &bufferInfos[i];
+        descriptorSet =
+            mDescriptorSetCache.acquireHandle(setReflections[setNum], contentHash, dependencies);
 
-          dynamicOffsets.push_back(mBindingState.getDynamicOffset(setNum, binding.first));
+        for (uint32_t j = 0; j < writeCount; ++j) {
+          writeInfos[j].dstSet = *descriptorSet;
         }
 
-        ++i;
-      }
-
-      if (bindingCount > 0) {
-        mDevice->getHandle()->updateDescriptorSets(writeInfos, nullptr);
+        if (writeCount > 0) {
+          ILLUSION_ZONE("Write Descriptor Sets");
+          mDevice->getHandle()->updateDescriptorSets(
+              vk::ArrayProxy<const vk::WriteDescriptorSet>(writeCount, writeInfos.data()), nullptr);
+          ++mStatistics.mDescriptorSetUpdates;
+          mStatistics.mDescriptorWrites += writeCount;
+        }
       }
 
       // now the descriptor set is up-to-date and we can bind it
       mVkCmd->bindDescriptorSets(bindPoint, *mCurrentShader->getReflection()->getLayout(), setNum,
-          *descriptorSet, dynamicOffsets);
+          *descriptorSet,
+          vk::ArrayProxy<const uint32_t>(dynamicOffsetCount, dynamicOffsets.data()));
+      ++mStatistics.mDescriptorSetBinds;
 
-      // store the hash of the descriptor set layout so that we can check for
+      // store the compatibility hash of the pipeline layout so that we can check for
       // compatibility if a new program is bound
-      mCurrentDescriptorSets[setNum] = {descriptorSet, setReflections[setNum]->getHash()};
+      mCurrentDescriptorSets[setNum] = {descriptorSet, compatibilityHashes[setNum]};
 
     }
     // there is a matching descriptor set currently bound,
     // however the dynamic offsets have been changed
-    else if (mBindingState.getDirtyDynamicOffsets().find(setNum) !=
-             mBindingState.getDirtyDynamicOffsets().end()) {
+    else if (!setReflections[setNum]->isPushDescriptor() &&
+             (mBindingState.getDirtyDynamicOffsets() & setBit)) {
 
-      std::vector<uint32_t> dynamicOffsets;
+      std::array<uint32_t, BindingState::MAX_BINDINGS> dynamicOffsets;
+      uint32_t                                          dynamicOffsetCount = 0;
 
-      for (auto const& binding : mBindingState.getBindings(setNum)) {
-        if (std::holds_alternative<DynamicUniformBufferBinding>(binding.second)) {
-          dynamicOffsets.push_back(mBindingState.getDynamicOffset(setNum, binding.first));
+      forEachBit(writeMask, [&](uint32_t binding) {
+        if (isDynamic(*mBindingState.getBinding(setNum, binding))) {
+          dynamicOffsets[dynamicOffsetCount++] = mBindingState.getDynamicOffset(setNum, binding);
         }
-      }
+      });
 
       mVkCmd->bindDescriptorSets(bindPoint, *mCurrentShader->getReflection()->getLayout(), setNum,
-          *currentSetIt->second.mSet, dynamicOffsets);
+          *currentSetIt->second.mSet,
+          vk::ArrayProxy<const uint32_t>(dynamicOffsetCount, dynamicOffsets.data()));
+      ++mStatistics.mDescriptorSetBinds;
+    }
+    // the currently bound descriptor set is still up-to-date
+    else {
+      ++mSkippedCommands.mDescriptorSetBinds;
     }
   }
 
   mBindingState.clearDirtySets();
   mBindingState.clearDirtyDynamicOffsets();
+
+  return true;
 }
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////
 
-vk::PipelinePtr CommandBuffer::getPipelineHandle() {
+uint32_t CommandBuffer::trackBindings() {
+  uint32_t changedSets = 0;
+
+  // outside of RenderPasses, only dispatches are possible
+  vk::PipelineStageFlags stages = vk::PipelineStageFlagBits::eComputeShader;
 
-  if (mType == QueueType::eCompute) {
+  auto const& setReflections = mCurrentShader->getDescriptorSetReflections();
 
-    if (!mCurrentShader) {
-      throw std::runtime_error("Failed to create compute pipeline: No Shader given!");
+  for (uint32_t setNum = 0; setNum < setReflections.size(); ++setNum) {
+    if (setReflections[setNum]->getResources().size() == 0 ||
+        setReflections[setNum]->isBindless()) {
+      continue;
     }
 
-    Core::BitHash hash;
-    hash.push<64>(mCurrentShader.get());
+    // bindings which are not declared by the current shader are not accessed
+    uint32_t mask = mBindingState.getBindingMask(setNum) & setReflections[setNum]->getBindingMask();
+
+    forEachBit(mask, [&](uint32_t bindingNum) {
+      auto const& binding = *mBindingState.getBinding(setNum, bindingNum);
+
+      if (std::holds_alternative<CombinedImageSamplerBinding>(binding)) {
+
+        // textures in eGeneral can be sampled as well, they are not transitioned
+        auto const& texture   = std::get<CombinedImageSamplerBinding>(binding).mTexture;
+        auto        oldLayout = texture->mCurrentLayout;
+        auto        layout    = oldLayout == vk::ImageLayout::eGeneral
+                            ? vk::ImageLayout::eGeneral
+                            : vk::ImageLayout::eShaderReadOnlyOptimal;
+
+        transitionImage(texture, layout, stages, vk::AccessFlagBits::eShaderRead);
+
+        if (texture->mCurrentLayout != oldLayout) {
+          changedSets |= 1u << setNum;
+        }
+
+      } else if (std::holds_alternative<StorageImageBinding>(binding)) {
+
+        auto const& image     = std::get<StorageImageBinding>(binding).mImage;
+        auto        oldLayout = image->mCurrentLayout;
+
+        transitionImage(image, vk::ImageLayout::eGeneral, stages,
+            vk::AccessFlagBits::eShaderRead | vk::AccessFlagBits::eShaderWrite);
+
+        if (image->mCurrentLayout != oldLayout) {
+          changedSets |= 1u << setNum;
+        }
+
+      } else if (std::holds_alternative<UniformBufferBinding>(binding)) {
+        accessBuffer(std::get<UniformBufferBinding>(binding).mBuffer, stages,
+            vk::AccessFlagBits::eUniformRead);
+
+      } else if (std::holds_alternative<DynamicUniformBufferBinding>(binding)) {
+        accessBuffer(std::get<DynamicUniformBufferBinding>(binding).mBuffer, stages,
+            vk::AccessFlagBits::eUniformRead);
+
+      } else if (std::holds_alternative<StorageBufferBinding>(binding)) {
+        accessBuffer(std::get<StorageBufferBinding>(binding).mBuffer, stages,
+            vk::AccessFlagBits::eShaderRead | vk::AccessFlagBits::eShaderWrite);
 
-    auto cached = mPipelineCache.find(hash);
-    if (cached != mPipelineCache.end()) {
-      return cached->second;
+      } else if (std::holds_alternative<DynamicStorageBufferBinding>(binding)) {
+        accessBuffer(std::get<DynamicStorageBufferBinding>(binding).mBuffer, stages,
+            vk::AccessFlagBits::eShaderRead | vk::AccessFlagBits::eShaderWrite);
+
+      } else if (std::holds_alternative<AccelerationStructureBinding>(binding)) {
+        auto const& accelerationStructure =
+            std::get<AccelerationStructureBinding>(binding).mAccelerationStructure;
+        accessBuffer(accelerationStructure->mBuffer, stages,
+            vk::AccessFlagBits::eAccelerationStructureReadKHR);
+      }
+    });
+  }
+
+  return changedSets;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void CommandBuffer::invalidateBoundState() {
+  mCurrentPipelines.clear();
+  mCurrentDescriptorSets.clear();
+  mCurrentVertexBuffers.clear();
+  mCurrentIndexBuffer = nullptr;
+  mPushConstantLayout.reset();
+  mDynamicStatePipeline.reset();
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void CommandBuffer::recordVertexBuffers(uint32_t firstBinding,
+    std::vector<vk::Buffer> const& buffers, std::vector<vk::DeviceSize> const& offsets) {
+
+  uint32_t count = static_cast<uint32_t>(buffers.size());
+
+  if (mCurrentVertexBuffers.size() < firstBinding + count) {
+    mCurrentVertexBuffers.resize(firstBinding + count);
+  }
+
+  // find the first and the last binding which actually change
+  uint32_t first = count;
+  uint32_t last  = 0;
+
+  for (uint32_t i = 0; i < count; ++i) {
+    auto& current = mCurrentVertexBuffers[firstBinding + i];
+    if (current.first != buffers[i] || current.second != offsets[i]) {
+      current = {buffers[i], offsets[i]};
+      first   = std::min(first, i);
+      last    = i;
     }
+  }
 
-    vk::ComputePipelineCreateInfo info;
+  if (first == count) {
+    ++mSkippedCommands.mVertexBufferBinds;
+    return;
+  }
+
+  mVkCmd->bindVertexBuffers(firstBinding + first,
+      vk::ArrayProxy<const vk::Buffer>(last - first + 1, buffers.data() + first),
+      vk::ArrayProxy<const vk::DeviceSize>(last - first + 1, offsets.data() + first));
+}
 
-    if (mCurrentShader->getModules().size() != 1) {
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void CommandBuffer::recordDynamicState(vk::PipelinePtr const& pipeline) {
+  auto const& state = mGraphicsState;
+
+  if (state.getDynamicState().empty() ||
+      (pipeline == mDynamicStatePipeline && state.getDynamicStateHash() == mDynamicStateHash)) {
+    return;
+  }
+
+  mDynamicStatePipeline = pipeline;
+  mDynamicStateHash     = state.getDynamicStateHash();
+
+  auto const& extended = mDevice->getExtendedDynamicStateFunctions();
+
+  auto requireExtension = [](auto function) {
+    if (!function) {
       throw std::runtime_error(
-          "Failed to create compute pipeline: There must be exactly one ShaderModule!");
+          "Failed to record dynamic state: VK_EXT_extended_dynamic_state is not supported!");
     }
+    return function;
+  };
 
-    info.stage.stage               = mCurrentShader->getModules()[0]->getStage();
-    info.stage.module              = *mCurrentShader->getModules()[0]->getHandle();
-    info.stage.pName               = "main";
-    info.stage.pSpecializationInfo = nullptr;
-    info.layout                    = *mCurrentShader->getReflection()->getLayout();
+  for (auto dynamicState : state.getDynamicState()) {
+    switch (dynamicState) {
+    case vk::DynamicState::eViewport: {
+      std::vector<vk::Viewport> viewports;
+      for (auto const& i : state.getViewports()) {
+        viewports.push_back(
+            {i.mOffset[0], i.mOffset[1], i.mExtend[0], i.mExtend[1], i.mMinDepth, i.mMaxDepth});
+      }
+      mVkCmd->setViewport(0, viewports);
+      break;
+    }
+
+    case vk::DynamicState::eScissor: {
+      // use viewports as scissors if no scissors are defined
+      std::vector<vk::Rect2D> scissors;
+      if (state.getScissors().size() > 0) {
+        for (auto const& i : state.getScissors()) {
+          scissors.push_back({{i.mOffset[0], i.mOffset[1]}, {i.mExtend[0], i.mExtend[1]}});
+        }
+      } else {
+        for (auto const& i : state.getViewports()) {
+          scissors.push_back({{(int32_t)i.mOffset[0], (int32_t)i.mOffset[1]},
+              {(uint32_t)i.mExtend[0], (uint32_t)i.mExtend[1]}});
+        }
+      }
+      mVkCmd->setScissor(0, scissors);
+      break;
+    }
+
+    case vk::DynamicState::eLineWidth:
+      mVkCmd->setLineWidth(state.getLineWidth());
+      break;
+
+    case vk::DynamicState::eDepthBias:
+      mVkCmd->setDepthBias(state.getDepthBiasConstantFactor(), state.getDepthBiasClamp(),
+          state.getDepthBiasSlopeFactor());
+      break;
+
+    case vk::DynamicState::eBlendConstants:
+      mVkCmd->setBlendConstants(state.getBlendConstants().data());
+      break;
+
+    case vk::DynamicState::eDepthBounds:
+      mVkCmd->setDepthBounds(state.getMinDepthBounds(), state.getMaxDepthBounds());
+      break;
+
+    case vk::DynamicState::eStencilCompareMask:
+      mVkCmd->setStencilCompareMask(
+          vk::StencilFaceFlagBits::eFront, state.getStencilFrontCompareMask());
+      mVkCmd->setStencilCompareMask(
+          vk::StencilFaceFlagBits::eBack, state.getStencilBackCompareMask());
+      break;
+
+    case vk::DynamicState::eStencilWriteMask:
+      mVkCmd->setStencilWriteMask(
+          vk::StencilFaceFlagBits::eFront, state.getStencilFrontWriteMask());
+      mVkCmd->setStencilWriteMask(
+          vk::StencilFaceFlagBits::eBack, state.getStencilBackWriteMask());
+      break;
+
+    case vk::DynamicState::eStencilReference:
+      mVkCmd->setStencilReference(
+          vk::StencilFaceFlagBits::eFront, state.getStencilFrontReference());
+      mVkCmd->setStencilReference(
+          vk::StencilFaceFlagBits::eBack, state.getStencilBackReference());
+      break;
+
+    case vk::DynamicState::eCullModeEXT:
+      requireExtension(extended.mSetCullMode)(
+          *mVkCmd, static_cast<VkCullModeFlags>(state.getCullMode()));
+      break;
+
+    case vk::DynamicState::eFrontFaceEXT:
+      requireExtension(extended.mSetFrontFace)(
+          *mVkCmd, static_cast<VkFrontFace>(state.getFrontFace()));
+      break;
+
+    case vk::DynamicState::ePrimitiveTopologyEXT:
+      requireExtension(extended.mSetPrimitiveTopology)(
+          *mVkCmd, static_cast<VkPrimitiveTopology>(state.getTopology()));
+      break;
+
+    case vk::DynamicState::eDepthTestEnableEXT:
+      requireExtension(extended.mSetDepthTestEnable)(*mVkCmd, state.getDepthTestEnable());
+      break;
+
+    case vk::DynamicState::eDepthWriteEnableEXT:
+      requireExtension(extended.mSetDepthWriteEnable)(*mVkCmd, state.getDepthWriteEnable());
+      break;
+
+    case vk::DynamicState::eDepthCompareOpEXT:
+      requireExtension(extended.mSetDepthCompareOp)(
+          *mVkCmd, static_cast<VkCompareOp>(state.getDepthCompareOp()));
+      break;
+
+    default:
+      throw std::runtime_error(
+          "Failed to record dynamic state: " + vk::to_string(dynamicState) + " is not supported!");
+    }
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+bool CommandBuffer::updateState(AccessState& state, vk::ImageLayout layout,
+    vk::PipelineStageFlags stages, vk::AccessFlags access, vk::PipelineStageFlags& srcStages,
+    vk::AccessFlags& srcAccess) {
 
-    auto pipeline = mDevice->createComputePipeline(info);
+  // clang-format off
+  static const vk::AccessFlags writeAccess =
+      vk::AccessFlagBits::eShaderWrite                | vk::AccessFlagBits::eColorAttachmentWrite |
+      vk::AccessFlagBits::eDepthStencilAttachmentWrite | vk::AccessFlagBits::eTransferWrite        |
+      vk::AccessFlagBits::eHostWrite                  | vk::AccessFlagBits::eMemoryWrite;
+  // clang-format on
+
+  vk::AccessFlags writes = access & writeAccess;
+
+  // layout transitions and writes have to wait for all previous reads and writes
+  if (state.mLayout != layout || writes) {
+    srcStages = state.mWriteStages | state.mReadStages;
+    srcAccess = state.mWriteAccess;
 
-    mPipelineCache[hash] = pipeline;
+    bool required = state.mLayout != layout || srcStages;
 
-    return pipeline;
+    // a layout transition counts as write access, subsequent reads of the given stages will see it
+    state.mLayout      = layout;
+    state.mWriteStages = stages;
+    state.mWriteAccess = writes;
+    state.mReadStages  = writes ? vk::PipelineStageFlags() : stages;
+
+    return required;
+  }
+
+  // reads only have to wait for the previous write, if they have not done so before
+  if ((stages & ~state.mReadStages) && state.mWriteStages) {
+    srcStages = state.mWriteStages;
+    srcAccess = state.mWriteAccess;
+    state.mReadStages |= stages;
+    return true;
   }
 
-  // -----------------------------------------------------------------------------------------------
+  state.mReadStages |= stages;
+  return false;
+}
 
-  Core::BitHash hash = mGraphicsState.getHash();
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void CommandBuffer::addImageBarrier(vk::ImageMemoryBarrier const& barrier) {
+  mPendingImageBarriers.push_back(barrier);
+
+  // Barriers are added for each subresource. Adjacent array layers of the same mipmap level and
+  // adjacent mipmap levels with the same array layers are merged into one barrier if they share
+  // the same properties.
+  while (mPendingImageBarriers.size() >= 2) {
+    auto& a = mPendingImageBarriers[mPendingImageBarriers.size() - 2];
+    auto& b = mPendingImageBarriers.back();
+
+    if (a.image != b.image || a.oldLayout != b.oldLayout || a.newLayout != b.newLayout ||
+        a.srcAccessMask != b.srcAccessMask || a.dstAccessMask != b.dstAccessMask ||
+        a.subresourceRange.aspectMask != b.subresourceRange.aspectMask) {
+      return;
+    }
+
+    auto& ra = a.subresourceRange;
+    auto& rb = b.subresourceRange;
+
+    if (ra.baseMipLevel == rb.baseMipLevel && ra.levelCount == rb.levelCount &&
+        ra.baseArrayLayer + ra.layerCount == rb.baseArrayLayer) {
+      ra.layerCount += rb.layerCount;
+    } else if (ra.baseArrayLayer == rb.baseArrayLayer && ra.layerCount == rb.layerCount &&
+               ra.baseMipLevel + ra.levelCount == rb.baseMipLevel) {
+      ra.levelCount += rb.levelCount;
+    } else {
+      return;
+    }
 
-  for (auto const& m : mCurrentShader->getModules()) {
-    hash.push<64>(m->getHandle().get());
+    mPendingImageBarriers.pop_back();
   }
-  hash.push<64>(mCurrentRenderPass.get());
-  hash.push<32>(mCurrentSubPass);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void CommandBuffer::beginRendering(RenderPassPtr const& renderPass, vk::SubpassContents contents) {
+  auto beginRendering = mDevice->getBeginRenderingFunction();
 
-  auto cached = mPipelineCache.find(hash);
-  if (cached != mPipelineCache.end()) {
-    return cached->second;
+  if (!beginRendering) {
+    throw std::runtime_error(
+        "Failed to begin RenderPass: VK_KHR_dynamic_rendering is not supported!");
   }
 
-  // -----------------------------------------------------------------------------------------------
-  std::vector<vk::PipelineShaderStageCreateInfo> stageInfos;
-  if (mCurrentShader) {
-    for (auto const& i : mCurrentShader->getModules()) {
-      vk::PipelineShaderStageCreateInfo stageInfo;
-      stageInfo.stage               = i->getStage();
-      stageInfo.module              = *i->getHandle();
-      stageInfo.pName               = "main";
-      stageInfo.pSpecializationInfo = nullptr;
-      stageInfos.push_back(stageInfo);
+  auto const& attachments = renderPass->getAttachments();
+  auto const& images      = renderPass->getFramebuffer()->getImages();
+  auto const& clearValues = renderPass->getClearValues();
+
+  // Without a vk::RenderPass there are no implicit layout transitions; resolve attachments are
+  // written like color attachments.
+  for (size_t i(0); i < attachments.size(); ++i) {
+    if (Utils::isDepthFormat(attachments[i].mFormat)) {
+      transitionImage(images[i], vk::ImageLayout::eDepthStencilAttachmentOptimal,
+          vk::PipelineStageFlagBits::eEarlyFragmentTests |
+              vk::PipelineStageFlagBits::eLateFragmentTests,
+          vk::AccessFlagBits::eDepthStencilAttachmentRead |
+              vk::AccessFlagBits::eDepthStencilAttachmentWrite);
+    } else {
+      transitionImage(images[i], vk::ImageLayout::eColorAttachmentOptimal,
+          vk::PipelineStageFlagBits::eColorAttachmentOutput,
+          vk::AccessFlagBits::eColorAttachmentRead | vk::AccessFlagBits::eColorAttachmentWrite);
     }
   }
 
-  // -----------------------------------------------------------------------------------------------
-  vk::PipelineVertexInputStateCreateInfo vertexInputStateInfo;
+  auto const& shadingRateImage = renderPass->getShadingRateImage();
 
-  std::vector<vk::VertexInputBindingDescription>   vertexInputBindingDescriptions;
-  std::vector<vk::VertexInputAttributeDescription> vertexInputAttributeDescriptions;
-  for (auto const& i : mGraphicsState.getVertexInputBindings()) {
-    vertexInputBindingDescriptions.push_back({i.binding, i.stride, i.inputRate});
+  if (shadingRateImage) {
+    transitionImage(shadingRateImage, vk::ImageLayout::eFragmentShadingRateAttachmentOptimalKHR,
+        vk::PipelineStageFlagBits::eFragmentShadingRateAttachmentKHR,
+        vk::AccessFlagBits::eFragmentShadingRateAttachmentReadKHR);
   }
-  for (auto const& i : mGraphicsState.getVertexInputAttributes()) {
-    vertexInputAttributeDescriptions.push_back({i.location, i.binding, i.format, i.offset});
+
+  flushBarriers();
+
+  auto getAttachmentInfo = [&](uint32_t i, vk::ImageLayout layout) {
+    vk::RenderingAttachmentInfoKHR info;
+    info.imageView   = *images[i]->mView;
+    info.imageLayout = layout;
+    info.loadOp      = attachments[i].mLoadOp;
+    info.storeOp     = attachments[i].mTransient ? vk::AttachmentStoreOp::eDontCare
+                                                 : attachments[i].mStoreOp;
+    info.clearValue  = clearValues[i];
+
+    if (attachments[i].mResolveAttachment) {
+      info.resolveMode        = vk::ResolveModeFlagBitsKHR::eAverage;
+      info.resolveImageView   = *images[*attachments[i].mResolveAttachment]->mView;
+      info.resolveImageLayout = vk::ImageLayout::eColorAttachmentOptimal;
+    }
+
+    return info;
+  };
+
+  std::vector<vk::RenderingAttachmentInfoKHR> colorInfos;
+  for (uint32_t i : renderPass->getColorAttachments()) {
+    colorInfos.push_back(getAttachmentInfo(i, vk::ImageLayout::eColorAttachmentOptimal));
   }
-  vertexInputStateInfo.vertexBindingDescriptionCount =
-      static_cast<uint32_t>(vertexInputBindingDescriptions.size());
-  vertexInputStateInfo.pVertexBindingDescriptions = vertexInputBindingDescriptions.data();
-  vertexInputStateInfo.vertexAttributeDescriptionCount =
-      static_cast<uint32_t>(vertexInputAttributeDescriptions.size());
-  vertexInputStateInfo.pVertexAttributeDescriptions = vertexInputAttributeDescriptions.data();
 
-  // -----------------------------------------------------------------------------------------------
-  vk::PipelineInputAssemblyStateCreateInfo inputAssemblyStateInfo;
-  inputAssemblyStateInfo.topology               = mGraphicsState.getTopology();
-  inputAssemblyStateInfo.primitiveRestartEnable = mGraphicsState.getPrimitiveRestartEnable();
+  vk::RenderingInfoKHR info;
+  info.renderArea.offset        = vk::Offset2D(0, 0);
+  info.renderArea.extent.width  = renderPass->getExtent().x;
+  info.renderArea.extent.height = renderPass->getExtent().y;
+  info.layerCount               = renderPass->getLayerCount();
+  info.viewMask                 = renderPass->getViewMask();
+  info.colorAttachmentCount     = static_cast<uint32_t>(colorInfos.size());
+  info.pColorAttachments        = colorInfos.data();
+
+  if (contents == vk::SubpassContents::eSecondaryCommandBuffers) {
+    info.flags = vk::RenderingFlagBitsKHR::eContentsSecondaryCommandBuffers;
+  }
 
-  // -----------------------------------------------------------------------------------------------
-  vk::PipelineTessellationStateCreateInfo tessellationStateInfo;
-  tessellationStateInfo.patchControlPoints = mGraphicsState.getTessellationPatchControlPoints();
+  vk::RenderingFragmentShadingRateAttachmentInfoKHR shadingRateInfo;
 
-  // -----------------------------------------------------------------------------------------------
-  vk::PipelineViewportStateCreateInfo viewportStateInfo;
-  std::vector<vk::Viewport>           viewports;
-  std::vector<vk::Rect2D>             scissors;
-  for (auto const& i : mGraphicsState.getViewports()) {
-    viewports.push_back(
-        {i.mOffset[0], i.mOffset[1], i.mExtend[0], i.mExtend[1], i.mMinDepth, i.mMaxDepth});
+  if (shadingRateImage) {
+    auto texelSize  = renderPass->getShadingRateTexelSize();
+    shadingRateInfo = vk::RenderingFragmentShadingRateAttachmentInfoKHR(*shadingRateImage->mView,
+        vk::ImageLayout::eFragmentShadingRateAttachmentOptimalKHR,
+        vk::Extent2D(texelSize.x, texelSize.y));
+    info.pNext = &shadingRateInfo;
   }
 
-  // use viewport as scissors if no scissors are defined
-  if (mGraphicsState.getScissors().size() > 0) {
-    for (auto const& i : mGraphicsState.getScissors()) {
-      scissors.push_back({{i.mOffset[0], i.mOffset[1]}, {i.mExtend[0], i.mExtend[1]}});
-    }
-  } else {
-    for (auto const& i : mGraphicsState.getViewports()) {
-      scissors.push_back({{(int32_t)i.mOffset[0], (int32_t)i.mOffset[1]},
-          {(uint32_t)i.mExtend[0], (uint32_t)i.mExtend[1]}});
+  vk::RenderingAttachmentInfoKHR depthInfo;
+  auto                           depth = renderPass->getDepthAttachment();
+
+  if (depth) {
+    depthInfo = getAttachmentInfo(*depth, vk::ImageLayout::eDepthStencilAttachmentOptimal);
+
+    info.pDepthAttachment = &depthInfo;
+
+    if (Utils::isDepthStencilFormat(attachments[*depth].mFormat)) {
+      info.pStencilAttachment = &depthInfo;
     }
   }
-  viewportStateInfo.viewportCount = static_cast<uint32_t>(viewports.size());
-  viewportStateInfo.pViewports    = viewports.data();
-  viewportStateInfo.scissorCount  = static_cast<uint32_t>(scissors.size());
-  viewportStateInfo.pScissors     = scissors.data();
-
-  // -----------------------------------------------------------------------------------------------
-  vk::PipelineRasterizationStateCreateInfo rasterizationStateInfo;
-  rasterizationStateInfo.depthClampEnable        = mGraphicsState.getDepthClampEnable();
-  rasterizationStateInfo.rasterizerDiscardEnable = mGraphicsState.getRasterizerDiscardEnable();
-  rasterizationStateInfo.polygonMode             = mGraphicsState.getPolygonMode();
-  rasterizationStateInfo.cullMode                = mGraphicsState.getCullMode();
-  rasterizationStateInfo.frontFace               = mGraphicsState.getFrontFace();
-  rasterizationStateInfo.depthBiasEnable         = mGraphicsState.getDepthBiasEnable();
-  rasterizationStateInfo.depthBiasConstantFactor = mGraphicsState.getDepthBiasConstantFactor();
-  rasterizationStateInfo.depthBiasClamp          = mGraphicsState.getDepthBiasClamp();
-  rasterizationStateInfo.depthBiasSlopeFactor    = mGraphicsState.getDepthBiasSlopeFactor();
-  rasterizationStateInfo.lineWidth               = mGraphicsState.getLineWidth();
-
-  // -----------------------------------------------------------------------------------------------
-  vk::PipelineMultisampleStateCreateInfo multisampleStateInfo;
-  multisampleStateInfo.rasterizationSamples  = mGraphicsState.getRasterizationSamples();
-  multisampleStateInfo.sampleShadingEnable   = mGraphicsState.getSampleShadingEnable();
-  multisampleStateInfo.minSampleShading      = mGraphicsState.getMinSampleShading();
-  multisampleStateInfo.pSampleMask           = mGraphicsState.getSampleMask().data();
-  multisampleStateInfo.alphaToCoverageEnable = mGraphicsState.getAlphaToCoverageEnable();
-  multisampleStateInfo.alphaToOneEnable      = mGraphicsState.getAlphaToOneEnable();
-
-  // -----------------------------------------------------------------------------------------------
-  vk::PipelineDepthStencilStateCreateInfo depthStencilStateInfo;
-  depthStencilStateInfo.depthTestEnable       = mGraphicsState.getDepthTestEnable();
-  depthStencilStateInfo.depthWriteEnable      = mGraphicsState.getDepthWriteEnable();
-  depthStencilStateInfo.depthCompareOp        = mGraphicsState.getDepthCompareOp();
-  depthStencilStateInfo.depthBoundsTestEnable = mGraphicsState.getDepthBoundsTestEnable();
-  depthStencilStateInfo.stencilTestEnable     = mGraphicsState.getStencilTestEnable();
-  depthStencilStateInfo.front                 = {mGraphicsState.getStencilFrontFailOp(),
-      mGraphicsState.getStencilFrontPassOp(), mGraphicsState.getStencilFrontDepthFailOp(),
-      mGraphicsState.getStencilFrontCompareOp(), mGraphicsState.getStencilFrontCompareMask(),
-      mGraphicsState.getStencilFrontWriteMask(), mGraphicsState.getStencilFrontReference()};
-  depthStencilStateInfo.back                  = {mGraphicsState.getStencilBackFailOp(),
-      mGraphicsState.getStencilBackPassOp(), mGraphicsState.getStencilBackDepthFailOp(),
-      mGraphicsState.getStencilBackCompareOp(), mGraphicsState.getStencilBackCompareMask(),
-      mGraphicsState.getStencilBackWriteMask(), mGraphicsState.getStencilBackReference()};
-  depthStencilStateInfo.minDepthBounds        = mGraphicsState.getMinDepthBounds();
-  depthStencilStateInfo.maxDepthBounds        = mGraphicsState.getMaxDepthBounds();
-
-  // -----------------------------------------------------------------------------------------------
-  vk::PipelineColorBlendStateCreateInfo              colorBlendStateInfo;
-  std::vector<vk::PipelineColorBlendAttachmentState> pipelineColorBlendAttachments;
-
-  // use default blend attachments if none are defined
-  if (mGraphicsState.getBlendAttachments().size() == 0) {
-    int attachmentCount = mCurrentRenderPass->getFrameBufferAttachmentFormats().size();
-    if (mCurrentRenderPass->hasDepthAttachment()) {
-      attachmentCount = std::max(0, attachmentCount - 1);
-    }
 
-    for (size_t i(0); i < attachmentCount; ++i) {
-      GraphicsState::BlendAttachment a;
-      pipelineColorBlendAttachments.push_back(
-          {a.mBlendEnable, a.mSrcColorBlendFactor, a.mDstColorBlendFactor, a.mColorBlendOp,
-              a.mSrcAlphaBlendFactor, a.mDstAlphaBlendFactor, a.mAlphaBlendOp, a.mColorWriteMask});
-    }
+  beginRendering(*mVkCmd, reinterpret_cast<VkRenderingInfoKHR const*>(&info));
+}
 
-  } else {
-    for (auto const& i : mGraphicsState.getBlendAttachments()) {
-      pipelineColorBlendAttachments.push_back(
-          {i.mBlendEnable, i.mSrcColorBlendFactor, i.mDstColorBlendFactor, i.mColorBlendOp,
-              i.mSrcAlphaBlendFactor, i.mDstAlphaBlendFactor, i.mAlphaBlendOp, i.mColorWriteMask});
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void CommandBuffer::endRendering() {
+  mDevice->getEndRenderingFunction()(*mVkCmd);
+
+  // The next use of the attachments will wait for these transitions.
+  auto const& attachments = mCurrentRenderPass->getAttachments();
+  auto const& images      = mCurrentRenderPass->getFramebuffer()->getImages();
+
+  for (size_t i(0); i < attachments.size(); ++i) {
+    if (attachments[i].mFinalLayout != vk::ImageLayout::eUndefined) {
+      transitionImage(images[i], attachments[i].mFinalLayout,
+          vk::PipelineStageFlagBits::eAllCommands, vk::AccessFlagBits::eMemoryRead);
     }
   }
-  colorBlendStateInfo.logicOpEnable   = mGraphicsState.getBlendLogicOpEnable();
-  colorBlendStateInfo.logicOp         = mGraphicsState.getBlendLogicOp();
-  colorBlendStateInfo.attachmentCount = static_cast<uint32_t>(pipelineColorBlendAttachments.size());
-  colorBlendStateInfo.pAttachments    = pipelineColorBlendAttachments.data();
-  colorBlendStateInfo.blendConstants[0] = mGraphicsState.getBlendConstants()[0];
-  colorBlendStateInfo.blendConstants[1] = mGraphicsState.getBlendConstants()[1];
-  colorBlendStateInfo.blendConstants[2] = mGraphicsState.getBlendConstants()[2];
-  colorBlendStateInfo.blendConstants[3] = mGraphicsState.getBlendConstants()[3];
-
-  // -----------------------------------------------------------------------------------------------
-  vk::PipelineDynamicStateCreateInfo dynamicStateInfo;
-  std::vector<vk::DynamicState>      dynamicState(
-      mGraphicsState.getDynamicState().begin(), mGraphicsState.getDynamicState().end());
-  dynamicStateInfo.dynamicStateCount = static_cast<uint32_t>(dynamicState.size());
-  dynamicStateInfo.pDynamicStates    = dynamicState.data();
-
-  // -----------------------------------------------------------------------------------------------
-  vk::GraphicsPipelineCreateInfo info;
-  info.stageCount          = static_cast<uint32_t>(stageInfos.size());
-  info.pStages             = stageInfos.data();
-  info.pVertexInputState   = &vertexInputStateInfo;
-  info.pInputAssemblyState = &inputAssemblyStateInfo;
-  info.pTessellationState  = &tessellationStateInfo;
-  info.pViewportState      = &viewportStateInfo;
-  info.pRasterizationState = &rasterizationStateInfo;
-  info.pMultisampleState   = &multisampleStateInfo;
-  info.pDepthStencilState  = &depthStencilStateInfo;
-  info.pColorBlendState    = &colorBlendStateInfo;
-  if (mGraphicsState.getDynamicState().size() > 0) {
-    info.pDynamicState = &dynamicStateInfo;
-  }
-  info.renderPass = *mCurrentRenderPass->getHandle();
-  info.subpass    = mCurrentSubPass;
-
-  if (mCurrentShader) {
-    info.layout = *mCurrentShader->getReflection()->getLayout();
-  }
-
-  auto pipeline = mDevice->createGraphicsPipeline(info);
-
-  mPipelineCache[hash] = pipeline;
-
-  return pipeline;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+vk::PipelinePtr CommandBuffer::getPipelineHandle(vk::PipelineBindPoint bindPoint) {
+
+  if (bindPoint == vk::PipelineBindPoint::eCompute) {
+    return mDevice->getPipelineCache()->getComputePipeline(mCurrentShader, mSpecializationState);
+  }
+
+  return mDevice->getPipelineCache()->getGraphicsPipeline(mGraphicsState, mCurrentShader,
+      mCurrentRenderPass, mCurrentSubPass, mSpecializationState, mAsyncPipelineCreation);
 }
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////
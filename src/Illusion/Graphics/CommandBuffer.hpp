@@ -11,10 +11,13 @@
 
 #include "BindingState.hpp"
 #include "DescriptorSetCache.hpp"
+#include "FrameStatistics.hpp"
 #include "GraphicsState.hpp"
+#include "SpecializationState.hpp"
 #include "fwd.hpp"
 
 #include <glm/glm.hpp>
+#include <unordered_map>
 
 namespace Illusion::Graphics {
 
@@ -22,7 +25,23 @@ namespace Illusion::Graphics {
 // The CommandBuffer class encapsulates a vk::CommandBuffer. It tracks the bound shader program,  //
 // the current render-pass and sub-pass, the graphics and the binding state. This information is  //
 // used to create descriptor sets and pipelines on-the-fly. Both are cached and re-used when      //
-// possible.                                                                                      //
+// possible. The pipelines are stored in the PipelineCache of the Device, hence they are shared   //
+// by all CommandBuffers.                                                                         //
+// The vk::CommandBuffer is allocated from the vk::CommandPool of the thread which constructs the //
+// CommandBuffer. Hence several threads can record their own CommandBuffers at the same time, for //
+// example secondary CommandBuffers for one subpass which are then executed by a primary one.     //
+// A CommandBuffer should be recorded, reset and destroyed by the thread which created it.        //
+// Threads which exit before the Device is destroyed should call Device::releaseCommandPools().   //
+// Furthermore, the CommandBuffer tracks the layout and the last accesses of each subresource of  //
+// the images and buffers it touches. Required pipeline barriers are collected and flushed in one //
+// vkCmdPipelineBarrier right before the next draw, dispatch, copy or RenderPass. The first       //
+// access in a CommandBuffer is not synchronized with previous submissions, this still has to be  //
+// done with semaphores or fences.                                                                //
+// The pipelines, descriptor sets, vertex and index buffers and push constants which are bound to //
+// the vk::CommandBuffer are shadowed. Commands which would not change this state are not         //
+// recorded; getSkippedCommands() reports how many have been skipped.                             //
+// Draws, dispatches, pipeline binds, descriptor updates and barriers are counted locally and     //
+// added to the FrameStatistics of the Device by end(); submit() counts as well.                  //
 ////////////////////////////////////////////////////////////////////////////////////////////////////
 
 class CommandBuffer {
@@ -33,25 +52,35 @@ class CommandBuffer {
     return std::make_shared<CommandBuffer>(args...);
   };
 
-  // Allocates a new vk::CommandBuffer from the device.
+  // Allocates a new vk::CommandBuffer from the vk::CommandPool of the calling thread.
   CommandBuffer(DevicePtr const& device, QueueType type = QueueType::eGeneric,
       vk::CommandBufferLevel level = vk::CommandBufferLevel::ePrimary);
 
   // basic operations ------------------------------------------------------------------------------
 
-  // Resets the vk::CommandBuffer and clears the current binding state.
-  // The current graphics state and the current shader program are not changed.
+  // Resets the vk::CommandBuffer and clears the current binding state and the counters of
+  // skipped commands. The current graphics state, the specialization state and the current shader
+  // program are not changed.
   void reset();
 
   // Begins the internal vk::CommandBuffer.
-  void begin(vk::CommandBufferUsageFlagBits usage =
-                 vk::CommandBufferUsageFlagBits::eSimultaneousUse) const;
+  void begin(
+      vk::CommandBufferUsageFlagBits usage = vk::CommandBufferUsageFlagBits::eSimultaneousUse);
 
-  // Ends the internal vk::CommandBuffer.
-  void end() const;
+  // Begins a secondary CommandBuffer which will be executed inside the given subpass of the
+  // RenderPass. The RenderPass and the subpass are stored so that draw calls create matching
+  // pipelines. eRenderPassContinue is always added to the usage flags. beginRenderPass() has to be
+  // called on the primary CommandBuffer before, as this initializes the RenderPass.
+  void begin(RenderPassPtr const& renderPass, uint32_t subPass,
+      vk::CommandBufferUsageFlags usage = vk::CommandBufferUsageFlagBits::eOneTimeSubmit);
+
+  // Flushes all pending barriers and ends the internal vk::CommandBuffer.
+  void end();
 
   // Submits the internal vk::CommandBuffer to the Device's queue matching the QueueType given to
-  // this CommandBuffer at construction time.
+  // this CommandBuffer at construction time. Each call issues a vkQueueSubmit of its own; when
+  // several CommandBuffers are submitted per frame, consider using the SubmissionBatcher of the
+  // Device instead.
   void submit(std::vector<vk::Semaphore> const&  waitSemaphores   = {},
       std::vector<vk::PipelineStageFlags> const& waitStages       = {},
       std::vector<vk::Semaphore> const&          signalSemaphores = {},
@@ -61,12 +90,28 @@ class CommandBuffer {
   // construction time.
   void waitIdle() const;
 
-  // Stores and begins the given RenderPass.
-  void beginRenderPass(RenderPassPtr const& renderPass);
+  // The internal vk::CommandBuffer and the QueueType given at construction time.
+  vk::CommandBufferPtr const& getHandle() const;
+  QueueType                   getQueueType() const;
+
+  // Stores and begins the given RenderPass. If the first subpass will be recorded by secondary
+  // CommandBuffers, contents has to be vk::SubpassContents::eSecondaryCommandBuffers. If the
+  // RenderPass uses dynamic rendering, its attachments are transitioned to the attachment layouts
+  // before; endRenderPass() transitions them to their mFinalLayout, if one is set.
+  void beginRenderPass(RenderPassPtr const& renderPass,
+      vk::SubpassContents contents = vk::SubpassContents::eInline);
+
+  // Advances to the next subpass of the current RenderPass.
+  void nextSubPass(vk::SubpassContents contents = vk::SubpassContents::eInline);
 
   // Ends and releases the current RenderPass.
   void endRenderPass();
 
+  // Records the given secondary CommandBuffers. They have to be ended already and must be kept
+  // alive until this CommandBuffer has finished execution. Afterwards, all bound state of this
+  // CommandBuffer is undefined and will be recorded again by the following commands.
+  void execute(std::vector<CommandBufferPtr> const& secondaryCommandBuffers);
+
   // state modification ----------------------------------------------------------------------------
 
   // Read and write access to the current GraphicsState. Changes will not directly affect the
@@ -79,33 +124,59 @@ class CommandBuffer {
   BindingState&       bindingState();
   BindingState const& bindingState() const;
 
+  // Read and write access to the current SpecializationState. The values are applied to the
+  // pipelines of all following draw and dispatch calls. Like the GraphicsState, this is not changed
+  // by reset().
+  SpecializationState&       specializationState();
+  SpecializationState const& specializationState() const;
+
   // Read and write access to the currently bound Shader. Changes will not directly affect
   // the internal vk::CommandBuffer; they are flushed whenever a draw or dispatch command is issued.
+  // Setting a Shader unbinds the current PipelineState.
   void             setShader(ShaderPtr const& val);
   ShaderPtr const& getShader() const;
 
+  // Binds a pre-built PipelineState. Its Shader becomes the current Shader and its GraphicsState
+  // replaces the current one, so that the values of its dynamic states are recorded; they may be
+  // changed with graphicsState() afterwards. Changes to other values of the GraphicsState and to
+  // the SpecializationState are ignored while a PipelineState is bound: the following draw or
+  // dispatch calls bind its vk::Pipeline directly, without hashing and without a PipelineCache
+  // lookup. A std::runtime_error is thrown by them if the PipelineState has been created for
+  // another bind point, RenderPass or subpass. Pass nullptr (or call setShader()) to return to
+  // pipelines created from the current state.
+  void                    bindPipelineState(PipelineStatePtr const& state);
+  PipelineStatePtr const& getPipelineState() const;
+
+  // If enabled, graphics pipelines which are not in the PipelineCache of the Device are created on
+  // a worker thread. Draw calls issued while their pipeline is not ready are silently skipped
+  // instead of stalling the recording thread. This is disabled by default.
+  void setAsyncPipelineCreation(bool enable);
+  bool getAsyncPipelineCreation() const;
+
   // Binds the given BackedBuffer as index buffer. This is directly recorded to the internal
-  // vk::CommandBuffer.
+  // vk::CommandBuffer unless the same buffer, offset and type are bound already.
   void bindIndexBuffer(
-      BackedBufferPtr const& buffer, vk::DeviceSize offset, vk::IndexType indexType) const;
+      BackedBufferPtr const& buffer, vk::DeviceSize offset, vk::IndexType indexType);
 
   // Binds the given BackedBuffer as vertex buffer. Compared to the method below, this method allows
-  // for additional offsets. This is directly recorded to the internal vk::CommandBuffer.
+  // for additional offsets. This is directly recorded to the internal vk::CommandBuffer; only the
+  // range of bindings which actually change is bound.
   void bindVertexBuffers(uint32_t                                    firstBinding,
-      std::vector<std::pair<BackedBufferPtr, vk::DeviceSize>> const& buffersAndOffsets) const;
+      std::vector<std::pair<BackedBufferPtr, vk::DeviceSize>> const& buffersAndOffsets);
 
   // Binds the given BackedBuffer as vertex buffer. This is directly recorded to the internal
-  // vk::CommandBuffer.
-  void bindVertexBuffers(uint32_t firstBinding, std::vector<BackedBufferPtr> const& buffers) const;
+  // vk::CommandBuffer; only the range of bindings which actually change is bound.
+  void bindVertexBuffers(uint32_t firstBinding, std::vector<BackedBufferPtr> const& buffers);
 
   // Sets the given data (size in bytes) as push constant data. You have to make sure that there is
-  // a shader program currently bound.
-  void pushConstants(const void* data, uint32_t size, uint32_t offset = 0) const;
+  // a shader program currently bound. Nothing is recorded if the same data has been pushed before
+  // with the same pipeline layout.
+  void pushConstants(const void* data, uint32_t size, uint32_t offset = 0);
 
   // Convenience method calling the method above. This allows setting any type (e.g. structs) as
   // push constant data
   template <typename T>
-  void pushConstants(T const& data, uint32_t offset = 0) const {
+  void pushConstants(T const& data, uint32_t offset = 0) {
     pushConstants(&data, sizeof(T), offset);
   }
 
@@ -115,19 +186,105 @@ class CommandBuffer {
   // the private method flush() is called. This will either create a vk::Pipeline object based on
   // the currently bound shader program and the current graphics state or retrieve a matching cached
   // vk::Pipeline. This pipeline will be bound. Then, based on the binding state, descriptor sets
-  // will be allocated, updated and bound.
+  // will be allocated, updated and bound. If asynchronous pipeline creation is enabled and the
+  // pipeline is not ready yet, nothing is recorded. As dispatch() always binds a compute pipeline,
+  // it can be used with all QueueTypes, for example for culling passes on eGeneric CommandBuffers.
   void draw(uint32_t vertexCount, uint32_t instanceCount = 1, uint32_t firstVertex = 0,
       uint32_t firstInstance = 0);
   void drawIndexed(uint32_t indexCount, uint32_t instanceCount = 1, uint32_t firstIndex = 0,
       int32_t vertexOffset = 0, uint32_t firstInstance = 0);
   void dispatch(uint32_t groupCountX, uint32_t groupCountY = 1, uint32_t groupCountZ = 1);
 
+  // Launches the given number of task shader workgroups (or mesh shader workgroups if the current
+  // Shader has no task stage). This requires VK_EXT_mesh_shader, an exception is thrown if it is
+  // not available. As the pipeline has no vertex input, no vertex and index buffers are used.
+  void drawMeshTasks(uint32_t groupCountX, uint32_t groupCountY = 1, uint32_t groupCountZ = 1);
+
+  // The indirect draw calls read drawCount vk::DrawIndexedIndirectCommands from the given buffer,
+  // which needs vk::BufferUsageFlagBits::eIndirectBuffer. Outside of RenderPasses, the buffers are
+  // tracked like the resources of the BindingState; inside of RenderPasses, buffers written on the
+  // GPU have to be declared with accessBuffer() before beginRenderPass() is called. If the
+  // multiDrawIndirect feature is not available, one command is recorded for each draw. The
+  // firstInstance of the commands must be zero if drawIndirectFirstInstance is not available (see
+  // Device::getEnabledFeatures()).
+  void drawIndexedIndirect(BackedBufferPtr const& buffer, vk::DeviceSize offset, uint32_t drawCount,
+      uint32_t stride = sizeof(vk::DrawIndexedIndirectCommand));
+
+  // Like above, but the number of draws is read from countBuffer at countOffset; it is clamped to
+  // maxDrawCount. This requires VK_KHR_draw_indirect_count, an exception is thrown if it is not
+  // available.
+  void drawIndexedIndirectCount(BackedBufferPtr const& buffer, vk::DeviceSize offset,
+      BackedBufferPtr const& countBuffer, vk::DeviceSize countOffset, uint32_t maxDrawCount,
+      uint32_t stride = sizeof(vk::DrawIndexedIndirectCommand));
+
+  // resource state tracking -----------------------------------------------------------------------
+
+  // Declares that the given subresources of the image will be accessed with the given layout by
+  // the given stages. If a layout transition or a memory dependency is required, a barrier is
+  // added to the pending barriers. The mCurrentLayout of the image is updated immediately if all
+  // its subresources share the same layout afterwards.
+  // Outside of RenderPasses, this is done automatically for all images and buffers of the
+  // BindingState before each dispatch; inside of RenderPasses no barriers can be recorded, hence
+  // sampled images have to be transitioned before beginRenderPass() is called.
+  void transitionImage(BackedImagePtr const& image, vk::ImageLayout layout,
+      vk::PipelineStageFlags stages, vk::AccessFlags access);
+  void transitionImage(BackedImagePtr const& image, vk::ImageLayout layout,
+      vk::PipelineStageFlags stages, vk::AccessFlags access,
+      vk::ImageSubresourceRange const& range);
+
+  // Declares that the given buffer will be accessed by the given stages. If there is a hazard with
+  // a previous access, a barrier is added to the pending barriers.
+  void accessBuffer(
+      BackedBufferPtr const& buffer, vk::PipelineStageFlags stages, vk::AccessFlags access);
+
+  // Records all pending barriers with one vkCmdPipelineBarrier. This is called automatically
+  // before draw, dispatch and copy commands which are issued with BackedImages or BackedBuffers.
+  void flushBarriers();
+
+  // Images and buffers with vk::SharingMode::eExclusive which are written by one QueueType and
+  // used by another one (for example by async compute, see FrameContext::submitCompute()) have to
+  // be transferred to the queue family of the other QueueType. The release has to be recorded on
+  // the CommandBuffer which used the resource last, the acquire on a CommandBuffer of the other
+  // QueueType which is submitted after the first one and waits for a semaphore signaled by it. The
+  // layout is not changed by the transfer. The stages and access of the acquire are those of the
+  // first use on the new queue; later accesses are synchronized with it as usual. If both
+  // QueueTypes use the same queue family, release does nothing and acquire only declares the
+  // access like transitionImage() or accessBuffer().
+  void releaseImage(BackedImagePtr const& image, QueueType dstType);
+  void acquireImage(BackedImagePtr const& image, QueueType srcType, vk::PipelineStageFlags stages,
+      vk::AccessFlags access);
+  void releaseBuffer(BackedBufferPtr const& buffer, QueueType dstType);
+  void acquireBuffer(BackedBufferPtr const& buffer, QueueType srcType,
+      vk::PipelineStageFlags stages, vk::AccessFlags access);
+
   // convenience methods ---------------------------------------------------------------------------
 
+  // Records a barrier immediately, the pending barriers are flushed before. As vk::Images are not
+  // tracked, this is only useful for images which are not BackedImages (e.g. swapchain images).
   void transitionImageLayout(vk::Image image, vk::ImageLayout oldLayout, vk::ImageLayout newLayout,
       vk::PipelineStageFlagBits srcStage, vk::PipelineStageFlagBits dstStage,
-      vk::ImageSubresourceRange range = {vk::ImageAspectFlagBits::eColor, 0, 1, 0, 1}) const;
+      vk::ImageSubresourceRange range = {vk::ImageAspectFlagBits::eColor, 0, 1, 0, 1});
+
+  // These track the states of the given images and buffers. They are transitioned to the required
+  // layouts and the pending barriers are flushed before the command is recorded.
+  void copyImage(BackedImagePtr const& src, BackedImagePtr const& dst, glm::uvec2 const& size);
 
+  void blitImage(BackedImagePtr const& src, uint32_t srcMipmapLevel, BackedImagePtr const& dst,
+      uint32_t dstMipmapLevel, glm::uvec2 const& srcSize, glm::uvec2 const& dstSize,
+      vk::Filter filter);
+
+  void copyBuffer(BackedBufferPtr const& src, BackedBufferPtr const& dst, vk::DeviceSize size);
+  void copyBuffer(BackedBufferPtr const& src, BackedBufferPtr const& dst,
+      std::vector<vk::BufferCopy> const& regions);
+
+  void copyBufferToImage(BackedBufferPtr const& src, BackedImagePtr const& dst,
+      std::vector<vk::BufferImageCopy> const& infos);
+
+  void copyImageToBuffer(BackedImagePtr const& src, BackedBufferPtr const& dst,
+      std::vector<vk::BufferImageCopy> const& infos);
+
+  // The raw versions of the commands above are not tracked. The source images have to be in
+  // vk::ImageLayout::eTransferSrcOptimal, the destination images in eTransferDstOptimal.
   void copyImage(vk::Image src, vk::Image dst, glm::uvec2 const& size) const;
 
   void blitImage(vk::Image src, vk::Image dst, glm::uvec2 const& srcSize, glm::uvec2 const& dstSize,
@@ -145,30 +302,181 @@ class CommandBuffer {
   void copyBufferToImage(vk::Buffer src, vk::Image dst, vk::ImageLayout dstLayout,
       std::vector<vk::BufferImageCopy> const& infos) const;
 
+  void copyImageToBuffer(vk::Image src, vk::ImageLayout srcLayout, vk::Buffer dst,
+      std::vector<vk::BufferImageCopy> const& infos) const;
+
+  // acceleration structures -----------------------------------------------------------------------
+
+  // These require ray query support (see PhysicalDevice::supportsRayQueries()), an exception is
+  // thrown if it is not available. They have to be recorded outside of RenderPasses; the buffers
+  // of the AccelerationStructures are tracked like other buffers, so traversals by ray queries of
+  // later dispatches are synchronized automatically. Inside of RenderPasses, the buffers of
+  // top-level structures have to be declared with accessBuffer() before beginRenderPass().
+
+  // Builds dst with the given geometries and one range per geometry. If the mode of the info is
+  // eUpdate, src is refitted into dst; both may be the same structure. The vertex, index and
+  // instance buffers which are referenced by the geometries have to be passed as inputs, for
+  // top-level structures also the mBuffers of the referenced bottom-level structures. The
+  // scratch buffer needs the eStorageBuffer and eShaderDeviceAddress usages and has to be at least
+  // minAccelerationStructureScratchOffsetAlignment bytes larger than the buildScratchSize (or
+  // updateScratchSize) of Device::getAccelerationStructureBuildSizes(); it must not be used by
+  // other builds of the same batch. The destination, source and scratch data of the info are set
+  // by this method.
+  void buildAccelerationStructure(AccelerationStructurePtr const& dst,
+      vk::AccelerationStructureBuildGeometryInfoKHR                  info,
+      std::vector<vk::AccelerationStructureBuildRangeInfoKHR> const& ranges,
+      std::vector<BackedBufferPtr> const& inputs, BackedBufferPtr const& scratch,
+      AccelerationStructurePtr const& src = nullptr);
+
+  // Copies src to dst. With vk::CopyAccelerationStructureModeKHR::eCompact, dst has to be at least
+  // as large as the compacted size of src, see writeCompactedSize().
+  void copyAccelerationStructure(AccelerationStructurePtr const& src,
+      AccelerationStructurePtr const& dst,
+      vk::CopyAccelerationStructureModeKHR mode = vk::CopyAccelerationStructureModeKHR::eClone);
+
+  // Writes the compacted size of the given structure to a query of the given pool, which has to be
+  // of type vk::QueryType::eAccelerationStructureCompactedSizeKHR. The structure has to be built
+  // with vk::BuildAccelerationStructureFlagBitsKHR::eAllowCompaction. Like the other queries, it
+  // has to be reset before.
+  void writeCompactedSize(AccelerationStructurePtr const& accelerationStructure,
+      vk::QueryPoolPtr const& pool, uint32_t query);
+
+  // statistics ------------------------------------------------------------------------------------
+
+  // The number of commands which have not been recorded since they would not have changed the
+  // state bound to the vk::CommandBuffer. These are set to zero by reset().
+  struct SkippedCommands {
+    uint32_t mPipelineBinds      = 0;
+    uint32_t mDescriptorSetBinds = 0;
+    uint32_t mVertexBufferBinds  = 0;
+    uint32_t mIndexBufferBinds   = 0;
+    uint32_t mPushConstants      = 0;
+  };
+
+  SkippedCommands const& getSkippedCommands() const;
+
+  // The commands recorded since the last call to begin(). They are added to the FrameStatistics of
+  // the Device by end().
+  FrameStatistics::Counters const& getStatistics() const;
+
+  // queries ---------------------------------------------------------------------------------------
+
+  // These are directly recorded to the internal vk::CommandBuffer. Queries have to be reset
+  // outside of RenderPasses before they are written. The pool must be kept alive until this
+  // CommandBuffer has finished execution.
+  void resetQueryPool(vk::QueryPoolPtr const& pool, uint32_t firstQuery, uint32_t queryCount) const;
+  void writeTimestamp(
+      vk::PipelineStageFlagBits stage, vk::QueryPoolPtr const& pool, uint32_t query) const;
+  void beginQuery(
+      vk::QueryPoolPtr const& pool, uint32_t query, vk::QueryControlFlags flags) const;
+  void endQuery(vk::QueryPoolPtr const& pool, uint32_t query) const;
+
+  // If set, each RenderPass which is begun on this CommandBuffer is measured by a scope of the
+  // PassStatistics, unless a scope is open already. The scope begins before and ends after the
+  // RenderPass. Set to nullptr to disable this again.
+  void                     setPassStatistics(PassStatisticsPtr const& statistics);
+  PassStatisticsPtr const& getPassStatistics() const;
+
  private:
-  void            flush();
-  vk::PipelinePtr getPipelineHandle();
+  // Returns false if the pipeline is not available yet.
+  bool            flush(vk::PipelineBindPoint bindPoint);
+  vk::PipelinePtr getPipelineHandle(vk::PipelineBindPoint bindPoint);
+
+  // Declares the accesses of all resources of the BindingState which are used by the current
+  // Shader. Returns a bit mask of the set numbers whose image layouts have changed.
+  uint32_t trackBindings();
+
+  // Forgets everything which is bound to the vk::CommandBuffer, all following commands will be
+  // recorded. This is required whenever the state of the vk::CommandBuffer becomes undefined.
+  void invalidateBoundState();
+
+  // Binds the given range of vertex buffers, leaving out bindings at the beginning and the end of
+  // the range which are bound already.
+  void recordVertexBuffers(uint32_t firstBinding, std::vector<vk::Buffer> const& buffers,
+      std::vector<vk::DeviceSize> const& offsets);
+
+  // Records the values of all dynamic states of the GraphicsState if one of them has been changed
+  // or if another pipeline has been bound since they have been recorded the last time.
+  void recordDynamicState(vk::PipelinePtr const& pipeline);
+
+  // The synchronization state of an image subresource or a buffer. mBatch is equal to
+  // mCurrentBatch if the resource is part of the pending barriers.
+  struct AccessState {
+    vk::ImageLayout        mLayout = vk::ImageLayout::eUndefined;
+    vk::PipelineStageFlags mWriteStages;
+    vk::AccessFlags        mWriteAccess;
+    vk::PipelineStageFlags mReadStages;
+    uint64_t               mBatch = 0;
+  };
+
+  // Updates the state and returns true if a barrier with the given source stages and access is
+  // required.
+  static bool updateState(AccessState& state, vk::ImageLayout layout, vk::PipelineStageFlags stages,
+      vk::AccessFlags access, vk::PipelineStageFlags& srcStages, vk::AccessFlags& srcAccess);
+
+  void addImageBarrier(vk::ImageMemoryBarrier const& barrier);
+
+  // These are used by beginRenderPass() and endRenderPass() for RenderPasses in dynamic rendering
+  // mode.
+  void beginRendering(RenderPassPtr const& renderPass, vk::SubpassContents contents);
+  void endRendering();
 
   DevicePtr              mDevice;
   vk::CommandBufferPtr   mVkCmd;
   QueueType              mType;
   vk::CommandBufferLevel mLevel;
 
-  GraphicsState mGraphicsState;
-  BindingState  mBindingState;
-
-  ShaderPtr     mCurrentShader;
-  RenderPassPtr mCurrentRenderPass;
-  uint32_t      mCurrentSubPass = 0;
-
-  std::map<Core::BitHash, vk::PipelinePtr> mPipelineCache;
-
+  GraphicsState       mGraphicsState;
+  BindingState        mBindingState;
+  SpecializationState mSpecializationState;
+
+  ShaderPtr        mCurrentShader;
+  PipelineStatePtr mCurrentPipelineState;
+  RenderPassPtr    mCurrentRenderPass;
+  uint32_t         mCurrentSubPass = 0;
+
+  // mPassStatisticsScope is true while mPassStatistics has a scope open for the current RenderPass
+  PassStatisticsPtr mPassStatistics;
+  bool              mPassStatisticsScope = false;
+
+  bool mAsyncPipelineCreation = false;
+
+  vk::PipelinePtr mDynamicStatePipeline;
+  Core::BitHash   mDynamicStateHash;
+
+  // The shadowed state of the vk::CommandBuffer. The vertex buffers are stored per binding, a null
+  // handle means that nothing is known about the binding. mPushConstants is only valid in the range
+  // [mPushConstantBegin, mPushConstantEnd) for mPushConstantLayout.
+  std::map<vk::PipelineBindPoint, vk::PipelinePtr>   mCurrentPipelines;
+  std::vector<std::pair<vk::Buffer, vk::DeviceSize>> mCurrentVertexBuffers;
+  vk::Buffer                                         mCurrentIndexBuffer;
+  vk::DeviceSize                                     mCurrentIndexOffset = 0;
+  vk::IndexType                                      mCurrentIndexType   = vk::IndexType::eUint16;
+  vk::PipelineLayoutPtr                              mPushConstantLayout;
+  std::vector<uint8_t>                               mPushConstants;
+  uint32_t                                           mPushConstantBegin = 0;
+  uint32_t                                           mPushConstantEnd   = 0;
+  SkippedCommands                                    mSkippedCommands;
+  FrameStatistics::Counters                          mStatistics;
+
+  // mSetLayoutHash is the compatibility hash of the pipeline layout the set has been bound with
   struct DescriptorSetState {
     vk::DescriptorSetPtr mSet;
     Core::BitHash        mSetLayoutHash;
   };
   std::map<uint32_t, DescriptorSetState> mCurrentDescriptorSets;
+  vk::PipelineBindPoint                  mCurrentBindPoint = vk::PipelineBindPoint::eGraphics;
   DescriptorSetCache                     mDescriptorSetCache;
+
+  // The states of the images are stored for each mipmap level and array layer, the index is
+  // mipLevel * arrayLayers + arrayLayer.
+  std::unordered_map<BackedImagePtr, std::vector<AccessState>> mImageStates;
+  std::unordered_map<BackedBufferPtr, AccessState>             mBufferStates;
+  std::vector<vk::ImageMemoryBarrier>                          mPendingImageBarriers;
+  std::vector<vk::BufferMemoryBarrier>                         mPendingBufferBarriers;
+  vk::PipelineStageFlags                                       mPendingSrcStages;
+  vk::PipelineStageFlags                                       mPendingDstStages;
+  uint64_t                                                     mCurrentBatch = 1;
 };
 
 } // namespace Illusion::Graphics
@@ -0,0 +1,196 @@
+////////////////////////////////////////////////////////////////////////////////////////////////////
+//                                                                                                //
+//    _)  |  |            _)                This code may be used and modified under the terms    //
+//     |  |  |  |  | (_-<  |   _ \    \     of the MIT license. See the LICENSE file for details. //
+//    _| _| _| \_,_| ___/ _| \___/ _| _|    Copyright (c) 2018-2019 Simon Schneegans              //
+//                                                                                                //
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include "DeletionQueue.hpp"
+
+#include "../Core/EnumCast.hpp"
+#include "../Core/Logger.hpp"
+
+#include <algorithm>
+#include <iostream>
+#include <vector>
+
+namespace Illusion::Graphics {
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+DeletionQueue::DeletionQueue() {
+  ILLUSION_TRACE << "Creating DeletionQueue." << std::endl;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+DeletionQueue::~DeletionQueue() {
+  ILLUSION_TRACE << "Deleting DeletionQueue." << std::endl;
+  disable();
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void DeletionQueue::push(std::function<void()> const& destroy) {
+  {
+    std::unique_lock<std::mutex> lock(mMutex);
+
+    bool pendingWork = false;
+    for (size_t i(0); i < mEnqueuedValues.size(); ++i) {
+      pendingWork |= mEnqueuedValues[i] > mCompletedValues[i];
+    }
+
+    // without frames, the Entry only waits for the timelines
+    if (mEnabled || pendingWork) {
+      mQueue.push_back({mEnabled ? mCurrentFrame : 0, mEnqueuedValues, destroy});
+      return;
+    }
+  }
+
+  destroy();
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void DeletionQueue::beginFrame(uint64_t frameIndex) {
+  std::unique_lock<std::mutex> lock(mMutex);
+  mCurrentFrame = frameIndex;
+  mEnabled      = true;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void DeletionQueue::addFrameContext() {
+  std::unique_lock<std::mutex> lock(mMutex);
+  ++mFrameContexts;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void DeletionQueue::removeFrameContext() {
+  {
+    std::unique_lock<std::mutex> lock(mMutex);
+
+    if (--mFrameContexts > 0) {
+      return;
+    }
+
+    // The frame indices of the next FrameContext start at zero again, so the remaining Entries
+    // only wait for the timelines from now on.
+    for (auto& entry : mQueue) {
+      entry.mFrame = 0;
+    }
+
+    mCurrentFrame  = 0;
+    mReleasedFrame = 0;
+    mEnabled       = false;
+  }
+
+  releaseCompleted();
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void DeletionQueue::releaseFrames(uint64_t frameIndex) {
+  {
+    std::unique_lock<std::mutex> lock(mMutex);
+    mReleasedFrame = std::max(mReleasedFrame, frameIndex);
+  }
+
+  releaseCompleted();
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void DeletionQueue::setEnqueuedValue(QueueType type, uint64_t value) {
+  std::unique_lock<std::mutex> lock(mMutex);
+  auto& enqueued = mEnqueuedValues[Core::enumCast(type)];
+  enqueued       = std::max(enqueued, value);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void DeletionQueue::setCompletedValue(QueueType type, uint64_t value) {
+  std::unique_lock<std::mutex> lock(mMutex);
+  auto& completed = mCompletedValues[Core::enumCast(type)];
+  completed       = std::max(completed, value);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void DeletionQueue::releaseCompleted() {
+  std::vector<std::function<void()>> functions;
+
+  {
+    std::unique_lock<std::mutex> lock(mMutex);
+
+    while (!mQueue.empty()) {
+      auto const& entry = mQueue.front();
+
+      bool completed = entry.mFrame <= mReleasedFrame;
+      for (size_t i(0); i < mCompletedValues.size(); ++i) {
+        completed &= entry.mTimelineValues[i] <= mCompletedValues[i];
+      }
+
+      if (!completed) {
+        break;
+      }
+
+      functions.push_back(std::move(mQueue.front().mDestroy));
+      mQueue.pop_front();
+    }
+  }
+
+  // the functions are called without holding the lock, as they may release further objects
+  for (auto const& f : functions) {
+    f();
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void DeletionQueue::releaseAll() {
+  std::vector<std::function<void()>> functions;
+
+  {
+    std::unique_lock<std::mutex> lock(mMutex);
+    for (auto& entry : mQueue) {
+      functions.push_back(std::move(entry.mDestroy));
+    }
+    mQueue.clear();
+  }
+
+  for (auto const& f : functions) {
+    f();
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void DeletionQueue::disable() {
+  {
+    std::unique_lock<std::mutex> lock(mMutex);
+    mEnabled = false;
+  }
+
+  releaseAll();
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+bool DeletionQueue::getEnabled() const {
+  std::unique_lock<std::mutex> lock(mMutex);
+  return mEnabled;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+uint32_t DeletionQueue::getPendingCount() const {
+  std::unique_lock<std::mutex> lock(mMutex);
+  return static_cast<uint32_t>(mQueue.size());
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+} // namespace Illusion::Graphics
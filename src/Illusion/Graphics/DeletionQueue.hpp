@@ -0,0 +1,113 @@
+////////////////////////////////////////////////////////////////////////////////////////////////////
+//                                                                                                //
+//    _)  |  |            _)                This code may be used and modified under the terms    //
+//     |  |  |  |  | (_-<  |   _ \    \     of the MIT license. See the LICENSE file for details. //
+//    _| _| _| \_,_| ___/ _| \___/ _| _|    Copyright (c) 2018-2019 Simon Schneegans              //
+//                                                                                                //
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#ifndef ILLUSION_GRAPHICS_DELETION_QUEUE_HPP
+#define ILLUSION_GRAPHICS_DELETION_QUEUE_HPP
+
+#include "fwd.hpp"
+
+#include <array>
+#include <deque>
+#include <functional>
+#include <mutex>
+
+namespace Illusion::Graphics {
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// The DeletionQueue is used by the deleters of the Vulkan objects created by the Device. Instead //
+// of destroying an object when its last std::shared_ptr goes away, the destruction is enqueued   //
+// together with the index of the frame which is currently recorded. The FrameContext calls       //
+// releaseFrames() once the fence of a frame has been signaled; then all objects which were       //
+// released during this frame (or before) are destroyed. This way objects which may still be used //
+// by the GPU can be dropped without waiting for the Device to become idle.                       //
+// Work which is submitted by the SubmissionBatcher outside of the frames (for example async      //
+// compute) is tracked as well: the batcher reports the values of its timelines and each object   //
+// is only destroyed once all timelines have reached the values which had been enqueued when it   //
+// was released. Hence objects are also deferred without a FrameContext as long as there is       //
+// pending work; otherwise they are destroyed immediately unless a FrameContext is in use. All    //
+// methods are thread-safe; the destruction functions are called by the thread which releases the //
+// frames or which flushes or waits for the SubmissionBatcher.                                    //
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+class DeletionQueue {
+
+ public:
+  // Syntactic sugar to create a std::shared_ptr for this class
+  template <typename... Args>
+  static DeletionQueuePtr create(Args&&... args) {
+    return std::make_shared<DeletionQueue>(args...);
+  };
+
+  DeletionQueue();
+
+  // Calls all pending destruction functions.
+  virtual ~DeletionQueue();
+
+  // Calls the given function once the current frame and all work enqueued to the SubmissionBatcher
+  // so far have been processed by the GPU. If the queue is not enabled and there is no pending
+  // work, it is called immediately.
+  void push(std::function<void()> const& destroy);
+
+  // Sets the index of the frame which is recorded from now on. This enables the queue.
+  void beginFrame(uint64_t frameIndex);
+
+  // These are called by each FrameContext when it is created and destroyed. Once the last
+  // FrameContext is gone, the frames of all pending functions are considered processed and the
+  // queue is disabled again. Functions which still wait for the timelines of the
+  // SubmissionBatcher are kept until these have been reached.
+  void addFrameContext();
+  void removeFrameContext();
+
+  // Marks all frames with an index less or equal to the given one as processed and calls all
+  // functions which are not waiting for any further work. frameIndex should be the index of a
+  // frame whose fence has been signaled.
+  void releaseFrames(uint64_t frameIndex);
+
+  // These are called by the SubmissionBatcher: the first with the value returned by each
+  // enqueue(), the second whenever it has queried the progress of a timeline.
+  void setEnqueuedValue(QueueType type, uint64_t value);
+  void setCompletedValue(QueueType type, uint64_t value);
+
+  // Calls all functions whose frames have been released and whose timeline values have been
+  // reached.
+  void releaseCompleted();
+
+  // Calls all pending functions. Use this only when the Device is idle.
+  void releaseAll();
+
+  // Calls all pending functions and disables the queue; later calls to push() will call the given
+  // functions immediately again.
+  void disable();
+
+  bool     getEnabled() const;
+  uint32_t getPendingCount() const;
+
+ private:
+  struct Entry {
+    uint64_t                mFrame;
+    std::array<uint64_t, 3> mTimelineValues;
+    std::function<void()>   mDestroy;
+  };
+
+  // One value for each QueueType
+  std::array<uint64_t, 3> mEnqueuedValues{};
+  std::array<uint64_t, 3> mCompletedValues{};
+
+  // mCurrentFrame and the enqueued values only grow, hence an Entry can only be released if all
+  // Entries before it can be released as well.
+  std::deque<Entry>  mQueue;
+  uint64_t           mCurrentFrame  = 0;
+  uint64_t           mReleasedFrame = 0;
+  uint32_t           mFrameContexts = 0;
+  bool               mEnabled       = false;
+  mutable std::mutex mMutex;
+};
+
+} // namespace Illusion::Graphics
+
+#endif // ILLUSION_GRAPHICS_DELETION_QUEUE_HPP
@@ -11,6 +11,7 @@
 #include "../Core/Logger.hpp"
 #include "DescriptorSetReflection.hpp"
 #include "Device.hpp"
+#include "FrameStatistics.hpp"
 #include "Utils.hpp"
 #include "VulkanPtr.hpp"
 
@@ -36,14 +37,17 @@ const std::unordered_map<PipelineResource::ResourceType, vk::DescriptorType> res
     {PipelineResource::ResourceType::eUniformBufferDynamic,
         vk::DescriptorType::eUniformBufferDynamic},
     {PipelineResource::ResourceType::eUniformTexelBuffer, vk::DescriptorType::eUniformTexelBuffer},
+    {PipelineResource::ResourceType::eAccelerationStructure,
+        vk::DescriptorType::eAccelerationStructureKHR},
 };
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////
 
 DescriptorPool::DescriptorPool(
-    DevicePtr const& device, DescriptorSetReflectionPtr const& reflection)
+    DevicePtr const& device, DescriptorSetReflectionPtr const& reflection, bool transient)
     : mDevice(device)
-    , mReflection(reflection) {
+    , mReflection(reflection)
+    , mTransient(transient) {
 
   ILLUSION_TRACE << "Creating DescriptorPool." << std::endl;
 
@@ -93,7 +97,10 @@ vk::DescriptorSetPtr DescriptorPool::allocateDescriptorSet() {
     info.poolSizeCount = static_cast<uint32_t>(mPoolSizes.size());
     info.pPoolSizes    = mPoolSizes.data();
     info.maxSets       = mMaxSetsPerPool;
-    info.flags         = vk::DescriptorPoolCreateFlagBits::eFreeDescriptorSet;
+
+    if (!mTransient) {
+      info.flags = vk::DescriptorPoolCreateFlagBits::eFreeDescriptorSet;
+    }
 
     pool                   = std::make_shared<PoolInfo>();
     pool->mPool            = mDevice->createDescriptorPool(info);
@@ -110,8 +117,16 @@ vk::DescriptorSetPtr DescriptorPool::allocateDescriptorSet() {
   info.pSetLayouts        = descriptorSetLayouts;
 
   ILLUSION_TRACE << "Allocating DescriptorSet." << std::endl;
+  mDevice->getFrameStatistics()->add(&FrameStatistics::Counters::mDescriptorSetAllocations);
 
   auto device{mDevice->getHandle()};
+
+  // transient sets are returned to their pool by reset(), the handle only keeps the pool alive
+  if (mTransient) {
+    return VulkanPtr::create(
+        device->allocateDescriptorSets(info)[0], [pool](vk::DescriptorSet* obj) { delete obj; });
+  }
+
   return VulkanPtr::create(
       device->allocateDescriptorSets(info)[0], [device, pool](vk::DescriptorSet* obj) {
         ILLUSION_TRACE << "Freeing DescriptorSet." << std::endl;
@@ -123,4 +138,20 @@ vk::DescriptorSetPtr DescriptorPool::allocateDescriptorSet() {
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////
 
+void DescriptorPool::reset() {
+  if (!mTransient) {
+    throw std::runtime_error("Cannot reset DescriptorPool: Pool is not transient!");
+  }
+
+  auto device{mDevice->getHandle()};
+  for (auto& p : mDescriptorPools) {
+    if (p->mAllocationCount > 0) {
+      device->resetDescriptorPool(*p->mPool);
+      p->mAllocationCount = 0;
+    }
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
 } // namespace Illusion::Graphics
@@ -23,6 +23,8 @@ namespace Illusion::Graphics {
 // vk::DescriptorSet allocations is reached.                                                      //
 // Reference counting on the returned handle is used to decide when a DescriptorSet can be freed  //
 // and returned to the allocating vk::DescriptorPool.                                             //
+// A transient DescriptorPool never frees individual DescriptorSets. Instead, all of them are     //
+// released at once with reset(), which is much cheaper and is meant to be done once per frame.   //
 ////////////////////////////////////////////////////////////////////////////////////////////////////
 
 class DescriptorPool {
@@ -34,18 +36,24 @@ class DescriptorPool {
   };
 
   // The allocated DescriptorSets are created according to the given reflection.
-  DescriptorPool(DevicePtr const& device, DescriptorSetReflectionPtr const& reflection);
+  DescriptorPool(DevicePtr const& device, DescriptorSetReflectionPtr const& reflection,
+      bool transient = false);
   virtual ~DescriptorPool();
 
   // Allocates a fresh vk::DescriptorSet, may create a vk::DescriptorPool if no free pool is
   // available. Once the reference count on this handle runs out of scope, the vk::DescriptorSet
-  // will be freed.
+  // will be freed. For transient pools, the vk::DescriptorSet is valid until the next reset().
   vk::DescriptorSetPtr allocateDescriptorSet();
 
+  // Returns all vk::DescriptorSets of a transient pool to their vk::DescriptorPools. None of them
+  // may be in use anymore. This throws for pools which are not transient.
+  void reset();
+
  private:
   const uint32_t                      mMaxSetsPerPool = 64;
   DevicePtr                           mDevice;
   DescriptorSetReflectionPtr          mReflection;
+  bool                                mTransient;
   std::vector<vk::DescriptorPoolSize> mPoolSizes;
 
   // The cache stores all vk::DescriptorPools and the number of descriptor sets which have been
@@ -13,6 +13,12 @@
 
 namespace Illusion::Graphics {
 
+namespace {
+// Persistent descriptor sets are recycled when they have not been found for this many calls to
+// releaseAll().
+const uint32_t MAX_UNUSED_FRAMES = 16;
+} // namespace
+
 ////////////////////////////////////////////////////////////////////////////////////////////////////
 
 DescriptorSetCache::DescriptorSetCache(DevicePtr const& device)
@@ -28,65 +34,113 @@ DescriptorSetCache::~DescriptorSetCache() {
 
 vk::DescriptorSetPtr DescriptorSetCache::acquireHandle(
     DescriptorSetReflectionPtr const& reflection) {
+  return getEntry(reflection).mTransientPool->allocateDescriptorSet();
+}
 
-  auto const& hash       = reflection->getHash();
-  auto        cacheEntry = mCache.find(hash);
-
-  if (cacheEntry != mCache.end()) {
+////////////////////////////////////////////////////////////////////////////////////////////////////
 
-    // First case: we have a handle which has been acquired before; return it!
-    if (cacheEntry->second.mFreeHandels.size() > 0) {
-      auto descriptorSet = *cacheEntry->second.mFreeHandels.begin();
-      cacheEntry->second.mFreeHandels.erase(cacheEntry->second.mFreeHandels.begin());
-      cacheEntry->second.mUsedHandels.insert(descriptorSet);
-      return descriptorSet;
-    }
+vk::DescriptorSetPtr DescriptorSetCache::findHandle(
+    DescriptorSetReflectionPtr const& reflection, Core::BitHash const& contentHash) {
 
-    // Second case: we have no free handle. So we have to create a new one!
-    auto descriptorSet = cacheEntry->second.mPool->allocateDescriptorSet();
-    cacheEntry->second.mUsedHandels.insert(descriptorSet);
-    return descriptorSet;
+  auto cacheEntry = mCache.find(reflection->getHash());
+  if (cacheEntry == mCache.end()) {
+    return nullptr;
   }
 
-  // Last case: there is no pool at all! Create a new one!
-  CacheEntry entry;
-  entry.mPool = std::make_shared<DescriptorPool>(mDevice, reflection);
+  auto& entry = cacheEntry->second;
 
-  auto descriptorSet = entry.mPool->allocateDescriptorSet();
-  entry.mUsedHandels.insert(descriptorSet);
+  // content which has been written in this frame already
+  auto transient = entry.mTransientHandles.find(contentHash);
+  if (transient != entry.mTransientHandles.end()) {
+    return transient->second;
+  }
 
-  mCache.emplace(hash, entry);
+  auto written = entry.mWrittenHandles.find(contentHash);
+  if (written == entry.mWrittenHandles.end()) {
+    return nullptr;
+  }
 
-  return descriptorSet;
+  for (auto const& dependency : written->second.mDependencies) {
+    if (dependency.expired()) {
+      // The set may have been bound since the last releaseAll(), so it is not free before the next
+      // call to releaseAll().
+      entry.mRetiredHandles.push_back(written->second.mHandle);
+      entry.mWrittenHandles.erase(written);
+      return nullptr;
+    }
+  }
+
+  written->second.mLastUsed = mFrameIndex;
+  return written->second.mHandle;
 }
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////
 
-void DescriptorSetCache::releaseHandle(vk::DescriptorSetPtr const& handle) {
+vk::DescriptorSetPtr DescriptorSetCache::acquireHandle(DescriptorSetReflectionPtr const& reflection,
+    Core::BitHash const& contentHash, std::vector<std::weak_ptr<void>> const& dependencies) {
 
-  // Search the cache entry which created this handle
-  for (auto& p : mCache) {
-    auto it = p.second.mUsedHandels.find(handle);
+  auto& entry = getEntry(reflection);
 
-    // Once found, mark the handle as beeing free agin
-    if (it != p.second.mUsedHandels.end()) {
-      p.second.mUsedHandels.erase(it);
-      p.second.mFreeHandels.insert(handle);
-      return;
-    }
+  // Content which is requested for the first time is likely to be a one-off, so a transient set is
+  // used. When it is requested in a later frame again, it is stored in a persistent set.
+  if (entry.mSeenContents.find(contentHash) == entry.mSeenContents.end()) {
+    entry.mSeenContents[contentHash] = mFrameIndex;
+
+    auto descriptorSet                   = entry.mTransientPool->allocateDescriptorSet();
+    entry.mTransientHandles[contentHash] = descriptorSet;
+    return descriptorSet;
+  }
+
+  vk::DescriptorSetPtr descriptorSet;
+
+  if (entry.mFreeHandles.empty()) {
+    descriptorSet = entry.mPool->allocateDescriptorSet();
+  } else {
+    descriptorSet = entry.mFreeHandles.back();
+    entry.mFreeHandles.pop_back();
   }
 
-  throw std::runtime_error("Failed to release descriptor set from DescriptorSetCache: The given "
-                           "handle has not been released before or has never been created by this "
-                           "cache!");
+  entry.mWrittenHandles[contentHash] = {descriptorSet, dependencies, mFrameIndex};
+
+  return descriptorSet;
 }
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////
 
 void DescriptorSetCache::releaseAll() {
+  ++mFrameIndex;
+
   for (auto& p : mCache) {
-    p.second.mFreeHandels.insert(p.second.mUsedHandels.begin(), p.second.mUsedHandels.end());
-    p.second.mUsedHandels.clear();
+    auto& entry = p.second;
+
+    entry.mTransientHandles.clear();
+    entry.mTransientPool->reset();
+
+    entry.mFreeHandles.insert(
+        entry.mFreeHandles.end(), entry.mRetiredHandles.begin(), entry.mRetiredHandles.end());
+    entry.mRetiredHandles.clear();
+
+    for (auto it = entry.mWrittenHandles.begin(); it != entry.mWrittenHandles.end();) {
+      bool expired = mFrameIndex - it->second.mLastUsed > MAX_UNUSED_FRAMES;
+      for (auto const& dependency : it->second.mDependencies) {
+        expired |= dependency.expired();
+      }
+
+      if (expired) {
+        entry.mFreeHandles.push_back(it->second.mHandle);
+        it = entry.mWrittenHandles.erase(it);
+      } else {
+        ++it;
+      }
+    }
+
+    for (auto it = entry.mSeenContents.begin(); it != entry.mSeenContents.end();) {
+      if (mFrameIndex - it->second > MAX_UNUSED_FRAMES) {
+        it = entry.mSeenContents.erase(it);
+      } else {
+        ++it;
+      }
+    }
   }
 }
 
@@ -98,4 +152,19 @@ void DescriptorSetCache::deleteAll() {
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////
 
+DescriptorSetCache::CacheEntry& DescriptorSetCache::getEntry(
+    DescriptorSetReflectionPtr const& reflection) {
+
+  auto& entry = mCache[reflection->getHash()];
+
+  if (!entry.mPool) {
+    entry.mPool          = DescriptorPool::create(mDevice, reflection);
+    entry.mTransientPool = DescriptorPool::create(mDevice, reflection, true);
+  }
+
+  return entry;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
 } // namespace Illusion::Graphics
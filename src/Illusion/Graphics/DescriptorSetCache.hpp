@@ -12,7 +12,7 @@
 #include "../Core/BitHash.hpp"
 #include "DescriptorSetReflection.hpp"
 
-#include <map>
+#include <unordered_map>
 
 namespace Illusion::Graphics {
 
@@ -20,6 +20,14 @@ namespace Illusion::Graphics {
 // The DescriptorSetCache can be used to avoid frequent recreation of similar DescriptorSets. It  //
 // also simplifies the vk::DescriptorSet management if multiple pipelines use the same            //
 // DescriptorSetLayouts. It is used by the CommandBuffer class.                                   //
+// vk::DescriptorSets are cached based on their content. A set acquired with a content hash is    //
+// never handed out for other content; findHandle() returns it whenever the same bindings are     //
+// requested again so that it does not need to be written once more.                              //
+// Content which is requested for the first time is written to a transient set. These are taken   //
+// from per-frame pools which are reset with vkResetDescriptorPool in releaseAll(). Only content  //
+// which is requested again in a later frame is promoted to a persistent set. Persistent sets are //
+// recycled via a free-list when they have not been used for several frames or when one of the    //
+// bound resources has been destroyed. Hence, there are no allocations in steady state.           //
 ////////////////////////////////////////////////////////////////////////////////////////////////////
 
 class DescriptorSetCache {
@@ -27,19 +35,26 @@ class DescriptorSetCache {
   DescriptorSetCache(DevicePtr const& device);
   virtual ~DescriptorSetCache();
 
-  // A reference to the acquired vk::DescriptorSet is also stored in the internal cache of this
-  // object. Therefore it will not be deleted, even if the returned handle goes out of scope. A hash
-  // based on the reflection will be used to store the handle.
+  // Returns a transient vk::DescriptorSet which is valid until the next call to releaseAll(). A
+  // reference to the vk::DescriptorPool is held by the handle.
   vk::DescriptorSetPtr acquireHandle(DescriptorSetReflectionPtr const& reflection);
 
-  // This should only be used with handles created by the method above. The passed in handle is
-  // marked as not being used anymore and will be returned by subsequent calls to acquireHandle()
-  // if the construction parameters are the same. This will not delete the allocated
-  // vk::DescriptorSet.
-  void releaseHandle(vk::DescriptorSetPtr const& handle);
+  // Returns a vk::DescriptorSet which has been acquired with the method below for the same
+  // contentHash before. If there is none, or if one of its dependencies has been destroyed in the
+  // meantime, nullptr is returned.
+  vk::DescriptorSetPtr findHandle(
+      DescriptorSetReflectionPtr const& reflection, Core::BitHash const& contentHash);
 
-  // Calls releaseHandle() for all DescriptorSets which have been created by this
-  // DescriptorSetCache.
+  // Acquires an unused vk::DescriptorSet for the given contentHash. The caller has to write the
+  // set; afterwards it must not be modified anymore. The dependencies should reference all
+  // resources which are written to the set. If the content has not been requested in a previous
+  // frame, a transient set is returned.
+  vk::DescriptorSetPtr acquireHandle(DescriptorSetReflectionPtr const& reflection,
+      Core::BitHash const& contentHash, std::vector<std::weak_ptr<void>> const& dependencies);
+
+  // Marks the beginning of a new frame. All transient sets are returned to their pools and
+  // persistent sets which have not been used recently are recycled. This must only be called when
+  // none of the sets is in use anymore.
   void releaseAll();
 
   // Clears all references to DescriptorSets created by this DescriptorSetCache. This will cause the
@@ -47,14 +62,33 @@ class DescriptorSetCache {
   void deleteAll();
 
  private:
+  struct WrittenHandle {
+    vk::DescriptorSetPtr             mHandle;
+    std::vector<std::weak_ptr<void>> mDependencies;
+    uint32_t                         mLastUsed;
+  };
+
   struct CacheEntry {
-    DescriptorPoolPtr              mPool;
-    std::set<vk::DescriptorSetPtr> mUsedHandels;
-    std::set<vk::DescriptorSetPtr> mFreeHandels;
+    DescriptorPoolPtr mPool;
+    DescriptorPoolPtr mTransientPool;
+
+    // Content-cached sets. Transient ones are forgotten in releaseAll().
+    std::unordered_map<Core::BitHash, WrittenHandle>        mWrittenHandles;
+    std::unordered_map<Core::BitHash, vk::DescriptorSetPtr> mTransientHandles;
+
+    // The frame index of content which has been written to a transient set.
+    std::unordered_map<Core::BitHash, uint32_t> mSeenContents;
+
+    // Persistent sets which can be re-used and sets which become free in the next frame.
+    std::vector<vk::DescriptorSetPtr> mFreeHandles;
+    std::vector<vk::DescriptorSetPtr> mRetiredHandles;
   };
 
-  DevicePtr                                   mDevice;
-  mutable std::map<Core::BitHash, CacheEntry> mCache;
+  CacheEntry& getEntry(DescriptorSetReflectionPtr const& reflection);
+
+  DevicePtr                                     mDevice;
+  std::unordered_map<Core::BitHash, CacheEntry> mCache;
+  uint32_t                                      mFrameIndex = 0;
 };
 
 } // namespace Illusion::Graphics
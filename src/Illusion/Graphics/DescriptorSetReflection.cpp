@@ -9,7 +9,9 @@
 #include "DescriptorSetReflection.hpp"
 
 #include "../Core/Logger.hpp"
+#include "BindlessDescriptorSet.hpp"
 #include "Device.hpp"
+#include "PhysicalDevice.hpp"
 
 #include <functional>
 #include <iostream>
@@ -33,6 +35,8 @@ const std::unordered_map<PipelineResource::ResourceType, vk::DescriptorType> res
     {PipelineResource::ResourceType::eUniformBufferDynamic,
         vk::DescriptorType::eUniformBufferDynamic},
     {PipelineResource::ResourceType::eUniformTexelBuffer, vk::DescriptorType::eUniformTexelBuffer},
+    {PipelineResource::ResourceType::eAccelerationStructure,
+        vk::DescriptorType::eAccelerationStructureKHR},
 };
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -76,6 +80,10 @@ void DescriptorSetReflection::addResource(PipelineResource const& resource) {
   } else {
     mResources[resource.mName] = resource;
   }
+
+  if (resource.mBinding < 32) {
+    mBindingMask |= 1u << resource.mBinding;
+  }
 }
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -102,13 +110,86 @@ std::map<std::string, PipelineResource> DescriptorSetReflection::getResources(
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////
 
+uint32_t DescriptorSetReflection::getBindingMask() const {
+  return mBindingMask;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
 uint32_t DescriptorSetReflection::getSet() const {
   return mSet;
 }
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////
 
+bool DescriptorSetReflection::isBindless() const {
+  for (auto const& r : mResources) {
+    if (r.second.mArraySize == 0) {
+      return true;
+    }
+  }
+
+  return false;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void DescriptorSetReflection::setPushDescriptor(bool enable) {
+  if (enable == mPushDescriptor) {
+    return;
+  }
+
+  if (enable) {
+    std::string error = "Failed to use push descriptors for set " + std::to_string(mSet) + ": ";
+
+    if (!mDevice->getPushDescriptorSetFunction()) {
+      throw std::runtime_error(error + "VK_KHR_push_descriptor is not supported!");
+    }
+
+    if (isBindless()) {
+      throw std::runtime_error(error + "The set contains runtime arrays!");
+    }
+
+    uint32_t descriptorCount = 0;
+
+    for (auto const& r : mResources) {
+      if (r.second.mResourceType == PipelineResource::ResourceType::eUniformBufferDynamic ||
+          r.second.mResourceType == PipelineResource::ResourceType::eStorageBufferDynamic) {
+        throw std::runtime_error(error + "The set contains dynamic buffers!");
+      }
+      descriptorCount += r.second.mArraySize;
+    }
+
+    auto const& properties = mDevice->getPhysicalDevice()->getPushDescriptorProperties();
+    if (descriptorCount > properties.maxPushDescriptors) {
+      throw std::runtime_error(error + "The set contains more than " +
+                               std::to_string(properties.maxPushDescriptors) + " descriptors!");
+    }
+  }
+
+  mPushDescriptor = enable;
+  mLayout.reset();
+  mHash.clear();
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+bool DescriptorSetReflection::isPushDescriptor() const {
+  return mPushDescriptor;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
 vk::DescriptorSetLayoutPtr DescriptorSetReflection::getLayout() const {
+  if (!mLayout && isBindless()) {
+    if (!mDevice->getBindlessDescriptorSet()) {
+      throw std::runtime_error("Failed to create DescriptorSetLayout: Set " + std::to_string(mSet) +
+                               " contains runtime arrays but bindless mode is not enabled!");
+    }
+
+    mLayout = mDevice->getBindlessDescriptorSet()->getLayout();
+  }
+
   if (!mLayout) {
 
     std::vector<vk::DescriptorSetLayoutBinding> bindings;
@@ -123,7 +204,11 @@ vk::DescriptorSetLayoutPtr DescriptorSetReflection::getLayout() const {
     descriptorSetLayoutInfo.bindingCount = static_cast<uint32_t>(bindings.size());
     descriptorSetLayoutInfo.pBindings    = bindings.data();
 
-    mLayout = mDevice->createDescriptorSetLayout(descriptorSetLayoutInfo);
+    if (mPushDescriptor) {
+      descriptorSetLayoutInfo.flags = vk::DescriptorSetLayoutCreateFlagBits::ePushDescriptorKHR;
+    }
+
+    mLayout = mDevice->getDescriptorSetLayout(getHash(), descriptorSetLayoutInfo);
   }
 
   return mLayout;
@@ -155,6 +240,7 @@ void DescriptorSetReflection::printInfo() const {
       {PipelineResource::ResourceType::eStorageBufferDynamic, "storage_buffer_dynamic"},
       {PipelineResource::ResourceType::eInputAttachment, "input_attachment"},
       {PipelineResource::ResourceType::ePushConstantBuffer, "push_constant_buffer"},
+      {PipelineResource::ResourceType::eAccelerationStructure, "acceleration_structure"},
       {PipelineResource::ResourceType::eNone, "none"}};
 
   std::function<void(PipelineResource::Member const&, int)> printMemberInfo =
@@ -188,6 +274,7 @@ void DescriptorSetReflection::printInfo() const {
 Core::BitHash const& DescriptorSetReflection::getHash() const {
   if (mHash.size() == 0) {
     mHash.push<16>(mSet);
+    mHash.push<1>(mPushDescriptor);
 
     for (auto const& r : mResources) {
       mHash.push<6>(r.second.mStages);
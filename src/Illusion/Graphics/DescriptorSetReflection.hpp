@@ -52,12 +52,31 @@ class DescriptorSetReflection {
   // maps could be considered an improvement.
   std::map<std::string, PipelineResource> getResources(PipelineResource::ResourceType type) const;
 
+  // Returns a bit mask where bit i is set if there is a resource with binding number i. Binding
+  // numbers of 32 and above are not included, they cannot be set in the BindingState anyway.
+  uint32_t getBindingMask() const;
+
   // Returns the set number all resources belong to. This has been given to this
   // DescriptorSetReflection in the constructor.
   uint32_t getSet() const;
 
-  // Creates a vk::DescriptorSetLayout for this reflection. It is created lazily; the first call to
-  // this method will cause the allocation.
+  // Returns true if any of the resources is a runtime array. Such sets use the layout of the
+  // BindlessDescriptorSet of the Device.
+  bool isBindless() const;
+
+  // Push descriptor sets are not allocated from a DescriptorPool; the CommandBuffer records their
+  // descriptors directly with vkCmdPushDescriptorSetKHR instead. Enabling this throws a
+  // std::runtime_error if VK_KHR_push_descriptor is not supported or if the set is bindless,
+  // contains dynamic buffers or more descriptors than maxPushDescriptors. Only one set of a
+  // PipelineReflection may be a push descriptor set, see
+  // PipelineReflection::setPushDescriptorSet().
+  void setPushDescriptor(bool enable);
+  bool isPushDescriptor() const;
+
+  // Returns a vk::DescriptorSetLayout for this reflection. It is retrieved lazily from the layout
+  // cache of the Device (see Device::getDescriptorSetLayout()), hence all reflections with the same
+  // hash share one handle. For bindless sets, the layout of the BindlessDescriptorSet is returned;
+  // an exception is thrown if the Device has no bindless mode.
   vk::DescriptorSetLayoutPtr getLayout() const;
 
   // Prints some reflection information to std::cout for debugging purposes.
@@ -72,6 +91,8 @@ class DescriptorSetReflection {
   DevicePtr                               mDevice;
   std::map<std::string, PipelineResource> mResources;
   uint32_t                                mSet;
+  uint32_t                                mBindingMask    = 0;
+  bool                                    mPushDescriptor = false;
   mutable vk::DescriptorSetLayoutPtr      mLayout;
   mutable Core::BitHash                   mHash;
 };
@@ -10,42 +10,174 @@
 
 #include "../Core/EnumCast.hpp"
 #include "../Core/Logger.hpp"
+#include "AccelerationStructure.hpp"
 #include "BackedBuffer.hpp"
 #include "BackedImage.hpp"
+#include "BindlessDescriptorSet.hpp"
 #include "CommandBuffer.hpp"
+#include "DeletionQueue.hpp"
+#include "FrameStatistics.hpp"
+#include "GeometryArena.hpp"
+#include "MemoryAllocator.hpp"
 #include "PhysicalDevice.hpp"
+#include "PipelineCache.hpp"
 #include "PipelineResource.hpp"
+#include "QueuePool.hpp"
+#include "RenderTargetPool.hpp"
+#include "SubmissionBatcher.hpp"
 #include "Texture.hpp"
-#include "Utils.hpp"
+#include "UploadManager.hpp"
 #include "VulkanPtr.hpp"
 
+#include <algorithm>
 #include <iostream>
-#include <set>
 
 namespace Illusion::Graphics {
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////
 
 namespace {
-const std::vector<const char*> DEVICE_EXTENSIONS{VK_KHR_SWAPCHAIN_EXTENSION_NAME};
+
+MemoryCategory getMemoryCategory(vk::ImageUsageFlags usage) {
+  if (usage & (vk::ImageUsageFlagBits::eColorAttachment |
+                  vk::ImageUsageFlagBits::eDepthStencilAttachment |
+                  vk::ImageUsageFlagBits::eTransientAttachment)) {
+    return MemoryCategory::eRenderTarget;
+  }
+
+  return MemoryCategory::eTexture;
+}
+
+MemoryCategory getMemoryCategory(vk::BufferUsageFlags usage) {
+  if (usage & (vk::BufferUsageFlagBits::eVertexBuffer | vk::BufferUsageFlagBits::eIndexBuffer |
+                  vk::BufferUsageFlagBits::eAccelerationStructureStorageKHR)) {
+    return MemoryCategory::eGeometry;
+  }
+
+  if (usage == vk::BufferUsageFlagBits::eTransferSrc) {
+    return MemoryCategory::eStaging;
+  }
+
+  return MemoryCategory::eOther;
+}
+
+vk::PhysicalDeviceFeatures chooseFeatures(PhysicalDevicePtr const& physicalDevice) {
+  auto supported = physicalDevice->getFeatures();
+
+  vk::PhysicalDeviceFeatures features;
+  features.samplerAnisotropy         = true;
+  features.multiDrawIndirect         = supported.multiDrawIndirect;
+  features.drawIndirectFirstInstance = supported.drawIndirectFirstInstance;
+
+  // compressed Textures are only loaded in formats which are supported
+  features.textureCompressionBC       = supported.textureCompressionBC;
+  features.textureCompressionETC2     = supported.textureCompressionETC2;
+  features.textureCompressionASTC_LDR = supported.textureCompressionASTC_LDR;
+
+  // the MipmapGenerator can write to these formats if they are supported
+  features.shaderStorageImageExtendedFormats = supported.shaderStorageImageExtendedFormats;
+
+  // used by the PassStatistics; inheritedQueries allows queries around secondary CommandBuffers
+  features.pipelineStatisticsQuery = supported.pipelineStatisticsQuery;
+  features.occlusionQueryPrecise   = supported.occlusionQueryPrecise;
+  features.inheritedQueries        = supported.inheritedQueries;
+
+  // the Gltf::ShadowMap selects the layer of its cascades in a geometry shader
+  features.geometryShader = supported.geometryShader;
+
+  return features;
+}
 }
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////
 
-Device::Device(PhysicalDevicePtr const& physicalDevice)
+Device::Device(PhysicalDevicePtr const& physicalDevice, std::string const& pipelineCacheFile,
+    bool enableBindless)
     : mPhysicalDevice(physicalDevice)
-    , mDevice(createDevice()) {
+    , mBindlessEnabled(enableBindless)
+    , mEnabledFeatures(chooseFeatures(physicalDevice))
+    , mDevice(createDevice())
+    , mQueuePool(QueuePool::create(mDevice, mPhysicalDevice))
+    , mDeletionQueue(DeletionQueue::create())
+    , mMemoryAllocator(MemoryAllocator::create(mDevice, mPhysicalDevice, mDeletionQueue))
+    , mFrameStatistics(FrameStatistics::create()) {
 
   ILLUSION_TRACE << "Creating Device." << std::endl;
 
-  for (size_t i(0); i < 3; ++i) {
-    QueueType type = static_cast<QueueType>(i);
-    mQueues[i]     = mDevice->getQueue(mPhysicalDevice->getQueueFamily(type), 0);
+  for (auto type : {QueueType::eGeneric, QueueType::eCompute, QueueType::eTransfer}) {
+    uint32_t family = mPhysicalDevice->getQueueFamily(type);
+    if (std::find(mQueueFamilies.begin(), mQueueFamilies.end(), family) == mQueueFamilies.end()) {
+      mQueueFamilies.push_back(family);
+    }
+  }
 
-    vk::CommandPoolCreateInfo info;
-    info.queueFamilyIndex = mPhysicalDevice->getQueueFamily(type);
-    info.flags            = vk::CommandPoolCreateFlagBits::eResetCommandBuffer;
-    mCommandPools[i]      = createCommandPool(info);
+  if (mPhysicalDevice->supportsDrawIndirectCount()) {
+    mDrawIndexedIndirectCount = (PFN_vkCmdDrawIndexedIndirectCountKHR)mDevice->getProcAddr(
+        "vkCmdDrawIndexedIndirectCountKHR");
+  }
+
+  if (mPhysicalDevice->supportsPushDescriptors()) {
+    mPushDescriptorSet =
+        (PFN_vkCmdPushDescriptorSetKHR)mDevice->getProcAddr("vkCmdPushDescriptorSetKHR");
+  }
+
+  if (mPhysicalDevice->supportsDynamicRendering()) {
+    mBeginRendering = (PFN_vkCmdBeginRenderingKHR)mDevice->getProcAddr("vkCmdBeginRenderingKHR");
+    mEndRendering   = (PFN_vkCmdEndRenderingKHR)mDevice->getProcAddr("vkCmdEndRenderingKHR");
+  }
+
+  if (mPhysicalDevice->supportsMeshShaders()) {
+    mDrawMeshTasks = (PFN_vkCmdDrawMeshTasksEXT)mDevice->getProcAddr("vkCmdDrawMeshTasksEXT");
+  }
+
+  if (mPhysicalDevice->supportsExternalMemoryHost()) {
+    mGetMemoryHostPointerProperties = (PFN_vkGetMemoryHostPointerPropertiesEXT)mDevice->getProcAddr(
+        "vkGetMemoryHostPointerPropertiesEXT");
+  }
+
+  if (mPhysicalDevice->supportsExtendedDynamicState()) {
+    auto& f        = mExtendedDynamicState;
+    f.mSetCullMode = (PFN_vkCmdSetCullModeEXT)mDevice->getProcAddr("vkCmdSetCullModeEXT");
+    f.mSetFrontFace =
+        (PFN_vkCmdSetFrontFaceEXT)mDevice->getProcAddr("vkCmdSetFrontFaceEXT");
+    f.mSetPrimitiveTopology = (PFN_vkCmdSetPrimitiveTopologyEXT)mDevice->getProcAddr(
+        "vkCmdSetPrimitiveTopologyEXT");
+    f.mSetDepthTestEnable =
+        (PFN_vkCmdSetDepthTestEnableEXT)mDevice->getProcAddr("vkCmdSetDepthTestEnableEXT");
+    f.mSetDepthWriteEnable =
+        (PFN_vkCmdSetDepthWriteEnableEXT)mDevice->getProcAddr("vkCmdSetDepthWriteEnableEXT");
+    f.mSetDepthCompareOp =
+        (PFN_vkCmdSetDepthCompareOpEXT)mDevice->getProcAddr("vkCmdSetDepthCompareOpEXT");
+  }
+
+  if (mPhysicalDevice->supportsRayQueries()) {
+    auto& f   = mAccelerationStructure;
+    f.mCreate = (PFN_vkCreateAccelerationStructureKHR)mDevice->getProcAddr(
+        "vkCreateAccelerationStructureKHR");
+    f.mDestroy = (PFN_vkDestroyAccelerationStructureKHR)mDevice->getProcAddr(
+        "vkDestroyAccelerationStructureKHR");
+    f.mGetBuildSizes = (PFN_vkGetAccelerationStructureBuildSizesKHR)mDevice->getProcAddr(
+        "vkGetAccelerationStructureBuildSizesKHR");
+    f.mGetDeviceAddress = (PFN_vkGetAccelerationStructureDeviceAddressKHR)mDevice->getProcAddr(
+        "vkGetAccelerationStructureDeviceAddressKHR");
+    f.mCmdBuild = (PFN_vkCmdBuildAccelerationStructuresKHR)mDevice->getProcAddr(
+        "vkCmdBuildAccelerationStructuresKHR");
+    f.mCmdCopy = (PFN_vkCmdCopyAccelerationStructureKHR)mDevice->getProcAddr(
+        "vkCmdCopyAccelerationStructureKHR");
+    f.mCmdWriteProperties =
+        (PFN_vkCmdWriteAccelerationStructuresPropertiesKHR)mDevice->getProcAddr(
+            "vkCmdWriteAccelerationStructuresPropertiesKHR");
+    f.mGetBufferDeviceAddress =
+        (PFN_vkGetBufferDeviceAddressKHR)mDevice->getProcAddr("vkGetBufferDeviceAddressKHR");
+  }
+
+  mUploadManager     = UploadManager::create(this);
+  mSubmissionBatcher = SubmissionBatcher::create(this);
+  mRenderTargetPool  = RenderTargetPool::create(this);
+  mPipelineCache     = PipelineCache::create(this, pipelineCacheFile);
+
+  if (mBindlessEnabled) {
+    mBindlessDescriptorSet = BindlessDescriptorSet::create(this);
   }
 }
 
@@ -53,6 +185,13 @@ Device::Device(PhysicalDevicePtr const& physicalDevice)
 
 Device::~Device() {
   ILLUSION_TRACE << "Deleting Device." << std::endl;
+
+  // All objects which are released from now on are destroyed immediately.
+  {
+    auto queueLocks = mQueuePool->lockAll();
+    mDevice->waitIdle();
+  }
+  mDeletionQueue->disable();
 }
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -73,14 +212,24 @@ BackedImagePtr Device::createBackedImage(vk::ImageCreateInfo imageInfo, vk::Imag
   result->mImage         = createImage(imageInfo);
   result->mCurrentLayout = imageInfo.initialLayout;
 
-  // create memory
+  // allocate memory
   auto requirements = mDevice->getImageMemoryRequirements(*result->mImage);
 
-  result->mMemoryInfo.allocationSize = requirements.size;
-  result->mMemoryInfo.memoryTypeIndex =
-      mPhysicalDevice->findMemoryType(requirements.memoryTypeBits, properties);
-  result->mMemory = createMemory(result->mMemoryInfo);
-  mDevice->bindImageMemory(*result->mImage, *result->mMemory, 0);
+  // Lazily allocated memory is mostly available on tiled GPUs; elsewhere, transient attachments use
+  // ordinary device-local memory.
+  if ((properties & vk::MemoryPropertyFlagBits::eLazilyAllocated) &&
+      !mPhysicalDevice->hasMemoryType(requirements.memoryTypeBits, properties)) {
+    properties &= ~vk::MemoryPropertyFlags(vk::MemoryPropertyFlagBits::eLazilyAllocated);
+  }
+
+  auto allocation   = mMemoryAllocator->allocate(requirements, properties,
+      imageInfo.tiling == vk::ImageTiling::eLinear, getMemoryCategory(imageInfo.usage));
+
+  result->mMemoryInfo.allocationSize  = allocation.mSize;
+  result->mMemoryInfo.memoryTypeIndex = allocation.mMemoryType;
+  result->mMemory                     = allocation.mMemory;
+  result->mMemoryOffset               = allocation.mOffset;
+  mDevice->bindImageMemory(*result->mImage, *result->mMemory, result->mMemoryOffset);
 
   // create image view
   result->mViewInfo.image                           = *result->mImage;
@@ -95,106 +244,13 @@ BackedImagePtr Device::createBackedImage(vk::ImageCreateInfo imageInfo, vk::Imag
 
   result->mView = createImageView(result->mViewInfo);
 
+  // Both, the upload and the layout transition, are recorded by the UploadManager; this does not
+  // block.
   if (data) {
-    auto cmd = allocateCommandBuffer();
-    cmd->begin({vk::CommandBufferUsageFlagBits::eOneTimeSubmit});
-
-    auto stagingBuffer = createBackedBuffer(vk::BufferUsageFlagBits::eTransferSrc,
-        vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent,
-        dataSize, data);
-
-    vk::ImageMemoryBarrier barrier;
-    barrier.srcQueueFamilyIndex         = VK_QUEUE_FAMILY_IGNORED;
-    barrier.dstQueueFamilyIndex         = VK_QUEUE_FAMILY_IGNORED;
-    barrier.image                       = *result->mImage;
-    barrier.subresourceRange.levelCount = imageInfo.mipLevels;
-    barrier.subresourceRange.layerCount = imageInfo.arrayLayers;
-    barrier.subresourceRange.aspectMask = imageAspectMask;
-    barrier.oldLayout                   = result->mCurrentLayout;
-    barrier.newLayout                   = vk::ImageLayout::eTransferDstOptimal;
-
-    cmd->pipelineBarrier(vk::PipelineStageFlagBits::eTransfer, vk::PipelineStageFlagBits::eTransfer,
-        vk::DependencyFlagBits(), nullptr, nullptr, barrier);
-
-    std::vector<vk::BufferImageCopy> infos;
-    uint64_t                         offset    = 0;
-    uint32_t                         mipWidth  = imageInfo.extent.width;
-    uint32_t                         mipHeight = imageInfo.extent.height;
-
-    for (uint32_t i = 0; i < imageInfo.mipLevels; ++i) {
-      uint64_t size = mipWidth * mipHeight * Utils::getByteCount(imageInfo.format);
-
-      if (offset + size > dataSize) {
-        break;
-      }
-
-      vk::BufferImageCopy info;
-      info.imageSubresource.aspectMask     = imageAspectMask;
-      info.imageSubresource.mipLevel       = i;
-      info.imageSubresource.baseArrayLayer = 0;
-      info.imageSubresource.layerCount     = imageInfo.arrayLayers;
-      info.imageExtent.width               = mipWidth;
-      info.imageExtent.height              = mipHeight;
-      info.imageExtent.depth               = 1;
-      info.bufferOffset                    = offset;
-
-      infos.push_back(info);
-
-      offset += size;
-      mipWidth  = std::max(mipWidth / 2, 1u);
-      mipHeight = std::max(mipHeight / 2, 1u);
-    }
-
-    cmd->copyBufferToImage(
-        *stagingBuffer->mBuffer, *result->mImage, vk::ImageLayout::eTransferDstOptimal, infos);
-
-    barrier.oldLayout = vk::ImageLayout::eTransferDstOptimal;
-    barrier.newLayout = layout;
-
-    cmd->pipelineBarrier(vk::PipelineStageFlagBits::eTransfer, vk::PipelineStageFlagBits::eTransfer,
-        vk::DependencyFlagBits(), nullptr, nullptr, barrier);
-
-    result->mCurrentLayout = layout;
-
-    cmd->end();
-
-    vk::CommandBuffer bufs[] = {*cmd};
-    vk::SubmitInfo    info;
-    info.commandBufferCount = 1;
-    info.pCommandBuffers    = bufs;
-
-    getQueue(QueueType::eGeneric).submit(info, nullptr);
-    getQueue(QueueType::eGeneric).waitIdle();
-
+    result->mUploadTicket =
+        mUploadManager->uploadToImage(result, imageAspectMask, layout, dataSize, data);
   } else {
-
-    auto cmd = allocateCommandBuffer();
-    cmd->begin({vk::CommandBufferUsageFlagBits::eOneTimeSubmit});
-
-    vk::ImageMemoryBarrier barrier;
-    barrier.srcQueueFamilyIndex         = VK_QUEUE_FAMILY_IGNORED;
-    barrier.dstQueueFamilyIndex         = VK_QUEUE_FAMILY_IGNORED;
-    barrier.image                       = *result->mImage;
-    barrier.subresourceRange.levelCount = imageInfo.mipLevels;
-    barrier.subresourceRange.layerCount = imageInfo.arrayLayers;
-    barrier.subresourceRange.aspectMask = imageAspectMask;
-    barrier.oldLayout                   = result->mCurrentLayout;
-    barrier.newLayout                   = layout;
-
-    cmd->pipelineBarrier(vk::PipelineStageFlagBits::eTransfer, vk::PipelineStageFlagBits::eTransfer,
-        vk::DependencyFlagBits(), nullptr, nullptr, barrier);
-
-    result->mCurrentLayout = layout;
-
-    cmd->end();
-
-    vk::CommandBuffer bufs[] = {*cmd};
-    vk::SubmitInfo    info;
-    info.commandBufferCount = 1;
-    info.pCommandBuffers    = bufs;
-
-    getQueue(QueueType::eGeneric).submit(info, nullptr);
-    getQueue(QueueType::eGeneric).waitIdle();
+    result->mUploadTicket = mUploadManager->transitionImage(result, imageAspectMask, layout);
   }
 
   return result;
@@ -203,7 +259,8 @@ BackedImagePtr Device::createBackedImage(vk::ImageCreateInfo imageInfo, vk::Imag
 ////////////////////////////////////////////////////////////////////////////////////////////////////
 
 BackedBufferPtr Device::createBackedBuffer(vk::BufferUsageFlags usage,
-    vk::MemoryPropertyFlags properties, vk::DeviceSize dataSize, const void* data) const {
+    vk::MemoryPropertyFlags properties, vk::DeviceSize dataSize, const void* data,
+    vk::SharingMode sharingMode) const {
 
   auto result = std::make_shared<BackedBuffer>();
 
@@ -211,6 +268,13 @@ BackedBufferPtr Device::createBackedBuffer(vk::BufferUsageFlags usage,
   result->mBufferInfo.usage       = usage;
   result->mBufferInfo.sharingMode = vk::SharingMode::eExclusive;
 
+  // concurrent sharing requires at least two distinct queue families
+  if (sharingMode == vk::SharingMode::eConcurrent && mQueueFamilies.size() > 1) {
+    result->mBufferInfo.sharingMode           = vk::SharingMode::eConcurrent;
+    result->mBufferInfo.queueFamilyIndexCount = static_cast<uint32_t>(mQueueFamilies.size());
+    result->mBufferInfo.pQueueFamilyIndices   = mQueueFamilies.data();
+  }
+
   // if data upload will use a staging buffer, we need to make sure transferDst is set!
   if (data && (!(properties & vk::MemoryPropertyFlagBits::eHostVisible) ||
                   !(properties & vk::MemoryPropertyFlagBits::eHostCoherent))) {
@@ -220,14 +284,16 @@ BackedBufferPtr Device::createBackedBuffer(vk::BufferUsageFlags usage,
   result->mBuffer = createBuffer(result->mBufferInfo);
 
   auto requirements = mDevice->getBufferMemoryRequirements(*result->mBuffer);
+  auto allocation   = mMemoryAllocator->allocate(
+      requirements, properties, true, getMemoryCategory(result->mBufferInfo.usage));
 
-  result->mMemoryInfo.allocationSize = requirements.size;
-  result->mMemoryInfo.memoryTypeIndex =
-      mPhysicalDevice->findMemoryType(requirements.memoryTypeBits, properties);
-
-  result->mMemory = createMemory(result->mMemoryInfo);
+  result->mMemoryInfo.allocationSize  = allocation.mSize;
+  result->mMemoryInfo.memoryTypeIndex = allocation.mMemoryType;
+  result->mMemory                     = allocation.mMemory;
+  result->mMemoryOffset               = allocation.mOffset;
+  result->mMappedData                 = allocation.mMappedData;
 
-  mDevice->bindBufferMemory(*result->mBuffer, *result->mMemory, 0);
+  mDevice->bindBufferMemory(*result->mBuffer, *result->mMemory, result->mMemoryOffset);
 
   if (data) {
     // data was provided, we need to upload it!
@@ -235,34 +301,95 @@ BackedBufferPtr Device::createBackedBuffer(vk::BufferUsageFlags usage,
         (properties & vk::MemoryPropertyFlagBits::eHostCoherent)) {
 
       // simple case - memory is host visible and coherent;
-      // we can simply map it and upload the data
-      void* dst = mDevice->mapMemory(*result->mMemory, 0, dataSize);
-      std::memcpy(dst, data, dataSize);
-      mDevice->unmapMemory(*result->mMemory);
+      // it is persistently mapped so we can simply upload the data
+      std::memcpy(result->mMappedData, data, dataSize);
+      mFrameStatistics->add(&FrameStatistics::Counters::mUploadedBytes, dataSize);
     } else {
 
-      // more difficult case, we need a staging buffer!
-      auto stagingBuffer = createBackedBuffer(vk::BufferUsageFlagBits::eTransferSrc,
-          vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent,
-          dataSize, data);
-
-      auto cmd = allocateCommandBuffer();
-      cmd->begin({vk::CommandBufferUsageFlagBits::eOneTimeSubmit});
-      vk::BufferCopy region;
-      region.size = dataSize;
-      cmd->copyBuffer(*stagingBuffer->mBuffer, *result->mBuffer, 1, &region);
-      cmd->end();
-
-      vk::CommandBuffer bufs[] = {*cmd};
-      vk::SubmitInfo    info;
-      info.commandBufferCount = 1;
-      info.pCommandBuffers    = bufs;
-
-      getQueue(QueueType::eGeneric).submit(info, nullptr);
-      getQueue(QueueType::eGeneric).waitIdle();
+      // more difficult case, the UploadManager will use a staging buffer and a transfer queue
+      result->mUploadTicket = mUploadManager->uploadToBuffer(result, dataSize, data);
     }
   }
 
+  if (mBindlessDescriptorSet && (usage & vk::BufferUsageFlagBits::eStorageBuffer)) {
+    mBindlessDescriptorSet->addStorageBuffer(result);
+  }
+
+  return result;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+BackedBufferPtr Device::importHostBuffer(
+    vk::BufferUsageFlags usage, vk::DeviceSize size, void* hostPointer) const {
+
+  if (!mGetMemoryHostPointerProperties) {
+    throw std::runtime_error(
+        "Failed to import host memory: VK_EXT_external_memory_host is not supported!");
+  }
+
+  vk::DeviceSize alignment =
+      mPhysicalDevice->getExternalMemoryHostProperties().minImportedHostPointerAlignment;
+
+  if (reinterpret_cast<uintptr_t>(hostPointer) % alignment != 0 || size % alignment != 0) {
+    throw std::runtime_error("Failed to import host memory: Pointer and size have to be " +
+                             std::to_string(alignment) + "-byte aligned!");
+  }
+
+  auto handleType = vk::ExternalMemoryHandleTypeFlagBits::eHostAllocationEXT;
+
+  vk::MemoryHostPointerPropertiesEXT pointerProperties;
+
+  if (mGetMemoryHostPointerProperties(*mDevice,
+          static_cast<VkExternalMemoryHandleTypeFlagBits>(handleType), hostPointer,
+          reinterpret_cast<VkMemoryHostPointerPropertiesEXT*>(&pointerProperties)) != VK_SUCCESS) {
+    throw std::runtime_error("Failed to import host memory: The pointer cannot be imported!");
+  }
+
+  auto result = std::make_shared<BackedBuffer>();
+
+  // The vk::ExternalMemoryBufferCreateInfo is only referenced during creation.
+  vk::ExternalMemoryBufferCreateInfo externalInfo;
+  externalInfo.handleTypes = handleType;
+
+  result->mBufferInfo.size        = size;
+  result->mBufferInfo.usage       = usage;
+  result->mBufferInfo.sharingMode = vk::SharingMode::eExclusive;
+  result->mBufferInfo.pNext       = &externalInfo;
+
+  result->mBuffer           = createBuffer(result->mBufferInfo);
+  result->mBufferInfo.pNext = nullptr;
+
+  // The memory is written by the CPU, hence host-cached memory types are preferred.
+  auto     requirements = mDevice->getBufferMemoryRequirements(*result->mBuffer);
+  uint32_t typeBits     = requirements.memoryTypeBits & pointerProperties.memoryTypeBits;
+
+  if (typeBits == 0) {
+    throw std::runtime_error(
+        "Failed to import host memory: No memory type is compatible with the buffer!");
+  }
+
+  vk::MemoryPropertyFlags properties =
+      vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCached;
+
+  if (!mPhysicalDevice->hasMemoryType(typeBits, properties)) {
+    properties = vk::MemoryPropertyFlags();
+  }
+
+  vk::ImportMemoryHostPointerInfoEXT importInfo;
+  importInfo.handleType   = handleType;
+  importInfo.pHostPointer = hostPointer;
+
+  result->mMemoryInfo.allocationSize  = size;
+  result->mMemoryInfo.memoryTypeIndex = mPhysicalDevice->findMemoryType(typeBits, properties);
+  result->mMemoryInfo.pNext           = &importInfo;
+
+  result->mMemory           = createMemory(result->mMemoryInfo);
+  result->mMemoryInfo.pNext = nullptr;
+  result->mMappedData       = static_cast<uint8_t*>(hostPointer);
+
+  mDevice->bindBufferMemory(*result->mBuffer, *result->mMemory, 0);
+
   return result;
 }
 
@@ -290,6 +417,64 @@ BackedBufferPtr Device::createUniformBuffer(vk::DeviceSize size) const {
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////
 
+AccelerationStructurePtr Device::createAccelerationStructure(
+    vk::AccelerationStructureTypeKHR type, vk::DeviceSize size) const {
+
+  if (!mPhysicalDevice->supportsRayQueries()) {
+    throw std::runtime_error(
+        "Failed to create acceleration structure: VK_KHR_ray_query is not supported!");
+  }
+
+  auto result   = std::make_shared<AccelerationStructure>();
+  result->mType = type;
+  result->mBuffer =
+      createBackedBuffer(vk::BufferUsageFlagBits::eAccelerationStructureStorageKHR |
+                             vk::BufferUsageFlagBits::eShaderDeviceAddress,
+          vk::MemoryPropertyFlagBits::eDeviceLocal, size);
+
+  vk::AccelerationStructureCreateInfoKHR info;
+  info.buffer = *result->mBuffer->mBuffer;
+  info.size   = size;
+  info.type   = type;
+
+  result->mAccelerationStructure = createAccelerationStructureKhr(info);
+
+  vk::AccelerationStructureDeviceAddressInfoKHR addressInfo;
+  addressInfo.accelerationStructure = *result->mAccelerationStructure;
+
+  result->mDeviceAddress = mAccelerationStructure.mGetDeviceAddress(*mDevice,
+      reinterpret_cast<VkAccelerationStructureDeviceAddressInfoKHR const*>(&addressInfo));
+
+  return result;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+vk::AccelerationStructureBuildSizesInfoKHR Device::getAccelerationStructureBuildSizes(
+    vk::AccelerationStructureBuildGeometryInfoKHR const& info,
+    std::vector<uint32_t> const&                         maxPrimitiveCounts) const {
+
+  vk::AccelerationStructureBuildSizesInfoKHR sizes;
+  mAccelerationStructure.mGetBuildSizes(*mDevice, VK_ACCELERATION_STRUCTURE_BUILD_TYPE_DEVICE_KHR,
+      reinterpret_cast<VkAccelerationStructureBuildGeometryInfoKHR const*>(&info),
+      maxPrimitiveCounts.data(),
+      reinterpret_cast<VkAccelerationStructureBuildSizesInfoKHR*>(&sizes));
+
+  return sizes;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+vk::DeviceAddress Device::getBufferDeviceAddress(BackedBufferPtr const& buffer) const {
+  vk::BufferDeviceAddressInfoKHR info;
+  info.buffer = *buffer->mBuffer;
+
+  return mAccelerationStructure.mGetBufferDeviceAddress(
+      *mDevice, reinterpret_cast<VkBufferDeviceAddressInfoKHR const*>(&info));
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
 TexturePtr Device::createTexture(vk::ImageCreateInfo imageInfo, vk::SamplerCreateInfo samplerInfo,
     vk::ImageViewType viewType, vk::ImageAspectFlags imageAspectMask, vk::ImageLayout layout,
     vk::ComponentMapping const& componentMapping, vk::DeviceSize dataSize, const void* data) const {
@@ -305,12 +490,18 @@ TexturePtr Device::createTexture(vk::ImageCreateInfo imageInfo, vk::SamplerCreat
   result->mView          = image->mView;
   result->mViewInfo      = image->mViewInfo;
   result->mMemory        = image->mMemory;
+  result->mMemoryOffset  = image->mMemoryOffset;
+  result->mUploadTicket  = image->mUploadTicket;
   result->mMemoryInfo    = image->mMemoryInfo;
   result->mCurrentLayout = image->mCurrentLayout;
 
   // create sampler
   result->mSamplerInfo = samplerInfo;
-  result->mSampler     = createSampler(result->mSamplerInfo);
+  result->mSampler     = getSampler(result->mSamplerInfo);
+
+  if (mBindlessDescriptorSet) {
+    mBindlessDescriptorSet->addTexture(result);
+  }
 
   return result;
 }
@@ -328,6 +519,8 @@ vk::SamplerCreateInfo Device::createSamplerInfo(
 
 TexturePtr Device::getSinglePixelTexture(std::array<uint8_t, 4> const& color) {
 
+  std::lock_guard<std::mutex> lock(mSinglePixelTextureMutex);
+
   auto cached = mSinglePixelTextures.find(color);
   if (cached != mSinglePixelTextures.end()) {
     return cached->second;
@@ -360,17 +553,99 @@ TexturePtr Device::getSinglePixelTexture(std::array<uint8_t, 4> const& color) {
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////
 
+vk::DescriptorSetLayoutPtr Device::getDescriptorSetLayout(
+    Core::BitHash const& hash, vk::DescriptorSetLayoutCreateInfo const& info) const {
+
+  std::lock_guard<std::mutex> lock(mLayoutMutex);
+
+  auto cached = mDescriptorSetLayouts.find(hash);
+  if (cached != mDescriptorSetLayouts.end()) {
+    return cached->second;
+  }
+
+  auto layout = createDescriptorSetLayout(info);
+  mDescriptorSetLayouts.emplace(hash, layout);
+
+  return layout;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+vk::PipelineLayoutPtr Device::getPipelineLayout(
+    Core::BitHash const& hash, vk::PipelineLayoutCreateInfo const& info) const {
+
+  std::lock_guard<std::mutex> lock(mLayoutMutex);
+
+  auto cached = mPipelineLayouts.find(hash);
+  if (cached != mPipelineLayouts.end()) {
+    return cached->second;
+  }
+
+  auto layout = createPipelineLayout(info);
+  mPipelineLayouts.emplace(hash, layout);
+
+  return layout;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+vk::SamplerPtr Device::getSampler(vk::SamplerCreateInfo const& info) const {
+
+  if (info.pNext) {
+    return createSampler(info);
+  }
+
+  Core::BitHash hash;
+  hash.push<32>(info.flags);
+  hash.push<32>(info.magFilter);
+  hash.push<32>(info.minFilter);
+  hash.push<32>(info.mipmapMode);
+  hash.push<32>(info.addressModeU);
+  hash.push<32>(info.addressModeV);
+  hash.push<32>(info.addressModeW);
+  hash.push<32>(info.mipLodBias);
+  hash.push<1>(info.anisotropyEnable);
+  hash.push<32>(info.maxAnisotropy);
+  hash.push<1>(info.compareEnable);
+  hash.push<32>(info.compareOp);
+  hash.push<32>(info.minLod);
+  hash.push<32>(info.maxLod);
+  hash.push<32>(info.borderColor);
+  hash.push<1>(info.unnormalizedCoordinates);
+
+  std::lock_guard<std::mutex> lock(mSamplerMutex);
+
+  auto cached = mSamplers.find(hash);
+  if (cached != mSamplers.end()) {
+    return cached->second;
+  }
+
+  auto sampler = createSampler(info);
+  mSamplers.emplace(hash, sampler);
+
+  return sampler;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
 vk::CommandBufferPtr Device::allocateCommandBuffer(
     QueueType type, vk::CommandBufferLevel level) const {
+  return allocateCommandBuffer(getCommandPool(type), level);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+vk::CommandBufferPtr Device::allocateCommandBuffer(
+    vk::CommandPoolPtr const& commandPool, vk::CommandBufferLevel level) const {
   vk::CommandBufferAllocateInfo info;
   info.level              = level;
-  info.commandPool        = *mCommandPools[Core::enumCast(type)];
+  info.commandPool        = *commandPool;
   info.commandBufferCount = 1;
 
   ILLUSION_TRACE << "Allocating CommandBuffer." << std::endl;
 
   auto device{mDevice};
-  auto pool{mCommandPools[Core::enumCast(type)]};
+  auto pool{commandPool};
 
   return VulkanPtr::create(
       mDevice->allocateCommandBuffers(info)[0], [device, pool](vk::CommandBuffer* obj) {
@@ -385,10 +660,13 @@ vk::CommandBufferPtr Device::allocateCommandBuffer(
 vk::BufferPtr Device::createBuffer(vk::BufferCreateInfo const& info) const {
   ILLUSION_TRACE << "Creating vk::Buffer." << std::endl;
   auto device{mDevice};
-  return VulkanPtr::create(device->createBuffer(info), [device](vk::Buffer* obj) {
-    ILLUSION_TRACE << "Deleting vk::Buffer." << std::endl;
-    device->destroyBuffer(*obj);
-    delete obj;
+  auto deletionQueue{mDeletionQueue};
+  return VulkanPtr::create(device->createBuffer(info), [device, deletionQueue](vk::Buffer* obj) {
+    deletionQueue->push([device, obj]() {
+      ILLUSION_TRACE << "Deleting vk::Buffer." << std::endl;
+      device->destroyBuffer(*obj);
+      delete obj;
+    });
   });
 }
 
@@ -409,11 +687,15 @@ vk::CommandPoolPtr Device::createCommandPool(vk::CommandPoolCreateInfo const& in
 vk::DescriptorPoolPtr Device::createDescriptorPool(vk::DescriptorPoolCreateInfo const& info) const {
   ILLUSION_TRACE << "Creating vk::DescriptorPool." << std::endl;
   auto device{mDevice};
-  return VulkanPtr::create(device->createDescriptorPool(info), [device](vk::DescriptorPool* obj) {
-    ILLUSION_TRACE << "Deleting vk::DescriptorPool." << std::endl;
-    device->destroyDescriptorPool(*obj);
-    delete obj;
-  });
+  auto deletionQueue{mDeletionQueue};
+  return VulkanPtr::create(
+      device->createDescriptorPool(info), [device, deletionQueue](vk::DescriptorPool* obj) {
+        deletionQueue->push([device, obj]() {
+          ILLUSION_TRACE << "Deleting vk::DescriptorPool." << std::endl;
+          device->destroyDescriptorPool(*obj);
+          delete obj;
+        });
+      });
 }
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -435,11 +717,15 @@ vk::DescriptorSetLayoutPtr Device::createDescriptorSetLayout(
 vk::DeviceMemoryPtr Device::createMemory(vk::MemoryAllocateInfo const& info) const {
   ILLUSION_TRACE << "Allocating vk::DeviceMemory." << std::endl;
   auto device{mDevice};
-  return VulkanPtr::create(device->allocateMemory(info), [device](vk::DeviceMemory* obj) {
-    ILLUSION_TRACE << "Freeing vk::DeviceMemory." << std::endl;
-    device->freeMemory(*obj);
-    delete obj;
-  });
+  auto deletionQueue{mDeletionQueue};
+  return VulkanPtr::create(
+      device->allocateMemory(info), [device, deletionQueue](vk::DeviceMemory* obj) {
+        deletionQueue->push([device, obj]() {
+          ILLUSION_TRACE << "Freeing vk::DeviceMemory." << std::endl;
+          device->freeMemory(*obj);
+          delete obj;
+        });
+      });
 }
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -459,11 +745,15 @@ vk::FencePtr Device::createFence(vk::FenceCreateFlags const& flags) const {
 vk::FramebufferPtr Device::createFramebuffer(vk::FramebufferCreateInfo const& info) const {
   ILLUSION_TRACE << "Creating vk::Framebuffer." << std::endl;
   auto device{mDevice};
-  return VulkanPtr::create(device->createFramebuffer(info), [device](vk::Framebuffer* obj) {
-    ILLUSION_TRACE << "Deleting vk::Framebuffer." << std::endl;
-    device->destroyFramebuffer(*obj);
-    delete obj;
-  });
+  auto deletionQueue{mDeletionQueue};
+  return VulkanPtr::create(
+      device->createFramebuffer(info), [device, deletionQueue](vk::Framebuffer* obj) {
+        deletionQueue->push([device, obj]() {
+          ILLUSION_TRACE << "Deleting vk::Framebuffer." << std::endl;
+          device->destroyFramebuffer(*obj);
+          delete obj;
+        });
+      });
 }
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -471,10 +761,13 @@ vk::FramebufferPtr Device::createFramebuffer(vk::FramebufferCreateInfo const& in
 vk::ImagePtr Device::createImage(vk::ImageCreateInfo const& info) const {
   ILLUSION_TRACE << "Creating vk::Image." << std::endl;
   auto device{mDevice};
-  return VulkanPtr::create(device->createImage(info), [device](vk::Image* obj) {
-    ILLUSION_TRACE << "Deleting vk::Image." << std::endl;
-    device->destroyImage(*obj);
-    delete obj;
+  auto deletionQueue{mDeletionQueue};
+  return VulkanPtr::create(device->createImage(info), [device, deletionQueue](vk::Image* obj) {
+    deletionQueue->push([device, obj]() {
+      ILLUSION_TRACE << "Deleting vk::Image." << std::endl;
+      device->destroyImage(*obj);
+      delete obj;
+    });
   });
 }
 
@@ -483,23 +776,32 @@ vk::ImagePtr Device::createImage(vk::ImageCreateInfo const& info) const {
 vk::ImageViewPtr Device::createImageView(vk::ImageViewCreateInfo const& info) const {
   ILLUSION_TRACE << "Creating vk::ImageView." << std::endl;
   auto device{mDevice};
-  return VulkanPtr::create(device->createImageView(info), [device](vk::ImageView* obj) {
-    ILLUSION_TRACE << "Deleting vk::ImageView." << std::endl;
-    device->destroyImageView(*obj);
-    delete obj;
-  });
+  auto deletionQueue{mDeletionQueue};
+  return VulkanPtr::create(
+      device->createImageView(info), [device, deletionQueue](vk::ImageView* obj) {
+        deletionQueue->push([device, obj]() {
+          ILLUSION_TRACE << "Deleting vk::ImageView." << std::endl;
+          device->destroyImageView(*obj);
+          delete obj;
+        });
+      });
 }
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////
 
 vk::PipelinePtr Device::createComputePipeline(vk::ComputePipelineCreateInfo const& info) const {
   ILLUSION_TRACE << "Creating vk::Pipeline (compute)." << std::endl;
+  mFrameStatistics->add(&FrameStatistics::Counters::mPipelineCreations);
   auto device{mDevice};
+  auto deletionQueue{mDeletionQueue};
   return VulkanPtr::create(
-      device->createComputePipeline(nullptr, info), [device](vk::Pipeline* obj) {
-        ILLUSION_TRACE << "Deleting vk::Pipeline (compute)." << std::endl;
-        device->destroyPipeline(*obj);
-        delete obj;
+      device->createComputePipeline(*mPipelineCache->getHandle(), info),
+      [device, deletionQueue](vk::Pipeline* obj) {
+        deletionQueue->push([device, obj]() {
+          ILLUSION_TRACE << "Deleting vk::Pipeline (compute)." << std::endl;
+          device->destroyPipeline(*obj);
+          delete obj;
+        });
       });
 }
 
@@ -507,37 +809,104 @@ vk::PipelinePtr Device::createComputePipeline(vk::ComputePipelineCreateInfo cons
 
 vk::PipelinePtr Device::createGraphicsPipeline(vk::GraphicsPipelineCreateInfo const& info) const {
   ILLUSION_TRACE << "Creating vk::Pipeline (graphics)." << std::endl;
+  mFrameStatistics->add(&FrameStatistics::Counters::mPipelineCreations);
   auto device{mDevice};
+  auto deletionQueue{mDeletionQueue};
   return VulkanPtr::create(
-      device->createGraphicsPipeline(nullptr, info), [device](vk::Pipeline* obj) {
-        ILLUSION_TRACE << "Deleting vk::Pipeline (graphics)." << std::endl;
-        device->destroyPipeline(*obj);
-        delete obj;
+      device->createGraphicsPipeline(*mPipelineCache->getHandle(), info),
+      [device, deletionQueue](vk::Pipeline* obj) {
+        deletionQueue->push([device, obj]() {
+          ILLUSION_TRACE << "Deleting vk::Pipeline (graphics)." << std::endl;
+          device->destroyPipeline(*obj);
+          delete obj;
+        });
       });
 }
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////
 
-vk::PipelineLayoutPtr Device::createPipelineLayout(vk::PipelineLayoutCreateInfo const& info) const {
-  ILLUSION_TRACE << "Creating vk::PipelineLayout." << std::endl;
+vk::PipelineCachePtr Device::createPipelineCache(vk::PipelineCacheCreateInfo const& info) const {
+  ILLUSION_TRACE << "Creating vk::PipelineCache." << std::endl;
   auto device{mDevice};
-  return VulkanPtr::create(device->createPipelineLayout(info), [device](vk::PipelineLayout* obj) {
-    ILLUSION_TRACE << "Deleting vk::PipelineLayout." << std::endl;
-    device->destroyPipelineLayout(*obj);
+  return VulkanPtr::create(device->createPipelineCache(info), [device](vk::PipelineCache* obj) {
+    ILLUSION_TRACE << "Deleting vk::PipelineCache." << std::endl;
+    device->destroyPipelineCache(*obj);
     delete obj;
   });
 }
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////
 
+vk::PipelineLayoutPtr Device::createPipelineLayout(vk::PipelineLayoutCreateInfo const& info) const {
+  ILLUSION_TRACE << "Creating vk::PipelineLayout." << std::endl;
+  auto device{mDevice};
+  auto deletionQueue{mDeletionQueue};
+  return VulkanPtr::create(
+      device->createPipelineLayout(info), [device, deletionQueue](vk::PipelineLayout* obj) {
+        deletionQueue->push([device, obj]() {
+          ILLUSION_TRACE << "Deleting vk::PipelineLayout." << std::endl;
+          device->destroyPipelineLayout(*obj);
+          delete obj;
+        });
+      });
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+vk::QueryPoolPtr Device::createQueryPool(vk::QueryPoolCreateInfo const& info) const {
+  ILLUSION_TRACE << "Creating vk::QueryPool." << std::endl;
+  auto device{mDevice};
+  auto deletionQueue{mDeletionQueue};
+  return VulkanPtr::create(
+      device->createQueryPool(info), [device, deletionQueue](vk::QueryPool* obj) {
+        deletionQueue->push([device, obj]() {
+          ILLUSION_TRACE << "Deleting vk::QueryPool." << std::endl;
+          device->destroyQueryPool(*obj);
+          delete obj;
+        });
+      });
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+vk::AccelerationStructureKHRPtr Device::createAccelerationStructureKhr(
+    vk::AccelerationStructureCreateInfoKHR const& info) const {
+
+  VkAccelerationStructureKHR handle;
+  if (mAccelerationStructure.mCreate(*mDevice,
+          reinterpret_cast<VkAccelerationStructureCreateInfoKHR const*>(&info), nullptr,
+          &handle) != VK_SUCCESS) {
+    throw std::runtime_error("Failed to create vk::AccelerationStructureKHR!");
+  }
+
+  ILLUSION_TRACE << "Creating vk::AccelerationStructureKHR." << std::endl;
+  auto device{mDevice};
+  auto deletionQueue{mDeletionQueue};
+  auto destroy{mAccelerationStructure.mDestroy};
+  return VulkanPtr::create(vk::AccelerationStructureKHR(handle),
+      [device, deletionQueue, destroy](vk::AccelerationStructureKHR* obj) {
+        deletionQueue->push([device, destroy, obj]() {
+          ILLUSION_TRACE << "Deleting vk::AccelerationStructureKHR." << std::endl;
+          destroy(*device, *obj, nullptr);
+          delete obj;
+        });
+      });
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
 vk::RenderPassPtr Device::createRenderPass(vk::RenderPassCreateInfo const& info) const {
   ILLUSION_TRACE << "Creating vk::RenderPass." << std::endl;
   auto device{mDevice};
-  return VulkanPtr::create(device->createRenderPass(info), [device](vk::RenderPass* obj) {
-    ILLUSION_TRACE << "Deleting vk::RenderPass." << std::endl;
-    device->destroyRenderPass(*obj);
-    delete obj;
-  });
+  auto deletionQueue{mDeletionQueue};
+  return VulkanPtr::create(
+      device->createRenderPass(info), [device, deletionQueue](vk::RenderPass* obj) {
+        deletionQueue->push([device, obj]() {
+          ILLUSION_TRACE << "Deleting vk::RenderPass." << std::endl;
+          device->destroyRenderPass(*obj);
+          delete obj;
+        });
+      });
 }
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -545,10 +914,13 @@ vk::RenderPassPtr Device::createRenderPass(vk::RenderPassCreateInfo const& info)
 vk::SamplerPtr Device::createSampler(vk::SamplerCreateInfo const& info) const {
   ILLUSION_TRACE << "Creating vk::Sampler." << std::endl;
   auto device{mDevice};
-  return VulkanPtr::create(device->createSampler(info), [device](vk::Sampler* obj) {
-    ILLUSION_TRACE << "Deleting vk::Sampler." << std::endl;
-    device->destroySampler(*obj);
-    delete obj;
+  auto deletionQueue{mDeletionQueue};
+  return VulkanPtr::create(device->createSampler(info), [device, deletionQueue](vk::Sampler* obj) {
+    deletionQueue->push([device, obj]() {
+      ILLUSION_TRACE << "Deleting vk::Sampler." << std::endl;
+      device->destroySampler(*obj);
+      delete obj;
+    });
   });
 }
 
@@ -590,6 +962,30 @@ vk::SwapchainKHRPtr Device::createSwapChainKhr(vk::SwapchainCreateInfoKHR const&
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////
 
+vk::SemaphorePtr Device::createTimelineSemaphore(uint64_t initialValue) const {
+  if (!mPhysicalDevice->supportsTimelineSemaphores()) {
+    throw std::runtime_error(
+        "Failed to create timeline semaphore: VK_KHR_timeline_semaphore is not supported!");
+  }
+
+  vk::SemaphoreTypeCreateInfoKHR typeInfo;
+  typeInfo.semaphoreType = vk::SemaphoreTypeKHR::eTimeline;
+  typeInfo.initialValue  = initialValue;
+
+  vk::SemaphoreCreateInfo info;
+  info.pNext = &typeInfo;
+
+  ILLUSION_TRACE << "Creating vk::Semaphore." << std::endl;
+  auto device{mDevice};
+  return VulkanPtr::create(device->createSemaphore(info), [device](vk::Semaphore* obj) {
+    ILLUSION_TRACE << "Deleting vk::Semaphore." << std::endl;
+    device->destroySemaphore(*obj);
+    delete obj;
+  });
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
 vk::DevicePtr const& Device::getHandle() const {
   return mDevice;
 }
@@ -602,8 +998,156 @@ PhysicalDevicePtr const& Device::getPhysicalDevice() const {
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////
 
+DeletionQueuePtr const& Device::getDeletionQueue() const {
+  return mDeletionQueue;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+MemoryAllocatorPtr const& Device::getMemoryAllocator() const {
+  return mMemoryAllocator;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+FrameStatisticsPtr const& Device::getFrameStatistics() const {
+  return mFrameStatistics;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+UploadManagerPtr const& Device::getUploadManager() const {
+  return mUploadManager;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+SubmissionBatcherPtr const& Device::getSubmissionBatcher() const {
+  return mSubmissionBatcher;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+RenderTargetPoolPtr const& Device::getRenderTargetPool() const {
+  return mRenderTargetPool;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+GeometryArenaPtr const& Device::getGeometryArena(
+    std::vector<vk::DeviceSize> const& vertexStrides) const {
+
+  std::lock_guard<std::mutex> lock(mGeometryArenaMutex);
+
+  auto& arena = mGeometryArenas[vertexStrides];
+  if (!arena) {
+    arena = GeometryArena::create(this, vertexStrides);
+  }
+
+  return arena;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+PipelineCachePtr const& Device::getPipelineCache() const {
+  return mPipelineCache;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+BindlessDescriptorSetPtr const& Device::getBindlessDescriptorSet() const {
+  return mBindlessDescriptorSet;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
 vk::Queue const& Device::getQueue(QueueType type) const {
-  return mQueues[Core::enumCast(type)];
+  return mQueuePool->getQueue(type);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+QueuePoolPtr const& Device::getQueuePool() const {
+  return mQueuePool;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+bool Device::hasSeparateQueue(QueueType type) const {
+  return type == QueueType::eGeneric || getQueue(type) != getQueue(QueueType::eGeneric);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+vk::PhysicalDeviceFeatures const& Device::getEnabledFeatures() const {
+  return mEnabledFeatures;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+PFN_vkCmdDrawIndexedIndirectCountKHR Device::getDrawIndexedIndirectCountFunction() const {
+  return mDrawIndexedIndirectCount;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+PFN_vkCmdPushDescriptorSetKHR Device::getPushDescriptorSetFunction() const {
+  return mPushDescriptorSet;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+Device::ExtendedDynamicStateFunctions const& Device::getExtendedDynamicStateFunctions() const {
+  return mExtendedDynamicState;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+PFN_vkCmdBeginRenderingKHR Device::getBeginRenderingFunction() const {
+  return mBeginRendering;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+PFN_vkCmdEndRenderingKHR Device::getEndRenderingFunction() const {
+  return mEndRendering;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+PFN_vkCmdDrawMeshTasksEXT Device::getDrawMeshTasksFunction() const {
+  return mDrawMeshTasks;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+Device::AccelerationStructureFunctions const& Device::getAccelerationStructureFunctions() const {
+  return mAccelerationStructure;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+vk::CommandPoolPtr const& Device::getCommandPool(QueueType type) const {
+  std::unique_lock<std::mutex> lock(mCommandPoolMutex);
+
+  // references to elements of an unordered_map stay valid when other elements are inserted
+  auto& pool = mCommandPools[std::this_thread::get_id()][Core::enumCast(type)];
+
+  if (!pool) {
+    vk::CommandPoolCreateInfo info;
+    info.queueFamilyIndex = mPhysicalDevice->getQueueFamily(type);
+    info.flags            = vk::CommandPoolCreateFlagBits::eResetCommandBuffer;
+    pool                  = createCommandPool(info);
+  }
+
+  return pool;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void Device::releaseCommandPools() const {
+  std::unique_lock<std::mutex> lock(mCommandPoolMutex);
+  mCommandPools.erase(std::this_thread::get_id());
 }
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -618,38 +1162,205 @@ void Device::resetFences(vk::ArrayProxy<const vk::Fence> const& fences) {
 }
 
 void Device::waitIdle() {
-  mDevice->waitIdle();
+  {
+    auto queueLocks = mQueuePool->lockAll();
+    mDevice->waitIdle();
+  }
+  mDeletionQueue->releaseAll();
 }
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////
 
 vk::DevicePtr Device::createDevice() const {
 
-  std::vector<vk::DeviceQueueCreateInfo> queueCreateInfos;
+  // All queues of the families used by the QueueTypes are created, see QueuePool.
+  std::vector<float> queuePriorities;
+  auto queueCreateInfos = QueuePool::getQueueCreateInfos(mPhysicalDevice, queuePriorities);
+
+  std::vector<const char*> extensions;
+
+  // headless Devices cannot present anything
+  if (mPhysicalDevice->supportsPresentation()) {
+    extensions.push_back(VK_KHR_SWAPCHAIN_EXTENSION_NAME);
+  }
+
+  if (mPhysicalDevice->supportsDrawIndirectCount()) {
+    extensions.push_back(VK_KHR_DRAW_INDIRECT_COUNT_EXTENSION_NAME);
+  }
+
+  if (mPhysicalDevice->supportsPushDescriptors()) {
+    extensions.push_back(VK_KHR_PUSH_DESCRIPTOR_EXTENSION_NAME);
+  }
+
+  if (mPhysicalDevice->supportsExtendedDynamicState()) {
+    extensions.push_back(VK_EXT_EXTENDED_DYNAMIC_STATE_EXTENSION_NAME);
+  }
 
-  const float              queuePriority{1.0f};
-  const std::set<uint32_t> uniqueQueueFamilies{
-      (uint32_t)mPhysicalDevice->getQueueFamily(QueueType::eGeneric),
-      (uint32_t)mPhysicalDevice->getQueueFamily(QueueType::eCompute),
-      (uint32_t)mPhysicalDevice->getQueueFamily(QueueType::eTransfer)};
+  if (mPhysicalDevice->supportsMemoryBudget()) {
+    extensions.push_back(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+  }
 
-  for (uint32_t queueFamily : uniqueQueueFamilies) {
-    vk::DeviceQueueCreateInfo queueCreateInfo;
-    queueCreateInfo.queueFamilyIndex = queueFamily;
-    queueCreateInfo.queueCount       = 1;
-    queueCreateInfo.pQueuePriorities = &queuePriority;
-    queueCreateInfos.push_back(queueCreateInfo);
+  if (mPhysicalDevice->supportsTimelineSemaphores()) {
+    extensions.push_back(VK_KHR_TIMELINE_SEMAPHORE_EXTENSION_NAME);
   }
 
-  vk::PhysicalDeviceFeatures deviceFeatures;
-  deviceFeatures.samplerAnisotropy = true;
+  // VK_KHR_dynamic_rendering depends on VK_KHR_multiview
+  if (mPhysicalDevice->supportsMultiview() || mPhysicalDevice->supportsDynamicRendering()) {
+    extensions.push_back(VK_KHR_MULTIVIEW_EXTENSION_NAME);
+  }
+
+  if (mPhysicalDevice->supportsDynamicRendering()) {
+    extensions.push_back(VK_KHR_MAINTENANCE2_EXTENSION_NAME);
+    extensions.push_back(VK_KHR_CREATE_RENDERPASS_2_EXTENSION_NAME);
+    extensions.push_back(VK_KHR_DEPTH_STENCIL_RESOLVE_EXTENSION_NAME);
+    extensions.push_back(VK_KHR_DYNAMIC_RENDERING_EXTENSION_NAME);
+  }
+
+  if (mPhysicalDevice->supportsMeshShaders()) {
+    extensions.push_back(VK_KHR_SHADER_FLOAT_CONTROLS_EXTENSION_NAME);
+    extensions.push_back(VK_KHR_SPIRV_1_4_EXTENSION_NAME);
+    extensions.push_back(VK_EXT_MESH_SHADER_EXTENSION_NAME);
+  }
+
+  if (mPhysicalDevice->supportsFragmentShadingRate()) {
+    extensions.push_back(VK_KHR_FRAGMENT_SHADING_RATE_EXTENSION_NAME);
+  }
+
+  if (mPhysicalDevice->supportsExternalMemoryHost()) {
+    extensions.push_back(VK_KHR_EXTERNAL_MEMORY_EXTENSION_NAME);
+    extensions.push_back(VK_EXT_EXTERNAL_MEMORY_HOST_EXTENSION_NAME);
+  }
+
+  if (mPhysicalDevice->supportsGraphicsPipelineLibrary()) {
+    extensions.push_back(VK_KHR_PIPELINE_LIBRARY_EXTENSION_NAME);
+    extensions.push_back(VK_EXT_GRAPHICS_PIPELINE_LIBRARY_EXTENSION_NAME);
+  }
+
+  // VK_KHR_ray_query depends on VK_KHR_spirv_1_4 which is pushed for mesh shaders as well;
+  // VK_EXT_descriptor_indexing is pushed below if the bindless mode is enabled
+  if (mPhysicalDevice->supportsRayQueries()) {
+    if (!mPhysicalDevice->supportsMeshShaders()) {
+      extensions.push_back(VK_KHR_SHADER_FLOAT_CONTROLS_EXTENSION_NAME);
+      extensions.push_back(VK_KHR_SPIRV_1_4_EXTENSION_NAME);
+    }
+    if (!mBindlessEnabled) {
+      extensions.push_back(VK_KHR_MAINTENANCE3_EXTENSION_NAME);
+      extensions.push_back(VK_EXT_DESCRIPTOR_INDEXING_EXTENSION_NAME);
+    }
+    extensions.push_back(VK_KHR_DEFERRED_HOST_OPERATIONS_EXTENSION_NAME);
+    extensions.push_back(VK_KHR_BUFFER_DEVICE_ADDRESS_EXTENSION_NAME);
+    extensions.push_back(VK_KHR_ACCELERATION_STRUCTURE_EXTENSION_NAME);
+    extensions.push_back(VK_KHR_RAY_QUERY_EXTENSION_NAME);
+  }
 
   vk::DeviceCreateInfo createInfo;
-  createInfo.pQueueCreateInfos       = queueCreateInfos.data();
-  createInfo.queueCreateInfoCount    = (uint32_t)queueCreateInfos.size();
-  createInfo.pEnabledFeatures        = &deviceFeatures;
-  createInfo.enabledExtensionCount   = static_cast<uint32_t>(DEVICE_EXTENSIONS.size());
-  createInfo.ppEnabledExtensionNames = DEVICE_EXTENSIONS.data();
+  createInfo.pQueueCreateInfos    = queueCreateInfos.data();
+  createInfo.queueCreateInfoCount = (uint32_t)queueCreateInfos.size();
+  createInfo.pEnabledFeatures     = &mEnabledFeatures;
+
+  // only the features required by the BindlessDescriptorSet are enabled
+  vk::PhysicalDeviceDescriptorIndexingFeaturesEXT descriptorIndexingFeatures;
+
+  if (mBindlessEnabled) {
+    if (!mPhysicalDevice->supportsBindless()) {
+      throw std::runtime_error(
+          "Failed to create Device: Bindless mode requires VK_EXT_descriptor_indexing!");
+    }
+
+    auto const& supported = mPhysicalDevice->getDescriptorIndexingFeatures();
+
+    descriptorIndexingFeatures.runtimeDescriptorArray                        = true;
+    descriptorIndexingFeatures.descriptorBindingPartiallyBound               = true;
+    descriptorIndexingFeatures.descriptorBindingVariableDescriptorCount      = true;
+    descriptorIndexingFeatures.descriptorBindingUpdateUnusedWhilePending     = true;
+    descriptorIndexingFeatures.descriptorBindingSampledImageUpdateAfterBind  = true;
+    descriptorIndexingFeatures.descriptorBindingStorageBufferUpdateAfterBind = true;
+    descriptorIndexingFeatures.shaderSampledImageArrayNonUniformIndexing     = true;
+
+    // this is optional, storage buffers can still be indexed with dynamically uniform values
+    descriptorIndexingFeatures.shaderStorageBufferArrayNonUniformIndexing =
+        supported.shaderStorageBufferArrayNonUniformIndexing;
+
+    extensions.push_back(VK_KHR_MAINTENANCE3_EXTENSION_NAME);
+    extensions.push_back(VK_EXT_DESCRIPTOR_INDEXING_EXTENSION_NAME);
+
+    createInfo.pNext = &descriptorIndexingFeatures;
+  }
+
+  vk::PhysicalDeviceExtendedDynamicStateFeaturesEXT extendedDynamicStateFeatures;
+
+  if (mPhysicalDevice->supportsExtendedDynamicState()) {
+    extendedDynamicStateFeatures.extendedDynamicState = true;
+    extendedDynamicStateFeatures.pNext                = const_cast<void*>(createInfo.pNext);
+    createInfo.pNext                                  = &extendedDynamicStateFeatures;
+  }
+
+  vk::PhysicalDeviceTimelineSemaphoreFeaturesKHR timelineSemaphoreFeatures;
+
+  if (mPhysicalDevice->supportsTimelineSemaphores()) {
+    timelineSemaphoreFeatures.timelineSemaphore = true;
+    timelineSemaphoreFeatures.pNext             = const_cast<void*>(createInfo.pNext);
+    createInfo.pNext                            = &timelineSemaphoreFeatures;
+  }
+
+  vk::PhysicalDeviceDynamicRenderingFeaturesKHR dynamicRenderingFeatures;
+
+  if (mPhysicalDevice->supportsDynamicRendering()) {
+    dynamicRenderingFeatures.dynamicRendering = true;
+    dynamicRenderingFeatures.pNext            = const_cast<void*>(createInfo.pNext);
+    createInfo.pNext                          = &dynamicRenderingFeatures;
+  }
+
+  vk::PhysicalDeviceMultiviewFeaturesKHR multiviewFeatures;
+
+  if (mPhysicalDevice->supportsMultiview()) {
+    multiviewFeatures.multiview = true;
+    multiviewFeatures.pNext     = const_cast<void*>(createInfo.pNext);
+    createInfo.pNext            = &multiviewFeatures;
+  }
+
+  vk::PhysicalDeviceMeshShaderFeaturesEXT meshShaderFeatures;
+
+  if (mPhysicalDevice->supportsMeshShaders()) {
+    meshShaderFeatures.taskShader = true;
+    meshShaderFeatures.meshShader = true;
+    meshShaderFeatures.pNext      = const_cast<void*>(createInfo.pNext);
+    createInfo.pNext              = &meshShaderFeatures;
+  }
+
+  vk::PhysicalDeviceFragmentShadingRateFeaturesKHR fragmentShadingRateFeatures;
+
+  if (mPhysicalDevice->supportsFragmentShadingRate()) {
+    fragmentShadingRateFeatures.pipelineFragmentShadingRate   = true;
+    fragmentShadingRateFeatures.attachmentFragmentShadingRate = true;
+    fragmentShadingRateFeatures.pNext                         = const_cast<void*>(createInfo.pNext);
+    createInfo.pNext                                          = &fragmentShadingRateFeatures;
+  }
+
+  vk::PhysicalDeviceGraphicsPipelineLibraryFeaturesEXT graphicsPipelineLibraryFeatures;
+
+  if (mPhysicalDevice->supportsGraphicsPipelineLibrary()) {
+    graphicsPipelineLibraryFeatures.graphicsPipelineLibrary = true;
+    graphicsPipelineLibraryFeatures.pNext                   = const_cast<void*>(createInfo.pNext);
+    createInfo.pNext                                        = &graphicsPipelineLibraryFeatures;
+  }
+
+  vk::PhysicalDeviceBufferDeviceAddressFeaturesKHR   bufferDeviceAddressFeatures;
+  vk::PhysicalDeviceAccelerationStructureFeaturesKHR accelerationStructureFeatures;
+  vk::PhysicalDeviceRayQueryFeaturesKHR              rayQueryFeatures;
+
+  if (mPhysicalDevice->supportsRayQueries()) {
+    bufferDeviceAddressFeatures.bufferDeviceAddress     = true;
+    bufferDeviceAddressFeatures.pNext                   = const_cast<void*>(createInfo.pNext);
+    accelerationStructureFeatures.accelerationStructure = true;
+    accelerationStructureFeatures.pNext                 = &bufferDeviceAddressFeatures;
+    rayQueryFeatures.rayQuery                           = true;
+    rayQueryFeatures.pNext                              = &accelerationStructureFeatures;
+    createInfo.pNext                                    = &rayQueryFeatures;
+  }
+
+  createInfo.enabledExtensionCount   = static_cast<uint32_t>(extensions.size());
+  createInfo.ppEnabledExtensionNames = extensions.data();
 
   ILLUSION_TRACE << "Creating vk::Device." << std::endl;
   return VulkanPtr::create(mPhysicalDevice->createDevice(createInfo), [](vk::Device* obj) {
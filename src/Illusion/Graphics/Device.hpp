@@ -14,6 +14,11 @@
 
 #include <glm/glm.hpp>
 #include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
 
 struct GLFWwindow;
 
@@ -27,6 +32,29 @@ namespace Illusion::Graphics {
 class Device {
 
  public:
+  // The commands of VK_EXT_extended_dynamic_state, see getExtendedDynamicStateFunctions().
+  struct ExtendedDynamicStateFunctions {
+    PFN_vkCmdSetCullModeEXT          mSetCullMode          = nullptr;
+    PFN_vkCmdSetFrontFaceEXT         mSetFrontFace         = nullptr;
+    PFN_vkCmdSetPrimitiveTopologyEXT mSetPrimitiveTopology = nullptr;
+    PFN_vkCmdSetDepthTestEnableEXT   mSetDepthTestEnable   = nullptr;
+    PFN_vkCmdSetDepthWriteEnableEXT  mSetDepthWriteEnable  = nullptr;
+    PFN_vkCmdSetDepthCompareOpEXT    mSetDepthCompareOp    = nullptr;
+  };
+
+  // The commands of VK_KHR_acceleration_structure and VK_KHR_buffer_device_address, see
+  // getAccelerationStructureFunctions().
+  struct AccelerationStructureFunctions {
+    PFN_vkCreateAccelerationStructureKHR              mCreate                 = nullptr;
+    PFN_vkDestroyAccelerationStructureKHR             mDestroy                = nullptr;
+    PFN_vkGetAccelerationStructureBuildSizesKHR       mGetBuildSizes          = nullptr;
+    PFN_vkGetAccelerationStructureDeviceAddressKHR    mGetDeviceAddress       = nullptr;
+    PFN_vkCmdBuildAccelerationStructuresKHR           mCmdBuild               = nullptr;
+    PFN_vkCmdCopyAccelerationStructureKHR             mCmdCopy                = nullptr;
+    PFN_vkCmdWriteAccelerationStructuresPropertiesKHR mCmdWriteProperties     = nullptr;
+    PFN_vkGetBufferDeviceAddressKHR                   mGetBufferDeviceAddress = nullptr;
+  };
+
   // Syntactic sugar to create a std::shared_ptr for this class
   template <typename... Args>
   static DevicePtr create(Args&&... args) {
@@ -34,16 +62,25 @@ class Device {
   };
 
   // The device needs the physical device it should be created for. You can get one from your
-  // Instance.
-  explicit Device(PhysicalDevicePtr const& physicalDevice);
+  // Instance. If a pipelineCacheFile is given, the content of the vk::PipelineCache will be loaded
+  // from this file and saved to it when the Device is destroyed. If enableBindless is set to true,
+  // VK_EXT_descriptor_indexing is enabled and all Textures and storage buffers are added to the
+  // BindlessDescriptorSet. An exception is thrown if PhysicalDevice::supportsBindless() is false.
+  explicit Device(PhysicalDevicePtr const& physicalDevice,
+      std::string const& pipelineCacheFile = "", bool enableBindless = false);
   virtual ~Device();
 
   // high-level create methods ---------------------------------------------------------------------
   // These methods will usually create multiple Vulkan resources and upload data to the GPU by
   // issuing CommandBuffers. They may even allocate temporary objects such as staging buffers.
+  // Staging uploads do not block, they are finished before any CommandBuffer which is submitted
+  // afterwards is executed. Use the mUploadTicket of the returned resources to wait on the CPU.
 
-  // Creates a BackedImage and optionally uploads data to the GPU. This uses a BackedBuffer as
-  // staging buffer.
+  // Creates a BackedImage and optionally uploads data to the GPU. This uses the staging memory of
+  // the UploadManager. The memory is sub-allocated by the MemoryAllocator of this Device. Images
+  // with an attachment usage are accounted as MemoryCategory::eRenderTarget, all others as
+  // MemoryCategory::eTexture. If the properties contain eLazilyAllocated but no memory type of
+  // the image supports it, the flag is ignored.
   BackedImagePtr createBackedImage(vk::ImageCreateInfo info, vk::ImageViewType viewType,
       vk::ImageAspectFlags imageAspectMask, vk::MemoryPropertyFlags properties,
       vk::ImageLayout layout, vk::ComponentMapping const& componentMapping = vk::ComponentMapping(),
@@ -51,8 +88,27 @@ class Device {
 
   // Creates a BackedBuffer and optionally uploads data to the GPU. If the memory is eHostVisible
   // and eHostCoherent, the data will be uploaded by mapping. Else a staging buffer will be used.
+  // The memory is sub-allocated by the MemoryAllocator of this Device. Vertex, index and
+  // acceleration structure buffers are accounted as MemoryCategory::eGeometry, buffers which are
+  // only a transfer source as MemoryCategory::eStaging and all others as MemoryCategory::eOther. If
+  // the PhysicalDevice supportsRayQueries(), buffers may have the eShaderDeviceAddress usage.
+  // With vk::SharingMode::eConcurrent, the buffer is shared by the queue families of all
+  // QueueTypes, so no ownership transfers are required. This is useful for buffers which are
+  // uploaded in several parts while other parts are already in use on the generic queue.
   BackedBufferPtr createBackedBuffer(vk::BufferUsageFlags usage, vk::MemoryPropertyFlags properties,
-      vk::DeviceSize dataSize, const void* data = nullptr) const;
+      vk::DeviceSize dataSize, const void* data = nullptr,
+      vk::SharingMode sharingMode = vk::SharingMode::eExclusive) const;
+
+  // Wraps the given host memory in a BackedBuffer without copying it, using
+  // VK_EXT_external_memory_host. The GPU reads the memory directly, for example when it is the
+  // source of UploadManager::copyToImage(); this saves the copy to the staging memory. Both, the
+  // hostPointer and the size have to be multiples of the minImportedHostPointerAlignment of the
+  // PhysicalDevice (see getExternalMemoryHostProperties()), else a std::runtime_error is thrown.
+  // The memory must stay allocated until the returned buffer has been destroyed by the
+  // DeletionQueue; it is not accounted by the MemoryAllocator. The mMappedData of the buffer is
+  // the hostPointer.
+  BackedBufferPtr importHostBuffer(
+      vk::BufferUsageFlags usage, vk::DeviceSize size, void* hostPointer) const;
 
   // Creates a device-local BackedBuffer with vk::BufferUsageFlagBits::eVertexBuffer and uploads the
   // given data. You may use the convenience template-version below to directly upload objects such
@@ -78,15 +134,49 @@ class Device {
   // vk::BufferUsageFlagBits::eTransferDst.
   BackedBufferPtr createUniformBuffer(vk::DeviceSize size) const;
 
+  // Creates a device-local BackedBuffer of the given size and a vk::AccelerationStructureKHR of the
+  // given type covering all of it. The size is usually the accelerationStructureSize returned by
+  // getAccelerationStructureBuildSizes(). The memory is accounted as MemoryCategory::eGeometry. A
+  // std::runtime_error is thrown if the PhysicalDevice does not support ray queries.
+  AccelerationStructurePtr createAccelerationStructure(
+      vk::AccelerationStructureTypeKHR type, vk::DeviceSize size) const;
+
+  // Returns the sizes of the acceleration structure and of the scratch buffers needed for building
+  // and updating it with the given geometries and primitive counts (one for each geometry).
+  vk::AccelerationStructureBuildSizesInfoKHR getAccelerationStructureBuildSizes(
+      vk::AccelerationStructureBuildGeometryInfoKHR const& info,
+      std::vector<uint32_t> const&                         maxPrimitiveCounts) const;
+
+  // Returns the address of the given buffer. It has to be created with
+  // vk::BufferUsageFlagBits::eShaderDeviceAddress, which requires ray query support.
+  vk::DeviceAddress getBufferDeviceAddress(BackedBufferPtr const& buffer) const;
+
   TexturePtr createTexture(vk::ImageCreateInfo imageInfo, vk::SamplerCreateInfo samplerInfo,
       vk::ImageViewType viewType, vk::ImageAspectFlags imageAspectMask, vk::ImageLayout layout,
       vk::ComponentMapping const& componentMapping = vk::ComponentMapping(),
       vk::DeviceSize dataSize = 0, const void* data = nullptr) const;
 
   // If you need a texture with a single pixel of a specific color, you can use this method. When
-  // called multiple times with the same color, it will only create a texture once.
+  // called multiple times with the same color, it will only create a texture once. This is
+  // thread-safe.
   TexturePtr getSinglePixelTexture(std::array<uint8_t, 4> const& color);
 
+  // These return cached layouts for the given create infos. The hash has to identify the create
+  // info, usually it is DescriptorSetReflection::getHash() or PipelineReflection::getHash(). The
+  // layout is only created when a hash is requested for the first time, hence all Shaders with
+  // identical resources share the same handles. The layouts are kept until the Device is
+  // destroyed. This is thread-safe.
+  vk::DescriptorSetLayoutPtr getDescriptorSetLayout(
+      Core::BitHash const& hash, vk::DescriptorSetLayoutCreateInfo const& info) const;
+  vk::PipelineLayoutPtr getPipelineLayout(
+      Core::BitHash const& hash, vk::PipelineLayoutCreateInfo const& info) const;
+
+  // Returns a shared vk::Sampler for the given create info. Identical create infos yield the same
+  // vk::Sampler, so scenes with many textures do not exhaust maxSamplerAllocationCount. The
+  // samplers are kept until the Device is destroyed. Create infos with a pNext chain cannot be
+  // compared; for them, a new vk::Sampler is created each time. This is thread-safe.
+  vk::SamplerPtr getSampler(vk::SamplerCreateInfo const& info) const;
+
   // static method for easy allocation of a vk::SamplerCreateInfo. It uses useful defaults and
   // assigns the same filter to magFilter and minFilter as well as the same address mode to U, V and
   // W.
@@ -101,25 +191,33 @@ class Device {
   // allocated from). This ensures that an object will not be deleted before all dependent objects
   // are deleted.
 
+  // The vk::CommandBuffers returned by the first allocateCommandBuffer() are allocated from the
+  // vk::CommandPool of the calling thread (see getCommandPool()). The second version allocates from
+  // the given pool.
   // clang-format off
-  vk::CommandBufferPtr       allocateCommandBuffer(QueueType = QueueType::eGeneric, vk::CommandBufferLevel = vk::CommandBufferLevel::ePrimary) const;
-  vk::BufferPtr              createBuffer(vk::BufferCreateInfo const&) const;
-  vk::CommandPoolPtr         createCommandPool(vk::CommandPoolCreateInfo const&) const;
-  vk::DescriptorPoolPtr      createDescriptorPool(vk::DescriptorPoolCreateInfo const&) const;
-  vk::DescriptorSetLayoutPtr createDescriptorSetLayout(vk::DescriptorSetLayoutCreateInfo const&) const;
-  vk::DeviceMemoryPtr        createMemory(vk::MemoryAllocateInfo const&) const;
-  vk::FencePtr               createFence(vk::FenceCreateFlags const& = vk::FenceCreateFlagBits::eSignaled) const;
-  vk::FramebufferPtr         createFramebuffer(vk::FramebufferCreateInfo const&) const;
-  vk::ImagePtr               createImage(vk::ImageCreateInfo const&) const;
-  vk::ImageViewPtr           createImageView(vk::ImageViewCreateInfo const&) const;
-  vk::PipelinePtr            createComputePipeline(vk::ComputePipelineCreateInfo const&) const;
-  vk::PipelinePtr            createGraphicsPipeline(vk::GraphicsPipelineCreateInfo const&) const;
-  vk::PipelineLayoutPtr      createPipelineLayout(vk::PipelineLayoutCreateInfo const&) const;
-  vk::RenderPassPtr          createRenderPass(vk::RenderPassCreateInfo const&) const;
-  vk::SamplerPtr             createSampler(vk::SamplerCreateInfo const&) const;
-  vk::SemaphorePtr           createSemaphore(vk::SemaphoreCreateFlags const& = {}) const;
-  vk::ShaderModulePtr        createShaderModule(vk::ShaderModuleCreateInfo const&) const;
-  vk::SwapchainKHRPtr        createSwapChainKhr(vk::SwapchainCreateInfoKHR const&) const;
+  vk::CommandBufferPtr            allocateCommandBuffer(QueueType = QueueType::eGeneric, vk::CommandBufferLevel = vk::CommandBufferLevel::ePrimary) const;
+  vk::CommandBufferPtr            allocateCommandBuffer(vk::CommandPoolPtr const&, vk::CommandBufferLevel = vk::CommandBufferLevel::ePrimary) const;
+  vk::AccelerationStructureKHRPtr createAccelerationStructureKhr(vk::AccelerationStructureCreateInfoKHR const&) const;
+  vk::BufferPtr                   createBuffer(vk::BufferCreateInfo const&) const;
+  vk::CommandPoolPtr              createCommandPool(vk::CommandPoolCreateInfo const&) const;
+  vk::DescriptorPoolPtr           createDescriptorPool(vk::DescriptorPoolCreateInfo const&) const;
+  vk::DescriptorSetLayoutPtr      createDescriptorSetLayout(vk::DescriptorSetLayoutCreateInfo const&) const;
+  vk::DeviceMemoryPtr             createMemory(vk::MemoryAllocateInfo const&) const;
+  vk::FencePtr                    createFence(vk::FenceCreateFlags const& = vk::FenceCreateFlagBits::eSignaled) const;
+  vk::FramebufferPtr              createFramebuffer(vk::FramebufferCreateInfo const&) const;
+  vk::ImagePtr                    createImage(vk::ImageCreateInfo const&) const;
+  vk::ImageViewPtr                createImageView(vk::ImageViewCreateInfo const&) const;
+  vk::PipelinePtr                 createComputePipeline(vk::ComputePipelineCreateInfo const&) const;
+  vk::PipelinePtr                 createGraphicsPipeline(vk::GraphicsPipelineCreateInfo const&) const;
+  vk::PipelineCachePtr            createPipelineCache(vk::PipelineCacheCreateInfo const&) const;
+  vk::PipelineLayoutPtr           createPipelineLayout(vk::PipelineLayoutCreateInfo const&) const;
+  vk::QueryPoolPtr                createQueryPool(vk::QueryPoolCreateInfo const&) const;
+  vk::RenderPassPtr               createRenderPass(vk::RenderPassCreateInfo const&) const;
+  vk::SamplerPtr                  createSampler(vk::SamplerCreateInfo const&) const;
+  vk::SemaphorePtr                createSemaphore(vk::SemaphoreCreateFlags const& = {}) const;
+  vk::ShaderModulePtr             createShaderModule(vk::ShaderModuleCreateInfo const&) const;
+  vk::SwapchainKHRPtr             createSwapChainKhr(vk::SwapchainCreateInfoKHR const&) const;
+  vk::SemaphorePtr                createTimelineSemaphore(uint64_t initialValue = 0) const;
   // clang-format on
 
   // vulkan getters --------------------------------------------------------------------------------
@@ -127,23 +225,153 @@ class Device {
   PhysicalDevicePtr const& getPhysicalDevice() const;
   vk::Queue const&         getQueue(QueueType type) const;
 
+  // All queues of the families used by the QueueTypes are created. getQueue() returns the ones
+  // chosen by the PhysicalDevice, the others can be used for example to submit uploads of several
+  // threads in parallel. As vk::Queues are not thread-safe, submit only while holding a
+  // QueuePool::Lock.
+  QueuePoolPtr const& getQueuePool() const;
+
+  // Returns true if the given QueueType has a vk::Queue of its own. Only then work submitted to it
+  // (for example async compute) can overlap with the work of the generic queue.
+  bool hasSeparateQueue(QueueType type) const;
+
+  // Besides samplerAnisotropy, the features multiDrawIndirect and drawIndirectFirstInstance are
+  // enabled if the PhysicalDevice supports them.
+  vk::PhysicalDeviceFeatures const& getEnabledFeatures() const;
+
+  // This is nullptr if VK_KHR_draw_indirect_count is not supported by the PhysicalDevice. It is
+  // used by CommandBuffer::drawIndexedIndirectCount().
+  PFN_vkCmdDrawIndexedIndirectCountKHR getDrawIndexedIndirectCountFunction() const;
+
+  // This is nullptr if VK_KHR_push_descriptor is not supported by the PhysicalDevice. It is used by
+  // the CommandBuffer for the per-draw descriptor sets of Shaders, see Shader::setPerDrawSet().
+  PFN_vkCmdPushDescriptorSetKHR getPushDescriptorSetFunction() const;
+
+  // These are nullptr if VK_EXT_extended_dynamic_state is not supported by the PhysicalDevice.
+  // They are used by the CommandBuffer to record the dynamic state of its GraphicsState.
+  ExtendedDynamicStateFunctions const& getExtendedDynamicStateFunctions() const;
+
+  // These are nullptr if VK_KHR_dynamic_rendering is not supported by the PhysicalDevice. They are
+  // used by the CommandBuffer for RenderPasses in dynamic rendering mode.
+  PFN_vkCmdBeginRenderingKHR getBeginRenderingFunction() const;
+  PFN_vkCmdEndRenderingKHR   getEndRenderingFunction() const;
+
+  // This is nullptr if VK_EXT_mesh_shader is not supported by the PhysicalDevice. It is used by
+  // CommandBuffer::drawMeshTasks().
+  PFN_vkCmdDrawMeshTasksEXT getDrawMeshTasksFunction() const;
+
+  // These are nullptr if the PhysicalDevice does not support ray queries. They are used by the
+  // CommandBuffer to build and copy AccelerationStructures.
+  AccelerationStructureFunctions const& getAccelerationStructureFunctions() const;
+
+  // Returns the vk::CommandPool of the calling thread for the given QueueType; it is created when
+  // a thread requests it for the first time. As vk::CommandPools are not thread-safe, a
+  // vk::CommandBuffer allocated by a thread should only be recorded, reset and destroyed by this
+  // thread. This way several threads can record CommandBuffers at the same time.
+  vk::CommandPoolPtr const& getCommandPool(QueueType type) const;
+
+  // The vk::CommandPools of a thread are kept until the Device is destroyed. Threads which exit
+  // earlier (for example worker threads which recorded secondary CommandBuffers) should call this
+  // before exiting, else their pools leak until then. CommandBuffers which have been allocated by
+  // the calling thread stay valid, they keep their vk::CommandPool alive. If the thread calls
+  // getCommandPool() again afterwards, new pools are created.
+  void releaseCommandPools() const;
+
+  // The deleters of vk::Buffers, vk::Images, vk::ImageViews, vk::Samplers, vk::Framebuffers,
+  // vk::RenderPasses, vk::Pipelines, vk::PipelineLayouts, vk::DescriptorPools, vk::QueryPools,
+  // vk::AccelerationStructureKHRs and vk::DeviceMemory (including sub-allocated ranges) push the
+  // destruction to this queue. Once a FrameContext is used, these objects are destroyed when the
+  // fence of the frame they were released in has been signaled. Hence they can be dropped without
+  // calling waitIdle() first.
+  DeletionQueuePtr const& getDeletionQueue() const;
+
+  // All BackedBuffers and BackedImages are sub-allocated from larger vk::DeviceMemory blocks by
+  // this allocator. It can be used to query memory statistics and the budget of the memory heaps.
+  MemoryAllocatorPtr const& getMemoryAllocator() const;
+
+  // Counts draws, dispatches, pipeline creations, descriptor updates, barriers, uploads and
+  // submissions. The FrameContext resets it once per frame, see FrameStatistics for details.
+  FrameStatisticsPtr const& getFrameStatistics() const;
+
+  // CommandBuffers which are enqueued to this SubmissionBatcher are submitted with one
+  // vkQueueSubmit per QueueType when it is flushed. The FrameContext flushes it once per frame.
+  SubmissionBatcherPtr const& getSubmissionBatcher() const;
+
+  // The Framebuffers acquire their images from this pool and release them to it when they are
+  // destroyed. The FrameContext destroys free images which have not been reused for a few frames.
+  RenderTargetPoolPtr const& getRenderTargetPool() const;
+
+  // Returns the GeometryArena for vertices with the given streams; there is one arena for each
+  // distinct list of vertex strides (in bytes). It is created on first use. This is thread-safe.
+  GeometryArenaPtr const& getGeometryArena(std::vector<vk::DeviceSize> const& vertexStrides) const;
+
+  // Staging uploads of the high-level create methods are recorded by this UploadManager and
+  // executed asynchronously on the transfer queue.
+  UploadManagerPtr const& getUploadManager() const;
+
+  // This stores all vk::Pipelines created by the CommandBuffers of this Device. Its
+  // vk::PipelineCache is used by createComputePipeline() and createGraphicsPipeline().
+  PipelineCachePtr const& getPipelineCache() const;
+
+  // This is nullptr if the bindless mode has not been enabled. Shaders using runtime arrays in a
+  // descriptor set get its layout for this set and the CommandBuffer binds it automatically.
+  BindlessDescriptorSetPtr const& getBindlessDescriptorSet() const;
+
   // device interface forwarding -------------------------------------------------------------------
   void waitForFences(
       vk::ArrayProxy<const vk::Fence> const& fences, bool waitAll = true, uint64_t timeout = ~0);
   void resetFences(vk::ArrayProxy<const vk::Fence> const& fences);
+
+  // This also destroys all objects in the DeletionQueue.
   void waitIdle();
 
  private:
   vk::DevicePtr createDevice() const;
 
-  PhysicalDevicePtr mPhysicalDevice;
-  vk::DevicePtr     mDevice;
+  PhysicalDevicePtr          mPhysicalDevice;
+  bool                       mBindlessEnabled;
+  vk::PhysicalDeviceFeatures mEnabledFeatures;
+  vk::DevicePtr              mDevice;
+  QueuePoolPtr               mQueuePool;
+  DeletionQueuePtr           mDeletionQueue;
+  MemoryAllocatorPtr         mMemoryAllocator;
+  FrameStatisticsPtr         mFrameStatistics;
+
+  // The distinct queue families of all QueueTypes, used for vk::SharingMode::eConcurrent.
+  std::vector<uint32_t> mQueueFamilies;
+
+  PFN_vkCmdDrawIndexedIndirectCountKHR mDrawIndexedIndirectCount = nullptr;
+  PFN_vkCmdPushDescriptorSetKHR        mPushDescriptorSet         = nullptr;
+  ExtendedDynamicStateFunctions        mExtendedDynamicState;
+  PFN_vkCmdBeginRenderingKHR           mBeginRendering = nullptr;
+  PFN_vkCmdEndRenderingKHR             mEndRendering   = nullptr;
+  PFN_vkCmdDrawMeshTasksEXT            mDrawMeshTasks  = nullptr;
+  PFN_vkGetMemoryHostPointerPropertiesEXT mGetMemoryHostPointerProperties = nullptr;
+  AccelerationStructureFunctions          mAccelerationStructure;
 
-  // One for each QueueType
-  std::array<vk::Queue, 3>          mQueues;
-  std::array<vk::CommandPoolPtr, 3> mCommandPools;
+  // One for each QueueType and thread
+  mutable std::unordered_map<std::thread::id, std::array<vk::CommandPoolPtr, 3>> mCommandPools;
+  mutable std::mutex                                                            mCommandPoolMutex;
 
   std::map<std::array<uint8_t, 4>, TexturePtr> mSinglePixelTextures;
+  std::mutex                                   mSinglePixelTextureMutex;
+
+  mutable std::unordered_map<Core::BitHash, vk::DescriptorSetLayoutPtr> mDescriptorSetLayouts;
+  mutable std::unordered_map<Core::BitHash, vk::PipelineLayoutPtr>      mPipelineLayouts;
+  mutable std::mutex                                                    mLayoutMutex;
+
+  mutable std::unordered_map<Core::BitHash, vk::SamplerPtr> mSamplers;
+  mutable std::mutex                                        mSamplerMutex;
+
+  // This has to be destroyed before the queues and command pools.
+  UploadManagerPtr         mUploadManager;
+  SubmissionBatcherPtr     mSubmissionBatcher;
+  RenderTargetPoolPtr      mRenderTargetPool;
+  PipelineCachePtr         mPipelineCache;
+  BindlessDescriptorSetPtr mBindlessDescriptorSet;
+
+  mutable std::map<std::vector<vk::DeviceSize>, GeometryArenaPtr> mGeometryArenas;
+  mutable std::mutex                                              mGeometryArenaMutex;
 };
 
 } // namespace Illusion::Graphics
@@ -0,0 +1,291 @@
+////////////////////////////////////////////////////////////////////////////////////////////////////
+//                                                                                                //
+//    _)  |  |            _)                This code may be used and modified under the terms    //
+//     |  |  |  |  | (_-<  |   _ \    \     of the MIT license. See the LICENSE file for details. //
+//    _| _| _| \_,_| ___/ _| \___/ _| _|    Copyright (c) 2018-2019 Simon Schneegans              //
+//                                                                                                //
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include "FrameContext.hpp"
+
+#include "../Core/Logger.hpp"
+#include "../Core/Timer.hpp"
+#include "CoherentUniformBuffer.hpp"
+#include "CommandBuffer.hpp"
+#include "DeletionQueue.hpp"
+#include "Device.hpp"
+#include "ReadbackManager.hpp"
+#include "RenderTargetPool.hpp"
+#include "SubmissionBatcher.hpp"
+#include "Swapchain.hpp"
+#include "TransientAllocator.hpp"
+#include "Window.hpp"
+
+#include <chrono>
+#include <thread>
+
+namespace Illusion::Graphics {
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+FrameContext::FrameContext(DevicePtr const& device, uint32_t frameCount,
+    vk::DeviceSize uniformBufferSize, vk::DeviceSize uniformBufferAlignment,
+    CoherentUniformBuffer::Memory uniformBufferMemory)
+    : mDevice(device) {
+
+  if (frameCount < 2 || frameCount > 4) {
+    throw std::runtime_error(
+        "Failed to create FrameContext: The number of frames in flight must be in [2, 4]!");
+  }
+
+  ILLUSION_TRACE << "Creating FrameContext with " << frameCount << " frames." << std::endl;
+
+  mFrames.resize(frameCount);
+
+  for (uint32_t i(0); i < frameCount; ++i) {
+    auto& frame = mFrames[i];
+
+    frame.mUniformBuffer = CoherentUniformBuffer::create(
+        device, uniformBufferSize, uniformBufferAlignment, uniformBufferMemory);
+    frame.mTransientAllocator =
+        TransientAllocator::create(device, 1024 * 1024, uniformBufferAlignment);
+    frame.mReadbackManager = ReadbackManager::create(device);
+
+    frame.mCmd                      = CommandBuffer::create(device);
+    frame.mComputeCmd               = CommandBuffer::create(device, QueueType::eCompute);
+    frame.mFrameFinishedFence       = device->createFence();
+    frame.mRenderFinishedSemaphore  = device->createSemaphore();
+    frame.mComputeFinishedSemaphore = device->createSemaphore();
+    frame.mSlot                     = i;
+  }
+
+  // beginFrame() advances to the next slot, so the first frame will use slot zero
+  mCurrentSlot = frameCount - 1;
+
+  mDevice->getDeletionQueue()->addFrameContext();
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+FrameContext::~FrameContext() {
+  waitIdle();
+
+  // The frames of this FrameContext have been released by waitIdle(). Objects which are still used
+  // by work enqueued to the SubmissionBatcher stay in the DeletionQueue until it has finished.
+  mDevice->getDeletionQueue()->removeFrameContext();
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+FrameContext::Frame& FrameContext::beginFrame() {
+
+  // Sleep until the minimum frame time has passed since the last frame was started.
+  if (mFrameRateLimit > 0.0) {
+    double remaining = mLastFrameStart + 1.0 / mFrameRateLimit - Core::Timer::getNow();
+    if (remaining > 0.0) {
+      std::this_thread::sleep_for(std::chrono::duration<double>(remaining));
+    }
+  }
+
+  mLastFrameStart      = Core::Timer::getNow();
+  mLastFrameStatistics = mDevice->getFrameStatistics()->reset();
+
+  mCurrentSlot = (mCurrentSlot + 1) % static_cast<uint32_t>(mFrames.size());
+  ++mFrameIndex;
+
+  auto& frame = mFrames[mCurrentSlot];
+
+  // Usually this returns instantly, as the other frames were processed in the meantime.
+  mDevice->waitForFences(*frame.mFrameFinishedFence);
+  mDevice->resetFences(*frame.mFrameFinishedFence);
+
+  // The data of the reads recorded in the last frame of this slot is available now.
+  frame.mReadbackManager->resolve();
+
+  // All Vulkan objects which were released until the last frame of this slot can be destroyed now.
+  // Objects which are released from now on are tagged with the new frame index.
+  mDevice->getDeletionQueue()->releaseFrames(frame.mFrameIndex);
+  mDevice->getDeletionQueue()->beginFrame(mFrameIndex);
+  mDevice->getRenderTargetPool()->beginFrame();
+
+  frame.mDeferredReleases.clear();
+  frame.mUniformBuffer->reset();
+  frame.mTransientAllocator->reset();
+  frame.mFrameIndex = mFrameIndex;
+
+  frame.mCmd->reset();
+  frame.mCmd->begin();
+  frame.mComputeCmd->reset();
+  frame.mComputeCmd->begin();
+  frame.mComputeSubmitted  = false;
+  frame.mComputeWaitStages = vk::PipelineStageFlags();
+
+  return frame;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void FrameContext::submitCompute(vk::PipelineStageFlags waitStages) {
+  auto& frame = mFrames[mCurrentSlot];
+
+  if (frame.mComputeSubmitted) {
+    throw std::runtime_error(
+        "Failed to submit compute CommandBuffer: It has been submitted in this frame already!");
+  }
+
+  frame.mComputeCmd->end();
+  mDevice->getSubmissionBatcher()->enqueue(
+      frame.mComputeCmd, nullptr, nullptr, *frame.mComputeFinishedSemaphore);
+
+  // submit() waits for the semaphore in any case; an empty stage mask is not valid there
+  frame.mComputeSubmitted  = true;
+  frame.mComputeWaitStages = waitStages ? waitStages : vk::PipelineStageFlagBits::eTopOfPipe;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+BackedImagePtr const& FrameContext::acquireImage(
+    WindowPtr const& window, BackedImagePtr const& image) {
+  auto& frame = mFrames[mCurrentSlot];
+
+  if (window->getSwapchain()->supportsDirectRendering(image)) {
+    frame.mSwapchainImage = window->acquireImage();
+    return frame.mSwapchainImage;
+  }
+
+  frame.mSwapchainImage.reset();
+  return image;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void FrameContext::endFrame(WindowPtr const& window, BackedImagePtr const& image) {
+  auto& frame = mFrames[mCurrentSlot];
+
+  if (frame.mSwapchainImage) {
+    frame.mSwapchainImage.reset();
+    endFrame(window);
+    return;
+  }
+
+  frame.mUniformBuffer->flush();
+  submit(frame, {}, {}, {*frame.mRenderFinishedSemaphore});
+
+  window->present(image, frame.mRenderFinishedSemaphore, frame.mFrameFinishedFence);
+
+  mLastSubmittedFence = frame.mFrameFinishedFence;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void FrameContext::endFrame(WindowPtr const& window) {
+  auto& frame = mFrames[mCurrentSlot];
+
+  frame.mUniformBuffer->flush();
+  submit(frame, {*window->getImageAvailableSemaphore()},
+      {vk::PipelineStageFlagBits::eColorAttachmentOutput}, {*frame.mRenderFinishedSemaphore},
+      *frame.mFrameFinishedFence);
+
+  window->present(frame.mRenderFinishedSemaphore);
+
+  mLastSubmittedFence = frame.mFrameFinishedFence;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void FrameContext::endFrame() {
+  auto& frame = mFrames[mCurrentSlot];
+
+  frame.mUniformBuffer->flush();
+  submit(frame, {}, {}, {}, *frame.mFrameFinishedFence);
+
+  mLastSubmittedFence = frame.mFrameFinishedFence;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void FrameContext::waitForLastFrame() {
+  if (mLastSubmittedFence) {
+    mDevice->waitForFences(*mLastSubmittedFence);
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void FrameContext::setFrameRateLimit(double framesPerSecond) {
+  mFrameRateLimit = framesPerSecond;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+double FrameContext::getFrameRateLimit() const {
+  return mFrameRateLimit;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void FrameContext::releaseLater(std::shared_ptr<void> const& object) {
+  mFrames[mCurrentSlot].mDeferredReleases.push_back(object);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void FrameContext::waitIdle() {
+  for (auto& frame : mFrames) {
+    mDevice->waitForFences(*frame.mFrameFinishedFence);
+    frame.mReadbackManager->resolve();
+    frame.mDeferredReleases.clear();
+  }
+
+  mDevice->getDeletionQueue()->releaseFrames(mFrameIndex);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+FrameContext::Frame& FrameContext::getCurrentFrame() {
+  return mFrames[mCurrentSlot];
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+uint32_t FrameContext::getFrameCount() const {
+  return static_cast<uint32_t>(mFrames.size());
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+uint64_t FrameContext::getFrameIndex() const {
+  return mFrameIndex;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+FrameStatistics::Counters const& FrameContext::getLastFrameStatistics() const {
+  return mLastFrameStatistics;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void FrameContext::submit(Frame& frame, std::vector<vk::Semaphore> waitSemaphores,
+    std::vector<vk::PipelineStageFlags> waitStages,
+    std::vector<vk::Semaphore> const& signalSemaphores, vk::Fence const& fence) {
+
+  // the semaphore of the compute submission has to be waited for, else it would still be signaled
+  // in the next frame of this slot
+  if (frame.mComputeSubmitted) {
+    waitSemaphores.push_back(*frame.mComputeFinishedSemaphore);
+    waitStages.push_back(frame.mComputeWaitStages);
+  }
+
+  frame.mCmd->end();
+
+  // the compute batch has to be submitted first, as its semaphore is waited for
+  auto const& batcher = mDevice->getSubmissionBatcher();
+  batcher->flush(QueueType::eCompute);
+  batcher->enqueue(frame.mCmd, waitSemaphores, waitStages, signalSemaphores);
+  batcher->flush(QueueType::eGeneric, fence);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+} // namespace Illusion::Graphics
@@ -0,0 +1,176 @@
+////////////////////////////////////////////////////////////////////////////////////////////////////
+//                                                                                                //
+//    _)  |  |            _)                This code may be used and modified under the terms    //
+//     |  |  |  |  | (_-<  |   _ \    \     of the MIT license. See the LICENSE file for details. //
+//    _| _| _| \_,_| ___/ _| \___/ _| _|    Copyright (c) 2018-2019 Simon Schneegans              //
+//                                                                                                //
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#ifndef ILLUSION_GRAPHICS_FRAME_CONTEXT_HPP
+#define ILLUSION_GRAPHICS_FRAME_CONTEXT_HPP
+
+#include "CoherentUniformBuffer.hpp"
+#include "FrameStatistics.hpp"
+
+namespace Illusion::Graphics {
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// The FrameContext manages the resources of several frames in flight. Each Frame contains a      //
+// primary CommandBuffer, a CoherentUniformBuffer of fixed size and a growing TransientAllocator  //
+// for transient uniform and storage data, a fence which is signaled when the GPU has finished    //
+// the frame and a semaphore which is signaled when rendering has finished. The Frames are used   //
+// in a round-robin fashion: beginFrame() waits until the GPU has finished the last frame which   //
+// used the same Frame, so the CPU can record up to getFrameCount() frames ahead of the GPU.      //
+// Each Frame also has a ReadbackManager, the data of the reads recorded in a frame is passed to  //
+// their callbacks by the next beginFrame() which uses the same Frame.                            //
+// Objects which may still be used by the GPU can be passed to releaseLater(); they are kept      //
+// alive until the fence of the current frame has been signaled. Furthermore, beginFrame() drives //
+// the DeletionQueue of the Device, so Vulkan objects which are dropped are destroyed only once   //
+// the GPU has finished all frames which may use them. It also resets the FrameStatistics of the  //
+// Device; getLastFrameStatistics() returns what has been counted during the previous frame.      //
+// Each Frame also has a CommandBuffer for the compute queue. Work recorded there is submitted by //
+// submitCompute(); the CommandBuffer of the generic queue waits for it at the given stages. So   //
+// compute work like culling executes concurrently with the rasterization of the previous frame   //
+// if the Device has a separate compute queue. Images and buffers shared between both queues have //
+// to be transferred with CommandBuffer::releaseImage() and acquireImage() (or the buffer         //
+// versions) if the queues belong to different families.                                          //
+// Both CommandBuffers are submitted through the SubmissionBatcher of the Device, so              //
+// CommandBuffers which have been enqueued there during the frame share one vkQueueSubmit per     //
+// queue with them.                                                                               //
+// The FrameContext should be used by the thread which created it, as the CommandBuffers are      //
+// allocated from the vk::CommandPool of this thread.                                             //
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+class FrameContext {
+
+ public:
+  struct Frame {
+    CommandBufferPtr         mCmd;
+    CommandBufferPtr         mComputeCmd;
+    CoherentUniformBufferPtr mUniformBuffer;
+    TransientAllocatorPtr    mTransientAllocator;
+    ReadbackManagerPtr       mReadbackManager;
+    vk::FencePtr             mFrameFinishedFence;
+    vk::SemaphorePtr         mRenderFinishedSemaphore;
+    vk::SemaphorePtr         mComputeFinishedSemaphore;
+
+    // The index of this Frame in the ring of Frames, this is in [0, getFrameCount()). It can be
+    // used to access further per-frame resources of the application.
+    uint32_t mSlot = 0;
+
+    // The number of the frame which is currently recorded with (or processed on) this Frame.
+    uint64_t mFrameIndex = 0;
+
+    // Objects which are released once mFrameFinishedFence has been signaled.
+    std::vector<std::shared_ptr<void>> mDeferredReleases;
+
+    // Set by submitCompute(). If mComputeCmd has been submitted in this frame, the submission of
+    // mCmd waits for mComputeFinishedSemaphore at the given stages.
+    bool                   mComputeSubmitted = false;
+    vk::PipelineStageFlags mComputeWaitStages;
+
+    // Set by acquireImage() if this frame renders directly to a swapchain image.
+    BackedImagePtr mSwapchainImage;
+  };
+
+  // Syntactic sugar to create a std::shared_ptr for this class
+  template <typename... Args>
+  static FrameContextPtr create(Args&&... args) {
+    return std::make_shared<FrameContext>(args...);
+  };
+
+  // frameCount must be in [2, 4]. Each Frame gets a CoherentUniformBuffer of the given size; the
+  // alignment is used for its addData() method and should usually be the
+  // minUniformBufferOffsetAlignment of the PhysicalDevice. The TransientAllocator of each Frame
+  // uses the same alignment; if it is zero, the TransientAllocator chooses one itself. If the
+  // memory of the CoherentUniformBuffers is not coherent, it is flushed by endFrame().
+  FrameContext(DevicePtr const& device, uint32_t frameCount = 2,
+      vk::DeviceSize uniformBufferSize = 65536, vk::DeviceSize uniformBufferAlignment = 0,
+      CoherentUniformBuffer::Memory uniformBufferMemory =
+          CoherentUniformBuffer::Memory::eHostCoherent);
+
+  // Waits until all frames have been processed by the GPU.
+  virtual ~FrameContext();
+
+  // Advances to the next Frame. This waits for the fence of this Frame and resets it, resolves the
+  // ReadbackManager, releases the deferred objects, resets the uniform buffer and the
+  // TransientAllocator and resets and begins the CommandBuffers.
+  Frame& beginFrame();
+
+  // Ends and submits the compute CommandBuffer of the current Frame. The submission of the generic
+  // CommandBuffer in endFrame() waits for it at the given stages, for example eDrawIndirect if
+  // the compute work writes indirect draw commands. If no stages are given, eTopOfPipe is used,
+  // so nothing waits for the compute work. This may be called at most once per frame.
+  void submitCompute(vk::PipelineStageFlags waitStages = {});
+
+  // Returns the image the current Frame should render its output to. If the given image could be
+  // replaced by the next swapchain image of the window (see Swapchain::supportsDirectRendering()),
+  // the swapchain image is acquired and returned. Else the given image is returned and
+  // endFrame(window, image) blits it to the swapchain image.
+  BackedImagePtr const& acquireImage(WindowPtr const& window, BackedImagePtr const& image);
+
+  // Ends and submits the CommandBuffer of the current Frame. The render finished semaphore of the
+  // Frame is signaled. Then the given image is presented on the window; the fence of the Frame is
+  // signaled when this is done. If acquireImage() has returned a swapchain image in this frame,
+  // this behaves like endFrame(window) instead.
+  void endFrame(WindowPtr const& window, BackedImagePtr const& image);
+
+  // Ends and submits the CommandBuffer of the current Frame which rendered directly into the image
+  // returned by Window::acquireImage(). The submission waits for the image to become available and
+  // the fence of the Frame is signaled once it has been processed. Then the image is presented.
+  void endFrame(WindowPtr const& window);
+
+  // Ends and submits the CommandBuffer of the current Frame without presenting anything. The fence
+  // of the Frame is signaled when the CommandBuffer has been processed.
+  void endFrame();
+
+  // Blocks until the GPU has finished the last submitted frame, including the blit to the swapchain
+  // image if Window::present() was used. Call this before sampling input (Window::update()) to
+  // keep the input latency low; the CPU will not run ahead of the GPU then.
+  void waitForLastFrame();
+
+  // If set to a value greater than zero, beginFrame() sleeps so that frames are not started more
+  // often than the given number of times per second. This can be used to save power or to keep
+  // a steady frame pacing below the refresh rate.
+  void   setFrameRateLimit(double framesPerSecond);
+  double getFrameRateLimit() const;
+
+  // Keeps the given object alive until the GPU has finished the current frame.
+  void releaseLater(std::shared_ptr<void> const& object);
+
+  // Blocks until the GPU has finished all frames, resolves their ReadbackManagers and releases all
+  // deferred objects.
+  void waitIdle();
+
+  Frame&   getCurrentFrame();
+  uint32_t getFrameCount() const;
+
+  // Returns the number of the current frame. This is incremented by each call to beginFrame().
+  uint64_t getFrameIndex() const;
+
+  // Returns the FrameStatistics counters of the Device accumulated between the last two calls to
+  // beginFrame(). This includes all work recorded or submitted by other threads in this time.
+  FrameStatistics::Counters const& getLastFrameStatistics() const;
+
+ private:
+  // Ends and submits the generic CommandBuffer of the Frame. It waits for the compute
+  // CommandBuffer as well if submitCompute() has been called. The batches of the compute and the
+  // generic queue of the SubmissionBatcher are flushed.
+  void submit(Frame& frame, std::vector<vk::Semaphore> waitSemaphores,
+      std::vector<vk::PipelineStageFlags> waitStages,
+      std::vector<vk::Semaphore> const& signalSemaphores, vk::Fence const& fence = nullptr);
+
+  DevicePtr          mDevice;
+  std::vector<Frame> mFrames;
+  uint32_t           mCurrentSlot    = 0;
+  uint64_t           mFrameIndex     = 0;
+  double             mFrameRateLimit = 0.0;
+  double             mLastFrameStart = 0.0;
+  vk::FencePtr       mLastSubmittedFence;
+
+  FrameStatistics::Counters mLastFrameStatistics;
+};
+
+} // namespace Illusion::Graphics
+
+#endif // ILLUSION_GRAPHICS_FRAME_CONTEXT_HPP
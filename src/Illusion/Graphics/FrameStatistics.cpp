@@ -0,0 +1,87 @@
+////////////////////////////////////////////////////////////////////////////////////////////////////
+//                                                                                                //
+//    _)  |  |            _)                This code may be used and modified under the terms    //
+//     |  |  |  |  | (_-<  |   _ \    \     of the MIT license. See the LICENSE file for details. //
+//    _| _| _| \_,_| ___/ _| \___/ _| _|    Copyright (c) 2018-2019 Simon Schneegans              //
+//                                                                                                //
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include "FrameStatistics.hpp"
+
+#include "../Core/Logger.hpp"
+
+#include <iostream>
+
+namespace Illusion::Graphics {
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+FrameStatistics::Counters& FrameStatistics::Counters::operator+=(Counters const& other) {
+  mDraws += other.mDraws;
+  mDispatches += other.mDispatches;
+  mPipelineBinds += other.mPipelineBinds;
+  mPipelineLookups += other.mPipelineLookups;
+  mPipelineCreations += other.mPipelineCreations;
+  mDescriptorSetAllocations += other.mDescriptorSetAllocations;
+  mDescriptorSetUpdates += other.mDescriptorSetUpdates;
+  mDescriptorWrites += other.mDescriptorWrites;
+  mDescriptorSetBinds += other.mDescriptorSetBinds;
+  mBarriers += other.mBarriers;
+  mUploadedBytes += other.mUploadedBytes;
+  mSubmits += other.mSubmits;
+  return *this;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void FrameStatistics::add(Counters const& counters) {
+  std::unique_lock<std::mutex> lock(mMutex);
+  mCounters += counters;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void FrameStatistics::add(uint64_t Counters::*counter, uint64_t value) {
+  std::unique_lock<std::mutex> lock(mMutex);
+  mCounters.*counter += value;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+FrameStatistics::Counters FrameStatistics::get() const {
+  std::unique_lock<std::mutex> lock(mMutex);
+  return mCounters;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+FrameStatistics::Counters FrameStatistics::reset() {
+  std::unique_lock<std::mutex> lock(mMutex);
+  Counters result = mCounters;
+  mCounters       = {};
+  return result;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void FrameStatistics::print(Counters const& counters) {
+  ILLUSION_MESSAGE << "Frame statistics:" << std::endl;
+  ILLUSION_MESSAGE << "  draws:                      " << counters.mDraws << std::endl;
+  ILLUSION_MESSAGE << "  dispatches:                 " << counters.mDispatches << std::endl;
+  ILLUSION_MESSAGE << "  pipeline binds:             " << counters.mPipelineBinds << std::endl;
+  ILLUSION_MESSAGE << "  pipeline lookups:           " << counters.mPipelineLookups << std::endl;
+  ILLUSION_MESSAGE << "  pipeline creations:         " << counters.mPipelineCreations << std::endl;
+  ILLUSION_MESSAGE << "  descriptor set allocations: " << counters.mDescriptorSetAllocations
+                   << std::endl;
+  ILLUSION_MESSAGE << "  descriptor set updates:     " << counters.mDescriptorSetUpdates
+                   << std::endl;
+  ILLUSION_MESSAGE << "  descriptor writes:          " << counters.mDescriptorWrites << std::endl;
+  ILLUSION_MESSAGE << "  descriptor set binds:       " << counters.mDescriptorSetBinds << std::endl;
+  ILLUSION_MESSAGE << "  barriers:                   " << counters.mBarriers << std::endl;
+  ILLUSION_MESSAGE << "  uploaded bytes:             " << counters.mUploadedBytes << std::endl;
+  ILLUSION_MESSAGE << "  submits:                    " << counters.mSubmits << std::endl;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+} // namespace Illusion::Graphics
@@ -0,0 +1,93 @@
+////////////////////////////////////////////////////////////////////////////////////////////////////
+//                                                                                                //
+//    _)  |  |            _)                This code may be used and modified under the terms    //
+//     |  |  |  |  | (_-<  |   _ \    \     of the MIT license. See the LICENSE file for details. //
+//    _| _| _| \_,_| ___/ _| \___/ _| _|    Copyright (c) 2018-2019 Simon Schneegans              //
+//                                                                                                //
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#ifndef ILLUSION_GRAPHICS_FRAME_STATISTICS_HPP
+#define ILLUSION_GRAPHICS_FRAME_STATISTICS_HPP
+
+#include "fwd.hpp"
+
+#include <mutex>
+
+namespace Illusion::Graphics {
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// The FrameStatistics of a Device count how much work has been recorded and submitted, so that   //
+// regressions like redundant descriptor set updates can be spotted without a profiler. Each      //
+// CommandBuffer counts its commands locally and adds them here when end() is called; rare events //
+// like pipeline creations, descriptor set allocations, uploads and submissions are added         //
+// directly. The FrameContext calls reset() in beginFrame(), its getLastFrameStatistics() returns //
+// the counters of the previous frame. All methods are thread-safe.                               //
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+class FrameStatistics {
+
+ public:
+  struct Counters {
+    // Indirect draws are counted once per recorded command.
+    uint64_t mDraws      = 0;
+    uint64_t mDispatches = 0;
+
+    // mPipelineLookups is the number of PipelineCache queries by draws and dispatches,
+    // mPipelineCreations the number of vk::Pipelines which have actually been created. The
+    // difference are cache hits.
+    uint64_t mPipelineBinds     = 0;
+    uint64_t mPipelineLookups   = 0;
+    uint64_t mPipelineCreations = 0;
+
+    // mDescriptorSetAllocations counts vkAllocateDescriptorSets calls, mDescriptorSetUpdates the
+    // descriptor sets which had to be (re-)written or pushed and mDescriptorWrites the individual
+    // descriptors written in these updates.
+    uint64_t mDescriptorSetAllocations = 0;
+    uint64_t mDescriptorSetUpdates     = 0;
+    uint64_t mDescriptorWrites         = 0;
+    uint64_t mDescriptorSetBinds       = 0;
+
+    // The number of recorded vkCmdPipelineBarrier calls.
+    uint64_t mBarriers = 0;
+
+    // Bytes copied to the GPU by the UploadManager or by mapping.
+    uint64_t mUploadedBytes = 0;
+
+    // The number of queue submissions.
+    uint64_t mSubmits = 0;
+
+    Counters& operator+=(Counters const& other);
+  };
+
+  // Syntactic sugar to create a std::shared_ptr for this class
+  template <typename... Args>
+  static FrameStatisticsPtr create(Args&&... args) {
+    return std::make_shared<FrameStatistics>(args...);
+  };
+
+  FrameStatistics() = default;
+
+  // Adds all given counters.
+  void add(Counters const& counters);
+
+  // Adds the value to a single counter, for example:
+  // statistics->add(&FrameStatistics::Counters::mSubmits);
+  void add(uint64_t Counters::*counter, uint64_t value = 1);
+
+  // Returns the counters accumulated since the last call to reset().
+  Counters get() const;
+
+  // Returns the counters accumulated since the last call and sets them to zero.
+  Counters reset();
+
+  // Prints the given counters with ILLUSION_MESSAGE.
+  static void print(Counters const& counters);
+
+ private:
+  Counters           mCounters;
+  mutable std::mutex mMutex;
+};
+
+} // namespace Illusion::Graphics
+
+#endif // ILLUSION_GRAPHICS_FRAME_STATISTICS_HPP
@@ -11,6 +11,7 @@
 #include "../Core/Logger.hpp"
 #include "BackedImage.hpp"
 #include "Device.hpp"
+#include "RenderTargetPool.hpp"
 #include "Utils.hpp"
 
 #include <iostream>
@@ -20,14 +21,23 @@ namespace Illusion::Graphics {
 ////////////////////////////////////////////////////////////////////////////////////////////////////
 
 Framebuffer::Framebuffer(DevicePtr const& device, vk::RenderPassPtr const& renderPass,
-    glm::uvec2 const& extent, std::vector<vk::Format> const& attachments)
+    glm::uvec2 const& extent, std::vector<vk::Format> const& attachments,
+    std::vector<BackedImagePtr> const& images, std::vector<bool> const& transient,
+    std::vector<vk::SampleCountFlagBits> const& samples, uint32_t layers, bool multiview)
     : mDevice(device)
     , mRenderPass(renderPass)
     , mExtent(extent) {
 
   ILLUSION_TRACE << "Creating Framebuffer." << std::endl;
 
-  for (auto attachment : attachments) {
+  for (size_t i(0); i < attachments.size(); ++i) {
+    if (i < images.size() && images[i]) {
+      mImageStore.push_back(images[i]);
+      continue;
+    }
+
+    auto attachment = attachments[i];
+
     vk::ImageAspectFlags aspect;
 
     if (Utils::isDepthOnlyFormat(attachment)) {
@@ -40,16 +50,29 @@ Framebuffer::Framebuffer(DevicePtr const& device, vk::RenderPassPtr const& rende
     }
 
     // eTransferSrc is actually only required for the attachment which will be blitted to the
-    // swapchain images
-    vk::ImageUsageFlags usage =
-        vk::ImageUsageFlagBits::eColorAttachment | vk::ImageUsageFlagBits::eTransferSrc;
+    // swapchain images; color attachments can be sampled, for example by a PostProcessor
+    vk::ImageUsageFlags usage = vk::ImageUsageFlagBits::eColorAttachment |
+                                vk::ImageUsageFlagBits::eTransferSrc |
+                                vk::ImageUsageFlagBits::eSampled;
     vk::ImageLayout layout = vk::ImageLayout::eColorAttachmentOptimal;
 
+    // depth attachments can be sampled, for example for building a Gltf::Culler's depth pyramid
     if (Utils::isDepthFormat(attachment)) {
-      usage  = vk::ImageUsageFlagBits::eDepthStencilAttachment;
+      usage  = vk::ImageUsageFlagBits::eDepthStencilAttachment | vk::ImageUsageFlagBits::eSampled;
       layout = vk::ImageLayout::eDepthStencilAttachmentOptimal;
     }
 
+    vk::MemoryPropertyFlags properties = vk::MemoryPropertyFlagBits::eDeviceLocal;
+
+    // transient attachments can neither be sampled nor be copied, only input attachments are okay
+    if (i < transient.size() && transient[i]) {
+      usage = Utils::isDepthFormat(attachment) ? vk::ImageUsageFlagBits::eDepthStencilAttachment
+                                               : vk::ImageUsageFlagBits::eColorAttachment;
+      usage |= vk::ImageUsageFlagBits::eTransientAttachment;
+      usage |= vk::ImageUsageFlagBits::eInputAttachment;
+      properties |= vk::MemoryPropertyFlagBits::eLazilyAllocated;
+    }
+
     vk::ImageCreateInfo imageInfo;
     imageInfo.imageType     = vk::ImageType::e2D;
     imageInfo.format        = attachment;
@@ -57,17 +80,28 @@ Framebuffer::Framebuffer(DevicePtr const& device, vk::RenderPassPtr const& rende
     imageInfo.extent.height = extent.y;
     imageInfo.extent.depth  = 1;
     imageInfo.mipLevels     = 1;
-    imageInfo.arrayLayers   = 1;
-    imageInfo.samples       = vk::SampleCountFlagBits::e1;
+    imageInfo.arrayLayers   = layers;
+    imageInfo.samples       = i < samples.size() ? samples[i] : vk::SampleCountFlagBits::e1;
     imageInfo.tiling        = vk::ImageTiling::eOptimal;
     imageInfo.usage         = usage;
     imageInfo.sharingMode   = vk::SharingMode::eExclusive;
     imageInfo.initialLayout = vk::ImageLayout::eUndefined;
 
-    auto image = mDevice->createBackedImage(imageInfo, vk::ImageViewType::e2D, aspect,
-        vk::MemoryPropertyFlagBits::eDeviceLocal, layout);
+    // the RenderTargetPool only contains images with a single layer
+    if (layers > 1) {
+      mImageStore.push_back(mDevice->createBackedImage(
+          imageInfo, vk::ImageViewType::e2DArray, aspect, properties, layout));
+      continue;
+    }
+
+    auto image = mDevice->getRenderTargetPool()->acquire(imageInfo, aspect, properties, layout);
 
     mImageStore.push_back(image);
+    mPooledImages.push_back(image);
+  }
+
+  if (!mRenderPass) {
+    return;
   }
 
   std::vector<vk::ImageView> imageViews(mImageStore.size());
@@ -82,7 +116,7 @@ Framebuffer::Framebuffer(DevicePtr const& device, vk::RenderPassPtr const& rende
   info.pAttachments    = imageViews.data();
   info.width           = mExtent.x;
   info.height          = mExtent.y;
-  info.layers          = 1;
+  info.layers          = multiview ? 1 : layers;
 
   mFramebuffer = mDevice->createFramebuffer(info);
 }
@@ -91,6 +125,10 @@ Framebuffer::Framebuffer(DevicePtr const& device, vk::RenderPassPtr const& rende
 
 Framebuffer::~Framebuffer() {
   ILLUSION_TRACE << "Deleting Framebuffer." << std::endl;
+
+  for (auto const& image : mPooledImages) {
+    mDevice->getRenderTargetPool()->release(image);
+  }
 }
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -26,8 +26,23 @@ class Framebuffer {
     return std::make_shared<Framebuffer>(args...);
   };
 
+  // For each attachment format, a new BackedImage is created unless a non-null image is given at
+  // the same position in the images vector. If the transient vector contains true at this
+  // position, the image is only usable as attachment: it is created with eTransientAttachment
+  // usage and lazily allocated memory, if supported by the Device. The samples vector contains the
+  // sample count of each created image; if it is shorter, single-sampled images are created.
+  // The created images are acquired from the RenderTargetPool of the Device and released to it
+  // when the Framebuffer is destroyed, so do not keep references to them. If renderPass is
+  // nullptr, only the images are created; this is used for dynamic rendering.
+  // With more than one layer, the created images are layered as well and are not pooled; given
+  // images need a vk::ImageViewType::e2DArray view with at least that many layers. Set multiview
+  // if the renderPass has a view mask; the layers are then addressed by the views and the
+  // vk::Framebuffer itself has a single layer.
   Framebuffer(DevicePtr const& device, vk::RenderPassPtr const& renderPass,
-      glm::uvec2 const& extent, std::vector<vk::Format> const& attachments);
+      glm::uvec2 const& extent, std::vector<vk::Format> const& attachments,
+      std::vector<BackedImagePtr> const& images = {}, std::vector<bool> const& transient = {},
+      std::vector<vk::SampleCountFlagBits> const& samples = {}, uint32_t layers = 1,
+      bool multiview = false);
 
   virtual ~Framebuffer();
 
@@ -45,6 +60,7 @@ class Framebuffer {
 
   vk::FramebufferPtr          mFramebuffer;
   std::vector<BackedImagePtr> mImageStore;
+  std::vector<BackedImagePtr> mPooledImages;
 };
 
 } // namespace Illusion::Graphics
@@ -0,0 +1,459 @@
+////////////////////////////////////////////////////////////////////////////////////////////////////
+//                                                                                                //
+//    _)  |  |            _)                This code may be used and modified under the terms    //
+//     |  |  |  |  | (_-<  |   _ \    \     of the MIT license. See the LICENSE file for details. //
+//    _| _| _| \_,_| ___/ _| \___/ _| _|    Copyright (c) 2018-2019 Simon Schneegans              //
+//                                                                                                //
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include "GeometryArena.hpp"
+
+#include "../Core/Logger.hpp"
+#include "BackedBuffer.hpp"
+#include "CommandBuffer.hpp"
+#include "DeletionQueue.hpp"
+#include "Device.hpp"
+#include "PhysicalDevice.hpp"
+#include "QueuePool.hpp"
+#include "UploadManager.hpp"
+
+#include <algorithm>
+#include <iostream>
+#include <limits>
+
+namespace Illusion::Graphics {
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+GeometryArena::GeometryArena(Device const* device,
+    std::vector<vk::DeviceSize> const& vertexStrides, uint32_t vertexCapacity,
+    uint32_t indexCapacity)
+    : mDevice(device)
+    , mVertexStrides(vertexStrides)
+    , mVertexCapacity(vertexCapacity)
+    , mIndexCapacity(indexCapacity) {
+
+  ILLUSION_TRACE << "Creating GeometryArena." << std::endl;
+
+  createBuffers();
+
+  mFreeVertices[0] = mVertexCapacity;
+  mFreeIndices[0]  = mIndexCapacity;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+GeometryArena::~GeometryArena() {
+  ILLUSION_TRACE << "Deleting GeometryArena." << std::endl;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+GeometryArena::AllocationPtr GeometryArena::allocate(uint32_t vertexCount, uint32_t indexCount) {
+  std::lock_guard<std::mutex> lock(mMutex);
+
+  auto allocation          = std::make_shared<Allocation>();
+  allocation->mVertexCount = vertexCount;
+  allocation->mIndexCount  = indexCount;
+
+  // the new space is appended to the free range at the end, so the allocation cannot fail after
+  // growing
+  if (!allocateRange(mFreeVertices, vertexCount, allocation->mFirstVertex)) {
+    if (!grow(uint64_t(mVertexCapacity) + std::max(mVertexCapacity, vertexCount),
+            mIndexCapacity)) {
+      return nullptr;
+    }
+    allocateRange(mFreeVertices, vertexCount, allocation->mFirstVertex);
+  }
+
+  if (!allocateRange(mFreeIndices, indexCount, allocation->mFirstIndex)) {
+    if (!grow(mVertexCapacity, uint64_t(mIndexCapacity) + std::max(mIndexCapacity, indexCount))) {
+      freeRange(mFreeVertices, allocation->mFirstVertex, vertexCount);
+      return nullptr;
+    }
+    allocateRange(mFreeIndices, indexCount, allocation->mFirstIndex);
+  }
+
+  mAllocations.insert(allocation);
+
+  return allocation;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void GeometryArena::free(AllocationPtr const& allocation) {
+  uint64_t generation;
+
+  {
+    std::lock_guard<std::mutex> lock(mMutex);
+
+    if (mAllocations.erase(allocation) == 0) {
+      throw std::runtime_error(
+          "Failed to free geometry: The allocation has not been created by this arena!");
+    }
+
+    generation = mGeneration;
+  }
+
+  // The ranges may still be read by the GPU in the current frame. If the arena is compacted in the
+  // meantime, they are part of the free space at the end already.
+  Allocation ranges = *allocation;
+  mDevice->getDeletionQueue()->push([this, ranges, generation]() {
+    std::lock_guard<std::mutex> lock(mMutex);
+    if (generation != mGeneration) {
+      return;
+    }
+
+    freeRange(mFreeVertices, ranges.mFirstVertex, ranges.mVertexCount);
+    freeRange(mFreeIndices, ranges.mFirstIndex, ranges.mIndexCount);
+
+    // the free range at the end does not count as a gap
+    if (getGapCount(mFreeVertices, mVertexCapacity) > COMPACTION_THRESHOLD * mVertexCapacity ||
+        getGapCount(mFreeIndices, mIndexCapacity) > COMPACTION_THRESHOLD * mIndexCapacity) {
+      mCompactionPending = true;
+    }
+  });
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+uint64_t GeometryArena::uploadVertices(
+    uint32_t stream, vk::DeviceSize dataSize, const void* data, vk::DeviceSize dstOffset) {
+  std::lock_guard<std::mutex> lock(mMutex);
+
+  // grow() waits for the uploads recorded before it replaces the buffers
+  auto const& buffer = mVertexBuffers.at(stream);
+
+  buffer->mUploadTicket =
+      mDevice->getUploadManager()->uploadToBuffer(buffer, dataSize, data, dstOffset);
+  return buffer->mUploadTicket;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+uint64_t GeometryArena::uploadIndices(
+    vk::DeviceSize dataSize, const void* data, vk::DeviceSize dstOffset) {
+  std::lock_guard<std::mutex> lock(mMutex);
+
+  mIndexBuffer->mUploadTicket =
+      mDevice->getUploadManager()->uploadToBuffer(mIndexBuffer, dataSize, data, dstOffset);
+  return mIndexBuffer->mUploadTicket;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+bool GeometryArena::update(CommandBuffer& cmd) {
+  {
+    std::lock_guard<std::mutex> lock(mMutex);
+    if (!mCompactionPending) {
+      return false;
+    }
+  }
+
+  compact(cmd);
+
+  return true;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void GeometryArena::compact(CommandBuffer& cmd) {
+  std::lock_guard<std::mutex> lock(mMutex);
+
+  auto oldVertexBuffers = mVertexBuffers;
+  auto oldIndexBuffer   = mIndexBuffer;
+
+  createBuffers();
+
+  // the Allocations keep their order, they are just moved together
+  std::vector<AllocationPtr> allocations(mAllocations.begin(), mAllocations.end());
+  std::sort(allocations.begin(), allocations.end(),
+      [](AllocationPtr const& a, AllocationPtr const& b) {
+        return a->mFirstVertex < b->mFirstVertex;
+      });
+
+  std::vector<std::vector<vk::BufferCopy>> vertexCopies(mVertexStrides.size());
+  std::vector<vk::BufferCopy>              indexCopies;
+
+  uint32_t vertexEnd = 0;
+  uint32_t indexEnd  = 0;
+
+  for (auto const& allocation : allocations) {
+    for (size_t i(0); i < mVertexStrides.size() && allocation->mVertexCount > 0; ++i) {
+      vk::DeviceSize stride = mVertexStrides[i];
+      vertexCopies[i].emplace_back(stride * allocation->mFirstVertex, stride * vertexEnd,
+          stride * allocation->mVertexCount);
+    }
+
+    if (allocation->mIndexCount > 0) {
+      indexCopies.emplace_back(sizeof(uint32_t) * allocation->mFirstIndex,
+          sizeof(uint32_t) * indexEnd, sizeof(uint32_t) * allocation->mIndexCount);
+    }
+
+    allocation->mFirstVertex = vertexEnd;
+    allocation->mFirstIndex  = indexEnd;
+
+    vertexEnd += allocation->mVertexCount;
+    indexEnd += allocation->mIndexCount;
+  }
+
+  mFreeVertices.clear();
+  mFreeIndices.clear();
+  freeRange(mFreeVertices, vertexEnd, mVertexCapacity - vertexEnd);
+  freeRange(mFreeIndices, indexEnd, mIndexCapacity - indexEnd);
+
+  mCompactionPending = false;
+  ++mGeneration;
+
+  ILLUSION_DEBUG << "Compacting GeometryArena: " << vertexEnd << " vertices and " << indexEnd
+                 << " indices are in use." << std::endl;
+
+  // the new buffers are read by vertex input, by Gltf::Morphers and by mesh shaders afterwards;
+  // this is not tracked by the CommandBuffer
+  vk::PipelineStageFlags stages = vk::PipelineStageFlagBits::eVertexInput |
+                                  vk::PipelineStageFlagBits::eVertexShader |
+                                  vk::PipelineStageFlagBits::eComputeShader;
+
+  vk::AccessFlags access = vk::AccessFlagBits::eVertexAttributeRead |
+                           vk::AccessFlagBits::eIndexRead | vk::AccessFlagBits::eShaderRead;
+
+  for (size_t i(0); i < mVertexStrides.size(); ++i) {
+    if (!vertexCopies[i].empty()) {
+      cmd.copyBuffer(oldVertexBuffers[i], mVertexBuffers[i], vertexCopies[i]);
+    }
+    cmd.accessBuffer(mVertexBuffers[i], stages, access);
+  }
+
+  if (!indexCopies.empty()) {
+    cmd.copyBuffer(oldIndexBuffer, mIndexBuffer, indexCopies);
+  }
+  cmd.accessBuffer(mIndexBuffer, stages, access);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+BackedBufferPtr GeometryArena::getVertexBuffer(uint32_t stream) const {
+  std::lock_guard<std::mutex> lock(mMutex);
+  return mVertexBuffers.at(stream);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+BackedBufferPtr GeometryArena::getIndexBuffer() const {
+  std::lock_guard<std::mutex> lock(mMutex);
+  return mIndexBuffer;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+vk::DeviceSize GeometryArena::getVertexStride(uint32_t stream) const {
+  return mVertexStrides.at(stream);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+uint32_t GeometryArena::getVertexStreamCount() const {
+  return static_cast<uint32_t>(mVertexStrides.size());
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+uint64_t GeometryArena::getGeneration() const {
+  std::lock_guard<std::mutex> lock(mMutex);
+  return mGeneration;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+uint32_t GeometryArena::getFreeVertexCount() const {
+  std::lock_guard<std::mutex> lock(mMutex);
+
+  uint32_t count = 0;
+  for (auto const& range : mFreeVertices) {
+    count += range.second;
+  }
+  return count;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+uint32_t GeometryArena::getFreeIndexCount() const {
+  std::lock_guard<std::mutex> lock(mMutex);
+
+  uint32_t count = 0;
+  for (auto const& range : mFreeIndices) {
+    count += range.second;
+  }
+  return count;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+bool GeometryArena::allocateRange(FreeRanges& ranges, uint32_t count, uint32_t& offset) {
+  // empty ranges do not need any space
+  if (count == 0) {
+    offset = 0;
+    return true;
+  }
+
+  for (auto it = ranges.begin(); it != ranges.end(); ++it) {
+    if (it->second < count) {
+      continue;
+    }
+
+    offset             = it->first;
+    uint32_t remaining = it->second - count;
+    ranges.erase(it);
+
+    if (remaining > 0) {
+      ranges[offset + count] = remaining;
+    }
+
+    return true;
+  }
+
+  return false;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void GeometryArena::freeRange(FreeRanges& ranges, uint32_t offset, uint32_t count) {
+  if (count == 0) {
+    return;
+  }
+
+  auto next = ranges.lower_bound(offset);
+
+  // merge with the following range
+  if (next != ranges.end() && next->first == offset + count) {
+    count += next->second;
+    next = ranges.erase(next);
+  }
+
+  // merge with the preceding range
+  if (next != ranges.begin()) {
+    auto previous = std::prev(next);
+    if (previous->first + previous->second == offset) {
+      previous->second += count;
+      return;
+    }
+  }
+
+  ranges[offset] = count;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+uint32_t GeometryArena::getGapCount(FreeRanges const& ranges, uint32_t capacity) {
+  uint32_t count = 0;
+  for (auto const& range : ranges) {
+    if (range.first + range.second < capacity) {
+      count += range.second;
+    }
+  }
+  return count;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+bool GeometryArena::grow(uint64_t vertexCapacity, uint64_t indexCapacity) {
+  if (vertexCapacity > std::numeric_limits<uint32_t>::max() ||
+      indexCapacity > std::numeric_limits<uint32_t>::max()) {
+    return false;
+  }
+
+  ILLUSION_DEBUG << "Growing GeometryArena to " << vertexCapacity << " vertices and "
+                 << indexCapacity << " indices." << std::endl;
+
+  // The uploads to the old buffers have to be finished before they are copied. As the arena's
+  // mutex is locked, no further uploads can be recorded to them.
+  auto const& uploadManager = mDevice->getUploadManager();
+  for (auto const& buffer : mVertexBuffers) {
+    uploadManager->wait(buffer->mUploadTicket);
+  }
+  uploadManager->wait(mIndexBuffer->mUploadTicket);
+
+  auto     oldVertexBuffers  = mVertexBuffers;
+  auto     oldIndexBuffer    = mIndexBuffer;
+  uint32_t oldVertexCapacity = mVertexCapacity;
+  uint32_t oldIndexCapacity  = mIndexCapacity;
+
+  mVertexCapacity = static_cast<uint32_t>(vertexCapacity);
+  mIndexCapacity  = static_cast<uint32_t>(indexCapacity);
+
+  createBuffers();
+
+  freeRange(mFreeVertices, oldVertexCapacity, mVertexCapacity - oldVertexCapacity);
+  freeRange(mFreeIndices, oldIndexCapacity, mIndexCapacity - oldIndexCapacity);
+
+  if (mAllocations.empty()) {
+    return true;
+  }
+
+  // The Allocations keep their offsets, so the old buffers are copied as a whole and the DrawLists
+  // stay valid. This cannot be deferred to the next frame, as the Models upload their data right
+  // after allocate(). Previous frames may still write to the old buffers, see Gltf::Morpher; the
+  // old buffers are kept alive by the DeletionQueue for the draws which have been recorded already.
+  auto cmd   = mDevice->allocateCommandBuffer(QueueType::eGeneric);
+  auto fence = mDevice->createFence(vk::FenceCreateFlags());
+
+  cmd->begin({vk::CommandBufferUsageFlagBits::eOneTimeSubmit});
+
+  vk::MemoryBarrier barrier(
+      vk::AccessFlagBits::eShaderWrite | vk::AccessFlagBits::eTransferWrite,
+      vk::AccessFlagBits::eTransferRead);
+  cmd->pipelineBarrier(vk::PipelineStageFlagBits::eAllCommands,
+      vk::PipelineStageFlagBits::eTransfer, vk::DependencyFlagBits(), barrier, nullptr, nullptr);
+
+  for (size_t i(0); i < mVertexStrides.size(); ++i) {
+    cmd->copyBuffer(*oldVertexBuffers[i]->mBuffer, *mVertexBuffers[i]->mBuffer,
+        vk::BufferCopy(0, 0, mVertexStrides[i] * oldVertexCapacity));
+  }
+
+  cmd->copyBuffer(*oldIndexBuffer->mBuffer, *mIndexBuffer->mBuffer,
+      vk::BufferCopy(0, 0, sizeof(uint32_t) * oldIndexCapacity));
+
+  cmd->end();
+
+  vk::SubmitInfo info;
+  info.commandBufferCount = 1;
+  info.pCommandBuffers    = cmd.get();
+
+  mDevice->getQueuePool()->lock(QueueType::eGeneric)->submit(info, *fence);
+  mDevice->getHandle()->waitForFences(*fence, true, ~0);
+
+  return true;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void GeometryArena::createBuffers() {
+  // the vertices are written by Gltf::Morphers and read by mesh shaders, hence all buffers are
+  // storage buffers as well; the transfer source usage is required by compact()
+  vk::BufferUsageFlags usage = vk::BufferUsageFlagBits::eStorageBuffer |
+                               vk::BufferUsageFlagBits::eTransferSrc |
+                               vk::BufferUsageFlagBits::eTransferDst;
+
+  // a Gltf::RayTracingScene builds its acceleration structures directly from these buffers
+  if (mDevice->getPhysicalDevice()->supportsRayQueries()) {
+    usage |= vk::BufferUsageFlagBits::eShaderDeviceAddress |
+             vk::BufferUsageFlagBits::eAccelerationStructureBuildInputReadOnlyKHR;
+  }
+
+  mVertexBuffers.clear();
+
+  // the Models upload their ranges while other ranges are in use, see Gltf::Model::update()
+  for (auto stride : mVertexStrides) {
+    mVertexBuffers.push_back(mDevice->createBackedBuffer(
+        usage | vk::BufferUsageFlagBits::eVertexBuffer, vk::MemoryPropertyFlagBits::eDeviceLocal,
+        stride * mVertexCapacity, nullptr, vk::SharingMode::eConcurrent));
+  }
+
+  mIndexBuffer = mDevice->createBackedBuffer(usage | vk::BufferUsageFlagBits::eIndexBuffer,
+      vk::MemoryPropertyFlagBits::eDeviceLocal, sizeof(uint32_t) * mIndexCapacity, nullptr,
+      vk::SharingMode::eConcurrent);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+} // namespace Illusion::Graphics
@@ -0,0 +1,147 @@
+////////////////////////////////////////////////////////////////////////////////////////////////////
+//                                                                                                //
+//    _)  |  |            _)                This code may be used and modified under the terms    //
+//     |  |  |  |  | (_-<  |   _ \    \     of the MIT license. See the LICENSE file for details. //
+//    _| _| _| \_,_| ___/ _| \___/ _| _|    Copyright (c) 2018-2019 Simon Schneegans              //
+//                                                                                                //
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#ifndef ILLUSION_GRAPHICS_GEOMETRY_ARENA_HPP
+#define ILLUSION_GRAPHICS_GEOMETRY_ARENA_HPP
+
+#include "fwd.hpp"
+
+#include <map>
+#include <mutex>
+#include <set>
+#include <vector>
+
+namespace Illusion::Graphics {
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// The GeometryArena stores the vertices and indices of many meshes in one set of shared buffers. //
+// Gltf::Models loaded with Gltf::LoadOptionBits::eGeometryArena sub-allocate a range of vertices //
+// and a range of uint32_t indices from the arena of their vertex layout (see                     //
+// Device::getGeometryArena()) instead of creating buffers of their own. Their draw commands are  //
+// offset accordingly, so all such Models can be drawn with one vertex and index buffer binding   //
+// and their DrawLists can be combined into one multi-draw.                                       //
+// There is one vertex buffer per vertex stream, all of them are indexed with the same vertex     //
+// offsets. Free ranges are found first-fit and merged with their neighbours when they are freed. //
+// The buffers start small and are replaced by larger ones when an allocation does not fit.       //
+// When free() leaves too much space in the gaps between the Allocations, update() compacts the   //
+// arena in the next frame. This moves the Allocations and increments getGeneration(); DrawLists  //
+// created before refer to outdated ranges then.                                                  //
+// allocate(), free(), the uploads and the getters may be called from any thread. update() and    //
+// compact() have to be called by the thread which records the frame.                             //
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+class GeometryArena {
+
+ public:
+  // The ranges of an Allocation are given in vertices and indices. They are changed by compact(),
+  // hence they should be read whenever draw commands are recorded or data is uploaded.
+  struct Allocation {
+    uint32_t mFirstVertex = 0;
+    uint32_t mVertexCount = 0;
+    uint32_t mFirstIndex  = 0;
+    uint32_t mIndexCount  = 0;
+  };
+
+  typedef std::shared_ptr<Allocation> AllocationPtr;
+
+  // When more than this fraction of the vertex or index capacity is in gaps between Allocations,
+  // the arena is compacted by the next update().
+  static constexpr float COMPACTION_THRESHOLD = 0.25f;
+
+  // Syntactic sugar to create a std::shared_ptr for this class
+  template <typename... Args>
+  static GeometryArenaPtr create(Args&&... args) {
+    return std::make_shared<GeometryArena>(args...);
+  };
+
+  // The GeometryArena is owned by the given Device, hence it only stores a raw pointer to it. There
+  // is one vertex buffer for each of the given strides (in bytes); the buffers initially have room
+  // for the given number of vertices and indices.
+  GeometryArena(Device const* device, std::vector<vk::DeviceSize> const& vertexStrides,
+      uint32_t vertexCapacity = 1 << 16, uint32_t indexCapacity = 1 << 18);
+  virtual ~GeometryArena();
+
+  // Reserves the given number of vertices (in all streams) and indices. If there is no free range
+  // which is large enough, the capacity is at least doubled: the content of the old buffers is
+  // copied to new ones on the generic queue and this blocks until the copy has finished. Returns
+  // nullptr if the capacity would exceed the range of uint32_t.
+  AllocationPtr allocate(uint32_t vertexCount, uint32_t indexCount);
+
+  // Returns the ranges of an Allocation to the arena. As they may still be read by the GPU in the
+  // current frame, they can be allocated again once the frame has been processed, see
+  // DeletionQueue. If this leaves more than COMPACTION_THRESHOLD of the capacity in gaps, the next
+  // update() compacts the arena.
+  void free(AllocationPtr const& allocation);
+
+  // Records uploads of the given data to a vertex stream or to the indices with the UploadManager
+  // of the Device; the offsets are given in bytes. As allocate() may replace the buffers on any
+  // thread, uploads to the Allocations have to be recorded with these methods instead of using
+  // getVertexBuffer() or getIndexBuffer(). The mUploadTicket of the buffer is set and returned.
+  uint64_t uploadVertices(
+      uint32_t stream, vk::DeviceSize dataSize, const void* data, vk::DeviceSize dstOffset);
+  uint64_t uploadIndices(vk::DeviceSize dataSize, const void* data, vk::DeviceSize dstOffset);
+
+  // This should be called once per frame before the DrawLists of the frame are created. It calls
+  // compact() if free() has left too much space in gaps since the last call. Returns true if the
+  // arena has been compacted.
+  bool update(CommandBuffer& cmd);
+
+  // Records copies of all Allocations to the beginning of new buffers, so that all free space is
+  // in one range at the end. The offsets of the Allocations are updated and getVertexBuffer() and
+  // getIndexBuffer() return the new buffers afterwards; the old ones are kept alive by the
+  // DeletionQueue until the current frame has been processed. Uploads to the arena which are
+  // recorded after this call but before the given CommandBuffer is submitted would be overwritten,
+  // hence pending uploads (like Gltf::Model::update()) should be issued before.
+  void compact(CommandBuffer& cmd);
+
+  // The buffers are returned by value, as they are replaced when the arena grows or is compacted.
+  BackedBufferPtr getVertexBuffer(uint32_t stream = 0) const;
+  BackedBufferPtr getIndexBuffer() const;
+  vk::DeviceSize  getVertexStride(uint32_t stream = 0) const;
+  uint32_t        getVertexStreamCount() const;
+
+  // This is incremented by compact(), as it moves the Allocations. DrawLists store the generation
+  // they have been created with, see Gltf::DrawList::isOutdated().
+  uint64_t getGeneration() const;
+
+  // The number of unused vertices and indices, including the gaps between Allocations.
+  uint32_t getFreeVertexCount() const;
+  uint32_t getFreeIndexCount() const;
+
+ private:
+  // Maps the offsets of free ranges to their sizes.
+  typedef std::map<uint32_t, uint32_t> FreeRanges;
+
+  static bool     allocateRange(FreeRanges& ranges, uint32_t count, uint32_t& offset);
+  static void     freeRange(FreeRanges& ranges, uint32_t offset, uint32_t count);
+  static uint32_t getGapCount(FreeRanges const& ranges, uint32_t capacity);
+
+  bool grow(uint64_t vertexCapacity, uint64_t indexCapacity);
+  void createBuffers();
+
+  Device const*               mDevice;
+  std::vector<vk::DeviceSize> mVertexStrides;
+  uint32_t                    mVertexCapacity;
+  uint32_t                    mIndexCapacity;
+
+  std::vector<BackedBufferPtr> mVertexBuffers;
+  BackedBufferPtr              mIndexBuffer;
+
+  std::set<AllocationPtr> mAllocations;
+  FreeRanges              mFreeVertices;
+  FreeRanges              mFreeIndices;
+
+  // This is incremented by compact(), ranges freed before are not returned afterwards.
+  uint64_t           mGeneration        = 0;
+  bool               mCompactionPending = false;
+  mutable std::mutex mMutex;
+};
+
+} // namespace Illusion::Graphics
+
+#endif // ILLUSION_GRAPHICS_GEOMETRY_ARENA_HPP
@@ -0,0 +1,434 @@
+////////////////////////////////////////////////////////////////////////////////////////////////////
+//                                                                                                //
+//    _)  |  |            _)                This code may be used and modified under the terms    //
+//     |  |  |  |  | (_-<  |   _ \    \     of the MIT license. See the LICENSE file for details. //
+//    _| _| _| \_,_| ___/ _| \___/ _| _|    Copyright (c) 2018-2019 Simon Schneegans              //
+//                                                                                                //
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include "GltfBvh.hpp"
+
+#include <algorithm>
+#include <array>
+#include <numeric>
+
+namespace Illusion::Graphics::Gltf {
+
+namespace {
+
+// Leaves with at most this many Items are never split. Larger ones are split if the surface area
+// heuristic estimates that this is cheaper than testing all of their Items.
+const uint32_t MAX_LEAF_SIZE = 4;
+
+// The number of bins per axis in which the split planes are evaluated.
+const uint32_t BIN_COUNT = 16;
+
+float getSurfaceArea(BoundingBox const& box) {
+  if (box.isEmpty()) {
+    return 0.f;
+  }
+
+  glm::vec3 extent = box.mMax - box.mMin;
+  return 2.f * (extent.x * extent.y + extent.y * extent.z + extent.z * extent.x);
+}
+
+// The slab test; invDirection is the component-wise inverse of the ray direction. Returns the
+// distance where the ray enters the box or infinity if the box is missed within maxDistance.
+float intersect(glm::vec3 const& min, glm::vec3 const& max, glm::vec3 const& origin,
+    glm::vec3 const& invDirection, float maxDistance) {
+  glm::vec3 t0    = (min - origin) * invDirection;
+  glm::vec3 t1    = (max - origin) * invDirection;
+  glm::vec3 tMin  = glm::min(t0, t1);
+  glm::vec3 tMax  = glm::max(t0, t1);
+  float     tNear = std::max(std::max(tMin.x, tMin.y), std::max(tMin.z, 0.f));
+  float     tFar  = std::min(std::min(tMax.x, tMax.y), std::min(tMax.z, maxDistance));
+  return tNear <= tFar ? tNear : std::numeric_limits<float>::infinity();
+}
+
+bool overlaps(glm::vec3 const& min, glm::vec3 const& max, BoundingBox const& box) {
+  return glm::all(glm::lessThanEqual(min, box.mMax)) &&
+         glm::all(glm::lessThanEqual(box.mMin, max));
+}
+
+// The box is outside if the corner which is furthest along the normal of one of the planes is
+// behind that plane.
+bool isInFrustum(
+    glm::vec3 const& min, glm::vec3 const& max, std::array<glm::vec4, 6> const& planes) {
+  for (auto const& plane : planes) {
+    glm::vec3 corner(plane.x > 0.f ? max.x : min.x, plane.y > 0.f ? max.y : min.y,
+        plane.z > 0.f ? max.z : min.z);
+
+    if (glm::dot(glm::vec3(plane), corner) + plane.w < 0.f) {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+} // namespace
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+Bvh::Bvh(ModelPtr const& model)
+    : mModel(model) {
+
+  for (Node const* node : mModel->getHierarchy()) {
+    if (!node->mMesh) {
+      continue;
+    }
+
+    auto const& primitives = node->mMesh->mPrimitives;
+
+    for (uint32_t i(0); i < primitives.size(); ++i) {
+      if (primitives[i].mBoundingBox.isEmpty()) {
+        continue;
+      }
+
+      mItems.push_back({node, i});
+      mLocalBounds.push_back(primitives[i].mBoundingBox);
+      mHierarchyIndices.push_back(node->mHierarchyIndex);
+    }
+  }
+
+  mBounds.resize(mItems.size());
+  updateItemBounds(nullptr);
+  rebuild();
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+Bvh::~Bvh() = default;
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+ModelPtr const& Bvh::getModel() const {
+  return mModel;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void Bvh::refit() {
+  updateItemBounds(nullptr);
+  updateNodeBounds();
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void Bvh::refit(std::vector<glm::mat4> const& globalTransforms) {
+  if (globalTransforms.size() != mModel->getHierarchy().size()) {
+    throw std::runtime_error("Failed to refit Bvh: The number of global transformations does not "
+                             "match the number of Nodes!");
+  }
+
+  updateItemBounds(&globalTransforms);
+  updateNodeBounds();
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void Bvh::rebuild() {
+  mItemOrder.resize(mItems.size());
+  std::iota(mItemOrder.begin(), mItemOrder.end(), 0u);
+
+  mTreeNodes.clear();
+
+  if (mItems.empty()) {
+    return;
+  }
+
+  std::vector<glm::vec3> centroids(mItems.size());
+  for (size_t i(0); i < mItems.size(); ++i) {
+    centroids[i] = (mBounds[i].mMin + mBounds[i].mMax) * 0.5f;
+  }
+
+  // a binary tree with n leaves has 2n - 1 nodes
+  mTreeNodes.reserve(2 * mItems.size() - 1);
+  mTreeNodes.push_back({glm::vec3(0.f), 0, glm::vec3(0.f), static_cast<uint32_t>(mItems.size())});
+
+  std::vector<uint32_t> stack{0};
+
+  while (!stack.empty()) {
+    uint32_t node = stack.back();
+    stack.pop_back();
+
+    subdivide(node, centroids);
+
+    if (mTreeNodes[node].mCount == 0) {
+      stack.push_back(mTreeNodes[node].mFirst);
+      stack.push_back(mTreeNodes[node].mFirst + 1);
+    }
+  }
+
+  updateNodeBounds();
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+std::optional<Bvh::Hit> Bvh::raycast(
+    glm::vec3 const& origin, glm::vec3 const& direction, float maxDistance) const {
+
+  if (mTreeNodes.empty()) {
+    return std::nullopt;
+  }
+
+  const float infinity = std::numeric_limits<float>::infinity();
+
+  // divisions by zero result in infinities, which the slab test handles correctly
+  glm::vec3          invDirection = 1.f / direction;
+  std::optional<Hit> hit;
+
+  if (intersect(mTreeNodes[0].mMin, mTreeNodes[0].mMax, origin, invDirection, maxDistance) ==
+      infinity) {
+    return hit;
+  }
+
+  std::vector<uint32_t> stack{0};
+
+  while (!stack.empty()) {
+    auto const& node = mTreeNodes[stack.back()];
+    stack.pop_back();
+
+    if (node.mCount > 0) {
+      for (uint32_t i(node.mFirst); i < node.mFirst + node.mCount; ++i) {
+        auto const& bounds = mBounds[mItemOrder[i]];
+        float distance = intersect(bounds.mMin, bounds.mMax, origin, invDirection, maxDistance);
+
+        if (distance < infinity) {
+          maxDistance = distance;
+          hit         = Hit{mItems[mItemOrder[i]], distance};
+        }
+      }
+      continue;
+    }
+
+    std::array<uint32_t, 2> children = {node.mFirst, node.mFirst + 1};
+    std::array<float, 2>    distances;
+
+    for (size_t i(0); i < 2; ++i) {
+      auto const& child = mTreeNodes[children[i]];
+      distances[i] = intersect(child.mMin, child.mMax, origin, invDirection, maxDistance);
+    }
+
+    if (distances[1] < distances[0]) {
+      std::swap(children[0], children[1]);
+      std::swap(distances[0], distances[1]);
+    }
+
+    // the nearer child is visited first, as its hits may allow skipping the other one
+    for (size_t i(2); i-- > 0;) {
+      if (distances[i] < infinity) {
+        stack.push_back(children[i]);
+      }
+    }
+  }
+
+  return hit;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+template <typename Predicate>
+void Bvh::collect(Predicate const& isVisible, std::vector<Item>& result) const {
+  if (mTreeNodes.empty()) {
+    return;
+  }
+
+  std::vector<uint32_t> stack{0};
+
+  while (!stack.empty()) {
+    auto const& node = mTreeNodes[stack.back()];
+    stack.pop_back();
+
+    if (!isVisible(node.mMin, node.mMax)) {
+      continue;
+    }
+
+    if (node.mCount > 0) {
+      for (uint32_t i(node.mFirst); i < node.mFirst + node.mCount; ++i) {
+        auto const& bounds = mBounds[mItemOrder[i]];
+        if (isVisible(bounds.mMin, bounds.mMax)) {
+          result.push_back(mItems[mItemOrder[i]]);
+        }
+      }
+    } else {
+      stack.push_back(node.mFirst + 1);
+      stack.push_back(node.mFirst);
+    }
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void Bvh::query(BoundingBox const& box, std::vector<Item>& result) const {
+  collect(
+      [&box](glm::vec3 const& min, glm::vec3 const& max) { return overlaps(min, max, box); },
+      result);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void Bvh::query(glm::mat4 const& viewProjection, std::vector<Item>& result) const {
+
+  // the columns of the transposed matrix are the rows of the view-projection matrix, the planes
+  // correspond to -w <= x <= w, -w <= y <= w and 0 <= z <= w in clip space
+  glm::mat4 rows = glm::transpose(viewProjection);
+
+  std::array<glm::vec4, 6> planes = {rows[3] + rows[0], rows[3] - rows[0], rows[3] + rows[1],
+      rows[3] - rows[1], rows[2], rows[3] - rows[2]};
+
+  collect([&planes](glm::vec3 const& min,
+              glm::vec3 const& max) { return isInFrustum(min, max, planes); },
+      result);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+BoundingBox Bvh::getBoundingBox() const {
+  BoundingBox box;
+
+  if (!mTreeNodes.empty()) {
+    box.mMin = mTreeNodes[0].mMin;
+    box.mMax = mTreeNodes[0].mMax;
+  }
+
+  return box;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+std::vector<Bvh::Item> const& Bvh::getItems() const {
+  return mItems;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void Bvh::updateItemBounds(std::vector<glm::mat4> const* globalTransforms) {
+  for (size_t i(0); i < mItems.size(); ++i) {
+    glm::mat4 const& transform = globalTransforms ? (*globalTransforms)[mHierarchyIndices[i]]
+                                                  : mItems[i].mNode->mGlobalTransform;
+    mBounds[i] = mLocalBounds[i].getTransformed(transform);
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void Bvh::updateNodeBounds() {
+
+  // children are stored after their parents, hence they are updated first
+  for (size_t i(mTreeNodes.size()); i-- > 0;) {
+    auto& node = mTreeNodes[i];
+
+    if (node.mCount > 0) {
+      BoundingBox box;
+      for (uint32_t j(node.mFirst); j < node.mFirst + node.mCount; ++j) {
+        box.add(mBounds[mItemOrder[j]]);
+      }
+      node.mMin = box.mMin;
+      node.mMax = box.mMax;
+    } else {
+      auto const& left  = mTreeNodes[node.mFirst];
+      auto const& right = mTreeNodes[node.mFirst + 1];
+      node.mMin         = glm::min(left.mMin, right.mMin);
+      node.mMax         = glm::max(left.mMax, right.mMax);
+    }
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void Bvh::subdivide(uint32_t node, std::vector<glm::vec3> const& centroids) {
+  uint32_t first = mTreeNodes[node].mFirst;
+  uint32_t count = mTreeNodes[node].mCount;
+
+  if (count <= MAX_LEAF_SIZE) {
+    return;
+  }
+
+  BoundingBox bounds;
+  BoundingBox centroidBounds;
+  for (uint32_t i(first); i < first + count; ++i) {
+    bounds.add(mBounds[mItemOrder[i]]);
+    centroidBounds.add(centroids[mItemOrder[i]]);
+  }
+
+  glm::vec3 scale = glm::vec3(static_cast<float>(BIN_COUNT)) /
+                    glm::max(centroidBounds.mMax - centroidBounds.mMin, glm::vec3(1e-20f));
+
+  auto getBin = [&](uint32_t item, int axis) {
+    float bin = (centroids[item][axis] - centroidBounds.mMin[axis]) * scale[axis];
+    return std::min(BIN_COUNT - 1, static_cast<uint32_t>(bin));
+  };
+
+  // the expected cost of a leaf is the number of its Items times the probability of hitting it
+  float    bestCost  = static_cast<float>(count) * getSurfaceArea(bounds);
+  int      bestAxis  = -1;
+  uint32_t bestSplit = 0;
+
+  for (int axis(0); axis < 3; ++axis) {
+    if (centroidBounds.mMax[axis] <= centroidBounds.mMin[axis]) {
+      continue;
+    }
+
+    std::array<BoundingBox, BIN_COUNT> binBounds;
+    std::array<uint32_t, BIN_COUNT>    binCounts{};
+
+    for (uint32_t i(first); i < first + count; ++i) {
+      uint32_t bin = getBin(mItemOrder[i], axis);
+      binBounds[bin].add(mBounds[mItemOrder[i]]);
+      ++binCounts[bin];
+    }
+
+    // the split between bin b - 1 and b puts all Items of bins < b to the left; the costs of the
+    // right sides are accumulated first
+    std::array<float, BIN_COUNT> rightCosts{};
+    BoundingBox                  right;
+    uint32_t                     rightCount = 0;
+
+    for (uint32_t b(BIN_COUNT - 1); b > 0; --b) {
+      right.add(binBounds[b]);
+      rightCount += binCounts[b];
+      rightCosts[b] = static_cast<float>(rightCount) * getSurfaceArea(right);
+    }
+
+    BoundingBox left;
+    uint32_t    leftCount = 0;
+
+    for (uint32_t b(1); b < BIN_COUNT; ++b) {
+      left.add(binBounds[b - 1]);
+      leftCount += binCounts[b - 1];
+
+      if (leftCount == 0 || leftCount == count) {
+        continue;
+      }
+
+      float cost = static_cast<float>(leftCount) * getSurfaceArea(left) + rightCosts[b];
+
+      if (cost < bestCost) {
+        bestCost  = cost;
+        bestAxis  = axis;
+        bestSplit = b;
+      }
+    }
+  }
+
+  if (bestAxis < 0) {
+    return;
+  }
+
+  auto begin  = mItemOrder.begin() + first;
+  auto middle = std::partition(begin, begin + count,
+      [&](uint32_t item) { return getBin(item, bestAxis) < bestSplit; });
+
+  uint32_t leftCount = static_cast<uint32_t>(middle - begin);
+
+  mTreeNodes[node].mFirst = static_cast<uint32_t>(mTreeNodes.size());
+  mTreeNodes[node].mCount = 0;
+
+  mTreeNodes.push_back({glm::vec3(0.f), first, glm::vec3(0.f), leftCount});
+  mTreeNodes.push_back({glm::vec3(0.f), first + leftCount, glm::vec3(0.f), count - leftCount});
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+} // namespace Illusion::Graphics::Gltf
@@ -0,0 +1,117 @@
+////////////////////////////////////////////////////////////////////////////////////////////////////
+//                                                                                                //
+//    _)  |  |            _)                This code may be used and modified under the terms    //
+//     |  |  |  |  | (_-<  |   _ \    \     of the MIT license. See the LICENSE file for details. //
+//    _| _| _| \_,_| ___/ _| \___/ _| _|    Copyright (c) 2018-2019 Simon Schneegans              //
+//                                                                                                //
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#ifndef ILLUSION_GRAPHICS_GLTF_BVH_HPP
+#define ILLUSION_GRAPHICS_GLTF_BVH_HPP
+
+#include "GltfModel.hpp"
+
+namespace Illusion::Graphics::Gltf {
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// The Bvh is a bounding volume hierarchy over the Primitives of all Nodes of the default scene   //
+// of a Gltf::Model. It is used on the CPU for picking with rays and for querying the Primitives  //
+// within a box or a view frustum, instead of testing each Primitive::mBoundingBox while          //
+// traversing the Node hierarchy. Each Item of the Bvh is one Primitive of one Node; its bounds   //
+// are the mBoundingBox of the Primitive transformed by the global transformation of the Node.    //
+// The tree is built with a binned surface area heuristic. When the Nodes are animated, refit()   //
+// updates the bounds of all tree nodes in one linear pass without changing the topology; if the  //
+// Nodes move a lot, rebuild() restores the quality of the tree. Skinned and morphed Primitives   //
+// use their undeformed bounds. The vertex data is not kept on the CPU, hence rays are            //
+// intersected with the bounds of the Items, not with their triangles.                            //
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+class Bvh {
+
+ public:
+  // Syntactic sugar to create a std::shared_ptr for this class
+  template <typename... Args>
+  static BvhPtr create(Args&&... args) {
+    return std::make_shared<Bvh>(args...);
+  };
+
+  struct Item {
+    Node const* mNode;
+    uint32_t    mPrimitive; // index into mNode->mMesh->mPrimitives
+  };
+
+  // mDistance is the distance along the ray to the point where it enters the bounds of the Item,
+  // in units of the length of the ray direction. It is zero if the ray starts inside.
+  struct Hit {
+    Item  mItem;
+    float mDistance;
+  };
+
+  // Builds the tree for the current global transformations of the Nodes of the Model.
+  explicit Bvh(ModelPtr const& model);
+  virtual ~Bvh();
+
+  ModelPtr const& getModel() const;
+
+  // Recomputes the bounds of all Items and tree nodes from the current Node::mGlobalTransform of
+  // their Nodes, for example after Model::setAnimationTime(). The second version uses the given
+  // global transformations (in the order of Model::getHierarchy()) instead, for example those of
+  // ModelInstance::getGlobalTransforms().
+  void refit();
+  void refit(std::vector<glm::mat4> const& globalTransforms);
+
+  // Builds a new tree for the current bounds of the Items.
+  void rebuild();
+
+  // Returns the nearest Item whose bounds are hit by the given ray within maxDistance. The
+  // direction does not need to be normalized.
+  std::optional<Hit> raycast(glm::vec3 const& origin, glm::vec3 const& direction,
+      float maxDistance = std::numeric_limits<float>::max()) const;
+
+  // Appends all Items whose bounds intersect the given box to result.
+  void query(BoundingBox const& box, std::vector<Item>& result) const;
+
+  // Appends all Items whose bounds are potentially visible with the given view-projection matrix
+  // to result. Like the Gltf::Culler, this assumes a clip space depth range of [0, 1]. The test is
+  // conservative: some Items close to the edges of the frustum may be reported although they are
+  // outside.
+  void query(glm::mat4 const& viewProjection, std::vector<Item>& result) const;
+
+  // Returns the bounds of all Items.
+  BoundingBox getBoundingBox() const;
+
+  std::vector<Item> const& getItems() const;
+
+ private:
+  // The bounds of an inner node contain those of its two children, which are stored at mFirst and
+  // mFirst + 1. A leaf contains the mCount Items starting at mFirst in mItemOrder. Children are
+  // always stored after their parents, so refit() can update the nodes back to front.
+  struct TreeNode {
+    glm::vec3 mMin;
+    uint32_t  mFirst;
+    glm::vec3 mMax;
+    uint32_t  mCount;
+  };
+
+  void updateItemBounds(std::vector<glm::mat4> const* globalTransforms);
+  void updateNodeBounds();
+  void subdivide(uint32_t node, std::vector<glm::vec3> const& centroids);
+
+  // Appends all Items to result for which isVisible(min, max) returns true for their bounds and
+  // for the bounds of all tree nodes containing them.
+  template <typename Predicate>
+  void collect(Predicate const& isVisible, std::vector<Item>& result) const;
+
+  ModelPtr mModel;
+
+  std::vector<Item>        mItems;
+  std::vector<BoundingBox> mLocalBounds;      // in the coordinate system of the Node
+  std::vector<BoundingBox> mBounds;           // in the coordinate system of the Model
+  std::vector<int32_t>     mHierarchyIndices; // of the Nodes of the Items
+  std::vector<uint32_t>    mItemOrder;
+  std::vector<TreeNode>    mTreeNodes;
+};
+
+} // namespace Illusion::Graphics::Gltf
+
+#endif // ILLUSION_GRAPHICS_GLTF_BVH_HPP
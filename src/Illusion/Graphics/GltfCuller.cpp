@@ -0,0 +1,501 @@
+////////////////////////////////////////////////////////////////////////////////////////////////////
+//                                                                                                //
+//    _)  |  |            _)                This code may be used and modified under the terms    //
+//     |  |  |  |  | (_-<  |   _ \    \     of the MIT license. See the LICENSE file for details. //
+//    _| _| _| \_,_| ___/ _| \___/ _| _|    Copyright (c) 2018-2019 Simon Schneegans              //
+//                                                                                                //
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include "GltfCuller.hpp"
+
+#include "../Core/Logger.hpp"
+#include "CommandBuffer.hpp"
+#include "Device.hpp"
+#include "GltfModel.hpp"
+#include "Shader.hpp"
+#include "ShaderSource.hpp"
+#include "Texture.hpp"
+
+#include <cstring>
+#include <iostream>
+
+namespace Illusion::Graphics::Gltf {
+
+namespace {
+
+// This matches the std140 layout of the CullingUniforms in the shaders below.
+struct CullingUniforms {
+  glm::mat4 mViewProjection;
+  glm::mat4 mHiZViewProjection;
+  uint32_t  mDrawCount;
+  uint32_t  mInstanceCount;
+  uint32_t  mCompact;
+  uint32_t  mOcclusion;
+};
+
+// One invocation per Instance. The visible Instances of each draw are moved to the beginning of
+// its range, the invisible ones to the end. Hence the range stays a permutation of the original
+// Instances and the MeshletDraws, which are not culled, still draw all of them. The first counter
+// of each draw receives the number of its visible Instances.
+const std::string CULL_INSTANCES_SHADER = R"(
+  #version 450
+
+  layout (local_size_x = 64) in;
+
+  struct DrawCommand {
+    uint indexCount;
+    uint instanceCount;
+    uint firstIndex;
+    int  vertexOffset;
+    uint firstInstance;
+  };
+
+  struct InstanceBounds {
+    vec3 mMin;
+    uint mDraw;
+    vec3 mMax;
+    uint mPadding;
+  };
+
+  struct Instance {
+    mat4  mModelMatrix;
+    ivec4 mData;
+  };
+
+  layout (binding = 0) uniform CullingUniforms {
+    mat4 mViewProjection;
+    mat4 mHiZViewProjection;
+    uint mDrawCount;
+    uint mInstanceCount;
+    uint mCompact;
+    uint mOcclusion;
+  } uniforms;
+
+  layout (binding = 1, std430) readonly  buffer InputCommands   { DrawCommand inputCommands[]; };
+  layout (binding = 2, std430) readonly  buffer InputBounds     { InstanceBounds bounds[]; };
+  layout (binding = 3, std430) readonly  buffer InputInstances  { Instance inputInstances[]; };
+  layout (binding = 4, std430) writeonly buffer OutputInstances { Instance outputInstances[]; };
+  layout (binding = 5) uniform sampler2D hiZ;
+  layout (binding = 6, std430)           buffer InstanceCounts  { uint instanceCounts[]; };
+
+  vec3 getCorner(InstanceBounds b, int i) {
+    return mix(b.mMin, b.mMax, vec3(i & 1, (i >> 1) & 1, (i >> 2) & 1));
+  }
+
+  // the box is outside if all of its corners are outside of the same clipping plane
+  bool isInFrustum(InstanceBounds b) {
+    int outside[6] = int[6](0, 0, 0, 0, 0, 0);
+
+    for (int i = 0; i < 8; ++i) {
+      vec4 p = uniforms.mViewProjection * vec4(getCorner(b, i), 1.0);
+      outside[0] += int(p.x < -p.w);
+      outside[1] += int(p.x >  p.w);
+      outside[2] += int(p.y < -p.w);
+      outside[3] += int(p.y >  p.w);
+      outside[4] += int(p.z <  0.0);
+      outside[5] += int(p.z >  p.w);
+    }
+
+    for (int i = 0; i < 6; ++i) {
+      if (outside[i] == 8) {
+        return false;
+      }
+    }
+
+    return true;
+  }
+
+  // the screen space rectangle of the box is covered by at most 2x2 texels of the selected level
+  bool isOccluded(InstanceBounds b) {
+    vec3 ndcMin = vec3( 1e20);
+    vec3 ndcMax = vec3(-1e20);
+
+    for (int i = 0; i < 8; ++i) {
+      vec4 p = uniforms.mHiZViewProjection * vec4(getCorner(b, i), 1.0);
+
+      // the box intersects the near plane
+      if (p.w <= 0.0) {
+        return false;
+      }
+
+      ndcMin = min(ndcMin, p.xyz / p.w);
+      ndcMax = max(ndcMax, p.xyz / p.w);
+    }
+
+    vec2  uvMin = clamp(ndcMin.xy * 0.5 + 0.5, vec2(0.0), vec2(1.0));
+    vec2  uvMax = clamp(ndcMax.xy * 0.5 + 0.5, vec2(0.0), vec2(1.0));
+    vec2  size  = (uvMax - uvMin) * vec2(textureSize(hiZ, 0));
+    float level = ceil(log2(max(max(size.x, size.y), 1.0)));
+    level       = min(level, float(textureQueryLevels(hiZ) - 1));
+
+    float depth = max(max(textureLod(hiZ, uvMin, level).r,
+                          textureLod(hiZ, vec2(uvMax.x, uvMin.y), level).r),
+                      max(textureLod(hiZ, vec2(uvMin.x, uvMax.y), level).r,
+                          textureLod(hiZ, uvMax, level).r));
+
+    return ndcMin.z > depth;
+  }
+
+  void main() {
+    uint i = gl_GlobalInvocationID.x;
+
+    if (i >= uniforms.mInstanceCount) {
+      return;
+    }
+
+    InstanceBounds b       = bounds[i];
+    DrawCommand    command = inputCommands[b.mDraw];
+
+    bool visible = any(greaterThan(b.mMin, b.mMax)) ||
+                   (isInFrustum(b) && (uniforms.mOcclusion == 0 || !isOccluded(b)));
+
+    uint slot = command.firstInstance;
+
+    if (visible) {
+      slot += atomicAdd(instanceCounts[2 * b.mDraw], 1);
+    } else {
+      slot += command.instanceCount - 1 - atomicAdd(instanceCounts[2 * b.mDraw + 1], 1);
+    }
+
+    outputInstances[slot] = inputInstances[i];
+  }
+)";
+
+// One invocation per draw. The instanceCount of each command is replaced by the number of its
+// visible Instances which has been counted by the shader above; draws without any are culled.
+const std::string CULL_SHADER = R"(
+  #version 450
+
+  layout (local_size_x = 64) in;
+
+  struct DrawCommand {
+    uint indexCount;
+    uint instanceCount;
+    uint firstIndex;
+    int  vertexOffset;
+    uint firstInstance;
+  };
+
+  struct Bounds {
+    vec3 mMin;
+    uint mBatch;
+    vec3 mMax;
+    uint mBatchFirstDraw;
+  };
+
+  layout (binding = 0) uniform CullingUniforms {
+    mat4 mViewProjection;
+    mat4 mHiZViewProjection;
+    uint mDrawCount;
+    uint mInstanceCount;
+    uint mCompact;
+    uint mOcclusion;
+  } uniforms;
+
+  layout (binding = 1, std430) readonly  buffer InputCommands  { DrawCommand inputCommands[]; };
+  layout (binding = 2, std430) readonly  buffer InputBounds    { Bounds bounds[]; };
+  layout (binding = 3, std430) writeonly buffer OutputCommands { DrawCommand outputCommands[]; };
+  layout (binding = 4, std430)           buffer DrawCounts     { uint drawCounts[]; };
+  layout (binding = 5, std430) readonly  buffer InstanceCounts { uint instanceCounts[]; };
+
+  void main() {
+    uint i = gl_GlobalInvocationID.x;
+
+    if (i >= uniforms.mDrawCount) {
+      return;
+    }
+
+    DrawCommand command = inputCommands[i];
+    Bounds      b       = bounds[i];
+
+    command.instanceCount = instanceCounts[2 * i];
+
+    if (uniforms.mCompact != 0) {
+      if (command.instanceCount > 0) {
+        uint slot = atomicAdd(drawCounts[b.mBatch], 1);
+        outputCommands[b.mBatchFirstDraw + slot] = command;
+      }
+    } else {
+      outputCommands[i] = command;
+    }
+  }
+)";
+
+const std::string COPY_DEPTH_SHADER = R"(
+  #version 450
+
+  layout (local_size_x = 16, local_size_y = 16) in;
+
+  layout (binding = 0)                    uniform sampler2D inputDepth;
+  layout (binding = 1, r32f) writeonly uniform image2D   outputLevel;
+
+  void main() {
+    ivec2 p = ivec2(gl_GlobalInvocationID.xy);
+
+    if (any(greaterThanEqual(p, imageSize(outputLevel)))) {
+      return;
+    }
+
+    imageStore(outputLevel, p, vec4(texelFetch(inputDepth, p, 0).r));
+  }
+)";
+
+const std::string REDUCE_DEPTH_SHADER = R"(
+  #version 450
+
+  layout (local_size_x = 16, local_size_y = 16) in;
+
+  layout (binding = 0, r32f) readonly  uniform image2D inputLevel;
+  layout (binding = 1, r32f) writeonly uniform image2D outputLevel;
+
+  void main() {
+    ivec2 p       = ivec2(gl_GlobalInvocationID.xy);
+    ivec2 dstSize = imageSize(outputLevel);
+    ivec2 srcSize = imageSize(inputLevel);
+
+    if (any(greaterThanEqual(p, dstSize))) {
+      return;
+    }
+
+    // for odd source sizes, the last texel also covers the remaining row or column
+    ivec2 last = 2 * p + 1 + ivec2(equal(p, dstSize - 1)) * (srcSize & 1);
+    last       = min(last, srcSize - 1);
+
+    float depth = 0.0;
+
+    for (int y = 2 * p.y; y <= last.y; ++y) {
+      for (int x = 2 * p.x; x <= last.x; ++x) {
+        depth = max(depth, imageLoad(inputLevel, ivec2(x, y)).r);
+      }
+    }
+
+    imageStore(outputLevel, p, vec4(depth));
+  }
+)";
+
+uint32_t getGroupCount(uint32_t size, uint32_t groupSize) {
+  return (size + groupSize - 1) / groupSize;
+}
+
+} // namespace
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+Culler::Culler(DevicePtr const& device)
+    : mDevice(device)
+    , mCullInstancesShader(Shader::create(device))
+    , mCullShader(Shader::create(device))
+    , mCopyDepthShader(Shader::create(device))
+    , mReduceDepthShader(Shader::create(device)) {
+
+  ILLUSION_TRACE << "Creating Gltf::Culler." << std::endl;
+
+  mCullInstancesShader->addModule(vk::ShaderStageFlagBits::eCompute,
+      GlslCode::create(CULL_INSTANCES_SHADER, "Gltf::Culler::cullInstances"));
+  mCullShader->addModule(
+      vk::ShaderStageFlagBits::eCompute, GlslCode::create(CULL_SHADER, "Gltf::Culler::cull"));
+  mCopyDepthShader->addModule(vk::ShaderStageFlagBits::eCompute,
+      GlslCode::create(COPY_DEPTH_SHADER, "Gltf::Culler::copyDepth"));
+  mReduceDepthShader->addModule(vk::ShaderStageFlagBits::eCompute,
+      GlslCode::create(REDUCE_DEPTH_SHADER, "Gltf::Culler::reduceDepth"));
+
+  mDepthSampler = mDevice->getSampler(Device::createSamplerInfo(vk::Filter::eNearest,
+      vk::SamplerMipmapMode::eNearest, vk::SamplerAddressMode::eClampToEdge));
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+Culler::~Culler() {
+  ILLUSION_TRACE << "Deleting Gltf::Culler." << std::endl;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void Culler::cull(CommandBuffer& cmd, DrawList& drawList, TransientAllocator& allocator,
+    glm::mat4 const& viewProjection) {
+
+  uint32_t drawCount = drawList.getDrawCount();
+
+  // the commands of DrawLists with direct draws are read on the host, see DrawList::mDirectDraws
+  if (drawCount == 0 || drawList.mDirectDraws) {
+    return;
+  }
+
+  bool compact   = mDevice->getDrawIndexedIndirectCountFunction() != nullptr;
+  bool occlusion = mHiZ && mHiZValid;
+
+  uint32_t instanceCount =
+      static_cast<uint32_t>(drawList.mInstanceBounds.mSize / sizeof(DrawList::InstanceBounds));
+
+  CullingUniforms uniforms;
+  uniforms.mViewProjection    = viewProjection;
+  uniforms.mHiZViewProjection = mHiZViewProjection;
+  uniforms.mDrawCount         = drawCount;
+  uniforms.mInstanceCount     = instanceCount;
+  uniforms.mCompact           = compact ? 1 : 0;
+  uniforms.mOcclusion         = occlusion ? 1 : 0;
+
+  auto uniformData = allocator.addData(uniforms);
+  auto commands    = allocator.allocate(drawList.mDrawCommands.mSize);
+  auto instances   = allocator.allocate(drawList.mInstances.mSize);
+
+  // the counters are incremented by the shaders, so they have to start at zero; there are two
+  // Instance counters for each draw, one for the visible and one for the invisible Instances
+  auto counts =
+      allocator.allocate(sizeof(uint32_t) * std::max<size_t>(drawList.mBatches.size(), 1));
+  auto instanceCounts = allocator.allocate(sizeof(uint32_t) * 2 * drawCount);
+  std::memset(counts.mData, 0, counts.mSize);
+  std::memset(instanceCounts.mData, 0, instanceCounts.mSize);
+
+  if (occlusion) {
+    // the HiZ has been written by the previous frame, this is not tracked by the CommandBuffer
+    cmd.transitionImageLayout(*mHiZ->mImage, vk::ImageLayout::eGeneral, vk::ImageLayout::eGeneral,
+        vk::PipelineStageFlagBits::eComputeShader, vk::PipelineStageFlagBits::eComputeShader,
+        mHiZ->mViewInfo.subresourceRange);
+  }
+
+  cmd.setShader(mCullInstancesShader);
+  cmd.bindingState().setUniformBuffer(
+      uniformData.mBuffer, uniformData.mSize, uniformData.mOffset, 0, 0);
+  cmd.bindingState().setStorageBuffer(drawList.mDrawCommands.mBuffer,
+      drawList.mDrawCommands.mSize, drawList.mDrawCommands.mOffset, 0, 1);
+  cmd.bindingState().setStorageBuffer(drawList.mInstanceBounds.mBuffer,
+      drawList.mInstanceBounds.mSize, drawList.mInstanceBounds.mOffset, 0, 2);
+  cmd.bindingState().setStorageBuffer(drawList.mInstances.mBuffer, drawList.mInstances.mSize,
+      drawList.mInstances.mOffset, 0, 3);
+  cmd.bindingState().setStorageBuffer(
+      instances.mBuffer, instances.mSize, instances.mOffset, 0, 4);
+  cmd.bindingState().setTexture(
+      occlusion ? mHiZ : mDevice->getSinglePixelTexture({255, 255, 255, 255}), 0, 5);
+  cmd.bindingState().setStorageBuffer(
+      instanceCounts.mBuffer, instanceCounts.mSize, instanceCounts.mOffset, 0, 6);
+
+  cmd.dispatch(getGroupCount(instanceCount, 64));
+
+  cmd.bindingState().reset(0);
+
+  cmd.setShader(mCullShader);
+  cmd.bindingState().setUniformBuffer(
+      uniformData.mBuffer, uniformData.mSize, uniformData.mOffset, 0, 0);
+  cmd.bindingState().setStorageBuffer(drawList.mDrawCommands.mBuffer,
+      drawList.mDrawCommands.mSize, drawList.mDrawCommands.mOffset, 0, 1);
+  cmd.bindingState().setStorageBuffer(
+      drawList.mBounds.mBuffer, drawList.mBounds.mSize, drawList.mBounds.mOffset, 0, 2);
+  cmd.bindingState().setStorageBuffer(commands.mBuffer, commands.mSize, commands.mOffset, 0, 3);
+  cmd.bindingState().setStorageBuffer(counts.mBuffer, counts.mSize, counts.mOffset, 0, 4);
+  cmd.bindingState().setStorageBuffer(
+      instanceCounts.mBuffer, instanceCounts.mSize, instanceCounts.mOffset, 0, 5);
+
+  cmd.dispatch(getGroupCount(drawCount, 64));
+
+  cmd.accessBuffer(commands.mBuffer, vk::PipelineStageFlagBits::eDrawIndirect,
+      vk::AccessFlagBits::eIndirectCommandRead);
+  cmd.accessBuffer(counts.mBuffer, vk::PipelineStageFlagBits::eDrawIndirect,
+      vk::AccessFlagBits::eIndirectCommandRead);
+  cmd.accessBuffer(instances.mBuffer, vk::PipelineStageFlagBits::eAllGraphics,
+      vk::AccessFlagBits::eShaderRead);
+
+  cmd.bindingState().reset(0);
+
+  drawList.mDrawCommands = commands;
+  drawList.mInstances    = instances;
+
+  if (compact) {
+    drawList.mDrawCounts = counts;
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void Culler::updateHiZ(
+    CommandBuffer& cmd, BackedImagePtr const& depth, glm::mat4 const& viewProjection) {
+
+  glm::uvec2 extent(depth->mImageInfo.extent.width, depth->mImageInfo.extent.height);
+
+  if (!mHiZ || mHiZ->mImageInfo.extent.width != extent.x ||
+      mHiZ->mImageInfo.extent.height != extent.y) {
+    createHiZ(extent);
+  }
+
+  // the depth attachment has been written by the RenderPass, which is not tracked
+  cmd.transitionImageLayout(*depth->mImage, vk::ImageLayout::eDepthStencilAttachmentOptimal,
+      vk::ImageLayout::eShaderReadOnlyOptimal, vk::PipelineStageFlagBits::eLateFragmentTests,
+      vk::PipelineStageFlagBits::eComputeShader, depth->mViewInfo.subresourceRange);
+
+  // the depth attachment is a BackedImage, it is sampled through a Texture sharing its vk::Image
+  auto depthTexture = std::make_shared<Texture>();
+  static_cast<BackedImage&>(*depthTexture) = *depth;
+  depthTexture->mCurrentLayout             = vk::ImageLayout::eShaderReadOnlyOptimal;
+  depthTexture->mSampler                   = mDepthSampler;
+
+  cmd.setShader(mCopyDepthShader);
+  cmd.bindingState().setTexture(depthTexture, 0, 0);
+  cmd.bindingState().setStorageImage(mHiZ, mHiZViews[0], 0, 1);
+  cmd.dispatch(getGroupCount(extent.x, 16), getGroupCount(extent.y, 16));
+
+  cmd.setShader(mReduceDepthShader);
+
+  for (size_t i(1); i < mHiZViews.size(); ++i) {
+    extent = glm::max(extent / 2u, glm::uvec2(1));
+
+    cmd.bindingState().setStorageImage(mHiZ, mHiZViews[i - 1], 0, 0);
+    cmd.bindingState().setStorageImage(mHiZ, mHiZViews[i], 0, 1);
+    cmd.dispatch(getGroupCount(extent.x, 16), getGroupCount(extent.y, 16));
+  }
+
+  cmd.bindingState().reset(0);
+
+  depth->mCurrentLayout = vk::ImageLayout::eShaderReadOnlyOptimal;
+
+  mHiZViewProjection = viewProjection;
+  mHiZValid          = true;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void Culler::resetHiZ() {
+  mHiZValid = false;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void Culler::createHiZ(glm::uvec2 const& extent) {
+  ILLUSION_DEBUG << "Creating HiZ pyramid of size " << extent.x << "x" << extent.y
+                 << " for Gltf::Culler." << std::endl;
+
+  vk::ImageCreateInfo imageInfo;
+  imageInfo.imageType     = vk::ImageType::e2D;
+  imageInfo.format        = vk::Format::eR32Sfloat;
+  imageInfo.extent.width  = extent.x;
+  imageInfo.extent.height = extent.y;
+  imageInfo.extent.depth  = 1;
+  imageInfo.mipLevels     = Texture::getMaxMipmapLevels(extent.x, extent.y);
+  imageInfo.arrayLayers   = 1;
+  imageInfo.samples       = vk::SampleCountFlagBits::e1;
+  imageInfo.tiling        = vk::ImageTiling::eOptimal;
+  imageInfo.usage         = vk::ImageUsageFlagBits::eStorage | vk::ImageUsageFlagBits::eSampled;
+  imageInfo.sharingMode   = vk::SharingMode::eExclusive;
+  imageInfo.initialLayout = vk::ImageLayout::eUndefined;
+
+  auto samplerInfo   = Device::createSamplerInfo(vk::Filter::eNearest,
+      vk::SamplerMipmapMode::eNearest, vk::SamplerAddressMode::eClampToEdge);
+  samplerInfo.maxLod = static_cast<float>(imageInfo.mipLevels);
+
+  mHiZ = mDevice->createTexture(imageInfo, samplerInfo, vk::ImageViewType::e2D,
+      vk::ImageAspectFlagBits::eColor, vk::ImageLayout::eGeneral);
+
+  mHiZViews.clear();
+
+  for (uint32_t i(0); i < imageInfo.mipLevels; ++i) {
+    auto mipViewInfo                          = mHiZ->mViewInfo;
+    mipViewInfo.subresourceRange.baseMipLevel = i;
+    mipViewInfo.subresourceRange.levelCount   = 1;
+    mHiZViews.push_back(mDevice->createImageView(mipViewInfo));
+  }
+
+  mHiZValid = false;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+} // namespace Illusion::Graphics::Gltf
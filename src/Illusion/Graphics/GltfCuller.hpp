@@ -0,0 +1,85 @@
+////////////////////////////////////////////////////////////////////////////////////////////////////
+//                                                                                                //
+//    _)  |  |            _)                This code may be used and modified under the terms    //
+//     |  |  |  |  | (_-<  |   _ \    \     of the MIT license. See the LICENSE file for details. //
+//    _| _| _| \_,_| ___/ _| \___/ _| _|    Copyright (c) 2018-2019 Simon Schneegans              //
+//                                                                                                //
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#ifndef ILLUSION_GRAPHICS_GLTF_CULLER_HPP
+#define ILLUSION_GRAPHICS_GLTF_CULLER_HPP
+
+#include "fwd.hpp"
+
+#include <glm/glm.hpp>
+
+namespace Illusion::Graphics::Gltf {
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// The Culler removes invisible draws and Instances from a Gltf::DrawList on the GPU. A first     //
+// compute shader tests the InstanceBounds of each Instance against the view frustum and against  //
+// a hierarchical depth buffer (HiZ) which has been built from the depth attachment of the        //
+// previous frame. It moves the visible Instances of each draw to the beginning of the draw's     //
+// range of mInstances. A second compute shader sets the instanceCount of each draw to its number //
+// of visible Instances. If the Device supports VK_KHR_draw_indirect_count, the draws with        //
+// visible Instances are compacted to the beginning of the range of their Batch and the DrawList  //
+// draws them with drawIndexedIndirectCount(). Else the instanceCount of invisible draws is zero, //
+// which still saves all vertex processing.                                                       //
+// As the occlusion test uses the depth of the previous frame, geometry which becomes visible due //
+// to fast camera movements may appear one frame late.                                            //
+// Both cull() and updateHiZ() record compute dispatches, hence they have to be called outside of //
+// RenderPasses. They change the current Shader of the CommandBuffer and reset the bindings of    //
+// descriptor set 0. DrawLists with mDirectDraws are not culled.                                  //
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+class Culler {
+
+ public:
+  // Syntactic sugar to create a std::shared_ptr for this class
+  template <typename... Args>
+  static CullerPtr create(Args&&... args) {
+    return std::make_shared<Culler>(args...);
+  };
+
+  explicit Culler(DevicePtr const& device);
+  virtual ~Culler();
+
+  // Replaces the mDrawCommands and mInstances of the given DrawList with new ranges of the
+  // TransientAllocator containing only the commands and Instances which are visible for the given
+  // view-projection matrix; if compaction is supported, mDrawCounts is set as well. Hence
+  // mInstances has to be bound after this has been called. The barriers required for reading the
+  // commands as indirect buffer are pending afterwards and are recorded by the next
+  // beginRenderPass().
+  void cull(CommandBuffer& cmd, DrawList& drawList, TransientAllocator& allocator,
+      glm::mat4 const& viewProjection);
+
+  // Builds the HiZ pyramid from the given depth attachment. This has to be called after the
+  // RenderPass which wrote the depth has been ended in the same CommandBuffer; the depth has to
+  // be in vk::ImageLayout::eDepthStencilAttachmentOptimal and is left in eShaderReadOnlyOptimal.
+  // The viewProjection is the matrix which has been used for rendering the depth.
+  void updateHiZ(
+      CommandBuffer& cmd, BackedImagePtr const& depth, glm::mat4 const& viewProjection);
+
+  // Disables occlusion culling until updateHiZ() is called again. This is useful after sudden
+  // camera changes.
+  void resetHiZ();
+
+ private:
+  void createHiZ(glm::uvec2 const& extent);
+
+  DevicePtr mDevice;
+  ShaderPtr mCullInstancesShader;
+  ShaderPtr mCullShader;
+  ShaderPtr mCopyDepthShader;
+  ShaderPtr mReduceDepthShader;
+
+  TexturePtr                    mHiZ;
+  std::vector<vk::ImageViewPtr> mHiZViews;
+  vk::SamplerPtr                mDepthSampler;
+  glm::mat4                     mHiZViewProjection = glm::mat4(1.f);
+  bool                          mHiZValid          = false;
+};
+
+} // namespace Illusion::Graphics::Gltf
+
+#endif // ILLUSION_GRAPHICS_GLTF_CULLER_HPP
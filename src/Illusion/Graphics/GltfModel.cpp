@@ -8,19 +8,48 @@
 
 #include "GltfModel.hpp"
 
+#include "../Core/ChunkedReader.hpp"
+#include "../Core/Hash.hpp"
 #include "../Core/Logger.hpp"
+#include "../Core/MappedFile.hpp"
+#include "../Core/MPMCQueue.hpp"
+#include "../Core/ThreadPool.hpp"
+#include "../Core/Tracer.hpp"
+#include "../Core/filesystem.hpp"
+#include "BackedBuffer.hpp"
 #include "CommandBuffer.hpp"
 #include "Device.hpp"
+#include "GltfModelInstance.hpp"
+#include "MeshOptimizer.hpp"
+#include "PhysicalDevice.hpp"
 #include "Texture.hpp"
+#include "TextureCompression.hpp"
+#include "TextureStreamer.hpp"
+#include "UploadManager.hpp"
 
 #define GLM_ENABLE_EXPERIMENTAL
 #include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/packing.hpp>
 #include <glm/gtc/type_ptr.hpp>
 #include <glm/gtx/io.hpp>
 
+#include <stb_image.h>
 #include <tiny_gltf.h>
 
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cmath>
+#include <condition_variable>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
 #include <functional>
+#include <limits>
+#include <map>
+#include <mutex>
+#include <tuple>
+#include <unordered_map>
 #include <unordered_set>
 
 namespace Illusion::Graphics::Gltf {
@@ -102,31 +131,2028 @@ vk::PrimitiveTopology convertPrimitiveTopology(int value) {
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////
 
+// All Models share one pool of worker threads with the other background tasks of the Graphics
+// module, so that they do not oversubscribe the cores together with a Core::JobSystem.
+Core::ThreadPool& getThreadPool() {
+  return Core::ThreadPool::getShared();
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+// This is used as image loader for tinygltf. The images are not decoded while the file is parsed;
+// instead a copy of the encoded data is stored in the std::vector given as userData, so that the
+// images can be decoded by the worker threads later.
+bool storeEncodedImage(tinygltf::Image*, const int imageIndex, std::string*, std::string*, int, int,
+    const unsigned char* bytes, int size, void* userData) {
+
+  auto& images = *static_cast<std::vector<std::vector<uint8_t>>*>(userData);
+
+  if (images.size() <= static_cast<size_t>(imageIndex)) {
+    images.resize(imageIndex + 1);
+  }
+
+  images[imageIndex].assign(bytes, bytes + size);
+
+  return true;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+// Decodes the given image to eR8G8B8A8Unorm and appends all mipmap levels down to 1x1 pixels to
+// the result. They are computed with a box filter, so no CommandBuffer has to be submitted for
+// creating the mipmaps. Returns false if the image could not be decoded.
+bool decodeImage(std::vector<uint8_t> const& encoded, uint32_t& width, uint32_t& height,
+    uint32_t& levels, std::vector<uint8_t>& result) {
+
+  int      w, h, components;
+  stbi_uc* pixels = stbi_load_from_memory(
+      encoded.data(), static_cast<int>(encoded.size()), &w, &h, &components, 4);
+
+  if (!pixels) {
+    return false;
+  }
+
+  width  = static_cast<uint32_t>(w);
+  height = static_cast<uint32_t>(h);
+
+  result.assign(pixels, pixels + width * height * 4);
+  stbi_image_free(pixels);
+
+  levels = TextureCompression::appendMipmaps(result, width, height);
+
+  return true;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+// The create info of the images returned by decodeImage(), optionally compressed to the given
+// format.
+vk::ImageCreateInfo getImageInfo(uint32_t width, uint32_t height, uint32_t levels,
+    vk::Format format = vk::Format::eR8G8B8A8Unorm) {
+  vk::ImageCreateInfo info;
+  info.imageType     = vk::ImageType::e2D;
+  info.format        = format;
+  info.extent.width  = width;
+  info.extent.height = height;
+  info.extent.depth  = 1;
+  info.mipLevels     = levels;
+  info.arrayLayers   = 1;
+  info.samples       = vk::SampleCountFlagBits::e1;
+  info.tiling        = vk::ImageTiling::eOptimal;
+  info.usage         = vk::ImageUsageFlagBits::eSampled | vk::ImageUsageFlagBits::eTransferDst;
+  info.sharingMode   = vk::SharingMode::eExclusive;
+  info.initialLayout = vk::ImageLayout::eUndefined;
+  return info;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+// Cache files start with this magic number and version. The version has to be increased whenever
+// the file format or the processing of the vertex data or the images changes.
+const char     CACHE_MAGIC[8] = {'I', 'L', 'G', 'L', 'T', 'F', 'C', '\0'};
+const uint32_t CACHE_VERSION  = 4;
+
+// The blobs in the cache files are aligned to this.
+const size_t CACHE_ALIGNMENT = 16;
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+// Reads values and blobs from a cache file. All reads are checked against the size of the file;
+// once a read failed, all following reads fail as well.
+class CacheReader {
+ public:
+  CacheReader(uint8_t const* data, size_t size)
+      : mData(data)
+      , mSize(size) {
+  }
+
+  template <typename T>
+  bool read(T& value) {
+    if (!mValid || mOffset + sizeof(T) > mSize) {
+      mValid = false;
+      return false;
+    }
+
+    std::memcpy(&value, mData + mOffset, sizeof(T));
+    mOffset += sizeof(T);
+    return true;
+  }
+
+  // Strings and containers are stored with their size first. Each element takes at least one byte,
+  // so sizes which exceed the remaining file are rejected before anything is allocated.
+  bool read(std::string& value) {
+    uint64_t size = 0;
+    if (!read(size) || size > getRemainingBytes()) {
+      mValid = false;
+      return false;
+    }
+
+    value.assign(reinterpret_cast<char const*>(mData + mOffset), size);
+    mOffset += size;
+    return true;
+  }
+
+  template <typename T>
+  bool read(std::vector<T>& values) {
+    uint64_t size = 0;
+    if (!read(size) || size > getRemainingBytes()) {
+      mValid = false;
+      return false;
+    }
+
+    values.resize(size);
+    for (auto& value : values) {
+      read(value);
+    }
+    return mValid;
+  }
+
+  template <typename K, typename V>
+  bool read(std::map<K, V>& values) {
+    uint64_t size = 0;
+    if (!read(size) || size > getRemainingBytes()) {
+      mValid = false;
+      return false;
+    }
+
+    for (uint64_t i(0); i < size && mValid; ++i) {
+      K key;
+      read(key);
+      read(values[key]);
+    }
+    return mValid;
+  }
+
+  uint8_t const* readBlob(size_t size) {
+    size_t offset = (mOffset + CACHE_ALIGNMENT - 1) / CACHE_ALIGNMENT * CACHE_ALIGNMENT;
+
+    if (!mValid || offset + size > mSize) {
+      mValid = false;
+      return nullptr;
+    }
+
+    mOffset = offset + size;
+    return mData + offset;
+  }
+
+  bool isValid() const {
+    return mValid;
+  }
+
+  size_t getRemainingBytes() const {
+    return mSize - mOffset;
+  }
+
+ private:
+  uint8_t const* mData;
+  size_t         mSize;
+  size_t         mOffset = 0;
+  bool           mValid  = true;
+};
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+// The counterpart of the CacheReader.
+class CacheWriter {
+ public:
+  explicit CacheWriter(std::string const& fileName)
+      : mStream(fileName, std::ios::out | std::ios::binary) {
+  }
+
+  template <typename T>
+  void write(T const& value) {
+    writeBytes(&value, sizeof(T));
+  }
+
+  void write(std::string const& value) {
+    write(static_cast<uint64_t>(value.size()));
+    writeBytes(value.data(), value.size());
+  }
+
+  template <typename T>
+  void write(std::vector<T> const& values) {
+    write(static_cast<uint64_t>(values.size()));
+    for (auto const& value : values) {
+      write(value);
+    }
+  }
+
+  template <typename K, typename V>
+  void write(std::map<K, V> const& values) {
+    write(static_cast<uint64_t>(values.size()));
+    for (auto const& value : values) {
+      write(value.first);
+      write(value.second);
+    }
+  }
+
+  void writeBlob(void const* data, size_t size) {
+    static const char padding[CACHE_ALIGNMENT] = {};
+    writeBytes(padding, (CACHE_ALIGNMENT - mOffset % CACHE_ALIGNMENT) % CACHE_ALIGNMENT);
+    writeBytes(data, size);
+  }
+
+  bool isValid() const {
+    return static_cast<bool>(mStream);
+  }
+
+ private:
+  void writeBytes(void const* data, size_t size) {
+    mStream.write(static_cast<char const*>(data), static_cast<std::streamsize>(size));
+    mOffset += size;
+  }
+
+  std::ofstream mStream;
+  size_t        mOffset = 0;
+};
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+// Stores the JSON values of extensions; binary values are not used by the Model and stored as null.
+// The nesting depth is limited when reading, so that a broken file cannot overflow the stack.
+void writeValue(CacheWriter& writer, tinygltf::Value const& value) {
+  if (value.IsBool()) {
+    writer.write(uint8_t(1));
+    writer.write(value.Get<bool>());
+  } else if (value.IsInt()) {
+    writer.write(uint8_t(2));
+    writer.write(value.Get<int>());
+  } else if (value.IsNumber()) {
+    writer.write(uint8_t(3));
+    writer.write(value.Get<double>());
+  } else if (value.IsString()) {
+    writer.write(uint8_t(4));
+    writer.write(value.Get<std::string>());
+  } else if (value.IsArray()) {
+    writer.write(uint8_t(5));
+    writer.write(static_cast<uint64_t>(value.ArrayLen()));
+    for (size_t i(0); i < value.ArrayLen(); ++i) {
+      writeValue(writer, value.Get(static_cast<int>(i)));
+    }
+  } else if (value.IsObject()) {
+    auto keys = value.Keys();
+    writer.write(uint8_t(6));
+    writer.write(static_cast<uint64_t>(keys.size()));
+    for (auto const& key : keys) {
+      writer.write(key);
+      writeValue(writer, value.Get(key));
+    }
+  } else {
+    writer.write(uint8_t(0));
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+bool readValue(CacheReader& reader, tinygltf::Value& value, uint32_t depth = 0) {
+  uint8_t type = 0;
+  if (!reader.read(type) || depth > 64) {
+    return false;
+  }
+
+  if (type == 0) {
+    value = tinygltf::Value();
+  } else if (type == 1) {
+    bool b = false;
+    reader.read(b);
+    value = tinygltf::Value(b);
+  } else if (type == 2) {
+    int i = 0;
+    reader.read(i);
+    value = tinygltf::Value(i);
+  } else if (type == 3) {
+    double d = 0.0;
+    reader.read(d);
+    value = tinygltf::Value(d);
+  } else if (type == 4) {
+    std::string s;
+    reader.read(s);
+    value = tinygltf::Value(s);
+  } else if (type == 5) {
+    uint64_t               size = 0;
+    tinygltf::Value::Array array;
+    reader.read(size);
+    for (uint64_t i(0); i < size && reader.isValid(); ++i) {
+      array.emplace_back();
+      readValue(reader, array.back(), depth + 1);
+    }
+    value = tinygltf::Value(array);
+  } else if (type == 6) {
+    uint64_t                size = 0;
+    tinygltf::Value::Object object;
+    reader.read(size);
+    for (uint64_t i(0); i < size && reader.isValid(); ++i) {
+      std::string key;
+      reader.read(key);
+      readValue(reader, object[key], depth + 1);
+    }
+    value = tinygltf::Value(object);
+  } else {
+    return false;
+  }
+
+  return reader.isValid();
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void writeParameters(CacheWriter& writer, tinygltf::ParameterMap const& parameters) {
+  writer.write(static_cast<uint64_t>(parameters.size()));
+  for (auto const& p : parameters) {
+    writer.write(p.first);
+    writer.write(p.second.bool_value);
+    writer.write(p.second.has_number_value);
+    writer.write(p.second.string_value);
+    writer.write(p.second.number_array);
+    writer.write(p.second.json_double_value);
+    writer.write(p.second.number_value);
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+bool readParameters(CacheReader& reader, tinygltf::ParameterMap& parameters) {
+  uint64_t size = 0;
+  reader.read(size);
+  for (uint64_t i(0); i < size && reader.isValid(); ++i) {
+    std::string key;
+    reader.read(key);
+    auto& p = parameters[key];
+    reader.read(p.bool_value);
+    reader.read(p.has_number_value);
+    reader.read(p.string_value);
+    reader.read(p.number_array);
+    reader.read(p.json_double_value);
+    reader.read(p.number_value);
+  }
+  return reader.isValid();
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+// Stores everything of the parsed file which the constructor of the Model reads, so that a cache
+// hit does not need to parse the file at all. The vertex data and the images are stored by the
+// LoadingState instead; only the buffer views which are read on the main thread (inverse bind
+// matrices, animation samplers and morph targets) are kept, each one as a buffer of its own.
+void writeDocument(CacheWriter& writer, tinygltf::Model const& model) {
+  std::vector<uint8_t> requiredViews(model.bufferViews.size(), 0);
+
+  auto require = [&](int accessor) {
+    if (accessor >= 0 && static_cast<size_t>(accessor) < model.accessors.size()) {
+      int view = model.accessors[accessor].bufferView;
+      if (view >= 0 && static_cast<size_t>(view) < requiredViews.size()) {
+        requiredViews[view] = 1;
+      }
+    }
+  };
+
+  for (auto const& s : model.skins) {
+    require(s.inverseBindMatrices);
+  }
+
+  for (auto const& a : model.animations) {
+    for (auto const& s : a.samplers) {
+      require(s.input);
+      require(s.output);
+    }
+  }
+
+  for (auto const& m : model.meshes) {
+    for (auto const& p : m.primitives) {
+      for (auto const& target : p.targets) {
+        for (auto const& attribute : target) {
+          require(attribute.second);
+        }
+      }
+    }
+  }
+
+  writer.write(static_cast<uint64_t>(model.bufferViews.size()));
+  for (size_t i(0); i < model.bufferViews.size(); ++i) {
+    auto const&    v    = model.bufferViews[i];
+    uint8_t const* data = nullptr;
+    uint64_t       size = 0;
+
+    if (requiredViews[i] && v.buffer >= 0 && static_cast<size_t>(v.buffer) < model.buffers.size()) {
+      auto const& buffer = model.buffers[v.buffer].data;
+      size_t      offset = std::min<size_t>(buffer.size(), v.byteOffset);
+      data               = buffer.data() + offset;
+      size               = std::min<uint64_t>(v.byteLength, buffer.size() - offset);
+    }
+
+    writer.write(static_cast<uint8_t>(data != nullptr));
+    writer.write(v.byteStride);
+    writer.write(size);
+    if (data) {
+      writer.writeBlob(data, size);
+    }
+  }
+
+  writer.write(static_cast<uint64_t>(model.accessors.size()));
+  for (auto const& a : model.accessors) {
+    writer.write(a.bufferView);
+    writer.write(a.byteOffset);
+    writer.write(a.componentType);
+    writer.write(a.count);
+    writer.write(a.type);
+    writer.write(a.minValues);
+    writer.write(a.maxValues);
+  }
+
+  writer.write(static_cast<uint64_t>(model.samplers.size()));
+  for (auto const& s : model.samplers) {
+    writer.write(s.minFilter);
+    writer.write(s.magFilter);
+    writer.write(s.wrapS);
+    writer.write(s.wrapT);
+  }
+
+  writer.write(static_cast<uint64_t>(model.textures.size()));
+  for (auto const& t : model.textures) {
+    writer.write(t.sampler);
+    writer.write(t.source);
+  }
+
+  writer.write(static_cast<uint64_t>(model.materials.size()));
+  for (auto const& m : model.materials) {
+    writer.write(m.name);
+    writeParameters(writer, m.values);
+    writeParameters(writer, m.additionalValues);
+    writer.write(static_cast<uint64_t>(m.extensions.size()));
+    for (auto const& e : m.extensions) {
+      writer.write(e.first);
+      writeValue(writer, e.second);
+    }
+  }
+
+  writer.write(static_cast<uint64_t>(model.meshes.size()));
+  for (auto const& m : model.meshes) {
+    writer.write(m.name);
+    writer.write(m.weights);
+    writer.write(static_cast<uint64_t>(m.primitives.size()));
+    for (auto const& p : m.primitives) {
+      writer.write(p.attributes);
+      writer.write(p.material);
+      writer.write(p.indices);
+      writer.write(p.mode);
+      writer.write(p.targets);
+    }
+  }
+
+  writer.write(static_cast<uint64_t>(model.nodes.size()));
+  for (auto const& n : model.nodes) {
+    writer.write(n.name);
+    writer.write(n.matrix);
+    writer.write(n.translation);
+    writer.write(n.rotation);
+    writer.write(n.scale);
+    writer.write(n.mesh);
+    writer.write(n.weights);
+    writer.write(n.skin);
+    writer.write(n.children);
+  }
+
+  writer.write(static_cast<uint64_t>(model.skins.size()));
+  for (auto const& s : model.skins) {
+    writer.write(s.name);
+    writer.write(s.joints);
+    writer.write(s.inverseBindMatrices);
+  }
+
+  writer.write(static_cast<uint64_t>(model.scenes.size()));
+  for (auto const& s : model.scenes) {
+    writer.write(s.nodes);
+  }
+  writer.write(model.defaultScene);
+
+  writer.write(static_cast<uint64_t>(model.animations.size()));
+  for (auto const& a : model.animations) {
+    writer.write(a.name);
+    writer.write(static_cast<uint64_t>(a.samplers.size()));
+    for (auto const& s : a.samplers) {
+      writer.write(s.input);
+      writer.write(s.output);
+      writer.write(s.interpolation);
+    }
+    writer.write(static_cast<uint64_t>(a.channels.size()));
+    for (auto const& c : a.channels) {
+      writer.write(c.sampler);
+      writer.write(c.target_node);
+      writer.write(c.target_path);
+    }
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+// The counterpart of writeDocument(). The sizes of the arrays are not checked against the remaining
+// file size, but each element takes at least one byte; once the end of the file is reached, all
+// reads fail and the loops stop.
+bool readDocument(CacheReader& reader, tinygltf::Model& model) {
+
+  // resizes the vector if the size could be read
+  auto readSize = [&reader](auto& vector) {
+    uint64_t size = 0;
+    if (reader.read(size) && reader.isValid()) {
+      vector.resize(std::min<uint64_t>(size, reader.getRemainingBytes()));
+    }
+    return reader.isValid() && vector.size() == size;
+  };
+
+  if (!readSize(model.bufferViews)) {
+    return false;
+  }
+
+  for (auto& v : model.bufferViews) {
+    uint8_t  required = 0;
+    uint64_t size     = 0;
+    reader.read(required);
+    reader.read(v.byteStride);
+    reader.read(size);
+
+    v.buffer     = -1;
+    v.byteOffset = 0;
+    v.byteLength = size;
+
+    if (required) {
+      auto data = reader.readBlob(size);
+      if (data) {
+        v.buffer = static_cast<int>(model.buffers.size());
+        model.buffers.emplace_back();
+        model.buffers.back().data.assign(data, data + size);
+      }
+    }
+  }
+
+  if (!readSize(model.accessors)) {
+    return false;
+  }
+
+  for (auto& a : model.accessors) {
+    reader.read(a.bufferView);
+    reader.read(a.byteOffset);
+    reader.read(a.componentType);
+    reader.read(a.count);
+    reader.read(a.type);
+    reader.read(a.minValues);
+    reader.read(a.maxValues);
+  }
+
+  if (!readSize(model.samplers)) {
+    return false;
+  }
+
+  for (auto& s : model.samplers) {
+    reader.read(s.minFilter);
+    reader.read(s.magFilter);
+    reader.read(s.wrapS);
+    reader.read(s.wrapT);
+  }
+
+  if (!readSize(model.textures)) {
+    return false;
+  }
+
+  for (auto& t : model.textures) {
+    reader.read(t.sampler);
+    reader.read(t.source);
+  }
+
+  if (!readSize(model.materials)) {
+    return false;
+  }
+
+  for (auto& m : model.materials) {
+    uint64_t extensionCount = 0;
+    reader.read(m.name);
+    readParameters(reader, m.values);
+    readParameters(reader, m.additionalValues);
+    reader.read(extensionCount);
+    for (uint64_t i(0); i < extensionCount && reader.isValid(); ++i) {
+      std::string name;
+      reader.read(name);
+      readValue(reader, m.extensions[name]);
+    }
+  }
+
+  if (!readSize(model.meshes)) {
+    return false;
+  }
+
+  for (auto& m : model.meshes) {
+    reader.read(m.name);
+    reader.read(m.weights);
+    if (!readSize(m.primitives)) {
+      return false;
+    }
+    for (auto& p : m.primitives) {
+      reader.read(p.attributes);
+      reader.read(p.material);
+      reader.read(p.indices);
+      reader.read(p.mode);
+      reader.read(p.targets);
+    }
+  }
+
+  if (!readSize(model.nodes)) {
+    return false;
+  }
+
+  for (auto& n : model.nodes) {
+    reader.read(n.name);
+    reader.read(n.matrix);
+    reader.read(n.translation);
+    reader.read(n.rotation);
+    reader.read(n.scale);
+    reader.read(n.mesh);
+    reader.read(n.weights);
+    reader.read(n.skin);
+    reader.read(n.children);
+  }
+
+  if (!readSize(model.skins)) {
+    return false;
+  }
+
+  for (auto& s : model.skins) {
+    reader.read(s.name);
+    reader.read(s.joints);
+    reader.read(s.inverseBindMatrices);
+  }
+
+  if (!readSize(model.scenes)) {
+    return false;
+  }
+
+  for (auto& s : model.scenes) {
+    reader.read(s.nodes);
+  }
+  reader.read(model.defaultScene);
+
+  if (!readSize(model.animations)) {
+    return false;
+  }
+
+  for (auto& a : model.animations) {
+    reader.read(a.name);
+    if (!readSize(a.samplers)) {
+      return false;
+    }
+    for (auto& s : a.samplers) {
+      reader.read(s.input);
+      reader.read(s.output);
+      reader.read(s.interpolation);
+    }
+    if (!readSize(a.channels)) {
+      return false;
+    }
+    for (auto& c : a.channels) {
+      reader.read(c.sampler);
+      reader.read(c.target_node);
+      reader.read(c.target_path);
+    }
+  }
+
+  return reader.isValid();
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+// Maps the unit vector to the octahedron and the octahedron to the [-1, 1] square. The lower half
+// is folded over the diagonals. This is decoded by GltfShaderCompact.vert.
+glm::i16vec2 encodeOctahedron(glm::vec3 const& n) {
+  float length = std::abs(n.x) + std::abs(n.y) + std::abs(n.z);
+
+  if (length == 0.f) {
+    return glm::i16vec2(0);
+  }
+
+  glm::vec2 p = glm::vec2(n.x, n.y) / length;
+
+  if (n.z < 0.f) {
+    glm::vec2 sign(p.x >= 0.f ? 1.f : -1.f, p.y >= 0.f ? 1.f : -1.f);
+    p = (1.f - glm::abs(glm::vec2(p.y, p.x))) * sign;
+  }
+
+  return glm::i16vec2(glm::round(glm::clamp(p, -1.f, 1.f) * 32767.f));
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+CompactVertex compressVertex(Vertex const& vertex) {
+  CompactVertex result;
+  result.mPosition  = vertex.mPosition;
+  result.mNormal    = encodeOctahedron(vertex.mNormal);
+  result.mTexcoords = glm::u16vec2(
+      glm::packHalf1x16(vertex.mTexcoords.x), glm::packHalf1x16(vertex.mTexcoords.y));
+  return result;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+SkinVertex compressSkin(Vertex const& vertex) {
+  SkinVertex result;
+  result.mJoint0  = glm::u16vec4(vertex.mJoint0);
+  result.mWeight0 = glm::u8vec4(glm::round(glm::clamp(vertex.mWeight0, 0.f, 1.f) * 255.f));
+  return result;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+size_t getVertexCount(tinygltf::Model const& model, tinygltf::Primitive const& p) {
+  auto positions = p.attributes.find("POSITION");
+  if (positions == p.attributes.end()) {
+    throw std::runtime_error("Failed to load GLTF model: Primitve has no vertex data!");
+  }
+
+  return model.accessors[positions->second].count;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+size_t getIndexCount(tinygltf::Model const& model, tinygltf::Primitive const& p) {
+  if (p.indices < 0) {
+    return getVertexCount(model, p);
+  }
+
+  return model.accessors[p.indices].count;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+Core::Flags<Primitive::VertexAttributeBits> getVertexAttributes(
+    tinygltf::Primitive const& p, bool loadSkins) {
+
+  Core::Flags<Primitive::VertexAttributeBits> result;
+
+  if (p.attributes.find("NORMAL") != p.attributes.end()) {
+    result |= Primitive::VertexAttributeBits::eNormals;
+  }
+
+  if (p.attributes.find("TEXCOORD_0") != p.attributes.end()) {
+    result |= Primitive::VertexAttributeBits::eTexcoords;
+  }
+
+  if (loadSkins && p.attributes.find("JOINTS_0") != p.attributes.end() &&
+      p.attributes.find("WEIGHTS_0") != p.attributes.end()) {
+    result |= Primitive::VertexAttributeBits::eSkins;
+  }
+
+  return result;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+// Converts the vertex attributes and the indices of the given primitive to our vertex layout. The
+// vertices and the indices (which refer to the first of these vertices) are written to the given
+// arrays. These must be large enough for getVertexCount() and getIndexCount() elements. The
+// positions are added to the given bounding box. This is called by the worker threads, hence it
+// must not modify anything else.
+void convertPrimitive(tinygltf::Model const& model, tinygltf::Primitive const& p, bool loadSkins,
+    Vertex* vertices, uint32_t* indices, BoundingBox& bbox) {
+
+  auto positions = p.attributes.find("POSITION");
+  if (positions == p.attributes.end()) {
+    throw std::runtime_error("Failed to load GLTF model: Primitve has no vertex data!");
+  }
+
+  size_t vertexCount = model.accessors[positions->second].count;
+
+  // positions
+  {
+    auto const& a = model.accessors[positions->second];
+    auto const& v = model.bufferViews[a.bufferView];
+
+    if (a.componentType != TINYGLTF_COMPONENT_TYPE_FLOAT) {
+      throw std::runtime_error(
+          "Failed to load GLTF model: Unsupported component type for positions!");
+    }
+
+    size_t s = v.byteStride == 0 ? sizeof(glm::vec3) : v.byteStride;
+    for (size_t i(0); i < vertexCount; ++i) {
+      vertices[i].mPosition = *reinterpret_cast<glm::vec3*>(
+          &(model.buffers[v.buffer].data[a.byteOffset + v.byteOffset + i * s]));
+      bbox.add(vertices[i].mPosition);
+    }
+  }
+
+  auto normals = p.attributes.find("NORMAL");
+  if (normals != p.attributes.end()) {
+    auto const& a = model.accessors[normals->second];
+    auto const& v = model.bufferViews[a.bufferView];
+
+    if (a.componentType != TINYGLTF_COMPONENT_TYPE_FLOAT) {
+      throw std::runtime_error(
+          "Failed to load GLTF model: Unsupported component type for normals!");
+    }
+
+    size_t s = v.byteStride == 0 ? sizeof(glm::vec3) : v.byteStride;
+    for (size_t i(0); i < vertexCount; ++i) {
+      vertices[i].mNormal = *reinterpret_cast<glm::vec3*>(
+          &(model.buffers[v.buffer].data[a.byteOffset + v.byteOffset + i * s]));
+    }
+  }
+
+  auto texcoords = p.attributes.find("TEXCOORD_0");
+  if (texcoords != p.attributes.end()) {
+    auto const& a = model.accessors[texcoords->second];
+    auto const& v = model.bufferViews[a.bufferView];
+
+    switch (a.componentType) {
+    case TINYGLTF_COMPONENT_TYPE_FLOAT: {
+      size_t s = v.byteStride == 0 ? sizeof(glm::vec2) : v.byteStride;
+      for (size_t i(0); i < vertexCount; ++i) {
+        vertices[i].mTexcoords = *reinterpret_cast<glm::vec2*>(
+            &(model.buffers[v.buffer].data[a.byteOffset + v.byteOffset + i * s]));
+      }
+      break;
+    }
+    case TINYGLTF_COMPONENT_TYPE_UNSIGNED_BYTE: {
+      size_t s = v.byteStride == 0 ? sizeof(glm::u8vec2) : v.byteStride;
+      for (size_t i(0); i < vertexCount; ++i) {
+        vertices[i].mTexcoords =
+            glm::vec2(*reinterpret_cast<glm::u8vec2*>(
+                &(model.buffers[v.buffer].data[a.byteOffset + v.byteOffset + i * s]))) /
+            255.f;
+      }
+      break;
+    }
+    case TINYGLTF_COMPONENT_TYPE_UNSIGNED_SHORT: {
+      size_t s = v.byteStride == 0 ? sizeof(glm::u16vec2) : v.byteStride;
+      for (size_t i(0); i < vertexCount; ++i) {
+        vertices[i].mTexcoords =
+            glm::vec2(*reinterpret_cast<glm::u16vec2*>(
+                &(model.buffers[v.buffer].data[a.byteOffset + v.byteOffset + i * s]))) /
+            65535.f;
+      }
+      break;
+    }
+    default:
+      throw std::runtime_error(
+          "Failed to load GLTF model: Unsupported component type for texcoords!");
+    }
+  }
+
+  auto joints  = p.attributes.find("JOINTS_0");
+  auto weights = p.attributes.find("WEIGHTS_0");
+
+  if (joints != p.attributes.end() && weights != p.attributes.end() && loadSkins) {
+    {
+      auto const& a = model.accessors[joints->second];
+      auto const& v = model.bufferViews[a.bufferView];
+
+      switch (a.componentType) {
+      case TINYGLTF_COMPONENT_TYPE_UNSIGNED_BYTE: {
+        size_t s = v.byteStride == 0 ? sizeof(glm::u8vec4) : v.byteStride;
+        for (size_t i(0); i < vertexCount; ++i) {
+          vertices[i].mJoint0 = glm::vec4(*reinterpret_cast<glm::u8vec4*>(
+              &(model.buffers[v.buffer].data[a.byteOffset + v.byteOffset + i * s])));
+        }
+        break;
+      }
+      case TINYGLTF_COMPONENT_TYPE_UNSIGNED_SHORT: {
+        size_t s = v.byteStride == 0 ? sizeof(glm::u16vec4) : v.byteStride;
+        for (size_t i(0); i < vertexCount; ++i) {
+          vertices[i].mJoint0 = glm::vec4(*reinterpret_cast<glm::u16vec4*>(
+              &(model.buffers[v.buffer].data[a.byteOffset + v.byteOffset + i * s])));
+        }
+        break;
+      }
+      default:
+        throw std::runtime_error(
+            "Failed to load GLTF model: Unsupported component type for joints!");
+      }
+    }
+
+    {
+      auto const& a = model.accessors[weights->second];
+      auto const& v = model.bufferViews[a.bufferView];
+
+      switch (a.componentType) {
+      case TINYGLTF_COMPONENT_TYPE_FLOAT: {
+        size_t s = v.byteStride == 0 ? sizeof(glm::vec4) : v.byteStride;
+        for (size_t i(0); i < vertexCount; ++i) {
+          vertices[i].mWeight0 = *reinterpret_cast<glm::vec4*>(
+              &(model.buffers[v.buffer].data[a.byteOffset + v.byteOffset + i * s]));
+        }
+        break;
+      }
+      case TINYGLTF_COMPONENT_TYPE_UNSIGNED_BYTE: {
+        size_t s = v.byteStride == 0 ? sizeof(glm::u8vec4) : v.byteStride;
+        for (size_t i(0); i < vertexCount; ++i) {
+          vertices[i].mWeight0 =
+              glm::vec4(*reinterpret_cast<glm::u8vec4*>(
+                  &(model.buffers[v.buffer].data[a.byteOffset + v.byteOffset + i * s]))) /
+              255.f;
+        }
+        break;
+      }
+      case TINYGLTF_COMPONENT_TYPE_UNSIGNED_SHORT: {
+        size_t s = v.byteStride == 0 ? sizeof(glm::u16vec4) : v.byteStride;
+        for (size_t i(0); i < vertexCount; ++i) {
+          vertices[i].mWeight0 =
+              glm::vec4(*reinterpret_cast<glm::u16vec4*>(
+                  &(model.buffers[v.buffer].data[a.byteOffset + v.byteOffset + i * s]))) /
+              65535.f;
+        }
+        break;
+      }
+      default:
+        throw std::runtime_error(
+            "Failed to load GLTF model: Unsupported component type for weights!");
+      }
+
+      // normalize weights - is this the correct way of handling cases where the sum of the
+      // weights is not equal to one?
+      for (size_t i(0); i < vertexCount; ++i) {
+        float sum = vertices[i].mWeight0.x +
+                    vertices[i].mWeight0.y +
+                    vertices[i].mWeight0.z +
+                    vertices[i].mWeight0.w;
+        if (sum > 0) {
+          vertices[i].mWeight0 /= sum;
+        }
+      }
+    }
+  }
+
+  if (p.indices < 0) {
+
+    // add artificial indices if there are none
+    for (size_t i(0); i < vertexCount; ++i) {
+      indices[i] = static_cast<uint32_t>(i);
+    }
+
+  } else {
+
+    auto const& a = model.accessors[p.indices];
+    auto const& v = model.bufferViews[a.bufferView];
+
+    switch (a.componentType) {
+    case TINYGLTF_PARAMETER_TYPE_UNSIGNED_INT: {
+      auto data = reinterpret_cast<const uint32_t*>(
+          &model.buffers[v.buffer].data[a.byteOffset + v.byteOffset]);
+      for (size_t i(0); i < a.count; ++i) {
+        indices[i] = data[i];
+      }
+      break;
+    }
+    case TINYGLTF_PARAMETER_TYPE_UNSIGNED_SHORT: {
+      auto data = reinterpret_cast<const uint16_t*>(
+          &model.buffers[v.buffer].data[a.byteOffset + v.byteOffset]);
+      for (size_t i(0); i < a.count; ++i) {
+        indices[i] = data[i];
+      }
+      break;
+    }
+    case TINYGLTF_PARAMETER_TYPE_UNSIGNED_BYTE: {
+      auto data = reinterpret_cast<const uint8_t*>(
+          &model.buffers[v.buffer].data[a.byteOffset + v.byteOffset]);
+      for (size_t i(0); i < a.count; ++i) {
+        indices[i] = data[i];
+      }
+      break;
+    }
+    default:
+      throw std::runtime_error("Failed to load GLTF model: Unsupported index type!");
+    }
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+// Converts the morph targets of the given primitive to Primitive::MorphDeltas which are appended
+// to the given vector. Only the vertices which are displaced by at least one target are stored,
+// their number is returned. Attributes other than positions and normals are ignored, as well as
+// accessors without buffer view (which are all zero unless they are sparse).
+uint32_t convertMorphTargets(tinygltf::Model const& model, tinygltf::Primitive const& p,
+    std::vector<Primitive::MorphDelta>& deltas) {
+
+  size_t vertexCount = getVertexCount(model, p);
+  size_t targetCount = p.targets.size();
+
+  // the deltas of target t are stored at t * vertexCount
+  std::vector<glm::vec3> positions(vertexCount * targetCount, glm::vec3(0.f));
+  std::vector<glm::vec3> normals(vertexCount * targetCount, glm::vec3(0.f));
+
+  auto readDeltas = [&](std::map<std::string, int> const& target, std::string const& name,
+                        glm::vec3* result) {
+    auto attribute = target.find(name);
+    if (attribute == target.end() || model.accessors[attribute->second].bufferView < 0) {
+      return;
+    }
+
+    auto const& a = model.accessors[attribute->second];
+    auto const& v = model.bufferViews[a.bufferView];
+
+    if (a.componentType != TINYGLTF_COMPONENT_TYPE_FLOAT || a.count < vertexCount) {
+      throw std::runtime_error(
+          "Failed to load GLTF model: Unsupported accessor for morph target " + name + "!");
+    }
+
+    size_t s = v.byteStride == 0 ? sizeof(glm::vec3) : v.byteStride;
+    for (size_t i(0); i < vertexCount; ++i) {
+      result[i] = *reinterpret_cast<glm::vec3 const*>(
+          &(model.buffers[v.buffer].data[a.byteOffset + v.byteOffset + i * s]));
+    }
+  };
+
+  for (size_t t(0); t < targetCount; ++t) {
+    readDeltas(p.targets[t], "POSITION", &positions[t * vertexCount]);
+    readDeltas(p.targets[t], "NORMAL", &normals[t * vertexCount]);
+  }
+
+  uint32_t displacedVertexCount = 0;
+
+  for (size_t i(0); i < vertexCount; ++i) {
+    bool displaced = false;
+    for (size_t t(0); t < targetCount && !displaced; ++t) {
+      displaced = positions[t * vertexCount + i] != glm::vec3(0.f) ||
+                  normals[t * vertexCount + i] != glm::vec3(0.f);
+    }
+
+    if (!displaced) {
+      continue;
+    }
+
+    for (size_t t(0); t < targetCount; ++t) {
+      Primitive::MorphDelta delta;
+      delta.mPosition = positions[t * vertexCount + i];
+      delta.mVertex   = static_cast<uint32_t>(i);
+      delta.mNormal   = normals[t * vertexCount + i];
+      deltas.push_back(delta);
+    }
+
+    ++displacedVertexCount;
+  }
+
+  return displacedVertexCount;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+// Applies all steps of the MeshOptimizer to the given triangle list. Afterwards, there may be less
+// vertices than before; the number of indices does not change.
+void optimizePrimitive(std::vector<Vertex>& vertices, std::vector<uint32_t>& indices) {
+  MeshOptimizer::weldVertices(indices, vertices.data(), vertices.size(), sizeof(Vertex));
+  MeshOptimizer::optimizeVertexCache(indices, vertices.size());
+
+  std::vector<glm::vec3> positions(vertices.size());
+  for (size_t i(0); i < vertices.size(); ++i) {
+    positions[i] = vertices[i].mPosition;
+  }
+
+  MeshOptimizer::optimizeOverdraw(indices, positions);
+
+  vertices.resize(MeshOptimizer::optimizeVertexFetch(
+      indices, vertices.data(), vertices.size(), sizeof(Vertex)));
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+// Returns the maximum index counts of the Lods which are generated for a triangle list. Each Lod
+// has at most half the triangles of the previous one; very small Lods are not worth the effort.
+std::vector<size_t> getLodIndexCounts(tinygltf::Model const& model, tinygltf::Primitive const& p) {
+  std::vector<size_t> result;
+
+  if (p.mode != TINYGLTF_MODE_TRIANGLES) {
+    return result;
+  }
+
+  size_t indexCount = getIndexCount(model, p);
+
+  for (size_t i(1); i <= 3 && (indexCount >> i) >= 3 * 32; ++i) {
+    result.push_back((indexCount >> i) / 3 * 3);
+  }
+
+  return result;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+// Meshlets are only built for triangle lists whose vertices are not deformed, as the bounds of the
+// Meshlets would be wrong else.
+bool hasMeshlets(tinygltf::Primitive const& p, bool loadSkins) {
+  return p.mode == TINYGLTF_MODE_TRIANGLES && p.targets.empty() &&
+         !static_cast<bool>(
+             getVertexAttributes(p, loadSkins) & Primitive::VertexAttributeBits::eSkins);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+// Returns the number of the coarsest Lod of the Primitive whose error on screen is below the
+// allowed pixel error when drawn with the given transformation; zero refers to the full Primitive
+// and i to p.mLods[i - 1].
+size_t selectLod(Primitive const& p, glm::mat4 const& transform, LodSelection const& selection) {
+  if (p.mLods.empty() || p.mBoundingBox.isEmpty()) {
+    return 0;
+  }
+
+  auto      bbox     = p.mBoundingBox.getTransformed(transform);
+  glm::vec3 closest  = glm::clamp(selection.mEyePosition, bbox.mMin, bbox.mMax);
+  float     distance = glm::length(selection.mEyePosition - closest);
+  float     scale    = std::max(glm::length(glm::vec3(transform[0])),
+      std::max(glm::length(glm::vec3(transform[1])), glm::length(glm::vec3(transform[2]))));
+
+  if (distance <= 0.f || scale <= 0.f) {
+    return 0;
+  }
+
+  // the largest object space error which is projected to less than mMaxPixelError pixels
+  float maxError = selection.mMaxPixelError * distance / (selection.mProjectionScale * scale);
+
+  size_t result = 0;
+  while (result < p.mLods.size() && p.mLods[result].mError <= maxError) {
+    ++result;
+  }
+
+  return result;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+// Assigns the value to the given member of the Node and marks the Node as dirty if this actually
+// changes the member; this way Nodes which are not moving are not updated again.
+template <typename T>
+void setTransform(Node& node, T& member, T const& value) {
+  if (member != value) {
+    member      = value;
+    node.mDirty = true;
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+// Interpolates the morph target weights of the Node between the key frames s and e of the Sampler
+// and marks them as dirty if they change. There is one value for each weight and key frame (three
+// for cubic splines); as there are usually only a few weights, they are not batched.
+void sampleWeights(Animation::Sampler const& sampler, size_t s, size_t e, float t, Node& node) {
+  size_t count = node.mWeights.size();
+
+  for (size_t i = 0; i < count; ++i) {
+    float weight;
+
+    if (sampler.mType == Animation::Sampler::Type::eStep) {
+      weight = sampler.mValues[s * count + i].x;
+    } else if (sampler.mType == Animation::Sampler::Type::eLinear) {
+      float from = sampler.mValues[s * count + i].x;
+      float to   = sampler.mValues[e * count + i].x;
+      weight     = from + (to - from) * t;
+    } else {
+      float d  = sampler.mKeyFrames[e] - sampler.mKeyFrames[s];
+      float m0 = sampler.mValues[(s * 3 + 2) * count + i].x * d;
+      float p0 = sampler.mValues[(s * 3 + 1) * count + i].x;
+      float m1 = sampler.mValues[(e * 3 + 0) * count + i].x * d;
+      float p1 = sampler.mValues[(e * 3 + 1) * count + i].x;
+
+      weight = (2.f * t * t * t - 3.f * t * t + 1.f) * p0 + (t * t * t - 2.f * t * t + t) * m0 +
+               (-2.f * t * t * t + 3.f * t * t) * p1 + (t * t * t - t * t) * m1;
+    }
+
+    if (node.mWeights[i] != weight) {
+      node.mWeights[i]   = weight;
+      node.mWeightsDirty = true;
+    }
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+// Returns the index s of the key frame with keyFrames[s] <= time < keyFrames[s + 1]. The time must
+// be inside the range of the key frames. As the time usually advances slowly, the interval of the
+// last lookup (the cursor) and the following one are tested first, else a binary search is done.
+size_t findKeyFrame(std::vector<float> const& keyFrames, uint32_t& cursor, float time) {
+  size_t s = cursor;
+
+  if (s + 1 < keyFrames.size() && keyFrames[s] <= time && time < keyFrames[s + 1]) {
+    return s;
+  }
+
+  if (s + 2 < keyFrames.size() && keyFrames[s + 1] <= time && time < keyFrames[s + 2]) {
+    s = s + 1;
+  } else {
+    s = std::upper_bound(keyFrames.begin(), keyFrames.end(), time) - keyFrames.begin() - 1;
+  }
+
+  cursor = static_cast<uint32_t>(s);
+  return s;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+// Finds the key frames s and e between which the Sampler has to be interpolated at the given time
+// and the interpolation factor t. Outside the range of the key frames, s and e are the first or the
+// last key frame.
+void findInterval(Animation::Sampler const& sampler, uint32_t& cursor, float time, size_t& s,
+    size_t& e, float& t) {
+  s = 0;
+  e = 0;
+  t = 0.f;
+
+  if (sampler.mKeyFrames.size() == 1 || time >= sampler.mKeyFrames.back()) {
+    s = e = sampler.mKeyFrames.size() - 1;
+  } else if (time >= sampler.mKeyFrames.front()) {
+    s = findKeyFrame(sampler.mKeyFrames, cursor, time);
+    e = s + 1;
+    t = glm::clamp(
+        (time - sampler.mKeyFrames[s]) / (sampler.mKeyFrames[e] - sampler.mKeyFrames[s]), 0.f, 1.f);
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+// Evaluates the cubic Hermite spline of the Sampler between the key frames s and e.
+glm::vec4 sampleCubicSpline(Animation::Sampler const& sampler, size_t s, size_t e, float t) {
+  float     d  = sampler.mKeyFrames[e] - sampler.mKeyFrames[s];
+  // the out-tangent of the first and the in-tangent of the second key frame
+  glm::vec4 m0 = sampler.mValues[s * 3 + 2] * d;
+  glm::vec4 p0 = sampler.mValues[s * 3 + 1];
+  glm::vec4 m1 = sampler.mValues[e * 3 + 0] * d;
+  glm::vec4 p1 = sampler.mValues[e * 3 + 1];
+
+  return (2.f * t * t * t - 3.f * t * t + 1.f) * p0 + (t * t * t - 2.f * t * t + t) * m0 +
+         (-2.f * t * t * t + 3.f * t * t) * p1 + (t * t * t - t * t) * m1;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+// The linearly interpolated Channels of all Models given to Model::setAnimationTimes() are
+// collected in these buffers, one array per component. They are then interpolated in one loop per
+// Channel type instead of one call per Channel. The loops are plain scalar code; the key frames
+// themselves are still stored as glm::vec4s. The results are written to mFrom.
+struct InterpolationBatch {
+  std::array<std::vector<float>, 4>                       mFrom;
+  std::array<std::vector<float>, 4>                       mTo;
+  std::vector<float>                                      mT;
+  std::vector<std::pair<Node*, Animation::Channel::Type>> mTargets;
+
+  void clear() {
+    for (int c = 0; c < 4; ++c) {
+      mFrom[c].clear();
+      mTo[c].clear();
+    }
+    mT.clear();
+    mTargets.clear();
+  }
+
+  void add(glm::vec4 const& from, glm::vec4 const& to, float t, Node* node,
+      Animation::Channel::Type type) {
+    for (int c = 0; c < 4; ++c) {
+      mFrom[c].push_back(from[c]);
+      mTo[c].push_back(to[c]);
+    }
+    mT.push_back(t);
+    mTargets.emplace_back(node, type);
+  }
+
+  // Component-wise linear interpolation of the first three components.
+  void lerp() {
+    size_t count = mT.size();
+
+    for (int c = 0; c < 3; ++c) {
+      float*       from = mFrom[c].data();
+      float const* to   = mTo[c].data();
+      float const* t    = mT.data();
+
+      for (size_t i = 0; i < count; ++i) {
+        from[i] += (to[i] - from[i]) * t[i];
+      }
+    }
+  }
+
+  // Spherical linear interpolation of quaternions, the results are normalized. Like glm::slerp(),
+  // this takes the shorter path and falls back to linear interpolation for very close rotations.
+  void slerp() {
+    size_t count = mT.size();
+
+    float* x0 = mFrom[0].data();
+    float* y0 = mFrom[1].data();
+    float* z0 = mFrom[2].data();
+    float* w0 = mFrom[3].data();
+
+    float const* x1 = mTo[0].data();
+    float const* y1 = mTo[1].data();
+    float const* z1 = mTo[2].data();
+    float const* w1 = mTo[3].data();
+    float const* t  = mT.data();
+
+    for (size_t i = 0; i < count; ++i) {
+      float cosTheta = x0[i] * x1[i] + y0[i] * y1[i] + z0[i] * z1[i] + w0[i] * w1[i];
+      float sign     = cosTheta < 0.f ? -1.f : 1.f;
+      cosTheta *= sign;
+
+      bool  close    = cosTheta > 1.f - std::numeric_limits<float>::epsilon();
+      float theta    = std::acos(std::min(cosTheta, 1.f));
+      float sinTheta = std::sin(theta);
+      float a        = close ? 1.f - t[i] : std::sin((1.f - t[i]) * theta) / sinTheta;
+      float b        = (close ? t[i] : std::sin(t[i] * theta) / sinTheta) * sign;
+
+      float x = a * x0[i] + b * x1[i];
+      float y = a * y0[i] + b * y1[i];
+      float z = a * z0[i] + b * z1[i];
+      float w = a * w0[i] + b * w1[i];
+
+      float invLength = 1.f / std::sqrt(x * x + y * y + z * z + w * w);
+
+      x0[i] = x * invLength;
+      y0[i] = y * invLength;
+      z0[i] = z * invLength;
+      w0[i] = w * invLength;
+    }
+  }
+
+  // Writes the results to the Nodes.
+  void apply() const {
+    for (size_t i = 0; i < mTargets.size(); ++i) {
+      glm::vec4 value(mFrom[0][i], mFrom[1][i], mFrom[2][i], mFrom[3][i]);
+      Node*     node = mTargets[i].first;
+
+      if (mTargets[i].second == Animation::Channel::Type::eTranslation) {
+        setTransform(*node, node->mTranslation, glm::vec3(value));
+      } else if (mTargets[i].second == Animation::Channel::Type::eScale) {
+        setTransform(*node, node->mScale, glm::vec3(value));
+      } else {
+        setTransform(*node, node->mRotation, glm::make_quat(&value[0]));
+      }
+    }
+  }
+};
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+// Evaluates all Channels of the given Animations at the given times and writes the results to the
+// Nodes. Nodes which are actually moved are marked as dirty, their global transformations are not
+// updated.
+void sampleAnimations(std::vector<std::pair<Animation*, float>> const& animations) {
+
+  // these are kept in order to avoid allocations in each frame
+  static thread_local InterpolationBatch linearVectors;
+  static thread_local InterpolationBatch linearRotations;
+
+  linearVectors.clear();
+  linearRotations.clear();
+
+  for (auto const& entry : animations) {
+    auto& animation = *entry.first;
+    float time      = entry.second;
+
+    for (auto& channel : animation.mChannels) {
+      auto& sampler = animation.mSamplers[channel.mSamplerIndex];
+
+      size_t s, e;
+      float  t;
+      findInterval(sampler, sampler.mCursor, time, s, e, t);
+
+      if (channel.mType == Animation::Channel::Type::eWeights) {
+        sampleWeights(sampler, s, e, t, *channel.mNode);
+        continue;
+      }
+
+      if (sampler.mType == Animation::Sampler::Type::eStep) {
+
+        auto& node = *channel.mNode;
+
+        if (channel.mType == Animation::Channel::Type::eTranslation) {
+          setTransform(node, node.mTranslation, glm::vec3(sampler.mValues[s]));
+        } else if (channel.mType == Animation::Channel::Type::eScale) {
+          setTransform(node, node.mScale, glm::vec3(sampler.mValues[s]));
+        } else if (channel.mType == Animation::Channel::Type::eRotation) {
+          setTransform(
+              node, node.mRotation, glm::normalize(glm::make_quat(&sampler.mValues[s][0])));
+        }
+
+      } else if (sampler.mType == Animation::Sampler::Type::eLinear) {
+
+        // linear Channels are interpolated together below
+        auto& batch =
+            channel.mType == Animation::Channel::Type::eRotation ? linearRotations : linearVectors;
+        batch.add(sampler.mValues[s], sampler.mValues[e], t, channel.mNode.get(), channel.mType);
+
+      } else if (sampler.mType == Animation::Sampler::Type::eCubicSpline) {
+
+        glm::vec4 spline = sampleCubicSpline(sampler, s, e, t);
+
+        auto& node = *channel.mNode;
+
+        if (channel.mType == Animation::Channel::Type::eTranslation) {
+          setTransform(node, node.mTranslation, glm::vec3(spline));
+        } else if (channel.mType == Animation::Channel::Type::eScale) {
+          setTransform(node, node.mScale, glm::vec3(spline));
+        } else if (channel.mType == Animation::Channel::Type::eRotation) {
+          setTransform(node, node.mRotation, glm::normalize(glm::make_quat(&spline[0])));
+        }
+      }
+    }
+  }
+
+  linearVectors.lerp();
+  linearRotations.slerp();
+
+  linearVectors.apply();
+  linearRotations.apply();
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+// Returns the index of the given element of the storage vector, or ~0u if it is not an element.
+template <typename T>
+uint32_t getStorageIndex(std::vector<T> const& storage, T const& object) {
+  std::less<T const*> less;
+  if (less(&object, storage.data()) || !less(&object, storage.data() + storage.size())) {
+    return ~0u;
+  }
+  return static_cast<uint32_t>(&object - storage.data());
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
 } // namespace
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////
 
-Model::Model(DevicePtr const& device, std::string const& file, LoadOptions options)
-    : mDevice(device)
-    , mRootNode(std::make_shared<Node>()) {
+// Each vector is resized once before its objects are created and never again, so that the aliasing
+// std::shared_ptrs of the Model stay valid.
+struct Model::Arena {
+  std::vector<Material>  mMaterials;
+  std::vector<Mesh>      mMeshes;
+  std::vector<Node>      mNodes;
+  std::vector<Skin>      mSkins;
+  std::vector<Animation> mAnimations;
+};
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+struct Model::LoadingState {
+  std::string       mFile;
+  tinygltf::Model   mModel;
+  std::atomic<bool> mCancelled{false};
+
+  // The encoded images as stored in the file, see storeEncodedImage().
+  std::vector<std::vector<uint8_t>> mEncodedImages;
+
+  // The vertex data of all Meshes; each Mesh is converted by one task which writes to its own
+  // range of these vectors. If the Meshes are optimized, the task reduces mVertexCount and stores
+  // the new vertex offsets of the Primitives. The ranges of the Meshlets are upper bounds, see
+  // MeshOptimizer::getMaxMeshletCount(); mMeshlets contains the first Meshlet and the number of
+  // Meshlets of each Primitive.
+  struct MeshRange {
+    uint32_t                 mFirstVertex = 0;
+    uint32_t                 mVertexCount = 0;
+    uint32_t                 mFirstIndex  = 0;
+    uint32_t                 mIndexCount  = 0;
+    std::vector<uint32_t>                    mIndexOffsets;
+    std::vector<BoundingBox>                 mBoundingBoxes;
+    std::vector<int32_t>                     mVertexOffsets;
+    std::vector<std::vector<Primitive::Lod>> mLods;
+
+    uint32_t                                     mFirstMeshlet         = 0;
+    uint32_t                                     mMeshletCount         = 0;
+    uint32_t                                     mFirstMeshletVertex   = 0;
+    uint32_t                                     mMeshletVertexCount   = 0;
+    uint32_t                                     mFirstMeshletTriangle = 0;
+    uint32_t                                     mMeshletTriangleCount = 0;
+    std::vector<std::pair<uint32_t, uint32_t>> mMeshlets;
+  };
+
+  // Depending on the VertexLayout, either mVertices or mCompactVertices and mSkinVertices are used.
+  VertexLayout               mVertexLayout = VertexLayout::eDefault;
+  std::vector<Vertex>        mVertices;
+  std::vector<CompactVertex> mCompactVertices;
+  std::vector<SkinVertex>    mSkinVertices;
+  std::vector<uint32_t>      mIndices;
+  std::vector<uint16_t>      mShortIndices;
+  std::vector<MeshRange>     mMeshRanges;
+  vk::IndexType              mIndexType = vk::IndexType::eUint32;
+
+  // With LoadOptionBits::eMeshlets, each Mesh writes its Meshlets to its own range of these.
+  std::vector<MeshOptimizer::Meshlet> mMeshlets;
+  std::vector<uint32_t>               mMeshletVertices;
+  std::vector<uint32_t>               mMeshletTriangles;
+
+  // Depending on the VertexLayout and the index type, these point to the vectors above or to a
+  // cache file.
+  uint8_t const* mVertexData = nullptr;
+  uint8_t const* mSkinData   = nullptr;
+  uint8_t const* mIndexData  = nullptr;
+
+  // mPixels points to mData or to a cache file; mMapping keeps the latter alive, as a
+  // TextureStreamer may access the pixels after loading has been finished. Each image is decoded
+  // only once, all Textures which use it share its mData.
+  struct DecodedTexture {
+    size_t                                 mIndex;
+    vk::ImageCreateInfo                    mImageInfo;
+    vk::SamplerCreateInfo                  mSamplerInfo;
+    std::shared_ptr<std::vector<uint8_t>> mData;
+    uint8_t const*                         mPixels = nullptr;
+    size_t                                 mSize   = 0;
+    std::shared_ptr<Core::MappedFile>      mMapping;
+  };
+
+  // The tasks push their results to these queues, they are processed by update(). Each Mesh and
+  // each Texture is pushed once, hence the queues are created with this capacity and a push never
+  // fails.
+  std::unique_ptr<Core::MPMCQueue<size_t>>                          mConvertedMeshes;
+  std::unique_ptr<Core::MPMCQueue<std::shared_ptr<DecodedTexture>>> mDecodedTextures;
+
+  // For each Texture, the members of the Materials which will be set to this Texture once it has
+  // been uploaded.
+  std::vector<std::vector<TexturePtr*>> mTextureUsers;
+
+  // These are only accessed by the thread which created the Model.
+  size_t mPendingMeshes   = 0;
+  size_t mPendingTextures = 0;
+
+  // The number of tasks which have been enqueued with enqueue() but have not finished yet.
+  size_t                  mRunningTasks = 0;
+  std::mutex              mTaskMutex;
+  std::condition_variable mTaskCondition;
+
+  // Enqueues the task to the ThreadPool and counts it in mRunningTasks. The task has to keep the
+  // LoadingState alive. Exceptions thrown by the task are reported with setError().
+  void enqueue(std::function<void()> const& task);
+
+  // Blocks until all tasks of this LoadingState have finished, including the tasks which have been
+  // enqueued by them. The ThreadPool is shared, so waiting for it would wait for other Models too.
+  void waitForTasks();
+
+  std::mutex  mErrorMutex;
+  std::string mError;
+
+  void setError(std::string const& error) {
+    std::unique_lock<std::mutex> lock(mErrorMutex);
+    if (mError.empty()) {
+      mError = error;
+    }
+  }
+
+  // With LoadOptionBits::eCache, the parsed file and the results of the tasks are read from a
+  // cache file if its key matches. Else they are collected and written to a new cache file once
+  // everything is loaded. The key only covers the file itself; the external buffers and images of
+  // .gltf files are stored as mDependencies and compared by readCache().
+  struct Dependency {
+    std::string mFile;
+    uint64_t    mSize = 0;
+    int64_t     mTime = 0;
+  };
+
+  struct Cache {
+    std::string                                  mFile;
+    uint64_t                                     mKey = 0;
+    std::vector<Dependency>                      mDependencies;
+    std::shared_ptr<Core::MappedFile>            mMapping;
+    std::vector<MeshRange>                       mMeshRanges;
+    std::vector<std::shared_ptr<DecodedTexture>> mTextures;
+    uint8_t const*                               mVertexData  = nullptr;
+    uint8_t const*                               mSkinData    = nullptr;
+    uint8_t const*                               mIndexData   = nullptr;
+    size_t                                       mVertexBytes = 0;
+    size_t                                       mSkinBytes   = 0;
+    size_t                                       mIndexBytes  = 0;
+    bool                                         mWrite       = false;
+  };
+
+  Cache mCache;
+
+  // Maps mCache.mFile and reads everything except for the MeshRange offsets, which are not stored.
+  // On success, mModel contains the parsed file as far as it is used by the constructor of the
+  // Model. Returns false if the file does not exist, is invalid, has a different key or if one of
+  // the dependencies has been modified.
+  bool readCache(bool loadTextures);
+
+  // Stores the external buffers and images of mModel as mCache.mDependencies.
+  void setDependencies(std::string const& baseDir);
+
+  // Writes mModel, the vertex data, the MeshRanges and mCache.mTextures to mCache.mFile. This is
+  // called by a worker thread once everything has been loaded.
+  void writeCache() const;
+
+  // Builds the Meshlets of all Primitives of the given Mesh from mIndexData and mVertexData, so
+  // this works for converted Meshes as well as for Meshes read from the cache file. The vertex
+  // offsets of the MeshRange have to be set already.
+  void buildMeshlets(size_t meshIndex, bool loadSkins);
+
+  // Reads the geometry of the Meshes from the cache file in the background; each Mesh is pushed to
+  // mConvertedMeshes once its data is resident, so that update() does not block on disc I/O when
+  // copying it to the staging memory. This is declared last, as its destructor waits for the
+  // current read, whose callback accesses the other members.
+  std::unique_ptr<Core::ChunkedReader> mReader;
+};
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void Model::LoadingState::enqueue(std::function<void()> const& task) {
+  {
+    std::unique_lock<std::mutex> lock(mTaskMutex);
+    ++mRunningTasks;
+  }
+
+  getThreadPool().enqueue([this, task]() {
+    try {
+      task();
+    } catch (std::exception const& e) {
+      setError(e.what());
+    }
+
+    {
+      std::unique_lock<std::mutex> lock(mTaskMutex);
+      --mRunningTasks;
+    }
+
+    // the task is still alive, hence the LoadingState is as well
+    mTaskCondition.notify_all();
+  });
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void Model::LoadingState::waitForTasks() {
+  {
+    std::unique_lock<std::mutex> lock(mTaskMutex);
+    mTaskCondition.wait(lock, [this]() { return mRunningTasks == 0; });
+  }
+
+  if (mReader) {
+    mReader->wait();
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+bool Model::LoadingState::readCache(bool loadTextures) {
+  auto mapping = std::make_shared<Core::MappedFile>(mCache.mFile);
+
+  if (!mapping->isValid()) {
+    return false;
+  }
+
+  CacheReader reader(mapping->getData(), mapping->getSize());
+
+  char     magic[sizeof(CACHE_MAGIC)];
+  uint32_t version, cachedTextureCount;
+  uint64_t key, dependencyCount, meshCount, vertexBytes, skinBytes, indexBytes;
+
+  reader.read(magic);
+  reader.read(version);
+  reader.read(key);
+
+  if (!reader.isValid() || std::memcmp(magic, CACHE_MAGIC, sizeof(CACHE_MAGIC)) != 0 ||
+      version != CACHE_VERSION || key != mCache.mKey) {
+    return false;
+  }
+
+  std::vector<Dependency> dependencies;
+
+  reader.read(dependencyCount);
+
+  for (uint64_t i(0); i < dependencyCount && reader.isValid(); ++i) {
+    Dependency dependency;
+    reader.read(dependency.mFile);
+    reader.read(dependency.mSize);
+    reader.read(dependency.mTime);
+
+    if (!reader.isValid() ||
+        Core::FileSystem::getFileSize(dependency.mFile) != dependency.mSize ||
+        Core::FileSystem::getLastWriteTime(dependency.mFile) != dependency.mTime) {
+      return false;
+    }
+
+    dependencies.push_back(dependency);
+  }
+
+  tinygltf::Model document;
+
+  if (!readDocument(reader, document)) {
+    return false;
+  }
+
+  size_t textureCount = loadTextures ? document.textures.size() : 0;
+
+  reader.read(cachedTextureCount);
+  reader.read(meshCount);
+
+  if (!reader.isValid() || cachedTextureCount != textureCount ||
+      meshCount != document.meshes.size()) {
+    return false;
+  }
+
+  reader.read(vertexBytes);
+  reader.read(skinBytes);
+  reader.read(indexBytes);
+
+  std::vector<MeshRange> meshRanges(meshCount);
+
+  for (size_t m(0); m < meshCount; ++m) {
+    auto&    range          = meshRanges[m];
+    uint32_t primitiveCount = 0;
+    reader.read(range.mVertexCount);
+    reader.read(primitiveCount);
+
+    if (!reader.isValid() || primitiveCount != document.meshes[m].primitives.size()) {
+      return false;
+    }
+
+    range.mBoundingBoxes.resize(primitiveCount);
+    range.mVertexOffsets.resize(primitiveCount);
+    range.mLods.resize(primitiveCount);
+
+    for (uint32_t i(0); i < primitiveCount; ++i) {
+      uint32_t lodCount = 0;
+      reader.read(range.mBoundingBoxes[i].mMin);
+      reader.read(range.mBoundingBoxes[i].mMax);
+      reader.read(range.mVertexOffsets[i]);
+      reader.read(lodCount);
+
+      // a Primitive has at most three Lods
+      if (!reader.isValid() || lodCount > 3) {
+        return false;
+      }
+
+      range.mLods[i].resize(lodCount);
+
+      for (auto& lod : range.mLods[i]) {
+        uint32_t indexCount = 0;
+        reader.read(lod.mIndexOffset);
+        reader.read(indexCount);
+        reader.read(lod.mError);
+        lod.mIndexCount = indexCount;
+      }
+    }
+  }
+
+  mCache.mVertexBytes = vertexBytes;
+  mCache.mSkinBytes   = skinBytes;
+  mCache.mIndexBytes  = indexBytes;
+  mCache.mVertexData  = reader.readBlob(vertexBytes);
+  mCache.mSkinData    = reader.readBlob(skinBytes);
+  mCache.mIndexData   = reader.readBlob(indexBytes);
+
+  std::vector<std::shared_ptr<DecodedTexture>> textures(textureCount);
+
+  for (size_t i(0); i < textureCount; ++i) {
+    uint32_t width = 0, height = 0, levels = 0, format = 0;
+    uint64_t size = 0;
+    reader.read(width);
+    reader.read(height);
+    reader.read(levels);
+    reader.read(format);
+    reader.read(size);
+
+    textures[i]             = std::make_shared<DecodedTexture>();
+    textures[i]->mIndex     = i;
+    textures[i]->mImageInfo =
+        getImageInfo(width, height, levels, static_cast<vk::Format>(format));
+    textures[i]->mSize      = size;
+    textures[i]->mPixels    = reader.readBlob(size);
+    textures[i]->mMapping   = mapping;
+  }
+
+  if (!reader.isValid()) {
+    return false;
+  }
+
+  mModel               = std::move(document);
+  mCache.mDependencies = std::move(dependencies);
+  mCache.mMapping      = mapping;
+  mCache.mMeshRanges   = std::move(meshRanges);
+  mCache.mTextures     = std::move(textures);
+
+  return true;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void Model::LoadingState::setDependencies(std::string const& baseDir) {
+  mCache.mDependencies.clear();
+
+  auto add = [&](std::string const& uri) {
+    if (uri.empty() || uri.compare(0, 5, "data:") == 0) {
+      return;
+    }
+
+    Dependency dependency;
+    dependency.mFile = baseDir + uri;
+    dependency.mSize = Core::FileSystem::getFileSize(dependency.mFile);
+    dependency.mTime = Core::FileSystem::getLastWriteTime(dependency.mFile);
+    mCache.mDependencies.push_back(dependency);
+  };
+
+  for (auto const& b : mModel.buffers) {
+    add(b.uri);
+  }
+
+  for (auto const& i : mModel.images) {
+    add(i.uri);
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void Model::LoadingState::writeCache() const {
+
+  // The file is written to a temporary file first, so that no other process reads a partially
+  // written cache.
+  std::string tmpFile = Core::FileSystem::getTemporaryFileName(mCache.mFile);
 
-  // load the file ---------------------------------------------------------------------------------
-  tinygltf::Model model;
   {
-    std::string        extension{file.substr(file.find_last_of('.'))};
+    CacheWriter writer(tmpFile);
+
+    size_t vertexBytes = mVertices.size() * sizeof(Vertex);
+    if (mVertexLayout != VertexLayout::eDefault) {
+      vertexBytes = mCompactVertices.size() * sizeof(CompactVertex);
+    }
+
+    size_t skinBytes  = mSkinVertices.size() * sizeof(SkinVertex);
+    size_t indexBytes = mIndices.size() * sizeof(uint32_t);
+    if (!mShortIndices.empty()) {
+      indexBytes = mShortIndices.size() * sizeof(uint16_t);
+    }
+
+    writer.write(CACHE_MAGIC);
+    writer.write(CACHE_VERSION);
+    writer.write(mCache.mKey);
+    writer.write(static_cast<uint64_t>(mCache.mDependencies.size()));
+
+    for (auto const& dependency : mCache.mDependencies) {
+      writer.write(dependency.mFile);
+      writer.write(dependency.mSize);
+      writer.write(dependency.mTime);
+    }
+
+    writeDocument(writer, mModel);
+
+    writer.write(static_cast<uint32_t>(mCache.mTextures.size()));
+    writer.write(static_cast<uint64_t>(mMeshRanges.size()));
+    writer.write(static_cast<uint64_t>(vertexBytes));
+    writer.write(static_cast<uint64_t>(skinBytes));
+    writer.write(static_cast<uint64_t>(indexBytes));
+
+    for (auto const& range : mMeshRanges) {
+      writer.write(range.mVertexCount);
+      writer.write(static_cast<uint32_t>(range.mBoundingBoxes.size()));
+
+      for (size_t i(0); i < range.mBoundingBoxes.size(); ++i) {
+        writer.write(range.mBoundingBoxes[i].mMin);
+        writer.write(range.mBoundingBoxes[i].mMax);
+        writer.write(range.mVertexOffsets[i]);
+        writer.write(static_cast<uint32_t>(range.mLods[i].size()));
+
+        for (auto const& lod : range.mLods[i]) {
+          writer.write(lod.mIndexOffset);
+          writer.write(static_cast<uint32_t>(lod.mIndexCount));
+          writer.write(lod.mError);
+        }
+      }
+    }
+
+    writer.writeBlob(mVertexData, vertexBytes);
+    writer.writeBlob(mSkinData, skinBytes);
+    writer.writeBlob(mIndexData, indexBytes);
+
+    for (auto const& texture : mCache.mTextures) {
+      writer.write(texture->mImageInfo.extent.width);
+      writer.write(texture->mImageInfo.extent.height);
+      writer.write(texture->mImageInfo.mipLevels);
+      writer.write(static_cast<uint32_t>(texture->mImageInfo.format));
+      writer.write(static_cast<uint64_t>(texture->mSize));
+      writer.writeBlob(texture->mPixels, texture->mSize);
+    }
+
+    if (!writer.isValid()) {
+      ILLUSION_WARNING << "Failed to write cache file " << tmpFile << "!" << std::endl;
+      std::remove(tmpFile.c_str());
+      return;
+    }
+  }
+
+  if (!Core::FileSystem::replaceFile(tmpFile, mCache.mFile)) {
+    ILLUSION_WARNING << "Failed to write cache file " << mCache.mFile << "!" << std::endl;
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void Model::LoadingState::buildMeshlets(size_t meshIndex, bool loadSkins) {
+  auto&       range      = mMeshRanges[meshIndex];
+  auto const& primitives = mModel.meshes[meshIndex].primitives;
+
+  // both Vertex and CompactVertex start with the position
+  size_t vertexSize =
+      mVertexLayout == VertexLayout::eDefault ? sizeof(Vertex) : sizeof(CompactVertex);
+
+  uint32_t meshletStart  = range.mFirstMeshlet;
+  uint32_t vertexStart   = range.mFirstMeshletVertex;
+  uint32_t triangleStart = range.mFirstMeshletTriangle;
+
+  range.mMeshlets.assign(primitives.size(), {0, 0});
+
+  for (size_t i(0); i < primitives.size(); ++i) {
+    if (!hasMeshlets(primitives[i], loadSkins)) {
+      continue;
+    }
+
+    std::vector<uint32_t> indices(getIndexCount(mModel, primitives[i]));
+
+    for (size_t j(0); j < indices.size(); ++j) {
+      size_t index = range.mIndexOffsets[i] + j;
+      if (mIndexType == vk::IndexType::eUint16) {
+        indices[j] = reinterpret_cast<uint16_t const*>(mIndexData)[index];
+      } else {
+        indices[j] = reinterpret_cast<uint32_t const*>(mIndexData)[index];
+      }
+    }
+
+    // optimized Primitives may use fewer vertices than the original ones
+    size_t vertexCount =
+        indices.empty() ? 0 : *std::max_element(indices.begin(), indices.end()) + 1;
+    std::vector<glm::vec3> positions(vertexCount);
+
+    for (size_t v(0); v < vertexCount; ++v) {
+      std::memcpy(&positions[v], mVertexData + vertexSize * (range.mVertexOffsets[i] + v),
+          sizeof(glm::vec3));
+    }
+
+    std::vector<MeshOptimizer::Meshlet> meshlets;
+    std::vector<uint32_t>               meshletVertices;
+    std::vector<uint32_t>               meshletTriangles;
+    MeshOptimizer::buildMeshlets(indices, positions, meshlets, meshletVertices, meshletTriangles);
+
+    for (auto& meshlet : meshlets) {
+      meshlet.mVertexOffset += vertexStart;
+      meshlet.mTriangleOffset += triangleStart;
+    }
+
+    std::copy(meshlets.begin(), meshlets.end(), mMeshlets.begin() + meshletStart);
+    std::copy(
+        meshletVertices.begin(), meshletVertices.end(), mMeshletVertices.begin() + vertexStart);
+    std::copy(meshletTriangles.begin(), meshletTriangles.end(),
+        mMeshletTriangles.begin() + triangleStart);
+
+    range.mMeshlets[i] = {meshletStart, static_cast<uint32_t>(meshlets.size())};
+
+    meshletStart += static_cast<uint32_t>(meshlets.size());
+    vertexStart += static_cast<uint32_t>(meshletVertices.size());
+    triangleStart += static_cast<uint32_t>(meshletTriangles.size());
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+Model::Model(DevicePtr const& device, std::string const& file, LoadOptions options,
+    TextureStreamerPtr const& textureStreamer)
+    : mDevice(device)
+    , mRootNode(std::make_shared<Node>())
+    , mArena(std::make_shared<Arena>())
+    , mTextureStreamer(textureStreamer)
+    , mLoadingState(std::make_shared<LoadingState>()) {
+  ILLUSION_ZONE("Gltf::Model Loading");
+
+  mLoadingState->mFile = file;
+
+  auto  state = mLoadingState;
+  auto& model = mLoadingState->mModel;
+
+  std::string extension{file.substr(file.find_last_of('.'))};
+  std::string baseDir{file.substr(0, file.find_last_of("/\\") + 1)};
+
+  if (extension != ".glb" && extension != ".gltf") {
+    throw std::runtime_error(
+        "Error loading GLTF file " + file + ": Unknown extension " + extension);
+  }
+
+  // Parses the file to mModel. The file is mapped instead of read into memory. This is skipped if
+  // the cache file is valid, unless the cache file turns out to be inconsistent later on.
+  auto loadFile = [state, file, extension, baseDir]() {
+    Core::MappedFile mapping(file);
+
+    if (!mapping.isValid()) {
+      throw std::runtime_error("Error loading GLTF file " + file + ": Cannot open file!");
+    }
+
     std::string        error, warn;
     bool               success = false;
     tinygltf::TinyGLTF loader;
 
+    // tinygltf takes the size as unsigned int; larger files are rejected instead of truncated
+    size_t size = mapping.getSize();
+
+    if (size > std::numeric_limits<unsigned int>::max()) {
+      throw std::runtime_error("Error loading GLTF file " + file + ": File is too large!");
+    }
+
+    state->mModel = tinygltf::Model();
+    state->mEncodedImages.clear();
+
+    loader.SetImageLoader(&storeEncodedImage, &state->mEncodedImages);
+
     if (extension == ".glb") {
       ILLUSION_TRACE << "Loading binary file " << file << "..." << std::endl;
-      success = loader.LoadBinaryFromFile(&model, &error, &warn, file);
-    } else if (extension == ".gltf") {
-      ILLUSION_TRACE << "Loading ascii file " << file << "..." << std::endl;
-      success = loader.LoadASCIIFromFile(&model, &error, &warn, file);
+      success = loader.LoadBinaryFromMemory(&state->mModel, &error, &warn, mapping.getData(),
+          static_cast<unsigned int>(size), baseDir);
     } else {
-      throw std::runtime_error(
-          "Error loading GLTF file " + file + ": Unknown extension " + extension);
+      ILLUSION_TRACE << "Loading ascii file " << file << "..." << std::endl;
+      success = loader.LoadASCIIFromString(&state->mModel, &error, &warn,
+          reinterpret_cast<char const*>(mapping.getData()),
+          static_cast<unsigned int>(size), baseDir);
     }
 
     if (!error.empty()) {
@@ -135,11 +2161,83 @@ Model::Model(DevicePtr const& device, std::string const& file, LoadOptions optio
     if (!success) {
       throw std::runtime_error("Error loading GLTF file " + file);
     }
+
+    state->setDependencies(baseDir);
+  };
+
+  // check the cache file --------------------------------------------------------------------------
+  // The key contains everything which affects the results of the tasks: the path, the size and the
+  // modification time of the file and the relevant LoadOptions. The external buffers and images
+  // are checked by readCache(). If the cache file is valid, the file is not parsed at all.
+  bool cacheHit = false;
+
+  // Textures are only compressed if the device supports the formats, so this is part of the key
+  // instead of eCompressTextures. BC1 is used for opaque images, BC3 for all others.
+  bool compressTextures = false;
+
+  if ((options & LoadOptionBits::eTextures) && (options & LoadOptionBits::eCompressTextures)) {
+    auto const& physicalDevice = mDevice->getPhysicalDevice();
+    compressTextures = physicalDevice->supportsSampledFormat(vk::Format::eBc1RgbUnormBlock) &&
+                       physicalDevice->supportsSampledFormat(vk::Format::eBc3UnormBlock);
+
+    if (!compressTextures) {
+      ILLUSION_WARNING << "Not compressing textures of " << file
+                       << ": BC1 and BC3 are not supported by the device!" << std::endl;
+    }
+  }
+
+  if (options & LoadOptionBits::eCache) {
+    auto relevantOptions = static_cast<int>(options & (LoadOptionBits::eSkins |
+                                                          LoadOptionBits::eTextures |
+                                                          LoadOptionBits::eCompactVertices |
+                                                          LoadOptionBits::eOptimizeMeshes |
+                                                          LoadOptionBits::eGenerateLods |
+                                                          LoadOptionBits::eGeometryArena));
+
+    uint64_t size = Core::FileSystem::getFileSize(file);
+    int64_t  time = Core::FileSystem::getLastWriteTime(file);
+
+    uint64_t key = Core::hashBytes(CACHE_VERSION, &relevantOptions, sizeof(relevantOptions));
+    key          = Core::hashBytes(key, &compressTextures, sizeof(compressTextures));
+    key          = Core::hashBytes(key, file.data(), file.size());
+    key          = Core::hashBytes(key, &size, sizeof(size));
+    key          = Core::hashBytes(key, &time, sizeof(time));
+
+    state->mCache.mFile = file + ".cache";
+    state->mCache.mKey  = key;
+
+    cacheHit             = state->readCache(static_cast<bool>(options & LoadOptionBits::eTextures));
+    state->mCache.mWrite = !cacheHit;
+
+    if (cacheHit) {
+      ILLUSION_TRACE << "Using cache file " << state->mCache.mFile << "." << std::endl;
+    }
   }
 
+  if (!cacheHit) {
+    loadFile();
+  }
+
+  state->mConvertedMeshes = std::make_unique<Core::MPMCQueue<size_t>>(model.meshes.size());
+  state->mDecodedTextures =
+      std::make_unique<Core::MPMCQueue<std::shared_ptr<LoadingState::DecodedTexture>>>(
+          model.textures.size());
+
   // create textures -------------------------------------------------------------------------------
+  // The images are decoded by the worker threads, the Textures are created by update().
   {
     if (options & LoadOptionBits::eTextures) {
+      mTextures.resize(model.textures.size());
+      state->mTextureUsers.resize(model.textures.size());
+
+      if (mTextureStreamer) {
+        mStreamingHandles.resize(model.textures.size(), INVALID_STREAMING_HANDLE);
+      }
+      state->mPendingTextures = model.textures.size();
+
+      // the Textures which use the same image, it is decoded only once for all of them
+      std::map<int, std::vector<std::shared_ptr<LoadingState::DecodedTexture>>> sourceUsers;
+
       for (size_t i(0); i < model.textures.size(); ++i) {
 
         tinygltf::Sampler sampler;
@@ -153,15 +2251,21 @@ Model::Model(DevicePtr const& device, std::string const& file, LoadOptions optio
           sampler.wrapT     = TINYGLTF_TEXTURE_WRAP_REPEAT;
         }
 
-        tinygltf::Image image;
+        int source = model.textures[i].source;
 
-        if (model.textures[i].source >= 0) {
-          image = model.images[model.textures[i].source];
-        } else {
+        bool missingSource = source < 0 ||
+                             static_cast<size_t>(source) >= state->mEncodedImages.size() ||
+                             state->mEncodedImages[source].empty();
+
+        if (!cacheHit && missingSource) {
           throw std::runtime_error("Error loading GLTF file " + file + ": No image source given");
         }
 
-        vk::SamplerCreateInfo samplerInfo;
+        auto texture = cacheHit ? state->mCache.mTextures[i]
+                                : std::make_shared<LoadingState::DecodedTexture>();
+        texture->mIndex = i;
+
+        vk::SamplerCreateInfo& samplerInfo  = texture->mSamplerInfo;
         samplerInfo.magFilter               = convertFilter(sampler.magFilter);
         samplerInfo.minFilter               = convertFilter(sampler.minFilter);
         samplerInfo.addressModeU            = convertSamplerAddressMode(sampler.wrapS);
@@ -176,50 +2280,68 @@ Model::Model(DevicePtr const& device, std::string const& file, LoadOptions optio
         samplerInfo.mipmapMode              = convertSamplerMipmapMode(sampler.minFilter);
         samplerInfo.mipLodBias              = 0.f;
         samplerInfo.minLod                  = 0.f;
-        samplerInfo.maxLod =
-            static_cast<float>(Texture::getMaxMipmapLevels(image.width, image.height));
 
-        // TODO: if no image data has been loaded, try loading it on our own
-        if (image.image.empty()) {
-          throw std::runtime_error(
-              "Failed to load GLTF model: Non-tinygltf texture loading is not implemented yet!");
-        } else {
-          // if there is image data, create an appropriate texture object for it
-          vk::ImageCreateInfo imageInfo;
-          imageInfo.imageType = vk::ImageType::e2D;
-          imageInfo.format =
-              image.component == 3 ? vk::Format::eR8G8B8Unorm : vk::Format::eR8G8B8A8Unorm;
-          imageInfo.extent.width  = image.width;
-          imageInfo.extent.height = image.height;
-          imageInfo.extent.depth  = 1;
-          imageInfo.mipLevels     = static_cast<uint32_t>(samplerInfo.maxLod);
-          imageInfo.arrayLayers   = 1;
-          imageInfo.samples       = vk::SampleCountFlagBits::e1;
-          imageInfo.tiling        = vk::ImageTiling::eOptimal;
-          imageInfo.usage         = vk::ImageUsageFlagBits::eSampled |
-                            vk::ImageUsageFlagBits::eTransferSrc |
-                            vk::ImageUsageFlagBits::eTransferDst;
-          imageInfo.sharingMode   = vk::SharingMode::eExclusive;
-          imageInfo.initialLayout = vk::ImageLayout::eUndefined;
-
-          // create the texture
-          auto texture = mDevice->createTexture(imageInfo, samplerInfo, vk::ImageViewType::e2D,
-              vk::ImageAspectFlagBits::eColor, vk::ImageLayout::eShaderReadOnlyOptimal,
-              vk::ComponentMapping(), image.image.size(), (void*)image.image.data());
-
-          Texture::updateMipmaps(mDevice, texture);
-
-          mTextures.push_back(texture);
+        if (cacheHit) {
+          samplerInfo.maxLod = static_cast<float>(texture->mImageInfo.mipLevels);
+          state->mDecodedTextures->push(texture);
+          continue;
         }
+
+        sourceUsers[source].push_back(texture);
+      }
+
+      for (auto const& users : sourceUsers) {
+        state->enqueue([state, textures = users.second, source = users.first, compressTextures]() {
+          if (state->mCancelled) {
+            return;
+          }
+
+          auto     data = std::make_shared<std::vector<uint8_t>>();
+          uint32_t width, height, levels;
+
+          if (!decodeImage(state->mEncodedImages[source], width, height, levels, *data)) {
+            state->setError("Failed to decode image " + std::to_string(source) + ": " +
+                            stbi_failure_reason());
+            return;
+          }
+
+          vk::Format format = vk::Format::eR8G8B8A8Unorm;
+
+          if (compressTextures) {
+            format = TextureCompression::isOpaque(data->data(), width, height)
+                         ? vk::Format::eBc1RgbUnormBlock
+                         : vk::Format::eBc3UnormBlock;
+            *data = TextureCompression::compress(format, data->data(), width, height, levels);
+          }
+
+          for (auto const& texture : textures) {
+            texture->mSamplerInfo.maxLod = static_cast<float>(levels);
+            texture->mImageInfo          = getImageInfo(width, height, levels, format);
+            texture->mData               = data;
+            texture->mPixels             = data->data();
+            texture->mSize               = data->size();
+
+            state->mDecodedTextures->push(texture);
+          }
+        });
       }
     }
   }
 
   // create materials ------------------------------------------------------------------------------
   {
+    // The Texture members of the Materials are set by update() once the Textures are available.
+    auto setTexture = [this](TexturePtr& member, int index) {
+      if (index >= 0 && static_cast<size_t>(index) < mTextures.size()) {
+        mLoadingState->mTextureUsers[index].push_back(&member);
+      }
+    };
+
+    mArena->mMaterials.resize(std::max<size_t>(1, model.materials.size()));
+
     // create default material if necessary
     if (model.materials.size() == 0) {
-      auto m = std::make_shared<Material>();
+      auto m = MaterialPtr(mArena, &mArena->mMaterials[0]);
 
       m->mAlbedoTexture            = mDevice->getSinglePixelTexture({255, 255, 255, 255});
       m->mMetallicRoughnessTexture = mDevice->getSinglePixelTexture({255, 255, 255, 255});
@@ -238,7 +2360,7 @@ Model::Model(DevicePtr const& device, std::string const& file, LoadOptions optio
 
       for (auto const& material : model.materials) {
 
-        auto m = std::make_shared<Material>();
+        auto m = MaterialPtr(mArena, &mArena->mMaterials[mMaterials.size()]);
 
         m->mAlbedoTexture            = mDevice->getSinglePixelTexture({255, 255, 255, 255});
         m->mMetallicRoughnessTexture = mDevice->getSinglePixelTexture({255, 255, 255, 255});
@@ -249,12 +2371,10 @@ Model::Model(DevicePtr const& device, std::string const& file, LoadOptions optio
         m->mName = material.name;
 
         for (auto const& p : material.values) {
-          if (p.first == "baseColorTexture" &&
-              static_cast<size_t>(p.second.TextureIndex()) < mTextures.size()) {
-            m->mAlbedoTexture = mTextures[p.second.TextureIndex()];
-          } else if (p.first == "metallicRoughnessTexture" &&
-                     static_cast<size_t>(p.second.TextureIndex()) < mTextures.size()) {
-            m->mMetallicRoughnessTexture = mTextures[p.second.TextureIndex()];
+          if (p.first == "baseColorTexture") {
+            setTexture(m->mAlbedoTexture, p.second.TextureIndex());
+          } else if (p.first == "metallicRoughnessTexture") {
+            setTexture(m->mMetallicRoughnessTexture, p.second.TextureIndex());
           } else if (p.first == "metallicFactor") {
             m->mMetallicRoughnessFactor.b = static_cast<float>(p.second.Factor());
           } else if (p.first == "roughnessFactor") {
@@ -273,15 +2393,13 @@ Model::Model(DevicePtr const& device, std::string const& file, LoadOptions optio
             m->mSpecularGlossinessWorkflow = true;
 
             auto val = p.second.Get("specularGlossinessTexture");
-            if (val.IsObject() &&
-                static_cast<size_t>(val.Get("index").Get<int>()) < mTextures.size()) {
-              m->mMetallicRoughnessTexture = mTextures[val.Get("index").Get<int>()];
+            if (val.IsObject()) {
+              setTexture(m->mMetallicRoughnessTexture, val.Get("index").Get<int>());
             }
 
             val = p.second.Get("diffuseTexture");
-            if (val.IsObject() &&
-                static_cast<size_t>(val.Get("index").Get<int>()) < mTextures.size()) {
-              m->mAlbedoTexture = mTextures[val.Get("index").Get<int>()];
+            if (val.IsObject()) {
+              setTexture(m->mAlbedoTexture, val.Get("index").Get<int>());
             }
 
             val = p.second.Get("diffuseFactor");
@@ -315,15 +2433,12 @@ Model::Model(DevicePtr const& device, std::string const& file, LoadOptions optio
         bool hasBlendMode = false;
 
         for (auto const& p : material.additionalValues) {
-          if (p.first == "normalTexture" &&
-              static_cast<size_t>(p.second.TextureIndex()) < mTextures.size()) {
-            m->mNormalTexture = mTextures[p.second.TextureIndex()];
-          } else if (p.first == "occlusionTexture" &&
-                     static_cast<size_t>(p.second.TextureIndex()) < mTextures.size()) {
-            m->mOcclusionTexture = mTextures[p.second.TextureIndex()];
-          } else if (p.first == "emissiveTexture" &&
-                     static_cast<size_t>(p.second.TextureIndex()) < mTextures.size()) {
-            m->mEmissiveTexture = mTextures[p.second.TextureIndex()];
+          if (p.first == "normalTexture") {
+            setTexture(m->mNormalTexture, p.second.TextureIndex());
+          } else if (p.first == "occlusionTexture") {
+            setTexture(m->mOcclusionTexture, p.second.TextureIndex());
+          } else if (p.first == "emissiveTexture") {
+            setTexture(m->mEmissiveTexture, p.second.TextureIndex());
           } else if (p.first == "normalScale") {
             m->mNormalScale = static_cast<float>(p.second.Factor());
           } else if (p.first == "alphaCutoff") {
@@ -358,274 +2473,515 @@ Model::Model(DevicePtr const& device, std::string const& file, LoadOptions optio
           }
         }
 
-        if (!hasBlendMode) {
-          m->mAlphaCutoff = 0.f;
+        if (!hasBlendMode) {
+          m->mAlphaCutoff = 0.f;
+        }
+
+        mMaterials.emplace_back(m);
+      }
+    }
+
+    // the factors of all Materials are uploaded once, see getMaterialBuffer()
+    std::vector<Material::Parameters> parameters;
+    parameters.reserve(mMaterials.size());
+    for (auto const& m : mMaterials) {
+      parameters.push_back(m->getParameters());
+    }
+
+    mMaterialBuffer = mDevice->createBackedBuffer(
+        vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eTransferDst,
+        vk::MemoryPropertyFlagBits::eDeviceLocal,
+        sizeof(Material::Parameters) * parameters.size(), parameters.data());
+  }
+
+  // create meshes & primitives --------------------------------------------------------------------
+  // The Primitives are created here; the vertex data of each Mesh is converted by a worker thread
+  // and uploaded by update(). The offsets of the morphed copies of the Primitives are assigned to
+  // the Nodes below.
+  std::vector<std::vector<int32_t>> morphVertexOffsets(model.nodes.size());
+
+  {
+    bool   loadSkins      = static_cast<bool>(options & LoadOptionBits::eSkins);
+    bool   optimizeMeshes = static_cast<bool>(options & LoadOptionBits::eOptimizeMeshes);
+    bool   generateLods   = static_cast<bool>(options & LoadOptionBits::eGenerateLods);
+    bool   buildMeshlets  = static_cast<bool>(options & LoadOptionBits::eMeshlets);
+    bool   useArena       = static_cast<bool>(options & LoadOptionBits::eGeometryArena);
+    bool   hasSkins       = false;
+    size_t vertexCount    = 0;
+    size_t indexCount     = 0;
+    size_t maxVertices    = 0;
+
+    size_t meshletCount         = 0;
+    size_t meshletVertexCount   = 0;
+    size_t meshletTriangleCount = 0;
+
+    std::vector<Primitive::MorphDelta> morphDeltas;
+
+    mArena->mMeshes.resize(model.meshes.size());
+
+    for (auto const& m : model.meshes) {
+
+      auto mesh   = MeshPtr(mArena, &mArena->mMeshes[mMeshes.size()]);
+      mesh->mName = m.name;
+
+      for (double weight : m.weights) {
+        mesh->mWeights.push_back(static_cast<float>(weight));
+      }
+
+      LoadingState::MeshRange range;
+      range.mFirstVertex          = static_cast<uint32_t>(vertexCount);
+      range.mFirstIndex           = static_cast<uint32_t>(indexCount);
+      range.mFirstMeshlet         = static_cast<uint32_t>(meshletCount);
+      range.mFirstMeshletVertex   = static_cast<uint32_t>(meshletVertexCount);
+      range.mFirstMeshletTriangle = static_cast<uint32_t>(meshletTriangleCount);
+
+      for (auto const& p : m.primitives) {
+        Primitive primitive;
+
+        // use default material if p.material < 0
+        primitive.mMaterial         = mMaterials[std::max(0, p.material)];
+        primitive.mTopology         = convertPrimitiveTopology(p.mode);
+        primitive.mVertexAttributes = getVertexAttributes(p, loadSkins);
+        primitive.mIndexOffset      = static_cast<uint32_t>(indexCount);
+        primitive.mIndexCount       = getIndexCount(model, p);
+
+        auto position = p.attributes.find("POSITION");
+        if (position == p.attributes.end()) {
+          throw std::runtime_error(
+              "Error loading GLTF file " + file + ": Primitive has no vertex data!");
+        }
+
+        // The bounds of the positions are mandatory in glTF. If they are missing anyways, the
+        // BoundingBox is computed from the vertices by update().
+        auto const& positions = model.accessors[position->second];
+        if (positions.minValues.size() == 3 && positions.maxValues.size() == 3) {
+          primitive.mBoundingBox.add(glm::vec3(glm::make_vec3(positions.minValues.data())));
+          primitive.mBoundingBox.add(glm::vec3(glm::make_vec3(positions.maxValues.data())));
+        }
+
+        primitive.mVertexOffset     = static_cast<int32_t>(vertexCount);
+
+        range.mIndexOffsets.push_back(primitive.mIndexOffset);
+
+        // the space for the Meshlets is reserved for the worst case
+        if (buildMeshlets && hasMeshlets(p, loadSkins)) {
+          size_t count = MeshOptimizer::getMaxMeshletCount(primitive.mIndexCount);
+          meshletCount += count;
+          meshletVertexCount += std::min<size_t>(
+              primitive.mIndexCount, count * MeshOptimizer::MAX_MESHLET_VERTICES);
+          meshletTriangleCount += primitive.mIndexCount / 3;
+        }
+
+        vertexCount += getVertexCount(model, p);
+        indexCount += primitive.mIndexCount;
+
+        // the Lods are stored after the indices of the Primitive, they are created by the tasks
+        if (generateLods) {
+          for (size_t lodIndexCount : getLodIndexCounts(model, p)) {
+            indexCount += lodIndexCount;
+          }
+        }
+        maxVertices = std::max(maxVertices, getVertexCount(model, p));
+        hasSkins =
+            hasSkins || static_cast<bool>(primitive.mVertexAttributes &
+                                          Primitive::VertexAttributeBits::eSkins);
+
+        // the morph targets are converted right away, they are required for creating the Nodes
+        if (!p.targets.empty()) {
+          auto& targets                 = primitive.mMorphTargets;
+          targets.mFirstDelta           = static_cast<uint32_t>(morphDeltas.size());
+          targets.mDisplacedVertexCount = convertMorphTargets(model, p, morphDeltas);
+
+          if (targets.mDisplacedVertexCount > 0) {
+            targets.mTargetCount = static_cast<uint32_t>(p.targets.size());
+            targets.mVertexCount = static_cast<uint32_t>(getVertexCount(model, p));
+            mesh->mWeights.resize(std::max(mesh->mWeights.size(), p.targets.size()), 0.f);
+          }
+        }
+
+        mesh->mBoundingBox.add(primitive.mBoundingBox);
+        mesh->mPrimitives.emplace_back(primitive);
+      }
+
+      range.mVertexCount = static_cast<uint32_t>(vertexCount) - range.mFirstVertex;
+      range.mIndexCount  = static_cast<uint32_t>(indexCount) - range.mFirstIndex;
+      range.mMeshletCount = static_cast<uint32_t>(meshletCount) - range.mFirstMeshlet;
+      range.mMeshletVertexCount =
+          static_cast<uint32_t>(meshletVertexCount) - range.mFirstMeshletVertex;
+      range.mMeshletTriangleCount =
+          static_cast<uint32_t>(meshletTriangleCount) - range.mFirstMeshletTriangle;
+
+      state->mMeshRanges.push_back(range);
+      mMeshes.emplace_back(mesh);
+    }
+
+    if (options & LoadOptionBits::eCompactVertices) {
+      mVertexLayout = hasSkins ? VertexLayout::eCompact : VertexLayout::eCompactUnskinned;
+    }
+
+    // Each Node with morph targets gets a copy of the vertices of the morphed Primitives of its
+    // Mesh. The copies are stored after the vertices of all Meshes; update() initializes them
+    // with the vertices of their Primitive.
+    size_t morphVertexCount = 0;
+
+    for (size_t i(0); i < model.nodes.size() && !morphDeltas.empty(); ++i) {
+      if (model.nodes[i].mesh < 0) {
+        continue;
+      }
+
+      bool hasMorphTargets = false;
+
+      for (auto const& primitive : mMeshes[model.nodes[i].mesh]->mPrimitives) {
+        if (primitive.mMorphTargets.mTargetCount == 0) {
+          morphVertexOffsets[i].push_back(-1);
+        } else {
+          morphVertexOffsets[i].push_back(static_cast<int32_t>(vertexCount + morphVertexCount));
+          morphVertexCount += primitive.mMorphTargets.mVertexCount;
+          hasMorphTargets = true;
         }
+      }
 
-        mMaterials.emplace_back(m);
+      if (!hasMorphTargets) {
+        morphVertexOffsets[i].clear();
       }
     }
-  }
 
-  // create meshes & primitives --------------------------------------------------------------------
-  {
-    std::vector<Vertex>   vertexBuffer;
-    std::vector<uint32_t> indexBuffer;
+    if (!morphDeltas.empty()) {
+      mMorphTargetBuffer = mDevice->createBackedBuffer(vk::BufferUsageFlagBits::eStorageBuffer,
+          vk::MemoryPropertyFlagBits::eDeviceLocal,
+          sizeof(Primitive::MorphDelta) * morphDeltas.size(), morphDeltas.data());
+    }
 
-    for (auto const& m : model.meshes) {
+    // the indices are relative to the first vertex of their Primitive; the GeometryArenas always
+    // store uint32_t indices
+    if (optimizeMeshes && !useArena &&
+        maxVertices <= size_t(std::numeric_limits<uint16_t>::max()) + 1) {
+      mIndexType = vk::IndexType::eUint16;
+    }
 
-      auto mesh   = std::make_shared<Mesh>();
-      mesh->mName = m.name;
+    size_t vertexSize = mVertexLayout == VertexLayout::eDefault ? sizeof(Vertex)
+                                                                : sizeof(CompactVertex);
+    size_t skinSize   = mVertexLayout == VertexLayout::eCompact ? sizeof(SkinVertex) : 0;
+    size_t indexSize = mIndexType == vk::IndexType::eUint16 ? sizeof(uint16_t) : sizeof(uint32_t);
+
+    // If the cache file is valid, the vertex data is uploaded directly from there. As the key
+    // matches, the sizes should match as well; this is only a safety net. As the Meshes have to be
+    // converted then, the file is parsed after all. The Textures are still read from the cache
+    // file; they are collected again by update() for the new one.
+    bool useCachedMeshes = cacheHit && state->mCache.mVertexBytes == vertexSize * vertexCount &&
+                           state->mCache.mSkinBytes == skinSize * vertexCount &&
+                           state->mCache.mIndexBytes == indexSize * indexCount;
+
+    if (cacheHit && !useCachedMeshes) {
+      ILLUSION_WARNING << "Ignoring vertex data of cache file " << state->mCache.mFile << "!"
+                       << std::endl;
+      state->mCache.mWrite = true;
+      state->mCache.mTextures.clear();
+      loadFile();
+      state->mEncodedImages.clear();
+    }
 
-      for (auto const& p : m.primitives) {
-        Primitive primitve;
+    state->mVertexLayout  = mVertexLayout;
+    state->mIndexType     = mIndexType;
+    state->mPendingMeshes = mMeshes.size();
 
-        // use default material if p.material < 0
-        primitve.mMaterial = mMaterials[std::max(0, p.material)];
-        primitve.mTopology = convertPrimitiveTopology(p.mode);
+    if (buildMeshlets) {
+      state->mMeshlets.resize(meshletCount);
+      state->mMeshletVertices.resize(meshletVertexCount);
+      state->mMeshletTriangles.resize(meshletTriangleCount);
+    }
+
+    if (useCachedMeshes) {
+      state->mVertexData = state->mCache.mVertexData;
+      state->mSkinData   = state->mCache.mSkinData;
+      state->mIndexData  = state->mCache.mIndexData;
+    } else {
+      if (mVertexLayout == VertexLayout::eDefault) {
+        state->mVertices.resize(vertexCount);
+        state->mVertexData = reinterpret_cast<uint8_t const*>(state->mVertices.data());
+      } else {
+        state->mCompactVertices.resize(vertexCount);
+        state->mVertexData = reinterpret_cast<uint8_t const*>(state->mCompactVertices.data());
+      }
 
-        size_t vertexStart = vertexBuffer.size();
+      if (mVertexLayout == VertexLayout::eCompact) {
+        state->mSkinVertices.resize(vertexCount);
+        state->mSkinData = reinterpret_cast<uint8_t const*>(state->mSkinVertices.data());
+      }
 
-        auto positions = p.attributes.find("POSITION");
-        if (positions == p.attributes.end()) {
-          throw std::runtime_error("Failed to load GLTF model: Primitve has no vertex data!");
-        }
+      if (mIndexType == vk::IndexType::eUint16) {
+        state->mShortIndices.resize(indexCount);
+        state->mIndexData = reinterpret_cast<uint8_t const*>(state->mShortIndices.data());
+      } else {
+        state->mIndices.resize(indexCount);
+        state->mIndexData = reinterpret_cast<uint8_t const*>(state->mIndices.data());
+      }
+    }
 
-        size_t vertexCount = model.accessors[positions->second].count;
-        vertexBuffer.resize(vertexStart + vertexCount);
+    // The buffers are created here, update() uploads the vertex data of each Mesh to its range.
+    // The morphed copies are written by a Gltf::Morpher, hence they have to be storage buffers.
+    size_t bufferVertexCount = std::max<size_t>(vertexCount + morphVertexCount, 1);
 
-        // positions
-        {
-          auto const& a = model.accessors[positions->second];
-          auto const& v = model.bufferViews[a.bufferView];
+    vk::BufferUsageFlags vertexUsage =
+        vk::BufferUsageFlagBits::eVertexBuffer | vk::BufferUsageFlagBits::eTransferDst;
+    if (mMorphTargetBuffer || buildMeshlets) {
+      vertexUsage |= vk::BufferUsageFlagBits::eStorageBuffer;
+    }
 
-          if (a.componentType != TINYGLTF_COMPONENT_TYPE_FLOAT) {
-            throw std::runtime_error(
-                "Failed to load GLTF model: Unsupported component type for positions!");
-          }
+    // A Gltf::RayTracingScene builds its acceleration structures directly from these buffers.
+    vk::BufferUsageFlags indexUsage =
+        vk::BufferUsageFlagBits::eIndexBuffer | vk::BufferUsageFlagBits::eTransferDst;
+    if (mDevice->getPhysicalDevice()->supportsRayQueries()) {
+      auto usage = vk::BufferUsageFlagBits::eShaderDeviceAddress |
+                   vk::BufferUsageFlagBits::eAccelerationStructureBuildInputReadOnlyKHR;
+      vertexUsage |= usage;
+      indexUsage |= usage;
+    }
 
-          size_t s = v.byteStride == 0 ? sizeof(glm::vec3) : v.byteStride;
-          for (size_t i(0); i < vertexCount; ++i) {
-            vertexBuffer[vertexStart + i].mPosition = *reinterpret_cast<glm::vec3*>(
-                &(model.buffers[v.buffer].data[a.byteOffset + v.byteOffset + i * s]));
-            primitve.mBoundingBox.add(vertexBuffer[vertexStart + i].mPosition);
-          }
-        }
+    if (mVertexLayout == VertexLayout::eCompactUnskinned) {
+      // this is read with a stride of zero
+      SkinVertex skin;
+      mSkinBuffer = mDevice->createBackedBuffer(vk::BufferUsageFlagBits::eVertexBuffer,
+          vk::MemoryPropertyFlagBits::eDeviceLocal, sizeof(SkinVertex), &skin);
+    }
 
-        auto normals = p.attributes.find("NORMAL");
-        if (normals != p.attributes.end()) {
-          primitve.mVertexAttributes |= Primitive::VertexAttributeBits::eNormals;
+    // With eGeometryArena, the vertices (and the SkinVertex stream of the compact layout) and the
+    // indices are stored in a range of the shared GeometryArena for this layout. The arena grows if
+    // it is full; only if it cannot grow any further, the Model uses buffers of its own.
+    if (useArena) {
+      std::vector<vk::DeviceSize> strides = {vertexSize};
+      if (mVertexLayout == VertexLayout::eCompact) {
+        strides.push_back(sizeof(SkinVertex));
+      }
 
-          auto const& a = model.accessors[normals->second];
-          auto const& v = model.bufferViews[a.bufferView];
+      auto const& arena = mDevice->getGeometryArena(strides);
+      mGeometry         = arena->allocate(
+          static_cast<uint32_t>(bufferVertexCount), static_cast<uint32_t>(indexCount));
 
-          if (a.componentType != TINYGLTF_COMPONENT_TYPE_FLOAT) {
-            throw std::runtime_error(
-                "Failed to load GLTF model: Unsupported component type for normals!");
-          }
+      if (mGeometry) {
+        mGeometryArena = arena;
+      } else {
+        ILLUSION_WARNING << "Not using the GeometryArena for " << file
+                         << ": The arena cannot grow any further!" << std::endl;
+      }
+    }
 
-          size_t s = v.byteStride == 0 ? sizeof(glm::vec3) : v.byteStride;
-          for (size_t i(0); i < vertexCount; ++i) {
-            vertexBuffer[vertexStart + i].mNormal = *reinterpret_cast<glm::vec3*>(
-                &(model.buffers[v.buffer].data[a.byteOffset + v.byteOffset + i * s]));
-          }
+    // update() uploads the Meshes one after another while the uploaded ones may already be drawn
+    // on the generic queue. With an exclusive sharing mode, the ownership of each of these ranges
+    // would have to be transferred from the transfer queue family, hence the buffers are shared.
+    vk::SharingMode sharing = vk::SharingMode::eConcurrent;
+
+    if (!mGeometry) {
+      if (mVertexLayout == VertexLayout::eCompact) {
+        mSkinBuffer = mDevice->createBackedBuffer(
+            vk::BufferUsageFlagBits::eVertexBuffer | vk::BufferUsageFlagBits::eTransferDst,
+            vk::MemoryPropertyFlagBits::eDeviceLocal, sizeof(SkinVertex) * bufferVertexCount,
+            nullptr, sharing);
+      }
+
+      mVertexBuffer = mDevice->createBackedBuffer(vertexUsage,
+          vk::MemoryPropertyFlagBits::eDeviceLocal, vertexSize * bufferVertexCount, nullptr,
+          sharing);
+      mIndexBuffer = mDevice->createBackedBuffer(indexUsage,
+          vk::MemoryPropertyFlagBits::eDeviceLocal, indexSize * std::max<size_t>(indexCount, 1),
+          nullptr, sharing);
+    }
+
+    if (buildMeshlets) {
+      vk::BufferUsageFlags meshletUsage =
+          vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eTransferDst;
+
+      mMeshletBuffer = mDevice->createBackedBuffer(meshletUsage,
+          vk::MemoryPropertyFlagBits::eDeviceLocal,
+          sizeof(MeshOptimizer::Meshlet) * std::max<size_t>(meshletCount, 1), nullptr, sharing);
+      mMeshletVertexBuffer = mDevice->createBackedBuffer(meshletUsage,
+          vk::MemoryPropertyFlagBits::eDeviceLocal,
+          sizeof(uint32_t) * std::max<size_t>(meshletVertexCount, 1), nullptr, sharing);
+      mMeshletTriangleBuffer = mDevice->createBackedBuffer(meshletUsage,
+          vk::MemoryPropertyFlagBits::eDeviceLocal,
+          sizeof(uint32_t) * std::max<size_t>(meshletTriangleCount, 1), nullptr, sharing);
+    }
+
+    if (useCachedMeshes && !buildMeshlets) {
+      state->mReader = std::make_unique<Core::ChunkedReader>(
+          state->mCache.mMapping, 4 * 1024 * 1024, getThreadPool());
+    }
+
+    for (size_t i(0); i < model.meshes.size() && useCachedMeshes; ++i) {
+      auto&       range  = state->mMeshRanges[i];
+      auto const& cached = state->mCache.mMeshRanges[i];
+
+      range.mVertexCount   = cached.mVertexCount;
+      range.mBoundingBoxes = cached.mBoundingBoxes;
+      range.mVertexOffsets = cached.mVertexOffsets;
+      range.mLods          = cached.mLods;
+
+      if (!buildMeshlets) {
+        auto read = [&](uint8_t const* data, size_t size,
+                        std::function<void()> const& onFinished = nullptr) {
+          auto offset = static_cast<size_t>(data - state->mCache.mMapping->getData());
+          state->mReader->read(offset, size, nullptr, onFinished);
+        };
+
+        read(state->mVertexData + vertexSize * range.mFirstVertex,
+            vertexSize * range.mVertexCount);
+
+        if (skinSize > 0) {
+          read(state->mSkinData + skinSize * range.mFirstVertex, skinSize * range.mVertexCount);
         }
 
-        auto texcoords = p.attributes.find("TEXCOORD_0");
-        if (texcoords != p.attributes.end()) {
-          primitve.mVertexAttributes |= Primitive::VertexAttributeBits::eTexcoords;
+        // the reads are processed in order, so the Mesh is complete after its indices
+        read(state->mIndexData + indexSize * range.mFirstIndex, indexSize * range.mIndexCount,
+            [loadingState = state.get(), i]() { loadingState->mConvertedMeshes->push(i); });
+        continue;
+      }
 
-          auto const& a = model.accessors[texcoords->second];
-          auto const& v = model.bufferViews[a.bufferView];
+      // the Meshlets are not cached, they are built from the cached vertex data
+      state->enqueue([state, i, loadSkins]() {
+        if (state->mCancelled) {
+          return;
+        }
 
-          switch (a.componentType) {
-          case TINYGLTF_COMPONENT_TYPE_FLOAT: {
-            size_t s = v.byteStride == 0 ? sizeof(glm::vec2) : v.byteStride;
-            for (size_t i(0); i < vertexCount; ++i) {
-              vertexBuffer[vertexStart + i].mTexcoords = *reinterpret_cast<glm::vec2*>(
-                  &(model.buffers[v.buffer].data[a.byteOffset + v.byteOffset + i * s]));
-            }
-            break;
-          }
-          case TINYGLTF_COMPONENT_TYPE_UNSIGNED_BYTE: {
-            size_t s = v.byteStride == 0 ? sizeof(glm::u8vec2) : v.byteStride;
-            for (size_t i(0); i < vertexCount; ++i) {
-              vertexBuffer[vertexStart + i].mTexcoords =
-                  glm::vec2(*reinterpret_cast<glm::u8vec2*>(
-                      &(model.buffers[v.buffer].data[a.byteOffset + v.byteOffset + i * s]))) /
-                  255.f;
-            }
-            break;
-          }
-          case TINYGLTF_COMPONENT_TYPE_UNSIGNED_SHORT: {
-            size_t s = v.byteStride == 0 ? sizeof(glm::u16vec2) : v.byteStride;
-            for (size_t i(0); i < vertexCount; ++i) {
-              vertexBuffer[vertexStart + i].mTexcoords =
-                  glm::vec2(*reinterpret_cast<glm::u16vec2*>(
-                      &(model.buffers[v.buffer].data[a.byteOffset + v.byteOffset + i * s]))) /
-                  65535.f;
-            }
-            break;
-          }
-          default:
-            throw std::runtime_error(
-                "Failed to load GLTF model: Unsupported component type for texcoords!");
-          }
+        try {
+          state->buildMeshlets(i, loadSkins);
+        } catch (std::exception const& e) {
+          state->setError(e.what());
+          return;
         }
 
-        auto joints  = p.attributes.find("JOINTS_0");
-        auto weights = p.attributes.find("WEIGHTS_0");
+        state->mConvertedMeshes->push(i);
+      });
+    }
 
-        if (joints != p.attributes.end() && weights != p.attributes.end() &&
-            (options & LoadOptionBits::eSkins)) {
-          primitve.mVertexAttributes |= Primitive::VertexAttributeBits::eSkins;
+    for (size_t i(0); i < model.meshes.size() && !useCachedMeshes; ++i) {
+      state->enqueue([state, i, loadSkins, optimizeMeshes, generateLods, buildMeshlets]() {
+        if (state->mCancelled) {
+          return;
+        }
 
-          {
-            auto const& a = model.accessors[joints->second];
-            auto const& v = model.bufferViews[a.bufferView];
+        auto const& model       = state->mModel;
+        auto&       range       = state->mMeshRanges[i];
+        uint32_t    vertexStart = range.mFirstVertex;
+        uint32_t    indexStart  = range.mFirstIndex;
 
-            switch (a.componentType) {
-            case TINYGLTF_COMPONENT_TYPE_UNSIGNED_BYTE: {
-              size_t s = v.byteStride == 0 ? sizeof(glm::u8vec4) : v.byteStride;
-              for (size_t i(0); i < vertexCount; ++i) {
-                vertexBuffer[vertexStart + i].mJoint0 = glm::vec4(*reinterpret_cast<glm::u8vec4*>(
-                    &(model.buffers[v.buffer].data[a.byteOffset + v.byteOffset + i * s])));
-              }
-              break;
-            }
-            case TINYGLTF_COMPONENT_TYPE_UNSIGNED_SHORT: {
-              size_t s = v.byteStride == 0 ? sizeof(glm::u16vec4) : v.byteStride;
-              for (size_t i(0); i < vertexCount; ++i) {
-                vertexBuffer[vertexStart + i].mJoint0 = glm::vec4(*reinterpret_cast<glm::u16vec4*>(
-                    &(model.buffers[v.buffer].data[a.byteOffset + v.byteOffset + i * s])));
-              }
-              break;
-            }
-            default:
-              throw std::runtime_error(
-                  "Failed to load GLTF model: Unsupported component type for joints!");
-            }
+        // writes the given indices to the index vector of the Model's index type
+        auto writeIndices = [&state](std::vector<uint32_t> const& indices, uint32_t start) {
+          if (state->mShortIndices.empty()) {
+            std::copy(indices.begin(), indices.end(), state->mIndices.begin() + start);
+          } else {
+            std::copy(indices.begin(), indices.end(), state->mShortIndices.begin() + start);
           }
+        };
 
-          {
-            auto const& a = model.accessors[weights->second];
-            auto const& v = model.bufferViews[a.bufferView];
+        try {
+          std::vector<Vertex>   vertices;
+          std::vector<uint32_t> indices;
 
-            switch (a.componentType) {
-            case TINYGLTF_COMPONENT_TYPE_FLOAT: {
-              size_t s = v.byteStride == 0 ? sizeof(glm::vec4) : v.byteStride;
-              for (size_t i(0); i < vertexCount; ++i) {
-                vertexBuffer[vertexStart + i].mWeight0 = *reinterpret_cast<glm::vec4*>(
-                    &(model.buffers[v.buffer].data[a.byteOffset + v.byteOffset + i * s]));
-              }
-              break;
+          for (auto const& p : model.meshes[i].primitives) {
+            BoundingBox bbox;
+
+            vertices.assign(getVertexCount(model, p), Vertex());
+            indices.resize(getIndexCount(model, p));
+            convertPrimitive(model, p, loadSkins, vertices.data(), indices.data(), bbox);
+
+            // The optimized Primitives of a Mesh are packed tightly, the space which is saved
+            // by welding remains unused at the end of the range of the Mesh. The MorphDeltas
+            // refer to the original vertices, so Primitives with morph targets are kept.
+            if (optimizeMeshes && p.mode == TINYGLTF_MODE_TRIANGLES && p.targets.empty()) {
+              optimizePrimitive(vertices, indices);
             }
-            case TINYGLTF_COMPONENT_TYPE_UNSIGNED_BYTE: {
-              size_t s = v.byteStride == 0 ? sizeof(glm::u8vec4) : v.byteStride;
-              for (size_t i(0); i < vertexCount; ++i) {
-                vertexBuffer[vertexStart + i].mWeight0 =
-                    glm::vec4(*reinterpret_cast<glm::u8vec4*>(
-                        &(model.buffers[v.buffer].data[a.byteOffset + v.byteOffset + i * s]))) /
-                    255.f;
+
+            if (state->mVertexLayout == VertexLayout::eDefault) {
+              std::copy(vertices.begin(), vertices.end(), state->mVertices.begin() + vertexStart);
+            } else {
+              for (size_t v(0); v < vertices.size(); ++v) {
+                state->mCompactVertices[vertexStart + v] = compressVertex(vertices[v]);
               }
-              break;
-            }
-            case TINYGLTF_COMPONENT_TYPE_UNSIGNED_SHORT: {
-              size_t s = v.byteStride == 0 ? sizeof(glm::u16vec4) : v.byteStride;
-              for (size_t i(0); i < vertexCount; ++i) {
-                vertexBuffer[vertexStart + i].mWeight0 =
-                    glm::vec4(*reinterpret_cast<glm::u16vec4*>(
-                        &(model.buffers[v.buffer].data[a.byteOffset + v.byteOffset + i * s]))) /
-                    65535.f;
+
+              if (state->mVertexLayout == VertexLayout::eCompact) {
+                for (size_t v(0); v < vertices.size(); ++v) {
+                  state->mSkinVertices[vertexStart + v] = compressSkin(vertices[v]);
+                }
               }
-              break;
             }
-            default:
-              throw std::runtime_error(
-                  "Failed to load GLTF model: Unsupported component type for weights!");
+
+            writeIndices(indices, indexStart);
+
+            range.mBoundingBoxes.push_back(bbox);
+            range.mVertexOffsets.push_back(static_cast<int32_t>(vertexStart));
+            range.mLods.emplace_back();
+            vertexStart += static_cast<uint32_t>(vertices.size());
+            indexStart += static_cast<uint32_t>(indices.size());
+
+            if (!generateLods) {
+              continue;
             }
 
-            // normalize weights - is this the correct way of handling cases where the sum of the
-            // weights is not equal to one?
-            for (size_t i(0); i < vertexCount; ++i) {
-              float sum = vertexBuffer[vertexStart + i].mWeight0.x +
-                          vertexBuffer[vertexStart + i].mWeight0.y +
-                          vertexBuffer[vertexStart + i].mWeight0.z +
-                          vertexBuffer[vertexStart + i].mWeight0.w;
-              if (sum > 0) {
-                vertexBuffer[vertexStart + i].mWeight0 /= sum;
-              }
+            // All Lods are simplified from the full Primitive. Lods which do not fit into their
+            // reserved range are skipped, as well as all coarser ones.
+            std::vector<glm::vec3> positions(vertices.size());
+            for (size_t v(0); v < vertices.size(); ++v) {
+              positions[v] = vertices[v].mPosition;
             }
-          }
-        }
 
-        if (p.indices < 0) {
+            bool  fits     = true;
+            float maxError = 0.f;
 
-          // add artificial indices if there are none
-          primitve.mIndexOffset = static_cast<uint32_t>(indexBuffer.size());
-          primitve.mIndexCount  = vertexCount;
+            for (size_t lodIndexCount : getLodIndexCounts(model, p)) {
+              float                 error = 0.f;
+              std::vector<uint32_t> lodIndices;
 
-          for (size_t i(0); i < vertexCount; ++i) {
-            indexBuffer.push_back(i + vertexStart);
-          }
+              if (fits) {
+                lodIndices = MeshOptimizer::simplify(indices, positions, lodIndexCount, error);
+                fits       = !lodIndices.empty() && lodIndices.size() <= lodIndexCount;
+              }
 
-        } else {
+              if (fits) {
+                MeshOptimizer::optimizeVertexCache(lodIndices, vertices.size());
+                writeIndices(lodIndices, indexStart);
 
-          auto const& a = model.accessors[p.indices];
-          auto const& v = model.bufferViews[a.bufferView];
+                maxError = std::max(maxError, error);
 
-          primitve.mIndexOffset = static_cast<uint32_t>(indexBuffer.size());
-          primitve.mIndexCount  = static_cast<uint32_t>(a.count);
+                Primitive::Lod lod;
+                lod.mIndexOffset = indexStart;
+                lod.mIndexCount  = lodIndices.size();
+                lod.mError       = maxError;
+                range.mLods.back().push_back(lod);
+              }
 
-          switch (a.componentType) {
-          case TINYGLTF_PARAMETER_TYPE_UNSIGNED_INT: {
-            auto data = reinterpret_cast<const uint32_t*>(
-                &model.buffers[v.buffer].data[a.byteOffset + v.byteOffset]);
-            for (uint32_t i = 0; i < primitve.mIndexCount; ++i) {
-              indexBuffer.push_back(data[i] + vertexStart);
+              indexStart += static_cast<uint32_t>(lodIndexCount);
             }
-            break;
           }
-          case TINYGLTF_PARAMETER_TYPE_UNSIGNED_SHORT: {
-            auto data = reinterpret_cast<const uint16_t*>(
-                &model.buffers[v.buffer].data[a.byteOffset + v.byteOffset]);
-            for (uint32_t i = 0; i < primitve.mIndexCount; ++i) {
-              indexBuffer.push_back(data[i] + vertexStart);
-            }
-            break;
-          }
-          case TINYGLTF_PARAMETER_TYPE_UNSIGNED_BYTE: {
-            auto data = reinterpret_cast<const uint8_t*>(
-                &model.buffers[v.buffer].data[a.byteOffset + v.byteOffset]);
-            for (uint32_t i = 0; i < primitve.mIndexCount; ++i) {
-              indexBuffer.push_back(data[i] + vertexStart);
-            }
-            break;
-          }
-          default:
-            throw std::runtime_error("Failed to load GLTF model: Unsupported index type!");
+
+          range.mVertexCount = vertexStart - range.mFirstVertex;
+
+          if (buildMeshlets) {
+            state->buildMeshlets(i, loadSkins);
           }
+
+        } catch (std::exception const& e) {
+          state->setError(e.what());
+          return;
         }
 
-        mesh->mBoundingBox.add(primitve.mBoundingBox);
-        mesh->mPrimitives.emplace_back(primitve);
-      }
-      mMeshes.emplace_back(mesh);
+        state->mConvertedMeshes->push(i);
+      });
     }
-
-    mVertexBuffer = mDevice->createVertexBuffer(vertexBuffer);
-    mIndexBuffer  = mDevice->createIndexBuffer(indexBuffer);
   }
 
   // pre-create nodes (they are referenced by themselves as children and by the skins) -------------
-  for (auto const& n : model.nodes) {
-    mNodes.emplace_back(std::make_shared<Node>());
+  mArena->mNodes.resize(model.nodes.size());
+
+  for (auto& node : mArena->mNodes) {
+    mNodes.emplace_back(mArena, &node);
   }
 
   // create skins ----------------------------------------------------------------------------------
   if (options & LoadOptionBits::eSkins) {
+    mArena->mSkins.resize(model.skins.size());
+
     for (auto const& s : model.skins) {
-      auto skin   = std::make_shared<Skin>();
+      auto skin   = SkinPtr(mArena, &mArena->mSkins[mSkins.size()]);
       skin->mName = s.name;
 
       for (int j : s.joints) {
@@ -670,6 +3026,14 @@ Model::Model(DevicePtr const& device, std::string const& file, LoadOptions optio
 
     if (model.nodes[i].mesh >= 0) {
       mNodes[i]->mMesh = mMeshes[model.nodes[i].mesh];
+
+      // the weights of the Node override the default weights of the Mesh
+      mNodes[i]->mWeights = mNodes[i]->mMesh->mWeights;
+      for (size_t w(0); w < model.nodes[i].weights.size() && w < mNodes[i]->mWeights.size(); ++w) {
+        mNodes[i]->mWeights[w] = static_cast<float>(model.nodes[i].weights[w]);
+      }
+
+      mNodes[i]->mMorphVertexOffsets = morphVertexOffsets[i];
     }
 
     if (model.nodes[i].skin >= 0 && (options & LoadOptionBits::eSkins)) {
@@ -687,8 +3051,10 @@ Model::Model(DevicePtr const& device, std::string const& file, LoadOptions optio
 
   // create animations -----------------------------------------------------------------------------
   if (options & LoadOptionBits::eAnimations) {
+    mArena->mAnimations.resize(model.animations.size());
+
     for (auto const& a : model.animations) {
-      auto animation   = std::make_shared<Animation>();
+      auto animation   = AnimationPtr(mArena, &mArena->mAnimations[mAnimations.size()]);
       animation->mName = a.name;
 
       // Samplers
@@ -771,6 +3137,8 @@ Model::Model(DevicePtr const& device, std::string const& file, LoadOptions optio
           channel.mType = Animation::Channel::Type::eTranslation;
         } else if (source.target_path == "scale") {
           channel.mType = Animation::Channel::Type::eScale;
+        } else if (source.target_path == "weights") {
+          channel.mType = Animation::Channel::Type::eWeights;
         } else {
           ILLUSION_WARNING << "Ignoring animation path type \"" << source.target_path
                            << "\" for GLTF model \"" << file << "\"." << std::endl;
@@ -784,123 +3152,536 @@ Model::Model(DevicePtr const& device, std::string const& file, LoadOptions optio
           continue;
         }
 
-        animation->mChannels.emplace_back(channel);
-      }
+        // invalid Samplers are sorted out here, so they need not be checked for each frame
+        auto const& sampler = animation->mSamplers[channel.mSamplerIndex];
+
+        // a Channel of Type::eWeights has one value for each weight of the Node per key frame
+        size_t valuesPerKeyFrame = channel.mType == Animation::Channel::Type::eWeights
+                                       ? channel.mNode->mWeights.size()
+                                       : 1;
+
+        if (valuesPerKeyFrame == 0) {
+          ILLUSION_WARNING << "Ignoring animation channel of GLTF model \"" << file
+                           << "\": The target node has no morph targets!" << std::endl;
+          continue;
+        }
+
+        if ((sampler.mType == Animation::Sampler::Type::eCubicSpline &&
+                sampler.mKeyFrames.size() * 3 * valuesPerKeyFrame != sampler.mValues.size()) ||
+            (sampler.mType != Animation::Sampler::Type::eCubicSpline &&
+                sampler.mKeyFrames.size() * valuesPerKeyFrame != sampler.mValues.size())) {
+          ILLUSION_WARNING << "Ignoring animation channel of GLTF model \"" << file
+                           << "\": Number of data points does not match the number of keyframes!"
+                           << std::endl;
+          continue;
+        }
+
+        if (sampler.mKeyFrames.size() == 0) {
+          ILLUSION_WARNING << "Ignoring animation channel of GLTF model \"" << file
+                           << "\": There must be at least one key frame!" << std::endl;
+          continue;
+        }
+
+        animation->mChannels.emplace_back(channel);
+      }
+
+      mAnimations.emplace_back(animation);
+    }
+  }
+
+  // create instance groups ------------------------------------------------------------------------
+  // Nodes without a Skin and without morph targets which share a Mesh are grouped, the groups are
+  // sorted by their first Node in depth-first order.
+  std::unordered_map<Mesh const*, size_t> groupIndices;
+
+  std::function<void(NodePtr const&)> addToInstanceGroups = [&](NodePtr const& node) {
+    if (node->mMesh) {
+      auto group  = groupIndices.find(node->mMesh.get());
+      bool single = node->mSkin || !node->mMorphVertexOffsets.empty();
+
+      if (single || group == groupIndices.end()) {
+        if (!single) {
+          groupIndices[node->mMesh.get()] = mInstanceGroups.size();
+        }
+        mInstanceGroups.push_back({node->mMesh, {node}});
+      } else {
+        mInstanceGroups[group->second].mNodes.push_back(node);
+      }
+    }
+
+    for (auto const& c : node->mChildren) {
+      addToInstanceGroups(c);
+    }
+  };
+
+  addToInstanceGroups(mRootNode);
+
+  // flatten the hierarchy -------------------------------------------------------------------------
+  // The Nodes are stored in depth-first order, hence each parent comes before its children and all
+  // global transformations can be computed in one linear pass.
+  std::function<void(NodePtr const&, int32_t)> addToHierarchy = [&](NodePtr const& node,
+                                                                    int32_t        parent) {
+    int32_t index         = static_cast<int32_t>(mHierarchy.size());
+    node->mHierarchyIndex = index;
+    mHierarchy.push_back(node.get());
+    mParentIndices.push_back(parent);
+
+    for (auto const& c : node->mChildren) {
+      addToHierarchy(c, index);
+    }
+  };
+
+  for (auto const& c : mRootNode->mChildren) {
+    addToHierarchy(c, -1);
+  }
+
+  mLocalTransforms.resize(mHierarchy.size());
+  mGlobalTransforms.resize(mHierarchy.size());
+  mDirtyTransforms.resize(mHierarchy.size());
+
+  // update all global transformations -------------------------------------------------------------
+  updateTransforms();
+
+  // wait for the background tasks -----------------------------------------------------------------
+  // sOnLoaded is not emitted here, nobody could be connected to it yet.
+  if (!(options & LoadOptionBits::eAsync)) {
+    state->waitForTasks();
+    uploadLoadedData(std::numeric_limits<vk::DeviceSize>::max());
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+Model::~Model() {
+  if (mLoadingState) {
+    mLoadingState->mCancelled = true;
+  }
+
+  for (uint32_t handle : mStreamingHandles) {
+    if (handle != INVALID_STREAMING_HANDLE) {
+      mTextureStreamer->remove(handle);
+    }
+  }
+
+  if (mGeometry) {
+    mGeometryArena->free(mGeometry);
+  }
+
+  // The objects of the Arena refer to each other with aliasing std::shared_ptrs, which keep the
+  // whole Arena alive. These references form a cycle, hence they are cleared here.
+  for (auto& mesh : mArena->mMeshes) {
+    for (auto& primitive : mesh.mPrimitives) {
+      primitive.mMaterial.reset();
+    }
+  }
+
+  for (auto& node : mArena->mNodes) {
+    node.mMesh.reset();
+    node.mSkin.reset();
+    node.mChildren.clear();
+  }
+
+  for (auto& skin : mArena->mSkins) {
+    skin.mJoints.clear();
+  }
+
+  for (auto& animation : mArena->mAnimations) {
+    for (auto& channel : animation.mChannels) {
+      channel.mNode.reset();
+    }
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+bool Model::update(vk::DeviceSize maxTextureBytes) {
+  if (!mLoadingState) {
+    return true;
+  }
+
+  if (!uploadLoadedData(maxTextureBytes)) {
+    return false;
+  }
+
+  sOnLoaded.emit();
+
+  return true;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+bool Model::uploadLoadedData(vk::DeviceSize maxTextureBytes) {
+  auto& state = *mLoadingState;
+
+  {
+    std::unique_lock<std::mutex> lock(state.mErrorMutex);
+    if (!state.mError.empty()) {
+      throw std::runtime_error("Error loading GLTF file " + state.mFile + ": " + state.mError);
+    }
+  }
+
+  auto const& uploadManager = mDevice->getUploadManager();
+
+  // With eGeometryArena, the uploads are recorded by the arena, as the loading of another Model
+  // may replace its buffers in the meantime. The SkinVertex stream is the second vertex stream.
+  auto uploadVertices = [&](uint32_t stream, vk::DeviceSize dataSize, const void* data,
+                            vk::DeviceSize dstOffset) {
+    if (mGeometry) {
+      mGeometryArena->uploadVertices(stream, dataSize, data, dstOffset);
+    } else {
+      auto const& buffer    = stream == 0 ? mVertexBuffer : mSkinBuffer;
+      buffer->mUploadTicket = uploadManager->uploadToBuffer(buffer, dataSize, data, dstOffset);
+    }
+  };
+
+  auto uploadIndices = [&](vk::DeviceSize dataSize, const void* data, vk::DeviceSize dstOffset) {
+    if (mGeometry) {
+      mGeometryArena->uploadIndices(dataSize, data, dstOffset);
+    } else {
+      mIndexBuffer->mUploadTicket =
+          uploadManager->uploadToBuffer(mIndexBuffer, dataSize, data, dstOffset);
+    }
+  };
+
+  // with eGeometryArena, the ranges of this Model do not start at the beginning of the buffers
+  vk::DeviceSize firstVertex = getFirstVertex();
+  vk::DeviceSize firstIndex  = getFirstIndex();
+
+  // upload the vertex data of all Meshes which have been converted since the last call
+  size_t meshIndex;
+  while (state.mConvertedMeshes->pop(meshIndex)) {
+    auto const& range = state.mMeshRanges[meshIndex];
+    auto const& mesh  = mMeshes[meshIndex];
+
+    // the data pointers refer either to the vectors of the LoadingState or to the cache file
+    size_t vertexSize =
+        mVertexLayout == VertexLayout::eDefault ? sizeof(Vertex) : sizeof(CompactVertex);
+    size_t indexSize = mIndexType == vk::IndexType::eUint16 ? sizeof(uint16_t) : sizeof(uint32_t);
+
+    if (range.mVertexCount > 0) {
+      uploadVertices(0, vertexSize * range.mVertexCount,
+          state.mVertexData + vertexSize * range.mFirstVertex,
+          vertexSize * (firstVertex + range.mFirstVertex));
+
+      if (mVertexLayout == VertexLayout::eCompact) {
+        uploadVertices(1, sizeof(SkinVertex) * range.mVertexCount,
+            state.mSkinData + sizeof(SkinVertex) * range.mFirstVertex,
+            sizeof(SkinVertex) * (firstVertex + range.mFirstVertex));
+      }
+    }
+
+    if (range.mIndexCount > 0) {
+      uploadIndices(indexSize * range.mIndexCount, state.mIndexData + indexSize * range.mFirstIndex,
+          indexSize * (firstIndex + range.mFirstIndex));
+    }
+
+    // the whole reserved ranges of the Meshlets are uploaded, unused parts are never referenced
+    if (mMeshletBuffer && range.mMeshletCount > 0) {
+      mMeshletBuffer->mUploadTicket = uploadManager->uploadToBuffer(mMeshletBuffer,
+          sizeof(MeshOptimizer::Meshlet) * range.mMeshletCount,
+          state.mMeshlets.data() + range.mFirstMeshlet,
+          sizeof(MeshOptimizer::Meshlet) * range.mFirstMeshlet);
+      mMeshletVertexBuffer->mUploadTicket = uploadManager->uploadToBuffer(mMeshletVertexBuffer,
+          sizeof(uint32_t) * range.mMeshletVertexCount,
+          state.mMeshletVertices.data() + range.mFirstMeshletVertex,
+          sizeof(uint32_t) * range.mFirstMeshletVertex);
+      mMeshletTriangleBuffer->mUploadTicket = uploadManager->uploadToBuffer(mMeshletTriangleBuffer,
+          sizeof(uint32_t) * range.mMeshletTriangleCount,
+          state.mMeshletTriangles.data() + range.mFirstMeshletTriangle,
+          sizeof(uint32_t) * range.mFirstMeshletTriangle);
+    }
+
+    // the morphed copies of the Nodes start with the original vertices of their Primitive
+    for (auto const& node : mNodes) {
+      if (node->mMesh != mesh || node->mMorphVertexOffsets.empty()) {
+        continue;
+      }
+
+      for (size_t i(0); i < mesh->mPrimitives.size(); ++i) {
+        int32_t  offset = node->mMorphVertexOffsets[i];
+        uint32_t count  = mesh->mPrimitives[i].mMorphTargets.mVertexCount;
+
+        if (offset < 0) {
+          continue;
+        }
+
+        uploadVertices(0, vertexSize * count,
+            state.mVertexData + vertexSize * range.mVertexOffsets[i],
+            vertexSize * (firstVertex + offset));
+
+        if (mVertexLayout == VertexLayout::eCompact) {
+          uploadVertices(1, sizeof(SkinVertex) * count,
+              state.mSkinData + sizeof(SkinVertex) * range.mVertexOffsets[i],
+              sizeof(SkinVertex) * (firstVertex + offset));
+        }
+      }
+
+      node->mWeightsDirty = true;
+    }
+
+    for (size_t i(0); i < mesh->mPrimitives.size(); ++i) {
+      mesh->mPrimitives[i].mVertexOffset = range.mVertexOffsets[i];
+      mesh->mPrimitives[i].mLods         = range.mLods[i];
+
+      if (!range.mMeshlets.empty()) {
+        mesh->mPrimitives[i].mFirstMeshlet = range.mMeshlets[i].first;
+        mesh->mPrimitives[i].mMeshletCount = range.mMeshlets[i].second;
+      }
+
+      // use the computed bounding boxes if the file did not contain any
+      if (mesh->mPrimitives[i].mBoundingBox.isEmpty()) {
+        mesh->mPrimitives[i].mBoundingBox = range.mBoundingBoxes[i];
+        mesh->mBoundingBox.add(range.mBoundingBoxes[i]);
+      }
+    }
+
+    mesh->mLoaded = true;
+
+    // the Meshlets are not part of the cache file
+    if (state.mPendingMeshes == 1) {
+      state.mMeshlets         = std::vector<MeshOptimizer::Meshlet>();
+      state.mMeshletVertices  = std::vector<uint32_t>();
+      state.mMeshletTriangles = std::vector<uint32_t>();
+    }
+
+    // the vertex data is kept until the cache file has been written
+    if (--state.mPendingMeshes == 0 && !state.mCache.mWrite) {
+      state.mVertices        = std::vector<Vertex>();
+      state.mCompactVertices = std::vector<CompactVertex>();
+      state.mSkinVertices    = std::vector<SkinVertex>();
+      state.mIndices         = std::vector<uint32_t>();
+      state.mShortIndices    = std::vector<uint16_t>();
+    }
+  }
+
+  // create the Textures which have been decoded since the last call
+  vk::DeviceSize                                uploadedBytes = 0;
+  std::shared_ptr<LoadingState::DecodedTexture> decoded;
+
+  while (uploadedBytes < maxTextureBytes && state.mDecodedTextures->pop(decoded)) {
+    size_t index = decoded->mIndex;
+
+    if (mTextureStreamer) {
+      // The TextureStreamer initially uploads the mip tail only; the callback is called again
+      // whenever it replaces the Texture. It keeps the decoded pixels alive.
+      TextureStreamer::Source source;
+      source.mImageInfo   = decoded->mImageInfo;
+      source.mSamplerInfo = decoded->mSamplerInfo;
+      source.mData        = decoded->mPixels;
+      source.mSize        = decoded->mSize;
+      source.mOwner       = decoded;
+
+      mStreamingHandles[index] = mTextureStreamer->add(source,
+          [this, index, users = state.mTextureUsers[index]](TexturePtr const& texture) {
+            mStreamedTextureIndices.erase(mTextures[index].get());
+            mStreamedTextureIndices[texture.get()] = index;
+            mTextures[index]                       = texture;
+
+            for (auto member : users) {
+              *member = texture;
+            }
+          });
+    } else {
+      auto texture = mDevice->createTexture(decoded->mImageInfo, decoded->mSamplerInfo,
+          vk::ImageViewType::e2D, vk::ImageAspectFlagBits::eColor,
+          vk::ImageLayout::eShaderReadOnlyOptimal, vk::ComponentMapping(), decoded->mSize,
+          decoded->mPixels);
+
+      mTextures[index] = texture;
+
+      for (auto member : state.mTextureUsers[index]) {
+        *member = texture;
+      }
+    }
+
+    if (state.mCache.mWrite) {
+      state.mCache.mTextures.push_back(decoded);
+    }
+
+    uploadedBytes += decoded->mSize;
+    --state.mPendingTextures;
+  }
+
+  if (state.mPendingMeshes > 0 || state.mPendingTextures > 0) {
+    return false;
+  }
+
+  // The cache file is written by a worker thread which keeps the LoadingState alive until it is
+  // done. The textures have been decoded in arbitrary order, but they are stored by index.
+  if (state.mCache.mWrite) {
+    std::sort(state.mCache.mTextures.begin(), state.mCache.mTextures.end(),
+        [](auto const& a, auto const& b) { return a->mIndex < b->mIndex; });
+    getThreadPool().enqueue([state = mLoadingState]() { state->writeCache(); });
+  }
+
+  // loading has been finished, the parsed file is not required anymore
+  mLoadingState.reset();
+
+  return true;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+bool Model::isLoaded() const {
+  return !mLoadingState;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+bool Model::isGeometryLoaded() const {
+  return !mLoadingState || mLoadingState->mPendingMeshes == 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void Model::setAnimationTime(uint32_t animationIndex, float time) {
+  setAnimationTimes({{this, animationIndex, time}});
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
 
-      mAnimations.emplace_back(animation);
+void Model::setAnimationTimes(std::vector<AnimationTime> const& times) {
+  std::vector<std::pair<Animation*, float>> animations;
+  animations.reserve(times.size());
+
+  for (auto const& entry : times) {
+    if (entry.mAnimationIndex >= entry.mModel->mAnimations.size()) {
+      throw std::runtime_error("Failed to update GLTF animation: No animation number \"" +
+                               std::to_string(entry.mAnimationIndex) + "\" available!");
     }
+
+    animations.emplace_back(entry.mModel->mAnimations[entry.mAnimationIndex].get(), entry.mTime);
   }
 
-  // update all global transformations -------------------------------------------------------------
-  mRootNode->update(glm::mat4(1.f));
+  sampleAnimations(animations);
+
+  for (auto const& entry : times) {
+    entry.mModel->updateTransforms();
+  }
 }
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////
 
-void Model::setAnimationTime(uint32_t animationIndex, float time) {
-  if (animationIndex >= mAnimations.size()) {
-    throw std::runtime_error("Failed to update GLTF animation: No animation number \"" +
-                             std::to_string(animationIndex) + "\" available!");
-  }
-
-  for (auto& channel : mAnimations[animationIndex]->mChannels) {
-    auto const& sampler = mAnimations[animationIndex]->mSamplers[channel.mSamplerIndex];
+void Model::updateTransforms() {
+  for (size_t i = 0; i < mHierarchy.size(); ++i) {
+    Node*   node   = mHierarchy[i];
+    int32_t parent = mParentIndices[i];
 
-    if ((sampler.mType == Animation::Sampler::Type::eCubicSpline &&
-            sampler.mKeyFrames.size() * 3 != sampler.mValues.size()) ||
-        (sampler.mType != Animation::Sampler::Type::eCubicSpline &&
-            sampler.mKeyFrames.size() != sampler.mValues.size())) {
-      ILLUSION_WARNING << "Failed to update GLTF animation: Number of data points does not match "
-                          "the number of keyframes. This should not happen!"
-                       << std::endl;
-      continue;
+    if (node->mDirty) {
+      mLocalTransforms[i] = node->getLocalTransform();
     }
 
-    if (sampler.mKeyFrames.size() == 0) {
-      ILLUSION_WARNING << "Failed to update GLTF animation: There must be at least one key frame!"
-                       << std::endl;
-      continue;
+    // the global transformation changes if the local one or the one of the parent has changed
+    mDirtyTransforms[i] = node->mDirty || (parent >= 0 && mDirtyTransforms[parent]);
+    node->mDirty        = false;
+
+    if (mDirtyTransforms[i]) {
+      mGlobalTransforms[i] =
+          parent >= 0 ? mGlobalTransforms[parent] * mLocalTransforms[i] : mLocalTransforms[i];
+      node->mGlobalTransform = mGlobalTransforms[i];
     }
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
 
-    size_t s = 0;
-    size_t e = 0;
-    float  t = 0.f;
+BoundingBox Model::getBoundingBox() const {
+  BoundingBox bbox;
 
-    if (sampler.mKeyFrames.size() == 1 || time >= sampler.mKeyFrames.back()) {
-      s = e = sampler.mKeyFrames.size() - 1;
-    } else if (time >= sampler.mKeyFrames.front()) {
-      while (time >= sampler.mKeyFrames[e]) {
-        ++e;
-      }
-      s = e - 1;
-      t = glm::clamp(
-          (time - sampler.mKeyFrames[s]) / (sampler.mKeyFrames[e] - sampler.mKeyFrames[s]), 0.f,
-          1.f);
+  for (size_t i = 0; i < mHierarchy.size(); ++i) {
+    if (mHierarchy[i]->mMesh) {
+      bbox.add(mHierarchy[i]->mMesh->mBoundingBox.getTransformed(mGlobalTransforms[i]));
     }
+  }
 
-    if (sampler.mType == Animation::Sampler::Type::eStep) {
+  return bbox;
+}
 
-      if (channel.mType == Animation::Channel::Type::eTranslation) {
-        channel.mNode->mTranslation = sampler.mValues[s];
-      } else if (channel.mType == Animation::Channel::Type::eScale) {
-        channel.mNode->mScale = sampler.mValues[s];
-      } else if (channel.mType == Animation::Channel::Type::eRotation) {
-        channel.mNode->mRotation = glm::normalize(glm::make_quat(&sampler.mValues[s][0]));
-      }
+////////////////////////////////////////////////////////////////////////////////////////////////////
 
-    } else if (sampler.mType == Animation::Sampler::Type::eLinear) {
+NodePtr const& Model::getRoot() const {
+  return mRootNode;
+}
 
-      if (channel.mType == Animation::Channel::Type::eTranslation) {
-        channel.mNode->mTranslation = glm::mix(sampler.mValues[s], sampler.mValues[e], t);
-      } else if (channel.mType == Animation::Channel::Type::eScale) {
-        channel.mNode->mScale = glm::mix(sampler.mValues[s], sampler.mValues[e], t);
-      } else if (channel.mType == Animation::Channel::Type::eRotation) {
-        glm::quat q1             = glm::make_quat(&sampler.mValues[s][0]);
-        glm::quat q2             = glm::make_quat(&sampler.mValues[e][0]);
-        channel.mNode->mRotation = glm::normalize(glm::slerp(q1, q2, t));
-      }
+////////////////////////////////////////////////////////////////////////////////////////////////////
 
-    } else if (sampler.mType == Animation::Sampler::Type::eCubicSpline) {
+BackedBufferPtr Model::getIndexBuffer() const {
+  return mGeometry ? mGeometryArena->getIndexBuffer() : mIndexBuffer;
+}
 
-      float     d  = sampler.mKeyFrames[e] - sampler.mKeyFrames[s];
-      glm::vec4 m0 = sampler.mValues[s * 3 + 0] * d;
-      glm::vec4 p0 = sampler.mValues[s * 3 + 1];
-      glm::vec4 m1 = sampler.mValues[s * 3 + 2] * d;
-      glm::vec4 p1 = sampler.mValues[e * 3 + 1];
+////////////////////////////////////////////////////////////////////////////////////////////////////
 
-      glm::vec4 spline = (2.f * t * t * t - 3.f * t * t + 1.f) * p0 +
-                         (t * t * t - 2.f * t * t + t) * m0 +
-                         (-2.f * t * t * t + 3.f * t * t) * p1 + (t * t * t - t * t) * m1;
+vk::IndexType Model::getIndexType() const {
+  return mIndexType;
+}
 
-      if (channel.mType == Animation::Channel::Type::eTranslation) {
-        channel.mNode->mTranslation = spline;
-      } else if (channel.mType == Animation::Channel::Type::eScale) {
-        channel.mNode->mScale = spline;
-      } else if (channel.mType == Animation::Channel::Type::eRotation) {
-        channel.mNode->mRotation = glm::normalize(glm::make_quat(&spline[0]));
-      }
-    }
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+BackedBufferPtr Model::getVertexBuffer() const {
+  return mGeometry ? mGeometryArena->getVertexBuffer() : mVertexBuffer;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+BackedBufferPtr Model::getSkinBuffer() const {
+  if (mGeometry && mVertexLayout == VertexLayout::eCompact) {
+    return mGeometryArena->getVertexBuffer(1);
   }
+  return mSkinBuffer;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
 
-  mRootNode->update(glm::mat4(1.f));
+VertexLayout Model::getVertexLayout() const {
+  return mVertexLayout;
 }
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////
 
-NodePtr const& Model::getRoot() const {
-  return mRootNode;
+GeometryArenaPtr const& Model::getGeometryArena() const {
+  return mGeometryArena;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+uint32_t Model::getFirstVertex() const {
+  return mGeometry ? mGeometry->mFirstVertex : 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+uint32_t Model::getFirstIndex() const {
+  return mGeometry ? mGeometry->mFirstIndex : 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+BackedBufferPtr const& Model::getMorphTargetBuffer() const {
+  return mMorphTargetBuffer;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+BackedBufferPtr const& Model::getMeshletBuffer() const {
+  return mMeshletBuffer;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+BackedBufferPtr const& Model::getMeshletVertexBuffer() const {
+  return mMeshletVertexBuffer;
 }
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////
 
-BackedBufferPtr const& Model::getIndexBuffer() const {
-  return mIndexBuffer;
+BackedBufferPtr const& Model::getMeshletTriangleBuffer() const {
+  return mMeshletTriangleBuffer;
 }
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////
 
-BackedBufferPtr const& Model::getVertexBuffer() const {
-  return mVertexBuffer;
+BackedBufferPtr const& Model::getMaterialBuffer() const {
+  return mMaterialBuffer;
 }
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -935,13 +3716,347 @@ std::vector<AnimationPtr> const& Model::getAnimations() const {
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////
 
+uint32_t Model::getIndex(Material const& material) const {
+  return getStorageIndex(mArena->mMaterials, material);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+uint32_t Model::getIndex(Mesh const& mesh) const {
+  return getStorageIndex(mArena->mMeshes, mesh);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+uint32_t Model::getIndex(Node const& node) const {
+  return getStorageIndex(mArena->mNodes, node);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+std::vector<InstanceGroup> const& Model::getInstanceGroups() const {
+  return mInstanceGroups;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void Model::requestTextureResolutions(
+    glm::vec3 const& eyePosition, float projectionScale, glm::mat4 const& modelMatrix) const {
+
+  if (!mTextureStreamer) {
+    return;
+  }
+
+  for (auto const& group : mInstanceGroups) {
+    auto transforms = group.getTransforms(modelMatrix);
+
+    for (auto const& p : group.mMesh->mPrimitives) {
+      auto const& box = p.mBoundingBox.isEmpty() ? group.mMesh->mBoundingBox : p.mBoundingBox;
+
+      if (!p.mMaterial || box.isEmpty()) {
+        continue;
+      }
+
+      // the projected diameter of the bounding sphere of the closest instance
+      float resolution = 0.f;
+
+      for (auto const& transform : transforms) {
+        auto      bbox     = box.getTransformed(transform);
+        glm::vec3 center   = (bbox.mMin + bbox.mMax) * 0.5f;
+        float     radius   = glm::length(bbox.mMax - bbox.mMin) * 0.5f;
+        float     distance = glm::length(center - eyePosition) - radius;
+
+        if (distance <= 0.f) {
+          resolution = std::numeric_limits<float>::max();
+          break;
+        }
+
+        resolution = std::max(resolution, 2.f * radius * projectionScale / distance);
+      }
+
+      for (auto const* texture : {&p.mMaterial->mAlbedoTexture, &p.mMaterial->mEmissiveTexture,
+               &p.mMaterial->mMetallicRoughnessTexture, &p.mMaterial->mOcclusionTexture,
+               &p.mMaterial->mNormalTexture}) {
+        auto index = mStreamedTextureIndices.find(texture->get());
+        if (index != mStreamedTextureIndices.end()) {
+          mTextureStreamer->request(mStreamingHandles[index->second], resolution);
+        }
+      }
+    }
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+DrawList Model::createDrawList(TransientAllocator& allocator, glm::mat4 const& modelMatrix,
+    std::optional<LodSelection> const& lodSelection) const {
+  return createDrawList(allocator, modelMatrix, lodSelection, nullptr);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+DrawList Model::createDrawList(TransientAllocator& allocator, glm::mat4 const& modelMatrix,
+    std::optional<LodSelection> const& lodSelection, ModelInstance const* instance) const {
+
+  struct Draw {
+    Primitive const* mPrimitive;
+    int32_t          mVertexOffset;
+    int32_t          mVertexAttributes;
+    uint32_t         mIndexOffset;
+    uint32_t         mIndexCount;
+    uint32_t         mFirstInstance;
+    uint32_t         mInstanceCount;
+    uint32_t         mFirstMeshlet;
+    uint32_t         mMeshletCount;
+    BoundingBox      mBoundingBox;
+  };
+
+  DrawList                        result;
+  std::vector<DrawList::Instance> instances;
+  std::vector<BoundingBox>        instanceBoxes;
+
+  result.mDirectDraws = !mDevice->getEnabledFeatures().drawIndirectFirstInstance;
+
+  // the offsets of the draw commands are only valid until the arena is compacted
+  if (mGeometry) {
+    result.mGeometryArena      = mGeometryArena;
+    result.mGeometryGeneration = mGeometryArena->getGeneration();
+  }
+
+  // the joint matrices are written directly to the TransientAllocator, only the live joints of the
+  // Skins of loaded Meshes are stored; the joint matrices of a ModelInstance have been written by
+  // ModelInstance::update() already, for all Skins
+  if (instance) {
+    result.mJointMatrices = instance->mJointMatrices;
+  } else {
+    uint32_t jointCount = 0;
+    for (auto const& group : mInstanceGroups) {
+      if (group.mMesh->mLoaded && group.mNodes.front()->mSkin) {
+        jointCount += static_cast<uint32_t>(group.mNodes.front()->mSkin->mJoints.size());
+      }
+    }
+
+    // it contains at least one element, so it can always be bound as storage buffer
+    result.mJointMatrices = allocator.allocate(sizeof(glm::mat4) * std::max(jointCount, 1u));
+  }
+
+  auto     jointMatrices = reinterpret_cast<glm::mat4*>(result.mJointMatrices.mData);
+  uint32_t jointEnd      = instance ? instance->mJointOffset : 0;
+
+  // collect one instanced Draw for each Primitive (and each Lod in use) of each InstanceGroup; the
+  // Instances of a Draw are stored consecutively
+  std::vector<Draw> draws;
+
+  for (auto const& group : mInstanceGroups) {
+    // only groups with one Node may have a Skin
+    auto const& skin        = group.mNodes.front()->mSkin;
+    int32_t     jointOffset = 0;
+
+    // the joint matrices of a ModelInstance are stored for the Skins of all groups
+    if (!group.mMesh->mLoaded) {
+      if (skin && instance) {
+        jointEnd += static_cast<uint32_t>(skin->mJoints.size());
+      }
+      continue;
+    }
+
+    std::vector<glm::mat4> transforms;
+
+    if (instance) {
+      transforms.reserve(group.mNodes.size());
+      for (auto const& node : group.mNodes) {
+        transforms.push_back(modelMatrix * instance->mGlobalTransforms[node->mHierarchyIndex]);
+      }
+    } else {
+      transforms = group.getTransforms(modelMatrix);
+    }
+
+    if (skin) {
+      if (!instance) {
+        skin->writeJointMatrices(group.mNodes.front()->mGlobalTransform, jointMatrices + jointEnd);
+      }
+      jointOffset = static_cast<int32_t>(jointEnd);
+      jointEnd += static_cast<uint32_t>(skin->mJoints.size());
+    }
+
+    // only groups with one Node may have morph targets, its Primitives use their morphed copies
+    auto const& morphVertexOffsets = group.mNodes.front()->mMorphVertexOffsets;
+
+    for (size_t i(0); i < group.mMesh->mPrimitives.size(); ++i) {
+      auto const& p          = group.mMesh->mPrimitives[i];
+      auto        attributes = static_cast<int32_t>(p.mVertexAttributes);
+      if (!skin) {
+        attributes &= ~static_cast<int32_t>(Primitive::VertexAttributeBits::eSkins);
+      }
+
+      bool    morphed       = !morphVertexOffsets.empty() && morphVertexOffsets[i] >= 0;
+      int32_t vertexOffset  = morphed ? morphVertexOffsets[i] : p.mVertexOffset;
+      int32_t materialIndex = static_cast<int32_t>(getIndex(*p.mMaterial));
+
+      std::vector<size_t> lods(transforms.size(), 0);
+      if (lodSelection) {
+        for (size_t t(0); t < transforms.size(); ++t) {
+          lods[t] = selectLod(p, transforms[t], *lodSelection);
+        }
+      }
+
+      for (size_t lod(0); lod <= p.mLods.size(); ++lod) {
+        Draw draw;
+        draw.mPrimitive        = &p;
+        draw.mVertexOffset     = vertexOffset;
+        draw.mVertexAttributes = attributes;
+        draw.mIndexOffset      = lod == 0 ? p.mIndexOffset : p.mLods[lod - 1].mIndexOffset;
+        draw.mIndexCount       = static_cast<uint32_t>(
+            lod == 0 ? p.mIndexCount : p.mLods[lod - 1].mIndexCount);
+        draw.mFirstInstance    = static_cast<uint32_t>(instances.size());
+        draw.mInstanceCount    = 0;
+
+        // the Meshlets contain the full-detail triangles only
+        draw.mFirstMeshlet = lod == 0 ? p.mFirstMeshlet : 0;
+        draw.mMeshletCount = lod == 0 ? p.mMeshletCount : 0;
+
+        for (size_t t(0); t < transforms.size(); ++t) {
+          if (lods[t] != lod) {
+            continue;
+          }
+
+          DrawList::Instance instance;
+          instance.mModelMatrix      = transforms[t];
+          instance.mMaterialIndex    = materialIndex;
+          instance.mVertexAttributes = attributes;
+          instance.mJointOffset      = jointOffset;
+          instance.mPadding          = 0;
+          instances.push_back(instance);
+          ++draw.mInstanceCount;
+
+          // the bounding boxes do not account for the deformation by skins and morph targets
+          instanceBoxes.emplace_back();
+          if (!skin && !morphed) {
+            instanceBoxes.back() = p.mBoundingBox.getTransformed(transforms[t]);
+            draw.mBoundingBox.add(instanceBoxes.back());
+          }
+        }
+
+        if (draw.mInstanceCount > 0) {
+          draws.push_back(draw);
+        }
+      }
+    }
+  }
+
+  // group the Primitives by blending mode, Material, topology, vertex attributes and whether they
+  // can be drawn with Meshlets
+  std::stable_sort(draws.begin(), draws.end(), [](Draw const& a, Draw const& b) {
+    auto const& pa = *a.mPrimitive;
+    auto const& pb = *b.mPrimitive;
+    return std::make_tuple(pa.mMaterial->mDoAlphaBlending, pa.mMaterial.get(), pa.mTopology,
+               a.mVertexAttributes, a.mMeshletCount > 0) <
+           std::make_tuple(pb.mMaterial->mDoAlphaBlending, pb.mMaterial.get(), pb.mTopology,
+               b.mVertexAttributes, b.mMeshletCount > 0);
+  });
+
+  if (mMeshletBuffer) {
+    result.mMeshletDraws.resize(draws.size());
+  }
+
+  std::vector<vk::DrawIndexedIndirectCommand> commands(std::max<size_t>(draws.size(), 1));
+  std::vector<DrawList::Bounds>               bounds(std::max<size_t>(draws.size(), 1));
+  std::vector<DrawList::InstanceBounds>       instanceBounds(std::max<size_t>(instances.size(), 1));
+
+  for (size_t i(0); i < draws.size(); ++i) {
+    auto const& p = *draws[i].mPrimitive;
+
+    bool meshlets = draws[i].mMeshletCount > 0;
+
+    if (result.mBatches.empty() || result.mBatches.back().mMaterial != p.mMaterial ||
+        result.mBatches.back().mTopology != p.mTopology ||
+        result.mBatches.back().mVertexAttributes != draws[i].mVertexAttributes ||
+        result.mBatches.back().mMeshlets != meshlets) {
+      DrawList::Batch batch;
+      batch.mMaterial         = p.mMaterial;
+      batch.mTopology         = p.mTopology;
+      batch.mVertexAttributes = draws[i].mVertexAttributes;
+      batch.mIndex            = static_cast<uint32_t>(result.mBatches.size());
+      batch.mFirstDraw        = static_cast<uint32_t>(i);
+      batch.mMeshlets         = meshlets;
+      result.mBatches.push_back(batch);
+    }
+
+    auto& batch = result.mBatches.back();
+    ++batch.mDrawCount;
+
+    commands[i].indexCount    = draws[i].mIndexCount;
+    commands[i].instanceCount = draws[i].mInstanceCount;
+    commands[i].firstIndex    = getFirstIndex() + draws[i].mIndexOffset;
+    commands[i].vertexOffset  = static_cast<int32_t>(getFirstVertex()) + draws[i].mVertexOffset;
+    commands[i].firstInstance = draws[i].mFirstInstance;
+
+    bounds[i].mMin            = draws[i].mBoundingBox.mMin;
+    bounds[i].mMax            = draws[i].mBoundingBox.mMax;
+    bounds[i].mBatch          = batch.mIndex;
+    bounds[i].mBatchFirstDraw = batch.mFirstDraw;
+
+    // the Instances of a draw are still stored consecutively, only the draws have been sorted
+    uint32_t instanceEnd = draws[i].mFirstInstance + draws[i].mInstanceCount;
+    for (uint32_t j(draws[i].mFirstInstance); j < instanceEnd; ++j) {
+      instanceBounds[j].mMin  = instanceBoxes[j].mMin;
+      instanceBounds[j].mMax  = instanceBoxes[j].mMax;
+      instanceBounds[j].mDraw = static_cast<uint32_t>(i);
+    }
+
+    if (meshlets) {
+      auto& meshletDraw          = result.mMeshletDraws[i];
+      meshletDraw.mFirstMeshlet  = draws[i].mFirstMeshlet;
+      meshletDraw.mMeshletCount  = draws[i].mMeshletCount;
+      meshletDraw.mVertexOffset  = commands[i].vertexOffset;
+      meshletDraw.mFirstInstance = draws[i].mFirstInstance;
+      meshletDraw.mInstanceCount = draws[i].mInstanceCount;
+    }
+  }
+
+  if (instances.empty()) {
+    instances.resize(1);
+  }
+
+  result.mDrawCommands = allocator.addData(reinterpret_cast<uint8_t const*>(commands.data()),
+      sizeof(vk::DrawIndexedIndirectCommand) * commands.size());
+  result.mInstances    = allocator.addData(reinterpret_cast<uint8_t const*>(instances.data()),
+      sizeof(DrawList::Instance) * instances.size());
+  result.mBounds       = allocator.addData(reinterpret_cast<uint8_t const*>(bounds.data()),
+      sizeof(DrawList::Bounds) * bounds.size());
+
+  result.mInstanceBounds =
+      allocator.addData(reinterpret_cast<uint8_t const*>(instanceBounds.data()),
+          sizeof(DrawList::InstanceBounds) * instanceBounds.size());
+
+  return result;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+std::vector<Node*> const& Model::getHierarchy() const {
+  return mHierarchy;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+std::vector<int32_t> const& Model::getParentIndices() const {
+  return mParentIndices;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
 void Model::printInfo() const {
 
   // clang-format off
   ILLUSION_MESSAGE << "Textures:" << std::endl;
   for (auto const& t : mTextures) {
+    if (!t) {
+      ILLUSION_MESSAGE << "  " << t << ": still loading" << std::endl;
+      continue;
+    }
     ILLUSION_MESSAGE << "  " << t << ": " << t->mImageInfo.extent.width << "x"
-                     << t->mImageInfo.extent.width << ", "
+                     << t->mImageInfo.extent.height << ", "
                      << vk::to_string(t->mImageInfo.format) << std::endl;
   }
 
@@ -971,7 +4086,8 @@ void Model::printInfo() const {
     ILLUSION_MESSAGE << "    Primitives:" << std::endl;
     for (auto const& p : m->mPrimitives) {
       ILLUSION_MESSAGE << "      Material: " << p.mMaterial << " Topology: " << vk::to_string(p.mTopology) 
-                       << " IndexCount: " << p.mIndexCount << " IndexOffset: " << p.mIndexOffset 
+                       << " IndexCount: " << p.mIndexCount << " IndexOffset: " << p.mIndexOffset
+                       << " VertexOffset: " << p.mVertexOffset << " Lods: " << p.mLods.size()
                        << " BoundingBox: " << p.mBoundingBox.mMin << " - " << p.mBoundingBox.mMax << std::endl;
     }
   }
@@ -1011,30 +4127,71 @@ void Model::printInfo() const {
     ILLUSION_MESSAGE << "    Joints:              " << s->mJoints.size() << std::endl;
     ILLUSION_MESSAGE << "    InverseBindMatrices: " << s->mInverseBindMatrices.size() << std::endl;
   }
+
+  ILLUSION_MESSAGE << "InstanceGroups:" << std::endl;
+  for (auto const& g : mInstanceGroups) {
+    ILLUSION_MESSAGE << "  " << g.mMesh << ": " << g.mMesh->mName << std::endl;
+    ILLUSION_MESSAGE << "    Nodes: " << g.mNodes.size() << std::endl;
+  }
   // clang-format on
 }
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////
 
-std::vector<vk::VertexInputBindingDescription> Model::getVertexInputBindings() {
-  return {{0, sizeof(Vertex), vk::VertexInputRate::eVertex}};
+std::vector<vk::VertexInputBindingDescription> Model::getVertexInputBindings(VertexLayout layout) {
+  if (layout == VertexLayout::eDefault) {
+    return {{0, sizeof(Vertex), vk::VertexInputRate::eVertex}};
+  }
+
+  uint32_t skinStride = layout == VertexLayout::eCompact ? sizeof(SkinVertex) : 0;
+
+  return {{0, sizeof(CompactVertex), vk::VertexInputRate::eVertex},
+      {1, skinStride, vk::VertexInputRate::eVertex}};
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+std::vector<vk::VertexInputAttributeDescription> Model::getVertexInputAttributes(
+    VertexLayout layout) {
+
+  if (layout == VertexLayout::eDefault) {
+    return {{0, 0, vk::Format::eR32G32B32Sfloat, offsetof(struct Vertex, mPosition)},
+        {1, 0, vk::Format::eR32G32B32Sfloat, offsetof(struct Vertex, mNormal)},
+        {2, 0, vk::Format::eR32G32Sfloat, offsetof(struct Vertex, mTexcoords)},
+        {3, 0, vk::Format::eR32G32B32A32Sfloat, offsetof(struct Vertex, mJoint0)},
+        {4, 0, vk::Format::eR32G32B32A32Sfloat, offsetof(struct Vertex, mWeight0)}};
+  }
+
+  return {{0, 0, vk::Format::eR32G32B32Sfloat, offsetof(struct CompactVertex, mPosition)},
+      {1, 0, vk::Format::eR16G16Snorm, offsetof(struct CompactVertex, mNormal)},
+      {2, 0, vk::Format::eR16G16Sfloat, offsetof(struct CompactVertex, mTexcoords)},
+      {3, 1, vk::Format::eR16G16B16A16Uint, offsetof(struct SkinVertex, mJoint0)},
+      {4, 1, vk::Format::eR8G8B8A8Unorm, offsetof(struct SkinVertex, mWeight0)}};
 }
 
+////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////
 ////////////////////////////////////////////////////////////////////////////////////////////////////
 
-std::vector<vk::VertexInputAttributeDescription> Model::getVertexInputAttributes() {
-  return {{0, 0, vk::Format::eR32G32B32Sfloat, offsetof(struct Vertex, mPosition)},
-      {1, 0, vk::Format::eR32G32B32Sfloat, offsetof(struct Vertex, mNormal)},
-      {2, 0, vk::Format::eR32G32Sfloat, offsetof(struct Vertex, mTexcoords)},
-      {3, 0, vk::Format::eR32G32B32A32Sfloat, offsetof(struct Vertex, mJoint0)},
-      {4, 0, vk::Format::eR32G32B32A32Sfloat, offsetof(struct Vertex, mWeight0)}};
+Material::Parameters Material::getParameters() const {
+  Parameters parameters;
+  parameters.mAlbedoFactor               = mAlbedoFactor;
+  parameters.mEmissiveFactor             = mEmissiveFactor;
+  parameters.mSpecularGlossinessWorkflow = mSpecularGlossinessWorkflow;
+  parameters.mMetallicRoughnessFactor    = mMetallicRoughnessFactor;
+  parameters.mNormalScale                = mNormalScale;
+  parameters.mOcclusionStrength          = mOcclusionStrength;
+  parameters.mAlphaCutoff                = mAlphaCutoff;
+  parameters.mPadding[0]                 = 0;
+  parameters.mPadding[1]                 = 0;
+  return parameters;
 }
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////
 ////////////////////////////////////////////////////////////////////////////////////////////////////
 ////////////////////////////////////////////////////////////////////////////////////////////////////
 
-BoundingBox BoundingBox::getTransformed(glm::mat4 const& transform) {
+BoundingBox BoundingBox::getTransformed(glm::mat4 const& transform) const {
   BoundingBox bbox;
   bbox.add((transform * glm::vec4(mMax.x, mMax.y, mMax.z, 1.f)).xyz());
   bbox.add((transform * glm::vec4(mMax.x, mMax.y, mMin.z, 1.f)).xyz());
@@ -1116,17 +4273,141 @@ void Node::addMeshesToBoundingBox(BoundingBox& bbox, glm::mat4 const& parentTran
 ////////////////////////////////////////////////////////////////////////////////////////////////////
 ////////////////////////////////////////////////////////////////////////////////////////////////////
 
+glm::vec4 Animation::Sampler::sample(
+    Channel::Type type, float time, uint32_t& cursor) const {
+  size_t s, e;
+  float  t;
+  findInterval(*this, cursor, time, s, e, t);
+
+  glm::vec4 value;
+
+  if (mType == Type::eStep) {
+    value = mValues[s];
+  } else if (mType == Type::eCubicSpline) {
+    value = sampleCubicSpline(*this, s, e, t);
+  } else if (type == Channel::Type::eRotation) {
+    glm::quat rotation =
+        glm::slerp(glm::make_quat(&mValues[s][0]), glm::make_quat(&mValues[e][0]), t);
+    value = glm::vec4(rotation.x, rotation.y, rotation.z, rotation.w);
+  } else {
+    value = glm::mix(mValues[s], mValues[e], t);
+  }
+
+  if (type == Channel::Type::eRotation) {
+    value = glm::normalize(value);
+  }
+
+  return value;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
 std::vector<glm::mat4> Skin::getJointMatrices(glm::mat4 const& meshTransform) const {
   std::vector<glm::mat4> jointMatrices(mJoints.size());
+  writeJointMatrices(meshTransform, jointMatrices.data());
+  return jointMatrices;
+}
 
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void Skin::writeJointMatrices(glm::mat4 const& meshTransform, glm::mat4* target) const {
   glm::mat4 inverseMeshTransform = glm::inverse(meshTransform);
 
   for (size_t i(0); i < mJoints.size(); i++) {
-    jointMatrices[i] =
-        inverseMeshTransform * mJoints[i]->mGlobalTransform * mInverseBindMatrices[i];
+    target[i] = inverseMeshTransform * mJoints[i]->mGlobalTransform * mInverseBindMatrices[i];
   }
+}
 
-  return jointMatrices;
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void Skin::writeJointMatrices(glm::mat4 const& meshTransform, glm::mat4 const* globalTransforms,
+    glm::mat4* target) const {
+  glm::mat4 inverseMeshTransform = glm::inverse(meshTransform);
+
+  for (size_t i(0); i < mJoints.size(); i++) {
+    int32_t          index = mJoints[i]->mHierarchyIndex;
+    glm::mat4 const& joint = index >= 0 ? globalTransforms[index] : mJoints[i]->mGlobalTransform;
+    target[i]              = inverseMeshTransform * joint * mInverseBindMatrices[i];
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+std::vector<glm::mat4> InstanceGroup::getTransforms(glm::mat4 const& modelMatrix) const {
+  std::vector<glm::mat4> result;
+  result.reserve(mNodes.size());
+
+  for (auto const& node : mNodes) {
+    result.push_back(modelMatrix * node->mGlobalTransform);
+  }
+
+  return result;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+uint32_t DrawList::getDrawCount() const {
+  return mBatches.empty() ? 0 : mBatches.back().mFirstDraw + mBatches.back().mDrawCount;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+bool DrawList::isOutdated() const {
+  return mGeometryArena && mGeometryArena->getGeneration() != mGeometryGeneration;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void DrawList::draw(CommandBuffer& cmd, Batch const& batch) const {
+  if (isOutdated()) {
+    throw std::runtime_error("Failed to draw: The GeometryArena has been compacted since the "
+                             "DrawList was created!");
+  }
+
+  if (mDirectDraws) {
+    auto commands = reinterpret_cast<vk::DrawIndexedIndirectCommand const*>(mDrawCommands.mData) +
+                    batch.mFirstDraw;
+
+    for (uint32_t i(0); i < batch.mDrawCount; ++i) {
+      cmd.drawIndexed(commands[i].indexCount, commands[i].instanceCount, commands[i].firstIndex,
+          commands[i].vertexOffset, commands[i].firstInstance);
+    }
+    return;
+  }
+
+  vk::DeviceSize offset =
+      mDrawCommands.mOffset + batch.mFirstDraw * sizeof(vk::DrawIndexedIndirectCommand);
+
+  if (mDrawCounts.mBuffer) {
+    cmd.drawIndexedIndirectCount(mDrawCommands.mBuffer, offset, mDrawCounts.mBuffer,
+        mDrawCounts.mOffset + batch.mIndex * sizeof(uint32_t), batch.mDrawCount);
+  } else {
+    cmd.drawIndexedIndirect(mDrawCommands.mBuffer, offset, batch.mDrawCount);
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void DrawList::drawMeshlets(CommandBuffer& cmd, Batch const& batch) const {
+  if (!batch.mMeshlets) {
+    throw std::runtime_error("Failed to draw Meshlets: The Batch has no Meshlets!");
+  }
+
+  if (isOutdated()) {
+    throw std::runtime_error("Failed to draw Meshlets: The GeometryArena has been compacted since "
+                             "the DrawList was created!");
+  }
+
+  for (uint32_t i(0); i < batch.mDrawCount; ++i) {
+    auto const& draw = mMeshletDraws[batch.mFirstDraw + i];
+    cmd.pushConstants(draw);
+    cmd.drawMeshTasks(
+        (draw.mMeshletCount + MESHLETS_PER_TASK - 1) / MESHLETS_PER_TASK, draw.mInstanceCount);
+  }
 }
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -10,11 +10,17 @@
 #define ILLUSION_GRAPHICS_GLTF_MODEL_HPP
 
 #include "../Core/Flags.hpp"
-#include "fwd.hpp"
+#include "../Core/Signal.hpp"
+#include "GeometryArena.hpp"
+#include "TransientAllocator.hpp"
 
 #define GLM_FORCE_SWIZZLE
 #include <glm/glm.hpp>
 #include <glm/gtc/quaternion.hpp>
+#include <glm/gtc/type_precision.hpp>
+
+#include <optional>
+#include <unordered_map>
 
 namespace Illusion::Graphics::Gltf {
 
@@ -25,26 +31,77 @@ namespace Illusion::Graphics::Gltf {
 // For now, all members of the structs are public. This should change in future as.               //
 ////////////////////////////////////////////////////////////////////////////////////////////////////
 
-// A bitwise combination of these flags can be passed to the constructor of the Model.
+// A bitwise combination of these flags can be passed to the constructor of the Model. eAsync,
+// eCompactVertices, eOptimizeMeshes, eGenerateLods, eCache, eCompressTextures and eMeshlets are
+// not part of eAll; see the constructor of the Model and VertexLayout for details.
 enum class LoadOptionBits : int {
-  eNone       = 0,
-  eAnimations = 1 << 0,
-  eSkins      = 1 << 1,
-  eTextures   = 1 << 2,
-  eAll        = eAnimations | eSkins | eTextures
+  eNone             = 0,
+  eAnimations       = 1 << 0,
+  eSkins            = 1 << 1,
+  eTextures         = 1 << 2,
+  eAsync            = 1 << 3,
+  eCompactVertices  = 1 << 4,
+  eOptimizeMeshes   = 1 << 5,
+  eGenerateLods     = 1 << 6,
+  eCache            = 1 << 7,
+  eCompressTextures = 1 << 8,
+  eMeshlets         = 1 << 9,
+  eGeometryArena    = 1 << 10,
+  eAll              = eAnimations | eSkins | eTextures
 };
 
 typedef Core::Flags<LoadOptionBits> LoadOptions;
 
+// The vertex layout of a Model is chosen at load time. eDefault uses one stream of Gltf::Vertex.
+// With LoadOptionBits::eCompactVertices, a stream of CompactVertex and a stream of SkinVertex are
+// used; if the Model has no skinned Primitives, the layout is eCompactUnskinned and the second
+// stream contains only one SkinVertex which is read with a stride of zero.
+enum class VertexLayout { eDefault, eCompact, eCompactUnskinned };
+
+// If this is passed to Model::createDrawList(), the coarsest Primitive::Lod whose error is below
+// mMaxPixelError on screen is drawn for each instance. mProjectionScale converts view space sizes
+// at a distance of one to pixels; for a perspective projection, this is the viewport height
+// divided by 2 * tan(fovy / 2), or projection[1][1] * height / 2.
+struct LodSelection {
+  glm::vec3 mEyePosition     = glm::vec3(0.f); // in world space
+  float     mProjectionScale = 1.f;
+  float     mMaxPixelError   = 1.f;
+};
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// glTF files often reference the same Mesh from many Nodes. An InstanceGroup contains all Nodes  //
+// of a Model which share a Mesh; each Primitive of the Mesh can be drawn for all of them with    //
+// one instanced draw call. As the joint matrices and the morphed vertices depend on the Node,    //
+// Nodes with a Skin or with morph targets are never grouped with other Nodes.                    //
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+struct InstanceGroup {
+  MeshPtr              mMesh;
+  std::vector<NodePtr> mNodes;
+
+  // Returns the current global transformations of all Nodes, multiplied by the modelMatrix.
+  std::vector<glm::mat4> getTransforms(glm::mat4 const& modelMatrix = glm::mat4(1.f)) const;
+};
+
 ////////////////////////////////////////////////////////////////////////////////////////////////////
 // Given a filename of a .gltf or .glb file, the Gltf::Model will load all Nodes, Materials,      //
 // Textures, Meshes, Primitives, Animations and Skins from the file. All vertex data of all       //
 // primitives is stored in one huge vertex buffer and one index buffer object. The primitives     //
 // only store information on the data offset in those buffers. While this leads to some wasting   //
 // of memory (not all primitives will have normals, texture coordinates and joint information),   //
-// this makes rendering of Models much cheaper since no pipeline need to be re-bound.             //
+// this makes rendering of Models much cheaper since no pipeline need to be re-bound. The images  //
+// are decoded and the vertex data is converted on the Core::ThreadPool::getShared(). With        //
+// LoadOptionBits::eAsync, the Model can be used while this is in progress.                       //
+//                                                                                                //
+// The morph targets of the Primitives are stored sparsely in another buffer, see                 //
+// Primitive::MorphTargets. Each Node with morph targets gets its own copy of the vertices of the //
+// morphed Primitives at the end of the vertex buffer; a Gltf::Morpher applies the weights of the //
+// Node to this copy on the GPU.                                                                  //
+//                                                                                                //
+// Many independently animated copies of one Model can be drawn with Gltf::ModelInstances, which  //
+// share all data of the Model except for the transformations of the Nodes.                       //
 //                                                                                                //
-// For now, multiple scenes, sparse accessors and morph targets are not supported.                //
+// For now, multiple scenes and sparse accessors are not supported.                               //
 ////////////////////////////////////////////////////////////////////////////////////////////////////
 
 class Model {
@@ -55,47 +112,226 @@ class Model {
     return std::make_shared<Model>(args...);
   };
 
+  // This is emitted by update() once all Meshes and Textures of an asynchronously loaded Model
+  // have been uploaded. It is never emitted for Models loaded without LoadOptionBits::eAsync, as
+  // these are loaded completely when the constructor returns.
+  Core::Signal<> sOnLoaded;
+
   // Creates a new Gltf::Model. The fileName should either be a *.gltf or a *.glb file. With the
   // options parameter you can prevent loading of some components such as textures.
+  // If options contains LoadOptionBits::eAsync, the constructor only parses the file and creates
+  // the Nodes, Materials, Skins and Animations. The vertex data and the images are then processed
+  // in the background and update() has to be called regularly to upload the results. Else the
+  // constructor blocks until everything has been loaded. Errors of the background tasks are
+  // thrown by update().
+  // With LoadOptionBits::eOptimizeMeshes, duplicate vertices of triangle lists are welded and the
+  // triangles and vertices are reordered for the vertex cache, for less overdraw and for vertex
+  // fetch locality (see MeshOptimizer.hpp). If no Primitive has more than 65536 vertices, the
+  // indices are stored as vk::IndexType::eUint16 then. Primitives with morph targets are not
+  // optimized, as the MorphDeltas refer to the original vertices.
+  // With LoadOptionBits::eGenerateLods, up to three simplified versions of each triangle list are
+  // added to the index buffer, with at most a half, a quarter and an eighth of the triangles of
+  // the Primitive. They are stored in Primitive::mLods and used by createDrawList().
+  // With LoadOptionBits::eCache, the parsed glTF file, the converted vertex data and the decoded
+  // mipmaps are stored in <fileName>.cache once everything has been loaded. When the Model is
+  // loaded again with the same options and neither the file nor its external buffers and images
+  // have been modified (according to their sizes and modification times), this file is
+  // memory-mapped and uploaded directly instead of parsing the glTF file, converting the meshes
+  // and decoding the images again.
+  // With LoadOptionBits::eCompressTextures, the decoded images are compressed to BC1 (if they are
+  // opaque) or BC3 on the worker threads. This is ignored if the device does not support these
+  // formats.
+  // With LoadOptionBits::eMeshlets, the triangle lists without skins and morph targets are
+  // partitioned into MeshOptimizer::Meshlets for mesh shaders, see getMeshletBuffer(). The vertex
+  // buffer gets vk::BufferUsageFlagBits::eStorageBuffer usage then, so that mesh shaders can read
+  // the vertices. The Meshlets are not stored in the cache file, they are rebuilt when loading.
+  // With LoadOptionBits::eGeometryArena, the vertices and indices are stored in the shared
+  // GeometryArena of the Device for the VertexLayout instead of buffers of their own, so that
+  // several Models can be drawn without binding other buffers. The indices are always stored as
+  // vk::IndexType::eUint32 then. If the arena is full, the Model falls back to its own buffers.
+  // If a TextureStreamer is given, the decoded Textures are added to it instead of being uploaded
+  // completely. Only their mip tails are resident until requestTextureResolutions() is used.
   Model(DevicePtr const& device, std::string const& fileName,
-      LoadOptions options = LoadOptionBits::eAll);
+      LoadOptions               options         = LoadOptionBits::eAll,
+      TextureStreamerPtr const& textureStreamer = nullptr);
+
+  // Cancels all background tasks which have not been started yet and removes the Textures from
+  // the TextureStreamer. Materials, Meshes, Nodes, Skins and Animations which are still used
+  // elsewhere stay valid, but their references to each other (like Node::mChildren or
+  // Primitive::mMaterial) are cleared.
+  virtual ~Model();
+
+  // Uploads the Meshes and Textures which have been processed in the background since the last
+  // call; this has to be called by the thread which created the Model, for example once a frame.
+  // The uploads do not block. Meshes become drawable as soon as their vertex data has been
+  // uploaded; createDrawList() skips Meshes which are not loaded yet. Textures are assigned to the
+  // Materials once they have been uploaded, until then the Materials use single-pixel Textures.
+  // To reduce stutter, at most maxTextureBytes of texture data are uploaded per call. Returns
+  // true once loading has been finished.
+  bool update(vk::DeviceSize maxTextureBytes = 64 * 1024 * 1024);
+
+  // Returns true once all Meshes and Textures have been uploaded.
+  bool isLoaded() const;
+
+  // Returns true once all Meshes have been uploaded.
+  bool isGeometryLoaded() const;
 
   // Updates all transformations of all Nodes according to the given animation and time. The time is
   // automatically clamped to the start and end time of the animation and is usually provided in
   // seconds.
   void setAnimationTime(uint32_t animationIndex, float time);
 
+  // Like setAnimationTime(), but for many Models at once, for example for a crowd of animated
+  // characters. The linearly interpolated Channels of all Models are collected and interpolated
+  // together in one loop per Channel type.
+  struct AnimationTime {
+    Model*   mModel;
+    uint32_t mAnimationIndex;
+    float    mTime;
+  };
+
+  static void setAnimationTimes(std::vector<AnimationTime> const& times);
+
+  // Recomputes the global transformations of all Nodes of the default scene whose local
+  // transformation or one of whose ancestors' local transformations has changed, see Node::mDirty.
+  // The Nodes are stored in hierarchy order in contiguous arrays, so this is one linear pass. This
+  // is called by the constructor and by setAnimationTime(); it only has to be called if Nodes are
+  // modified manually.
+  void updateTransforms();
+
+  // Returns the bounding box of all Meshes of the default scene in the current animation state.
+  // Unlike Node::getBoundingBox(), this uses the global transformations of updateTransforms()
+  // instead of traversing the hierarchy.
+  BoundingBox getBoundingBox() const;
+
   // Gets the root node of the default scene. This usually does not exist in the glTF format but is
   // created here anyways. It is quite useful for getting the global bounding box, for example. The
   // children of this Node are the actual root nodes of the glTF file.
   NodePtr const& getRoot() const;
 
-  // Returns the index buffer for all primitives of this Model.
-  BackedBufferPtr const& getIndexBuffer() const;
-
-  // Returns the vertex buffer for all primitives of this Model.
-  BackedBufferPtr const& getVertexBuffer() const;
+  // Returns the index buffer for all primitives of this Model. The indices are relative to the
+  // mVertexOffset of their Primitive and have to be bound with getIndexType(). With
+  // LoadOptionBits::eGeometryArena, this and the vertex buffers are the current buffers of the
+  // arena; the draw commands of createDrawList() refer to the range of this Model then.
+  BackedBufferPtr getIndexBuffer() const;
+  vk::IndexType   getIndexType() const;
+
+  // Returns the vertex buffer for all primitives of this Model. Depending on the VertexLayout, this
+  // contains Vertex or CompactVertex elements, it should be bound to binding 0. If the
+  // PhysicalDevice supportsRayQueries(), the vertex and index buffers can be used as inputs of
+  // acceleration structure builds, see Gltf::RayTracingScene.
+  BackedBufferPtr getVertexBuffer() const;
+
+  // Returns the SkinVertex stream for the compact VertexLayouts which should be bound to binding
+  // 1. For VertexLayout::eDefault this is nullptr.
+  BackedBufferPtr getSkinBuffer() const;
+
+  VertexLayout getVertexLayout() const;
+
+  // With LoadOptionBits::eGeometryArena, this is the arena which stores the vertices and indices
+  // and these are the offsets of the range of this Model in it. They change when the arena is
+  // compacted. Without an arena, the arena is nullptr and both offsets are zero.
+  GeometryArenaPtr const& getGeometryArena() const;
+  uint32_t                getFirstVertex() const;
+  uint32_t                getFirstIndex() const;
+
+  // Returns the Primitive::MorphDeltas of all Primitives. This is nullptr if the Model has no
+  // morph targets; else the vertex buffer has vk::BufferUsageFlagBits::eStorageBuffer usage as
+  // well, so that a Gltf::Morpher can write the morphed vertices.
+  BackedBufferPtr const& getMorphTargetBuffer() const;
+
+  // With LoadOptionBits::eMeshlets, these contain the MeshOptimizer::Meshlets of all Primitives,
+  // their vertex indices (uint32_t, relative to the mVertexOffset of their Primitive) and their
+  // packed triangles (one uint32_t each). See Primitive::mFirstMeshlet. They have
+  // vk::BufferUsageFlagBits::eStorageBuffer usage; without eMeshlets, they are nullptr.
+  BackedBufferPtr const& getMeshletBuffer() const;
+  BackedBufferPtr const& getMeshletVertexBuffer() const;
+  BackedBufferPtr const& getMeshletTriangleBuffer() const;
+
+  // Contains one Material::Parameters for each Material in the order of getMaterials(), so that
+  // shaders can look them up with the index returned by getIndex(). It has
+  // vk::BufferUsageFlagBits::eStorageBuffer usage and is written once while loading; changes to
+  // the factors of the Materials afterwards are not reflected.
+  BackedBufferPtr const& getMaterialBuffer() const;
 
   // The Nodes store pointers to their Materials / Meshes / ... but it may be useful to access all
-  // of them in one std::vector. Especially the Animations should be accessed via this API.
+  // of them in one std::vector. Especially the Animations should be accessed via this API. Textures
+  // which are still being loaded are nullptr.
   std::vector<TexturePtr> const&   getTextures() const;
   std::vector<MaterialPtr> const&  getMaterials() const;
   std::vector<MeshPtr> const&      getMeshes() const;
   std::vector<NodePtr> const&      getNodes() const;
   std::vector<AnimationPtr> const& getAnimations() const;
 
+  // The Materials, Meshes, Nodes, Skins and Animations are not allocated individually; each kind
+  // is stored in one contiguous array which is allocated once while loading. The pointers above
+  // point into these arrays and keep them alive. These return the index of the given object in
+  // getMaterials(), getMeshes() or getNodes() in constant time, or ~0u if it does not belong to
+  // this Model. The index can be used as a compact handle, for example to index GPU buffers.
+  uint32_t getIndex(Material const& material) const;
+  uint32_t getIndex(Mesh const& mesh) const;
+  uint32_t getIndex(Node const& node) const;
+
+  // Returns the Nodes of the default scene grouped by their Mesh. Nodes with a Skin get a group of
+  // their own. The groups are in the order in which their first Node is found in the hierarchy.
+  std::vector<InstanceGroup> const& getInstanceGroups() const;
+
+  // Flattens the Node hierarchy in its current animation state into a DrawList. The draw commands,
+  // the Instance data and the joint matrices are written to the given TransientAllocator, which
+  // therefore needs eIndirectBuffer and eStorageBuffer usage (as it has by default). The
+  // modelMatrix is multiplied to the global transformations of all Nodes. There is one instanced
+  // draw command for each Primitive of each InstanceGroup; if an LodSelection is given, the
+  // instances are split into one command per level of detail in use.
+  DrawList createDrawList(TransientAllocator& allocator,
+      glm::mat4 const&                   modelMatrix  = glm::mat4(1.f),
+      std::optional<LodSelection> const& lodSelection = std::nullopt) const;
+
+  // If the Model uses a TextureStreamer, this requests the resolution of each of its Textures
+  // which is required for the current view. The resolution is estimated from the projected size
+  // of the bounding boxes of the Primitives using the Textures, assuming that their texture
+  // coordinates span the Texture about once. The parameters have the same meaning as the members
+  // of LodSelection. TextureStreamer::update() has to be called afterwards.
+  void requestTextureResolutions(glm::vec3 const& eyePosition, float projectionScale,
+      glm::mat4 const& modelMatrix = glm::mat4(1.f)) const;
+
   // For debugging purposes.
   void printInfo() const;
 
-  // Since all vertices are stored in one vertex buffer object, these are the same for all Models.
-  static std::vector<vk::VertexInputBindingDescription>   getVertexInputBindings();
-  static std::vector<vk::VertexInputAttributeDescription> getVertexInputAttributes();
+  // Returns the Nodes of the default scene in depth-first order (see Node::mHierarchyIndex) and
+  // the index of the parent of each of them in this array, or -1 for the root Nodes of the scene.
+  std::vector<Node*> const&   getHierarchy() const;
+  std::vector<int32_t> const& getParentIndices() const;
+
+  // Since all vertices are stored in one vertex buffer object, these are the same for all Models
+  // with the same VertexLayout. The compact layouts have to be used with a shader which decodes the
+  // normals (see GltfShaderCompact.vert).
+  static std::vector<vk::VertexInputBindingDescription> getVertexInputBindings(
+      VertexLayout layout = VertexLayout::eDefault);
+  static std::vector<vk::VertexInputAttributeDescription> getVertexInputAttributes(
+      VertexLayout layout = VertexLayout::eDefault);
 
  private:
   DevicePtr       mDevice;
   NodePtr         mRootNode;
   BackedBufferPtr mIndexBuffer;
   BackedBufferPtr mVertexBuffer;
+  BackedBufferPtr mSkinBuffer;
+  BackedBufferPtr mMorphTargetBuffer;
+  BackedBufferPtr mMeshletBuffer;
+  BackedBufferPtr mMeshletVertexBuffer;
+  BackedBufferPtr mMeshletTriangleBuffer;
+  BackedBufferPtr mMaterialBuffer;
+  VertexLayout    mVertexLayout = VertexLayout::eDefault;
+  vk::IndexType   mIndexType    = vk::IndexType::eUint32;
+
+  GeometryArenaPtr             mGeometryArena;
+  GeometryArena::AllocationPtr mGeometry;
+
+  // The storage of the Materials, Meshes, Nodes, Skins and Animations. The vectors below contain
+  // aliasing std::shared_ptrs to its elements. As the elements refer to each other with such
+  // std::shared_ptrs as well, ~Model() clears these references.
+  struct Arena;
+  std::shared_ptr<Arena> mArena;
 
   std::vector<TexturePtr>   mTextures;
   std::vector<MaterialPtr>  mMaterials;
@@ -103,16 +339,64 @@ class Model {
   std::vector<NodePtr>      mNodes;
   std::vector<AnimationPtr> mAnimations;
   std::vector<SkinPtr>      mSkins;
+
+  std::vector<InstanceGroup> mInstanceGroups;
+
+  // The Nodes of the default scene in depth-first order. mParentIndices contains the index of the
+  // parent of each of them in this array, or -1 for the root Nodes of the scene.
+  std::vector<Node*>     mHierarchy;
+  std::vector<int32_t>   mParentIndices;
+  std::vector<glm::mat4> mLocalTransforms;
+  std::vector<glm::mat4> mGlobalTransforms;
+  std::vector<uint8_t>   mDirtyTransforms;
+
+  // Implements both createDrawList() and ModelInstance::createDrawList(). If an instance is given,
+  // its pose is drawn instead of the current transformations of the Nodes.
+  DrawList createDrawList(TransientAllocator& allocator, glm::mat4 const& modelMatrix,
+      std::optional<LodSelection> const& lodSelection, ModelInstance const* instance) const;
+
+  friend class ModelInstance;
+
+  // For each Texture, the handle returned by TextureStreamer::add(); the map is used to find the
+  // index of the current Textures of the Materials.
+  static constexpr uint32_t INVALID_STREAMING_HANDLE = ~0u;
+
+  TextureStreamerPtr                         mTextureStreamer;
+  std::vector<uint32_t>                      mStreamingHandles;
+  std::unordered_map<Texture const*, size_t> mStreamedTextureIndices;
+
+  // This contains the parsed file and the results of the background tasks. It is shared with the
+  // tasks and released by update() once loading has been finished.
+  struct LoadingState;
+  std::shared_ptr<LoadingState> mLoadingState;
+
+  // This implements update() without emitting sOnLoaded, so that the constructor can use it.
+  bool uploadLoadedData(vk::DeviceSize maxTextureBytes);
 };
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////
 // The Material can be either used for the metallic-roughness workflow or for the                 //
 // specular-glossiness workflow. In the latter case, some of the members are intrepreted in a     //
 // different way. See the inline comments for details.                                            //
-// When drawing the model, it is possible to upload the material data via push constants.         //
+// The Model uploads the Parameters of all of its Materials to one storage buffer, see            //
+// Model::getMaterialBuffer().                                                                    //
 ////////////////////////////////////////////////////////////////////////////////////////////////////
 
 struct Material {
+
+  // The factors of a Material as they are stored in Model::getMaterialBuffer(). The layout of
+  // this struct matches the std430 layout of a corresponding GLSL struct.
+  struct Parameters {
+    glm::vec4 mAlbedoFactor;
+    glm::vec3 mEmissiveFactor;
+    int32_t   mSpecularGlossinessWorkflow;
+    glm::vec3 mMetallicRoughnessFactor;
+    float     mNormalScale;
+    float     mOcclusionStrength;
+    float     mAlphaCutoff;
+    int32_t   mPadding[2];
+  };
+
   std::string mName;
 
   bool mDoubleSided                = false;
@@ -131,6 +415,9 @@ struct Material {
   TexturePtr mMetallicRoughnessTexture; // g:    roughness, b: metallic / rgb specular glossiness
   TexturePtr mOcclusionTexture;         // r:    ambient occlusion
   TexturePtr mNormalTexture;            // rgb:  tangent space normal map
+
+  // Copies the factors above.
+  Parameters getParameters() const;
 };
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -144,7 +431,7 @@ struct BoundingBox {
 
   // Returns a new axis aligned bounding box which contains this bounding box when transformed by
   // the given matrix.
-  BoundingBox getTransformed(glm::mat4 const& transform);
+  BoundingBox getTransformed(glm::mat4 const& transform) const;
 
   // Returns true when the mMin and mMax members have not been changed.
   bool isEmpty() const;
@@ -157,9 +444,9 @@ struct BoundingBox {
 };
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////
-// For now, all Gltf::Models share the same vertex layout. This simplifies drawing but wastes     //
-// some memory. We should at least consider optimizing for the case were there are no animations  //
-// at all. This would half the size of our vertex buffer object.                                  //
+// By default, all Gltf::Models share the same vertex layout. This simplifies drawing but wastes  //
+// some memory. Models loaded with LoadOptionBits::eCompactVertices use the CompactVertex and     //
+// SkinVertex below instead.                                                                      //
 ////////////////////////////////////////////////////////////////////////////////////////////////////
 
 struct Vertex {
@@ -171,8 +458,28 @@ struct Vertex {
 };
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////
-// A Primitive stores the offset into the Model-global index buffer object. Additionally it       //
-// stores whether its vertices have normals, texture coordinates or joints and weights. As all    //
+// These are used for the compact VertexLayouts. The CompactVertex stores the normal in an        //
+// octahedron encoding as two snorm16 values and the texture coordinates as half floats, which    //
+// reduces the size of a vertex from 80 to 20 bytes. The joints (uint16) and weights (unorm8) are //
+// stored in a separate stream of SkinVertices (12 bytes), so that static Models do not need it.  //
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+struct CompactVertex {
+  glm::vec3    mPosition  = glm::vec3(0.f);
+  glm::i16vec2 mNormal    = glm::i16vec2(0);
+  glm::u16vec2 mTexcoords = glm::u16vec2(0);
+};
+
+struct SkinVertex {
+  glm::u16vec4 mJoint0  = glm::u16vec4(0);
+  glm::u8vec4  mWeight0 = glm::u8vec4(0);
+};
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// A Primitive stores the offset into the Model-global index buffer object. Its indices are       //
+// relative to mVertexOffset, which is passed as vertexOffset to the draw commands. The mLods use //
+// the same vertices with fewer triangles; they are sorted from fine to coarse. Additionally      //
+// it stores whether its vertices have normals, texture coordinates or joints and weights. As all //
 // vertices share the same layout, the Shader has to ignore those values if they are not actually //
 // set. So it's a good idea to set the mVertexAttributes member as push constant at draw time.    //
 ////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -185,17 +492,63 @@ struct Primitive {
   vk::PrimitiveTopology            mTopology;
   vk::DeviceSize                   mIndexCount;
   uint32_t                         mIndexOffset;
+  int32_t                          mVertexOffset = 0;
   BoundingBox                      mBoundingBox;
+
+  // mError is the maximum object space distance between the surface of the Lod and the surface of
+  // the Primitive.
+  struct Lod {
+    uint32_t       mIndexOffset = 0;
+    vk::DeviceSize mIndexCount  = 0;
+    float          mError       = 0.f;
+  };
+
+  std::vector<Lod> mLods;
+
+  // With LoadOptionBits::eMeshlets, the full-detail triangles of the Primitive are additionally
+  // stored as mMeshletCount MeshOptimizer::Meshlets in the meshlet buffer of the Model, starting at
+  // mFirstMeshlet. If mMeshletCount is zero, the Primitive has to be drawn with the index buffer.
+  uint32_t mFirstMeshlet = 0;
+  uint32_t mMeshletCount = 0;
+
+  // The layout of this struct matches the std430 layout of the MorphDelta struct of the
+  // Gltf::Morpher. mVertex is relative to the first vertex of the Primitive.
+  struct MorphDelta {
+    glm::vec3 mPosition;
+    uint32_t  mVertex;
+    glm::vec3 mNormal;
+    float     mUnused = 0.f;
+  };
+
+  // Only the vertices which are displaced by at least one morph target are stored. For each of
+  // them, there are mTargetCount consecutive MorphDeltas in the morph target buffer of the Model,
+  // starting at mFirstDelta. If the Primitive has no morph targets, mTargetCount is zero.
+  struct MorphTargets {
+    uint32_t mTargetCount          = 0;
+    uint32_t mVertexCount          = 0; // of the whole Primitive
+    uint32_t mDisplacedVertexCount = 0;
+    uint32_t mFirstDelta           = 0;
+  };
+
+  MorphTargets mMorphTargets;
 };
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////
-// A Mesh contains a set of Primitives as well as a BoundingBox containing all Primitives.        //
+// A Mesh contains a set of Primitives as well as a BoundingBox containing all Primitives. The    //
+// BoundingBox is available before the vertex data has been loaded, as it is taken from the       //
+// accessors of the glTF file if possible.                                                        //
 ////////////////////////////////////////////////////////////////////////////////////////////////////
 
 struct Mesh {
   std::string            mName;
   BoundingBox            mBoundingBox;
   std::vector<Primitive> mPrimitives;
+
+  // The default weights of the morph targets, one for each target of the Primitives.
+  std::vector<float> mWeights;
+
+  // This is set by Model::update() once the vertex data of the Mesh has been uploaded.
+  bool mLoaded = false;
 };
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -209,7 +562,7 @@ struct Node {
   SkinPtr              mSkin;
   std::vector<NodePtr> mChildren;
 
-  // This is set by the update() method.
+  // This is set by Model::updateTransforms() and the update() method.
   glm::mat4 mGlobalTransform = glm::mat4(1.f);
 
   // These are affected by animations.
@@ -223,8 +576,26 @@ struct Node {
   glm::quat mRestRotation    = glm::quat(1.f, 0.f, 0.f, 0.f);
   glm::vec3 mRestScale       = glm::vec3(1.f);
 
-  // This is called recursively by the Gltf::Model's constructor and setAnimationTime() and updates
-  // the mGlobalTransform member.
+  // This has to be set whenever mTransform, mTranslation, mRotation or mScale are changed, then
+  // Model::updateTransforms() recomputes the global transformations of this Node and its
+  // descendants. Model::setAnimationTime() does this automatically.
+  bool mDirty = true;
+
+  // The index of this Node in the depth-first order of the default scene, which is used by
+  // Model::updateTransforms() and by the Gltf::ModelInstances. This is -1 for Nodes which are not
+  // part of the default scene.
+  int32_t mHierarchyIndex = -1;
+
+  // The weights of the morph targets of the Mesh; these are affected by animations. Whenever they
+  // are changed, mWeightsDirty has to be set. Then the Gltf::Morpher updates the morphed vertices
+  // of this Node, which are stored at mMorphVertexOffsets (one for each Primitive of the Mesh, -1
+  // for Primitives without morph targets). If the Mesh has no morph targets, both are empty.
+  std::vector<float>   mWeights;
+  std::vector<int32_t> mMorphVertexOffsets;
+  bool                 mWeightsDirty = true;
+
+  // Updates the mGlobalTransform member of this Node and all its descendants recursively,
+  // regardless of mDirty. Model::updateTransforms() is usually faster.
   void update(glm::mat4 parentTransform);
 
   // Combines the mTransform, mTranslation, mRotation and mScale members to one matrix.
@@ -245,18 +616,28 @@ struct Animation {
 
   // The Channel describes which Node to move.
   struct Channel {
-    enum class Type { eTranslation, eRotation, eScale };
+    enum class Type { eTranslation, eRotation, eScale, eWeights };
     Type     mType;
     NodePtr  mNode;
     uint32_t mSamplerIndex;
   };
 
-  // The Sampler describes how to move the Node.
+  // The Sampler describes how to move the Node. For Channels of Type::eWeights, each key frame
+  // has one value for each weight of the Node, which is stored in the x component.
   struct Sampler {
     enum class Type { eLinear, eStep, eCubicSpline };
     Type                   mType;
     std::vector<float>     mKeyFrames;
     std::vector<glm::vec4> mValues;
+
+    // The index of the key frame interval which has been used last, the next lookup starts here.
+    uint32_t mCursor = 0;
+
+    // Evaluates this Sampler at the given time for a Channel of the given type, which must not be
+    // Type::eWeights. Rotations are returned as normalized quaternions in x, y, z, w order. Instead
+    // of mCursor, the given cursor is used and updated; this way several threads can sample the
+    // same Animation at different times, each with its own cursors.
+    glm::vec4 sample(Channel::Type type, float time, uint32_t& cursor) const;
   };
 
   std::string          mName;
@@ -277,7 +658,144 @@ struct Skin {
   std::vector<glm::mat4> mInverseBindMatrices;
   std::vector<NodePtr>   mJoints;
 
+  // Returns one matrix for each joint which transforms from the bind pose to the current pose in
+  // the coordinate system of the Mesh.
   std::vector<glm::mat4> getJointMatrices(glm::mat4 const& meshTransform) const;
+
+  // Like above, but writes the mJoints.size() matrices to the given memory without allocating,
+  // for example directly to a mapped storage buffer.
+  void writeJointMatrices(glm::mat4 const& meshTransform, glm::mat4* target) const;
+
+  // Like above, but the global transformations of the joints are read from globalTransforms at
+  // their Node::mHierarchyIndex, for example from the pose of a Gltf::ModelInstance. Joints which
+  // are not part of the default scene use their mGlobalTransform.
+  void writeJointMatrices(glm::mat4 const& meshTransform, glm::mat4 const* globalTransforms,
+      glm::mat4* target) const;
+};
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// The DrawList is created by Model::createDrawList(). It contains one                            //
+// vk::DrawIndexedIndirectCommand for each Primitive (and Lod in use) of each InstanceGroup and   //
+// one Instance for each Primitive of each Node. The instanceCount of a command is the number of  //
+// its Nodes and the Instances of these Nodes are stored consecutively; the firstInstance of the  //
+// command is the index of the first of them. Hence shaders can read the Instance data from a     //
+// storage buffer with gl_InstanceIndex. If the drawIndirectFirstInstance feature is not          //
+// available, the commands are recorded as direct draws instead (see mDirectDraws). The commands  //
+// are grouped into Batches of Primitives sharing the same Material, topology and vertex          //
+// attributes; the Batches of opaque Materials come first. Hence a whole Model can be drawn with  //
+// one CommandBuffer::drawIndexedIndirect() per Batch instead of one drawIndexed() per Primitive  //
+// and Node. As the vertex attributes of a Batch are known, a shader variant without runtime      //
+// checks for missing attributes can be used for each of them (see ShaderVariants). Draws with    //
+// and without Meshlets are put into different Batches, so that the former can be drawn with mesh //
+// shaders instead (see drawMeshlets()).                                                          //
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+struct DrawList {
+
+  // The layout of this struct matches the std430 layout of a corresponding GLSL struct.
+  struct Instance {
+    glm::mat4 mModelMatrix;
+    int32_t   mMaterialIndex;    // index of the Material in Model::getMaterialBuffer()
+    int32_t   mVertexAttributes; // eSkins is only set if the Node actually has a Skin
+    int32_t   mJointOffset;      // index of the first joint matrix of the Node's Skin
+    int32_t   mPadding;
+  };
+
+  // For each draw command, this contains the range of Meshlets of its Primitive; mMeshletCount is
+  // zero if the Primitive has none or if a coarser Lod is drawn. The layout of this struct matches
+  // the std430 layout of a corresponding push constant block, see drawMeshlets().
+  struct MeshletDraw {
+    uint32_t mFirstMeshlet;
+    uint32_t mMeshletCount;
+    int32_t  mVertexOffset;
+    uint32_t mFirstInstance;
+    uint32_t mInstanceCount;
+  };
+
+  // The number of Meshlets processed by one task shader workgroup in drawMeshlets().
+  static constexpr uint32_t MESHLETS_PER_TASK = 32;
+
+  // The world space bounding box of all instances of a draw, this is used by the Gltf::Culler.
+  // Skinned and morphed Primitives get an empty box (mMin greater than mMax); they are never
+  // culled.
+  struct Bounds {
+    glm::vec3 mMin;
+    uint32_t  mBatch;
+    glm::vec3 mMax;
+    uint32_t  mBatchFirstDraw;
+  };
+
+  // The world space bounding box of a single Instance and the index of its draw command. The
+  // Gltf::Culler tests each Instance on its own, so an instanced draw only draws the visible ones.
+  // Like above, the boxes of skinned and morphed Primitives are empty.
+  struct InstanceBounds {
+    glm::vec3 mMin;
+    uint32_t  mDraw;
+    glm::vec3 mMax;
+    uint32_t  mPadding;
+  };
+
+  struct Batch {
+    MaterialPtr           mMaterial;
+    vk::PrimitiveTopology mTopology;
+    int32_t               mVertexAttributes = 0; // the same as in all Instances of the Batch
+    uint32_t              mIndex            = 0;
+    uint32_t              mFirstDraw        = 0;
+    uint32_t              mDrawCount        = 0;
+
+    // This is set if all draws of the Batch have Meshlets, so that drawMeshlets() can be used.
+    bool mMeshlets = false;
+  };
+
+  // vk::DrawIndexedIndirectCommands, Instances, glm::mat4s, Bounds and InstanceBounds. They
+  // contain at least one element, so they can always be bound as storage buffers.
+  TransientAllocator::Allocation mDrawCommands;
+  TransientAllocator::Allocation mInstances;
+  TransientAllocator::Allocation mJointMatrices;
+  TransientAllocator::Allocation mBounds;
+  TransientAllocator::Allocation mInstanceBounds;
+
+  // If this is set (by the Gltf::Culler), it contains one uint32_t for each Batch: the number of
+  // visible draws which have been compacted to the beginning of the Batch's range in
+  // mDrawCommands.
+  TransientAllocator::Allocation mDrawCounts;
+
+  std::vector<Batch> mBatches;
+
+  // This is set if the drawIndirectFirstInstance feature is not available. Then the commands are
+  // read from mDrawCommands on the host and recorded as direct draws by draw(); hence they must
+  // not be written on the GPU.
+  bool mDirectDraws = false;
+
+  // One for each draw command; if the Model has no Meshlets, this is empty.
+  std::vector<MeshletDraw> mMeshletDraws;
+
+  // With LoadOptionBits::eGeometryArena, this is the arena of the Model and its
+  // GeometryArena::getGeneration() when the DrawList was created.
+  GeometryArenaPtr mGeometryArena;
+  uint64_t         mGeometryGeneration = 0;
+
+  // Returns the number of draw commands of all Batches.
+  uint32_t getDrawCount() const;
+
+  // Returns true if mGeometryArena has been compacted since the DrawList was created. The draw
+  // commands refer to outdated ranges then, draw() and drawMeshlets() throw a std::runtime_error
+  // and the DrawList has to be created again.
+  bool isOutdated() const;
+
+  // Records one CommandBuffer::drawIndexedIndirect() for the given Batch, or one
+  // drawIndexedIndirectCount() if mDrawCounts is set. If mDirectDraws is set, one drawIndexed() is
+  // recorded for each command instead. The vertex and index buffers of the Model as well as the
+  // Material of the Batch have to be bound before.
+  void draw(CommandBuffer& cmd, Batch const& batch) const;
+
+  // Records one CommandBuffer::drawMeshTasks() for each draw of the given Batch, which must have
+  // mMeshlets set. The MeshletDraw is set as push constant and there are
+  // ceil(mMeshletCount / MESHLETS_PER_TASK) x mInstanceCount task shader workgroups. The task
+  // shader is expected to cull the Meshlets and to launch the mesh shaders for the visible ones.
+  // The mDrawCounts of the Gltf::Culler are ignored. The meshlet buffers and the vertex buffer of
+  // the Model have to be bound as storage buffers before.
+  void drawMeshlets(CommandBuffer& cmd, Batch const& batch) const;
 };
 
 } // namespace Illusion::Graphics::Gltf
@@ -0,0 +1,191 @@
+////////////////////////////////////////////////////////////////////////////////////////////////////
+//                                                                                                //
+//    _)  |  |            _)                This code may be used and modified under the terms    //
+//     |  |  |  |  | (_-<  |   _ \    \     of the MIT license. See the LICENSE file for details. //
+//    _| _| _| \_,_| ___/ _| \___/ _| _|    Copyright (c) 2018-2019 Simon Schneegans              //
+//                                                                                                //
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include "GltfModelInstance.hpp"
+
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <algorithm>
+
+namespace Illusion::Graphics::Gltf {
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+ModelInstance::ModelInstance(ModelPtr const& model)
+    : mModel(model) {
+
+  auto const& hierarchy = mModel->getHierarchy();
+
+  mTranslations.reserve(hierarchy.size());
+  mRotations.reserve(hierarchy.size());
+  mScales.reserve(hierarchy.size());
+  mGlobalTransforms.reserve(hierarchy.size());
+
+  for (Node const* node : hierarchy) {
+    mTranslations.push_back(node->mTranslation);
+    mRotations.push_back(node->mRotation);
+    mScales.push_back(node->mScale);
+    mGlobalTransforms.push_back(node->mGlobalTransform);
+  }
+
+  for (auto const& group : mModel->getInstanceGroups()) {
+    if (group.mNodes.front()->mSkin) {
+      mJointCount += static_cast<uint32_t>(group.mNodes.front()->mSkin->mJoints.size());
+    }
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+ModelInstance::~ModelInstance() = default;
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+ModelPtr const& ModelInstance::getModel() const {
+  return mModel;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void ModelInstance::setAnimationTime(uint32_t animationIndex, float time) {
+  auto const& animations = mModel->getAnimations();
+
+  if (animationIndex >= animations.size()) {
+    throw std::runtime_error("Failed to update GLTF animation: No animation number \"" +
+                             std::to_string(animationIndex) + "\" available!");
+  }
+
+  if (mAnimationIndex != static_cast<int32_t>(animationIndex)) {
+    mAnimationIndex = static_cast<int32_t>(animationIndex);
+    mCursors.assign(animations[animationIndex]->mSamplers.size(), 0);
+  }
+
+  mTime = time;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+TransientAllocator::Allocation ModelInstance::update(std::vector<ModelInstance*> const& instances,
+    TransientAllocator& allocator, Core::JobSystem& jobSystem) {
+
+  // the TransientAllocator is not thread-safe, hence one range is allocated for all instances and
+  // each of them writes its joint matrices to its own part of it
+  uint32_t jointCount = 0;
+  for (auto instance : instances) {
+    instance->mJointOffset = jointCount;
+    jointCount += instance->mJointCount;
+  }
+
+  auto jointMatrices = allocator.allocate(sizeof(glm::mat4) * std::max(jointCount, 1u));
+
+  for (auto instance : instances) {
+    instance->mJointMatrices = jointMatrices;
+  }
+
+  auto target = reinterpret_cast<glm::mat4*>(jointMatrices.mData);
+
+  // one chunk for each worker thread and one for the calling thread
+  size_t chunkCount = static_cast<size_t>(jobSystem.getThreadCount()) + 1;
+  size_t chunkSize  = (instances.size() + chunkCount - 1) / chunkCount;
+
+  jobSystem.parallelFor(
+      instances.size(), chunkSize, [&instances, target](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i) {
+          instances[i]->updatePose(target);
+        }
+      });
+
+  return jointMatrices;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+DrawList ModelInstance::createDrawList(TransientAllocator& allocator, glm::mat4 const& modelMatrix,
+    std::optional<LodSelection> const& lodSelection) const {
+
+  if (!mJointMatrices.mData) {
+    throw std::runtime_error(
+        "Failed to create DrawList of GLTF model instance: update() has not been called!");
+  }
+
+  return mModel->createDrawList(allocator, modelMatrix, lodSelection, this);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+std::vector<glm::mat4> const& ModelInstance::getGlobalTransforms() const {
+  return mGlobalTransforms;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+uint32_t ModelInstance::getJointCount() const {
+  return mJointCount;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void ModelInstance::updatePose(glm::mat4* jointMatrices) {
+
+  // sample the animation --------------------------------------------------------------------------
+  // The Samplers are shared with the Model and all other instances, hence the cursors of this
+  // instance are used.
+  if (mAnimationIndex >= 0) {
+    auto const& animation = *mModel->getAnimations()[mAnimationIndex];
+
+    for (auto const& channel : animation.mChannels) {
+      int32_t index = channel.mNode->mHierarchyIndex;
+
+      if (index < 0 || channel.mType == Animation::Channel::Type::eWeights) {
+        continue;
+      }
+
+      auto const& sampler = animation.mSamplers[channel.mSamplerIndex];
+      glm::vec4   value   = sampler.sample(channel.mType, mTime, mCursors[channel.mSamplerIndex]);
+
+      if (channel.mType == Animation::Channel::Type::eTranslation) {
+        mTranslations[index] = glm::vec3(value);
+      } else if (channel.mType == Animation::Channel::Type::eScale) {
+        mScales[index] = glm::vec3(value);
+      } else {
+        mRotations[index] = glm::quat(value.w, value.x, value.y, value.z);
+      }
+    }
+  }
+
+  // update the global transformations -------------------------------------------------------------
+  // Parents come before their children, so this is one linear pass.
+  auto const& hierarchy = mModel->getHierarchy();
+  auto const& parents   = mModel->getParentIndices();
+
+  for (size_t i = 0; i < hierarchy.size(); ++i) {
+    glm::mat4 local(hierarchy[i]->mTransform);
+    local = glm::translate(local, mTranslations[i]);
+    local = local * glm::mat4_cast(mRotations[i]);
+    local = glm::scale(local, mScales[i]);
+
+    mGlobalTransforms[i] = parents[i] >= 0 ? mGlobalTransforms[parents[i]] * local : local;
+  }
+
+  // write the joint matrices ----------------------------------------------------------------------
+  uint32_t jointEnd = mJointOffset;
+
+  for (auto const& group : mModel->getInstanceGroups()) {
+    auto const& node = group.mNodes.front();
+
+    if (node->mSkin) {
+      node->mSkin->writeJointMatrices(mGlobalTransforms[node->mHierarchyIndex],
+          mGlobalTransforms.data(), jointMatrices + jointEnd);
+      jointEnd += static_cast<uint32_t>(node->mSkin->mJoints.size());
+    }
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+} // namespace Illusion::Graphics::Gltf
@@ -0,0 +1,95 @@
+////////////////////////////////////////////////////////////////////////////////////////////////////
+//                                                                                                //
+//    _)  |  |            _)                This code may be used and modified under the terms    //
+//     |  |  |  |  | (_-<  |   _ \    \     of the MIT license. See the LICENSE file for details. //
+//    _| _| _| \_,_| ___/ _| \___/ _| _|    Copyright (c) 2018-2019 Simon Schneegans              //
+//                                                                                                //
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#ifndef ILLUSION_GRAPHICS_GLTF_MODEL_INSTANCE_HPP
+#define ILLUSION_GRAPHICS_GLTF_MODEL_INSTANCE_HPP
+
+#include "../Core/JobSystem.hpp"
+#include "GltfModel.hpp"
+
+namespace Illusion::Graphics::Gltf {
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// A ModelInstance is one independently animated copy of a Gltf::Model. The buffers, Meshes,      //
+// Skins and Animations are shared with the Model; the instance only stores its own pose, that is //
+// the local and global transformations of the Nodes of the default scene, in the order of        //
+// Model::getHierarchy(). This way, a crowd of characters needs only one Model.                   //
+// The poses of many instances are updated in parallel by update(), which writes the joint        //
+// matrices of all of them directly to one mapped TransientAllocator range.                       //
+// Channels of Type::eWeights are ignored by the instances; morphed Nodes use the morph target    //
+// weights of the Model.                                                                          //
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+class ModelInstance {
+
+ public:
+  // Syntactic sugar to create a std::shared_ptr for this class
+  template <typename... Args>
+  static ModelInstancePtr create(Args&&... args) {
+    return std::make_shared<ModelInstance>(args...);
+  };
+
+  // The instance starts with the current local transformations of the Nodes of the Model.
+  explicit ModelInstance(ModelPtr const& model);
+  virtual ~ModelInstance();
+
+  ModelPtr const& getModel() const;
+
+  // Selects the animation and the time which are sampled by the next update(). The time is clamped
+  // to the start and end time of the animation. Throws if there is no such animation.
+  void setAnimationTime(uint32_t animationIndex, float time);
+
+  // Samples the selected animation of each instance and recomputes its global transformations and
+  // joint matrices. The instances are split into one chunk per thread of the given JobSystem plus
+  // one for the calling thread, which blocks until all chunks have been processed. The instances
+  // must be distinct, but they may share Models. The joint matrices of all instances are written
+  // to the returned Allocation, which is used by createDrawList() afterwards; it contains at least
+  // one element, so it can always be bound as storage buffer.
+  static TransientAllocator::Allocation update(std::vector<ModelInstance*> const& instances,
+      TransientAllocator& allocator, Core::JobSystem& jobSystem);
+
+  // Like Model::createDrawList(), but draws the pose of this instance. update() has to be called
+  // with the same TransientAllocator before, the returned DrawList uses its joint matrices.
+  DrawList createDrawList(TransientAllocator& allocator,
+      glm::mat4 const&                   modelMatrix  = glm::mat4(1.f),
+      std::optional<LodSelection> const& lodSelection = std::nullopt) const;
+
+  // Returns the global transformation of each Node at its Node::mHierarchyIndex, as computed by
+  // the last update().
+  std::vector<glm::mat4> const& getGlobalTransforms() const;
+
+  // Returns the number of joint matrices which update() writes for this instance, which is the
+  // number of joints of the Skins of all InstanceGroups of the Model.
+  uint32_t getJointCount() const;
+
+ private:
+  // Samples the animation, computes the global transformations in one linear pass and writes the
+  // joint matrices to jointMatrices + mJointOffset. This is called on the worker threads.
+  void updatePose(glm::mat4* jointMatrices);
+
+  ModelPtr mModel;
+
+  int32_t               mAnimationIndex = -1;
+  float                 mTime           = 0.f;
+  std::vector<uint32_t> mCursors; // one for each Sampler of the selected animation
+
+  std::vector<glm::vec3> mTranslations;
+  std::vector<glm::quat> mRotations;
+  std::vector<glm::vec3> mScales;
+  std::vector<glm::mat4> mGlobalTransforms;
+
+  uint32_t                       mJointCount  = 0;
+  uint32_t                       mJointOffset = 0;
+  TransientAllocator::Allocation mJointMatrices;
+
+  friend class Model;
+};
+
+} // namespace Illusion::Graphics::Gltf
+
+#endif // ILLUSION_GRAPHICS_GLTF_MODEL_INSTANCE_HPP
@@ -0,0 +1,268 @@
+////////////////////////////////////////////////////////////////////////////////////////////////////
+//                                                                                                //
+//    _)  |  |            _)                This code may be used and modified under the terms    //
+//     |  |  |  |  | (_-<  |   _ \    \     of the MIT license. See the LICENSE file for details. //
+//    _| _| _| \_,_| ___/ _| \___/ _| _|    Copyright (c) 2018-2019 Simon Schneegans              //
+//                                                                                                //
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include "GltfMorpher.hpp"
+
+#include "../Core/Logger.hpp"
+#include "BackedBuffer.hpp"
+#include "CommandBuffer.hpp"
+#include "GltfModel.hpp"
+#include "Shader.hpp"
+#include "ShaderSource.hpp"
+
+#include <algorithm>
+#include <iostream>
+
+namespace Illusion::Graphics::Gltf {
+
+namespace {
+
+// One MorphJob is processed for each morphed Primitive of each Node. This matches the std430
+// layout of the MorphJob in the shader below.
+struct MorphJob {
+  uint32_t mFirstDelta;
+  uint32_t mDisplacedVertexCount;
+  uint32_t mTargetCount;
+  uint32_t mFirstWeight;
+  uint32_t mSourceVertex;
+  uint32_t mDestinationVertex;
+  uint32_t mFirstGroup;
+  uint32_t mUnused = 0;
+};
+
+struct PushConstants {
+  uint32_t mFirstGroup;
+  uint32_t mCompact;
+};
+
+// This is the minimum of maxComputeWorkGroupCount[0] which is guaranteed by Vulkan.
+const uint32_t MAX_GROUP_COUNT = 65535;
+
+const std::string MORPH_SHADER = R"(
+  #version 450
+
+  layout (local_size_x = 64) in;
+
+  struct MorphDelta {
+    vec3  mPosition;
+    uint  mVertex;
+    vec3  mNormal;
+    float mUnused;
+  };
+
+  struct MorphJob {
+    uint mFirstDelta;
+    uint mDisplacedVertexCount;
+    uint mTargetCount;
+    uint mFirstWeight;
+    uint mSourceVertex;
+    uint mDestinationVertex;
+    uint mFirstGroup;
+    uint mUnused;
+  };
+
+  layout (push_constant, std430) uniform PushConstants {
+    uint mFirstGroup;
+    uint mCompact;
+  } pushConstants;
+
+  layout (binding = 0, std430) readonly buffer Deltas    { MorphDelta deltas[]; };
+  layout (binding = 1, std430) readonly buffer Jobs      { MorphJob jobs[]; };
+  layout (binding = 2, std430) readonly buffer GroupJobs { uint groupJobs[]; };
+  layout (binding = 3, std430) readonly buffer Weights   { float weights[]; };
+  layout (binding = 4, std430)          buffer Vertices  { uint vertices[]; };
+
+  // Gltf::Vertex and Gltf::CompactVertex both start with the position, followed by the normal
+  // which is octahedron-encoded in the latter case (see GltfShaderCompact.vert).
+  vec3 decodeOctahedron(uint packed) {
+    vec2 p = unpackSnorm2x16(packed);
+    vec3 n = vec3(p, 1.0 - abs(p.x) - abs(p.y));
+    if (n.z < 0.0) {
+      n.xy = (1.0 - abs(n.yx)) * vec2(n.x >= 0.0 ? 1.0 : -1.0, n.y >= 0.0 ? 1.0 : -1.0);
+    }
+    return n;
+  }
+
+  uint encodeOctahedron(vec3 n) {
+    vec2 p = n.xy / (abs(n.x) + abs(n.y) + abs(n.z));
+    if (n.z < 0.0) {
+      p = (1.0 - abs(p.yx)) * vec2(p.x >= 0.0 ? 1.0 : -1.0, p.y >= 0.0 ? 1.0 : -1.0);
+    }
+    return packSnorm2x16(p);
+  }
+
+  void main() {
+    uint     group = pushConstants.mFirstGroup + gl_WorkGroupID.x;
+    MorphJob job   = jobs[groupJobs[group]];
+    uint     i     = (group - job.mFirstGroup) * gl_WorkGroupSize.x + gl_LocalInvocationID.x;
+
+    if (i >= job.mDisplacedVertexCount) {
+      return;
+    }
+
+    uint first  = job.mFirstDelta + i * job.mTargetCount;
+    uint vertex = deltas[first].mVertex;
+    uint stride = pushConstants.mCompact != 0 ? 5 : 20;
+    uint src    = (job.mSourceVertex + vertex) * stride;
+    uint dst    = (job.mDestinationVertex + vertex) * stride;
+
+    vec3 position = uintBitsToFloat(uvec3(vertices[src], vertices[src + 1], vertices[src + 2]));
+    vec3 normal;
+
+    if (pushConstants.mCompact != 0) {
+      normal = decodeOctahedron(vertices[src + 3]);
+    } else {
+      normal = uintBitsToFloat(uvec3(vertices[src + 3], vertices[src + 4], vertices[src + 5]));
+    }
+
+    for (uint t = 0; t < job.mTargetCount; ++t) {
+      float weight = weights[job.mFirstWeight + t];
+      position += weight * deltas[first + t].mPosition;
+      normal   += weight * deltas[first + t].mNormal;
+    }
+
+    if (dot(normal, normal) > 0.0) {
+      normal = normalize(normal);
+    }
+
+    uvec3 p = floatBitsToUint(position);
+    vertices[dst]     = p.x;
+    vertices[dst + 1] = p.y;
+    vertices[dst + 2] = p.z;
+
+    if (pushConstants.mCompact != 0) {
+      vertices[dst + 3] = dot(normal, normal) > 0.0 ? encodeOctahedron(normal) : 0u;
+    } else {
+      uvec3 n = floatBitsToUint(normal);
+      vertices[dst + 3] = n.x;
+      vertices[dst + 4] = n.y;
+      vertices[dst + 5] = n.z;
+    }
+  }
+)";
+
+uint32_t getGroupCount(uint32_t size, uint32_t groupSize) {
+  return (size + groupSize - 1) / groupSize;
+}
+
+} // namespace
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+Morpher::Morpher(DevicePtr const& device)
+    : mDevice(device)
+    , mMorphShader(Shader::create(device)) {
+
+  ILLUSION_TRACE << "Creating Gltf::Morpher." << std::endl;
+
+  mMorphShader->addModule(
+      vk::ShaderStageFlagBits::eCompute, GlslCode::create(MORPH_SHADER, "Gltf::Morpher::morph"));
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+Morpher::~Morpher() {
+  ILLUSION_TRACE << "Deleting Gltf::Morpher." << std::endl;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void Morpher::morph(CommandBuffer& cmd, Model const& model, TransientAllocator& allocator) {
+  auto const& deltas   = model.getMorphTargetBuffer();
+  auto const& vertices = model.getVertexBuffer();
+
+  if (!deltas) {
+    return;
+  }
+
+  std::vector<MorphJob> jobs;
+  std::vector<uint32_t> groupJobs;
+  std::vector<float>    weights;
+
+  // with a GeometryArena, the vertices of the Model do not start at the beginning of the buffer
+  uint32_t firstVertex = model.getFirstVertex();
+
+  for (auto const& node : model.getNodes()) {
+    if (!node->mWeightsDirty || node->mMorphVertexOffsets.empty() || !node->mMesh->mLoaded) {
+      continue;
+    }
+
+    auto const& primitives  = node->mMesh->mPrimitives;
+    auto        firstWeight = static_cast<uint32_t>(weights.size());
+
+    weights.insert(weights.end(), node->mWeights.begin(), node->mWeights.end());
+
+    for (size_t i(0); i < primitives.size(); ++i) {
+      auto const& targets = primitives[i].mMorphTargets;
+
+      if (node->mMorphVertexOffsets[i] < 0) {
+        continue;
+      }
+
+      MorphJob job;
+      job.mFirstDelta           = targets.mFirstDelta;
+      job.mDisplacedVertexCount = targets.mDisplacedVertexCount;
+      job.mTargetCount          = targets.mTargetCount;
+      job.mFirstWeight          = firstWeight;
+      job.mSourceVertex         = firstVertex + static_cast<uint32_t>(primitives[i].mVertexOffset);
+      job.mDestinationVertex    = firstVertex + static_cast<uint32_t>(node->mMorphVertexOffsets[i]);
+      job.mFirstGroup           = static_cast<uint32_t>(groupJobs.size());
+
+      groupJobs.resize(groupJobs.size() + getGroupCount(targets.mDisplacedVertexCount, 64),
+          static_cast<uint32_t>(jobs.size()));
+      jobs.push_back(job);
+    }
+
+    node->mWeightsDirty = false;
+  }
+
+  if (jobs.empty()) {
+    return;
+  }
+
+  auto jobData      = allocator.addData(
+      reinterpret_cast<uint8_t const*>(jobs.data()), sizeof(MorphJob) * jobs.size());
+  auto groupJobData = allocator.addData(
+      reinterpret_cast<uint8_t const*>(groupJobs.data()), sizeof(uint32_t) * groupJobs.size());
+  auto weightData   = allocator.addData(
+      reinterpret_cast<uint8_t const*>(weights.data()), sizeof(float) * weights.size());
+
+  // the vertex buffer has been read by the previous frames, this is not tracked by the
+  // CommandBuffer; declaring it here makes the dispatch wait for them
+  cmd.accessBuffer(vertices, vk::PipelineStageFlagBits::eVertexInput,
+      vk::AccessFlagBits::eVertexAttributeRead);
+
+  cmd.setShader(mMorphShader);
+  cmd.bindingState().setStorageBuffer(deltas, deltas->mBufferInfo.size, 0, 0, 0);
+  cmd.bindingState().setStorageBuffer(jobData.mBuffer, jobData.mSize, jobData.mOffset, 0, 1);
+  cmd.bindingState().setStorageBuffer(
+      groupJobData.mBuffer, groupJobData.mSize, groupJobData.mOffset, 0, 2);
+  cmd.bindingState().setStorageBuffer(
+      weightData.mBuffer, weightData.mSize, weightData.mOffset, 0, 3);
+  cmd.bindingState().setStorageBuffer(vertices, vertices->mBufferInfo.size, 0, 0, 4);
+
+  PushConstants constants;
+  constants.mCompact = model.getVertexLayout() == VertexLayout::eDefault ? 0 : 1;
+
+  auto groupCount = static_cast<uint32_t>(groupJobs.size());
+
+  for (uint32_t first(0); first < groupCount; first += MAX_GROUP_COUNT) {
+    constants.mFirstGroup = first;
+    cmd.pushConstants(constants);
+    cmd.dispatch(std::min(groupCount - first, MAX_GROUP_COUNT));
+  }
+
+  cmd.accessBuffer(vertices, vk::PipelineStageFlagBits::eVertexInput,
+      vk::AccessFlagBits::eVertexAttributeRead);
+
+  cmd.bindingState().reset(0);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+} // namespace Illusion::Graphics::Gltf
@@ -0,0 +1,55 @@
+////////////////////////////////////////////////////////////////////////////////////////////////////
+//                                                                                                //
+//    _)  |  |            _)                This code may be used and modified under the terms    //
+//     |  |  |  |  | (_-<  |   _ \    \     of the MIT license. See the LICENSE file for details. //
+//    _| _| _| \_,_| ___/ _| \___/ _| _|    Copyright (c) 2018-2019 Simon Schneegans              //
+//                                                                                                //
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#ifndef ILLUSION_GRAPHICS_GLTF_MORPHER_HPP
+#define ILLUSION_GRAPHICS_GLTF_MORPHER_HPP
+
+#include "fwd.hpp"
+
+namespace Illusion::Graphics::Gltf {
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// The Morpher applies the morph targets of Gltf::Models on the GPU. For each Node whose weights  //
+// have changed, a compute shader adds the weighted Primitive::MorphDeltas to the original        //
+// positions and normals of the displaced vertices and writes the results to the morphed copy of  //
+// the Node in the vertex buffer of the Model. All Nodes of a Model are processed with one        //
+// dispatch; vertices which are not displaced by any target are never touched. As the vertices    //
+// are morphed before the vertex shader runs, this works together with Skins.                     //
+// The morphed copies are shared by all frames in flight, hence the dispatch waits until the      //
+// vertex input of previously submitted frames has been finished.                                 //
+// morph() records compute dispatches, hence it has to be called outside of RenderPasses. It      //
+// changes the current Shader of the CommandBuffer and resets the bindings of descriptor set 0.   //
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+class Morpher {
+
+ public:
+  // Syntactic sugar to create a std::shared_ptr for this class
+  template <typename... Args>
+  static MorpherPtr create(Args&&... args) {
+    return std::make_shared<Morpher>(args...);
+  };
+
+  explicit Morpher(DevicePtr const& device);
+  virtual ~Morpher();
+
+  // Updates the morphed vertices of all Nodes of the given Model whose mWeightsDirty is set and
+  // whose Mesh has been loaded; mWeightsDirty is reset afterwards. The weights are written to the
+  // given TransientAllocator, which therefore needs eStorageBuffer usage. The barriers required
+  // for reading the vertex buffer are pending afterwards and are recorded by the next
+  // beginRenderPass().
+  void morph(CommandBuffer& cmd, Model const& model, TransientAllocator& allocator);
+
+ private:
+  DevicePtr mDevice;
+  ShaderPtr mMorphShader;
+};
+
+} // namespace Illusion::Graphics::Gltf
+
+#endif // ILLUSION_GRAPHICS_GLTF_MORPHER_HPP
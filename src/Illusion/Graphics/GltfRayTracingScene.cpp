@@ -0,0 +1,395 @@
+////////////////////////////////////////////////////////////////////////////////////////////////////
+//                                                                                                //
+//    _)  |  |            _)                This code may be used and modified under the terms    //
+//     |  |  |  |  | (_-<  |   _ \    \     of the MIT license. See the LICENSE file for details. //
+//    _| _| _| \_,_| ___/ _| \___/ _| _|    Copyright (c) 2018-2019 Simon Schneegans              //
+//                                                                                                //
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include "GltfRayTracingScene.hpp"
+
+#include "../Core/Logger.hpp"
+#include "AccelerationStructure.hpp"
+#include "BackedBuffer.hpp"
+#include "CommandBuffer.hpp"
+#include "Device.hpp"
+#include "PhysicalDevice.hpp"
+
+#include <iostream>
+
+namespace Illusion::Graphics::Gltf {
+
+namespace {
+
+// Only Primitives drawn as triangle lists can be put into bottom-level structures.
+bool isIncluded(Primitive const& primitive) {
+  return primitive.mTopology == vk::PrimitiveTopology::eTriangleList &&
+         primitive.mIndexCount >= 3;
+}
+
+// The scratch buffer has to be larger than required, as CommandBuffer::buildAccelerationStructure()
+// aligns its address.
+BackedBufferPtr createScratchBuffer(DevicePtr const& device, vk::DeviceSize size) {
+  auto alignment = device->getPhysicalDevice()
+                       ->getAccelerationStructureProperties()
+                       .minAccelerationStructureScratchOffsetAlignment;
+
+  return device->createBackedBuffer(
+      vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eShaderDeviceAddress,
+      vk::MemoryPropertyFlagBits::eDeviceLocal, size + alignment);
+}
+
+} // namespace
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+RayTracingScene::RayTracingScene(DevicePtr const& device, ModelPtr const& model)
+    : mDevice(device)
+    , mModel(model) {
+
+  ILLUSION_TRACE << "Creating Gltf::RayTracingScene." << std::endl;
+
+  if (!mDevice->getPhysicalDevice()->supportsRayQueries()) {
+    throw std::runtime_error(
+        "Failed to create Gltf::RayTracingScene: VK_KHR_ray_query is not supported!");
+  }
+
+  // the Primitives of all Meshes are known before their vertex data has been loaded, so the
+  // Geometries of each Mesh can be assigned a fixed range of the geometry buffer
+  uint32_t geometryCount = 0;
+
+  for (auto const& mesh : mModel->getMeshes()) {
+    MeshData data;
+    data.mFirstGeometry = geometryCount;
+
+    for (auto const& primitive : mesh->mPrimitives) {
+      if (isIncluded(primitive)) {
+        ++data.mGeometryCount;
+      }
+    }
+
+    geometryCount += data.mGeometryCount;
+    mMeshes.push_back(data);
+  }
+
+  mGeometryBuffer = mDevice->createBackedBuffer(
+      vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eTransferDst,
+      vk::MemoryPropertyFlagBits::eDeviceLocal,
+      std::max(geometryCount, 1u) * sizeof(Geometry));
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+RayTracingScene::~RayTracingScene() {
+  ILLUSION_TRACE << "Deleting Gltf::RayTracingScene." << std::endl;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+ModelPtr const& RayTracingScene::getModel() const {
+  return mModel;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void RayTracingScene::update(CommandBuffer& cmd, glm::mat4 const& modelMatrix, bool allowRefit) {
+  compactBottomLevels(cmd);
+  buildBottomLevels(cmd);
+  buildTopLevel(cmd, nullptr, modelMatrix, allowRefit);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void RayTracingScene::update(CommandBuffer& cmd, std::vector<glm::mat4> const& globalTransforms,
+    glm::mat4 const& modelMatrix, bool allowRefit) {
+
+  if (globalTransforms.size() != mModel->getHierarchy().size()) {
+    throw std::runtime_error("Failed to update Gltf::RayTracingScene: The number of global "
+                             "transformations does not match the number of Nodes!");
+  }
+
+  compactBottomLevels(cmd);
+  buildBottomLevels(cmd);
+  buildTopLevel(cmd, &globalTransforms, modelMatrix, allowRefit);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void RayTracingScene::bind(CommandBuffer& cmd, uint32_t set, uint32_t firstBinding) const {
+  cmd.bindingState().setAccelerationStructure(mTopLevel, set, firstBinding);
+  cmd.bindingState().setStorageBuffer(
+      mGeometryBuffer, mGeometryBuffer->mBufferInfo.size, 0, set, firstBinding + 1);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+AccelerationStructurePtr const& RayTracingScene::getTopLevel() const {
+  return mTopLevel;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+AccelerationStructurePtr const& RayTracingScene::getBottomLevel(Mesh const& mesh) const {
+  return mMeshes.at(mModel->getIndex(mesh)).mBottomLevel;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+BackedBufferPtr const& RayTracingScene::getGeometryBuffer() const {
+  return mGeometryBuffer;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void RayTracingScene::buildBottomLevels(CommandBuffer& cmd) {
+  auto const& meshes       = mModel->getMeshes();
+  auto const& vertexBuffer = mModel->getVertexBuffer();
+  auto const& indexBuffer  = mModel->getIndexBuffer();
+
+  // the position is the first member of both vertex layouts
+  vk::DeviceSize vertexSize = mModel->getVertexLayout() == VertexLayout::eDefault
+                                  ? sizeof(Vertex)
+                                  : sizeof(CompactVertex);
+  vk::DeviceSize indexSize = mModel->getIndexType() == vk::IndexType::eUint16 ? 2 : 4;
+
+  Compaction compaction;
+
+  for (uint32_t m(0); m < mMeshes.size(); ++m) {
+    auto& data = mMeshes[m];
+
+    if (data.mBottomLevel || data.mGeometryCount == 0 || !meshes[m]->mLoaded) {
+      continue;
+    }
+
+    std::vector<vk::AccelerationStructureGeometryKHR>       geometries;
+    std::vector<vk::AccelerationStructureBuildRangeInfoKHR> ranges;
+    std::vector<uint32_t>                                   primitiveCounts;
+    std::vector<Geometry>                                   entries;
+
+    for (auto const& primitive : meshes[m]->mPrimitives) {
+      if (!isIncluded(primitive)) {
+        continue;
+      }
+
+      vk::AccelerationStructureGeometryTrianglesDataKHR triangles;
+      triangles.vertexFormat             = vk::Format::eR32G32B32Sfloat;
+      triangles.vertexData.deviceAddress = mDevice->getBufferDeviceAddress(vertexBuffer);
+      triangles.vertexStride             = vertexSize;
+      triangles.maxVertex =
+          static_cast<uint32_t>(vertexBuffer->mBufferInfo.size / vertexSize - 1);
+      triangles.indexType               = mModel->getIndexType();
+      triangles.indexData.deviceAddress = mDevice->getBufferDeviceAddress(indexBuffer);
+
+      // hits of transparent and alpha-tested surfaces may have to be rejected by the shader
+      auto const& material = *primitive.mMaterial;
+      bool        opaque   = !material.mDoAlphaBlending &&
+                    (material.mAlphaCutoff <= 0.f || material.mAlphaCutoff >= 1.f);
+
+      vk::AccelerationStructureGeometryKHR geometry;
+      geometry.geometryType       = vk::GeometryTypeKHR::eTriangles;
+      geometry.geometry.triangles = triangles;
+      geometry.flags              = opaque ? vk::GeometryFlagBitsKHR::eOpaque
+                                           : vk::GeometryFlagBitsKHR::eNoDuplicateAnyHitInvocation;
+      geometries.push_back(geometry);
+
+      vk::AccelerationStructureBuildRangeInfoKHR range;
+      range.primitiveCount  = static_cast<uint32_t>(primitive.mIndexCount / 3);
+      range.primitiveOffset = static_cast<uint32_t>(
+          (mModel->getFirstIndex() + primitive.mIndexOffset) * indexSize);
+      range.firstVertex = mModel->getFirstVertex() + primitive.mVertexOffset;
+      ranges.push_back(range);
+      primitiveCounts.push_back(range.primitiveCount);
+
+      Geometry entry;
+      entry.mMaterialIndex    = static_cast<int32_t>(mModel->getIndex(material));
+      entry.mFirstIndex       = primitive.mIndexOffset;
+      entry.mVertexOffset     = primitive.mVertexOffset;
+      entry.mVertexAttributes = static_cast<int32_t>(primitive.mVertexAttributes);
+      entries.push_back(entry);
+    }
+
+    vk::AccelerationStructureBuildGeometryInfoKHR info;
+    info.type  = vk::AccelerationStructureTypeKHR::eBottomLevel;
+    info.mode  = vk::BuildAccelerationStructureModeKHR::eBuild;
+    info.flags = vk::BuildAccelerationStructureFlagBitsKHR::ePreferFastTrace |
+                 vk::BuildAccelerationStructureFlagBitsKHR::eAllowCompaction;
+
+    info.geometryCount = static_cast<uint32_t>(geometries.size());
+    info.pGeometries   = geometries.data();
+
+    auto sizes = mDevice->getAccelerationStructureBuildSizes(info, primitiveCounts);
+
+    data.mBottomLevel = mDevice->createAccelerationStructure(
+        vk::AccelerationStructureTypeKHR::eBottomLevel, sizes.accelerationStructureSize);
+
+    cmd.buildAccelerationStructure(data.mBottomLevel, info, ranges, {vertexBuffer, indexBuffer},
+        createScratchBuffer(mDevice, sizes.buildScratchSize));
+
+    // the Geometries of the Mesh are not referenced by any instance yet, so the geometry buffer
+    // can be written while older top-level structures are still in use
+    vk::DeviceSize entriesSize = entries.size() * sizeof(Geometry);
+    auto           staging     = mDevice->createBackedBuffer(vk::BufferUsageFlagBits::eTransferSrc,
+        vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent,
+        entriesSize, entries.data());
+    cmd.copyBuffer(staging, mGeometryBuffer,
+        {vk::BufferCopy(0, data.mFirstGeometry * sizeof(Geometry), entriesSize)});
+
+    compaction.mMeshes.push_back(m);
+  }
+
+  if (compaction.mMeshes.empty()) {
+    return;
+  }
+
+  // the compacted sizes are read back by a later update(), once this CommandBuffer has finished
+  auto count = static_cast<uint32_t>(compaction.mMeshes.size());
+
+  vk::QueryPoolCreateInfo info;
+  info.queryType   = vk::QueryType::eAccelerationStructureCompactedSizeKHR;
+  info.queryCount  = count;
+  compaction.mPool = mDevice->createQueryPool(info);
+
+  cmd.resetQueryPool(compaction.mPool, 0, count);
+
+  for (uint32_t i(0); i < count; ++i) {
+    cmd.writeCompactedSize(mMeshes[compaction.mMeshes[i]].mBottomLevel, compaction.mPool, i);
+  }
+
+  mCompactions.push_back(std::move(compaction));
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void RayTracingScene::compactBottomLevels(CommandBuffer& cmd) {
+  for (auto compaction = mCompactions.begin(); compaction != mCompactions.end();) {
+    std::vector<vk::DeviceSize> sizes(compaction->mMeshes.size());
+
+    auto result = mDevice->getHandle()->getQueryPoolResults(*compaction->mPool, 0,
+        static_cast<uint32_t>(sizes.size()), sizes.size() * sizeof(vk::DeviceSize), sizes.data(),
+        sizeof(vk::DeviceSize), vk::QueryResultFlagBits::e64);
+
+    if (result == vk::Result::eNotReady) {
+      ++compaction;
+      continue;
+    }
+
+    // if the sizes cannot be read, the structures are simply kept as they are
+    if (result == vk::Result::eSuccess) {
+      for (size_t i(0); i < sizes.size(); ++i) {
+        auto& bottomLevel = mMeshes[compaction->mMeshes[i]].mBottomLevel;
+        auto  compacted   = mDevice->createAccelerationStructure(
+            vk::AccelerationStructureTypeKHR::eBottomLevel, sizes[i]);
+
+        // the old structure may still be referenced by the top-level structures of frames in
+        // flight, its destruction is deferred by the DeletionQueue
+        cmd.copyAccelerationStructure(
+            bottomLevel, compacted, vk::CopyAccelerationStructureModeKHR::eCompact);
+        bottomLevel = compacted;
+      }
+    }
+
+    compaction = mCompactions.erase(compaction);
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void RayTracingScene::buildTopLevel(CommandBuffer& cmd,
+    std::vector<glm::mat4> const* globalTransforms, glm::mat4 const& modelMatrix,
+    bool allowRefit) {
+
+  std::vector<vk::AccelerationStructureInstanceKHR> instances;
+  std::vector<vk::DeviceAddress>                    references;
+
+  for (Node const* node : mModel->getHierarchy()) {
+    if (!node->mMesh) {
+      continue;
+    }
+
+    auto const& data = mMeshes[mModel->getIndex(*node->mMesh)];
+
+    if (!data.mBottomLevel) {
+      continue;
+    }
+
+    glm::mat4 transform =
+        modelMatrix * (globalTransforms ? (*globalTransforms)[node->mHierarchyIndex]
+                                        : node->mGlobalTransform);
+
+    // the instances store the upper three rows of the matrix in row-major order
+    vk::TransformMatrixKHR matrix;
+    for (int row(0); row < 3; ++row) {
+      for (int column(0); column < 4; ++column) {
+        matrix.matrix[row][column] = transform[column][row];
+      }
+    }
+
+    vk::AccelerationStructureInstanceKHR instance;
+    instance.setTransform(matrix);
+    instance.setInstanceCustomIndex(data.mFirstGeometry);
+    instance.setMask(0xFF);
+    instance.setInstanceShaderBindingTableRecordOffset(0);
+    instance.setFlags(VK_GEOMETRY_INSTANCE_TRIANGLE_FACING_CULL_DISABLE_BIT_KHR);
+    instance.setAccelerationStructureReference(data.mBottomLevel->mDeviceAddress);
+    instances.push_back(instance);
+
+    references.push_back(data.mBottomLevel->mDeviceAddress);
+  }
+
+  // the instances are written to a new buffer each time, as the previous one may still be read by
+  // frames in flight
+  auto instanceBuffer = mDevice->createBackedBuffer(
+      vk::BufferUsageFlagBits::eShaderDeviceAddress |
+          vk::BufferUsageFlagBits::eAccelerationStructureBuildInputReadOnlyKHR,
+      vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent,
+      std::max<size_t>(instances.size(), 1) * sizeof(vk::AccelerationStructureInstanceKHR),
+      instances.data());
+
+  // refitting is only possible if the instances reference the same bottom-level structures
+  bool refit = allowRefit && mTopLevel && references == mTopLevelReferences;
+
+  vk::AccelerationStructureGeometryInstancesDataKHR instancesData;
+  instancesData.arrayOfPointers    = false;
+  instancesData.data.deviceAddress = mDevice->getBufferDeviceAddress(instanceBuffer);
+
+  vk::AccelerationStructureGeometryKHR geometry;
+  geometry.geometryType       = vk::GeometryTypeKHR::eInstances;
+  geometry.geometry.instances = instancesData;
+
+  vk::AccelerationStructureBuildGeometryInfoKHR info;
+  info.type  = vk::AccelerationStructureTypeKHR::eTopLevel;
+  info.mode  = refit ? vk::BuildAccelerationStructureModeKHR::eUpdate
+                     : vk::BuildAccelerationStructureModeKHR::eBuild;
+  info.flags = vk::BuildAccelerationStructureFlagBitsKHR::ePreferFastTrace |
+               vk::BuildAccelerationStructureFlagBitsKHR::eAllowUpdate;
+
+  info.geometryCount = 1;
+  info.pGeometries   = &geometry;
+
+  vk::AccelerationStructureBuildRangeInfoKHR range;
+  range.primitiveCount = static_cast<uint32_t>(instances.size());
+
+  auto sizes = mDevice->getAccelerationStructureBuildSizes(info, {range.primitiveCount});
+
+  // the bottom-level structures are read by the build
+  std::vector<BackedBufferPtr> inputs = {instanceBuffer};
+  for (auto const& data : mMeshes) {
+    if (data.mBottomLevel) {
+      inputs.push_back(data.mBottomLevel->mBuffer);
+    }
+  }
+
+  auto topLevel = mDevice->createAccelerationStructure(
+      vk::AccelerationStructureTypeKHR::eTopLevel, sizes.accelerationStructureSize);
+
+  cmd.buildAccelerationStructure(topLevel, info, {range}, inputs,
+      createScratchBuffer(mDevice, refit ? sizes.updateScratchSize : sizes.buildScratchSize),
+      refit ? mTopLevel : nullptr);
+
+  mTopLevel           = topLevel;
+  mTopLevelReferences = std::move(references);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+} // namespace Illusion::Graphics::Gltf
@@ -0,0 +1,122 @@
+////////////////////////////////////////////////////////////////////////////////////////////////////
+//                                                                                                //
+//    _)  |  |            _)                This code may be used and modified under the terms    //
+//     |  |  |  |  | (_-<  |   _ \    \     of the MIT license. See the LICENSE file for details. //
+//    _| _| _| \_,_| ___/ _| \___/ _| _|    Copyright (c) 2018-2019 Simon Schneegans              //
+//                                                                                                //
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#ifndef ILLUSION_GRAPHICS_GLTF_RAY_TRACING_SCENE_HPP
+#define ILLUSION_GRAPHICS_GLTF_RAY_TRACING_SCENE_HPP
+
+#include "GltfModel.hpp"
+
+namespace Illusion::Graphics::Gltf {
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// The RayTracingScene contains the AccelerationStructures of a Gltf::Model, so that shaders can  //
+// trace rays against it with ray queries (GL_EXT_ray_query). There is one bottom-level structure //
+// per Mesh which contains one geometry for each of its Primitives drawn as a triangle list; it   //
+// is built once the vertex data of the Mesh has been loaded, directly from the vertex and index  //
+// buffers of the Model. Afterwards, it is compacted as soon as its compacted size is known. The  //
+// top-level structure contains one instance for each Node of the default scene which has a Mesh. //
+// It is rebuilt by each update(); if the instances did not change, it is refitted instead. The   //
+// instanceCustomIndex of each instance is the index of the first Geometry of its Mesh in         //
+// getGeometryBuffer(), the geometry index of a hit has to be added to this. Skinned and morphed  //
+// Primitives are contained in their rest pose. Transparent Primitives and those with an alpha    //
+// cutoff are not marked as opaque, so that their hits can be rejected in the shader. This        //
+// requires ray query support, see PhysicalDevice::supportsRayQueries().                          //
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+class RayTracingScene {
+
+ public:
+  // The layout of this struct matches the std430 layout of a corresponding GLSL struct. The index
+  // and vertex offsets are relative to Model::getFirstIndex() and Model::getFirstVertex().
+  struct Geometry {
+    int32_t  mMaterialIndex;    // index of the Material in Model::getMaterialBuffer()
+    uint32_t mFirstIndex;       // the first index of the Primitive in the index buffer
+    int32_t  mVertexOffset;     // the same as Primitive::mVertexOffset
+    int32_t  mVertexAttributes; // the same as Primitive::mVertexAttributes
+  };
+
+  // Syntactic sugar to create a std::shared_ptr for this class
+  template <typename... Args>
+  static RayTracingScenePtr create(Args&&... args) {
+    return std::make_shared<RayTracingScene>(args...);
+  };
+
+  // A std::runtime_error is thrown if the PhysicalDevice does not support ray queries. The Model
+  // has to be loaded with this Device after ray query support has been detected, so that its
+  // buffers can be used as build inputs.
+  RayTracingScene(DevicePtr const& device, ModelPtr const& model);
+  virtual ~RayTracingScene();
+
+  ModelPtr const& getModel() const;
+
+  // Builds the bottom-level structures of all Meshes which have been loaded since the last call,
+  // compacts those whose compacted sizes are available and builds the top-level structure for the
+  // current Node::mGlobalTransform of the Nodes. The second version uses the given global
+  // transformations (in the order of Model::getHierarchy()) instead, for example those of
+  // ModelInstance::getGlobalTransforms(). The modelMatrix is applied to all instances. If
+  // allowRefit is false, the top-level structure is always built from scratch; refitting is much
+  // faster but the quality of the tree degrades if the Nodes move a lot. This has to be called
+  // outside of RenderPasses. The previous structures are not modified, so they can still be used
+  // by frames in flight.
+  void update(
+      CommandBuffer& cmd, glm::mat4 const& modelMatrix = glm::mat4(1.f), bool allowRefit = true);
+  void update(CommandBuffer& cmd, std::vector<glm::mat4> const& globalTransforms,
+      glm::mat4 const& modelMatrix = glm::mat4(1.f), bool allowRefit = true);
+
+  // Binds the top-level structure of the last update() and the geometry buffer to two consecutive
+  // bindings of the given descriptor set, starting at firstBinding. Inside of RenderPasses, the
+  // buffers have to be declared with CommandBuffer::accessBuffer() before.
+  void bind(CommandBuffer& cmd, uint32_t set, uint32_t firstBinding) const;
+
+  // The top-level structure of the last update(), nullptr before the first one.
+  AccelerationStructurePtr const& getTopLevel() const;
+
+  // The bottom-level structure of the given Mesh; nullptr if it has not been built yet.
+  AccelerationStructurePtr const& getBottomLevel(Mesh const& mesh) const;
+
+  // Contains one Geometry for each Primitive in the bottom-level structures. The Geometries of a
+  // Mesh are consecutive; they are written when its bottom-level structure is built. It has
+  // vk::BufferUsageFlagBits::eStorageBuffer usage.
+  BackedBufferPtr const& getGeometryBuffer() const;
+
+ private:
+  // The bottom-level structures of all Meshes which have been built with one CommandBuffer. Their
+  // compacted sizes are written to consecutive queries of mPool.
+  struct Compaction {
+    vk::QueryPoolPtr      mPool;
+    std::vector<uint32_t> mMeshes;
+  };
+
+  struct MeshData {
+    AccelerationStructurePtr mBottomLevel;
+    uint32_t                 mFirstGeometry = 0;
+    uint32_t                 mGeometryCount = 0;
+  };
+
+  void buildBottomLevels(CommandBuffer& cmd);
+  void compactBottomLevels(CommandBuffer& cmd);
+  void buildTopLevel(CommandBuffer& cmd, std::vector<glm::mat4> const* globalTransforms,
+      glm::mat4 const& modelMatrix, bool allowRefit);
+
+  DevicePtr mDevice;
+  ModelPtr  mModel;
+
+  std::vector<MeshData>   mMeshes;
+  std::vector<Compaction> mCompactions;
+  BackedBufferPtr         mGeometryBuffer;
+
+  AccelerationStructurePtr mTopLevel;
+
+  // The bottom-level structures referenced by the instances of mTopLevel. It can only be refitted
+  // if they did not change.
+  std::vector<vk::DeviceAddress> mTopLevelReferences;
+};
+
+} // namespace Illusion::Graphics::Gltf
+
+#endif // ILLUSION_GRAPHICS_GLTF_RAY_TRACING_SCENE_HPP
@@ -0,0 +1,564 @@
+////////////////////////////////////////////////////////////////////////////////////////////////////
+//                                                                                                //
+//    _)  |  |            _)                This code may be used and modified under the terms    //
+//     |  |  |  |  | (_-<  |   _ \    \     of the MIT license. See the LICENSE file for details. //
+//    _| _| _| \_,_| ___/ _| \___/ _| _|    Copyright (c) 2018-2019 Simon Schneegans              //
+//                                                                                                //
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include "GltfShadowMap.hpp"
+
+#include "../Core/Logger.hpp"
+#include "CommandBuffer.hpp"
+#include "Device.hpp"
+#include "GltfModel.hpp"
+#include "RenderPass.hpp"
+#include "Shader.hpp"
+#include "ShaderSource.hpp"
+#include "Texture.hpp"
+
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <cmath>
+#include <iostream>
+
+namespace Illusion::Graphics::Gltf {
+
+namespace {
+
+// This matches the std140 layout of the ShadowUniforms in the shaders below and in
+// CascadedShadows.glsl.
+struct ShadowUniforms {
+  glm::mat4 mViewProjections[ShadowMap::MAX_CASCADES];
+  glm::vec4 mSplits;         // the view space depth where each cascade ends
+  glm::vec4 mLightDirection; // w: number of cascades
+  uint32_t  mDrawCount;
+};
+
+// The weight of the logarithmic split scheme, the uniform scheme gets the rest.
+const float SPLIT_LAMBDA = 0.75f;
+
+const std::string CULL_SHADER = R"(
+  #version 450
+
+  layout (local_size_x = 64) in;
+
+  struct DrawCommand {
+    uint indexCount;
+    uint instanceCount;
+    uint firstIndex;
+    int  vertexOffset;
+    uint firstInstance;
+  };
+
+  struct Bounds {
+    vec3 mMin;
+    uint mBatch;
+    vec3 mMax;
+    uint mBatchFirstDraw;
+  };
+
+  layout (binding = 0) uniform ShadowUniforms {
+    mat4 mViewProjections[4];
+    vec4 mSplits;
+    vec4 mLightDirection;
+    uint mDrawCount;
+  } uniforms;
+
+  layout (binding = 1, std430) readonly  buffer InputCommands  { DrawCommand inputCommands[]; };
+  layout (binding = 2, std430) readonly  buffer InputBounds    { Bounds bounds[]; };
+  layout (binding = 3, std430) writeonly buffer OutputCommands { DrawCommand outputCommands[]; };
+  layout (binding = 4, std430) writeonly buffer CascadeMasks   { uint cascadeMasks[]; };
+
+  vec3 getCorner(Bounds b, int i) {
+    return mix(b.mMin, b.mMax, vec3(i & 1, (i >> 1) & 1, (i >> 2) & 1));
+  }
+
+  // The projections are orthographic, so w is always one. The near planes are in front of the
+  // whole scene, hence they are not tested.
+  bool isInCascade(Bounds b, uint cascade) {
+    int outside[5] = int[5](0, 0, 0, 0, 0);
+
+    for (int i = 0; i < 8; ++i) {
+      vec3 p = (uniforms.mViewProjections[cascade] * vec4(getCorner(b, i), 1.0)).xyz;
+      outside[0] += int(p.x < -1.0);
+      outside[1] += int(p.x >  1.0);
+      outside[2] += int(p.y < -1.0);
+      outside[3] += int(p.y >  1.0);
+      outside[4] += int(p.z >  1.0);
+    }
+
+    for (int i = 0; i < 5; ++i) {
+      if (outside[i] == 8) {
+        return false;
+      }
+    }
+
+    return true;
+  }
+
+  void main() {
+    uint i = gl_GlobalInvocationID.x;
+
+    if (i >= uniforms.mDrawCount) {
+      return;
+    }
+
+    DrawCommand command = inputCommands[i];
+    Bounds      b       = bounds[i];
+
+    // skinned and morphed draws have empty bounds, they are rendered to all cascades
+    bool empty        = any(greaterThan(b.mMin, b.mMax));
+    uint cascadeCount = uint(uniforms.mLightDirection.w);
+    uint mask         = 0;
+
+    for (uint c = 0; c < cascadeCount; ++c) {
+      if (empty || isInCascade(b, c)) {
+        mask |= 1u << c;
+      }
+    }
+
+    for (uint j = 0; j < command.instanceCount; ++j) {
+      cascadeMasks[command.firstInstance + j] = mask;
+    }
+
+    if (mask == 0) {
+      command.instanceCount = 0;
+    }
+
+    outputCommands[i] = command;
+  }
+)";
+
+// COMPACT_VERTICES is defined for the compact VertexLayouts, their joints are integers.
+const std::string VERTEX_SHADER = R"(
+  #version 450
+
+  layout(location = 0) in vec3 inPosition;
+  layout(location = 4) in vec4 inWeight;
+
+  #ifdef COMPACT_VERTICES
+  layout(location = 3) in uvec4 inJoint;
+  #else
+  layout(location = 3) in vec4 inJoint;
+  #endif
+
+  // This matches the Gltf::DrawList::Instance struct.
+  struct Instance {
+    mat4 mModelMatrix;
+    int  mMaterialIndex;
+    int  mVertexAttributes;
+    int  mJointOffset;
+    int  mPadding;
+  };
+
+  layout(binding = 2, std430) readonly buffer Instances     { Instance instances[]; };
+  layout(binding = 3, std430) readonly buffer JointMatrices { mat4 jointMatrices[]; };
+
+  layout(location = 0) out vec3 vPosition;
+  layout(location = 1) flat out uint vInstance;
+
+  void main() {
+    Instance instance    = instances[gl_InstanceIndex];
+    mat4     modelMatrix = instance.mModelMatrix;
+
+    // this is Gltf::Primitive::VertexAttributeBits::eSkins
+    if ((instance.mVertexAttributes & 4) != 0) {
+      ivec4 joint = ivec4(inJoint) + instance.mJointOffset;
+      modelMatrix = modelMatrix * (inWeight.x * jointMatrices[joint.x] +
+                                   inWeight.y * jointMatrices[joint.y] +
+                                   inWeight.z * jointMatrices[joint.z] +
+                                   inWeight.w * jointMatrices[joint.w]);
+    }
+
+    vPosition = (modelMatrix * vec4(inPosition, 1.0)).xyz;
+    vInstance = gl_InstanceIndex;
+  }
+)";
+
+// There is one invocation for each cascade. Each triangle is only emitted to the layers of the
+// cascades which contain its draw and which it overlaps.
+const std::string GEOMETRY_SHADER = R"(
+  #version 450
+
+  layout(triangles, invocations = 4) in;
+  layout(triangle_strip, max_vertices = 3) out;
+
+  layout (binding = 0) uniform ShadowUniforms {
+    mat4 mViewProjections[4];
+    vec4 mSplits;
+    vec4 mLightDirection;
+    uint mDrawCount;
+  } uniforms;
+
+  layout (binding = 1, std430) readonly buffer CascadeMasks { uint cascadeMasks[]; };
+
+  layout(location = 0) in vec3 vPosition[];
+  layout(location = 1) flat in uint vInstance[];
+
+  void main() {
+    uint cascade = uint(gl_InvocationID);
+
+    if (cascade >= uint(uniforms.mLightDirection.w) ||
+        (cascadeMasks[vInstance[0]] & (1u << cascade)) == 0) {
+      return;
+    }
+
+    vec4 p[3];
+    for (int i = 0; i < 3; ++i) {
+      p[i] = uniforms.mViewProjections[cascade] * vec4(vPosition[i], 1.0);
+    }
+
+    vec3 x = vec3(p[0].x, p[1].x, p[2].x);
+    vec3 y = vec3(p[0].y, p[1].y, p[2].y);
+
+    if (all(lessThan(x, vec3(-1.0))) || all(greaterThan(x, vec3(1.0))) ||
+        all(lessThan(y, vec3(-1.0))) || all(greaterThan(y, vec3(1.0)))) {
+      return;
+    }
+
+    for (int i = 0; i < 3; ++i) {
+      gl_Position = p[i];
+      gl_Layer    = int(cascade);
+      EmitVertex();
+    }
+
+    EndPrimitive();
+  }
+)";
+
+uint32_t getGroupCount(uint32_t size, uint32_t groupSize) {
+  return (size + groupSize - 1) / groupSize;
+}
+
+} // namespace
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+ShadowMap::ShadowMap(DevicePtr const& device, uint32_t resolution, uint32_t cascadeCount)
+    : mDevice(device)
+    , mResolution(resolution)
+    , mCascadeCount(cascadeCount)
+    , mCullShader(Shader::create(device))
+    , mShadowShader(Shader::create(device))
+    , mCompactShadowShader(Shader::create(device))
+    , mRenderPass(RenderPass::create(device)) {
+
+  ILLUSION_TRACE << "Creating Gltf::ShadowMap." << std::endl;
+
+  if (mCascadeCount == 0 || mCascadeCount > MAX_CASCADES) {
+    throw std::runtime_error("Failed to create Gltf::ShadowMap: The number of cascades has to be "
+                             "between 1 and " +
+                             std::to_string(MAX_CASCADES) + "!");
+  }
+
+  if (!mDevice->getEnabledFeatures().geometryShader) {
+    throw std::runtime_error(
+        "Failed to create Gltf::ShadowMap: The geometryShader feature is not supported!");
+  }
+
+  mCullShader->addModule(
+      vk::ShaderStageFlagBits::eCompute, GlslCode::create(CULL_SHADER, "Gltf::ShadowMap::cull"));
+
+  mShadowShader->addModule(vk::ShaderStageFlagBits::eVertex,
+      GlslCode::create(VERTEX_SHADER, "Gltf::ShadowMap::vertex"));
+  mShadowShader->addModule(vk::ShaderStageFlagBits::eGeometry,
+      GlslCode::create(GEOMETRY_SHADER, "Gltf::ShadowMap::geometry"));
+
+  mCompactShadowShader->addModule(vk::ShaderStageFlagBits::eVertex,
+      GlslCode::create(VERTEX_SHADER, "Gltf::ShadowMap::compactVertex",
+          std::set<std::string>{"COMPACT_VERTICES"}));
+  mCompactShadowShader->addModule(vk::ShaderStageFlagBits::eGeometry,
+      GlslCode::create(GEOMETRY_SHADER, "Gltf::ShadowMap::geometry"));
+
+  // each cascade is one layer of the depth image
+  vk::ImageCreateInfo imageInfo;
+  imageInfo.imageType     = vk::ImageType::e2D;
+  imageInfo.format        = vk::Format::eD32Sfloat;
+  imageInfo.extent.width  = mResolution;
+  imageInfo.extent.height = mResolution;
+  imageInfo.extent.depth  = 1;
+  imageInfo.mipLevels     = 1;
+  imageInfo.arrayLayers   = mCascadeCount;
+  imageInfo.samples       = vk::SampleCountFlagBits::e1;
+  imageInfo.tiling        = vk::ImageTiling::eOptimal;
+  imageInfo.usage =
+      vk::ImageUsageFlagBits::eDepthStencilAttachment | vk::ImageUsageFlagBits::eSampled;
+  imageInfo.sharingMode   = vk::SharingMode::eExclusive;
+  imageInfo.initialLayout = vk::ImageLayout::eUndefined;
+
+  // with a comparison sampler, the hardware filters the results of four depth tests
+  auto samplerInfo = Device::createSamplerInfo(
+      vk::Filter::eLinear, vk::SamplerMipmapMode::eNearest, vk::SamplerAddressMode::eClampToEdge);
+  samplerInfo.compareEnable = true;
+  samplerInfo.compareOp     = vk::CompareOp::eLessOrEqual;
+
+  mTexture = mDevice->createTexture(imageInfo, samplerInfo, vk::ImageViewType::e2DArray,
+      vk::ImageAspectFlagBits::eDepth, vk::ImageLayout::eShaderReadOnlyOptimal);
+
+  RenderPass::Attachment depth;
+  depth.mFormat = vk::Format::eD32Sfloat;
+  depth.mImage  = mTexture;
+
+  mRenderPass->addAttachment(depth);
+  mRenderPass->setExtent(glm::uvec2(mResolution));
+  mRenderPass->setLayerCount(mCascadeCount);
+  mRenderPass->setName("Gltf::ShadowMap");
+
+  mCascadeMatrices.fill(glm::mat4(1.f));
+  mCascadeSplits.fill(0.f);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+ShadowMap::~ShadowMap() {
+  ILLUSION_TRACE << "Deleting Gltf::ShadowMap." << std::endl;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void ShadowMap::render(CommandBuffer& cmd, Model const& model, DrawList const& drawList,
+    TransientAllocator& allocator, glm::mat4 const& viewMatrix, glm::mat4 const& projectionMatrix,
+    float nearClip, float farClip, glm::vec3 const& lightDirection,
+    BoundingBox const& sceneBounds) {
+
+  updateCascades(viewMatrix, projectionMatrix, nearClip, farClip, lightDirection, sceneBounds);
+
+  uint32_t drawCount = drawList.getDrawCount();
+
+  ShadowUniforms uniforms;
+  for (uint32_t i(0); i < MAX_CASCADES; ++i) {
+    uniforms.mViewProjections[i] = mCascadeMatrices[i];
+    uniforms.mSplits[i]          = mCascadeSplits[i];
+  }
+  uniforms.mLightDirection = glm::vec4(mLightDirection, static_cast<float>(mCascadeCount));
+  uniforms.mDrawCount      = drawCount;
+
+  mUniforms = allocator.addData(uniforms);
+
+  // one cascade mask for each Instance of the DrawList
+  auto masks = allocator.allocate(
+      drawList.mInstances.mSize / sizeof(DrawList::Instance) * sizeof(uint32_t));
+  auto commands = allocator.allocate(drawList.mDrawCommands.mSize);
+
+  if (drawCount > 0) {
+    cmd.setShader(mCullShader);
+    cmd.bindingState().setUniformBuffer(
+        mUniforms.mBuffer, mUniforms.mSize, mUniforms.mOffset, 0, 0);
+    cmd.bindingState().setStorageBuffer(drawList.mDrawCommands.mBuffer,
+        drawList.mDrawCommands.mSize, drawList.mDrawCommands.mOffset, 0, 1);
+    cmd.bindingState().setStorageBuffer(
+        drawList.mBounds.mBuffer, drawList.mBounds.mSize, drawList.mBounds.mOffset, 0, 2);
+    cmd.bindingState().setStorageBuffer(commands.mBuffer, commands.mSize, commands.mOffset, 0, 3);
+    cmd.bindingState().setStorageBuffer(masks.mBuffer, masks.mSize, masks.mOffset, 0, 4);
+
+    cmd.dispatch(getGroupCount(drawCount, 64));
+
+    cmd.accessBuffer(commands.mBuffer, vk::PipelineStageFlagBits::eDrawIndirect,
+        vk::AccessFlagBits::eIndirectCommandRead);
+    cmd.accessBuffer(masks.mBuffer, vk::PipelineStageFlagBits::eGeometryShader,
+        vk::AccessFlagBits::eShaderRead);
+
+    cmd.bindingState().reset(0);
+  }
+
+  // the layered pass clears all cascades, even if nothing is drawn
+  GraphicsState savedState = cmd.graphicsState();
+
+  cmd.beginRenderPass(mRenderPass);
+
+  if (drawCount > 0) {
+    auto& state = cmd.graphicsState();
+    state.setViewports({{glm::vec2(static_cast<float>(mResolution))}});
+    state.setRasterizationSamples(vk::SampleCountFlagBits::e1);
+    state.setBlendAttachments({});
+    state.setDepthTestEnable(true);
+    state.setDepthWriteEnable(true);
+    state.setDepthBiasEnable(true);
+    state.setDepthBiasConstantFactor(1.25f);
+    state.setDepthBiasSlopeFactor(1.75f);
+    state.setCullMode(vk::CullModeFlagBits::eNone);
+
+    // only the positions, joints and weights are read
+    std::vector<vk::VertexInputAttributeDescription> attributes;
+    for (auto const& attribute : Model::getVertexInputAttributes(model.getVertexLayout())) {
+      if (attribute.location == 0 || attribute.location == 3 || attribute.location == 4) {
+        attributes.push_back(attribute);
+      }
+    }
+
+    state.setVertexInputAttributes(attributes);
+    state.setVertexInputBindings(Model::getVertexInputBindings(model.getVertexLayout()));
+
+    cmd.setShader(model.getVertexLayout() == VertexLayout::eDefault ? mShadowShader
+                                                                    : mCompactShadowShader);
+    cmd.bindingState().setUniformBuffer(
+        mUniforms.mBuffer, mUniforms.mSize, mUniforms.mOffset, 0, 0);
+    cmd.bindingState().setStorageBuffer(masks.mBuffer, masks.mSize, masks.mOffset, 0, 1);
+    cmd.bindingState().setStorageBuffer(drawList.mInstances.mBuffer, drawList.mInstances.mSize,
+        drawList.mInstances.mOffset, 0, 2);
+    cmd.bindingState().setStorageBuffer(drawList.mJointMatrices.mBuffer,
+        drawList.mJointMatrices.mSize, drawList.mJointMatrices.mOffset, 0, 3);
+
+    if (model.getSkinBuffer()) {
+      cmd.bindVertexBuffers(0, {model.getVertexBuffer(), model.getSkinBuffer()});
+    } else {
+      cmd.bindVertexBuffers(0, {model.getVertexBuffer()});
+    }
+    cmd.bindIndexBuffer(model.getIndexBuffer(), 0, model.getIndexType());
+
+    for (auto const& batch : drawList.mBatches) {
+      bool triangles = batch.mTopology == vk::PrimitiveTopology::eTriangleList ||
+                       batch.mTopology == vk::PrimitiveTopology::eTriangleStrip ||
+                       batch.mTopology == vk::PrimitiveTopology::eTriangleFan;
+
+      if (!triangles || batch.mMaterial->mDoAlphaBlending) {
+        continue;
+      }
+
+      state.setTopology(batch.mTopology);
+
+      // direct draws skip the culling of whole draws, but the cascade masks are still used
+      if (drawList.mDirectDraws) {
+        drawList.draw(cmd, batch);
+      } else {
+        cmd.drawIndexedIndirect(commands.mBuffer,
+            commands.mOffset + batch.mFirstDraw * sizeof(vk::DrawIndexedIndirectCommand),
+            batch.mDrawCount);
+      }
+    }
+
+    cmd.bindingState().reset(0);
+  }
+
+  cmd.endRenderPass();
+
+  cmd.graphicsState() = savedState;
+
+  // the depth image has been written by the RenderPass, which is not tracked
+  cmd.transitionImageLayout(*mTexture->mImage, vk::ImageLayout::eDepthStencilAttachmentOptimal,
+      vk::ImageLayout::eShaderReadOnlyOptimal, vk::PipelineStageFlagBits::eLateFragmentTests,
+      vk::PipelineStageFlagBits::eFragmentShader, mTexture->mViewInfo.subresourceRange);
+
+  mTexture->mCurrentLayout = vk::ImageLayout::eShaderReadOnlyOptimal;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void ShadowMap::bind(CommandBuffer& cmd, uint32_t set, uint32_t firstBinding) const {
+  cmd.bindingState().setUniformBuffer(
+      mUniforms.mBuffer, mUniforms.mSize, mUniforms.mOffset, set, firstBinding);
+  cmd.bindingState().setTexture(mTexture, set, firstBinding + 1);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+std::array<glm::mat4, ShadowMap::MAX_CASCADES> const& ShadowMap::getCascadeMatrices() const {
+  return mCascadeMatrices;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+std::array<float, ShadowMap::MAX_CASCADES> const& ShadowMap::getCascadeSplits() const {
+  return mCascadeSplits;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+uint32_t ShadowMap::getCascadeCount() const {
+  return mCascadeCount;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+TexturePtr const& ShadowMap::getTexture() const {
+  return mTexture;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void ShadowMap::updateCascades(glm::mat4 const& viewMatrix, glm::mat4 const& projectionMatrix,
+    float nearClip, float farClip, glm::vec3 const& lightDirection,
+    BoundingBox const& sceneBounds) {
+
+  mLightDirection = glm::normalize(lightDirection);
+
+  // The corners of the view frustum in world space; the corners i and i + 4 are on the same edge,
+  // on the near and on the far plane respectively.
+  glm::mat4                inverseViewProjection = glm::inverse(projectionMatrix * viewMatrix);
+  std::array<glm::vec3, 8> frustum;
+
+  for (int i(0); i < 8; ++i) {
+    glm::vec4 p = inverseViewProjection *
+                  glm::vec4((i & 1) ? 1.f : -1.f, (i & 2) ? 1.f : -1.f, (i & 4) ? 1.f : 0.f, 1.f);
+    frustum[i] = glm::vec3(p) / p.w;
+  }
+
+  glm::vec3 up = std::abs(mLightDirection.y) > 0.99f ? glm::vec3(1.f, 0.f, 0.f)
+                                                     : glm::vec3(0.f, 1.f, 0.f);
+
+  float lastSplit = nearClip;
+
+  for (uint32_t c(0); c < mCascadeCount; ++c) {
+
+    // the practical split scheme mixes logarithmic and uniform splits
+    float t     = static_cast<float>(c + 1) / static_cast<float>(mCascadeCount);
+    float split = SPLIT_LAMBDA * nearClip * std::pow(farClip / nearClip, t) +
+                  (1.f - SPLIT_LAMBDA) * (nearClip + (farClip - nearClip) * t);
+
+    // the view space depth is linear along the edges of the frustum
+    float start = (lastSplit - nearClip) / (farClip - nearClip);
+    float end   = (split - nearClip) / (farClip - nearClip);
+
+    std::array<glm::vec3, 8> corners;
+    for (int i(0); i < 4; ++i) {
+      corners[i]     = glm::mix(frustum[i], frustum[i + 4], start);
+      corners[i + 4] = glm::mix(frustum[i], frustum[i + 4], end);
+    }
+
+    // The cascade covers the bounding sphere of its slice of the frustum. Its size does not change
+    // when the camera rotates, so the resolution of the shadows stays the same.
+    glm::vec3 center(0.f);
+    for (auto const& corner : corners) {
+      center += corner / 8.f;
+    }
+
+    float radius = 0.f;
+    for (auto const& corner : corners) {
+      radius = std::max(radius, glm::length(corner - center));
+    }
+    radius = std::ceil(radius * 16.f) / 16.f;
+
+    glm::mat4 view = glm::lookAt(center, center - mLightDirection, up);
+
+    // the near plane is moved towards the light until it contains all casters of the scene
+    float nearPlane = -radius;
+    if (!sceneBounds.isEmpty()) {
+      for (int i(0); i < 8; ++i) {
+        glm::vec3 corner((i & 1) ? sceneBounds.mMax.x : sceneBounds.mMin.x,
+            (i & 2) ? sceneBounds.mMax.y : sceneBounds.mMin.y,
+            (i & 4) ? sceneBounds.mMax.z : sceneBounds.mMin.z);
+        nearPlane = std::min(nearPlane, -(view * glm::vec4(corner, 1.f)).z);
+      }
+    }
+
+    glm::mat4 projection = glm::orthoZO(-radius, radius, -radius, radius, nearPlane, radius);
+
+    // The projection is moved so that the world origin falls onto a texel. Hence the texels do not
+    // move relative to the scene when the camera moves and the shadow edges do not shimmer.
+    glm::vec4 origin = projection * view * glm::vec4(0.f, 0.f, 0.f, 1.f);
+    glm::vec2 texel  = glm::vec2(origin) * (static_cast<float>(mResolution) * 0.5f);
+    glm::vec2 offset = (glm::round(texel) - texel) * (2.f / static_cast<float>(mResolution));
+    projection[3][0] += offset.x;
+    projection[3][1] += offset.y;
+
+    mCascadeMatrices[c] = projection * view;
+    mCascadeSplits[c]   = split;
+
+    lastSplit = split;
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+} // namespace Illusion::Graphics::Gltf
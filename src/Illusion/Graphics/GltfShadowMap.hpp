@@ -0,0 +1,102 @@
+////////////////////////////////////////////////////////////////////////////////////////////////////
+//                                                                                                //
+//    _)  |  |            _)                This code may be used and modified under the terms    //
+//     |  |  |  |  | (_-<  |   _ \    \     of the MIT license. See the LICENSE file for details. //
+//    _| _| _| \_,_| ___/ _| \___/ _| _|    Copyright (c) 2018-2019 Simon Schneegans              //
+//                                                                                                //
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#ifndef ILLUSION_GRAPHICS_GLTF_SHADOW_MAP_HPP
+#define ILLUSION_GRAPHICS_GLTF_SHADOW_MAP_HPP
+
+#include "TransientAllocator.hpp"
+
+#include <array>
+#include <glm/glm.hpp>
+
+namespace Illusion::Graphics::Gltf {
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// The ShadowMap renders cascaded shadow maps of a directional light for a Gltf::DrawList. The    //
+// view frustum of the camera is split into up to MAX_CASCADES depth ranges, each of them is      //
+// covered by an orthographic projection along the light direction. All cascades are layers of    //
+// one depth image and they are rendered in a single layered RenderPass: the indirect draw        //
+// commands of the DrawList are recorded only once and a geometry shader with one invocation per  //
+// cascade routes each triangle to the layers it touches. Before, a compute shader tests the      //
+// Bounds of each draw against all cascades; draws which are outside of all of them get an        //
+// instanceCount of zero, the others are only sent to the cascades they intersect.                //
+// The vertices are read from the vertex buffer of the Model, so Primitives morphed by a          //
+// Gltf::Morpher cast morphed shadows. Skinned Primitives reuse the joint matrices of the         //
+// DrawList. Transparent Batches and Batches which are not drawn as triangles cast no shadows;    //
+// alpha cutoffs are ignored.                                                                     //
+// The depth image is written each frame, hence each frame in flight needs its own ShadowMap.     //
+// See examples/data/shaders/CascadedShadows.glsl for the shader side. This requires the          //
+// geometryShader feature of the Device.                                                          //
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+class ShadowMap {
+
+ public:
+  static constexpr uint32_t MAX_CASCADES = 4;
+
+  // Syntactic sugar to create a std::shared_ptr for this class
+  template <typename... Args>
+  static ShadowMapPtr create(Args&&... args) {
+    return std::make_shared<ShadowMap>(args...);
+  };
+
+  // The resolution is the width and height of each cascade. A std::runtime_error is thrown if the
+  // cascadeCount is not in [1, MAX_CASCADES] or if the geometryShader feature is not enabled.
+  explicit ShadowMap(
+      DevicePtr const& device, uint32_t resolution = 2048, uint32_t cascadeCount = MAX_CASCADES);
+  virtual ~ShadowMap();
+
+  // Computes the cascades for the given camera and records the culling dispatch and the layered
+  // RenderPass. This has to be called outside of RenderPasses and before the DrawList is culled by
+  // a Gltf::Culler, as this replaces the draw commands with those visible for the camera. The
+  // vertex and index buffers of the Model are bound afterwards. The lightDirection points towards
+  // the light. The cascades are extended towards the light so that they contain all casters of
+  // the sceneBounds (in world space). Afterwards, the depth image is in
+  // vk::ImageLayout::eShaderReadOnlyOptimal. This changes the current Shader of the CommandBuffer
+  // and resets the bindings of descriptor set 0; the GraphicsState is restored.
+  void render(CommandBuffer& cmd, Model const& model, DrawList const& drawList,
+      TransientAllocator& allocator, glm::mat4 const& viewMatrix,
+      glm::mat4 const& projectionMatrix, float nearClip, float farClip,
+      glm::vec3 const& lightDirection, BoundingBox const& sceneBounds);
+
+  // Binds the uniforms of the last render() and the depth image (with a comparison sampler) to two
+  // consecutive bindings of the given descriptor set, starting at firstBinding.
+  void bind(CommandBuffer& cmd, uint32_t set, uint32_t firstBinding) const;
+
+  // The world space to shadow map matrices of the cascades of the last render() and the view space
+  // depths where they end.
+  std::array<glm::mat4, MAX_CASCADES> const& getCascadeMatrices() const;
+  std::array<float, MAX_CASCADES> const&     getCascadeSplits() const;
+
+  uint32_t          getCascadeCount() const;
+  TexturePtr const& getTexture() const;
+
+ private:
+  void updateCascades(glm::mat4 const& viewMatrix, glm::mat4 const& projectionMatrix,
+      float nearClip, float farClip, glm::vec3 const& lightDirection,
+      BoundingBox const& sceneBounds);
+
+  DevicePtr     mDevice;
+  uint32_t      mResolution;
+  uint32_t      mCascadeCount;
+  ShaderPtr     mCullShader;
+  ShaderPtr     mShadowShader;
+  ShaderPtr     mCompactShadowShader;
+  TexturePtr    mTexture;
+  RenderPassPtr mRenderPass;
+
+  std::array<glm::mat4, MAX_CASCADES> mCascadeMatrices;
+  std::array<float, MAX_CASCADES>     mCascadeSplits;
+  glm::vec3                           mLightDirection = glm::vec3(0.f, 1.f, 0.f);
+
+  TransientAllocator::Allocation mUniforms;
+};
+
+} // namespace Illusion::Graphics::Gltf
+
+#endif // ILLUSION_GRAPHICS_GLTF_SHADOW_MAP_HPP
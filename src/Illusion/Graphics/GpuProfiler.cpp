@@ -0,0 +1,214 @@
+////////////////////////////////////////////////////////////////////////////////////////////////////
+//                                                                                                //
+//    _)  |  |            _)                This code may be used and modified under the terms    //
+//     |  |  |  |  | (_-<  |   _ \    \     of the MIT license. See the LICENSE file for details. //
+//    _| _| _| \_,_| ___/ _| \___/ _| _|    Copyright (c) 2018-2019 Simon Schneegans              //
+//                                                                                                //
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include "GpuProfiler.hpp"
+
+#include "../Core/Logger.hpp"
+#include "CommandBuffer.hpp"
+#include "Device.hpp"
+#include "PhysicalDevice.hpp"
+
+#include <iostream>
+
+namespace Illusion::Graphics {
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+GpuProfiler::ScopedQuery::ScopedQuery(
+    GpuProfiler& profiler, CommandBuffer& cmd, std::string const& name)
+    : mProfiler(profiler)
+    , mCmd(cmd) {
+  mProfiler.beginScope(mCmd, name);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+GpuProfiler::ScopedQuery::~ScopedQuery() {
+  mProfiler.endScope(mCmd);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+GpuProfiler::GpuProfiler(DevicePtr const& device, uint32_t frameCount, uint32_t maxScopes)
+    : mDevice(device)
+    , mMaxScopes(maxScopes) {
+
+  auto const& physicalDevice = mDevice->getPhysicalDevice();
+  uint32_t    family         = physicalDevice->getQueueFamily(QueueType::eGeneric);
+  uint32_t    validBits = physicalDevice->getQueueFamilyProperties()[family].timestampValidBits;
+
+  if (validBits == 0) {
+    ILLUSION_WARNING << "GPU profiling is disabled: The generic queue does not support timestamps."
+                     << std::endl;
+    return;
+  }
+
+  // the timestamp period is given in nanoseconds
+  mTimestampPeriod = physicalDevice->getProperties().limits.timestampPeriod * 1e-6;
+  mTimestampMask   = validBits >= 64 ? ~0ull : (1ull << validBits) - 1;
+
+  vk::QueryPoolCreateInfo info;
+  info.queryType  = vk::QueryType::eTimestamp;
+  info.queryCount = maxScopes * 2;
+
+  mSlots.resize(frameCount);
+
+  for (auto& slot : mSlots) {
+    slot.mPool = mDevice->createQueryPool(info);
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+GpuProfiler::~GpuProfiler() = default;
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void GpuProfiler::beginFrame(FrameContext::Frame const& frame) {
+  if (mSlots.empty()) {
+    return;
+  }
+
+  if (frame.mSlot >= mSlots.size()) {
+    throw std::runtime_error("Failed to begin frame of GpuProfiler: There are only " +
+                             std::to_string(mSlots.size()) + " slots!");
+  }
+
+  auto& slot = mSlots[frame.mSlot];
+
+  if (slot.mPending) {
+    readResults(slot);
+  }
+
+  frame.mCmd->resetQueryPool(slot.mPool, 0, mMaxScopes * 2);
+
+  slot.mRecords.clear();
+  slot.mFrameIndex = frame.mFrameIndex;
+  slot.mPending    = true;
+
+  mCurrentSlot = &slot;
+  mOpenScopes.clear();
+  mDroppedScopes = 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void GpuProfiler::beginScope(CommandBuffer& cmd, std::string const& name) {
+  if (!mCurrentSlot) {
+    return;
+  }
+
+  auto& records = mCurrentSlot->mRecords;
+
+  if (records.size() >= mMaxScopes) {
+    ++mDroppedScopes;
+    mOpenScopes.push_back(-1);
+    return;
+  }
+
+  // dropped scopes have no record, so the innermost recorded scope becomes the parent
+  int32_t parent = -1;
+  for (auto it = mOpenScopes.rbegin(); it != mOpenScopes.rend() && parent < 0; ++it) {
+    parent = *it;
+  }
+
+  int32_t index = static_cast<int32_t>(records.size());
+  records.push_back({name, parent});
+  mOpenScopes.push_back(index);
+
+  cmd.writeTimestamp(vk::PipelineStageFlagBits::eTopOfPipe, mCurrentSlot->mPool, index * 2);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void GpuProfiler::endScope(CommandBuffer& cmd) {
+  if (!mCurrentSlot) {
+    return;
+  }
+
+  if (mOpenScopes.empty()) {
+    throw std::runtime_error("Failed to end GPU profiler scope: There is no open scope!");
+  }
+
+  int32_t index = mOpenScopes.back();
+  mOpenScopes.pop_back();
+
+  if (index >= 0) {
+    cmd.writeTimestamp(
+        vk::PipelineStageFlagBits::eBottomOfPipe, mCurrentSlot->mPool, index * 2 + 1);
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+std::vector<GpuProfiler::Timing> const& GpuProfiler::getResults() const {
+  return mResults;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+uint64_t GpuProfiler::getResultFrameIndex() const {
+  return mResultFrameIndex;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+uint32_t GpuProfiler::getDroppedScopeCount() const {
+  return mDroppedScopes;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void GpuProfiler::readResults(Slot& slot) {
+  slot.mPending = false;
+
+  if (slot.mRecords.empty()) {
+    return;
+  }
+
+  // Each query gets its value and its availability. The fence of the frame has been signaled, so
+  // all written timestamps are available; only scopes which have not been closed are missing.
+  uint32_t              queryCount = static_cast<uint32_t>(slot.mRecords.size()) * 2;
+  std::vector<uint64_t> data(queryCount * 2);
+
+  auto result = mDevice->getHandle()->getQueryPoolResults(*slot.mPool, 0, queryCount,
+      data.size() * sizeof(uint64_t), data.data(), sizeof(uint64_t) * 2,
+      vk::QueryResultFlagBits::e64 | vk::QueryResultFlagBits::eWithAvailability);
+
+  if (result != vk::Result::eSuccess && result != vk::Result::eNotReady) {
+    return;
+  }
+
+  // Build the tree from the back: the children of each scope come after it, so they are complete
+  // when they are moved into their parent. Inserting at the front keeps the recording order.
+  std::vector<Timing> timings(slot.mRecords.size());
+  std::vector<Timing> roots;
+
+  for (size_t i = slot.mRecords.size(); i-- > 0;) {
+    auto& timing = timings[i];
+    timing.mName = std::move(slot.mRecords[i].mName);
+
+    uint64_t begin = data[i * 4] & mTimestampMask;
+    uint64_t end   = data[i * 4 + 2] & mTimestampMask;
+
+    if (data[i * 4 + 1] && data[i * 4 + 3]) {
+      timing.mMilliseconds = static_cast<double>((end - begin) & mTimestampMask) * mTimestampPeriod;
+    }
+
+    int32_t parent = slot.mRecords[i].mParent;
+    auto&   target = parent >= 0 ? timings[parent].mChildren : roots;
+    target.insert(target.begin(), std::move(timing));
+  }
+
+  mResults          = std::move(roots);
+  mResultFrameIndex = slot.mFrameIndex;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+} // namespace Illusion::Graphics
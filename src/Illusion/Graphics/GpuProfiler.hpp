@@ -0,0 +1,120 @@
+////////////////////////////////////////////////////////////////////////////////////////////////////
+//                                                                                                //
+//    _)  |  |            _)                This code may be used and modified under the terms    //
+//     |  |  |  |  | (_-<  |   _ \    \     of the MIT license. See the LICENSE file for details. //
+//    _| _| _| \_,_| ___/ _| \___/ _| _|    Copyright (c) 2018-2019 Simon Schneegans              //
+//                                                                                                //
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#ifndef ILLUSION_GRAPHICS_GPU_PROFILER_HPP
+#define ILLUSION_GRAPHICS_GPU_PROFILER_HPP
+
+#include "FrameContext.hpp"
+
+#include <string>
+#include <vector>
+
+namespace Illusion::Graphics {
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// The GpuProfiler measures how much GPU time named parts of a frame take. Scopes are opened and  //
+// closed on a CommandBuffer with beginScope() and endScope() (or with a ScopedQuery); each of    //
+// them writes a timestamp to a vk::QueryPool. Scopes may be nested, the results form a tree.     //
+// There is one vk::QueryPool for each frame in flight. The timestamps of a Frame are read in the //
+// next beginFrame() for the same slot; at this point the FrameContext has already waited for the //
+// fence of the Frame, so reading the results never stalls. Hence getResults() lags getFrameCount //
+// frames behind the CPU.                                                                         //
+// If the generic queue does not support timestamps, all methods do nothing and there will be no  //
+// results.                                                                                       //
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+class GpuProfiler {
+
+ public:
+  // The measured GPU time of one scope and its nested scopes.
+  struct Timing {
+    std::string         mName;
+    double              mMilliseconds = 0.0;
+    std::vector<Timing> mChildren;
+  };
+
+  // Opens a scope in the constructor and closes it in the destructor.
+  class ScopedQuery {
+   public:
+    ScopedQuery(GpuProfiler& profiler, CommandBuffer& cmd, std::string const& name);
+    virtual ~ScopedQuery();
+
+    ScopedQuery(ScopedQuery const& other) = delete;
+    ScopedQuery& operator=(ScopedQuery const& other) = delete;
+
+   private:
+    GpuProfiler&   mProfiler;
+    CommandBuffer& mCmd;
+  };
+
+  // Syntactic sugar to create a std::shared_ptr for this class
+  template <typename... Args>
+  static GpuProfilerPtr create(Args&&... args) {
+    return std::make_shared<GpuProfiler>(args...);
+  };
+
+  // frameCount should match the FrameContext. At most maxScopes scopes can be recorded per frame;
+  // further scopes are ignored.
+  GpuProfiler(DevicePtr const& device, uint32_t frameCount, uint32_t maxScopes = 256);
+  virtual ~GpuProfiler();
+
+  // This has to be called after FrameContext::beginFrame() with the returned Frame, outside of a
+  // RenderPass. It reads the timestamps which were written the last time this slot was used and
+  // resets the vk::QueryPool of the slot on the CommandBuffer of the Frame.
+  void beginFrame(FrameContext::Frame const& frame);
+
+  // Writes a timestamp at the top of the pipe. The scope is a child of the innermost open scope.
+  // The CommandBuffer has to be executed in the current Frame, but it may be a secondary one.
+  void beginScope(CommandBuffer& cmd, std::string const& name);
+
+  // Writes a timestamp at the bottom of the pipe for the innermost open scope.
+  void endScope(CommandBuffer& cmd);
+
+  // Returns the root scopes of the most recent frame whose timestamps have been read. Each
+  // beginFrame() may replace the results.
+  std::vector<Timing> const& getResults() const;
+
+  // Returns the number of the frame the results belong to; see FrameContext::getFrameIndex().
+  uint64_t getResultFrameIndex() const;
+
+  // Returns the number of scopes which have been ignored since the last beginFrame() because
+  // maxScopes was exceeded.
+  uint32_t getDroppedScopeCount() const;
+
+ private:
+  struct Record {
+    std::string mName;
+    int32_t     mParent = -1;
+  };
+
+  struct Slot {
+    vk::QueryPoolPtr    mPool;
+    std::vector<Record> mRecords;
+    uint64_t            mFrameIndex = 0;
+    bool                mPending    = false;
+  };
+
+  void readResults(Slot& slot);
+
+  DevicePtr         mDevice;
+  uint32_t          mMaxScopes;
+  double            mTimestampPeriod = 0.0;
+  uint64_t          mTimestampMask   = 0;
+  std::vector<Slot> mSlots;
+
+  Slot*                mCurrentSlot = nullptr;
+  std::vector<int32_t> mOpenScopes; // -1 for dropped scopes
+  uint32_t             mDroppedScopes = 0;
+
+  std::vector<Timing> mResults;
+  uint64_t            mResultFrameIndex = 0;
+};
+
+} // namespace Illusion::Graphics
+
+#endif // ILLUSION_GRAPHICS_GPU_PROFILER_HPP
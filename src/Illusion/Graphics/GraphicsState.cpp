@@ -12,10 +12,71 @@
 #include "RenderPass.hpp"
 #include "ShaderModule.hpp"
 
+#include <cstring>
 #include <iostream>
 
 namespace Illusion::Graphics {
 
+namespace {
+
+// All properties of the GraphicsState are trivially copyable, hence they can be written byte-wise.
+template <typename T>
+void write(std::vector<uint8_t>& data, T const& value) {
+  size_t offset = data.size();
+  data.resize(offset + sizeof(T));
+  std::memcpy(data.data() + offset, &value, sizeof(T));
+}
+
+template <typename T>
+void write(std::vector<uint8_t>& data, std::vector<T> const& values) {
+  write(data, static_cast<uint32_t>(values.size()));
+  for (auto const& value : values) {
+    write(data, value);
+  }
+}
+
+template <typename T>
+bool read(std::vector<uint8_t> const& data, size_t& offset, T& value) {
+  if (offset + sizeof(T) > data.size()) {
+    return false;
+  }
+  std::memcpy(&value, data.data() + offset, sizeof(T));
+  offset += sizeof(T);
+  return true;
+}
+
+template <typename T>
+bool read(std::vector<uint8_t> const& data, size_t& offset, std::vector<T>& values) {
+  uint32_t size;
+  if (!read(data, offset, size) || offset + size * sizeof(T) > data.size()) {
+    return false;
+  }
+  values.resize(size);
+  for (auto& value : values) {
+    read(data, offset, value);
+  }
+  return true;
+}
+
+// Pipelines with a dynamic topology can be used for all topologies of the same class.
+uint32_t getTopologyClass(vk::PrimitiveTopology topology) {
+  switch (topology) {
+  case vk::PrimitiveTopology::ePointList:
+    return 0;
+  case vk::PrimitiveTopology::eLineList:
+  case vk::PrimitiveTopology::eLineStrip:
+  case vk::PrimitiveTopology::eLineListWithAdjacency:
+  case vk::PrimitiveTopology::eLineStripWithAdjacency:
+    return 1;
+  case vk::PrimitiveTopology::ePatchList:
+    return 3;
+  default:
+    return 2;
+  }
+}
+
+} // namespace
+
 ////////////////////////////////////////////////////////////////////////////////////////////////////
 
 bool GraphicsState::BlendAttachment::operator==(GraphicsState::BlendAttachment const& other) const {
@@ -850,6 +911,12 @@ Core::BitHash GraphicsState::getHash() const {
 
   if (mDirty) {
     mHash.clear();
+    mDynamicHash.clear();
+
+    // values of dynamic states are not part of the pipeline, they are pushed to mDynamicHash
+    auto hash = [this](vk::DynamicState state) -> Core::BitHash& {
+      return mDynamicState.count(state) ? mDynamicHash : mHash;
+    };
 
     mHash.push<1>(mBlendLogicOpEnable);
     mHash.push<4>(mBlendLogicOp);
@@ -863,54 +930,44 @@ Core::BitHash GraphicsState::getHash() const {
       mHash.push<3>(attachmentState.mAlphaBlendOp);
       mHash.push<4>(attachmentState.mColorWriteMask);
     }
-    if (!getDynamicState().count(vk::DynamicState::eBlendConstants)) {
-      mHash.push<32>(mBlendConstants[0]);
-      mHash.push<32>(mBlendConstants[1]);
-      mHash.push<32>(mBlendConstants[2]);
-      mHash.push<32>(mBlendConstants[3]);
-    }
-
-    mHash.push<1>(mDepthTestEnable);
-    mHash.push<1>(mDepthWriteEnable);
-    mHash.push<3>(mDepthCompareOp);
+    hash(vk::DynamicState::eBlendConstants).push<32>(mBlendConstants[0]);
+    hash(vk::DynamicState::eBlendConstants).push<32>(mBlendConstants[1]);
+    hash(vk::DynamicState::eBlendConstants).push<32>(mBlendConstants[2]);
+    hash(vk::DynamicState::eBlendConstants).push<32>(mBlendConstants[3]);
+
+    hash(vk::DynamicState::eDepthTestEnableEXT).push<1>(mDepthTestEnable);
+    hash(vk::DynamicState::eDepthWriteEnableEXT).push<1>(mDepthWriteEnable);
+    hash(vk::DynamicState::eDepthCompareOpEXT).push<3>(mDepthCompareOp);
     mHash.push<1>(mDepthBoundsTestEnable);
     mHash.push<1>(mStencilTestEnable);
     mHash.push<3>(mStencilFrontFailOp);
     mHash.push<3>(mStencilFrontPassOp);
     mHash.push<3>(mStencilFrontDepthFailOp);
     mHash.push<3>(mStencilFrontCompareOp);
-    if (!getDynamicState().count(vk::DynamicState::eStencilCompareMask)) {
-      mHash.push<32>(mStencilFrontCompareMask);
-    }
-    if (!getDynamicState().count(vk::DynamicState::eStencilWriteMask)) {
-      mHash.push<32>(mStencilFrontWriteMask);
-    }
-    if (!getDynamicState().count(vk::DynamicState::eStencilReference)) {
-      mHash.push<32>(mStencilFrontReference);
-    }
+    hash(vk::DynamicState::eStencilCompareMask).push<32>(mStencilFrontCompareMask);
+    hash(vk::DynamicState::eStencilWriteMask).push<32>(mStencilFrontWriteMask);
+    hash(vk::DynamicState::eStencilReference).push<32>(mStencilFrontReference);
     mHash.push<3>(mStencilBackFailOp);
     mHash.push<3>(mStencilBackPassOp);
     mHash.push<3>(mStencilBackDepthFailOp);
     mHash.push<3>(mStencilBackCompareOp);
-    if (!getDynamicState().count(vk::DynamicState::eStencilCompareMask)) {
-      mHash.push<32>(mStencilBackCompareMask);
-    }
-    if (!getDynamicState().count(vk::DynamicState::eStencilWriteMask)) {
-      mHash.push<32>(mStencilBackWriteMask);
-    }
-    if (!getDynamicState().count(vk::DynamicState::eStencilReference)) {
-      mHash.push<32>(mStencilBackReference);
-    }
-    if (!getDynamicState().count(vk::DynamicState::eDepthBounds)) {
-      mHash.push<32>(mMinDepthBounds);
-      mHash.push<32>(mMaxDepthBounds);
-    }
+    hash(vk::DynamicState::eStencilCompareMask).push<32>(mStencilBackCompareMask);
+    hash(vk::DynamicState::eStencilWriteMask).push<32>(mStencilBackWriteMask);
+    hash(vk::DynamicState::eStencilReference).push<32>(mStencilBackReference);
+    hash(vk::DynamicState::eDepthBounds).push<32>(mMinDepthBounds);
+    hash(vk::DynamicState::eDepthBounds).push<32>(mMaxDepthBounds);
 
     for (auto const& dynamicState : mDynamicState) {
       mHash.push<32>(dynamicState);
     }
 
-    mHash.push<4>(mTopology);
+    // with a dynamic topology, only the topology class has to match the pipeline
+    if (mDynamicState.count(vk::DynamicState::ePrimitiveTopologyEXT)) {
+      mHash.push<2>(getTopologyClass(mTopology));
+      mDynamicHash.push<4>(mTopology);
+    } else {
+      mHash.push<4>(mTopology);
+    }
     mHash.push<1>(mPrimitiveRestartEnable);
 
     mHash.push<3>(mRasterizationSamples);
@@ -925,17 +982,13 @@ Core::BitHash GraphicsState::getHash() const {
     mHash.push<1>(mDepthClampEnable);
     mHash.push<1>(mRasterizerDiscardEnable);
     mHash.push<2>(mPolygonMode);
-    mHash.push<2>(mCullMode);
-    mHash.push<1>(mFrontFace);
+    hash(vk::DynamicState::eCullModeEXT).push<2>(mCullMode);
+    hash(vk::DynamicState::eFrontFaceEXT).push<1>(mFrontFace);
     mHash.push<1>(mDepthBiasEnable);
-    if (!getDynamicState().count(vk::DynamicState::eDepthBias)) {
-      mHash.push<32>(mDepthBiasConstantFactor);
-      mHash.push<32>(mDepthBiasClamp);
-      mHash.push<32>(mDepthBiasSlopeFactor);
-    }
-    if (!getDynamicState().count(vk::DynamicState::eLineWidth)) {
-      mHash.push<32>(mLineWidth);
-    }
+    hash(vk::DynamicState::eDepthBias).push<32>(mDepthBiasConstantFactor);
+    hash(vk::DynamicState::eDepthBias).push<32>(mDepthBiasClamp);
+    hash(vk::DynamicState::eDepthBias).push<32>(mDepthBiasSlopeFactor);
+    hash(vk::DynamicState::eLineWidth).push<32>(mLineWidth);
 
     mHash.push<32>(mTessellationPatchControlPoints);
 
@@ -951,27 +1004,26 @@ Core::BitHash GraphicsState::getHash() const {
       mHash.push<32>(attribute.offset);
     }
 
-    if (getDynamicState().count(vk::DynamicState::eViewport)) {
+    // the number of viewports and scissors is part of the pipeline even if they are dynamic
+    if (mDynamicState.count(vk::DynamicState::eViewport)) {
       mHash.push<32>(mViewports.size());
-    } else {
-      for (auto const& viewport : mViewports) {
-        mHash.push<32>(viewport.mOffset[0]);
-        mHash.push<32>(viewport.mOffset[1]);
-        mHash.push<32>(viewport.mExtend[0]);
-        mHash.push<32>(viewport.mExtend[1]);
-        mHash.push<32>(viewport.mMinDepth);
-        mHash.push<32>(viewport.mMaxDepth);
-      }
     }
-    if (getDynamicState().count(vk::DynamicState::eScissor)) {
+    for (auto const& viewport : mViewports) {
+      hash(vk::DynamicState::eViewport).push<32>(viewport.mOffset[0]);
+      hash(vk::DynamicState::eViewport).push<32>(viewport.mOffset[1]);
+      hash(vk::DynamicState::eViewport).push<32>(viewport.mExtend[0]);
+      hash(vk::DynamicState::eViewport).push<32>(viewport.mExtend[1]);
+      hash(vk::DynamicState::eViewport).push<32>(viewport.mMinDepth);
+      hash(vk::DynamicState::eViewport).push<32>(viewport.mMaxDepth);
+    }
+    if (mDynamicState.count(vk::DynamicState::eScissor)) {
       mHash.push<32>(mScissors.size());
-    } else {
-      for (auto const& scissor : mScissors) {
-        mHash.push<32>(scissor.mOffset[0]);
-        mHash.push<32>(scissor.mOffset[1]);
-        mHash.push<32>(scissor.mExtend[0]);
-        mHash.push<32>(scissor.mExtend[1]);
-      }
+    }
+    for (auto const& scissor : mScissors) {
+      hash(vk::DynamicState::eScissor).push<32>(scissor.mOffset[0]);
+      hash(vk::DynamicState::eScissor).push<32>(scissor.mOffset[1]);
+      hash(vk::DynamicState::eScissor).push<32>(scissor.mExtend[0]);
+      hash(vk::DynamicState::eScissor).push<32>(scissor.mExtend[1]);
     }
 
     mDirty = false;
@@ -982,4 +1034,126 @@ Core::BitHash GraphicsState::getHash() const {
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////
 
+Core::BitHash const& GraphicsState::getDynamicStateHash() const {
+  getHash();
+  return mDynamicHash;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+bool GraphicsState::isDynamic(vk::DynamicState state) const {
+  return mDynamicState.count(state) > 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void GraphicsState::serialize(std::vector<uint8_t>& data) const {
+  write(data, mBlendLogicOpEnable);
+  write(data, mBlendLogicOp);
+  write(data, mBlendAttachments);
+  write(data, mBlendConstants);
+
+  write(data, mDepthTestEnable);
+  write(data, mDepthWriteEnable);
+  write(data, mDepthCompareOp);
+  write(data, mDepthBoundsTestEnable);
+  write(data, mStencilTestEnable);
+  write(data, mStencilFrontFailOp);
+  write(data, mStencilFrontPassOp);
+  write(data, mStencilFrontDepthFailOp);
+  write(data, mStencilFrontCompareOp);
+  write(data, mStencilFrontCompareMask);
+  write(data, mStencilFrontWriteMask);
+  write(data, mStencilFrontReference);
+  write(data, mStencilBackFailOp);
+  write(data, mStencilBackPassOp);
+  write(data, mStencilBackDepthFailOp);
+  write(data, mStencilBackCompareOp);
+  write(data, mStencilBackCompareMask);
+  write(data, mStencilBackWriteMask);
+  write(data, mStencilBackReference);
+  write(data, mMinDepthBounds);
+  write(data, mMaxDepthBounds);
+
+  write(data, mTopology);
+  write(data, mPrimitiveRestartEnable);
+
+  write(data, mRasterizationSamples);
+  write(data, mSampleShadingEnable);
+  write(data, mMinSampleShading);
+  write(data, mSampleMask);
+  write(data, mAlphaToCoverageEnable);
+  write(data, mAlphaToOneEnable);
+
+  write(data, mDepthClampEnable);
+  write(data, mRasterizerDiscardEnable);
+  write(data, mPolygonMode);
+  write(data, mCullMode);
+  write(data, mFrontFace);
+  write(data, mDepthBiasEnable);
+  write(data, mDepthBiasConstantFactor);
+  write(data, mDepthBiasClamp);
+  write(data, mDepthBiasSlopeFactor);
+  write(data, mLineWidth);
+
+  write(data, mTessellationPatchControlPoints);
+
+  write(data, mVertexInputBindings);
+  write(data, mVertexInputAttributes);
+
+  write(data, mViewports);
+  write(data, mScissors);
+
+  write(data, std::vector<vk::DynamicState>(mDynamicState.begin(), mDynamicState.end()));
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+bool GraphicsState::deserialize(std::vector<uint8_t> const& data, size_t& offset) {
+  std::vector<vk::DynamicState> dynamicState;
+
+  bool success =
+      read(data, offset, mBlendLogicOpEnable) && read(data, offset, mBlendLogicOp) &&
+      read(data, offset, mBlendAttachments) && read(data, offset, mBlendConstants) &&
+
+      read(data, offset, mDepthTestEnable) && read(data, offset, mDepthWriteEnable) &&
+      read(data, offset, mDepthCompareOp) && read(data, offset, mDepthBoundsTestEnable) &&
+      read(data, offset, mStencilTestEnable) && read(data, offset, mStencilFrontFailOp) &&
+      read(data, offset, mStencilFrontPassOp) && read(data, offset, mStencilFrontDepthFailOp) &&
+      read(data, offset, mStencilFrontCompareOp) && read(data, offset, mStencilFrontCompareMask) &&
+      read(data, offset, mStencilFrontWriteMask) && read(data, offset, mStencilFrontReference) &&
+      read(data, offset, mStencilBackFailOp) && read(data, offset, mStencilBackPassOp) &&
+      read(data, offset, mStencilBackDepthFailOp) && read(data, offset, mStencilBackCompareOp) &&
+      read(data, offset, mStencilBackCompareMask) && read(data, offset, mStencilBackWriteMask) &&
+      read(data, offset, mStencilBackReference) && read(data, offset, mMinDepthBounds) &&
+      read(data, offset, mMaxDepthBounds) &&
+
+      read(data, offset, mTopology) && read(data, offset, mPrimitiveRestartEnable) &&
+
+      read(data, offset, mRasterizationSamples) && read(data, offset, mSampleShadingEnable) &&
+      read(data, offset, mMinSampleShading) && read(data, offset, mSampleMask) &&
+      read(data, offset, mAlphaToCoverageEnable) && read(data, offset, mAlphaToOneEnable) &&
+
+      read(data, offset, mDepthClampEnable) && read(data, offset, mRasterizerDiscardEnable) &&
+      read(data, offset, mPolygonMode) && read(data, offset, mCullMode) &&
+      read(data, offset, mFrontFace) && read(data, offset, mDepthBiasEnable) &&
+      read(data, offset, mDepthBiasConstantFactor) && read(data, offset, mDepthBiasClamp) &&
+      read(data, offset, mDepthBiasSlopeFactor) && read(data, offset, mLineWidth) &&
+
+      read(data, offset, mTessellationPatchControlPoints) &&
+
+      read(data, offset, mVertexInputBindings) && read(data, offset, mVertexInputAttributes) &&
+
+      read(data, offset, mViewports) && read(data, offset, mScissors) &&
+
+      read(data, offset, dynamicState);
+
+  mDynamicState = std::set<vk::DynamicState>(dynamicState.begin(), dynamicState.end());
+  mDirty        = true;
+
+  return success;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
 } // namespace Illusion::Graphics
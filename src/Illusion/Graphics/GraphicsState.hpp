@@ -21,7 +21,7 @@ namespace Illusion::Graphics {
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////
 // This GraphicsState is used as a member of each CommandBuffer. Based on the stored information, //
-// a vk::Pipeline will be created by the CommandBuffer. The method getHash() can be used to cache //
+// a vk::Pipeline will be created by the PipelineCache. The method getHash() can be used to cache //
 // vk::Pipelines.                                                                                 //
 // The default state of each property can be seen in the private part at the end of this file.    //
 ////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -194,6 +194,10 @@ class GraphicsState {
   std::vector<Scissor> const&         getScissors() const;
 
   // Dynamic State ---------------------------------------------------------------------------------
+  // The values of dynamic states are recorded by the CommandBuffer before each draw call. The
+  // states of VK_EXT_extended_dynamic_state (eCullModeEXT, eFrontFaceEXT, ePrimitiveTopologyEXT,
+  // eDepthTestEnableEXT, eDepthWriteEnableEXT and eDepthCompareOpEXT) may only be used if
+  // PhysicalDevice::supportsExtendedDynamicState() returns true.
   void                                addDynamicState(vk::DynamicState val);
   void                                removeDynamicState(vk::DynamicState val);
   void                                setDynamicState(std::set<vk::DynamicState> const& val);
@@ -201,9 +205,29 @@ class GraphicsState {
 
   // clang-format on
 
+  // Returns true if the given state has been added with addDynamicState().
+  bool isDynamic(vk::DynamicState state) const;
+
   // -----------------------------------------------------------------------------------------------
+
+  // The values of dynamic states are not part of this hash, hence changing them does not require a
+  // new vk::Pipeline. The CommandBuffer records them with the corresponding vkCmdSet* commands
+  // instead. With a dynamic vk::DynamicState::ePrimitiveTopologyEXT, only the topology class
+  // (points, lines, triangles or patches) is part of the hash.
   Core::BitHash getHash() const;
 
+  // Returns a hash of the values of all dynamic states. The CommandBuffer uses this to record the
+  // dynamic state only when one of the values has been changed.
+  Core::BitHash const& getDynamicStateHash() const;
+
+  // Appends a binary representation of all properties to the given data. This is used by the
+  // PipelineCache to store used GraphicsStates in its manifest.
+  void serialize(std::vector<uint8_t>& data) const;
+
+  // Reads the properties written by serialize() starting at the given offset. The offset is
+  // advanced accordingly. Returns false if the data is truncated; the state is undefined then.
+  bool deserialize(std::vector<uint8_t> const& data, size_t& offset);
+
  private:
   DevicePtr mDevice;
 
@@ -277,6 +301,7 @@ class GraphicsState {
   // Dirty State -----------------------------------------------------------------------------------
   mutable bool          mDirty = true;
   mutable Core::BitHash mHash;
+  mutable Core::BitHash mDynamicHash;
 };
 
 } // namespace Illusion::Graphics
@@ -0,0 +1,949 @@
+////////////////////////////////////////////////////////////////////////////////////////////////////
+//                                                                                                //
+//    _)  |  |            _)                This code may be used and modified under the terms    //
+//     |  |  |  |  | (_-<  |   _ \    \     of the MIT license. See the LICENSE file for details. //
+//    _| _| _| \_,_| ___/ _| \___/ _| _|    Copyright (c) 2018-2019 Simon Schneegans              //
+//                                                                                                //
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include "IblBaker.hpp"
+
+#include "../Core/Hash.hpp"
+#include "../Core/Logger.hpp"
+#include "../Core/MappedFile.hpp"
+#include "../Core/filesystem.hpp"
+#include "BackedBuffer.hpp"
+#include "CommandBuffer.hpp"
+#include "Device.hpp"
+#include "MipmapGenerator.hpp"
+#include "Shader.hpp"
+#include "ShaderSource.hpp"
+#include "Texture.hpp"
+#include "Utils.hpp"
+
+#include <array>
+#include <atomic>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <stb_image.h>
+
+namespace Illusion::Graphics {
+
+namespace {
+
+// Cache files start with this header. The version has to be increased whenever the file format or
+// one of the shaders changes.
+const char     CACHE_MAGIC[8] = {'I', 'L', 'I', 'B', 'L', 'C', '\0', '\0'};
+const uint32_t CACHE_VERSION  = 1;
+
+struct CacheHeader {
+  char     mMagic[8];
+  uint32_t mVersion;
+  uint32_t mReserved;
+  uint64_t mKey;
+  uint64_t mDataSize;
+};
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+const std::string PANORAMA_SHADER = R"(
+  #version 450
+
+  // inputs
+  layout (local_size_x = 16, local_size_y = 16, local_size_z = 6) in;
+
+  // outputs
+  layout (binding = 0)                    uniform sampler2D inputImage;
+  layout (rgba32f, binding = 1) writeonly uniform imageCube outputCubemap;
+
+  // constants
+  vec3 majorAxes[6] = vec3[6](
+    vec3( 1,  0,  0), vec3(-1,  0,  0),
+    vec3( 0,  1,  0), vec3( 0, -1,  0),
+    vec3( 0,  0,  1), vec3( 0,  0, -1)
+  );
+
+  vec3 s[6] = vec3[6](
+    vec3( 0,  0, -1), vec3( 0,  0,  1),
+    vec3( 1,  0,  0), vec3( 1,  0,  0),
+    vec3( 1,  0,  0), vec3(-1,  0,  0)
+  );
+
+  vec3 t[6] = vec3[6](
+    vec3( 0, -1,  0), vec3( 0, -1,  0),
+    vec3( 0,  0,  1), vec3( 0,  0, -1),
+    vec3( 0, -1,  0), vec3( 0, -1,  0)
+  );
+
+  void main() {
+    const uvec2 size = imageSize(outputCubemap);
+
+    if (gl_GlobalInvocationID.x >= size.x || gl_GlobalInvocationID.y >= size.y) {
+        return;
+    }
+
+    const uint  face = gl_GlobalInvocationID.z;
+    const vec2 st = vec2(gl_GlobalInvocationID.xy) / size - 0.5;
+    const vec3 dir = normalize(s[face] * st.s + t[face] * st.t + 0.5 * majorAxes[face]);
+
+    const vec2 lngLat = vec2(atan(dir.x, dir.z), asin(dir.y));
+    const vec2 uv = (lngLat / 3.14159265359 + vec2(0, -0.5)) * vec2(-0.5, -1);
+
+    imageStore(outputCubemap, ivec3(gl_GlobalInvocationID), vec4(texture(inputImage, uv).rgb, 1.0) );
+  }
+)";
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+const std::string IRRADIANCE_SHADER = R"(
+  #version 450
+
+  // inputs
+  layout (local_size_x = 16, local_size_y = 16, local_size_z = 6) in;
+
+  // outputs
+  layout (binding = 0)                    uniform samplerCube inputCubemap;
+  layout (rgba32f, binding = 1) writeonly uniform imageCube   outputCubemap;
+
+  // constants
+  #define PI 3.14159265359
+
+  vec3 majorAxes[6] = vec3[6](
+    vec3( 1,  0,  0), vec3(-1,  0,  0),
+    vec3( 0,  1,  0), vec3( 0, -1,  0),
+    vec3( 0,  0,  1), vec3( 0,  0, -1)
+  );
+
+  vec3 s[6] = vec3[6](
+    vec3( 0,  0, -1), vec3( 0,  0,  1),
+    vec3( 1,  0,  0), vec3( 1,  0,  0),
+    vec3( 1,  0,  0), vec3(-1,  0,  0)
+  );
+
+  vec3 t[6] = vec3[6](
+    vec3( 0, -1,  0), vec3( 0, -1,  0),
+    vec3( 0,  0,  1), vec3( 0,  0, -1),
+    vec3( 0, -1,  0), vec3( 0, -1,  0)
+  );
+
+  void main() {
+    const uvec2 size = imageSize(outputCubemap);
+
+    if (gl_GlobalInvocationID.x >= size.x || gl_GlobalInvocationID.y >= size.y) {
+        return;
+    }
+
+    const uint  face = gl_GlobalInvocationID.z;
+    const vec2 st = vec2(gl_GlobalInvocationID.xy) / size - 0.5;
+    const vec3 normal = normalize(s[face] * st.s + t[face] * st.t + 0.5 * majorAxes[face]);
+
+    // from https://learnopengl.com/PBR/IBL/Diffuse-irradiance
+    vec3 irradiance = vec3(0.0);
+
+    vec3 up    = vec3(0.0, 1.0, 0.0);
+    vec3 right = cross(up, normal);
+    up         = cross(normal, right);
+         
+    float sampleDelta = 0.05;
+    float nrSamples = 0.0;
+
+    // choose an input level which we will not undersample given our sampleDelta
+    float requiredSize  = 0.5 * PI / sampleDelta;
+    float inputBaseSize = float(textureSize(inputCubemap, 0).x);
+    float inputLevels   = float(textureQueryLevels(inputCubemap));
+    float lod = clamp(log2(inputBaseSize) - log2(requiredSize), 0, inputLevels);
+
+    for (float phi = 0.0; phi < 2.0 * PI; phi += sampleDelta) {
+      for (float theta = 0.0; theta < 0.5 * PI; theta += sampleDelta) {
+        // spherical to cartesian (in tangent space)
+        vec3 tangentSample = vec3(sin(theta) * cos(phi), sin(theta) * sin(phi), cos(theta));
+        // tangent space to world
+        vec3 sampleVec = tangentSample.x * right + tangentSample.y * up + tangentSample.z * normal; 
+
+        irradiance += (textureLod(inputCubemap, sampleVec, lod).rgb) * cos(theta) * sin(theta);
+
+        nrSamples++;
+      }
+    }
+    irradiance = PI * irradiance * (1.0 / float(nrSamples));
+
+    imageStore(outputCubemap, ivec3(gl_GlobalInvocationID), vec4(irradiance, 1.0));
+  }
+)";
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+const std::string REFLECTION_SHADER = R"(
+  #version 450
+
+  // inputs
+  layout (local_size_x = 16, local_size_y = 16, local_size_z = 6) in;
+
+  // outputs
+  layout (binding = 0)                    uniform samplerCube inputCubemap;
+  layout (rgba32f, binding = 1) writeonly uniform imageCube   outputCubemap;
+
+  // push constants
+  layout(push_constant, std430) uniform PushConstants {
+      float mCurrentLevel;
+  } pushConstants;
+
+  // constants
+  #define PI 3.14159265359
+
+  vec3 majorAxes[6] = vec3[6](
+    vec3( 1,  0,  0), vec3(-1,  0,  0),
+    vec3( 0,  1,  0), vec3( 0, -1,  0),
+    vec3( 0,  0,  1), vec3( 0,  0, -1)
+  );
+
+  vec3 s[6] = vec3[6](
+    vec3( 0,  0, -1), vec3( 0,  0,  1),
+    vec3( 1,  0,  0), vec3( 1,  0,  0),
+    vec3( 1,  0,  0), vec3(-1,  0,  0)
+  );
+
+  vec3 t[6] = vec3[6](
+    vec3( 0, -1,  0), vec3( 0, -1,  0),
+    vec3( 0,  0,  1), vec3( 0,  0, -1),
+    vec3( 0, -1,  0), vec3( 0, -1,  0)
+  );
+
+  float DistributionGGX(vec3 N, vec3 H, float roughness) {
+    float a = roughness*roughness;
+    float a2 = a*a;
+    float NdotH = max(dot(N, H), 0.0);
+    float NdotH2 = NdotH*NdotH;
+
+    float nom   = a2;
+    float denom = (NdotH2 * (a2 - 1.0) + 1.0);
+    denom = PI * denom * denom;
+
+    return nom / denom;
+  }
+
+  // http://holger.dammertz.org/stuff/notes_HammersleyOnHemisphere.html
+  // efficient VanDerCorpus calculation.
+  float RadicalInverse_VdC(uint bits) {
+     bits = (bits << 16u) | (bits >> 16u);
+     bits = ((bits & 0x55555555u) << 1u) | ((bits & 0xAAAAAAAAu) >> 1u);
+     bits = ((bits & 0x33333333u) << 2u) | ((bits & 0xCCCCCCCCu) >> 2u);
+     bits = ((bits & 0x0F0F0F0Fu) << 4u) | ((bits & 0xF0F0F0F0u) >> 4u);
+     bits = ((bits & 0x00FF00FFu) << 8u) | ((bits & 0xFF00FF00u) >> 8u);
+     return float(bits) * 2.3283064365386963e-10; // / 0x100000000
+  }
+
+  vec2 Hammersley(uint i, uint N) {
+      return vec2(float(i)/float(N), RadicalInverse_VdC(i));
+  }
+
+  vec3 ImportanceSampleGGX(vec2 Xi, vec3 N, float roughness) {
+    float a = roughness*roughness;
+    
+    float phi = 2.0 * PI * Xi.x;
+    float cosTheta = sqrt((1.0 - Xi.y) / (1.0 + (a*a - 1.0) * Xi.y));
+    float sinTheta = sqrt(1.0 - cosTheta*cosTheta);
+    
+    // from spherical coordinates to cartesian coordinates - halfway vector
+    vec3 H;
+    H.x = cos(phi) * sinTheta;
+    H.y = sin(phi) * sinTheta;
+    H.z = cosTheta;
+    
+    // from tangent-space H vector to world-space sample vector
+    vec3 up          = abs(N.z) < 0.999 ? vec3(0.0, 0.0, 1.0) : vec3(1.0, 0.0, 0.0);
+    vec3 tangent   = normalize(cross(up, N));
+    vec3 bitangent = cross(N, tangent);
+    
+    vec3 sampleVec = tangent * H.x + bitangent * H.y + N * H.z;
+    return normalize(sampleVec);
+  }
+
+  void main() {
+    const uvec2 size = imageSize(outputCubemap);
+
+    if (gl_GlobalInvocationID.x >= size.x || gl_GlobalInvocationID.y >= size.y) {
+        return;
+    }
+
+    const uint  face      = gl_GlobalInvocationID.z;
+    const float maxLevel  = float(textureQueryLevels(inputCubemap));
+    const float roughness = pushConstants.mCurrentLevel / maxLevel;
+
+    const vec2 st = vec2(gl_GlobalInvocationID.xy) / size - 0.5;
+    const vec3 normal = normalize(s[face] * st.s + t[face] * st.t + 0.5 * majorAxes[face]);
+
+    const uint SAMPLE_COUNT = 512u;
+    vec3 prefilteredReflection = vec3(0.0);
+    float totalWeight = 0.0;
+
+    for(uint i = 0u; i < SAMPLE_COUNT; ++i)
+    {
+      // generates a sample vector that's biased towards the preferred alignment direction (importance sampling).
+      vec2 Xi = Hammersley(i, SAMPLE_COUNT);
+      vec3 H = ImportanceSampleGGX(Xi, normal, roughness);
+      vec3 L  = normalize(2.0 * dot(normal, H) * H - normal);
+
+      float NdotL = max(dot(normal, L), 0.0);
+      if(NdotL > 0.0)
+      {
+        // sample from the environment's mip level based on roughness/pdf
+        float D   = DistributionGGX(normal, H, roughness);
+        float NdotH = max(dot(normal, H), 0.0);
+        float HdotV = max(dot(H, normal), 0.0);
+        float pdf = D * NdotH / (4.0 * HdotV) + 0.0001; 
+
+        float resolution = textureSize(inputCubemap, 0).x;
+        float saTexel  = 4.0 * PI / (6.0 * resolution * resolution);
+        float saSample = 1.0 / (float(SAMPLE_COUNT) * pdf + 0.0001);
+
+        float mipLevel = roughness == 0.0 ? 0.0 : 0.5 * log2(saSample / saTexel); 
+        
+        prefilteredReflection += textureLod(inputCubemap, L, mipLevel).rgb * NdotL;
+        totalWeight += NdotL;
+      }
+    }
+
+    prefilteredReflection = prefilteredReflection / totalWeight;
+
+    imageStore(outputCubemap, ivec3(gl_GlobalInvocationID), vec4(prefilteredReflection, 1.0));
+  }
+)";
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+const std::string BRDFLUT_SHADER = R"(
+  #version 450
+
+  // inputs
+  layout (local_size_x = 16, local_size_y = 16) in;
+
+  // outputs
+  layout (rgba32f, set = 0, binding = 0) writeonly uniform image2D outputImage;
+
+  // constants
+  #define PI 3.14159265359
+
+  // Brian Karis s2013_pbs_epic_notes_v2.pdf
+  vec3 ImportanceSampleGGX( vec2 Xi, float Roughness, vec3 N) {
+    float a = Roughness * Roughness;
+    
+    float Phi = 2 * PI * Xi.x;
+    float CosTheta = sqrt( (1.0 - Xi.y) / ( 1.0 + (a*a - 1.0) * Xi.y ) );
+    float SinTheta = sqrt( 1.0 - CosTheta * CosTheta );
+    
+    vec3 H = vec3(SinTheta * cos( Phi ), SinTheta * sin( Phi ), CosTheta);
+    vec3 up = abs(N.z) < 0.999 ? vec3(0,0,1) : vec3(1,0,0);
+
+    vec3 TangentX = normalize( cross( up, N ) );
+    vec3 TangentY = cross( N, TangentX );
+    
+    // Tangent to world space
+    return normalize(TangentX * H.x + TangentY * H.y + N * H.z);
+  }
+
+  // http://holger.dammertz.org/stuff/notes_HammersleyOnHemisphere.html
+  float radicalInverse_VdC(uint bits) {
+    bits = (bits << 16u) | (bits >> 16u);
+    bits = ((bits & 0x55555555u) << 1u) | ((bits & 0xAAAAAAAAu) >> 1u);
+    bits = ((bits & 0x33333333u) << 2u) | ((bits & 0xCCCCCCCCu) >> 2u);
+    bits = ((bits & 0x0F0F0F0Fu) << 4u) | ((bits & 0xF0F0F0F0u) >> 4u);
+    bits = ((bits & 0x00FF00FFu) << 8u) | ((bits & 0xFF00FF00u) >> 8u);
+    
+    return float(bits) * 2.3283064365386963e-10;
+  }
+
+  vec2 Hammersley(uint i, uint n) { 
+    return vec2(float(i)/float(n), radicalInverse_VdC(i));
+  }
+
+  // http://graphicrants.blogspot.com.au/2013/08/specular-brdf-reference.html
+  float GGX(float nDotV, float a) {
+    // lipsryme, http://www.gamedev.net/topic/658769-ue4-ibl-glsl/
+    // http://graphicrants.blogspot.com.au/2013/08/specular-brdf-reference.html
+    float k = a / 2.0;
+    return nDotV / (nDotV * (1.0 - k) + k);
+  } 
+
+  float G_Smith(float Roughness, float nDotV, float nDotL) {
+    // lipsryme, http://www.gamedev.net/topic/658769-ue4-ibl-glsl/ 
+    float a = Roughness * Roughness;
+    return GGX(nDotL, a) * GGX(nDotV, a);
+  }
+
+  vec2 IntegrateBRDF( float Roughness, float NoV , vec3 N) {
+      vec3 V = vec3( sqrt ( 1.0 - NoV * NoV ) //sin
+                   , 0.0
+                   , NoV); // cos
+      float A = 0.0;
+      float B = 0.0;
+      const uint NumSamples = 1024u;
+      for ( uint i = 0u; i < NumSamples; i++ ) {
+          vec2 Xi = Hammersley( i, NumSamples );
+          vec3 H = ImportanceSampleGGX( Xi, Roughness, N );
+          vec3 L = 2.0 * dot(V, H) * H - V;
+          float NoL = clamp((L.z), 0, 1);
+          float NoH = clamp((H.z), 0, 1);
+          float VoH = clamp((dot(V, H)), 0, 1);
+          if ( NoL > 0.0 ) {
+              float G = G_Smith(Roughness, NoV, NoL);
+              float G_Vis = G * VoH / (NoH * NoV);
+              float Fc = pow(1.0 - VoH, 5.0);
+              A += (1.0 - Fc) * G_Vis;
+              B += Fc * G_Vis;
+          }
+      }
+      return vec2(A, B) / float(NumSamples);
+  }
+
+  void main() {
+    ivec2 storePos = ivec2(gl_GlobalInvocationID.xy);
+    ivec2 size = imageSize(outputImage);
+
+    if (storePos.x >= size.x || storePos.y >= size.y) {
+        return;
+    }
+
+    vec2 fragCoord = vec2(storePos) + vec2(0.5);
+    vec2 resolution = vec2(size);
+    vec2 uv = fragCoord / resolution;
+
+    vec3 N = vec3(0,0,1); 
+    float NdotV = uv.x;
+    float Roughness = uv.y;
+
+    vec2 result = IntegrateBRDF(Roughness, NdotV, N);
+
+    imageStore(outputImage, storePos, vec4(result, 0.0, 0.0) );
+  }
+)";
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+vk::ImageCreateInfo getImageInfo(vk::Format format, uint32_t size, uint32_t mipLevels, bool cube) {
+  vk::ImageCreateInfo info;
+  info.imageType     = vk::ImageType::e2D;
+  info.format        = format;
+  info.extent.width  = size;
+  info.extent.height = size;
+  info.extent.depth  = 1;
+  info.mipLevels     = mipLevels;
+  info.arrayLayers   = 1;
+  info.samples       = vk::SampleCountFlagBits::e1;
+  info.tiling        = vk::ImageTiling::eOptimal;
+  info.usage         = vk::ImageUsageFlagBits::eStorage | vk::ImageUsageFlagBits::eSampled;
+  info.sharingMode   = vk::SharingMode::eExclusive;
+  info.initialLayout = vk::ImageLayout::eUndefined;
+
+  // this is required for writing the cache file
+  info.usage |= vk::ImageUsageFlagBits::eTransferSrc;
+
+  if (cube) {
+    info.flags       = vk::ImageCreateFlagBits::eCubeCompatible;
+    info.arrayLayers = 6;
+  }
+
+  return info;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+// The image infos of the Textures which are stored in the cache file, in this order.
+std::array<vk::ImageCreateInfo, 3> getCachedImageInfos(IblBaker::Sizes const& sizes) {
+  return {getImageInfo(vk::Format::eR32G32B32A32Sfloat, sizes.mIrradiance, 1, true),
+      getImageInfo(vk::Format::eR32G32B32A32Sfloat, sizes.mReflection,
+          Texture::getMaxMipmapLevels(sizes.mReflection, sizes.mReflection), true),
+      getImageInfo(vk::Format::eR32G32Sfloat, sizes.mBRDFLuT, 1, false)};
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+// Returns the byte count of all levels of an image with the given info when they are tightly
+// packed. This is the layout which is used by Device::createTexture().
+vk::DeviceSize getDataSize(vk::ImageCreateInfo const& info) {
+  vk::DeviceSize size = 0;
+
+  for (uint32_t i = 0; i < info.mipLevels; ++i) {
+    vk::DeviceSize width  = std::max(info.extent.width >> i, 1u);
+    vk::DeviceSize height = std::max(info.extent.height >> i, 1u);
+    size += width * height * info.arrayLayers * Utils::getByteCount(info.format);
+  }
+
+  return size;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+vk::DeviceSize getCacheDataSize(IblBaker::Sizes const& sizes) {
+  vk::DeviceSize size = 0;
+
+  for (auto const& info : getCachedImageInfos(sizes)) {
+    size += getDataSize(info);
+  }
+
+  return size;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+uint32_t getGroupCount(uint32_t size) {
+  return static_cast<uint32_t>(std::ceil(static_cast<float>(size) / 16.f));
+}
+
+} // namespace
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+struct IblBaker::Job {
+  ~Job() {
+    if (mPixels) {
+      stbi_image_free(mPixels);
+    }
+  }
+
+  std::string mPanoramaFile;
+  std::string mCacheFile;
+  Sizes       mSizes;
+
+  // These are written by the worker thread before mDecoded is set. If the panorama is not an HDR
+  // image which can be decoded by stb, mPixels stays nullptr and it is loaded with
+  // Texture::createFromFile() instead. mCache is only set if it matches mKey.
+  uint64_t                          mKey    = 0;
+  float*                            mPixels = nullptr;
+  int                               mWidth  = 0;
+  int                               mHeight = 0;
+  std::shared_ptr<Core::MappedFile> mCache;
+  std::atomic<bool>                 mDecoded{false};
+};
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+IblBaker::IblBaker(DevicePtr const& device)
+    : mDevice(device)
+    , mMipmapGenerator(MipmapGenerator::create(device))
+    , mPanoramaShader(Shader::create(device))
+    , mIrradianceShader(Shader::create(device))
+    , mReflectionShader(Shader::create(device))
+    , mBRDFLuTShader(Shader::create(device)) {
+
+  ILLUSION_TRACE << "Creating IblBaker." << std::endl;
+
+  mPanoramaShader->addModule(vk::ShaderStageFlagBits::eCompute,
+      GlslCode::create(PANORAMA_SHADER, "IblBaker::recordCubemapFromPanorama"));
+  mIrradianceShader->addModule(vk::ShaderStageFlagBits::eCompute,
+      GlslCode::create(IRRADIANCE_SHADER, "IblBaker::recordIrradiance"));
+  mReflectionShader->addModule(vk::ShaderStageFlagBits::eCompute,
+      GlslCode::create(REFLECTION_SHADER, "IblBaker::recordReflection"));
+  mBRDFLuTShader->addModule(vk::ShaderStageFlagBits::eCompute,
+      GlslCode::create(BRDFLUT_SHADER, "IblBaker::recordBRDFLuT"));
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+IblBaker::~IblBaker() {
+  ILLUSION_TRACE << "Deleting IblBaker." << std::endl;
+
+  // the worker thread may still access the Job and the resources of mCmd must not be destroyed
+  // while it is executed
+  if (mThreadPool) {
+    mThreadPool->waitIdle();
+  }
+
+  if (mFence) {
+    mDevice->waitForFences(*mFence);
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void IblBaker::bake(
+    std::string const& panoramaFile, Sizes const& sizes, std::string const& cacheFile) {
+
+  if (mJob) {
+    throw std::runtime_error(
+        "Failed to bake " + panoramaFile + ": The previous bake has not finished yet!");
+  }
+
+  ILLUSION_TRACE << "Baking image based lighting for " << panoramaFile << "." << std::endl;
+
+  mJob                = std::make_shared<Job>();
+  mJob->mPanoramaFile = panoramaFile;
+  mJob->mCacheFile    = cacheFile;
+  mJob->mSizes        = sizes;
+
+  if (!mThreadPool) {
+    mThreadPool = std::make_unique<Core::ThreadPool>(1);
+  }
+
+  mThreadPool->enqueue([job = mJob]() {
+    Core::MappedFile file(job->mPanoramaFile);
+
+    if (file.isValid()) {
+      job->mKey = Core::hashBytes(CACHE_VERSION, &job->mSizes, sizeof(Sizes));
+      job->mKey = Core::hashBytes(job->mKey, file.getData(), file.getSize());
+
+      if (!job->mCacheFile.empty()) {
+        auto cache = std::make_shared<Core::MappedFile>(job->mCacheFile);
+
+        if (cache->isValid() && cache->getSize() >= sizeof(CacheHeader)) {
+          CacheHeader header;
+          std::memcpy(&header, cache->getData(), sizeof(CacheHeader));
+
+          vk::DeviceSize dataSize = getCacheDataSize(job->mSizes);
+
+          if (std::memcmp(header.mMagic, CACHE_MAGIC, sizeof(CACHE_MAGIC)) == 0 &&
+              header.mVersion == CACHE_VERSION && header.mKey == job->mKey &&
+              header.mDataSize == dataSize &&
+              cache->getSize() >= sizeof(CacheHeader) + dataSize) {
+            job->mCache = cache;
+          }
+        }
+      }
+
+      auto data = file.getData();
+      auto size = static_cast<int>(file.getSize());
+
+      if (stbi_is_hdr_from_memory(data, size)) {
+        int components;
+        job->mPixels =
+            stbi_loadf_from_memory(data, size, &job->mWidth, &job->mHeight, &components, 4);
+      }
+    }
+
+    job->mDecoded = true;
+  });
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+bool IblBaker::update() {
+  if (!mJob) {
+    return true;
+  }
+
+  if (!mCmd) {
+    if (!mJob->mDecoded) {
+      return false;
+    }
+
+    submit();
+  }
+
+  if (mDevice->getHandle()->getFenceStatus(*mFence) != vk::Result::eSuccess) {
+    return false;
+  }
+
+  finish();
+
+  return true;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void IblBaker::waitIdle() {
+  if (!mJob) {
+    return;
+  }
+
+  mThreadPool->waitIdle();
+
+  if (!mCmd) {
+    submit();
+  }
+
+  mDevice->waitForFences(*mFence);
+
+  finish();
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+TexturePtr const& IblBaker::getSkybox() const {
+  return mResults.mSkybox;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+TexturePtr const& IblBaker::getIrradiance() const {
+  return mResults.mIrradiance;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+TexturePtr const& IblBaker::getReflection() const {
+  return mResults.mReflection;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+TexturePtr const& IblBaker::getBRDFLuT() const {
+  return mResults.mBRDFLuT;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+vk::SamplerCreateInfo IblBaker::createPanoramaSamplerInfo() {
+  return vk::SamplerCreateInfo(vk::SamplerCreateFlags(), vk::Filter::eLinear, vk::Filter::eLinear,
+      vk::SamplerMipmapMode::eLinear, vk::SamplerAddressMode::eRepeat,
+      vk::SamplerAddressMode::eClampToEdge);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+TexturePtr IblBaker::recordCubemapFromPanorama(CommandBuffer& cmd, TexturePtr const& panorama,
+    uint32_t size, vk::SamplerCreateInfo samplerInfo, bool generateMipmaps) {
+
+  auto imageInfo = getImageInfo(vk::Format::eR32G32B32A32Sfloat, size, 1, true);
+
+  if (generateMipmaps) {
+    imageInfo.mipLevels = Texture::getMaxMipmapLevels(size, size);
+    imageInfo.usage |= MipmapGenerator::getRequiredUsage(mDevice, imageInfo.format);
+    samplerInfo.maxLod = static_cast<float>(imageInfo.mipLevels);
+  }
+
+  auto outputCubemap = mDevice->createTexture(imageInfo, samplerInfo, vk::ImageViewType::eCube,
+      vk::ImageAspectFlagBits::eColor, vk::ImageLayout::eGeneral);
+
+  cmd.bindingState().reset(0);
+  cmd.bindingState().setTexture(panorama, 0, 0);
+  cmd.bindingState().setStorageImage(outputCubemap, 0, 1);
+  cmd.setShader(mPanoramaShader);
+  cmd.dispatch(getGroupCount(size), getGroupCount(size), 6);
+
+  if (generateMipmaps) {
+    mMipmapGenerator->generate(cmd, outputCubemap, MipmapFilter::eBox);
+  }
+
+  return outputCubemap;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+TexturePtr IblBaker::recordIrradiance(
+    CommandBuffer& cmd, TexturePtr const& inputCubemap, uint32_t size) {
+
+  auto outputCubemap = mDevice->createTexture(
+      getImageInfo(vk::Format::eR32G32B32A32Sfloat, size, 1, true), Device::createSamplerInfo(),
+      vk::ImageViewType::eCube, vk::ImageAspectFlagBits::eColor, vk::ImageLayout::eGeneral);
+
+  cmd.bindingState().reset(0);
+  cmd.bindingState().setTexture(inputCubemap, 0, 0);
+  cmd.bindingState().setStorageImage(outputCubemap, 0, 1);
+  cmd.setShader(mIrradianceShader);
+  cmd.dispatch(getGroupCount(size), getGroupCount(size), 6);
+
+  return outputCubemap;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+TexturePtr IblBaker::recordReflection(
+    CommandBuffer& cmd, TexturePtr const& inputCubemap, uint32_t size) {
+
+  auto imageInfo = getImageInfo(
+      vk::Format::eR32G32B32A32Sfloat, size, Texture::getMaxMipmapLevels(size, size), true);
+
+  auto samplerInfo   = Device::createSamplerInfo();
+  samplerInfo.maxLod = static_cast<float>(imageInfo.mipLevels);
+
+  auto outputCubemap = mDevice->createTexture(imageInfo, samplerInfo, vk::ImageViewType::eCube,
+      vk::ImageAspectFlagBits::eColor, vk::ImageLayout::eGeneral);
+
+  cmd.bindingState().reset(0);
+  cmd.bindingState().setTexture(inputCubemap, 0, 0);
+  cmd.setShader(mReflectionShader);
+
+  for (uint32_t i(0); i < imageInfo.mipLevels; ++i) {
+    auto mipViewInfo                          = outputCubemap->mViewInfo;
+    mipViewInfo.subresourceRange.baseMipLevel = i;
+    mipViewInfo.subresourceRange.levelCount   = 1;
+    auto mipView                              = mDevice->createImageView(mipViewInfo);
+
+    cmd.pushConstants(static_cast<float>(i));
+    cmd.bindingState().setStorageImage(outputCubemap, mipView, 0, 1);
+    cmd.dispatch(getGroupCount(size), getGroupCount(size), 6);
+
+    mLevelViews.emplace_back(mipView);
+
+    size = std::max(size / 2, 1u);
+  }
+
+  return outputCubemap;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+TexturePtr IblBaker::recordBRDFLuT(CommandBuffer& cmd, uint32_t size) {
+
+  auto outputImage = mDevice->createTexture(
+      getImageInfo(vk::Format::eR32G32Sfloat, size, 1, false), Device::createSamplerInfo(),
+      vk::ImageViewType::e2D, vk::ImageAspectFlagBits::eColor, vk::ImageLayout::eGeneral);
+
+  cmd.bindingState().reset(0);
+  cmd.bindingState().setStorageImage(outputImage, 0, 0);
+  cmd.setShader(mBRDFLuTShader);
+  cmd.dispatch(getGroupCount(size), getGroupCount(size), 1);
+
+  return outputImage;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void IblBaker::submit() {
+  auto const& sizes = mJob->mSizes;
+
+  if (mJob->mPixels) {
+    auto imageInfo          = getImageInfo(vk::Format::eR32G32B32A32Sfloat, 1, 1, false);
+    imageInfo.extent.width  = static_cast<uint32_t>(mJob->mWidth);
+    imageInfo.extent.height = static_cast<uint32_t>(mJob->mHeight);
+    imageInfo.usage         = vk::ImageUsageFlagBits::eSampled;
+
+    mPanorama = mDevice->createTexture(imageInfo, createPanoramaSamplerInfo(),
+        vk::ImageViewType::e2D, vk::ImageAspectFlagBits::eColor,
+        vk::ImageLayout::eShaderReadOnlyOptimal, vk::ComponentMapping(),
+        static_cast<vk::DeviceSize>(mJob->mWidth) * mJob->mHeight * 4 * sizeof(float),
+        mJob->mPixels);
+
+    stbi_image_free(mJob->mPixels);
+    mJob->mPixels = nullptr;
+  } else {
+    mPanorama = Texture::createFromFile(
+        mDevice, mJob->mPanoramaFile, createPanoramaSamplerInfo(), false);
+  }
+
+  mCmd = CommandBuffer::create(mDevice, QueueType::eCompute);
+  mCmd->begin(vk::CommandBufferUsageFlagBits::eOneTimeSubmit);
+
+  mPending.mSkybox = recordCubemapFromPanorama(
+      *mCmd, mPanorama, sizes.mSkybox, Device::createSamplerInfo(), true);
+
+  if (mJob->mCache) {
+    ILLUSION_TRACE << "Loading image based lighting from " << mJob->mCacheFile << "."
+                   << std::endl;
+
+    TexturePtr* outputs[] = {&mPending.mIrradiance, &mPending.mReflection, &mPending.mBRDFLuT};
+
+    auto           infos = getCachedImageInfos(sizes);
+    uint8_t const* data  = mJob->mCache->getData() + sizeof(CacheHeader);
+
+    for (size_t i(0); i < infos.size(); ++i) {
+      auto samplerInfo   = Device::createSamplerInfo();
+      samplerInfo.maxLod = static_cast<float>(infos[i].mipLevels);
+      infos[i].usage     = vk::ImageUsageFlagBits::eSampled;
+
+      auto viewType = infos[i].arrayLayers == 6 ? vk::ImageViewType::eCube : vk::ImageViewType::e2D;
+      auto size     = getDataSize(infos[i]);
+
+      *outputs[i] = mDevice->createTexture(infos[i], samplerInfo, viewType,
+          vk::ImageAspectFlagBits::eColor, vk::ImageLayout::eShaderReadOnlyOptimal,
+          vk::ComponentMapping(), size, data);
+      data += size;
+    }
+  } else {
+    mPending.mIrradiance = recordIrradiance(*mCmd, mPending.mSkybox, sizes.mIrradiance);
+    mPending.mReflection = recordReflection(*mCmd, mPending.mSkybox, sizes.mReflection);
+    mPending.mBRDFLuT    = recordBRDFLuT(*mCmd, sizes.mBRDFLuT);
+
+    if (!mJob->mCacheFile.empty()) {
+      recordReadback();
+    }
+  }
+
+  // all results will be sampled by fragment shaders
+  for (auto const& texture :
+      {mPending.mSkybox, mPending.mIrradiance, mPending.mReflection, mPending.mBRDFLuT}) {
+    mCmd->transitionImage(texture, vk::ImageLayout::eShaderReadOnlyOptimal,
+        vk::PipelineStageFlagBits::eFragmentShader, vk::AccessFlagBits::eShaderRead);
+  }
+
+  mCmd->flushBarriers();
+  mCmd->end();
+
+  mFence = mDevice->createFence(vk::FenceCreateFlags());
+  mCmd->submit({}, {}, {}, *mFence);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void IblBaker::recordReadback() {
+  mReadback = mDevice->createBackedBuffer(vk::BufferUsageFlagBits::eTransferDst,
+      vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent,
+      getCacheDataSize(mJob->mSizes));
+
+  vk::DeviceSize offset = 0;
+
+  for (auto const& texture : {mPending.mIrradiance, mPending.mReflection, mPending.mBRDFLuT}) {
+    auto const&                      info = texture->mImageInfo;
+    std::vector<vk::BufferImageCopy> regions;
+
+    for (uint32_t i = 0; i < info.mipLevels; ++i) {
+      uint32_t width  = std::max(info.extent.width >> i, 1u);
+      uint32_t height = std::max(info.extent.height >> i, 1u);
+
+      vk::BufferImageCopy region;
+      region.bufferOffset     = offset;
+      region.imageSubresource = {vk::ImageAspectFlagBits::eColor, i, 0, info.arrayLayers};
+      region.imageExtent      = vk::Extent3D(width, height, 1);
+      regions.push_back(region);
+
+      offset += static_cast<vk::DeviceSize>(width) * height * info.arrayLayers *
+                Utils::getByteCount(info.format);
+    }
+
+    mCmd->copyImageToBuffer(texture, mReadback, regions);
+  }
+
+  // make the copies visible to the host once the fence is signaled
+  mCmd->accessBuffer(mReadback, vk::PipelineStageFlagBits::eHost, vk::AccessFlagBits::eHostRead);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void IblBaker::finish() {
+  if (mReadback) {
+    CacheHeader header;
+    std::memcpy(header.mMagic, CACHE_MAGIC, sizeof(CACHE_MAGIC));
+    header.mVersion  = CACHE_VERSION;
+    header.mReserved = 0;
+    header.mKey      = mJob->mKey;
+    header.mDataSize = getCacheDataSize(mJob->mSizes);
+
+    // The cache is written to a temporary file first and then renamed, so that other processes
+    // never see a partially written cache.
+    std::string tmpFile = Core::FileSystem::getTemporaryFileName(mJob->mCacheFile);
+    bool        success = false;
+
+    {
+      std::ofstream stream(tmpFile, std::ios::out | std::ios::binary);
+      stream.write(reinterpret_cast<char const*>(&header), sizeof(CacheHeader));
+      stream.write(reinterpret_cast<char const*>(mReadback->mMappedData),
+          static_cast<std::streamsize>(header.mDataSize));
+      success = static_cast<bool>(stream);
+    }
+
+    if (success) {
+      Core::FileSystem::replaceFile(tmpFile, mJob->mCacheFile);
+    } else {
+      ILLUSION_WARNING << "Failed to write image based lighting cache " << mJob->mCacheFile << "!"
+                       << std::endl;
+      std::remove(tmpFile.c_str());
+    }
+  }
+
+  mResults = mPending;
+  mPending = Results();
+
+  mLevelViews.clear();
+  mJob.reset();
+  mCmd.reset();
+  mFence.reset();
+  mPanorama.reset();
+  mReadback.reset();
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+} // namespace Illusion::Graphics
@@ -0,0 +1,135 @@
+////////////////////////////////////////////////////////////////////////////////////////////////////
+//                                                                                                //
+//    _)  |  |            _)                This code may be used and modified under the terms    //
+//     |  |  |  |  | (_-<  |   _ \    \     of the MIT license. See the LICENSE file for details. //
+//    _| _| _| \_,_| ___/ _| \___/ _| _|    Copyright (c) 2018-2019 Simon Schneegans              //
+//                                                                                                //
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#ifndef ILLUSION_GRAPHICS_IBL_BAKER_HPP
+#define ILLUSION_GRAPHICS_IBL_BAKER_HPP
+
+#include "../Core/ThreadPool.hpp"
+#include "fwd.hpp"
+
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace Illusion::Graphics {
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// The IblBaker computes the Textures required for image based lighting from an equirectangular   //
+// HDR panorama: a skybox cubemap with mipmaps, a prefiltered irradiance cubemap, a prefiltered   //
+// reflection cubemap and the BRDF lookup table. bake() reads and decodes the panorama on a       //
+// worker thread. update() then records all stages into one CommandBuffer of the compute queue    //
+// and submits it without waiting; it has to be called regularly (e.g. once a frame) by the       //
+// thread which uses the Device until the results are available. The skybox is always computed,   //
+// as this is cheap. The other Textures can be stored in a cache file; they are read from there   //
+// if the file has been written for the same panorama (by content) and the same Sizes.            //
+// The record*() methods can be used to record individual stages into your own CommandBuffers.    //
+// They change the current Shader of the CommandBuffer and reset the bindings of descriptor set   //
+// 0. The IblBaker has to be kept alive until these CommandBuffers have been executed.            //
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+class IblBaker {
+
+ public:
+  // The resolutions of the resulting Textures.
+  struct Sizes {
+    uint32_t mSkybox     = 1024;
+    uint32_t mIrradiance = 64;
+    uint32_t mReflection = 128;
+    uint32_t mBRDFLuT    = 128;
+  };
+
+  // Syntactic sugar to create a std::shared_ptr for this class
+  template <typename... Args>
+  static IblBakerPtr create(Args&&... args) {
+    return std::make_shared<IblBaker>(args...);
+  };
+
+  explicit IblBaker(DevicePtr const& device);
+  virtual ~IblBaker();
+
+  // Starts baking the given panorama. If cacheFile is not empty, it is read if it matches the
+  // panorama and the sizes; else it is written once the results have been computed. The results
+  // of a previous bake stay available until the new one has finished. Throws a std::runtime_error
+  // if another bake has not finished yet.
+  void bake(std::string const& panoramaFile, Sizes const& sizes = Sizes(),
+      std::string const& cacheFile = "");
+
+  // Submits the CommandBuffer once the panorama has been decoded and finishes the bake once it has
+  // been executed. Returns true if there is no bake in progress anymore. This never blocks.
+  bool update();
+
+  // Blocks until the current bake has finished.
+  void waitIdle();
+
+  // These return the results of the last finished bake. They are in eShaderReadOnlyOptimal layout
+  // and nullptr before the first bake has finished.
+  TexturePtr const& getSkybox() const;
+  TexturePtr const& getIrradiance() const;
+  TexturePtr const& getReflection() const;
+  TexturePtr const& getBRDFLuT() const;
+
+  // Returns the sampler parameters which should be used for panoramas: they repeat horizontally
+  // and are clamped vertically.
+  static vk::SamplerCreateInfo createPanoramaSamplerInfo();
+
+  // These record the individual stages. The resulting Textures are in eGeneral layout, except for
+  // the skybox if generateMipmaps is set; it is in eShaderReadOnlyOptimal layout then. The input
+  // cubemaps of recordIrradiance() and recordReflection() should have mipmaps.
+  TexturePtr recordCubemapFromPanorama(CommandBuffer& cmd, TexturePtr const& panorama,
+      uint32_t size, vk::SamplerCreateInfo samplerInfo, bool generateMipmaps);
+  TexturePtr recordIrradiance(CommandBuffer& cmd, TexturePtr const& inputCubemap, uint32_t size);
+  TexturePtr recordReflection(CommandBuffer& cmd, TexturePtr const& inputCubemap, uint32_t size);
+  TexturePtr recordBRDFLuT(CommandBuffer& cmd, uint32_t size);
+
+ private:
+  // The state which is shared with the worker thread.
+  struct Job;
+
+  struct Results {
+    TexturePtr mSkybox;
+    TexturePtr mIrradiance;
+    TexturePtr mReflection;
+    TexturePtr mBRDFLuT;
+  };
+
+  // Creates the panorama Texture, records and submits mCmd.
+  void submit();
+
+  // Records the copies of the irradiance, reflection and BRDF Textures to mReadback.
+  void recordReadback();
+
+  // Writes mReadback to the cache file, releases all temporary resources and publishes mPending.
+  void finish();
+
+  DevicePtr          mDevice;
+  MipmapGeneratorPtr mMipmapGenerator;
+  ShaderPtr          mPanoramaShader;
+  ShaderPtr          mIrradianceShader;
+  ShaderPtr          mReflectionShader;
+  ShaderPtr          mBRDFLuTShader;
+
+  // The per-level views of the reflection cubemaps; they are released when a bake finishes.
+  std::vector<vk::ImageViewPtr> mLevelViews;
+
+  // The worker thread is only started by the first call to bake().
+  std::unique_ptr<Core::ThreadPool> mThreadPool;
+
+  // These are only valid while a bake is in progress.
+  std::shared_ptr<Job> mJob;
+  CommandBufferPtr     mCmd;
+  vk::FencePtr         mFence;
+  TexturePtr           mPanorama;
+  BackedBufferPtr      mReadback;
+  Results              mPending;
+
+  Results mResults;
+};
+
+} // namespace Illusion::Graphics
+
+#endif // ILLUSION_GRAPHICS_IBL_BAKER_HPP
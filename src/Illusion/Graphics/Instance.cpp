@@ -72,19 +72,31 @@ bool checkValidationLayerSupport() {
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////
 
-std::vector<const char*> getRequiredInstanceExtensions(bool debugMode) {
-  unsigned int glfwExtensionCount{0};
-  const char** glfwExtensions{glfwGetRequiredInstanceExtensions(&glfwExtensionCount)};
-
+std::vector<const char*> getRequiredInstanceExtensions(bool debugMode, bool headless) {
   std::vector<const char*> extensions;
-  for (unsigned int i = 0; i < glfwExtensionCount; ++i) {
-    extensions.push_back(glfwExtensions[i]);
+
+  // the surface extensions are only required for presenting to a Window
+  if (!headless) {
+    unsigned int glfwExtensionCount{0};
+    const char** glfwExtensions{glfwGetRequiredInstanceExtensions(&glfwExtensionCount)};
+
+    for (unsigned int i = 0; i < glfwExtensionCount; ++i) {
+      extensions.push_back(glfwExtensions[i]);
+    }
   }
 
   if (debugMode) {
     extensions.push_back(VK_EXT_DEBUG_REPORT_EXTENSION_NAME);
   }
 
+  // this is required to query the support for VK_EXT_descriptor_indexing
+  for (auto const& extension : vk::enumerateInstanceExtensionProperties()) {
+    if (std::string(extension.extensionName) ==
+        VK_KHR_GET_PHYSICAL_DEVICE_PROPERTIES_2_EXTENSION_NAME) {
+      extensions.push_back(VK_KHR_GET_PHYSICAL_DEVICE_PROPERTIES_2_EXTENSION_NAME);
+    }
+  }
+
   return extensions;
 }
 
@@ -94,8 +106,9 @@ std::vector<const char*> getRequiredInstanceExtensions(bool debugMode) {
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////
 
-Instance::Instance(std::string const& app, bool debugMode)
+Instance::Instance(std::string const& app, bool debugMode, bool headless)
     : mDebugMode(debugMode)
+    , mHeadless(headless)
     , mInstance(createInstance("Illusion", app))
     , mDebugCallback(createDebugCallback()) {
 
@@ -103,7 +116,7 @@ Instance::Instance(std::string const& app, bool debugMode)
 
   for (auto const& vkPhysicalDevice : mInstance->enumeratePhysicalDevices()) {
     mPhysicalDevices.push_back(
-        std::make_shared<PhysicalDevice>(*mInstance.get(), vkPhysicalDevice));
+        std::make_shared<PhysicalDevice>(*mInstance.get(), vkPhysicalDevice, mHeadless));
   }
 }
 
@@ -124,6 +137,10 @@ PhysicalDevicePtr Instance::getPhysicalDevice(std::vector<std::string> const& ex
     auto availableExtensions = physicalDevice->enumerateDeviceExtensionProperties();
     std::set<std::string> requiredExtensions(extensions.begin(), extensions.end());
 
+    if (mHeadless) {
+      requiredExtensions.erase(VK_KHR_SWAPCHAIN_EXTENSION_NAME);
+    }
+
     for (auto const& extension : availableExtensions) {
       requiredExtensions.erase(extension.extensionName);
     }
@@ -138,9 +155,14 @@ PhysicalDevicePtr Instance::getPhysicalDevice(std::vector<std::string> const& ex
 
   throw std::runtime_error("Failed to find a suitable vulkan device!");
 }
+
 ////////////////////////////////////////////////////////////////////////////////////////////////////
 
 vk::SurfaceKHRPtr Instance::createSurface(GLFWwindow* window) const {
+  if (mHeadless) {
+    throw std::runtime_error("Failed to create window surface: The Instance is headless!");
+  }
+
   VkSurfaceKHR tmp;
   if (glfwCreateWindowSurface(*mInstance, window, nullptr, &tmp) != VK_SUCCESS) {
     throw std::runtime_error("Failed to create window surface!");
@@ -159,9 +181,15 @@ vk::SurfaceKHRPtr Instance::createSurface(GLFWwindow* window) const {
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////
 
+bool Instance::getIsHeadless() const {
+  return mHeadless;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
 vk::InstancePtr Instance::createInstance(std::string const& engine, std::string const& app) const {
 
-  if (!glfwInitialized) {
+  if (!mHeadless && !glfwInitialized) {
     if (!glfwInit()) {
       throw std::runtime_error("Failed to initialize GLFW.");
     }
@@ -185,8 +213,18 @@ vk::InstancePtr Instance::createInstance(std::string const& engine, std::string
   appInfo.engineVersion      = VK_MAKE_VERSION(1, 0, 0);
   appInfo.apiVersion         = VK_API_VERSION_1_0;
 
+  // Vulkan 1.1 is requested if the loader supports it, some extensions (for example
+  // VK_EXT_mesh_shader) require it. Devices which only support Vulkan 1.0 can still be used.
+  auto enumerateInstanceVersion =
+      (PFN_vkEnumerateInstanceVersion)vkGetInstanceProcAddr(nullptr, "vkEnumerateInstanceVersion");
+  uint32_t loaderVersion = VK_API_VERSION_1_0;
+  if (enumerateInstanceVersion && enumerateInstanceVersion(&loaderVersion) == VK_SUCCESS &&
+      loaderVersion >= VK_API_VERSION_1_1) {
+    appInfo.apiVersion = VK_API_VERSION_1_1;
+  }
+
   // find required extensions
-  auto extensions(getRequiredInstanceExtensions(mDebugMode));
+  auto extensions(getRequiredInstanceExtensions(mDebugMode, mHeadless));
 
   // create instance
   vk::InstanceCreateInfo info;
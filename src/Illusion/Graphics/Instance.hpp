@@ -20,6 +20,9 @@ namespace Illusion::Graphics {
 // constructor requires nothing more than a name to identify your application.                    //
 // It can then be used to get a PhysicalDevice which is required to create a Device. Once you     //
 // have a Device, you can create all othe Vulkan resources.                                       //
+// A headless Instance neither initializes GLFW nor enables any surface extension. It can be used //
+// on machines without a display, for example for rendering to offscreen RenderPasses on a render //
+// farm. Windows cannot be opened in this case.                                                   //
 ////////////////////////////////////////////////////////////////////////////////////////////////////
 
 class Instance {
@@ -32,21 +35,25 @@ class Instance {
   };
 
   // When debugMode is set to true, validation layers will be loaded.
-  explicit Instance(std::string const& appName, bool debugMode = true);
+  explicit Instance(std::string const& appName, bool debugMode = true, bool headless = false);
   virtual ~Instance();
 
-  // Tries to find a physical device which supports the given extensions.
+  // Tries to find a physical device which supports the given extensions. A headless Instance
+  // ignores VK_KHR_swapchain in the list, as no surface can be presented to anyway.
   PhysicalDevicePtr getPhysicalDevice(
       std::vector<std::string> const& extensions = {VK_KHR_SWAPCHAIN_EXTENSION_NAME}) const;
 
-  // This is used by the Window class.
+  // This is used by the Window class. Throws a std::runtime_error if the Instance is headless.
   vk::SurfaceKHRPtr createSurface(GLFWwindow* window) const;
 
+  bool getIsHeadless() const;
+
  private:
   vk::InstancePtr createInstance(std::string const& engine, std::string const& app) const;
   vk::DebugReportCallbackEXTPtr createDebugCallback() const;
 
   bool mDebugMode = false;
+  bool mHeadless  = false;
 
   vk::InstancePtr                mInstance;
   vk::DebugReportCallbackEXTPtr  mDebugCallback;
@@ -0,0 +1,239 @@
+////////////////////////////////////////////////////////////////////////////////////////////////////
+//                                                                                                //
+//    _)  |  |            _)                This code may be used and modified under the terms    //
+//     |  |  |  |  | (_-<  |   _ \    \     of the MIT license. See the LICENSE file for details. //
+//    _| _| _| \_,_| ___/ _| \___/ _| _|    Copyright (c) 2018-2019 Simon Schneegans              //
+//                                                                                                //
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include "LightClusterer.hpp"
+
+#include "../Core/Logger.hpp"
+#include "BackedBuffer.hpp"
+#include "CommandBuffer.hpp"
+#include "Device.hpp"
+#include "Shader.hpp"
+#include "ShaderSource.hpp"
+
+#include <cmath>
+#include <iostream>
+
+namespace Illusion::Graphics {
+
+namespace {
+
+// This matches the std140 layout of the ClusterUniforms in the shaders.
+struct ClusterUniforms {
+  glm::mat4  mViewMatrix;
+  glm::mat4  mInverseProjection;
+  glm::uvec4 mGridSize;     // xyz: number of clusters, w: tile size in pixels
+  glm::vec4  mDepthSlicing; // x: scale, y: bias, z: near, w: far
+  glm::vec2  mExtent;
+  uint32_t   mLightCount;
+};
+
+// The lights are processed in batches of 64; each invocation of a workgroup transforms one light
+// of a batch to view space and stores it in shared memory, then all invocations test the whole
+// batch against their cluster.
+const std::string CLUSTER_SHADER = R"(
+  #version 450
+
+  layout (local_size_x = 64) in;
+
+  // This has to match LightClusterer::MAX_LIGHTS_PER_CLUSTER.
+  const uint MAX_LIGHTS_PER_CLUSTER = 128;
+
+  struct PointLight {
+    vec3  mPosition;
+    float mRadius;
+    vec3  mColor;
+    float mIntensity;
+  };
+
+  layout (binding = 0) uniform ClusterUniforms {
+    mat4  mViewMatrix;
+    mat4  mInverseProjection;
+    uvec4 mGridSize;
+    vec4  mDepthSlicing;
+    vec2  mExtent;
+    uint  mLightCount;
+  } uniforms;
+
+  layout (binding = 1, std430) readonly  buffer Lights       { PointLight lights[]; };
+  layout (binding = 2, std430) writeonly buffer LightCounts  { uint lightCounts[]; };
+  layout (binding = 3, std430) writeonly buffer LightIndices { uint lightIndices[]; };
+
+  shared vec4 viewSpaceLights[64];
+
+  // returns the view space position of the given pixel with a depth of one
+  vec3 getViewRay(vec2 pixel) {
+    vec2 ndc = pixel / uniforms.mExtent * 2.0 - 1.0;
+    vec4 p   = uniforms.mInverseProjection * vec4(ndc, 1.0, 1.0);
+    return p.xyz / -p.z;
+  }
+
+  float getSliceDepth(uint slice) {
+    float nearClip = uniforms.mDepthSlicing.z;
+    float farClip  = uniforms.mDepthSlicing.w;
+    return nearClip * pow(farClip / nearClip, float(slice) / float(uniforms.mGridSize.z));
+  }
+
+  void main() {
+    uvec3 grid    = uniforms.mGridSize.xyz;
+    uint  cluster = gl_GlobalInvocationID.x;
+    bool  valid   = cluster < grid.x * grid.y * grid.z;
+
+    // the view space bounding box of the cluster
+    vec3 aabbMin = vec3(0.0);
+    vec3 aabbMax = vec3(0.0);
+
+    if (valid) {
+      uvec3 c = uvec3(cluster % grid.x, (cluster / grid.x) % grid.y, cluster / (grid.x * grid.y));
+
+      vec3 rayMin = getViewRay(vec2(c.xy * uniforms.mGridSize.w));
+      vec3 rayMax = getViewRay(vec2((c.xy + 1u) * uniforms.mGridSize.w));
+
+      float depthNear = getSliceDepth(c.z);
+      float depthFar  = getSliceDepth(c.z + 1u);
+
+      aabbMin = min(min(rayMin * depthNear, rayMin * depthFar),
+                    min(rayMax * depthNear, rayMax * depthFar));
+      aabbMax = max(max(rayMin * depthNear, rayMin * depthFar),
+                    max(rayMax * depthNear, rayMax * depthFar));
+    }
+
+    uint count = 0;
+
+    for (uint first = 0; first < uniforms.mLightCount; first += 64) {
+      uint i = first + gl_LocalInvocationIndex;
+
+      if (i < uniforms.mLightCount) {
+        vec4 position = uniforms.mViewMatrix * vec4(lights[i].mPosition, 1.0);
+        viewSpaceLights[gl_LocalInvocationIndex] = vec4(position.xyz, lights[i].mRadius);
+      }
+
+      barrier();
+
+      uint batchSize = min(64u, uniforms.mLightCount - first);
+
+      for (uint j = 0; valid && j < batchSize && count < MAX_LIGHTS_PER_CLUSTER; ++j) {
+        vec4 light   = viewSpaceLights[j];
+        vec3 closest = clamp(light.xyz, aabbMin, aabbMax);
+        vec3 delta   = closest - light.xyz;
+
+        if (dot(delta, delta) <= light.w * light.w) {
+          lightIndices[cluster * MAX_LIGHTS_PER_CLUSTER + count++] = first + j;
+        }
+      }
+
+      barrier();
+    }
+
+    if (valid) {
+      lightCounts[cluster] = count;
+    }
+  }
+)";
+
+uint32_t getGroupCount(uint32_t size, uint32_t groupSize) {
+  return (size + groupSize - 1) / groupSize;
+}
+
+} // namespace
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+LightClusterer::LightClusterer(DevicePtr const& device)
+    : mDevice(device)
+    , mClusterShader(Shader::create(device)) {
+
+  ILLUSION_TRACE << "Creating LightClusterer." << std::endl;
+
+  mClusterShader->addModule(vk::ShaderStageFlagBits::eCompute,
+      GlslCode::create(CLUSTER_SHADER, "LightClusterer::cluster"));
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+LightClusterer::~LightClusterer() {
+  ILLUSION_TRACE << "Deleting LightClusterer." << std::endl;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void LightClusterer::cluster(CommandBuffer& cmd, TransientAllocator& allocator,
+    std::vector<PointLight> const& lights, glm::mat4 const& viewMatrix,
+    glm::mat4 const& projectionMatrix, glm::uvec2 const& extent, float nearClip, float farClip) {
+
+  mGridSize = glm::uvec3((extent.x + TILE_SIZE - 1) / TILE_SIZE,
+      (extent.y + TILE_SIZE - 1) / TILE_SIZE, DEPTH_SLICES);
+
+  uint32_t clusterCount = mGridSize.x * mGridSize.y * mGridSize.z;
+
+  if (!mLightCounts || mLightCounts->mBufferInfo.size < sizeof(uint32_t) * clusterCount) {
+    ILLUSION_DEBUG << "Creating light buffers for " << clusterCount
+                   << " clusters for LightClusterer." << std::endl;
+
+    mLightCounts = mDevice->createBackedBuffer(vk::BufferUsageFlagBits::eStorageBuffer,
+        vk::MemoryPropertyFlagBits::eDeviceLocal, sizeof(uint32_t) * clusterCount);
+    mLightIndices = mDevice->createBackedBuffer(vk::BufferUsageFlagBits::eStorageBuffer,
+        vk::MemoryPropertyFlagBits::eDeviceLocal,
+        sizeof(uint32_t) * clusterCount * MAX_LIGHTS_PER_CLUSTER);
+  }
+
+  // the slice of a view space depth d is log(d) * scale + bias
+  float logRatio = std::log(farClip / nearClip);
+
+  ClusterUniforms uniforms;
+  uniforms.mViewMatrix        = viewMatrix;
+  uniforms.mInverseProjection = glm::inverse(projectionMatrix);
+  uniforms.mGridSize          = glm::uvec4(mGridSize, TILE_SIZE);
+  uniforms.mDepthSlicing      = glm::vec4(DEPTH_SLICES / logRatio,
+      -static_cast<float>(DEPTH_SLICES) * std::log(nearClip) / logRatio, nearClip, farClip);
+  uniforms.mExtent     = glm::vec2(extent);
+  uniforms.mLightCount = static_cast<uint32_t>(lights.size());
+
+  mUniforms = allocator.addData(uniforms);
+
+  // the buffer contains at least one element, so it can always be bound
+  if (lights.empty()) {
+    mLights = allocator.allocate(sizeof(PointLight));
+  } else {
+    mLights = allocator.addData(
+        reinterpret_cast<uint8_t const*>(lights.data()), sizeof(PointLight) * lights.size());
+  }
+
+  cmd.setShader(mClusterShader);
+  bind(cmd, 0, 0);
+  cmd.dispatch(getGroupCount(clusterCount, 64));
+
+  cmd.accessBuffer(mLightCounts, vk::PipelineStageFlagBits::eFragmentShader,
+      vk::AccessFlagBits::eShaderRead);
+  cmd.accessBuffer(mLightIndices, vk::PipelineStageFlagBits::eFragmentShader,
+      vk::AccessFlagBits::eShaderRead);
+
+  cmd.bindingState().reset(0);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void LightClusterer::bind(CommandBuffer& cmd, uint32_t set, uint32_t firstBinding) const {
+  cmd.bindingState().setUniformBuffer(
+      mUniforms.mBuffer, mUniforms.mSize, mUniforms.mOffset, set, firstBinding);
+  cmd.bindingState().setStorageBuffer(
+      mLights.mBuffer, mLights.mSize, mLights.mOffset, set, firstBinding + 1);
+  cmd.bindingState().setStorageBuffer(
+      mLightCounts, mLightCounts->mBufferInfo.size, 0, set, firstBinding + 2);
+  cmd.bindingState().setStorageBuffer(
+      mLightIndices, mLightIndices->mBufferInfo.size, 0, set, firstBinding + 3);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+glm::uvec3 const& LightClusterer::getGridSize() const {
+  return mGridSize;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+} // namespace Illusion::Graphics
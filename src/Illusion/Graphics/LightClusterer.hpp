@@ -0,0 +1,91 @@
+////////////////////////////////////////////////////////////////////////////////////////////////////
+//                                                                                                //
+//    _)  |  |            _)                This code may be used and modified under the terms    //
+//     |  |  |  |  | (_-<  |   _ \    \     of the MIT license. See the LICENSE file for details. //
+//    _| _| _| \_,_| ___/ _| \___/ _| _|    Copyright (c) 2018-2019 Simon Schneegans              //
+//                                                                                                //
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#ifndef ILLUSION_GRAPHICS_LIGHT_CLUSTERER_HPP
+#define ILLUSION_GRAPHICS_LIGHT_CLUSTERER_HPP
+
+#include "TransientAllocator.hpp"
+
+#include <glm/glm.hpp>
+#include <vector>
+
+namespace Illusion::Graphics {
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// The LightClusterer bins point lights into a three-dimensional grid of view space clusters for  //
+// clustered forward shading. The screen is divided into tiles of TILE_SIZE x TILE_SIZE pixels,   //
+// the view frustum of each tile is divided into DEPTH_SLICES slices whose depth grows            //
+// exponentially from the near to the far plane. A compute shader tests the bounding sphere of    //
+// each light against the bounding box of each cluster and stores the indices of at most          //
+// MAX_LIGHTS_PER_CLUSTER intersecting lights. A fragment shader then only has to evaluate the    //
+// lights of its cluster, so that the per-pixel cost hardly depends on the total number of        //
+// lights. See examples/data/shaders/ClusteredLights.glsl for the shader side.                    //
+// The lights are uploaded with a TransientAllocator each frame, the cluster data is stored in    //
+// device-local buffers of the LightClusterer. Hence each frame in flight needs its own           //
+// LightClusterer, just like its own TransientAllocator.                                          //
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+class LightClusterer {
+
+ public:
+  // This matches the std430 layout of the PointLight struct in the shaders. The position is given
+  // in world space; the light has no influence beyond mRadius.
+  struct PointLight {
+    glm::vec3 mPosition;
+    float     mRadius;
+    glm::vec3 mColor;
+    float     mIntensity;
+  };
+
+  static constexpr uint32_t TILE_SIZE              = 64;
+  static constexpr uint32_t DEPTH_SLICES           = 24;
+  static constexpr uint32_t MAX_LIGHTS_PER_CLUSTER = 128;
+
+  // Syntactic sugar to create a std::shared_ptr for this class
+  template <typename... Args>
+  static LightClustererPtr create(Args&&... args) {
+    return std::make_shared<LightClusterer>(args...);
+  };
+
+  explicit LightClusterer(DevicePtr const& device);
+  virtual ~LightClusterer();
+
+  // Uploads the lights and records the compute dispatch which assigns them to the clusters. This
+  // has to be called outside of RenderPasses. The clipping distances have to match the
+  // projection, they determine the depth of the slices. The barriers required for reading the
+  // results in fragment shaders are pending afterwards and are recorded by the next
+  // beginRenderPass(). This changes the current Shader of the CommandBuffer and resets the bindings
+  // of descriptor set 0.
+  void cluster(CommandBuffer& cmd, TransientAllocator& allocator,
+      std::vector<PointLight> const& lights, glm::mat4 const& viewMatrix,
+      glm::mat4 const& projectionMatrix, glm::uvec2 const& extent, float nearClip, float farClip);
+
+  // Binds the uniforms, the lights, the light counts and the light indices of the last cluster()
+  // to four consecutive bindings of the given descriptor set, starting at firstBinding.
+  void bind(CommandBuffer& cmd, uint32_t set, uint32_t firstBinding) const;
+
+  // The number of clusters in x, y and z direction of the last cluster().
+  glm::uvec3 const& getGridSize() const;
+
+ private:
+  DevicePtr mDevice;
+  ShaderPtr mClusterShader;
+
+  glm::uvec3 mGridSize = glm::uvec3(0);
+
+  // These are reallocated if the number of clusters grows.
+  BackedBufferPtr mLightCounts;
+  BackedBufferPtr mLightIndices;
+
+  TransientAllocator::Allocation mUniforms;
+  TransientAllocator::Allocation mLights;
+};
+
+} // namespace Illusion::Graphics
+
+#endif // ILLUSION_GRAPHICS_LIGHT_CLUSTERER_HPP
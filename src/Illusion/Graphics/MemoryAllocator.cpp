@@ -0,0 +1,492 @@
+////////////////////////////////////////////////////////////////////////////////////////////////////
+//                                                                                                //
+//    _)  |  |            _)                This code may be used and modified under the terms    //
+//     |  |  |  |  | (_-<  |   _ \    \     of the MIT license. See the LICENSE file for details. //
+//    _| _| _| \_,_| ___/ _| \___/ _| _|    Copyright (c) 2018-2019 Simon Schneegans              //
+//                                                                                                //
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include "MemoryAllocator.hpp"
+
+#include "../Core/EnumCast.hpp"
+#include "../Core/Logger.hpp"
+#include "DeletionQueue.hpp"
+#include "PhysicalDevice.hpp"
+#include "VulkanPtr.hpp"
+
+#include <algorithm>
+#include <iomanip>
+#include <iostream>
+
+namespace Illusion::Graphics {
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+namespace {
+// The smallest range the buddy allocator will hand out. This is larger than all common
+// minUniformBufferOffsetAlignment and minStorageBufferOffsetAlignment values.
+const vk::DeviceSize MIN_ALLOCATION_SIZE = 256;
+} // namespace
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+float MemoryAllocator::Statistics::getFragmentation() const {
+  if (mBytesFree == 0) {
+    return 0.f;
+  }
+
+  return 1.f - static_cast<float>(mLargestFreeRange) / static_cast<float>(mBytesFree);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+MemoryAllocator::MemoryAllocator(vk::DevicePtr const& device,
+    PhysicalDevicePtr const& physicalDevice, DeletionQueuePtr const& deletionQueue,
+    vk::DeviceSize blockSize)
+    : mDevice(device)
+    , mPhysicalDevice(physicalDevice)
+    , mDeletionQueue(deletionQueue)
+    , mBlockSize(blockSize)
+    , mMemoryProperties(physicalDevice->getMemoryProperties()) {
+
+  ILLUSION_TRACE << "Creating MemoryAllocator." << std::endl;
+
+  if (mBlockSize < MIN_ALLOCATION_SIZE || (mBlockSize & (mBlockSize - 1)) != 0) {
+    throw std::runtime_error("Failed to create MemoryAllocator: Block size must be a power of two!");
+  }
+
+  mHeapBytesUsed.resize(mMemoryProperties.memoryHeapCount, 0);
+  mHeapBytesReserved.resize(mMemoryProperties.memoryHeapCount, 0);
+  mHeapWarned.resize(mMemoryProperties.memoryHeapCount, false);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+MemoryAllocator::~MemoryAllocator() {
+  ILLUSION_TRACE << "Deleting MemoryAllocator." << std::endl;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+MemoryAllocator::Allocation MemoryAllocator::allocate(vk::MemoryRequirements const& requirements,
+    vk::MemoryPropertyFlags properties, bool linear, MemoryCategory category) {
+
+  Allocation result;
+  result.mSize       = requirements.size;
+  result.mMemoryType = mPhysicalDevice->findMemoryType(requirements.memoryTypeBits, properties);
+
+  std::unique_lock<std::mutex> lock(mMutex);
+
+  auto& pool = mPools[{result.mMemoryType, linear}];
+
+  // Choose a block size which is reasonable for the heap this memory type belongs to.
+  if (pool.mBlockSize == 0) {
+    auto heapIndex = mMemoryProperties.memoryTypes[result.mMemoryType].heapIndex;
+    auto heapSize  = mMemoryProperties.memoryHeaps[heapIndex].size;
+
+    pool.mBlockSize = mBlockSize;
+    while (pool.mBlockSize > MIN_ALLOCATION_SIZE && pool.mBlockSize * 8 > heapSize) {
+      pool.mBlockSize /= 2;
+    }
+  }
+
+  vk::DeviceSize size =
+      std::max({requirements.size, requirements.alignment, MIN_ALLOCATION_SIZE});
+
+  // Huge resources get their own vk::DeviceMemory.
+  if (size > pool.mBlockSize / 2) {
+    vk::MemoryAllocateInfo info;
+    info.allocationSize  = requirements.size;
+    info.memoryTypeIndex = result.mMemoryType;
+
+    // acceleration structure builds need the device addresses of their input buffers
+    vk::MemoryAllocateFlagsInfo flagsInfo(vk::MemoryAllocateFlagBits::eDeviceAddress);
+    if (mPhysicalDevice->supportsRayQueries()) {
+      info.pNext = &flagsInfo;
+    }
+
+    ILLUSION_TRACE << "Allocating dedicated vk::DeviceMemory." << std::endl;
+
+    auto device{mDevice};
+    auto allocator{shared_from_this()};
+    auto memorySize{requirements.size};
+    auto mapped{static_cast<bool>(mMemoryProperties.memoryTypes[result.mMemoryType].propertyFlags &
+                                  vk::MemoryPropertyFlagBits::eHostVisible)};
+
+    auto memoryType{result.mMemoryType};
+
+    result.mMemory = VulkanPtr::create(device->allocateMemory(info),
+        [device, allocator, memorySize, mapped, memoryType, category](vk::DeviceMemory* obj) {
+          allocator->mDeletionQueue->push(
+              [device, allocator, memorySize, mapped, memoryType, category, obj]() {
+                ILLUSION_TRACE << "Freeing dedicated vk::DeviceMemory." << std::endl;
+                if (mapped) {
+                  device->unmapMemory(*obj);
+                }
+                device->freeMemory(*obj);
+                delete obj;
+
+                std::unique_lock<std::mutex> lock(allocator->mMutex);
+                --allocator->mDedicatedAllocationCount;
+                allocator->mDedicatedBytes -= memorySize;
+                allocator->track(memoryType, category, -static_cast<int64_t>(memorySize),
+                    -static_cast<int64_t>(memorySize));
+              });
+        });
+
+    result.mMappedData = map(*result.mMemory, result.mMemoryType);
+
+    ++mDedicatedAllocationCount;
+    mDedicatedBytes += requirements.size;
+    track(result.mMemoryType, category, requirements.size, requirements.size);
+
+    lock.unlock();
+    checkBudget();
+
+    return result;
+  }
+
+  // Find the level in the buddy tree which fits the requested size best.
+  uint32_t       level     = 0;
+  vk::DeviceSize levelSize = pool.mBlockSize;
+  while (levelSize / 2 >= size && levelSize / 2 >= MIN_ALLOCATION_SIZE) {
+    levelSize /= 2;
+    ++level;
+  }
+
+  BlockPtr block;
+  for (auto const& b : pool.mBlocks) {
+    if (allocateFromBlock(*b, level, result.mOffset)) {
+      block = b;
+      break;
+    }
+  }
+
+  bool newBlock = !block;
+
+  if (newBlock) {
+    block = createBlock(result.mMemoryType, pool.mBlockSize);
+    pool.mBlocks.push_back(block);
+    allocateFromBlock(*block, level, result.mOffset);
+  }
+
+  block->mAllocations[result.mOffset].second = requirements.size;
+  track(result.mMemoryType, category, requirements.size, newBlock ? block->mSize : 0);
+
+  if (block->mMappedData) {
+    result.mMappedData = block->mMappedData + result.mOffset;
+  }
+
+  auto allocator{shared_from_this()};
+  auto offset{result.mOffset};
+  auto memoryType{result.mMemoryType};
+
+  result.mMemory = VulkanPtr::create(*block->mMemory,
+      [allocator, block, offset, memoryType, linear, category](vk::DeviceMemory* obj) {
+        delete obj;
+        allocator->mDeletionQueue->push([allocator, block, offset, memoryType, linear, category]() {
+          allocator->free(block, offset, memoryType, linear, category);
+        });
+      });
+
+  if (newBlock) {
+    lock.unlock();
+    checkBudget();
+  }
+
+  return result;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+MemoryAllocator::Statistics MemoryAllocator::getStatistics() const {
+  std::unique_lock<std::mutex> lock(mMutex);
+
+  Statistics result;
+  result.mDedicatedAllocationCount = mDedicatedAllocationCount;
+  result.mAllocationCount          = mDedicatedAllocationCount;
+  result.mBytesReserved            = mDedicatedBytes;
+  result.mBytesUsed                = mDedicatedBytes;
+  result.mBytesAllocated           = mDedicatedBytes;
+  result.mBytesPerCategory         = mBytesPerCategory;
+
+  for (auto const& pool : mPools) {
+    for (auto const& block : pool.second.mBlocks) {
+      ++result.mBlockCount;
+      result.mBytesReserved += block->mSize;
+      result.mAllocationCount += static_cast<uint32_t>(block->mAllocations.size());
+
+      for (auto const& allocation : block->mAllocations) {
+        result.mBytesUsed += allocation.second.second;
+        result.mBytesAllocated += block->mSize >> allocation.second.first;
+      }
+
+      for (size_t level(0); level < block->mFreeLists.size(); ++level) {
+        vk::DeviceSize levelSize = block->mSize >> level;
+        if (!block->mFreeLists[level].empty()) {
+          result.mBytesFree += levelSize * block->mFreeLists[level].size();
+          result.mLargestFreeRange = std::max(result.mLargestFreeRange, levelSize);
+        }
+      }
+    }
+  }
+
+  return result;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+std::vector<MemoryAllocator::HeapStatistics> MemoryAllocator::getHeapStatistics() const {
+  std::unique_lock<std::mutex> lock(mMutex);
+  return getHeapStatisticsImpl();
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void MemoryAllocator::printStatistics() const {
+  auto stats = getStatistics();
+  auto heaps = getHeapStatistics();
+
+  ILLUSION_MESSAGE << "Device memory: " << stats.mAllocationCount << " allocations in "
+                   << stats.mBlockCount << " blocks and " << stats.mDedicatedAllocationCount
+                   << " dedicated allocations." << std::endl;
+  ILLUSION_MESSAGE << "  reserved:      " << stats.mBytesReserved << " bytes" << std::endl;
+  ILLUSION_MESSAGE << "  used:          " << stats.mBytesUsed << " bytes" << std::endl;
+  ILLUSION_MESSAGE << "  allocated:     " << stats.mBytesAllocated << " bytes" << std::endl;
+  ILLUSION_MESSAGE << "  free:          " << stats.mBytesFree << " bytes" << std::endl;
+  ILLUSION_MESSAGE << "  fragmentation: " << stats.getFragmentation() << std::endl;
+
+  const std::array<std::string, 5> categories = {
+      "textures", "render targets", "geometry", "staging", "other"};
+
+  for (size_t i(0); i < categories.size(); ++i) {
+    ILLUSION_MESSAGE << "  " << std::left << std::setw(15) << (categories[i] + ":")
+                     << stats.mBytesPerCategory[i] << " bytes" << std::endl;
+  }
+
+  for (size_t i(0); i < heaps.size(); ++i) {
+    ILLUSION_MESSAGE << "  heap " << i
+                     << (heaps[i].mFlags & vk::MemoryHeapFlagBits::eDeviceLocal ? " (device local)"
+                                                                                : "")
+                     << ": " << heaps[i].mBytesReserved << " of " << heaps[i].mSize
+                     << " bytes reserved, usage " << heaps[i].mUsage << " of " << heaps[i].mBudget
+                     << " bytes budget" << std::endl;
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void MemoryAllocator::setBudgetWarningThreshold(float fraction) {
+  std::unique_lock<std::mutex> lock(mMutex);
+  mBudgetWarningThreshold = fraction;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+float MemoryAllocator::getBudgetWarningThreshold() const {
+  std::unique_lock<std::mutex> lock(mMutex);
+  return mBudgetWarningThreshold;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+MemoryAllocator::BlockPtr MemoryAllocator::createBlock(
+    uint32_t memoryType, vk::DeviceSize size) const {
+
+  vk::MemoryAllocateInfo info;
+  info.allocationSize  = size;
+  info.memoryTypeIndex = memoryType;
+
+  // see allocate(), buffers in this block may need a device address
+  vk::MemoryAllocateFlagsInfo flagsInfo(vk::MemoryAllocateFlagBits::eDeviceAddress);
+  if (mPhysicalDevice->supportsRayQueries()) {
+    info.pNext = &flagsInfo;
+  }
+
+  ILLUSION_TRACE << "Allocating vk::DeviceMemory block of " << size << " bytes." << std::endl;
+
+  auto device{mDevice};
+  auto mapped{static_cast<bool>(mMemoryProperties.memoryTypes[memoryType].propertyFlags &
+                                vk::MemoryPropertyFlagBits::eHostVisible)};
+
+  auto block   = std::make_shared<Block>();
+  block->mSize = size;
+  block->mMemory =
+      VulkanPtr::create(device->allocateMemory(info), [device, mapped](vk::DeviceMemory* obj) {
+        ILLUSION_TRACE << "Freeing vk::DeviceMemory block." << std::endl;
+        if (mapped) {
+          device->unmapMemory(*obj);
+        }
+        device->freeMemory(*obj);
+        delete obj;
+      });
+
+  block->mMappedData = map(*block->mMemory, memoryType);
+
+  uint32_t levelCount = 1;
+  while ((size >> levelCount) >= MIN_ALLOCATION_SIZE) {
+    ++levelCount;
+  }
+
+  block->mFreeLists.resize(levelCount);
+  block->mFreeLists[0].insert(0);
+
+  return block;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+bool MemoryAllocator::allocateFromBlock(
+    Block& block, uint32_t level, vk::DeviceSize& offset) const {
+
+  // Search for the smallest free range which is large enough.
+  int32_t freeLevel = static_cast<int32_t>(level);
+  while (freeLevel >= 0 && block.mFreeLists[freeLevel].empty()) {
+    --freeLevel;
+  }
+
+  if (freeLevel < 0) {
+    return false;
+  }
+
+  offset = *block.mFreeLists[freeLevel].begin();
+  block.mFreeLists[freeLevel].erase(block.mFreeLists[freeLevel].begin());
+
+  // Split the range until it has the requested size, the right halves become free.
+  while (static_cast<uint32_t>(freeLevel) < level) {
+    ++freeLevel;
+    block.mFreeLists[freeLevel].insert(offset + (block.mSize >> freeLevel));
+  }
+
+  block.mAllocations[offset] = {level, 0};
+
+  return true;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void MemoryAllocator::free(BlockPtr const& block, vk::DeviceSize offset, uint32_t memoryType,
+    bool linear, MemoryCategory category) {
+
+  std::unique_lock<std::mutex> lock(mMutex);
+
+  auto allocation = block->mAllocations.find(offset);
+  if (allocation == block->mAllocations.end()) {
+    ILLUSION_ERROR << "Failed to free memory: Range was not allocated from this block!"
+                   << std::endl;
+    return;
+  }
+
+  uint32_t level = allocation->second.first;
+  track(memoryType, category, -static_cast<int64_t>(allocation->second.second), 0);
+  block->mAllocations.erase(allocation);
+
+  // Merge with the buddy as long as it is free as well.
+  while (level > 0) {
+    vk::DeviceSize buddy = offset ^ (block->mSize >> level);
+    auto           it    = block->mFreeLists[level].find(buddy);
+
+    if (it == block->mFreeLists[level].end()) {
+      break;
+    }
+
+    block->mFreeLists[level].erase(it);
+    offset = std::min(offset, buddy);
+    --level;
+  }
+
+  block->mFreeLists[level].insert(offset);
+
+  // Release the block if it's empty, but keep at least one empty block per pool in order to
+  // prevent frequent allocations when resources are created and destroyed in a loop.
+  if (level == 0) {
+    auto& blocks = mPools[{memoryType, linear}].mBlocks;
+
+    auto emptyBlocks = std::count_if(blocks.begin(), blocks.end(),
+        [](BlockPtr const& b) { return b->mAllocations.empty(); });
+
+    if (emptyBlocks > 1) {
+      blocks.erase(std::remove(blocks.begin(), blocks.end(), block), blocks.end());
+      track(memoryType, category, 0, -static_cast<int64_t>(block->mSize));
+    }
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void MemoryAllocator::track(
+    uint32_t memoryType, MemoryCategory category, int64_t bytesUsed, int64_t bytesReserved) {
+
+  auto heapIndex = mMemoryProperties.memoryTypes[memoryType].heapIndex;
+
+  mBytesPerCategory[Core::enumCast(category)] += bytesUsed;
+  mHeapBytesUsed[heapIndex] += bytesUsed;
+  mHeapBytesReserved[heapIndex] += bytesReserved;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+std::vector<MemoryAllocator::HeapStatistics> MemoryAllocator::getHeapStatisticsImpl() const {
+  auto budget = mPhysicalDevice->getMemoryBudget();
+
+  std::vector<HeapStatistics> result(mMemoryProperties.memoryHeapCount);
+
+  for (uint32_t i(0); i < mMemoryProperties.memoryHeapCount; ++i) {
+    result[i].mFlags         = mMemoryProperties.memoryHeaps[i].flags;
+    result[i].mSize          = mMemoryProperties.memoryHeaps[i].size;
+    result[i].mBytesReserved = mHeapBytesReserved[i];
+    result[i].mBytesUsed     = mHeapBytesUsed[i];
+
+    if (mPhysicalDevice->supportsMemoryBudget()) {
+      result[i].mBudget = budget.heapBudget[i];
+      result[i].mUsage  = budget.heapUsage[i];
+    } else {
+      result[i].mBudget = result[i].mSize;
+      result[i].mUsage  = result[i].mBytesReserved;
+    }
+  }
+
+  return result;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void MemoryAllocator::checkBudget() {
+  std::vector<std::pair<uint32_t, HeapStatistics>> warnings;
+
+  {
+    std::unique_lock<std::mutex> lock(mMutex);
+    auto                         heaps = getHeapStatisticsImpl();
+
+    for (uint32_t i(0); i < heaps.size(); ++i) {
+      bool exceeded = heaps[i].mUsage > heaps[i].mBudget * mBudgetWarningThreshold;
+
+      if (exceeded && !mHeapWarned[i]) {
+        warnings.emplace_back(i, heaps[i]);
+      }
+
+      mHeapWarned[i] = exceeded;
+    }
+  }
+
+  for (auto const& warning : warnings) {
+    ILLUSION_WARNING << "Memory heap " << warning.first << " uses " << warning.second.mUsage
+                     << " of " << warning.second.mBudget << " bytes of its budget!" << std::endl;
+    sOnBudgetWarning.emit(warning.first, warning.second);
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+uint8_t* MemoryAllocator::map(vk::DeviceMemory const& memory, uint32_t memoryType) const {
+  if (mMemoryProperties.memoryTypes[memoryType].propertyFlags &
+      vk::MemoryPropertyFlagBits::eHostVisible) {
+    return static_cast<uint8_t*>(mDevice->mapMemory(memory, 0, VK_WHOLE_SIZE));
+  }
+
+  return nullptr;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+} // namespace Illusion::Graphics
@@ -0,0 +1,185 @@
+////////////////////////////////////////////////////////////////////////////////////////////////////
+//                                                                                                //
+//    _)  |  |            _)                This code may be used and modified under the terms    //
+//     |  |  |  |  | (_-<  |   _ \    \     of the MIT license. See the LICENSE file for details. //
+//    _| _| _| \_,_| ___/ _| \___/ _| _|    Copyright (c) 2018-2019 Simon Schneegans              //
+//                                                                                                //
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#ifndef ILLUSION_GRAPHICS_MEMORY_ALLOCATOR_HPP
+#define ILLUSION_GRAPHICS_MEMORY_ALLOCATOR_HPP
+
+#include "../Core/Signal.hpp"
+#include "fwd.hpp"
+
+#include <array>
+#include <map>
+#include <mutex>
+#include <set>
+#include <unordered_map>
+
+namespace Illusion::Graphics {
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// The MemoryAllocator is used by the Device to back BackedBuffers and BackedImages with          //
+// vk::DeviceMemory. Instead of calling vkAllocateMemory for each resource, it allocates large    //
+// blocks per memory type and sub-allocates ranges from them using a buddy allocator. Linear and  //
+// optimal resources are kept in separate blocks, so bufferImageGranularity never has to be       //
+// considered. Resources which are larger than half a block get a dedicated allocation.           //
+// The vk::DeviceMemoryPtr of an Allocation points to the memory of the block; its deleter        //
+// returns the range to the allocator by pushing it to the DeletionQueue of the Device; this way  //
+// ranges are only reused once the GPU has finished all frames which may access them.             //
+// Host-visible memory is persistently mapped.                                                    //
+// All allocations are accounted per memory heap and per MemoryCategory. If VK_EXT_memory_budget  //
+// is available, the budget of each heap is queried whenever a new vk::DeviceMemory is allocated; //
+// sOnBudgetWarning is emitted once the usage of a heap exceeds a fraction of its budget. This    //
+// can be used to shrink streaming caches before the driver starts to evict memory.               //
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+class MemoryAllocator : public std::enable_shared_from_this<MemoryAllocator> {
+
+ public:
+  struct Allocation {
+    vk::DeviceMemoryPtr mMemory;
+    vk::DeviceSize      mOffset     = 0;
+    vk::DeviceSize      mSize       = 0;
+    uint32_t            mMemoryType = 0;
+
+    // This is nullptr if the memory is not eHostVisible.
+    uint8_t* mMappedData = nullptr;
+  };
+
+  struct Statistics {
+    uint32_t mBlockCount               = 0;
+    uint32_t mDedicatedAllocationCount = 0;
+    uint32_t mAllocationCount          = 0;
+
+    // Total size of all vk::DeviceMemory objects allocated from the driver.
+    vk::DeviceSize mBytesReserved = 0;
+
+    // Sum of the sizes requested by all living resources.
+    vk::DeviceSize mBytesUsed = 0;
+
+    // Sum of the ranges handed out; this is larger than mBytesUsed as the buddy allocator rounds
+    // up to the next power of two.
+    vk::DeviceSize mBytesAllocated = 0;
+
+    // Unused bytes in all blocks and the largest contiguous range among them.
+    vk::DeviceSize mBytesFree        = 0;
+    vk::DeviceSize mLargestFreeRange = 0;
+
+    // mBytesUsed split by MemoryCategory, use Core::enumCast() to index this.
+    std::array<vk::DeviceSize, 5> mBytesPerCategory = {0, 0, 0, 0, 0};
+
+    // 0 means that all free memory is contiguous, values close to 1 mean that the free memory is
+    // scattered across many small ranges.
+    float getFragmentation() const;
+  };
+
+  struct HeapStatistics {
+    vk::MemoryHeapFlags mFlags;
+    vk::DeviceSize      mSize = 0;
+
+    // The budget and usage as reported by VK_EXT_memory_budget; both include the allocations of
+    // other processes. Without the extension, mBudget is the heap size and mUsage equals
+    // mBytesReserved.
+    vk::DeviceSize mBudget = 0;
+    vk::DeviceSize mUsage  = 0;
+
+    // The vk::DeviceMemory allocated by this allocator and the sizes requested by living resources.
+    vk::DeviceSize mBytesReserved = 0;
+    vk::DeviceSize mBytesUsed     = 0;
+  };
+
+  // Emitted with the heap index when the usage of a heap exceeds the warning threshold of its
+  // budget. It is emitted again only after the usage dropped below the threshold in between. This
+  // is emitted by the thread which allocates, but not while the allocator is locked.
+  Core::Signal<uint32_t, HeapStatistics> sOnBudgetWarning;
+
+  // Syntactic sugar to create a std::shared_ptr for this class
+  template <typename... Args>
+  static MemoryAllocatorPtr create(Args&&... args) {
+    return std::make_shared<MemoryAllocator>(args...);
+  };
+
+  // The blockSize must be a power of two. For memory heaps smaller than eight times the blockSize,
+  // a smaller block size will be chosen.
+  MemoryAllocator(vk::DevicePtr const& device, PhysicalDevicePtr const& physicalDevice,
+      DeletionQueuePtr const& deletionQueue, vk::DeviceSize blockSize = 64 * 1024 * 1024);
+  virtual ~MemoryAllocator();
+
+  // Returns a range of memory fulfilling the given requirements. Set linear to true for buffers and
+  // for images with vk::ImageTiling::eLinear. This is thread-safe.
+  Allocation allocate(vk::MemoryRequirements const& requirements,
+      vk::MemoryPropertyFlags properties, bool linear,
+      MemoryCategory category = MemoryCategory::eOther);
+
+  Statistics                  getStatistics() const;
+  std::vector<HeapStatistics> getHeapStatistics() const;
+  void                        printStatistics() const;
+
+  // sOnBudgetWarning is emitted when a heap's usage exceeds this fraction of its budget. The
+  // default is 0.9.
+  void  setBudgetWarningThreshold(float fraction);
+  float getBudgetWarningThreshold() const;
+
+ private:
+  struct Block {
+    vk::DeviceMemoryPtr mMemory;
+    vk::DeviceSize      mSize       = 0;
+    uint8_t*            mMappedData = nullptr;
+
+    // One set of free offsets for each level, level 0 is the entire block.
+    std::vector<std::set<vk::DeviceSize>> mFreeLists;
+
+    // Maps an allocated offset to its level and the requested size.
+    std::unordered_map<vk::DeviceSize, std::pair<uint32_t, vk::DeviceSize>> mAllocations;
+  };
+
+  typedef std::shared_ptr<Block> BlockPtr;
+
+  struct Pool {
+    vk::DeviceSize        mBlockSize = 0;
+    std::vector<BlockPtr> mBlocks;
+  };
+
+  BlockPtr createBlock(uint32_t memoryType, vk::DeviceSize size) const;
+  bool     allocateFromBlock(Block& block, uint32_t level, vk::DeviceSize& offset) const;
+  void     free(BlockPtr const& block, vk::DeviceSize offset, uint32_t memoryType, bool linear,
+          MemoryCategory category);
+
+  // These have to be called while mMutex is locked.
+  void track(
+      uint32_t memoryType, MemoryCategory category, int64_t bytesUsed, int64_t bytesReserved);
+  std::vector<HeapStatistics> getHeapStatisticsImpl() const;
+
+  // Emits sOnBudgetWarning for all heaps which crossed the threshold since the last call.
+  void checkBudget();
+
+  uint8_t* map(vk::DeviceMemory const& memory, uint32_t memoryType) const;
+
+  vk::DevicePtr     mDevice;
+  PhysicalDevicePtr mPhysicalDevice;
+  DeletionQueuePtr  mDeletionQueue;
+  vk::DeviceSize    mBlockSize;
+
+  vk::PhysicalDeviceMemoryProperties mMemoryProperties;
+
+  // Pools are identified by the memory type and whether they contain linear resources.
+  std::map<std::pair<uint32_t, bool>, Pool> mPools;
+
+  uint32_t       mDedicatedAllocationCount = 0;
+  vk::DeviceSize mDedicatedBytes           = 0;
+
+  std::array<vk::DeviceSize, 5> mBytesPerCategory = {0, 0, 0, 0, 0};
+  std::vector<vk::DeviceSize>   mHeapBytesUsed;
+  std::vector<vk::DeviceSize>   mHeapBytesReserved;
+  std::vector<bool>             mHeapWarned;
+  float                         mBudgetWarningThreshold = 0.9f;
+
+  mutable std::mutex mMutex;
+};
+
+} // namespace Illusion::Graphics
+
+#endif // ILLUSION_GRAPHICS_MEMORY_ALLOCATOR_HPP
@@ -0,0 +1,610 @@
+////////////////////////////////////////////////////////////////////////////////////////////////////
+//                                                                                                //
+//    _)  |  |            _)                This code may be used and modified under the terms    //
+//     |  |  |  |  | (_-<  |   _ \    \     of the MIT license. See the LICENSE file for details. //
+//    _| _| _| \_,_| ___/ _| \___/ _| _|    Copyright (c) 2018-2019 Simon Schneegans              //
+//                                                                                                //
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include "MeshOptimizer.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <numeric>
+#include <set>
+#include <string_view>
+#include <tuple>
+#include <unordered_map>
+
+namespace Illusion::Graphics::MeshOptimizer {
+
+namespace {
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+// The size of the simulated LRU cache of optimizeVertexCache(). Larger caches of the actual
+// hardware still benefit from the order, smaller ones do not suffer too much.
+const size_t cLRUCacheSize = 32;
+
+// The size of the simulated FIFO cache of optimizeOverdraw(). Triangles which miss all three of
+// their vertices in this cache start a new cluster.
+const size_t cFIFOCacheSize = 16;
+
+// The initial resolution of the grid used by simplify(). Each coarsening step divides the
+// resolution by cGridCoarsening.
+const float cMaxGridResolution = 512.f;
+const float cGridCoarsening    = 1.5f;
+
+// If a triangle of a Meshlet deviates more than this from the axis of the normal cone (the value
+// is the cosine of the angle), no cone is stored as it would hardly ever cull the Meshlet.
+const float cMinConeCosine = 0.1f;
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+// The score of a vertex as proposed by Tom Forsyth. Vertices which are recently used get a high
+// score, as well as vertices which have only few triangles left which have not been emitted yet.
+float getVertexScore(int cachePosition, uint32_t remainingTriangles) {
+  if (remainingTriangles == 0) {
+    return -1.f;
+  }
+
+  float score = 0.f;
+
+  if (cachePosition >= 0) {
+    if (cachePosition < 3) {
+      // the vertices of the last triangle get a fixed score, else it would make no difference in
+      // which order the triangles are emitted
+      score = 0.75f;
+    } else {
+      float scale = 1.f / (cLRUCacheSize - 3);
+      score       = std::pow(1.f - (cachePosition - 3) * scale, 1.5f);
+    }
+  }
+
+  // boost vertices with few triangles left, so that no lonely triangles are left behind
+  score += 2.f / std::sqrt(static_cast<float>(remainingTriangles));
+
+  return score;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+// Computes the bounding sphere and the normal cone of the given Meshlet from its vertices and
+// triangles. The sphere is centered in the bounding box of the vertices, which is not minimal but
+// cheap.
+void computeMeshletBounds(Meshlet& meshlet, std::vector<uint32_t> const& meshletVertices,
+    std::vector<uint32_t> const& meshletTriangles, std::vector<glm::vec3> const& positions) {
+
+  glm::vec3 min(std::numeric_limits<float>::max());
+  glm::vec3 max(std::numeric_limits<float>::lowest());
+
+  for (uint32_t i(0); i < meshlet.mVertexCount; ++i) {
+    glm::vec3 const& p = positions[meshletVertices[meshlet.mVertexOffset + i]];
+    min                = glm::min(min, p);
+    max                = glm::max(max, p);
+  }
+
+  meshlet.mCenter = (min + max) * 0.5f;
+  meshlet.mRadius = 0.f;
+
+  for (uint32_t i(0); i < meshlet.mVertexCount; ++i) {
+    glm::vec3 const& p = positions[meshletVertices[meshlet.mVertexOffset + i]];
+    meshlet.mRadius    = std::max(meshlet.mRadius, glm::length(p - meshlet.mCenter));
+  }
+
+  // The axis of the cone is the average of the normals of the triangles; degenerate triangles
+  // are ignored.
+  std::vector<glm::vec3> normals;
+  normals.reserve(meshlet.mTriangleCount);
+
+  glm::vec3 axis(0.f);
+
+  for (uint32_t t(0); t < meshlet.mTriangleCount; ++t) {
+    uint32_t  triangle = meshletTriangles[meshlet.mTriangleOffset + t];
+    glm::vec3 a = positions[meshletVertices[meshlet.mVertexOffset + (triangle & 0xff)]];
+    glm::vec3 b = positions[meshletVertices[meshlet.mVertexOffset + ((triangle >> 8) & 0xff)]];
+    glm::vec3 c = positions[meshletVertices[meshlet.mVertexOffset + ((triangle >> 16) & 0xff)]];
+    glm::vec3 normal = glm::cross(b - a, c - a);
+    float     length = glm::length(normal);
+
+    if (length > 0.f) {
+      normals.push_back(normal / length);
+      axis += normals.back();
+    }
+  }
+
+  meshlet.mConeAxis   = glm::vec3(0.f, 0.f, 1.f);
+  meshlet.mConeCutoff = 1.f;
+
+  if (normals.empty() || glm::length(axis) == 0.f) {
+    return;
+  }
+
+  axis = glm::normalize(axis);
+
+  float minCosine = 1.f;
+  for (auto const& normal : normals) {
+    minCosine = std::min(minCosine, glm::dot(normal, axis));
+  }
+
+  if (minCosine < cMinConeCosine) {
+    return;
+  }
+
+  // the triangles face away if the view direction is within 90 degrees minus the opening angle
+  // of the cone around its axis; the cosine of this is the sine of the opening angle
+  meshlet.mConeAxis   = axis;
+  meshlet.mConeCutoff = std::sqrt(1.f - minCosine * minCosine);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+} // namespace
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void weldVertices(
+    std::vector<uint32_t>& indices, void const* vertices, size_t vertexCount, size_t vertexSize) {
+
+  auto data = static_cast<char const*>(vertices);
+
+  std::unordered_map<std::string_view, uint32_t> firstVertices;
+  firstVertices.reserve(vertexCount);
+
+  std::vector<uint32_t> remap(vertexCount);
+
+  for (size_t i(0); i < vertexCount; ++i) {
+    std::string_view key(data + i * vertexSize, vertexSize);
+    remap[i] = firstVertices.emplace(key, static_cast<uint32_t>(i)).first->second;
+  }
+
+  for (auto& index : indices) {
+    index = remap[index];
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void optimizeVertexCache(std::vector<uint32_t>& indices, size_t vertexCount) {
+  size_t triangleCount = indices.size() / 3;
+
+  // For each vertex, store the triangles using it which have not been emitted yet. These lists
+  // are stored back-to-back in adjacency; emitted triangles are removed by swapping them to the
+  // end of the list of the vertex and decrementing its remainingTriangles.
+  std::vector<uint32_t> remainingTriangles(vertexCount, 0);
+  for (size_t i(0); i < triangleCount * 3; ++i) {
+    ++remainingTriangles[indices[i]];
+  }
+
+  std::vector<uint32_t> adjacencyOffsets(vertexCount, 0);
+  for (size_t v(1); v < vertexCount; ++v) {
+    adjacencyOffsets[v] = adjacencyOffsets[v - 1] + remainingTriangles[v - 1];
+  }
+
+  std::vector<uint32_t> adjacency(triangleCount * 3);
+  {
+    std::vector<uint32_t> fill(adjacencyOffsets);
+    for (size_t t(0); t < triangleCount; ++t) {
+      for (size_t k(0); k < 3; ++k) {
+        adjacency[fill[indices[t * 3 + k]]++] = static_cast<uint32_t>(t);
+      }
+    }
+  }
+
+  std::vector<float> vertexScores(vertexCount);
+  for (size_t v(0); v < vertexCount; ++v) {
+    vertexScores[v] = getVertexScore(-1, remainingTriangles[v]);
+  }
+
+  std::vector<float> triangleScores(triangleCount);
+  std::vector<bool>  emitted(triangleCount, false);
+  for (size_t t(0); t < triangleCount; ++t) {
+    triangleScores[t] = vertexScores[indices[t * 3]] + vertexScores[indices[t * 3 + 1]] +
+                        vertexScores[indices[t * 3 + 2]];
+  }
+
+  std::vector<uint32_t> result;
+  result.reserve(triangleCount * 3);
+
+  std::vector<uint32_t> cache;
+  std::vector<uint32_t> newCache;
+
+  size_t  nextTriangle = 0;
+  int64_t best         = -1;
+
+  while (result.size() < triangleCount * 3) {
+
+    // if there is no candidate in the cache, continue with the next triangle in input order
+    if (best < 0) {
+      while (emitted[nextTriangle]) {
+        ++nextTriangle;
+      }
+      best = static_cast<int64_t>(nextTriangle);
+    }
+
+    emitted[best] = true;
+    newCache.clear();
+
+    for (size_t k(0); k < 3; ++k) {
+      uint32_t v = indices[best * 3 + k];
+      result.push_back(v);
+
+      if (std::find(newCache.begin(), newCache.end(), v) == newCache.end()) {
+        newCache.push_back(v);
+      }
+
+      auto begin = adjacency.begin() + adjacencyOffsets[v];
+      auto end   = begin + remainingTriangles[v];
+      std::iter_swap(std::find(begin, end, static_cast<uint32_t>(best)), end - 1);
+      --remainingTriangles[v];
+    }
+
+    // degenerate triangles have less than three different vertices
+    size_t triangleVertices = newCache.size();
+    for (uint32_t v : cache) {
+      if (std::find(newCache.begin(), newCache.begin() + triangleVertices, v) ==
+          newCache.begin() + triangleVertices) {
+        newCache.push_back(v);
+      }
+    }
+
+    // Update the scores of all vertices which have been in the cache before or are in the cache
+    // now, as well as the scores of their remaining triangles. The best of those triangles is
+    // emitted next.
+    best           = -1;
+    float maxScore = -1.f;
+
+    for (size_t i(0); i < newCache.size(); ++i) {
+      uint32_t v        = newCache[i];
+      int      position = i < cLRUCacheSize ? static_cast<int>(i) : -1;
+      float    score    = getVertexScore(position, remainingTriangles[v]);
+      float    delta    = score - vertexScores[v];
+
+      vertexScores[v] = score;
+
+      for (uint32_t j(0); j < remainingTriangles[v]; ++j) {
+        uint32_t t = adjacency[adjacencyOffsets[v] + j];
+        triangleScores[t] += delta;
+
+        if (triangleScores[t] > maxScore) {
+          maxScore = triangleScores[t];
+          best     = t;
+        }
+      }
+    }
+
+    if (newCache.size() > cLRUCacheSize) {
+      newCache.resize(cLRUCacheSize);
+    }
+
+    std::swap(cache, newCache);
+  }
+
+  std::copy(result.begin(), result.end(), indices.begin());
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void optimizeOverdraw(std::vector<uint32_t>& indices, std::vector<glm::vec3> const& positions) {
+  size_t triangleCount = indices.size() / 3;
+
+  if (triangleCount == 0) {
+    return;
+  }
+
+  // Split the triangles into clusters. A new cluster starts at each triangle whose vertices are
+  // all missing in the simulated cache, so the order inside of the clusters remains cache
+  // friendly.
+  std::vector<uint32_t> clusterStarts;
+  {
+    std::vector<uint32_t> fifo(cFIFOCacheSize, std::numeric_limits<uint32_t>::max());
+    size_t                fifoStart = 0;
+
+    for (size_t t(0); t < triangleCount; ++t) {
+      uint32_t misses = 0;
+
+      for (size_t k(0); k < 3; ++k) {
+        uint32_t v = indices[t * 3 + k];
+
+        if (std::find(fifo.begin(), fifo.end(), v) == fifo.end()) {
+          fifo[fifoStart] = v;
+          fifoStart       = (fifoStart + 1) % cFIFOCacheSize;
+          ++misses;
+        }
+      }
+
+      if (misses == 3 || t == 0) {
+        clusterStarts.push_back(static_cast<uint32_t>(t));
+      }
+    }
+  }
+
+  clusterStarts.push_back(static_cast<uint32_t>(triangleCount));
+
+  // The area-weighted centroid of the whole mesh.
+  glm::vec3 meshCentroid(0.f);
+  float     meshArea = 0.f;
+
+  std::vector<glm::vec3> triangleCentroids(triangleCount);
+  std::vector<glm::vec3> triangleNormals(triangleCount);
+
+  for (size_t t(0); t < triangleCount; ++t) {
+    glm::vec3 const& a = positions[indices[t * 3]];
+    glm::vec3 const& b = positions[indices[t * 3 + 1]];
+    glm::vec3 const& c = positions[indices[t * 3 + 2]];
+
+    // the length of the cross product is twice the area of the triangle
+    triangleNormals[t]   = glm::cross(b - a, c - a);
+    triangleCentroids[t] = (a + b + c) / 3.f;
+
+    float area = glm::length(triangleNormals[t]);
+    meshCentroid += triangleCentroids[t] * area;
+    meshArea += area;
+  }
+
+  if (meshArea > 0.f) {
+    meshCentroid /= meshArea;
+  }
+
+  // Clusters which face away from the centroid are likely to occlude other parts of the mesh,
+  // hence they are sorted to the front.
+  size_t             clusterCount = clusterStarts.size() - 1;
+  std::vector<float> sortKeys(clusterCount);
+
+  for (size_t i(0); i < clusterCount; ++i) {
+    glm::vec3 centroid(0.f);
+    glm::vec3 normal(0.f);
+    float     area = 0.f;
+
+    for (uint32_t t = clusterStarts[i]; t < clusterStarts[i + 1]; ++t) {
+      float triangleArea = glm::length(triangleNormals[t]);
+      centroid += triangleCentroids[t] * triangleArea;
+      normal += triangleNormals[t];
+      area += triangleArea;
+    }
+
+    if (area > 0.f) {
+      centroid /= area;
+    }
+
+    float length = glm::length(normal);
+    sortKeys[i]  = length > 0.f ? glm::dot(centroid - meshCentroid, normal / length) : 0.f;
+  }
+
+  std::vector<uint32_t> order(clusterCount);
+  std::iota(order.begin(), order.end(), 0);
+  std::stable_sort(order.begin(), order.end(),
+      [&sortKeys](uint32_t a, uint32_t b) { return sortKeys[a] > sortKeys[b]; });
+
+  std::vector<uint32_t> result;
+  result.reserve(indices.size());
+
+  for (uint32_t i : order) {
+    result.insert(result.end(), indices.begin() + clusterStarts[i] * 3,
+        indices.begin() + clusterStarts[i + 1] * 3);
+  }
+
+  std::copy(result.begin(), result.end(), indices.begin());
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+size_t optimizeVertexFetch(
+    std::vector<uint32_t>& indices, void* vertices, size_t vertexCount, size_t vertexSize) {
+
+  auto data = static_cast<char*>(vertices);
+
+  std::vector<uint32_t> remap(vertexCount, std::numeric_limits<uint32_t>::max());
+  uint32_t              usedVertices = 0;
+
+  for (auto& index : indices) {
+    if (remap[index] == std::numeric_limits<uint32_t>::max()) {
+      remap[index] = usedVertices++;
+    }
+    index = remap[index];
+  }
+
+  std::vector<char> copy(data, data + vertexCount * vertexSize);
+
+  for (size_t v(0); v < vertexCount; ++v) {
+    if (remap[v] != std::numeric_limits<uint32_t>::max()) {
+      std::memcpy(data + remap[v] * vertexSize, copy.data() + v * vertexSize, vertexSize);
+    }
+  }
+
+  return usedVertices;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+std::vector<uint32_t> simplify(std::vector<uint32_t> const& indices,
+    std::vector<glm::vec3> const& positions, size_t targetIndexCount, float& error) {
+
+  error = 0.f;
+
+  if (indices.size() <= targetIndexCount) {
+    return indices;
+  }
+
+  glm::vec3 bboxMin(std::numeric_limits<float>::max());
+  glm::vec3 bboxMax(std::numeric_limits<float>::lowest());
+
+  for (uint32_t i : indices) {
+    bboxMin = glm::min(bboxMin, positions[i]);
+    bboxMax = glm::max(bboxMax, positions[i]);
+  }
+
+  glm::vec3 extent    = bboxMax - bboxMin;
+  float     maxExtent = std::max(extent.x, std::max(extent.y, extent.z));
+
+  std::vector<uint32_t> result;
+  std::vector<uint32_t> representatives(positions.size());
+
+  for (float resolution = cMaxGridResolution; resolution >= 1.f; resolution /= cGridCoarsening) {
+
+    float cellSize = maxExtent / resolution;
+
+    // Assign each used vertex to a cell and accumulate the positions of each cell.
+    std::unordered_map<uint64_t, uint32_t> cellIndices;
+    std::vector<glm::vec3>                 cellSums;
+    std::vector<uint32_t>                  cellCounts;
+    std::vector<uint32_t>                  vertexCells(positions.size());
+
+    for (uint32_t i : indices) {
+      glm::vec3 cell = cellSize > 0.f ? (positions[i] - bboxMin) / cellSize : glm::vec3(0.f);
+      uint64_t  key  = static_cast<uint64_t>(cell.x) | (static_cast<uint64_t>(cell.y) << 21) |
+                     (static_cast<uint64_t>(cell.z) << 42);
+
+      auto it = cellIndices.emplace(key, static_cast<uint32_t>(cellSums.size())).first;
+
+      if (it->second == cellSums.size()) {
+        cellSums.emplace_back(0.f);
+        cellCounts.emplace_back(0);
+      }
+
+      // vertices which are used several times are counted several times, which gives them more
+      // weight
+      vertexCells[i] = it->second;
+      cellSums[it->second] += positions[i];
+      ++cellCounts[it->second];
+    }
+
+    // For each cell, find the vertex which is closest to the mean position.
+    std::vector<float>    bestDistances(cellSums.size(), std::numeric_limits<float>::max());
+    std::vector<uint32_t> cellRepresentatives(cellSums.size());
+
+    for (uint32_t i : indices) {
+      uint32_t cell     = vertexCells[i];
+      float    distance = glm::length(positions[i] - cellSums[cell] / float(cellCounts[cell]));
+
+      if (distance < bestDistances[cell]) {
+        bestDistances[cell]       = distance;
+        cellRepresentatives[cell] = i;
+      }
+    }
+
+    error = 0.f;
+    for (uint32_t i : indices) {
+      representatives[i] = cellRepresentatives[vertexCells[i]];
+      error = std::max(error, glm::length(positions[i] - positions[representatives[i]]));
+    }
+
+    // Collect the remaining triangles. They are rotated so that the smallest index comes first;
+    // this keeps the winding order and makes duplicates easy to find.
+    std::set<std::tuple<uint32_t, uint32_t, uint32_t>> triangles;
+    result.clear();
+
+    for (size_t t(0); t + 2 < indices.size(); t += 3) {
+      uint32_t a = representatives[indices[t]];
+      uint32_t b = representatives[indices[t + 1]];
+      uint32_t c = representatives[indices[t + 2]];
+
+      if (a == b || b == c || c == a) {
+        continue;
+      }
+
+      while (a > b || a > c) {
+        std::tie(a, b, c) = std::make_tuple(b, c, a);
+      }
+
+      if (triangles.emplace(a, b, c).second) {
+        result.insert(result.end(), {a, b, c});
+      }
+    }
+
+    if (result.size() <= targetIndexCount) {
+      break;
+    }
+  }
+
+  return result;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+size_t getMaxMeshletCount(size_t indexCount) {
+  size_t triangleCount = indexCount / 3;
+
+  if (triangleCount == 0) {
+    return 0;
+  }
+
+  // A Meshlet is only finished early if the next triangle could exceed the vertex limit. Then it
+  // has at least MAX_MESHLET_VERTICES - 2 vertices; as each triangle adds at most three of them,
+  // it has at least ceil((MAX_MESHLET_VERTICES - 2) / 3) triangles.
+  size_t minTriangles = (MAX_MESHLET_VERTICES - 2 + 2) / 3;
+
+  return triangleCount / minTriangles + 1;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void buildMeshlets(std::vector<uint32_t> const& indices, std::vector<glm::vec3> const& positions,
+    std::vector<Meshlet>& meshlets, std::vector<uint32_t>& meshletVertices,
+    std::vector<uint32_t>& meshletTriangles) {
+
+  const uint8_t cUnused = 0xff;
+
+  // the index of each vertex in the current Meshlet, or cUnused
+  std::vector<uint8_t> localIndices(positions.size(), cUnused);
+
+  Meshlet meshlet{};
+  meshlet.mVertexOffset   = static_cast<uint32_t>(meshletVertices.size());
+  meshlet.mTriangleOffset = static_cast<uint32_t>(meshletTriangles.size());
+
+  auto finishMeshlet = [&]() {
+    if (meshlet.mTriangleCount == 0) {
+      return;
+    }
+
+    computeMeshletBounds(meshlet, meshletVertices, meshletTriangles, positions);
+
+    for (uint32_t i(0); i < meshlet.mVertexCount; ++i) {
+      localIndices[meshletVertices[meshlet.mVertexOffset + i]] = cUnused;
+    }
+
+    meshlets.push_back(meshlet);
+
+    meshlet                 = Meshlet{};
+    meshlet.mVertexOffset   = static_cast<uint32_t>(meshletVertices.size());
+    meshlet.mTriangleOffset = static_cast<uint32_t>(meshletTriangles.size());
+  };
+
+  for (size_t t(0); t + 2 < indices.size(); t += 3) {
+
+    // vertices which occur twice in a degenerate triangle are counted twice, this is harmless
+    uint32_t newVertices = 0;
+    for (size_t i(0); i < 3; ++i) {
+      newVertices += localIndices[indices[t + i]] == cUnused ? 1 : 0;
+    }
+
+    if (meshlet.mVertexCount + newVertices > MAX_MESHLET_VERTICES ||
+        meshlet.mTriangleCount == MAX_MESHLET_TRIANGLES) {
+      finishMeshlet();
+    }
+
+    uint32_t triangle = 0;
+
+    for (size_t i(0); i < 3; ++i) {
+      uint32_t vertex = indices[t + i];
+
+      if (localIndices[vertex] == cUnused) {
+        localIndices[vertex] = static_cast<uint8_t>(meshlet.mVertexCount++);
+        meshletVertices.push_back(vertex);
+      }
+
+      triangle |= static_cast<uint32_t>(localIndices[vertex]) << (8 * i);
+    }
+
+    meshletTriangles.push_back(triangle);
+    ++meshlet.mTriangleCount;
+  }
+
+  finishMeshlet();
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+} // namespace Illusion::Graphics::MeshOptimizer
@@ -0,0 +1,104 @@
+////////////////////////////////////////////////////////////////////////////////////////////////////
+//                                                                                                //
+//    _)  |  |            _)                This code may be used and modified under the terms    //
+//     |  |  |  |  | (_-<  |   _ \    \     of the MIT license. See the LICENSE file for details. //
+//    _| _| _| \_,_| ___/ _| \___/ _| _|    Copyright (c) 2018-2019 Simon Schneegans              //
+//                                                                                                //
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#ifndef ILLUSION_GRAPHICS_MESH_OPTIMIZER_HPP
+#define ILLUSION_GRAPHICS_MESH_OPTIMIZER_HPP
+
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <vector>
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// These functions reorder the indices and vertices of indexed triangle lists so that the GPU     //
+// has to do less work when drawing them. They are usually applied in this order:                 //
+//   weldVertices() - makes all indices referring identical vertices use the same vertex.         //
+//   optimizeVertexCache() - reorders the triangles for a high hit rate of the post-transform     //
+//                           vertex cache, using Tom Forsyth's linear-speed algorithm.            //
+//   optimizeOverdraw() - reorders clusters of triangles so that triangles which are likely to    //
+//                        occlude others come first (Sander et al., 2007). The clusters are       //
+//                        not split, so the vertex cache efficiency is mostly preserved.          //
+//   optimizeVertexFetch() - reorders the vertices in the order of their first use and removes    //
+//                           unused vertices. This improves the locality of vertex fetches.       //
+// Furthermore, simplify() creates coarser index lists which use the same vertices; they can be   //
+// used as levels of detail. buildMeshlets() partitions a triangle list into small clusters for   //
+// mesh shaders.                                                                                  //
+// The functions are not thread-safe in any way, but they do not share any state. Hence they can  //
+// be called for different meshes by several threads at the same time.                            //
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+namespace Illusion::Graphics::MeshOptimizer {
+
+// Replaces each index by the index of the first vertex with exactly the same bytes. vertexSize is
+// the size of one vertex in bytes; the vertices must not contain uninitialized padding.
+void weldVertices(
+    std::vector<uint32_t>& indices, void const* vertices, size_t vertexCount, size_t vertexSize);
+
+// Reorders the triangles of the given list. All indices must be smaller than vertexCount.
+void optimizeVertexCache(std::vector<uint32_t>& indices, size_t vertexCount);
+
+// Reorders clusters of triangles of the given list. This should be called after
+// optimizeVertexCache(), as the clusters are found by simulating a vertex cache.
+void optimizeOverdraw(std::vector<uint32_t>& indices, std::vector<glm::vec3> const& positions);
+
+// Reorders the vertices (vertexSize bytes each) in place and updates the indices accordingly.
+// Vertices which are not referenced by any index are dropped. The remaining vertices are at the
+// beginning of the array, the returned number of them should be used as new vertex count.
+size_t optimizeVertexFetch(
+    std::vector<uint32_t>& indices, void* vertices, size_t vertexCount, size_t vertexSize);
+
+// Returns a coarser version of the given triangle list. The vertices are clustered in a regular
+// grid (Rossignac and Borrel, 1993) and each cluster is represented by the vertex closest to its
+// mean, so no new vertices are required. Triangles which become degenerate or duplicates are
+// removed. The grid is coarsened until at most targetIndexCount indices remain; for very small
+// targets, this may fail and the result of the coarsest grid is returned. The maximum distance of
+// a vertex to its representative is stored in error; this is an upper bound for the deviation of
+// the surface.
+std::vector<uint32_t> simplify(std::vector<uint32_t> const& indices,
+    std::vector<glm::vec3> const& positions, size_t targetIndexCount, float& error);
+
+// A Meshlet references mVertexCount consecutive vertex indices starting at mVertexOffset and
+// mTriangleCount consecutive triangles starting at mTriangleOffset. Each triangle is one uint32_t
+// containing three 8-bit indices into the vertex indices of the Meshlet (in bits 0-7, 8-15 and
+// 16-23). The layout of this struct matches the std430 layout of a corresponding GLSL struct.
+// All triangles of the Meshlet face away from an eye position e if
+//   dot(mCenter - e, mConeAxis) >= mConeCutoff * length(mCenter - e) + mRadius.
+// If the normals of the triangles diverge too much, mConeCutoff is one and this is never true.
+struct Meshlet {
+  glm::vec3 mCenter;
+  float     mRadius;
+  glm::vec3 mConeAxis;
+  float     mConeCutoff;
+  uint32_t  mVertexOffset;
+  uint32_t  mTriangleOffset;
+  uint32_t  mVertexCount;
+  uint32_t  mTriangleCount;
+};
+
+// These limits are supported by all implementations of VK_EXT_mesh_shader.
+const uint32_t MAX_MESHLET_VERTICES  = 64;
+const uint32_t MAX_MESHLET_TRIANGLES = 124;
+
+// Returns an upper bound for the number of Meshlets buildMeshlets() creates for a triangle list
+// with the given number of indices. At most MAX_MESHLET_VERTICES vertex indices are added for
+// each of them, but never more than indexCount.
+size_t getMaxMeshletCount(size_t indexCount);
+
+// Partitions the given triangle list into Meshlets with at most MAX_MESHLET_VERTICES vertices and
+// MAX_MESHLET_TRIANGLES triangles each. The triangles are added in order, so a list which has been
+// optimized with optimizeVertexCache() results in fewer and more compact Meshlets. The Meshlets,
+// their vertex indices and their triangles are appended to the given vectors; the offsets of the
+// Meshlets refer to the positions in these vectors. The bounding spheres and normal cones are
+// computed from the given positions.
+void buildMeshlets(std::vector<uint32_t> const& indices, std::vector<glm::vec3> const& positions,
+    std::vector<Meshlet>& meshlets, std::vector<uint32_t>& meshletVertices,
+    std::vector<uint32_t>& meshletTriangles);
+
+} // namespace Illusion::Graphics::MeshOptimizer
+
+#endif // ILLUSION_GRAPHICS_MESH_OPTIMIZER_HPP
@@ -0,0 +1,458 @@
+////////////////////////////////////////////////////////////////////////////////////////////////////
+//                                                                                                //
+//    _)  |  |            _)                This code may be used and modified under the terms    //
+//     |  |  |  |  | (_-<  |   _ \    \     of the MIT license. See the LICENSE file for details. //
+//    _| _| _| \_,_| ___/ _| \___/ _| _|    Copyright (c) 2018-2019 Simon Schneegans              //
+//                                                                                                //
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include "MipmapGenerator.hpp"
+
+#include "BackedBuffer.hpp"
+#include "CommandBuffer.hpp"
+#include "Device.hpp"
+#include "PhysicalDevice.hpp"
+#include "Shader.hpp"
+#include "ShaderSource.hpp"
+#include "Texture.hpp"
+#include "Utils.hpp"
+
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+
+namespace Illusion::Graphics {
+
+namespace {
+
+// This matches the PushConstants of the shader below.
+struct PushConstants {
+  uint32_t mLevelCount = 0;
+  uint32_t mGroupCount = 0;
+  uint32_t mFilter     = 0;
+};
+
+// The level images, the loadLevel(), storeLevel() and levelSize() functions and the COUNTER_BINDING
+// are generated by getShaderCode(). The bindings refer to the levels relative to the first level of
+// the dispatch.
+const std::string MIPMAP_SHADER = R"(
+  layout (local_size_x = 256) in;
+
+  layout (push_constant, std430) uniform PushConstants {
+    uint mLevelCount;
+    uint mGroupCount;
+    uint mFilter;
+  } pushConstants;
+
+  layout (std430, binding = COUNTER_BINDING) coherent buffer Counters {
+    uint mCounters[];
+  };
+
+  const uint FILTER_SRGB = 1u;
+  const uint FILTER_HDR  = 2u;
+
+  shared vec4 sTexels[16][16];
+  shared bool sIsLast;
+
+  vec3 toLinear(vec3 c) {
+    return mix(c / 12.92, pow((c + 0.055) / 1.055, vec3(2.4)), greaterThan(c, vec3(0.04045)));
+  }
+
+  vec3 toSrgb(vec3 c) {
+    return mix(c * 12.92, 1.055 * pow(c, vec3(1.0 / 2.4)) - 0.055, greaterThan(c, vec3(0.0031308)));
+  }
+
+  vec4 reduce(vec4 a, vec4 b, vec4 c, vec4 d) {
+    if (pushConstants.mFilter == FILTER_HDR) {
+      const vec3 luminance = vec3(0.2126, 0.7152, 0.0722);
+      vec4 w = 1.0 / (1.0 + vec4(dot(a.rgb, luminance), dot(b.rgb, luminance),
+                                 dot(c.rgb, luminance), dot(d.rgb, luminance)));
+      return (a * w.x + b * w.y + c * w.z + d * w.w) / (w.x + w.y + w.z + w.w);
+    }
+
+    return (a + b + c + d) * 0.25;
+  }
+
+  // Texels outside of the level are clamped to its border. They only contribute to texels of the
+  // coarser levels which are outside of these levels as well.
+  vec4 loadTexel(uint level, ivec2 p, uint layer) {
+    vec4 value = loadLevel(level, ivec3(min(p, levelSize(level) - 1), layer));
+
+    if (pushConstants.mFilter == FILTER_SRGB) {
+      value.rgb = toLinear(value.rgb);
+    }
+
+    return value;
+  }
+
+  void storeTexel(uint level, ivec2 p, uint layer, vec4 value) {
+    if (all(lessThan(p, levelSize(level)))) {
+      if (pushConstants.mFilter == FILTER_SRGB) {
+        value.rgb = toSrgb(value.rgb);
+      }
+
+      storeLevel(level, ivec3(p, layer), value);
+    }
+  }
+
+  // Writes the levels base + 1 to base + count (at most six) of the given tile of 64x64 texels of
+  // the level base.
+  void reduceTile(uint base, uint count, ivec2 tile, uint layer) {
+    ivec2 local = ivec2(gl_LocalInvocationIndex % 16u, gl_LocalInvocationIndex / 16u);
+
+    // each invocation computes 2x2 texels of the first level from 4x4 texels
+    vec4 texels[4];
+
+    for (int i = 0; i < 4; ++i) {
+      ivec2 offset = ivec2(i % 2, i / 2);
+      ivec2 p      = tile * 64 + local * 4 + offset * 2;
+
+      texels[i] = reduce(loadTexel(base, p, layer), loadTexel(base, p + ivec2(1, 0), layer),
+                         loadTexel(base, p + ivec2(0, 1), layer),
+                         loadTexel(base, p + ivec2(1, 1), layer));
+
+      storeTexel(base + 1u, tile * 32 + local * 2 + offset, layer, texels[i]);
+    }
+
+    if (count < 2u) {
+      return;
+    }
+
+    vec4 texel = reduce(texels[0], texels[1], texels[2], texels[3]);
+    storeTexel(base + 2u, tile * 16 + local, layer, texel);
+    sTexels[local.y][local.x] = texel;
+
+    // the remaining levels are reduced in shared memory
+    for (uint level = 3u; level <= count; ++level) {
+      int  size   = 64 >> level;
+      bool active = all(lessThan(local, ivec2(size)));
+
+      barrier();
+
+      if (active) {
+        ivec2 p = local * 2;
+        texel   = reduce(sTexels[p.y][p.x], sTexels[p.y][p.x + 1], sTexels[p.y + 1][p.x],
+                         sTexels[p.y + 1][p.x + 1]);
+      }
+
+      barrier();
+
+      if (active) {
+        sTexels[local.y][local.x] = texel;
+        storeTexel(base + level, tile * size + local, layer, texel);
+      }
+    }
+  }
+
+  void main() {
+    uint layer = gl_WorkGroupID.z;
+
+    reduceTile(0u, min(pushConstants.mLevelCount, 6u), ivec2(gl_WorkGroupID.xy), layer);
+
+  #ifdef SECOND_STAGE
+    if (pushConstants.mLevelCount <= 6u) {
+      return;
+    }
+
+    // make the texels of level six visible to the last work group
+    memoryBarrierImage();
+    barrier();
+
+    if (gl_LocalInvocationIndex == 0u) {
+      sIsLast = atomicAdd(mCounters[layer], 1u) == pushConstants.mGroupCount - 1u;
+    }
+
+    barrier();
+
+    if (!sIsLast) {
+      return;
+    }
+
+    // level six has at most 64x64 texels, the last work group reduces them like a tile of the
+    // first level; the counter is reset for the next dispatch
+    if (gl_LocalInvocationIndex == 0u) {
+      mCounters[layer] = 0u;
+    }
+
+    reduceTile(6u, pushConstants.mLevelCount - 6u, ivec2(0), layer);
+  #endif
+  }
+)";
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+// Returns the GLSL format qualifier for storage images of the given format or an empty string if
+// the format is not supported. Most of them require shaderStorageImageExtendedFormats.
+std::string getStorageFormat(DevicePtr const& device, vk::Format format) {
+  switch (format) {
+  case vk::Format::eR8G8B8A8Unorm:
+    return "rgba8";
+  case vk::Format::eR16G16B16A16Sfloat:
+    return "rgba16f";
+  case vk::Format::eR32G32B32A32Sfloat:
+    return "rgba32f";
+  case vk::Format::eR32Sfloat:
+    return "r32f";
+  default:
+    break;
+  }
+
+  if (!device->getEnabledFeatures().shaderStorageImageExtendedFormats) {
+    return "";
+  }
+
+  switch (format) {
+  case vk::Format::eR8Unorm:
+    return "r8";
+  case vk::Format::eR8G8Unorm:
+    return "rg8";
+  case vk::Format::eR16Unorm:
+    return "r16";
+  case vk::Format::eR16G16Unorm:
+    return "rg16";
+  case vk::Format::eR16G16B16A16Unorm:
+    return "rgba16";
+  case vk::Format::eR16Sfloat:
+    return "r16f";
+  case vk::Format::eR16G16Sfloat:
+    return "rg16f";
+  case vk::Format::eR32G32Sfloat:
+    return "rg32f";
+  case vk::Format::eB10G11R11UfloatPack32:
+    return "r11f_g11f_b10f";
+  case vk::Format::eA2B10G10R10UnormPack32:
+    return "rgb10_a2";
+  default:
+    return "";
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+// Prepends the declarations of the given number of level images to MIPMAP_SHADER. The second
+// stage requires thirteen of them.
+std::string getShaderCode(std::string const& format, uint32_t imageCount) {
+  std::string images, loads, stores, sizes;
+
+  for (uint32_t i(0); i < imageCount; ++i) {
+    std::string n = std::to_string(i);
+    images += "layout (binding = " + n + ", " + format + ") uniform coherent image2DArray level" +
+              n + ";\n";
+    loads += "  case " + n + "u: return imageLoad(level" + n + ", p);\n";
+    stores += "  case " + n + "u: imageStore(level" + n + ", p, value); break;\n";
+    sizes += "  case " + n + "u: return imageSize(level" + n + ").xy;\n";
+  }
+
+  std::string code = "#version 450\n";
+
+  if (imageCount == 13) {
+    code += "#define SECOND_STAGE\n";
+  }
+
+  code += "#define COUNTER_BINDING " + std::to_string(imageCount) + "\n";
+  code += images;
+  code += "vec4 loadLevel(uint level, ivec3 p) {\nswitch (level) {\n" + loads +
+          "}\nreturn vec4(0);\n}\n";
+  code += "void storeLevel(uint level, ivec3 p, vec4 value) {\nswitch (level) {\n" + stores +
+          "}\n}\n";
+  code += "ivec2 levelSize(uint level) {\nswitch (level) {\n" + sizes + "}\nreturn ivec2(0);\n}\n";
+
+  return code + MIPMAP_SHADER;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+uint32_t getGroupCount(uint32_t size, uint32_t groupSize) {
+  return (size + groupSize - 1) / groupSize;
+}
+
+} // namespace
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+MipmapGenerator::MipmapGenerator(DevicePtr const& device)
+    : mDevice(device) {
+
+  auto const& limits = mDevice->getPhysicalDevice()->getProperties().limits;
+  uint32_t    images = std::min(limits.maxPerStageDescriptorStorageImages, 13u);
+
+  // either one stage of up to six levels or two stages of six levels each
+  mMaxLevelsPerDispatch = images == 13 ? 12 : std::min(images - 1, 6u);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+MipmapGenerator::~MipmapGenerator() = default;
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+vk::ImageUsageFlags MipmapGenerator::getRequiredUsage(DevicePtr const& device, vk::Format format) {
+  vk::ImageUsageFlags usage =
+      vk::ImageUsageFlagBits::eTransferSrc | vk::ImageUsageFlagBits::eTransferDst;
+
+  if (supportsCompute(device, format)) {
+    usage |= vk::ImageUsageFlagBits::eStorage;
+  }
+
+  return usage;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void MipmapGenerator::generate(CommandBuffer& cmd, TexturePtr const& texture, MipmapFilter filter) {
+  auto const& info = texture->mImageInfo;
+
+  if (info.imageType != vk::ImageType::e2D || !(info.usage & vk::ImageUsageFlagBits::eStorage) ||
+      !supportsCompute(mDevice, info.format)) {
+
+    if (filter != MipmapFilter::eBox) {
+      throw std::runtime_error("Failed to generate mipmaps: Format " + vk::to_string(info.format) +
+                               " can only be filtered with MipmapFilter::eBox!");
+    }
+
+    generateWithBlits(cmd, texture);
+    return;
+  }
+
+  auto& shader = mShaders[info.format];
+
+  if (!shader) {
+    shader = Shader::create(mDevice);
+    shader->addModule(vk::ShaderStageFlagBits::eCompute,
+        GlslCode::create(getShaderCode(getStorageFormat(mDevice, info.format),
+                             mMaxLevelsPerDispatch + 1),
+            "MipmapGenerator"));
+  }
+
+  // there is one counter for each array layer; they are reset by the shader
+  if (mCounterCount < info.arrayLayers) {
+    std::vector<uint32_t> zeros(info.arrayLayers, 0);
+    mCounters     = mDevice->createBackedBuffer(vk::BufferUsageFlagBits::eStorageBuffer,
+        vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent,
+        zeros.size() * sizeof(uint32_t), zeros.data());
+    mCounterCount = info.arrayLayers;
+  }
+
+  auto const& views = getLevelViews(texture);
+
+  cmd.setShader(shader);
+  cmd.bindingState().setStorageBuffer(
+      mCounters, mCounterCount * sizeof(uint32_t), 0, 0, mMaxLevelsPerDispatch + 1);
+
+  PushConstants constants;
+  constants.mFilter = static_cast<uint32_t>(filter);
+
+  for (uint32_t first = 0; first + 1 < info.mipLevels; first += constants.mLevelCount) {
+    uint32_t width   = std::max(info.extent.width >> first, 1u);
+    uint32_t height  = std::max(info.extent.height >> first, 1u);
+    uint32_t groupsX = getGroupCount(width, 64);
+    uint32_t groupsY = getGroupCount(height, 64);
+
+    // the second stage reduces only one tile, so there must not be more than 64x64 tiles
+    uint32_t maxLevels = mMaxLevelsPerDispatch;
+    if (groupsX > 64 || groupsY > 64) {
+      maxLevels = std::min(maxLevels, 6u);
+    }
+
+    constants.mLevelCount = std::min(maxLevels, info.mipLevels - 1 - first);
+    constants.mGroupCount = groupsX * groupsY;
+
+    // unused bindings get the last level, as all bindings of the shader have to be valid
+    for (uint32_t i = 0; i <= mMaxLevelsPerDispatch; ++i) {
+      cmd.bindingState().setStorageImage(
+          texture, views[std::min(first + i, info.mipLevels - 1)], 0, i);
+    }
+
+    cmd.pushConstants(constants);
+    cmd.dispatch(groupsX, groupsY, info.arrayLayers);
+  }
+
+  cmd.bindingState().reset(0);
+
+  // this updates the mCurrentLayout of the texture
+  cmd.transitionImage(texture, vk::ImageLayout::eShaderReadOnlyOptimal,
+      vk::PipelineStageFlagBits::eFragmentShader, vk::AccessFlagBits::eShaderRead);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+bool MipmapGenerator::supportsCompute(DevicePtr const& device, vk::Format format) {
+  auto const& physicalDevice = device->getPhysicalDevice();
+  auto const& limits         = physicalDevice->getProperties().limits;
+  auto        features = physicalDevice->getFormatProperties(format).optimalTilingFeatures;
+
+  return limits.maxComputeWorkGroupInvocations >= 256 && limits.maxComputeWorkGroupSize[0] >= 256 &&
+         (features & vk::FormatFeatureFlagBits::eStorageImage) &&
+         !getStorageFormat(device, format).empty();
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void MipmapGenerator::generateWithBlits(CommandBuffer& cmd, TexturePtr const& texture) {
+  auto const& info = texture->mImageInfo;
+  auto        features =
+      mDevice->getPhysicalDevice()->getFormatProperties(info.format).optimalTilingFeatures;
+
+  if (!(features & vk::FormatFeatureFlagBits::eSampledImageFilterLinear)) {
+    throw std::runtime_error(
+        "Failed to generate mipmaps: Texture format does not support linear sampling!");
+  }
+
+  if (Utils::isCompressedFormat(info.format)) {
+    throw std::runtime_error(
+        "Failed to generate mipmaps: Compressed textures cannot be the destination of blits!");
+  }
+
+  uint32_t mipWidth  = info.extent.width;
+  uint32_t mipHeight = info.extent.height;
+
+  // The CommandBuffer tracks the layout of each mipmap level. Before each blit, the source level is
+  // transitioned to eTransferSrcOptimal and the destination level to eTransferDstOptimal with one
+  // barrier.
+  for (uint32_t i = 1; i < info.mipLevels; ++i) {
+    cmd.blitImage(texture, i - 1, texture, i, glm::uvec2(mipWidth, mipHeight),
+        glm::uvec2(std::max(mipWidth / 2, 1u), std::max(mipHeight / 2, 1u)), vk::Filter::eLinear);
+
+    mipWidth  = std::max(mipWidth / 2, 1u);
+    mipHeight = std::max(mipHeight / 2, 1u);
+  }
+
+  // this updates the mCurrentLayout of the texture
+  cmd.transitionImage(texture, vk::ImageLayout::eShaderReadOnlyOptimal,
+      vk::PipelineStageFlagBits::eFragmentShader, vk::AccessFlagBits::eShaderRead);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+std::vector<vk::ImageViewPtr> const& MipmapGenerator::getLevelViews(TexturePtr const& texture) {
+
+  // drop the views of Textures which do not exist anymore
+  for (auto it = mLevelViews.begin(); it != mLevelViews.end();) {
+    if (it->first.expired()) {
+      it = mLevelViews.erase(it);
+    } else {
+      ++it;
+    }
+  }
+
+  auto& views = mLevelViews[texture];
+
+  if (views.empty()) {
+    for (uint32_t i(0); i < texture->mImageInfo.mipLevels; ++i) {
+      auto viewInfo                            = texture->mViewInfo;
+      viewInfo.viewType                        = vk::ImageViewType::e2DArray;
+      viewInfo.components                      = vk::ComponentMapping();
+      viewInfo.subresourceRange.baseMipLevel   = i;
+      viewInfo.subresourceRange.levelCount     = 1;
+      viewInfo.subresourceRange.baseArrayLayer = 0;
+      viewInfo.subresourceRange.layerCount     = texture->mImageInfo.arrayLayers;
+      views.push_back(mDevice->createImageView(viewInfo));
+    }
+  }
+
+  return views;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+} // namespace Illusion::Graphics
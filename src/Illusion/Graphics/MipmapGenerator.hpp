@@ -0,0 +1,92 @@
+////////////////////////////////////////////////////////////////////////////////////////////////////
+//                                                                                                //
+//    _)  |  |            _)                This code may be used and modified under the terms    //
+//     |  |  |  |  | (_-<  |   _ \    \     of the MIT license. See the LICENSE file for details. //
+//    _| _| _| \_,_| ___/ _| \___/ _| _|    Copyright (c) 2018-2019 Simon Schneegans              //
+//                                                                                                //
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#ifndef ILLUSION_GRAPHICS_MIPMAP_GENERATOR_HPP
+#define ILLUSION_GRAPHICS_MIPMAP_GENERATOR_HPP
+
+#include "fwd.hpp"
+
+#include <map>
+#include <memory>
+#include <vector>
+
+namespace Illusion::Graphics {
+
+// eBox averages 2x2 texels. eSrgb does the same, but the color channels are converted from sRGB to
+// linear before and back afterwards; this is meant for unorm images which contain sRGB data (for
+// sRGB formats, the conversion is done by the hardware anyway). eHdr weights each texel with
+// 1 / (1 + luminance), so that single very bright texels do not dominate the coarser levels.
+enum class MipmapFilter { eBox, eSrgb, eHdr };
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// The MipmapGenerator computes all mipmap levels of a Texture from its base level with a single  //
+// compute dispatch for Textures of up to 4096x4096 pixels. Each work group reduces a tile of     //
+// 64x64 texels to six levels in shared memory; the last work group which finishes (this is       //
+// detected with an atomic counter) then reduces the remaining texels to six more levels. Larger  //
+// Textures require one more dispatch for each factor of 64. All array layers (e.g. the faces of  //
+// a cubemap) are processed by the same dispatch.                                                 //
+// This requires a 2D Texture with eStorage usage whose format can be used as storage image (see  //
+// getRequiredUsage()). For other Textures, linearly filtered blits are recorded instead; this is //
+// only possible with MipmapFilter::eBox and on eGeneric CommandBuffers.                          //
+// The Shaders are compiled once for each format and kept for the lifetime of the generator, so   //
+// one instance should be used for all Textures. generate() records compute dispatches, hence it  //
+// has to be called outside of RenderPasses. It changes the current Shader of the CommandBuffer   //
+// and resets the bindings of descriptor set 0. The atomic counters are shared by all calls, so   //
+// CommandBuffers recorded with the same MipmapGenerator must not be executed at the same time.   //
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+class MipmapGenerator {
+
+ public:
+  // Syntactic sugar to create a std::shared_ptr for this class
+  template <typename... Args>
+  static MipmapGeneratorPtr create(Args&&... args) {
+    return std::make_shared<MipmapGenerator>(args...);
+  };
+
+  explicit MipmapGenerator(DevicePtr const& device);
+  virtual ~MipmapGenerator();
+
+  // Returns the usage flags which Textures of the given format need for generate(): eTransferSrc
+  // and eTransferDst for the blits and additionally eStorage if the compute path can be used.
+  static vk::ImageUsageFlags getRequiredUsage(DevicePtr const& device, vk::Format format);
+
+  // Records the commands which compute all levels of the given Texture from its first level. The
+  // Texture is transitioned to eShaderReadOnlyOptimal for fragment shaders afterwards. Throws a
+  // std::runtime_error if the Texture requires blits but the filter is not eBox.
+  void generate(CommandBuffer& cmd, TexturePtr const& texture, MipmapFilter filter);
+
+ private:
+  // Returns true if the compute path can be used for the given format.
+  static bool supportsCompute(DevicePtr const& device, vk::Format format);
+
+  void generateWithBlits(CommandBuffer& cmd, TexturePtr const& texture);
+
+  // Returns one ImageView of type e2DArray for each level of the given Texture.
+  std::vector<vk::ImageViewPtr> const& getLevelViews(TexturePtr const& texture);
+
+  DevicePtr mDevice;
+
+  // The number of levels which can be written by one dispatch; this is limited by
+  // maxPerStageDescriptorStorageImages.
+  uint32_t mMaxLevelsPerDispatch;
+
+  std::map<vk::Format, ShaderPtr> mShaders;
+  BackedBufferPtr                 mCounters;
+  uint32_t                        mCounterCount = 0;
+
+  // The ImageViews are kept as long as their Textures exist, so that they can be used again if the
+  // mipmaps of a Texture are updated multiple times.
+  std::map<std::weak_ptr<Texture>, std::vector<vk::ImageViewPtr>,
+      std::owner_less<std::weak_ptr<Texture>>>
+      mLevelViews;
+};
+
+} // namespace Illusion::Graphics
+
+#endif // ILLUSION_GRAPHICS_MIPMAP_GENERATOR_HPP
@@ -0,0 +1,242 @@
+////////////////////////////////////////////////////////////////////////////////////////////////////
+//                                                                                                //
+//    _)  |  |            _)                This code may be used and modified under the terms    //
+//     |  |  |  |  | (_-<  |   _ \    \     of the MIT license. See the LICENSE file for details. //
+//    _| _| _| \_,_| ___/ _| \___/ _| _|    Copyright (c) 2018-2019 Simon Schneegans              //
+//                                                                                                //
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include "PassStatistics.hpp"
+
+#include "CommandBuffer.hpp"
+#include "Device.hpp"
+
+#include <algorithm>
+
+namespace Illusion::Graphics {
+
+namespace {
+
+// The results of a pipeline statistics query are written in the order of the flag bits, followed
+// by the availability.
+const uint32_t STATISTIC_COUNT = 7;
+
+} // namespace
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+PassStatistics::PassStatistics(DevicePtr const& device, uint32_t frameCount, uint32_t maxScopes)
+    : mDevice(device)
+    , mMaxScopes(maxScopes) {
+
+  auto const& features = mDevice->getEnabledFeatures();
+
+  mStatisticsEnabled = features.pipelineStatisticsQuery;
+
+  if (features.occlusionQueryPrecise) {
+    mOcclusionFlags = vk::QueryControlFlagBits::ePrecise;
+  }
+
+  mSlots.resize(frameCount);
+
+  for (auto& slot : mSlots) {
+    if (mStatisticsEnabled) {
+      vk::QueryPoolCreateInfo info;
+      info.queryType          = vk::QueryType::ePipelineStatistics;
+      info.queryCount         = maxScopes;
+      info.pipelineStatistics = getStatisticFlags();
+      slot.mStatisticsPool    = mDevice->createQueryPool(info);
+    }
+
+    vk::QueryPoolCreateInfo info;
+    info.queryType      = vk::QueryType::eOcclusion;
+    info.queryCount     = maxScopes;
+    slot.mOcclusionPool = mDevice->createQueryPool(info);
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+PassStatistics::~PassStatistics() = default;
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void PassStatistics::beginFrame(FrameContext::Frame const& frame) {
+  if (frame.mSlot >= mSlots.size()) {
+    throw std::runtime_error("Failed to begin frame of PassStatistics: There are only " +
+                             std::to_string(mSlots.size()) + " slots!");
+  }
+
+  auto& slot = mSlots[frame.mSlot];
+
+  if (slot.mPending) {
+    readResults(slot);
+  }
+
+  if (slot.mStatisticsPool) {
+    frame.mCmd->resetQueryPool(slot.mStatisticsPool, 0, mMaxScopes);
+  }
+
+  frame.mCmd->resetQueryPool(slot.mOcclusionPool, 0, mMaxScopes);
+
+  slot.mNames.clear();
+  slot.mFrameIndex = frame.mFrameIndex;
+  slot.mPending    = true;
+
+  mCurrentSlot = &slot;
+  mOpenScope   = -1;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void PassStatistics::beginScope(CommandBuffer& cmd, std::string const& name) {
+  if (!mCurrentSlot) {
+    return;
+  }
+
+  if (mOpenScope != -1) {
+    throw std::runtime_error(
+        "Failed to begin PassStatistics scope \"" + name + "\": Scopes cannot be nested!");
+  }
+
+  auto& names = mCurrentSlot->mNames;
+
+  if (names.size() >= mMaxScopes) {
+    mOpenScope = -2;
+    return;
+  }
+
+  mOpenScope = static_cast<int32_t>(names.size());
+  names.push_back(name);
+
+  if (mCurrentSlot->mStatisticsPool) {
+    cmd.beginQuery(mCurrentSlot->mStatisticsPool, mOpenScope, {});
+  }
+
+  cmd.beginQuery(mCurrentSlot->mOcclusionPool, mOpenScope, mOcclusionFlags);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void PassStatistics::endScope(CommandBuffer& cmd) {
+  if (!mCurrentSlot) {
+    return;
+  }
+
+  if (mOpenScope == -1) {
+    throw std::runtime_error("Failed to end PassStatistics scope: There is no open scope!");
+  }
+
+  if (mOpenScope >= 0) {
+    if (mCurrentSlot->mStatisticsPool) {
+      cmd.endQuery(mCurrentSlot->mStatisticsPool, mOpenScope);
+    }
+
+    cmd.endQuery(mCurrentSlot->mOcclusionPool, mOpenScope);
+  }
+
+  mOpenScope = -1;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+bool PassStatistics::isScopeOpen() const {
+  return mOpenScope != -1;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+std::vector<PassStatistics::PassResult> const& PassStatistics::getResults() const {
+  return mResults;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+uint64_t PassStatistics::getResultFrameIndex() const {
+  return mResultFrameIndex;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+vk::QueryPipelineStatisticFlags PassStatistics::getStatisticFlags() {
+  return vk::QueryPipelineStatisticFlagBits::eInputAssemblyVertices |
+         vk::QueryPipelineStatisticFlagBits::eInputAssemblyPrimitives |
+         vk::QueryPipelineStatisticFlagBits::eVertexShaderInvocations |
+         vk::QueryPipelineStatisticFlagBits::eClippingInvocations |
+         vk::QueryPipelineStatisticFlagBits::eClippingPrimitives |
+         vk::QueryPipelineStatisticFlagBits::eFragmentShaderInvocations |
+         vk::QueryPipelineStatisticFlagBits::eComputeShaderInvocations;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void PassStatistics::readResults(Slot& slot) {
+  slot.mPending = false;
+
+  uint32_t scopeCount = static_cast<uint32_t>(slot.mNames.size());
+
+  std::vector<uint64_t> statistics(scopeCount * (STATISTIC_COUNT + 1));
+  std::vector<uint64_t> occlusion(scopeCount * 2);
+
+  // The fence of the frame has been signaled, so all queries which have been ended are
+  // available. Queries without availability are skipped below.
+  auto flags = vk::QueryResultFlagBits::e64 | vk::QueryResultFlagBits::eWithAvailability;
+
+  vk::Result statisticsResult = vk::Result::eSuccess;
+  vk::Result occlusionResult  = vk::Result::eSuccess;
+
+  if (scopeCount > 0 && slot.mStatisticsPool) {
+    statisticsResult = mDevice->getHandle()->getQueryPoolResults(*slot.mStatisticsPool, 0,
+        scopeCount, statistics.size() * sizeof(uint64_t), statistics.data(),
+        sizeof(uint64_t) * (STATISTIC_COUNT + 1), flags);
+  }
+
+  if (scopeCount > 0) {
+    occlusionResult = mDevice->getHandle()->getQueryPoolResults(*slot.mOcclusionPool, 0,
+        scopeCount, occlusion.size() * sizeof(uint64_t), occlusion.data(), sizeof(uint64_t) * 2,
+        flags);
+  }
+
+  for (auto result : {statisticsResult, occlusionResult}) {
+    if (result != vk::Result::eSuccess && result != vk::Result::eNotReady) {
+      return;
+    }
+  }
+
+  mResults.clear();
+
+  for (uint32_t i = 0; i < scopeCount; ++i) {
+    auto result = std::find_if(mResults.begin(), mResults.end(),
+        [&slot, i](PassResult const& r) { return r.mName == slot.mNames[i]; });
+
+    if (result == mResults.end()) {
+      mResults.push_back({slot.mNames[i]});
+      result = mResults.end() - 1;
+    }
+
+    ++result->mScopeCount;
+
+    auto&     sum    = result->mStatistics;
+    uint64_t* values = statistics.data() + i * (STATISTIC_COUNT + 1);
+
+    if (values[STATISTIC_COUNT]) {
+      sum.mInputAssemblyVertices += values[0];
+      sum.mInputAssemblyPrimitives += values[1];
+      sum.mVertexShaderInvocations += values[2];
+      sum.mClippingInvocations += values[3];
+      sum.mClippingPrimitives += values[4];
+      sum.mFragmentShaderInvocations += values[5];
+      sum.mComputeShaderInvocations += values[6];
+    }
+
+    if (occlusion[i * 2 + 1]) {
+      sum.mSamplesPassed += occlusion[i * 2];
+    }
+  }
+
+  mResultFrameIndex = slot.mFrameIndex;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+} // namespace Illusion::Graphics
@@ -0,0 +1,118 @@
+////////////////////////////////////////////////////////////////////////////////////////////////////
+//                                                                                                //
+//    _)  |  |            _)                This code may be used and modified under the terms    //
+//     |  |  |  |  | (_-<  |   _ \    \     of the MIT license. See the LICENSE file for details. //
+//    _| _| _| \_,_| ___/ _| \___/ _| _|    Copyright (c) 2018-2019 Simon Schneegans              //
+//                                                                                                //
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#ifndef ILLUSION_GRAPHICS_PASS_STATISTICS_HPP
+#define ILLUSION_GRAPHICS_PASS_STATISTICS_HPP
+
+#include "FrameContext.hpp"
+
+#include <string>
+#include <vector>
+
+namespace Illusion::Graphics {
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// The PassStatistics count how much work the GPU does in named scopes of a frame, for example    //
+// how many vertices and fragments are shaded and how many primitives survive clipping. This can  //
+// be used to validate culling and mesh optimizations. Each scope records one pipeline statistics //
+// query and one occlusion query; scopes with the same name are summed up. Scopes cannot be       //
+// nested. If the PassStatistics are given to CommandBuffer::setPassStatistics(), each RenderPass //
+// which is begun on that CommandBuffer outside of a scope gets a scope with its name.            //
+// Like the GpuProfiler, there is one vk::QueryPool of each type for each frame in flight and the //
+// results of a Frame are read in the next beginFrame() for the same slot, so this never stalls.  //
+// The pipeline statistics stay zero if the pipelineStatisticsQuery feature is not supported. For //
+// secondary CommandBuffers to be counted, the inheritedQueries feature is required.              //
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+class PassStatistics {
+
+ public:
+  struct Statistics {
+    uint64_t mInputAssemblyVertices     = 0;
+    uint64_t mInputAssemblyPrimitives   = 0;
+    uint64_t mVertexShaderInvocations   = 0;
+    uint64_t mClippingInvocations       = 0; // primitives which reached the clipping stage
+    uint64_t mClippingPrimitives        = 0; // primitives which were output by the clipping stage
+    uint64_t mFragmentShaderInvocations = 0;
+    uint64_t mComputeShaderInvocations  = 0;
+
+    // The number of samples which passed the depth and stencil tests. If the
+    // occlusionQueryPrecise feature is not supported, this is only non-zero or zero.
+    uint64_t mSamplesPassed = 0;
+  };
+
+  struct PassResult {
+    std::string mName;
+    uint32_t    mScopeCount = 0; // how often a scope of this name was recorded in the frame
+    Statistics  mStatistics;
+  };
+
+  // Syntactic sugar to create a std::shared_ptr for this class
+  template <typename... Args>
+  static PassStatisticsPtr create(Args&&... args) {
+    return std::make_shared<PassStatistics>(args...);
+  };
+
+  // frameCount should match the FrameContext. At most maxScopes scopes can be recorded per frame;
+  // further scopes are ignored.
+  PassStatistics(DevicePtr const& device, uint32_t frameCount, uint32_t maxScopes = 64);
+  virtual ~PassStatistics();
+
+  // This has to be called after FrameContext::beginFrame() with the returned Frame, outside of a
+  // RenderPass. It reads the results of the last time this slot was used and resets the
+  // vk::QueryPools of the slot on the CommandBuffer of the Frame.
+  void beginFrame(FrameContext::Frame const& frame);
+
+  // Begins the queries of a scope. This has to be called outside of RenderPasses; the
+  // CommandBuffer has to be a primary one which is executed in the current Frame.
+  void beginScope(CommandBuffer& cmd, std::string const& name);
+
+  // Ends the queries of the open scope. This has to be called outside of RenderPasses as well.
+  void endScope(CommandBuffer& cmd);
+
+  // Returns true if a scope is open.
+  bool isScopeOpen() const;
+
+  // Returns the statistics of the most recent frame whose results have been read, one entry for
+  // each name in the order in which the names were first used in that frame.
+  std::vector<PassResult> const& getResults() const;
+
+  // Returns the number of the frame the results belong to; see FrameContext::getFrameIndex().
+  uint64_t getResultFrameIndex() const;
+
+  // The pipeline statistics which are queried. Secondary CommandBuffers inherit them, so that they
+  // can be executed inside a scope.
+  static vk::QueryPipelineStatisticFlags getStatisticFlags();
+
+ private:
+  struct Slot {
+    vk::QueryPoolPtr         mStatisticsPool;
+    vk::QueryPoolPtr         mOcclusionPool;
+    std::vector<std::string> mNames; // one for each recorded scope
+    uint64_t                 mFrameIndex = 0;
+    bool                     mPending    = false;
+  };
+
+  void readResults(Slot& slot);
+
+  DevicePtr             mDevice;
+  uint32_t              mMaxScopes;
+  bool                  mStatisticsEnabled = false;
+  vk::QueryControlFlags mOcclusionFlags;
+  std::vector<Slot>     mSlots;
+
+  Slot*   mCurrentSlot = nullptr;
+  int32_t mOpenScope   = -1; // -2 if the open scope has been dropped
+
+  std::vector<PassResult> mResults;
+  uint64_t                mResultFrameIndex = 0;
+};
+
+} // namespace Illusion::Graphics
+
+#endif // ILLUSION_GRAPHICS_PASS_STATISTICS_HPP
@@ -16,6 +16,7 @@
 #include <cmath>
 #include <iomanip>
 #include <iostream>
+#include <set>
 #include <sstream>
 
 namespace Illusion::Graphics {
@@ -79,19 +80,21 @@ std::string printMax(S val, T ref) {
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////
 
-PhysicalDevice::PhysicalDevice(vk::Instance const& instance, vk::PhysicalDevice const& device)
+PhysicalDevice::PhysicalDevice(
+    vk::Instance const& instance, vk::PhysicalDevice const& device, bool headless)
     : vk::PhysicalDevice(device) {
 
   auto                available  = getQueueFamilyProperties();
   std::array<bool, 3> foundQueue = {false, false, false};
 
-  // first find a family which can do everything
+  // first find a family which can do everything; GLFW is not initialized for headless Instances
   for (size_t i(0); i < available.size(); ++i) {
     vk::QueueFlags required(
         vk::QueueFlagBits::eGraphics | vk::QueueFlagBits::eCompute | vk::QueueFlagBits::eTransfer);
 
     if (available[i].queueCount > 0 && (available[i].queueFlags & required) == required &&
-        glfwGetPhysicalDevicePresentationSupport(instance, *this, static_cast<uint32_t>(i))) {
+        (headless || glfwGetPhysicalDevicePresentationSupport(
+                         instance, *this, static_cast<uint32_t>(i)))) {
 
       mQueueFamilies[Core::enumCast(QueueType::eGeneric)] = static_cast<uint32_t>(i);
       foundQueue[Core::enumCast(QueueType::eGeneric)]     = true;
@@ -160,6 +163,180 @@ PhysicalDevice::PhysicalDevice(vk::Instance const& instance, vk::PhysicalDevice
         std::min(available[mQueueFamilies[Core::enumCast(QueueType::eTransfer)]].queueCount - 1,
             mQueueIndices[Core::enumCast(QueueType::eCompute)] + 1);
   }
+
+  // query descriptor indexing and push descriptor support, the function pointers are only
+  // available if the Instance enabled VK_KHR_get_physical_device_properties2
+  std::set<std::string> extensions;
+  for (auto const& extension : enumerateDeviceExtensionProperties()) {
+    extensions.insert(extension.extensionName);
+  }
+
+  mPresentationSupported      = !headless && extensions.count(VK_KHR_SWAPCHAIN_EXTENSION_NAME) > 0;
+  mDrawIndirectCountSupported = extensions.count(VK_KHR_DRAW_INDIRECT_COUNT_EXTENSION_NAME) > 0;
+
+  auto getFeatures2 = (PFN_vkGetPhysicalDeviceFeatures2KHR)instance.getProcAddr(
+      "vkGetPhysicalDeviceFeatures2KHR");
+  auto getProperties2 = (PFN_vkGetPhysicalDeviceProperties2KHR)instance.getProcAddr(
+      "vkGetPhysicalDeviceProperties2KHR");
+
+  if (getFeatures2 && getProperties2 &&
+      extensions.count(VK_EXT_DESCRIPTOR_INDEXING_EXTENSION_NAME) &&
+      extensions.count(VK_KHR_MAINTENANCE3_EXTENSION_NAME)) {
+
+    vk::PhysicalDeviceFeatures2 features;
+    features.pNext = &mDescriptorIndexingFeatures;
+    getFeatures2(*this, reinterpret_cast<VkPhysicalDeviceFeatures2*>(&features));
+
+    vk::PhysicalDeviceProperties2 properties;
+    properties.pNext = &mDescriptorIndexingProperties;
+    getProperties2(*this, reinterpret_cast<VkPhysicalDeviceProperties2*>(&properties));
+
+    mDescriptorIndexingFeatures.pNext   = nullptr;
+    mDescriptorIndexingProperties.pNext = nullptr;
+  }
+
+  if (getProperties2 && extensions.count(VK_KHR_PUSH_DESCRIPTOR_EXTENSION_NAME)) {
+    vk::PhysicalDeviceProperties2 properties;
+    properties.pNext = &mPushDescriptorProperties;
+    getProperties2(*this, reinterpret_cast<VkPhysicalDeviceProperties2*>(&properties));
+
+    mPushDescriptorProperties.pNext = nullptr;
+    mPushDescriptorsSupported       = true;
+  }
+
+  if (getFeatures2 && extensions.count(VK_EXT_EXTENDED_DYNAMIC_STATE_EXTENSION_NAME)) {
+    vk::PhysicalDeviceExtendedDynamicStateFeaturesEXT extendedDynamicState;
+    vk::PhysicalDeviceFeatures2                       features;
+    features.pNext = &extendedDynamicState;
+    getFeatures2(*this, reinterpret_cast<VkPhysicalDeviceFeatures2*>(&features));
+
+    mExtendedDynamicStateSupported = extendedDynamicState.extendedDynamicState;
+  }
+
+  if (getFeatures2 && extensions.count(VK_KHR_TIMELINE_SEMAPHORE_EXTENSION_NAME)) {
+    vk::PhysicalDeviceTimelineSemaphoreFeaturesKHR timelineSemaphore;
+    vk::PhysicalDeviceFeatures2                    features;
+    features.pNext = &timelineSemaphore;
+    getFeatures2(*this, reinterpret_cast<VkPhysicalDeviceFeatures2*>(&features));
+
+    mTimelineSemaphoresSupported = timelineSemaphore.timelineSemaphore;
+  }
+
+  // VK_KHR_dynamic_rendering depends on VK_KHR_depth_stencil_resolve and thereby on
+  // VK_KHR_create_renderpass2, VK_KHR_multiview and VK_KHR_maintenance2
+  if (getFeatures2 && extensions.count(VK_KHR_DYNAMIC_RENDERING_EXTENSION_NAME) &&
+      extensions.count(VK_KHR_DEPTH_STENCIL_RESOLVE_EXTENSION_NAME) &&
+      extensions.count(VK_KHR_CREATE_RENDERPASS_2_EXTENSION_NAME) &&
+      extensions.count(VK_KHR_MULTIVIEW_EXTENSION_NAME) &&
+      extensions.count(VK_KHR_MAINTENANCE2_EXTENSION_NAME)) {
+    vk::PhysicalDeviceDynamicRenderingFeaturesKHR dynamicRendering;
+    vk::PhysicalDeviceFeatures2                   features;
+    features.pNext = &dynamicRendering;
+    getFeatures2(*this, reinterpret_cast<VkPhysicalDeviceFeatures2*>(&features));
+
+    mDynamicRenderingSupported = dynamicRendering.dynamicRendering;
+  }
+
+  if (getFeatures2 && extensions.count(VK_KHR_MULTIVIEW_EXTENSION_NAME)) {
+    vk::PhysicalDeviceMultiviewFeaturesKHR multiview;
+    vk::PhysicalDeviceFeatures2            features;
+    features.pNext = &multiview;
+    getFeatures2(*this, reinterpret_cast<VkPhysicalDeviceFeatures2*>(&features));
+
+    mMultiviewSupported = multiview.multiview;
+  }
+
+  // VK_EXT_mesh_shader depends on VK_KHR_spirv_1_4 and thereby on Vulkan 1.1 and
+  // VK_KHR_shader_float_controls
+  if (getFeatures2 && getProperties().apiVersion >= VK_API_VERSION_1_1 &&
+      extensions.count(VK_EXT_MESH_SHADER_EXTENSION_NAME) &&
+      extensions.count(VK_KHR_SPIRV_1_4_EXTENSION_NAME) &&
+      extensions.count(VK_KHR_SHADER_FLOAT_CONTROLS_EXTENSION_NAME)) {
+    vk::PhysicalDeviceMeshShaderFeaturesEXT meshShader;
+    vk::PhysicalDeviceFeatures2             features;
+    features.pNext = &meshShader;
+    getFeatures2(*this, reinterpret_cast<VkPhysicalDeviceFeatures2*>(&features));
+
+    mMeshShadersSupported = meshShader.taskShader && meshShader.meshShader;
+  }
+
+  // VK_KHR_fragment_shading_rate depends on VK_KHR_create_renderpass2, which is enabled together
+  // with VK_KHR_dynamic_rendering
+  if (getFeatures2 && getProperties2 && mDynamicRenderingSupported &&
+      extensions.count(VK_KHR_FRAGMENT_SHADING_RATE_EXTENSION_NAME)) {
+    vk::PhysicalDeviceFragmentShadingRateFeaturesKHR fragmentShadingRate;
+    vk::PhysicalDeviceFeatures2                      features;
+    features.pNext = &fragmentShadingRate;
+    getFeatures2(*this, reinterpret_cast<VkPhysicalDeviceFeatures2*>(&features));
+
+    vk::PhysicalDeviceProperties2 properties;
+    properties.pNext = &mFragmentShadingRateProperties;
+    getProperties2(*this, reinterpret_cast<VkPhysicalDeviceProperties2*>(&properties));
+
+    mFragmentShadingRateProperties.pNext = nullptr;
+
+    mFragmentShadingRateSupported = fragmentShadingRate.pipelineFragmentShadingRate &&
+                                    fragmentShadingRate.attachmentFragmentShadingRate;
+  }
+
+  // VK_EXT_external_memory_host depends on VK_KHR_external_memory and thereby on Vulkan 1.1
+  if (getProperties2 && getProperties().apiVersion >= VK_API_VERSION_1_1 &&
+      extensions.count(VK_EXT_EXTERNAL_MEMORY_HOST_EXTENSION_NAME) &&
+      extensions.count(VK_KHR_EXTERNAL_MEMORY_EXTENSION_NAME)) {
+    vk::PhysicalDeviceProperties2 properties;
+    properties.pNext = &mExternalMemoryHostProperties;
+    getProperties2(*this, reinterpret_cast<VkPhysicalDeviceProperties2*>(&properties));
+
+    mExternalMemoryHostProperties.pNext = nullptr;
+    mExternalMemoryHostSupported        = true;
+  }
+
+  if (getFeatures2 && extensions.count(VK_EXT_GRAPHICS_PIPELINE_LIBRARY_EXTENSION_NAME) &&
+      extensions.count(VK_KHR_PIPELINE_LIBRARY_EXTENSION_NAME)) {
+    vk::PhysicalDeviceGraphicsPipelineLibraryFeaturesEXT graphicsPipelineLibrary;
+    vk::PhysicalDeviceFeatures2                          features;
+    features.pNext = &graphicsPipelineLibrary;
+    getFeatures2(*this, reinterpret_cast<VkPhysicalDeviceFeatures2*>(&features));
+
+    mGraphicsPipelineLibrarySupported = graphicsPipelineLibrary.graphicsPipelineLibrary;
+  }
+
+  // VK_KHR_acceleration_structure depends on Vulkan 1.1, VK_KHR_deferred_host_operations,
+  // VK_KHR_buffer_device_address and VK_EXT_descriptor_indexing (and thereby on
+  // VK_KHR_maintenance3); VK_KHR_ray_query depends on VK_KHR_spirv_1_4 and thereby on
+  // VK_KHR_shader_float_controls
+  if (getFeatures2 && getProperties2 && getProperties().apiVersion >= VK_API_VERSION_1_1 &&
+      extensions.count(VK_KHR_ACCELERATION_STRUCTURE_EXTENSION_NAME) &&
+      extensions.count(VK_KHR_RAY_QUERY_EXTENSION_NAME) &&
+      extensions.count(VK_KHR_DEFERRED_HOST_OPERATIONS_EXTENSION_NAME) &&
+      extensions.count(VK_KHR_BUFFER_DEVICE_ADDRESS_EXTENSION_NAME) &&
+      extensions.count(VK_EXT_DESCRIPTOR_INDEXING_EXTENSION_NAME) &&
+      extensions.count(VK_KHR_MAINTENANCE3_EXTENSION_NAME) &&
+      extensions.count(VK_KHR_SPIRV_1_4_EXTENSION_NAME) &&
+      extensions.count(VK_KHR_SHADER_FLOAT_CONTROLS_EXTENSION_NAME)) {
+    vk::PhysicalDeviceAccelerationStructureFeaturesKHR accelerationStructure;
+    vk::PhysicalDeviceRayQueryFeaturesKHR              rayQuery;
+    vk::PhysicalDeviceBufferDeviceAddressFeaturesKHR   bufferDeviceAddress;
+    vk::PhysicalDeviceFeatures2                        features;
+    features.pNext              = &accelerationStructure;
+    accelerationStructure.pNext = &rayQuery;
+    rayQuery.pNext              = &bufferDeviceAddress;
+    getFeatures2(*this, reinterpret_cast<VkPhysicalDeviceFeatures2*>(&features));
+
+    vk::PhysicalDeviceProperties2 properties;
+    properties.pNext = &mAccelerationStructureProperties;
+    getProperties2(*this, reinterpret_cast<VkPhysicalDeviceProperties2*>(&properties));
+
+    mAccelerationStructureProperties.pNext = nullptr;
+
+    mRayQueriesSupported = accelerationStructure.accelerationStructure && rayQuery.rayQuery &&
+                           bufferDeviceAddress.bufferDeviceAddress;
+  }
+
+  mGetMemoryProperties2 = (PFN_vkGetPhysicalDeviceMemoryProperties2KHR)instance.getProcAddr(
+      "vkGetPhysicalDeviceMemoryProperties2KHR");
+  mMemoryBudgetSupported =
+      mGetMemoryProperties2 && extensions.count(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
 }
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -181,6 +358,39 @@ uint32_t PhysicalDevice::findMemoryType(
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////
 
+bool PhysicalDevice::hasMemoryType(uint32_t typeFilter, vk::MemoryPropertyFlags properties) const {
+
+  auto memProperties{getMemoryProperties()};
+
+  for (uint32_t i{0}; i < memProperties.memoryTypeCount; i++) {
+    if ((typeFilter & (1 << i)) &&
+        (memProperties.memoryTypes[i].propertyFlags & properties) == properties) {
+      return true;
+    }
+  }
+
+  return false;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+vk::SampleCountFlagBits PhysicalDevice::getMaxSampleCount(vk::SampleCountFlagBits limit) const {
+  auto const& limits = getProperties().limits;
+  auto        counts = limits.framebufferColorSampleCounts & limits.framebufferDepthSampleCounts;
+
+  for (auto count : {vk::SampleCountFlagBits::e64, vk::SampleCountFlagBits::e32,
+           vk::SampleCountFlagBits::e16, vk::SampleCountFlagBits::e8, vk::SampleCountFlagBits::e4,
+           vk::SampleCountFlagBits::e2}) {
+    if (count <= limit && (counts & count)) {
+      return count;
+    }
+  }
+
+  return vk::SampleCountFlagBits::e1;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
 uint32_t PhysicalDevice::getQueueFamily(QueueType type) const {
   return mQueueFamilies[Core::enumCast(type)];
 }
@@ -193,6 +403,160 @@ uint32_t PhysicalDevice::getQueueIndex(QueueType type) const {
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////
 
+bool PhysicalDevice::supportsBindless() const {
+  return mDescriptorIndexingFeatures.runtimeDescriptorArray &&
+         mDescriptorIndexingFeatures.descriptorBindingPartiallyBound &&
+         mDescriptorIndexingFeatures.descriptorBindingVariableDescriptorCount &&
+         mDescriptorIndexingFeatures.descriptorBindingUpdateUnusedWhilePending &&
+         mDescriptorIndexingFeatures.descriptorBindingSampledImageUpdateAfterBind &&
+         mDescriptorIndexingFeatures.descriptorBindingStorageBufferUpdateAfterBind &&
+         mDescriptorIndexingFeatures.shaderSampledImageArrayNonUniformIndexing;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+bool PhysicalDevice::supportsPresentation() const {
+  return mPresentationSupported;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+bool PhysicalDevice::supportsDrawIndirectCount() const {
+  return mDrawIndirectCountSupported;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+bool PhysicalDevice::supportsPushDescriptors() const {
+  return mPushDescriptorsSupported;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+bool PhysicalDevice::supportsExtendedDynamicState() const {
+  return mExtendedDynamicStateSupported;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+bool PhysicalDevice::supportsMemoryBudget() const {
+  return mMemoryBudgetSupported;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+bool PhysicalDevice::supportsTimelineSemaphores() const {
+  return mTimelineSemaphoresSupported;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+bool PhysicalDevice::supportsDynamicRendering() const {
+  return mDynamicRenderingSupported;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+bool PhysicalDevice::supportsMultiview() const {
+  return mMultiviewSupported;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+bool PhysicalDevice::supportsMeshShaders() const {
+  return mMeshShadersSupported;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+bool PhysicalDevice::supportsFragmentShadingRate() const {
+  return mFragmentShadingRateSupported;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+bool PhysicalDevice::supportsExternalMemoryHost() const {
+  return mExternalMemoryHostSupported;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+bool PhysicalDevice::supportsGraphicsPipelineLibrary() const {
+  return mGraphicsPipelineLibrarySupported;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+bool PhysicalDevice::supportsRayQueries() const {
+  return mRayQueriesSupported;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+bool PhysicalDevice::supportsSampledFormat(vk::Format format) const {
+  auto features = getFormatProperties(format).optimalTilingFeatures;
+  return static_cast<bool>(features & vk::FormatFeatureFlagBits::eSampledImage);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+vk::PhysicalDeviceDescriptorIndexingFeaturesEXT const&
+PhysicalDevice::getDescriptorIndexingFeatures() const {
+  return mDescriptorIndexingFeatures;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+vk::PhysicalDeviceDescriptorIndexingPropertiesEXT const&
+PhysicalDevice::getDescriptorIndexingProperties() const {
+  return mDescriptorIndexingProperties;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+vk::PhysicalDevicePushDescriptorPropertiesKHR const&
+PhysicalDevice::getPushDescriptorProperties() const {
+  return mPushDescriptorProperties;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+vk::PhysicalDeviceFragmentShadingRatePropertiesKHR const&
+PhysicalDevice::getFragmentShadingRateProperties() const {
+  return mFragmentShadingRateProperties;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+vk::PhysicalDeviceExternalMemoryHostPropertiesEXT const&
+PhysicalDevice::getExternalMemoryHostProperties() const {
+  return mExternalMemoryHostProperties;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+vk::PhysicalDeviceAccelerationStructurePropertiesKHR const&
+PhysicalDevice::getAccelerationStructureProperties() const {
+  return mAccelerationStructureProperties;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+vk::PhysicalDeviceMemoryBudgetPropertiesEXT PhysicalDevice::getMemoryBudget() const {
+  vk::PhysicalDeviceMemoryBudgetPropertiesEXT budget;
+
+  if (mMemoryBudgetSupported) {
+    vk::PhysicalDeviceMemoryProperties2 properties;
+    properties.pNext = &budget;
+    mGetMemoryProperties2(*this, reinterpret_cast<VkPhysicalDeviceMemoryProperties2*>(&properties));
+    budget.pNext = nullptr;
+  }
+
+  return budget;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
 void PhysicalDevice::printInfo() {
   // basic information
   vk::PhysicalDeviceProperties properties{getProperties()};
@@ -279,6 +643,20 @@ void PhysicalDevice::printInfo() {
   printCap("sparseResidencyAliased",                  features.sparseResidencyAliased);
   printCap("variableMultisampleRate",                 features.variableMultisampleRate);
   printCap("inheritedQueries",                        features.inheritedQueries);
+  printCap("bindless (VK_EXT_descriptor_indexing)",   supportsBindless());
+  printCap("VK_KHR_swapchain",                        supportsPresentation());
+  printCap("VK_KHR_draw_indirect_count",              supportsDrawIndirectCount());
+  printCap("VK_KHR_push_descriptor",                  supportsPushDescriptors());
+  printCap("VK_EXT_extended_dynamic_state",           supportsExtendedDynamicState());
+  printCap("VK_EXT_memory_budget",                    supportsMemoryBudget());
+  printCap("VK_KHR_timeline_semaphore",               supportsTimelineSemaphores());
+  printCap("VK_KHR_dynamic_rendering",                supportsDynamicRendering());
+  printCap("VK_KHR_multiview",                        supportsMultiview());
+  printCap("VK_EXT_mesh_shader",                      supportsMeshShaders());
+  printCap("VK_KHR_fragment_shading_rate",            supportsFragmentShadingRate());
+  printCap("VK_EXT_external_memory_host",             supportsExternalMemoryHost());
+  printCap("VK_EXT_graphics_pipeline_library",        supportsGraphicsPipelineLibrary());
+  printCap("VK_KHR_ray_query",                        supportsRayQueries());
 
   // format properties
   ILLUSION_MESSAGE << Core::Logger::PRINT_BOLD << "Format Properties " << Core::Logger::PRINT_RESET << std::endl;
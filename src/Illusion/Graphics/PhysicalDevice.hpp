@@ -24,19 +24,146 @@ class PhysicalDevice : public vk::PhysicalDevice {
     return std::make_shared<PhysicalDevice>(args...);
   };
 
-  PhysicalDevice(vk::Instance const& instance, vk::PhysicalDevice const& device);
+  // If headless is true, the queue families are chosen without considering presentation support.
+  PhysicalDevice(
+      vk::Instance const& instance, vk::PhysicalDevice const& device, bool headless = false);
 
   uint32_t findMemoryType(uint32_t typeFilter, vk::MemoryPropertyFlags properties) const;
 
+  // Returns true if findMemoryType() would succeed for the given arguments. This can be used to
+  // check for optional properties such as eLazilyAllocated.
+  bool hasMemoryType(uint32_t typeFilter, vk::MemoryPropertyFlags properties) const;
+
+  // Returns the highest sample count which is supported by color and depth attachments, but not
+  // more than the given one. This can be used to choose the samples of a multisampled RenderPass.
+  vk::SampleCountFlagBits getMaxSampleCount(
+      vk::SampleCountFlagBits limit = vk::SampleCountFlagBits::e64) const;
+
   // queues of this family can do graphics, compute, transfer and presentation
   uint32_t getQueueFamily(QueueType type) const;
   uint32_t getQueueIndex(QueueType type) const;
 
+  // Returns true if VK_EXT_descriptor_indexing is available with all features required for the
+  // bindless mode of the Device.
+  bool supportsBindless() const;
+
+  // Returns true if the PhysicalDevice was not created for a headless Instance and VK_KHR_swapchain
+  // is available. The Device enables VK_KHR_swapchain only in this case.
+  bool supportsPresentation() const;
+
+  // Returns true if VK_KHR_draw_indirect_count is available. The Device enables it in this case.
+  bool supportsDrawIndirectCount() const;
+
+  // Returns true if VK_KHR_push_descriptor is available. The Device enables it in this case, see
+  // Shader::setPerDrawSet().
+  bool supportsPushDescriptors() const;
+
+  // Returns true if VK_EXT_extended_dynamic_state is available. The Device enables it in this
+  // case, see GraphicsState::addDynamicState().
+  bool supportsExtendedDynamicState() const;
+
+  // Returns true if VK_EXT_memory_budget is available. The Device enables it in this case, see
+  // getMemoryBudget().
+  bool supportsMemoryBudget() const;
+
+  // Returns true if VK_KHR_timeline_semaphore is available with its timelineSemaphore feature. The
+  // Device enables it in this case, see SubmissionBatcher.
+  bool supportsTimelineSemaphores() const;
+
+  // Returns true if VK_KHR_dynamic_rendering is available with its dynamicRendering feature,
+  // together with the extensions it depends on. The Device enables all of them in this case, see
+  // RenderPass::setDynamicRendering().
+  bool supportsDynamicRendering() const;
+
+  // Returns true if VK_KHR_multiview is available with its multiview feature. The Device enables it
+  // in this case, see RenderPass::setViewMask().
+  bool supportsMultiview() const;
+
+  // Returns true if VK_EXT_mesh_shader is available with its taskShader and meshShader features.
+  // It requires Vulkan 1.1 and VK_KHR_spirv_1_4; the Device enables all of them in this case, see
+  // CommandBuffer::drawMeshTasks().
+  bool supportsMeshShaders() const;
+
+  // Returns true if VK_KHR_fragment_shading_rate is available with its pipelineFragmentShadingRate
+  // and attachmentFragmentShadingRate features. As shading rate images are only used with dynamic
+  // rendering, this requires supportsDynamicRendering() as well. The Device enables it in this
+  // case, see RenderPass::setShadingRateImage().
+  bool supportsFragmentShadingRate() const;
+
+  // Returns true if VK_EXT_external_memory_host is available. It requires Vulkan 1.1 and
+  // VK_KHR_external_memory; the Device enables both in this case, see Device::importHostBuffer().
+  bool supportsExternalMemoryHost() const;
+
+  // Returns true if VK_EXT_graphics_pipeline_library is available with its graphicsPipelineLibrary
+  // feature. It requires VK_KHR_pipeline_library; the Device enables both in this case and the
+  // PipelineCache links graphics pipelines from separately compiled parts.
+  bool supportsGraphicsPipelineLibrary() const;
+
+  // Returns true if VK_KHR_acceleration_structure and VK_KHR_ray_query are available with their
+  // accelerationStructure and rayQuery features and the bufferDeviceAddress feature of
+  // VK_KHR_buffer_device_address. They require Vulkan 1.1, VK_KHR_deferred_host_operations,
+  // VK_EXT_descriptor_indexing and VK_KHR_spirv_1_4; the Device enables all of them in this case,
+  // see Gltf::RayTracingScene.
+  bool supportsRayQueries() const;
+
+  // Returns true if images of the given format can be sampled with optimal tiling. For
+  // block-compressed formats, this requires the corresponding feature (e.g. textureCompressionBC);
+  // the Device enables all of these features which are available.
+  bool supportsSampledFormat(vk::Format format) const;
+
+  // These are only filled if VK_EXT_descriptor_indexing is available.
+  vk::PhysicalDeviceDescriptorIndexingFeaturesEXT const&   getDescriptorIndexingFeatures() const;
+  vk::PhysicalDeviceDescriptorIndexingPropertiesEXT const& getDescriptorIndexingProperties() const;
+
+  // This is only filled if VK_KHR_push_descriptor is available.
+  vk::PhysicalDevicePushDescriptorPropertiesKHR const& getPushDescriptorProperties() const;
+
+  // This is only filled if supportsFragmentShadingRate() returns true. It contains the texel sizes
+  // which can be used for shading rate images.
+  vk::PhysicalDeviceFragmentShadingRatePropertiesKHR const&
+  getFragmentShadingRateProperties() const;
+
+  // This is only filled if supportsExternalMemoryHost() returns true. Imported host pointers and
+  // sizes have to be multiples of its minImportedHostPointerAlignment.
+  vk::PhysicalDeviceExternalMemoryHostPropertiesEXT const& getExternalMemoryHostProperties() const;
+
+  // This is only filled if supportsRayQueries() returns true. Scratch buffers of acceleration
+  // structure builds have to be aligned to its minAccelerationStructureScratchOffsetAlignment.
+  vk::PhysicalDeviceAccelerationStructurePropertiesKHR const&
+  getAccelerationStructureProperties() const;
+
+  // Queries the current budget and usage of each memory heap. Unlike the properties above, these
+  // values change over time; they include the allocations of other processes. This is only filled
+  // if VK_EXT_memory_budget is available.
+  vk::PhysicalDeviceMemoryBudgetPropertiesEXT getMemoryBudget() const;
+
   void printInfo();
 
  private:
   std::array<uint32_t, 3> mQueueFamilies = {0, 0, 0};
   std::array<uint32_t, 3> mQueueIndices  = {0, 0, 0};
+
+  vk::PhysicalDeviceDescriptorIndexingFeaturesEXT   mDescriptorIndexingFeatures;
+  vk::PhysicalDeviceDescriptorIndexingPropertiesEXT mDescriptorIndexingProperties;
+  vk::PhysicalDevicePushDescriptorPropertiesKHR     mPushDescriptorProperties;
+  vk::PhysicalDeviceFragmentShadingRatePropertiesKHR mFragmentShadingRateProperties;
+  vk::PhysicalDeviceExternalMemoryHostPropertiesEXT mExternalMemoryHostProperties;
+  vk::PhysicalDeviceAccelerationStructurePropertiesKHR mAccelerationStructureProperties;
+  bool                                              mPresentationSupported            = false;
+  bool                                              mDrawIndirectCountSupported       = false;
+  bool                                              mPushDescriptorsSupported         = false;
+  bool                                              mExtendedDynamicStateSupported    = false;
+  bool                                              mMemoryBudgetSupported            = false;
+  bool                                              mTimelineSemaphoresSupported      = false;
+  bool                                              mDynamicRenderingSupported        = false;
+  bool                                              mMultiviewSupported               = false;
+  bool                                              mMeshShadersSupported             = false;
+  bool                                              mFragmentShadingRateSupported     = false;
+  bool                                              mExternalMemoryHostSupported      = false;
+  bool                                              mGraphicsPipelineLibrarySupported = false;
+  bool                                              mRayQueriesSupported              = false;
+
+  PFN_vkGetPhysicalDeviceMemoryProperties2KHR mGetMemoryProperties2 = nullptr;
 };
 
 } // namespace Illusion::Graphics
@@ -0,0 +1,1212 @@
+////////////////////////////////////////////////////////////////////////////////////////////////////
+//                                                                                                //
+//    _)  |  |            _)                This code may be used and modified under the terms    //
+//     |  |  |  |  | (_-<  |   _ \    \     of the MIT license. See the LICENSE file for details. //
+//    _| _| _| \_,_| ___/ _| \___/ _| _|    Copyright (c) 2018-2019 Simon Schneegans              //
+//                                                                                                //
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include "PipelineCache.hpp"
+
+#include "../Core/File.hpp"
+#include "../Core/Logger.hpp"
+#include "../Core/Tracer.hpp"
+#include "Device.hpp"
+#include "PhysicalDevice.hpp"
+#include "PipelineReflection.hpp"
+#include "RenderPass.hpp"
+#include "Shader.hpp"
+#include "ShaderModule.hpp"
+#include "Utils.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <iostream>
+
+namespace Illusion::Graphics {
+
+namespace {
+
+const uint32_t MANIFEST_MAGIC   = 0x4d504c49; // "ILPM"
+const uint32_t MANIFEST_VERSION = 2;
+
+template <typename T>
+void write(std::vector<uint8_t>& data, T const& value) {
+  size_t offset = data.size();
+  data.resize(offset + sizeof(T));
+  std::memcpy(data.data() + offset, &value, sizeof(T));
+}
+
+template <typename T>
+bool read(std::vector<uint8_t> const& data, size_t& offset, T& value) {
+  if (offset + sizeof(T) > data.size()) {
+    return false;
+  }
+  std::memcpy(&value, data.data() + offset, sizeof(T));
+  offset += sizeof(T);
+  return true;
+}
+
+// 64 bit FNV-1a step
+uint64_t combine(uint64_t hash, uint64_t value) {
+  return (hash ^ value) * 1099511628211ull;
+}
+
+void push(Core::BitHash& hash, SpecializationState const& specialization) {
+  for (auto const& value : specialization.getValues()) {
+    hash.push<32>(value.first);
+    hash.push<32>(value.second);
+  }
+}
+
+} // namespace
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+PipelineCache::PipelineCache(Device const* device, std::string const& fileName)
+    : mDevice(device)
+    , mFileName(fileName) {
+
+  ILLUSION_TRACE << "Creating PipelineCache." << std::endl;
+
+  auto data = loadData();
+
+  vk::PipelineCacheCreateInfo info;
+  info.initialDataSize = data.size();
+  info.pInitialData    = data.data();
+
+  mCache = mDevice->createPipelineCache(info);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+PipelineCache::~PipelineCache() {
+  ILLUSION_TRACE << "Deleting PipelineCache." << std::endl;
+
+  {
+    std::unique_lock<std::mutex> lock(mWorkerMutex);
+    mStopWorkers = true;
+  }
+
+  mJobsCondition.notify_all();
+
+  for (auto& worker : mWorkers) {
+    worker.join();
+  }
+
+  save();
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+vk::PipelinePtr PipelineCache::get(Core::BitHash const& hash) const {
+  std::unique_lock<std::mutex> lock(mMutex);
+  return find(mPipelines, hash);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+vk::PipelinePtr PipelineCache::insert(Core::BitHash const& hash, vk::PipelinePtr const& pipeline,
+    std::vector<std::weak_ptr<void>> const& dependencies) {
+
+  std::unique_lock<std::mutex> lock(mMutex);
+  return store(mPipelines, mPipelinesPruneSize, hash, pipeline, dependencies);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+vk::PipelinePtr PipelineCache::find(
+    std::unordered_map<Core::BitHash, Entry> const& entries, Core::BitHash const& hash) {
+
+  auto cached = entries.find(hash);
+  if (cached == entries.end() || !isValid(cached->second)) {
+    return nullptr;
+  }
+
+  return cached->second.mPipeline;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+vk::PipelinePtr PipelineCache::store(std::unordered_map<Core::BitHash, Entry>& entries,
+    size_t& pruneSize, Core::BitHash const& hash, vk::PipelinePtr const& pipeline,
+    std::vector<std::weak_ptr<void>> const& dependencies) {
+
+  // Remove the entries of destroyed Shaders and RenderPasses, else they would keep their
+  // vk::Pipelines alive until clear() is called.
+  if (entries.size() >= pruneSize && entries.find(hash) == entries.end()) {
+    for (auto it = entries.begin(); it != entries.end();) {
+      if (isValid(it->second)) {
+        ++it;
+      } else {
+        it = entries.erase(it);
+      }
+    }
+
+    pruneSize = std::max<size_t>(64, entries.size() * 2);
+  }
+
+  auto& entry = entries[hash];
+
+  // Keep the existing pipeline if it's still valid.
+  if (entry.mPipeline && isValid(entry)) {
+    return entry.mPipeline;
+  }
+
+  entry.mPipeline     = pipeline;
+  entry.mDependencies = dependencies;
+
+  return pipeline;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+bool PipelineCache::isValid(Entry const& entry) {
+  for (auto const& dependency : entry.mDependencies) {
+    if (dependency.expired()) {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+vk::PipelinePtr PipelineCache::getComputePipeline(
+    ShaderPtr const& shader, SpecializationState const& specialization) {
+
+  if (!shader) {
+    throw std::runtime_error("Failed to create compute pipeline: No Shader given!");
+  }
+
+  if (shader->getModules().size() != 1) {
+    throw std::runtime_error(
+        "Failed to create compute pipeline: There must be exactly one ShaderModule!");
+  }
+
+  auto const& module = shader->getModules()[0];
+  auto const& layout = shader->getReflection()->getLayout();
+  auto        used   = specialization.getSubset(shader->getModules());
+
+  // the layout is part of the hash as the same modules may be used with different push
+  // descriptor sets, see Shader::setPerDrawSet()
+  Core::BitHash hash;
+  hash.push<64>(module->getHandle().get());
+  hash.push<64>(layout.get());
+  push(hash, used);
+
+  auto cached = get(hash);
+  if (cached) {
+    return cached;
+  }
+
+  auto                   specializationData = used.getInfo(module);
+  vk::SpecializationInfo specializationInfo(
+      static_cast<uint32_t>(specializationData.mEntries.size()),
+      specializationData.mEntries.data(), specializationData.mData.size() * sizeof(uint32_t),
+      specializationData.mData.data());
+
+  vk::ComputePipelineCreateInfo info;
+  info.stage.stage               = module->getStage();
+  info.stage.module              = *module->getHandle();
+  info.stage.pName               = "main";
+  info.stage.pSpecializationInfo = nullptr;
+  info.layout                    = *layout;
+
+  if (!specializationData.mEntries.empty()) {
+    info.stage.pSpecializationInfo = &specializationInfo;
+  }
+
+  ILLUSION_ZONE("Create Compute Pipeline");
+  return insert(hash, mDevice->createComputePipeline(info), {module->getHandle(), layout});
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+vk::PipelinePtr PipelineCache::getGraphicsPipeline(GraphicsState const& state,
+    ShaderPtr const& shader, RenderPassPtr const& renderPass, uint32_t subPass,
+    SpecializationState const& specialization, bool async) {
+
+  if (!shader) {
+    throw std::runtime_error("Failed to create graphics pipeline: No Shader given!");
+  }
+
+  if (!renderPass) {
+    throw std::runtime_error("Failed to create graphics pipeline: No RenderPass given!");
+  }
+
+  GraphicsPipelineInfo info{state, {}, {}, shader->getReflection()->getLayout(),
+      renderPass->getHandle(), subPass, 0};
+
+  // only the constants which are declared by the modules affect the pipeline
+  auto used = specialization.getSubset(shader->getModules());
+
+  Core::BitHash hash = state.getHash();
+  for (auto const& m : shader->getModules()) {
+    info.mModules.emplace_back(m->getStage(), m->getHandle());
+    hash.push<64>(m->getHandle().get());
+  }
+  hash.push<64>(info.mLayout.get());
+  hash.push<1>(renderPass->getDynamicRendering());
+
+  auto const& attachments      = renderPass->getAttachments();
+  auto        colorAttachments = renderPass->getColorAttachments();
+
+  // without a vk::RenderPass, equal attachment formats result in the same pipeline
+  if (renderPass->getDynamicRendering()) {
+    auto depth = renderPass->getDepthAttachment();
+
+    for (uint32_t i : colorAttachments) {
+      info.mColorFormats.push_back(attachments[i].mFormat);
+    }
+
+    if (depth) {
+      info.mDepthFormat = attachments[*depth].mFormat;
+    }
+
+    info.mViewMask         = renderPass->getViewMask();
+    info.mShadingRateImage = renderPass->getShadingRateImage() != nullptr;
+
+    hash.push<32>(info.mColorFormats.size());
+    for (auto format : info.mColorFormats) {
+      hash.push<32>(format);
+    }
+    hash.push<32>(info.mDepthFormat);
+    hash.push<32>(info.mViewMask);
+    hash.push<1>(info.mShadingRateImage);
+  } else {
+    hash.push<64>(info.mRenderPass.get());
+    hash.push<32>(subPass);
+  }
+
+  push(hash, used);
+
+  auto cached = get(hash);
+  if (cached) {
+    return cached;
+  }
+
+  // This is used if the GraphicsState does not contain any blend attachments.
+  info.mColorAttachmentCount = static_cast<uint32_t>(colorAttachments.size());
+
+  for (auto const& m : shader->getModules()) {
+    info.mSpecializations.push_back(used.getInfo(m));
+  }
+
+  record(state, used, getShaderKey(shader), getRenderPassKey(renderPass), subPass);
+
+  // The pipeline becomes invalid if any of the objects it was created from is destroyed.
+  std::vector<std::weak_ptr<void>> dependencies{info.mLayout};
+  if (info.mRenderPass) {
+    dependencies.push_back(info.mRenderPass);
+  }
+  for (auto const& m : info.mModules) {
+    dependencies.push_back(m.second);
+  }
+
+  if (async) {
+    queue(hash, [this, hash, info, dependencies]() {
+      insert(hash, createGraphicsPipeline(info), dependencies);
+    });
+    return nullptr;
+  }
+
+  // If a worker thread is already creating this pipeline, we wait for it instead of creating it a
+  // second time.
+  {
+    std::unique_lock<std::mutex> lock(mWorkerMutex);
+    mPendingCondition.wait(lock, [this, &hash]() { return mPendingPipelines.count(hash) == 0; });
+  }
+
+  cached = get(hash);
+  if (cached) {
+    return cached;
+  }
+
+  return insert(hash, createGraphicsPipeline(info), dependencies);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void PipelineCache::waitForPendingPipelines() {
+  std::unique_lock<std::mutex> lock(mWorkerMutex);
+  mPendingCondition.wait(lock, [this]() { return mPendingPipelines.empty(); });
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+uint32_t PipelineCache::getPendingPipelineCount() const {
+  std::unique_lock<std::mutex> lock(mWorkerMutex);
+  return static_cast<uint32_t>(mPendingPipelines.size());
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+bool PipelineCache::saveManifest(std::string const& fileName) const {
+  std::vector<uint8_t> data;
+
+  {
+    std::unique_lock<std::mutex> lock(mManifestMutex);
+
+    write(data, MANIFEST_MAGIC);
+    write(data, MANIFEST_VERSION);
+    write(data, static_cast<uint32_t>(mManifest.size()));
+
+    for (auto const& entry : mManifest) {
+      write(data, entry.second.mShaderKey);
+      write(data, entry.second.mRenderPassKey);
+      write(data, entry.second.mSubPass);
+      write(data, static_cast<uint32_t>(entry.second.mState.size()));
+      data.insert(data.end(), entry.second.mState.begin(), entry.second.mState.end());
+      data.insert(
+          data.end(), entry.second.mSpecialization.begin(), entry.second.mSpecialization.end());
+    }
+  }
+
+  Core::File file(fileName);
+  if (!file.save(data)) {
+    return false;
+  }
+
+  ILLUSION_DEBUG << "Saved pipeline manifest to \"" << fileName << "\"." << std::endl;
+
+  return true;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+uint32_t PipelineCache::prewarm(std::string const& fileName, std::vector<ShaderPtr> const& shaders,
+    std::vector<RenderPassPtr> const& renderPasses) {
+
+  Core::File file(fileName);
+  if (!file.isValid()) {
+    return 0;
+  }
+
+  auto     data   = file.getContent<std::vector<uint8_t>>();
+  size_t   offset = 0;
+  uint32_t magic, version, count;
+
+  if (!read(data, offset, magic) || !read(data, offset, version) || !read(data, offset, count) ||
+      magic != MANIFEST_MAGIC || version != MANIFEST_VERSION) {
+    ILLUSION_WARNING << "Ignoring pipeline manifest \"" << fileName
+                     << "\": Invalid header or unsupported version!" << std::endl;
+    return 0;
+  }
+
+  // Pipelines can only be created for RenderPasses which have been initialized.
+  std::unordered_map<uint64_t, ShaderPtr>     shaderKeys;
+  std::unordered_map<uint64_t, RenderPassPtr> renderPassKeys;
+
+  for (auto const& shader : shaders) {
+    shaderKeys[getShaderKey(shader)] = shader;
+  }
+
+  for (auto const& renderPass : renderPasses) {
+    renderPass->init();
+    renderPassKeys[getRenderPassKey(renderPass)] = renderPass;
+  }
+
+  uint32_t queued = 0;
+
+  for (uint32_t i = 0; i < count; ++i) {
+    uint64_t shaderKey, renderPassKey;
+    uint32_t subPass, stateSize;
+
+    if (!read(data, offset, shaderKey) || !read(data, offset, renderPassKey) ||
+        !read(data, offset, subPass) || !read(data, offset, stateSize) ||
+        offset + stateSize > data.size()) {
+      ILLUSION_WARNING << "Pipeline manifest \"" << fileName << "\" is truncated!" << std::endl;
+      break;
+    }
+
+    std::vector<uint8_t> stateData(data.begin() + offset, data.begin() + offset + stateSize);
+    offset += stateSize;
+
+    SpecializationState specialization;
+    if (!specialization.deserialize(data, offset)) {
+      ILLUSION_WARNING << "Pipeline manifest \"" << fileName << "\" is truncated!" << std::endl;
+      break;
+    }
+
+    GraphicsState state(nullptr);
+    size_t        stateOffset = 0;
+    if (!state.deserialize(stateData, stateOffset)) {
+      continue;
+    }
+
+    record(state, specialization, shaderKey, renderPassKey, subPass);
+
+    auto shader     = shaderKeys.find(shaderKey);
+    auto renderPass = renderPassKeys.find(renderPassKey);
+
+    if (shader != shaderKeys.end() && renderPass != renderPassKeys.end()) {
+      if (!getGraphicsPipeline(
+              state, shader->second, renderPass->second, subPass, specialization, true)) {
+        ++queued;
+      }
+    }
+  }
+
+  ILLUSION_DEBUG << "Queued " << queued << " of " << count << " pipelines from manifest \""
+                 << fileName << "\"." << std::endl;
+
+  return queued;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void PipelineCache::clear() {
+  std::unique_lock<std::mutex> lock(mMutex);
+  mPipelines.clear();
+  mLibraries.clear();
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void PipelineCache::save() const {
+  if (mFileName.empty()) {
+    return;
+  }
+
+  auto data = mDevice->getHandle()->getPipelineCacheData(*mCache);
+
+  Core::File file(mFileName);
+  if (file.save(data)) {
+    ILLUSION_DEBUG << "Saved " << data.size() << " bytes of pipeline cache data to \"" << mFileName
+                   << "\"." << std::endl;
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+vk::PipelineCachePtr const& PipelineCache::getHandle() const {
+  return mCache;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+vk::PipelinePtr PipelineCache::createGraphicsPipeline(GraphicsPipelineInfo const& info) const {
+
+  // the vertex input interface does not exist for mesh shading pipelines
+  bool meshShading = false;
+  for (auto const& m : info.mModules) {
+    meshShading = meshShading || m.first == vk::ShaderStageFlagBits::eMeshEXT;
+  }
+
+  if (mDevice->getPhysicalDevice()->supportsGraphicsPipelineLibrary() && !meshShading) {
+    return linkGraphicsPipeline(info);
+  }
+
+  return compileGraphicsPipeline(info);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+vk::PipelinePtr PipelineCache::compileGraphicsPipeline(
+    GraphicsPipelineInfo const& info, vk::GraphicsPipelineLibraryFlagsEXT parts) const {
+  ILLUSION_ZONE("Create Graphics Pipeline");
+
+  GraphicsState const& state = info.mState;
+
+  using Part   = vk::GraphicsPipelineLibraryFlagBitsEXT;
+  bool library = static_cast<bool>(parts);
+
+  // without any parts, all of them are compiled into a complete pipeline
+  if (!library) {
+    parts = Part::eVertexInputInterface | Part::ePreRasterizationShaders |
+            Part::eFragmentShader | Part::eFragmentOutputInterface;
+  }
+
+  // -----------------------------------------------------------------------------------------------
+  std::vector<vk::PipelineShaderStageCreateInfo> stageInfos;
+  std::vector<vk::SpecializationInfo>            specializationInfos(info.mModules.size());
+  bool                                           meshShading = false;
+  for (size_t i(0); i < info.mModules.size(); ++i) {
+    meshShading = meshShading || info.mModules[i].first == vk::ShaderStageFlagBits::eMeshEXT;
+
+    // the fragment shader is part of its own library, all other stages are pre-rasterization
+    Part stagePart = info.mModules[i].first == vk::ShaderStageFlagBits::eFragment
+                         ? Part::eFragmentShader
+                         : Part::ePreRasterizationShaders;
+
+    if (!(parts & stagePart)) {
+      continue;
+    }
+
+    auto const& specialization = info.mSpecializations[i];
+    specializationInfos[i] =
+        vk::SpecializationInfo(static_cast<uint32_t>(specialization.mEntries.size()),
+            specialization.mEntries.data(), specialization.mData.size() * sizeof(uint32_t),
+            specialization.mData.data());
+
+    vk::PipelineShaderStageCreateInfo stageInfo;
+    stageInfo.stage               = info.mModules[i].first;
+    stageInfo.module              = *info.mModules[i].second;
+    stageInfo.pName               = "main";
+    stageInfo.pSpecializationInfo =
+        specialization.mEntries.empty() ? nullptr : &specializationInfos[i];
+    stageInfos.push_back(stageInfo);
+  }
+
+  // -----------------------------------------------------------------------------------------------
+  vk::PipelineVertexInputStateCreateInfo vertexInputStateInfo;
+
+  std::vector<vk::VertexInputBindingDescription>   vertexInputBindingDescriptions;
+  std::vector<vk::VertexInputAttributeDescription> vertexInputAttributeDescriptions;
+  for (auto const& i : state.getVertexInputBindings()) {
+    vertexInputBindingDescriptions.push_back({i.binding, i.stride, i.inputRate});
+  }
+  for (auto const& i : state.getVertexInputAttributes()) {
+    vertexInputAttributeDescriptions.push_back({i.location, i.binding, i.format, i.offset});
+  }
+  vertexInputStateInfo.vertexBindingDescriptionCount =
+      static_cast<uint32_t>(vertexInputBindingDescriptions.size());
+  vertexInputStateInfo.pVertexBindingDescriptions = vertexInputBindingDescriptions.data();
+  vertexInputStateInfo.vertexAttributeDescriptionCount =
+      static_cast<uint32_t>(vertexInputAttributeDescriptions.size());
+  vertexInputStateInfo.pVertexAttributeDescriptions = vertexInputAttributeDescriptions.data();
+
+  // -----------------------------------------------------------------------------------------------
+  vk::PipelineInputAssemblyStateCreateInfo inputAssemblyStateInfo;
+  inputAssemblyStateInfo.topology               = state.getTopology();
+  inputAssemblyStateInfo.primitiveRestartEnable = state.getPrimitiveRestartEnable();
+
+  // -----------------------------------------------------------------------------------------------
+  vk::PipelineTessellationStateCreateInfo tessellationStateInfo;
+  tessellationStateInfo.patchControlPoints = state.getTessellationPatchControlPoints();
+
+  // -----------------------------------------------------------------------------------------------
+  vk::PipelineViewportStateCreateInfo viewportStateInfo;
+  std::vector<vk::Viewport>           viewports;
+  std::vector<vk::Rect2D>             scissors;
+  for (auto const& i : state.getViewports()) {
+    viewports.push_back(
+        {i.mOffset[0], i.mOffset[1], i.mExtend[0], i.mExtend[1], i.mMinDepth, i.mMaxDepth});
+  }
+
+  // use viewport as scissors if no scissors are defined
+  if (state.getScissors().size() > 0) {
+    for (auto const& i : state.getScissors()) {
+      scissors.push_back({{i.mOffset[0], i.mOffset[1]}, {i.mExtend[0], i.mExtend[1]}});
+    }
+  } else {
+    for (auto const& i : state.getViewports()) {
+      scissors.push_back({{(int32_t)i.mOffset[0], (int32_t)i.mOffset[1]},
+          {(uint32_t)i.mExtend[0], (uint32_t)i.mExtend[1]}});
+    }
+  }
+  viewportStateInfo.viewportCount = static_cast<uint32_t>(viewports.size());
+  viewportStateInfo.pViewports    = viewports.data();
+  viewportStateInfo.scissorCount  = static_cast<uint32_t>(scissors.size());
+  viewportStateInfo.pScissors     = scissors.data();
+
+  // -----------------------------------------------------------------------------------------------
+  vk::PipelineRasterizationStateCreateInfo rasterizationStateInfo;
+  rasterizationStateInfo.depthClampEnable        = state.getDepthClampEnable();
+  rasterizationStateInfo.rasterizerDiscardEnable = state.getRasterizerDiscardEnable();
+  rasterizationStateInfo.polygonMode             = state.getPolygonMode();
+  rasterizationStateInfo.cullMode                = state.getCullMode();
+  rasterizationStateInfo.frontFace               = state.getFrontFace();
+  rasterizationStateInfo.depthBiasEnable         = state.getDepthBiasEnable();
+  rasterizationStateInfo.depthBiasConstantFactor = state.getDepthBiasConstantFactor();
+  rasterizationStateInfo.depthBiasClamp          = state.getDepthBiasClamp();
+  rasterizationStateInfo.depthBiasSlopeFactor    = state.getDepthBiasSlopeFactor();
+  rasterizationStateInfo.lineWidth               = state.getLineWidth();
+
+  // -----------------------------------------------------------------------------------------------
+  vk::PipelineMultisampleStateCreateInfo multisampleStateInfo;
+  multisampleStateInfo.rasterizationSamples  = state.getRasterizationSamples();
+  multisampleStateInfo.sampleShadingEnable   = state.getSampleShadingEnable();
+  multisampleStateInfo.minSampleShading      = state.getMinSampleShading();
+  multisampleStateInfo.pSampleMask           = state.getSampleMask().data();
+  multisampleStateInfo.alphaToCoverageEnable = state.getAlphaToCoverageEnable();
+  multisampleStateInfo.alphaToOneEnable      = state.getAlphaToOneEnable();
+
+  // -----------------------------------------------------------------------------------------------
+  vk::PipelineDepthStencilStateCreateInfo depthStencilStateInfo;
+  depthStencilStateInfo.depthTestEnable       = state.getDepthTestEnable();
+  depthStencilStateInfo.depthWriteEnable      = state.getDepthWriteEnable();
+  depthStencilStateInfo.depthCompareOp        = state.getDepthCompareOp();
+  depthStencilStateInfo.depthBoundsTestEnable = state.getDepthBoundsTestEnable();
+  depthStencilStateInfo.stencilTestEnable     = state.getStencilTestEnable();
+  depthStencilStateInfo.front = {state.getStencilFrontFailOp(), state.getStencilFrontPassOp(),
+      state.getStencilFrontDepthFailOp(), state.getStencilFrontCompareOp(),
+      state.getStencilFrontCompareMask(), state.getStencilFrontWriteMask(),
+      state.getStencilFrontReference()};
+  depthStencilStateInfo.back = {state.getStencilBackFailOp(), state.getStencilBackPassOp(),
+      state.getStencilBackDepthFailOp(), state.getStencilBackCompareOp(),
+      state.getStencilBackCompareMask(), state.getStencilBackWriteMask(),
+      state.getStencilBackReference()};
+  depthStencilStateInfo.minDepthBounds = state.getMinDepthBounds();
+  depthStencilStateInfo.maxDepthBounds = state.getMaxDepthBounds();
+
+  // -----------------------------------------------------------------------------------------------
+  vk::PipelineColorBlendStateCreateInfo              colorBlendStateInfo;
+  std::vector<vk::PipelineColorBlendAttachmentState> pipelineColorBlendAttachments;
+
+  // use default blend attachments if none are defined
+  if (state.getBlendAttachments().size() == 0) {
+    for (uint32_t i(0); i < info.mColorAttachmentCount; ++i) {
+      GraphicsState::BlendAttachment a;
+      pipelineColorBlendAttachments.push_back(
+          {a.mBlendEnable, a.mSrcColorBlendFactor, a.mDstColorBlendFactor, a.mColorBlendOp,
+              a.mSrcAlphaBlendFactor, a.mDstAlphaBlendFactor, a.mAlphaBlendOp, a.mColorWriteMask});
+    }
+
+  } else {
+    for (auto const& i : state.getBlendAttachments()) {
+      pipelineColorBlendAttachments.push_back(
+          {i.mBlendEnable, i.mSrcColorBlendFactor, i.mDstColorBlendFactor, i.mColorBlendOp,
+              i.mSrcAlphaBlendFactor, i.mDstAlphaBlendFactor, i.mAlphaBlendOp, i.mColorWriteMask});
+    }
+  }
+  colorBlendStateInfo.logicOpEnable   = state.getBlendLogicOpEnable();
+  colorBlendStateInfo.logicOp         = state.getBlendLogicOp();
+  colorBlendStateInfo.attachmentCount = static_cast<uint32_t>(pipelineColorBlendAttachments.size());
+  colorBlendStateInfo.pAttachments    = pipelineColorBlendAttachments.data();
+  colorBlendStateInfo.blendConstants[0] = state.getBlendConstants()[0];
+  colorBlendStateInfo.blendConstants[1] = state.getBlendConstants()[1];
+  colorBlendStateInfo.blendConstants[2] = state.getBlendConstants()[2];
+  colorBlendStateInfo.blendConstants[3] = state.getBlendConstants()[3];
+
+  // -----------------------------------------------------------------------------------------------
+  vk::PipelineDynamicStateCreateInfo dynamicStateInfo;
+  std::vector<vk::DynamicState>      dynamicState;
+
+  // mesh shading pipelines have no vertex input and input assembly state, hence the corresponding
+  // dynamic state is not allowed either
+  for (auto s : state.getDynamicState()) {
+    if (!meshShading || (s != vk::DynamicState::ePrimitiveTopologyEXT &&
+                            s != vk::DynamicState::eVertexInputBindingStrideEXT)) {
+      dynamicState.push_back(s);
+    }
+  }
+
+  dynamicStateInfo.dynamicStateCount = static_cast<uint32_t>(dynamicState.size());
+  dynamicStateInfo.pDynamicStates    = dynamicState.data();
+
+  // -----------------------------------------------------------------------------------------------
+  vk::GraphicsPipelineCreateInfo pipelineInfo;
+  pipelineInfo.stageCount          = static_cast<uint32_t>(stageInfos.size());
+  pipelineInfo.pStages             = stageInfos.data();
+  pipelineInfo.pVertexInputState   = &vertexInputStateInfo;
+  pipelineInfo.pInputAssemblyState = &inputAssemblyStateInfo;
+  pipelineInfo.pTessellationState  = &tessellationStateInfo;
+  pipelineInfo.pViewportState      = &viewportStateInfo;
+  pipelineInfo.pRasterizationState = &rasterizationStateInfo;
+  pipelineInfo.pMultisampleState   = &multisampleStateInfo;
+  pipelineInfo.pDepthStencilState  = &depthStencilStateInfo;
+  pipelineInfo.pColorBlendState    = &colorBlendStateInfo;
+  if (meshShading || !(parts & Part::eVertexInputInterface)) {
+    pipelineInfo.pVertexInputState   = nullptr;
+    pipelineInfo.pInputAssemblyState = nullptr;
+  }
+  if (!(parts & Part::ePreRasterizationShaders)) {
+    pipelineInfo.pTessellationState  = nullptr;
+    pipelineInfo.pViewportState      = nullptr;
+    pipelineInfo.pRasterizationState = nullptr;
+  }
+  if (!(parts & Part::eFragmentShader)) {
+    pipelineInfo.pDepthStencilState = nullptr;
+  }
+  if (!(parts & (Part::eFragmentShader | Part::eFragmentOutputInterface))) {
+    pipelineInfo.pMultisampleState = nullptr;
+  }
+  if (!(parts & Part::eFragmentOutputInterface)) {
+    pipelineInfo.pColorBlendState = nullptr;
+  }
+  if (dynamicState.size() > 0) {
+    pipelineInfo.pDynamicState = &dynamicStateInfo;
+  }
+  if (parts & (Part::ePreRasterizationShaders | Part::eFragmentShader)) {
+    pipelineInfo.layout = *info.mLayout;
+  }
+
+  vk::PipelineRenderingCreateInfoKHR renderingInfo;
+
+  if (info.mRenderPass) {
+    pipelineInfo.renderPass = *info.mRenderPass;
+    pipelineInfo.subpass    = info.mSubPass;
+  } else {
+    renderingInfo.colorAttachmentCount    = static_cast<uint32_t>(info.mColorFormats.size());
+    renderingInfo.pColorAttachmentFormats = info.mColorFormats.data();
+    renderingInfo.depthAttachmentFormat   = info.mDepthFormat;
+    renderingInfo.viewMask                = info.mViewMask;
+
+    if (Utils::isDepthStencilFormat(info.mDepthFormat)) {
+      renderingInfo.stencilAttachmentFormat = info.mDepthFormat;
+    }
+
+    pipelineInfo.pNext = &renderingInfo;
+  }
+
+  // the shading rate image replaces the rate of the pipeline, which is one fragment per pixel
+  vk::PipelineFragmentShadingRateStateCreateInfoKHR shadingRateInfo;
+
+  if (info.mShadingRateImage) {
+    shadingRateInfo.fragmentSize   = vk::Extent2D(1, 1);
+    shadingRateInfo.combinerOps[0] = vk::FragmentShadingRateCombinerOpKHR::eKeep;
+    shadingRateInfo.combinerOps[1] = vk::FragmentShadingRateCombinerOpKHR::eReplace;
+    shadingRateInfo.pNext          = pipelineInfo.pNext;
+
+    pipelineInfo.pNext = &shadingRateInfo;
+    pipelineInfo.flags |= vk::PipelineCreateFlagBits::eRenderingFragmentShadingRateAttachmentKHR;
+  }
+
+  vk::GraphicsPipelineLibraryCreateInfoEXT libraryInfo;
+
+  if (library) {
+    libraryInfo.flags  = parts;
+    libraryInfo.pNext  = const_cast<void*>(pipelineInfo.pNext);
+    pipelineInfo.pNext = &libraryInfo;
+    pipelineInfo.flags |= vk::PipelineCreateFlagBits::eLibraryKHR;
+  }
+
+  return mDevice->createGraphicsPipeline(pipelineInfo);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+vk::PipelinePtr PipelineCache::linkGraphicsPipeline(GraphicsPipelineInfo const& info) const {
+  ILLUSION_ZONE("Link Graphics Pipeline");
+
+  GraphicsState const& state = info.mState;
+
+  using Part = vk::GraphicsPipelineLibraryFlagBitsEXT;
+
+  // Each part is identified by the state it is created from. Values of dynamic state are not
+  // part of the pipeline, hence they are not pushed.
+  auto isStatic = [&state](vk::DynamicState s) { return !state.isDynamic(s); };
+
+  auto pushCommon = [&info, &state](Core::BitHash& hash, Part part) {
+    hash.push<32>(part);
+    for (auto s : state.getDynamicState()) {
+      hash.push<32>(s);
+    }
+
+    // all parts but the vertex input interface depend on the render pass
+    if (part != Part::eVertexInputInterface) {
+      hash.push<64>(info.mRenderPass.get());
+      hash.push<32>(info.mSubPass);
+      hash.push<32>(info.mColorFormats.size());
+      for (auto format : info.mColorFormats) {
+        hash.push<32>(format);
+      }
+      hash.push<32>(info.mDepthFormat);
+      hash.push<32>(info.mViewMask);
+      hash.push<1>(info.mShadingRateImage);
+    }
+  };
+
+  auto pushModules = [&info](Core::BitHash& hash, bool fragment) {
+    hash.push<64>(info.mLayout.get());
+    for (size_t i(0); i < info.mModules.size(); ++i) {
+      if ((info.mModules[i].first == vk::ShaderStageFlagBits::eFragment) == fragment) {
+        hash.push<32>(info.mModules[i].first);
+        hash.push<64>(info.mModules[i].second.get());
+        for (auto const& entry : info.mSpecializations[i].mEntries) {
+          hash.push<32>(entry.constantID);
+        }
+        for (uint32_t value : info.mSpecializations[i].mData) {
+          hash.push<32>(value);
+        }
+      }
+    }
+  };
+
+  auto pushMultisample = [&state](Core::BitHash& hash) {
+    hash.push<32>(state.getRasterizationSamples());
+    hash.push<1>(state.getSampleShadingEnable());
+    hash.push<32>(state.getMinSampleShading());
+    for (uint32_t mask : state.getSampleMask()) {
+      hash.push<32>(mask);
+    }
+    hash.push<1>(state.getAlphaToCoverageEnable());
+    hash.push<1>(state.getAlphaToOneEnable());
+  };
+
+  auto pushViewports = [&state](Core::BitHash& hash) {
+    for (auto const& v : state.getViewports()) {
+      hash.push<32>(v.mOffset[0]);
+      hash.push<32>(v.mOffset[1]);
+      hash.push<32>(v.mExtend[0]);
+      hash.push<32>(v.mExtend[1]);
+      hash.push<32>(v.mMinDepth);
+      hash.push<32>(v.mMaxDepth);
+    }
+  };
+
+  // vertex input interface ------------------------------------------------------------------------
+  Core::BitHash vertexInputHash;
+  pushCommon(vertexInputHash, Part::eVertexInputInterface);
+  vertexInputHash.push<32>(state.getTopology());
+  vertexInputHash.push<1>(state.getPrimitiveRestartEnable());
+  for (auto const& binding : state.getVertexInputBindings()) {
+    vertexInputHash.push<32>(binding.binding);
+    vertexInputHash.push<32>(binding.stride);
+    vertexInputHash.push<1>(binding.inputRate);
+  }
+  for (auto const& attribute : state.getVertexInputAttributes()) {
+    vertexInputHash.push<32>(attribute.location);
+    vertexInputHash.push<32>(attribute.binding);
+    vertexInputHash.push<32>(attribute.format);
+    vertexInputHash.push<32>(attribute.offset);
+  }
+
+  // pre-rasterization shaders ---------------------------------------------------------------------
+  Core::BitHash preRasterizationHash;
+  pushCommon(preRasterizationHash, Part::ePreRasterizationShaders);
+  pushModules(preRasterizationHash, false);
+  preRasterizationHash.push<32>(state.getViewports().size());
+  preRasterizationHash.push<32>(state.getScissors().size());
+  if (isStatic(vk::DynamicState::eViewport)) {
+    pushViewports(preRasterizationHash);
+  }
+  if (isStatic(vk::DynamicState::eScissor)) {
+    for (auto const& s : state.getScissors()) {
+      preRasterizationHash.push<32>(s.mOffset[0]);
+      preRasterizationHash.push<32>(s.mOffset[1]);
+      preRasterizationHash.push<32>(s.mExtend[0]);
+      preRasterizationHash.push<32>(s.mExtend[1]);
+    }
+
+    // without scissors, the viewports are used as scissors
+    if (state.getScissors().empty()) {
+      pushViewports(preRasterizationHash);
+    }
+  }
+  preRasterizationHash.push<1>(state.getDepthClampEnable());
+  preRasterizationHash.push<1>(state.getRasterizerDiscardEnable());
+  preRasterizationHash.push<32>(state.getPolygonMode());
+  if (isStatic(vk::DynamicState::eCullModeEXT)) {
+    preRasterizationHash.push<32>(state.getCullMode());
+  }
+  if (isStatic(vk::DynamicState::eFrontFaceEXT)) {
+    preRasterizationHash.push<32>(state.getFrontFace());
+  }
+  preRasterizationHash.push<1>(state.getDepthBiasEnable());
+  if (isStatic(vk::DynamicState::eDepthBias)) {
+    preRasterizationHash.push<32>(state.getDepthBiasConstantFactor());
+    preRasterizationHash.push<32>(state.getDepthBiasClamp());
+    preRasterizationHash.push<32>(state.getDepthBiasSlopeFactor());
+  }
+  if (isStatic(vk::DynamicState::eLineWidth)) {
+    preRasterizationHash.push<32>(state.getLineWidth());
+  }
+  preRasterizationHash.push<32>(state.getTessellationPatchControlPoints());
+
+  // fragment shader -------------------------------------------------------------------------------
+  Core::BitHash fragmentHash;
+  pushCommon(fragmentHash, Part::eFragmentShader);
+  pushModules(fragmentHash, true);
+  pushMultisample(fragmentHash);
+  if (isStatic(vk::DynamicState::eDepthTestEnableEXT)) {
+    fragmentHash.push<1>(state.getDepthTestEnable());
+  }
+  if (isStatic(vk::DynamicState::eDepthWriteEnableEXT)) {
+    fragmentHash.push<1>(state.getDepthWriteEnable());
+  }
+  if (isStatic(vk::DynamicState::eDepthCompareOpEXT)) {
+    fragmentHash.push<32>(state.getDepthCompareOp());
+  }
+  fragmentHash.push<1>(state.getDepthBoundsTestEnable());
+  fragmentHash.push<1>(state.getStencilTestEnable());
+  fragmentHash.push<32>(state.getStencilFrontFailOp());
+  fragmentHash.push<32>(state.getStencilFrontPassOp());
+  fragmentHash.push<32>(state.getStencilFrontDepthFailOp());
+  fragmentHash.push<32>(state.getStencilFrontCompareOp());
+  fragmentHash.push<32>(state.getStencilBackFailOp());
+  fragmentHash.push<32>(state.getStencilBackPassOp());
+  fragmentHash.push<32>(state.getStencilBackDepthFailOp());
+  fragmentHash.push<32>(state.getStencilBackCompareOp());
+  if (isStatic(vk::DynamicState::eStencilCompareMask)) {
+    fragmentHash.push<32>(state.getStencilFrontCompareMask());
+    fragmentHash.push<32>(state.getStencilBackCompareMask());
+  }
+  if (isStatic(vk::DynamicState::eStencilWriteMask)) {
+    fragmentHash.push<32>(state.getStencilFrontWriteMask());
+    fragmentHash.push<32>(state.getStencilBackWriteMask());
+  }
+  if (isStatic(vk::DynamicState::eStencilReference)) {
+    fragmentHash.push<32>(state.getStencilFrontReference());
+    fragmentHash.push<32>(state.getStencilBackReference());
+  }
+  if (isStatic(vk::DynamicState::eDepthBounds)) {
+    fragmentHash.push<32>(state.getMinDepthBounds());
+    fragmentHash.push<32>(state.getMaxDepthBounds());
+  }
+
+  // fragment output interface ---------------------------------------------------------------------
+  Core::BitHash outputHash;
+  pushCommon(outputHash, Part::eFragmentOutputInterface);
+  pushMultisample(outputHash);
+  outputHash.push<1>(state.getBlendLogicOpEnable());
+  outputHash.push<32>(state.getBlendLogicOp());
+  outputHash.push<32>(info.mColorAttachmentCount);
+  for (auto const& a : state.getBlendAttachments()) {
+    outputHash.push<1>(a.mBlendEnable);
+    outputHash.push<32>(a.mSrcColorBlendFactor);
+    outputHash.push<32>(a.mDstColorBlendFactor);
+    outputHash.push<32>(a.mColorBlendOp);
+    outputHash.push<32>(a.mSrcAlphaBlendFactor);
+    outputHash.push<32>(a.mDstAlphaBlendFactor);
+    outputHash.push<32>(a.mAlphaBlendOp);
+    outputHash.push<32>(a.mColorWriteMask);
+  }
+  if (isStatic(vk::DynamicState::eBlendConstants)) {
+    for (float constant : state.getBlendConstants()) {
+      outputHash.push<32>(constant);
+    }
+  }
+
+  // -----------------------------------------------------------------------------------------------
+  // A part becomes invalid if any of the objects it was created from is destroyed.
+  auto getDependencies = [&info](Part part) {
+    std::vector<std::weak_ptr<void>> dependencies;
+    if (part == Part::eVertexInputInterface) {
+      return dependencies;
+    }
+    if (info.mRenderPass) {
+      dependencies.push_back(info.mRenderPass);
+    }
+    if (part == Part::eFragmentOutputInterface) {
+      return dependencies;
+    }
+    dependencies.push_back(info.mLayout);
+    for (auto const& m : info.mModules) {
+      if ((m.first == vk::ShaderStageFlagBits::eFragment) == (part == Part::eFragmentShader)) {
+        dependencies.push_back(m.second);
+      }
+    }
+    return dependencies;
+  };
+
+  auto getLibrary = [this, &info, &getDependencies](Core::BitHash const& hash, Part part) {
+    {
+      std::unique_lock<std::mutex> lock(mMutex);
+      auto                         cached = find(mLibraries, hash);
+      if (cached) {
+        return cached;
+      }
+    }
+
+    // If two threads compile the same part at the same time, the first one is kept.
+    auto library = compileGraphicsPipeline(info, part);
+
+    std::unique_lock<std::mutex> lock(mMutex);
+    return store(mLibraries, mLibrariesPruneSize, hash, library, getDependencies(part));
+  };
+
+  std::array<vk::PipelinePtr, 4> libraries{getLibrary(vertexInputHash, Part::eVertexInputInterface),
+      getLibrary(preRasterizationHash, Part::ePreRasterizationShaders),
+      getLibrary(fragmentHash, Part::eFragmentShader),
+      getLibrary(outputHash, Part::eFragmentOutputInterface)};
+
+  std::array<vk::Pipeline, 4> handles;
+  for (size_t i(0); i < libraries.size(); ++i) {
+    handles[i] = *libraries[i];
+  }
+
+  // Linking without link time optimization is fast enough to be done whenever a new combination
+  // is used.
+  vk::PipelineLibraryCreateInfoKHR libraryInfo;
+  libraryInfo.libraryCount = static_cast<uint32_t>(handles.size());
+  libraryInfo.pLibraries   = handles.data();
+
+  vk::GraphicsPipelineCreateInfo pipelineInfo;
+  pipelineInfo.pNext  = &libraryInfo;
+  pipelineInfo.layout = *info.mLayout;
+
+  if (info.mShadingRateImage) {
+    pipelineInfo.flags |= vk::PipelineCreateFlagBits::eRenderingFragmentShadingRateAttachmentKHR;
+  }
+
+  // The libraries are kept alive as long as the linked pipeline.
+  struct Linked {
+    vk::PipelinePtr                mPipeline;
+    std::array<vk::PipelinePtr, 4> mLibraries;
+  };
+
+  auto linked = std::make_shared<Linked>(
+      Linked{mDevice->createGraphicsPipeline(pipelineInfo), std::move(libraries)});
+
+  return vk::PipelinePtr(linked, linked->mPipeline.get());
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void PipelineCache::queue(Core::BitHash const& hash, std::function<void()> const& job) {
+  std::unique_lock<std::mutex> lock(mWorkerMutex);
+
+  if (!mPendingPipelines.insert(hash).second) {
+    return;
+  }
+
+  if (mWorkers.empty()) {
+    // Leave one core for the render thread.
+    uint32_t threadCount = std::thread::hardware_concurrency();
+    threadCount          = std::min(4u, threadCount > 1 ? threadCount - 1 : 1u);
+
+    ILLUSION_TRACE << "Starting " << threadCount << " pipeline creation threads." << std::endl;
+
+    for (uint32_t i = 0; i < threadCount; ++i) {
+      mWorkers.emplace_back([this]() { work(); });
+    }
+  }
+
+  mJobs.emplace(hash, job);
+  mJobsCondition.notify_one();
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void PipelineCache::work() {
+  while (true) {
+    std::pair<Core::BitHash, std::function<void()>> job;
+
+    {
+      std::unique_lock<std::mutex> lock(mWorkerMutex);
+      mJobsCondition.wait(lock, [this]() { return mStopWorkers || !mJobs.empty(); });
+
+      if (mStopWorkers) {
+        return;
+      }
+
+      job = std::move(mJobs.front());
+      mJobs.pop();
+    }
+
+    try {
+      job.second();
+    } catch (std::exception const& e) {
+      ILLUSION_ERROR << "Failed to create pipeline asynchronously: " << e.what() << std::endl;
+    }
+
+    {
+      std::unique_lock<std::mutex> lock(mWorkerMutex);
+      mPendingPipelines.erase(job.first);
+    }
+
+    mPendingCondition.notify_all();
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void PipelineCache::record(GraphicsState const& state, SpecializationState const& specialization,
+    uint64_t shaderKey, uint64_t renderPassKey, uint32_t subPass) {
+
+  Core::BitHash key = state.getHash();
+  key.push<64>(shaderKey);
+  key.push<64>(renderPassKey);
+  key.push<32>(subPass);
+  push(key, specialization);
+
+  std::unique_lock<std::mutex> lock(mManifestMutex);
+
+  if (mManifest.find(key) != mManifest.end()) {
+    return;
+  }
+
+  auto& entry          = mManifest[key];
+  entry.mShaderKey     = shaderKey;
+  entry.mRenderPassKey = renderPassKey;
+  entry.mSubPass       = subPass;
+  state.serialize(entry.mState);
+  specialization.serialize(entry.mSpecialization);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+uint64_t PipelineCache::getShaderKey(ShaderPtr const& shader) {
+  uint64_t key = 14695981039346656037ull;
+  for (auto const& m : shader->getModules()) {
+    key = combine(key, static_cast<uint64_t>(m->getStage()));
+    key = combine(key, m->getSpirvHash());
+  }
+  return key;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+uint64_t PipelineCache::getRenderPassKey(RenderPassPtr const& renderPass) {
+  uint64_t key = 14695981039346656037ull;
+  for (auto format : renderPass->getFrameBufferAttachmentFormats()) {
+    key = combine(key, static_cast<uint64_t>(format));
+  }
+  for (auto const& subPass : renderPass->getSubPasses()) {
+    key = combine(key, subPass.mPreSubPasses.size());
+    for (uint32_t i : subPass.mPreSubPasses) {
+      key = combine(key, i);
+    }
+    key = combine(key, subPass.mInputAttachments.size());
+    for (uint32_t i : subPass.mInputAttachments) {
+      key = combine(key, i);
+    }
+    key = combine(key, subPass.mOutputAttachments.size());
+    for (uint32_t i : subPass.mOutputAttachments) {
+      key = combine(key, i);
+    }
+  }
+  if (renderPass->getDynamicRendering()) {
+    key = combine(key, 1);
+  }
+  // these keep the keys of RenderPasses without multiview or shading rate image unchanged
+  if (renderPass->getViewMask() != 0) {
+    key = combine(key, renderPass->getViewMask());
+  }
+  if (renderPass->getShadingRateImage()) {
+    key = combine(key, 2);
+  }
+  return key;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+std::vector<uint8_t> PipelineCache::loadData() const {
+  if (mFileName.empty()) {
+    return {};
+  }
+
+  Core::File file(mFileName);
+  if (!file.isValid()) {
+    return {};
+  }
+
+  auto data = file.getContent<std::vector<uint8_t>>();
+
+  // The header is described in the Vulkan specification of vkGetPipelineCacheData.
+  const size_t headerSize = 16 + VK_UUID_SIZE;
+  if (data.size() < headerSize) {
+    ILLUSION_WARNING << "Ignoring pipeline cache \"" << mFileName << "\": File is too small!"
+                     << std::endl;
+    return {};
+  }
+
+  uint32_t version, vendorID, deviceID;
+  std::memcpy(&version, data.data() + 4, sizeof(uint32_t));
+  std::memcpy(&vendorID, data.data() + 8, sizeof(uint32_t));
+  std::memcpy(&deviceID, data.data() + 12, sizeof(uint32_t));
+
+  auto properties = mDevice->getPhysicalDevice()->getProperties();
+
+  if (version != VK_PIPELINE_CACHE_HEADER_VERSION_ONE || vendorID != properties.vendorID ||
+      deviceID != properties.deviceID ||
+      std::memcmp(data.data() + 16, properties.pipelineCacheUUID, VK_UUID_SIZE) != 0) {
+    ILLUSION_WARNING << "Ignoring pipeline cache \"" << mFileName
+                     << "\": It was created by a different driver or device!" << std::endl;
+    return {};
+  }
+
+  ILLUSION_DEBUG << "Loaded " << data.size() << " bytes of pipeline cache data from \""
+                 << mFileName << "\"." << std::endl;
+
+  return data;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+} // namespace Illusion::Graphics
@@ -0,0 +1,207 @@
+////////////////////////////////////////////////////////////////////////////////////////////////////
+//                                                                                                //
+//    _)  |  |            _)                This code may be used and modified under the terms    //
+//     |  |  |  |  | (_-<  |   _ \    \     of the MIT license. See the LICENSE file for details. //
+//    _| _| _| \_,_| ___/ _| \___/ _| _|    Copyright (c) 2018-2019 Simon Schneegans              //
+//                                                                                                //
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#ifndef ILLUSION_GRAPHICS_PIPELINE_CACHE_HPP
+#define ILLUSION_GRAPHICS_PIPELINE_CACHE_HPP
+
+#include "../Core/BitHash.hpp"
+#include "GraphicsState.hpp"
+#include "SpecializationState.hpp"
+
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+
+namespace Illusion::Graphics {
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// The PipelineCache is owned by the Device and shared by all CommandBuffers. It stores created   //
+// vk::Pipelines together with weak references to the objects they were created from (usually the //
+// vk::ShaderModules and the vk::RenderPass). If one of those has been destroyed, the cached      //
+// pipeline is considered invalid, this prevents false cache hits when a new object is allocated  //
+// at the same address.                                                                           //
+// Additionally, a vk::PipelineCache is used for all pipeline creations of the Device. If a file  //
+// name is given, its content is loaded on construction and saved on destruction. The data is     //
+// only used if it was created by the same driver and device.                                     //
+// Specialization constants are part of the cache key, but only the values of the constants which //
+// are actually declared by the ShaderModules are considered. Pipelines of RenderPasses in        //
+// dynamic rendering mode depend on the formats of the attachments instead of the vk::RenderPass. //
+// Graphics pipelines can be compiled asynchronously on a pool of worker threads. Every created   //
+// graphics pipeline is recorded in a manifest which identifies Shaders and RenderPasses by their //
+// content. When the manifest of a previous session is passed to prewarm(), all recorded          //
+// pipelines of the given Shaders and RenderPasses are compiled in the background, usually before //
+// the first frame is drawn.                                                                      //
+// If VK_EXT_graphics_pipeline_library is supported, graphics pipelines are linked from four      //
+// parts which are compiled and cached separately: the vertex input interface, the                //
+// pre-rasterization shaders, the fragment shader and the fragment output interface. If a new     //
+// combination only changes some of them, the other parts are reused and linking takes a fraction //
+// of the time of a full compilation. Pipelines with mesh shaders are always compiled as a whole. //
+// All methods are thread-safe.                                                                   //
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+class PipelineCache {
+
+ public:
+  // Syntactic sugar to create a std::shared_ptr for this class
+  template <typename... Args>
+  static PipelineCachePtr create(Args&&... args) {
+    return std::make_shared<PipelineCache>(args...);
+  };
+
+  // The PipelineCache is owned by the given Device, hence it only stores a raw pointer to it. If
+  // fileName is empty, the vk::PipelineCache will not be persistent.
+  PipelineCache(Device const* device, std::string const& fileName = "");
+  virtual ~PipelineCache();
+
+  // Returns the pipeline stored for the given hash. If there is none or if one of its dependencies
+  // has been destroyed in the meantime, nullptr is returned.
+  vk::PipelinePtr get(Core::BitHash const& hash) const;
+
+  // Stores the given pipeline. If another thread inserted a pipeline for the same hash in the
+  // meantime, the already stored pipeline is returned. Else the given pipeline is returned.
+  vk::PipelinePtr insert(Core::BitHash const& hash, vk::PipelinePtr const& pipeline,
+      std::vector<std::weak_ptr<void>> const& dependencies);
+
+  // Returns a compute pipeline for the given Shader. It is created if it is not cached yet. The
+  // Shader must contain exactly one ShaderModule.
+  vk::PipelinePtr getComputePipeline(
+      ShaderPtr const& shader, SpecializationState const& specialization = {});
+
+  // Returns a graphics pipeline for the given combination. If it is not cached yet and async is
+  // false, it is created on the calling thread. If async is true, the creation is queued on a
+  // worker thread and nullptr is returned until the pipeline is ready.
+  vk::PipelinePtr getGraphicsPipeline(GraphicsState const& state, ShaderPtr const& shader,
+      RenderPassPtr const& renderPass, uint32_t subPass,
+      SpecializationState const& specialization = {}, bool async = false);
+
+  // Blocks until all queued pipelines have been created.
+  void waitForPendingPipelines();
+
+  // Returns the number of queued pipelines which have not been created yet.
+  uint32_t getPendingPipelineCount() const;
+
+  // Writes all graphics pipelines created (or loaded with prewarm()) so far to the given file.
+  bool saveManifest(std::string const& fileName) const;
+
+  // Reads a manifest written by saveManifest() and queues all recorded pipelines which use one of
+  // the given Shaders and RenderPasses for asynchronous creation. Returns the number of queued
+  // pipelines. The entries are kept in the manifest even if they do not match.
+  uint32_t prewarm(std::string const& fileName, std::vector<ShaderPtr> const& shaders,
+      std::vector<RenderPassPtr> const& renderPasses);
+
+  // Removes all cached vk::Pipelines. The content of the vk::PipelineCache and the manifest is
+  // not affected.
+  void clear();
+
+  // Writes the content of the vk::PipelineCache to the file given at construction time. This is
+  // called automatically by the destructor.
+  void save() const;
+
+  vk::PipelineCachePtr const& getHandle() const;
+
+ private:
+  struct Entry {
+    vk::PipelinePtr                  mPipeline;
+    std::vector<std::weak_ptr<void>> mDependencies;
+  };
+
+  // Everything required to create a graphics pipeline. This is gathered on the calling thread, as
+  // Shaders and RenderPasses are not thread-safe.
+  struct GraphicsPipelineInfo {
+    GraphicsState                                                        mState;
+    std::vector<std::pair<vk::ShaderStageFlagBits, vk::ShaderModulePtr>> mModules;
+    std::vector<SpecializationState::Info>                               mSpecializations;
+    vk::PipelineLayoutPtr                                                mLayout;
+    vk::RenderPassPtr                                                    mRenderPass;
+    uint32_t                                                             mSubPass;
+    uint32_t                                                             mColorAttachmentCount;
+
+    // These are only used for RenderPasses in dynamic rendering mode, see
+    // RenderPass::setDynamicRendering().
+    std::vector<vk::Format> mColorFormats;
+    vk::Format              mDepthFormat      = vk::Format::eUndefined;
+    uint32_t                mViewMask         = 0;
+    bool                    mShadingRateImage = false;
+  };
+
+  // A recorded graphics pipeline. Shaders and RenderPasses are identified by content hashes.
+  struct ManifestEntry {
+    uint64_t             mShaderKey;
+    uint64_t             mRenderPassKey;
+    uint32_t             mSubPass;
+    std::vector<uint8_t> mState;
+    std::vector<uint8_t> mSpecialization;
+  };
+
+  // Links the pipeline from cached parts if VK_EXT_graphics_pipeline_library is supported, else
+  // compiles it as a whole.
+  vk::PipelinePtr createGraphicsPipeline(GraphicsPipelineInfo const& info) const;
+
+  // Compiles the given parts of the pipeline as a pipeline library. If parts is empty, a complete
+  // pipeline is compiled.
+  vk::PipelinePtr compileGraphicsPipeline(
+      GraphicsPipelineInfo const& info, vk::GraphicsPipelineLibraryFlagsEXT parts = {}) const;
+
+  // Links the four parts of the pipeline. Each part is taken from mLibraries or compiled and
+  // stored there if it is not cached yet.
+  vk::PipelinePtr linkGraphicsPipeline(GraphicsPipelineInfo const& info) const;
+
+  // These implement get() and insert() for mPipelines and mLibraries; mMutex has to be locked.
+  // Before a new entry is added, entries with expired dependencies are removed if the map has grown
+  // to pruneSize. pruneSize is then set to twice the remaining size, so that the cost of pruning is
+  // amortized over the insertions.
+  static vk::PipelinePtr find(
+      std::unordered_map<Core::BitHash, Entry> const& entries, Core::BitHash const& hash);
+  static vk::PipelinePtr store(std::unordered_map<Core::BitHash, Entry>& entries,
+      size_t& pruneSize, Core::BitHash const& hash, vk::PipelinePtr const& pipeline,
+      std::vector<std::weak_ptr<void>> const& dependencies);
+  static bool isValid(Entry const& entry);
+
+  // Adds the given job to the queue of the worker threads. The threads are started lazily. If there
+  // is already a job pending for the given hash, nothing is done.
+  void queue(Core::BitHash const& hash, std::function<void()> const& job);
+  void work();
+
+  // Adds an entry to the manifest.
+  void record(GraphicsState const& state, SpecializationState const& specialization,
+      uint64_t shaderKey, uint64_t renderPassKey, uint32_t subPass);
+
+  static uint64_t getShaderKey(ShaderPtr const& shader);
+  static uint64_t getRenderPassKey(RenderPassPtr const& renderPass);
+
+  std::vector<uint8_t> loadData() const;
+
+  Device const*        mDevice;
+  std::string          mFileName;
+  vk::PipelineCachePtr mCache;
+
+  std::unordered_map<Core::BitHash, Entry>         mPipelines;
+  mutable std::unordered_map<Core::BitHash, Entry> mLibraries;
+  size_t                                           mPipelinesPruneSize = 64;
+  mutable size_t                                   mLibrariesPruneSize = 64;
+  mutable std::mutex                               mMutex;
+
+  std::unordered_map<Core::BitHash, ManifestEntry> mManifest;
+  mutable std::mutex                               mManifestMutex;
+
+  std::vector<std::thread>                                   mWorkers;
+  std::queue<std::pair<Core::BitHash, std::function<void()>>> mJobs;
+  std::unordered_set<Core::BitHash>                          mPendingPipelines;
+  std::condition_variable                                    mJobsCondition;
+  std::condition_variable                                    mPendingCondition;
+  bool                                                       mStopWorkers = false;
+  mutable std::mutex                                         mWorkerMutex;
+};
+
+} // namespace Illusion::Graphics
+
+#endif // ILLUSION_GRAPHICS_PIPELINE_CACHE_HPP
@@ -32,6 +32,8 @@ PipelineReflection::~PipelineReflection() {
 void PipelineReflection::addResource(PipelineResource const& resource) {
 
   mLayout.reset();
+  mHash.clear();
+  mCompatibilityHashes.clear();
 
   // As in Vulkan-EZ, the key used for each resource is its name, except in the case of inputs and
   // outputs, since its legal to have separate outputs and inputs with the same name across
@@ -84,6 +86,31 @@ PipelineReflection::getDescriptorSetReflections() const {
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////
 
+void PipelineReflection::setPushDescriptorSet(std::optional<uint32_t> set) {
+  if (set && (*set >= mDescriptorSetReflections.size() ||
+                 mDescriptorSetReflections[*set]->getResources().empty())) {
+    throw std::runtime_error("Failed to use push descriptors for set " + std::to_string(*set) +
+                             ": The set is not used by the pipeline!");
+  }
+
+  // enable it first so that nothing is changed if this throws
+  if (set) {
+    mDescriptorSetReflections[*set]->setPushDescriptor(true);
+  }
+
+  for (auto const& s : mDescriptorSetReflections) {
+    if (!set || s->getSet() != *set) {
+      s->setPushDescriptor(false);
+    }
+  }
+
+  mLayout.reset();
+  mHash.clear();
+  mCompatibilityHashes.clear();
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
 std::map<std::string, PipelineResource> PipelineReflection::getResources(
     PipelineResource::ResourceType type) const {
 
@@ -146,7 +173,7 @@ vk::PipelineLayoutPtr const& PipelineReflection::getLayout() const {
     pipelineLayoutInfo.pushConstantRangeCount = static_cast<uint32_t>(pushConstantRanges.size());
     pipelineLayoutInfo.pPushConstantRanges    = pushConstantRanges.data();
 
-    mLayout = mDevice->createPipelineLayout(pipelineLayoutInfo);
+    mLayout = mDevice->getPipelineLayout(getHash(), pipelineLayoutInfo);
   }
 
   return mLayout;
@@ -154,6 +181,48 @@ vk::PipelineLayoutPtr const& PipelineReflection::getLayout() const {
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////
 
+Core::BitHash const& PipelineReflection::getHash() const {
+  if (mHash.size() == 0) {
+    Core::BitHash hash;
+
+    // the push constant ranges are part of the hashes of all sets
+    hash.push<16>(mPushConstantBuffers.size());
+    for (auto const& r : mPushConstantBuffers) {
+      hash.push<32>(r.second.mStages);
+      hash.push<32>(r.second.mOffset);
+      hash.push<32>(static_cast<uint32_t>(r.second.mSize));
+    }
+
+    mCompatibilityHashes.clear();
+
+    for (auto const& s : mDescriptorSetReflections) {
+      hash.push<1>(s->isPushDescriptor());
+      hash.push<16>(s->getResources().size());
+      for (auto const& r : s->getResources()) {
+        hash.push<6>(r.second.mStages);
+        hash.push<4>(r.second.mResourceType);
+        hash.push<16>(r.second.mBinding);
+        hash.push<32>(r.second.mArraySize);
+      }
+
+      mCompatibilityHashes.push_back(hash);
+    }
+
+    mHash = hash;
+  }
+
+  return mHash;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+std::vector<Core::BitHash> const& PipelineReflection::getCompatibilityHashes() const {
+  getHash();
+  return mCompatibilityHashes;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
 void PipelineReflection::printInfo() const {
   ILLUSION_MESSAGE << "Inputs" << std::endl;
   for (auto const& r : mInputs) {
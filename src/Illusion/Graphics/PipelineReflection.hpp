@@ -14,6 +14,7 @@
 #include "PipelineResource.hpp"
 
 #include <map>
+#include <optional>
 #include <set>
 #include <unordered_map>
 
@@ -48,6 +49,12 @@ class PipelineReflection {
   // vk::DescriptorSetLayout.
   std::vector<DescriptorSetReflectionPtr> const& getDescriptorSetReflections() const;
 
+  // Makes the given set the only push descriptor set of this reflection, all other sets become
+  // regular descriptor sets again; std::nullopt disables push descriptors. This throws a
+  // std::runtime_error if the set is not used or cannot be a push descriptor set (see
+  // DescriptorSetReflection::setPushDescriptor()). In this case, nothing is changed.
+  void setPushDescriptorSet(std::optional<uint32_t> set);
+
   // Returns all resources which have been added to this PipelineReflection. The returned map is
   // created on-the-fly, hence this operation is quite costly. If this becomes a bottleneck, storing
   // the resources in an additional map could be considered an improvement.
@@ -58,10 +65,21 @@ class PipelineReflection {
   // maps could be considered an improvement.
   std::map<std::string, PipelineResource> getResources(PipelineResource::ResourceType type) const;
 
-  // Creates a vk::PipelineLayout for this reflection. It is created lazily; the first call to
-  // this method will cause the allocation.
+  // Returns a vk::PipelineLayout for this reflection. It is retrieved lazily from the layout cache
+  // of the Device (see Device::getPipelineLayout()), hence all reflections with the same hash share
+  // one handle.
   vk::PipelineLayoutPtr const& getLayout() const;
 
+  // Returns a hash which is based on the push constant ranges and the resources of all descriptor
+  // sets. Reflections with the same hash have identical vk::PipelineLayouts.
+  Core::BitHash const& getHash() const;
+
+  // Returns one hash for each descriptor set. The hash of set N is based on the push constant
+  // ranges and the resources of the sets 0 to N. According to the Vulkan specification, a
+  // descriptor set bound with one layout remains valid for another layout if their hashes for
+  // this set are equal. The CommandBuffer uses this to keep descriptor sets bound across Shaders.
+  std::vector<Core::BitHash> const& getCompatibilityHashes() const;
+
   // Prints some reflection information to std::cout for debugging purposes.
   void printInfo() const;
 
@@ -72,6 +90,8 @@ class PipelineReflection {
   std::map<std::string, PipelineResource> mOutputs;
   std::map<std::string, PipelineResource> mPushConstantBuffers;
   mutable vk::PipelineLayoutPtr           mLayout;
+  mutable Core::BitHash                   mHash;
+  mutable std::vector<Core::BitHash>      mCompatibilityHashes;
 };
 
 } // namespace Illusion::Graphics
@@ -57,6 +57,7 @@ struct PipelineResource {
     eStorageBufferDynamic,
     eInputAttachment,
     ePushConstantBuffer,
+    eAccelerationStructure,
     eNone
   };
 
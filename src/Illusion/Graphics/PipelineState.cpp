@@ -0,0 +1,92 @@
+////////////////////////////////////////////////////////////////////////////////////////////////////
+//                                                                                                //
+//    _)  |  |            _)                This code may be used and modified under the terms    //
+//     |  |  |  |  | (_-<  |   _ \    \     of the MIT license. See the LICENSE file for details. //
+//    _| _| _| \_,_| ___/ _| \___/ _| _|    Copyright (c) 2018-2019 Simon Schneegans              //
+//                                                                                                //
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include "PipelineState.hpp"
+
+#include "../Core/Logger.hpp"
+#include "Device.hpp"
+#include "PipelineCache.hpp"
+
+#include <iostream>
+
+namespace Illusion::Graphics {
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+PipelineState::PipelineState(DevicePtr const& device, ShaderPtr const& shader,
+    GraphicsState const& state, RenderPassPtr const& renderPass, uint32_t subPass,
+    SpecializationState const& specialization)
+    : mBindPoint(vk::PipelineBindPoint::eGraphics)
+    , mShader(shader)
+    , mGraphicsState(state)
+    , mRenderPass(renderPass)
+    , mSubPass(subPass) {
+
+  ILLUSION_TRACE << "Creating PipelineState." << std::endl;
+
+  mPipeline = device->getPipelineCache()->getGraphicsPipeline(
+      mGraphicsState, mShader, mRenderPass, mSubPass, specialization);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+PipelineState::PipelineState(
+    DevicePtr const& device, ShaderPtr const& shader, SpecializationState const& specialization)
+    : mBindPoint(vk::PipelineBindPoint::eCompute)
+    , mShader(shader) {
+
+  ILLUSION_TRACE << "Creating PipelineState." << std::endl;
+
+  mPipeline = device->getPipelineCache()->getComputePipeline(mShader, specialization);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+PipelineState::~PipelineState() {
+  ILLUSION_TRACE << "Deleting PipelineState." << std::endl;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+vk::PipelineBindPoint PipelineState::getBindPoint() const {
+  return mBindPoint;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+vk::PipelinePtr const& PipelineState::getHandle() const {
+  return mPipeline;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+ShaderPtr const& PipelineState::getShader() const {
+  return mShader;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+GraphicsState const& PipelineState::getGraphicsState() const {
+  return mGraphicsState;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+RenderPassPtr const& PipelineState::getRenderPass() const {
+  return mRenderPass;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+uint32_t PipelineState::getSubPass() const {
+  return mSubPass;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+} // namespace Illusion::Graphics
@@ -0,0 +1,68 @@
+////////////////////////////////////////////////////////////////////////////////////////////////////
+//                                                                                                //
+//    _)  |  |            _)                This code may be used and modified under the terms    //
+//     |  |  |  |  | (_-<  |   _ \    \     of the MIT license. See the LICENSE file for details. //
+//    _| _| _| \_,_| ___/ _| \___/ _| _|    Copyright (c) 2018-2019 Simon Schneegans              //
+//                                                                                                //
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#ifndef ILLUSION_GRAPHICS_PIPELINE_STATE_HPP
+#define ILLUSION_GRAPHICS_PIPELINE_STATE_HPP
+
+#include "GraphicsState.hpp"
+#include "SpecializationState.hpp"
+#include "fwd.hpp"
+
+namespace Illusion::Graphics {
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// A PipelineState is an immutable combination of a Shader, a GraphicsState, a RenderPass and a   //
+// SpecializationState whose vk::Pipeline is created once, on construction.                       //
+// CommandBuffer::bindPipelineState() binds it directly. Draw calls then neither hash the         //
+// GraphicsState nor look up the pipeline in the PipelineCache of the Device. This is useful for  //
+// draw loops which switch between a known set of pipelines. The pipeline is taken from the       //
+// PipelineCache, so creating a PipelineState for a combination which has been used before is     //
+// cheap. The vk::Pipeline is not re-created when the Shader is reloaded or when the attachments  //
+// of the RenderPass change; create a new PipelineState in this case.                             //
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+class PipelineState {
+
+ public:
+  // Syntactic sugar to create a std::shared_ptr for this class
+  template <typename... Args>
+  static PipelineStatePtr create(Args&&... args) {
+    return std::make_shared<PipelineState>(args...);
+  };
+
+  // Creates a graphics pipeline for the given subpass of the RenderPass. The values of the dynamic
+  // states of the GraphicsState are recorded when the PipelineState is bound.
+  PipelineState(DevicePtr const& device, ShaderPtr const& shader, GraphicsState const& state,
+      RenderPassPtr const& renderPass, uint32_t subPass = 0,
+      SpecializationState const& specialization = {});
+
+  // Creates a compute pipeline. The Shader must contain exactly one ShaderModule.
+  PipelineState(DevicePtr const& device, ShaderPtr const& shader,
+      SpecializationState const& specialization = {});
+
+  virtual ~PipelineState();
+
+  vk::PipelineBindPoint  getBindPoint() const;
+  vk::PipelinePtr const& getHandle() const;
+  ShaderPtr const&       getShader() const;
+  GraphicsState const&   getGraphicsState() const;
+  RenderPassPtr const&   getRenderPass() const;
+  uint32_t               getSubPass() const;
+
+ private:
+  vk::PipelineBindPoint mBindPoint;
+  vk::PipelinePtr       mPipeline;
+  ShaderPtr             mShader;
+  GraphicsState         mGraphicsState;
+  RenderPassPtr         mRenderPass;
+  uint32_t              mSubPass = 0;
+};
+
+} // namespace Illusion::Graphics
+
+#endif // ILLUSION_GRAPHICS_PIPELINE_STATE_HPP
@@ -0,0 +1,527 @@
+////////////////////////////////////////////////////////////////////////////////////////////////////
+//                                                                                                //
+//    _)  |  |            _)                This code may be used and modified under the terms    //
+//     |  |  |  |  | (_-<  |   _ \    \     of the MIT license. See the LICENSE file for details. //
+//    _| _| _| \_,_| ___/ _| \___/ _| _|    Copyright (c) 2018-2019 Simon Schneegans              //
+//                                                                                                //
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include "PostProcessor.hpp"
+
+#include "../Core/Logger.hpp"
+#include "CommandBuffer.hpp"
+#include "Device.hpp"
+#include "RenderTargetPool.hpp"
+#include "Shader.hpp"
+#include "ShaderSource.hpp"
+#include "Texture.hpp"
+
+#include <algorithm>
+#include <iostream>
+
+namespace Illusion::Graphics {
+
+namespace {
+
+// This matches the std140 layout of the PostProcessingUniforms in the shaders below.
+struct PostProcessingUniforms {
+  float mExposure;
+  float mBloomThreshold;
+  float mBloomIntensity;
+};
+
+// The bits of the composite Shader variants.
+const uint32_t COMPOSITE_BLOOM        = 1;
+const uint32_t COMPOSITE_TONE_MAPPING = 2;
+const uint32_t COMPOSITE_FXAA         = 4;
+
+// All shaders share the same bindings: 0 contains the uniforms, 1 is the sampled source and 2 the
+// written storage image.
+const std::string COMMON = R"(
+  #version 450
+
+  layout (local_size_x = 8, local_size_y = 8) in;
+
+  layout (binding = 0) uniform PostProcessingUniforms {
+    float mExposure;
+    float mBloomThreshold;
+    float mBloomIntensity;
+  } uniforms;
+
+  layout (binding = 1) uniform sampler2D inputImage;
+)";
+
+// Each texel of the smaller level is the average of four bilinear samples around it, so each
+// level averages a 4x4 texel neighbourhood of the level above. With PREFILTER, only the parts of
+// the HDR input which are brighter than the threshold are kept.
+const std::string DOWNSAMPLE_SHADER = COMMON + R"(
+  layout (binding = 2, rgba16f) uniform writeonly image2D outputImage;
+
+  void main() {
+    ivec2 size = imageSize(outputImage);
+    ivec2 texel = ivec2(gl_GlobalInvocationID.xy);
+
+    if (any(greaterThanEqual(texel, size))) {
+      return;
+    }
+
+    vec2 uv     = (vec2(texel) + 0.5) / vec2(size);
+    vec2 offset = 1.0 / vec2(textureSize(inputImage, 0));
+
+    vec3 color = 0.25 * (textureLod(inputImage, uv + vec2(-offset.x, -offset.y), 0).rgb +
+                         textureLod(inputImage, uv + vec2( offset.x, -offset.y), 0).rgb +
+                         textureLod(inputImage, uv + vec2(-offset.x,  offset.y), 0).rgb +
+                         textureLod(inputImage, uv + vec2( offset.x,  offset.y), 0).rgb);
+
+    #ifdef PREFILTER
+      color *= uniforms.mExposure;
+      float brightness = max(color.r, max(color.g, color.b));
+      color *= max(brightness - uniforms.mBloomThreshold, 0.0) / max(brightness, 0.0001);
+    #endif
+
+    imageStore(outputImage, texel, vec4(color, 1.0));
+  }
+)";
+
+// The smaller level is blurred with a 3x3 tent filter and added to the larger level.
+const std::string UPSAMPLE_SHADER = COMMON + R"(
+  layout (binding = 2, rgba16f) uniform image2D outputImage;
+
+  void main() {
+    ivec2 size = imageSize(outputImage);
+    ivec2 texel = ivec2(gl_GlobalInvocationID.xy);
+
+    if (any(greaterThanEqual(texel, size))) {
+      return;
+    }
+
+    vec2 uv     = (vec2(texel) + 0.5) / vec2(size);
+    vec2 offset = 1.0 / vec2(textureSize(inputImage, 0));
+
+    vec3 color = 4.0 * textureLod(inputImage, uv, 0).rgb;
+    color += 2.0 * textureLod(inputImage, uv + vec2(-offset.x, 0.0), 0).rgb;
+    color += 2.0 * textureLod(inputImage, uv + vec2( offset.x, 0.0), 0).rgb;
+    color += 2.0 * textureLod(inputImage, uv + vec2(0.0, -offset.y), 0).rgb;
+    color += 2.0 * textureLod(inputImage, uv + vec2(0.0,  offset.y), 0).rgb;
+    color += textureLod(inputImage, uv + vec2(-offset.x, -offset.y), 0).rgb;
+    color += textureLod(inputImage, uv + vec2( offset.x, -offset.y), 0).rgb;
+    color += textureLod(inputImage, uv + vec2(-offset.x,  offset.y), 0).rgb;
+    color += textureLod(inputImage, uv + vec2( offset.x,  offset.y), 0).rgb;
+
+    imageStore(outputImage, texel, imageLoad(outputImage, texel) + vec4(color / 16.0, 0.0));
+  }
+)";
+
+// All per-pixel operations in one pass. With FXAA, the luminance of the result is stored in the
+// alpha channel for the FXAA pass.
+const std::string COMPOSITE_SHADER = COMMON + R"(
+  layout (binding = 2, rgba8) uniform writeonly image2D outputImage;
+
+  #ifdef BLOOM
+    layout (binding = 3) uniform sampler2D bloomImage;
+  #endif
+
+  vec3 Uncharted2Tonemap(vec3 x) {
+    float A = 0.15;
+    float B = 0.50;
+    float C = 0.10;
+    float D = 0.20;
+    float E = 0.02;
+    float F = 0.30;
+    return ((x * (A * x + C * B) + D * E) / (x * (A * x + B) + D * F)) - E / F;
+  }
+
+  void main() {
+    ivec2 size = imageSize(outputImage);
+    ivec2 texel = ivec2(gl_GlobalInvocationID.xy);
+
+    if (any(greaterThanEqual(texel, size))) {
+      return;
+    }
+
+    vec3 color = texelFetch(inputImage, texel, 0).rgb * uniforms.mExposure;
+
+    #ifdef BLOOM
+      vec2 uv = (vec2(texel) + 0.5) / vec2(size);
+      color += textureLod(bloomImage, uv, 0).rgb * uniforms.mBloomIntensity;
+    #endif
+
+    #ifdef TONE_MAPPING
+      color = Uncharted2Tonemap(color) / Uncharted2Tonemap(vec3(11.2));
+    #else
+      color = clamp(color, vec3(0.0), vec3(1.0));
+    #endif
+
+    color = pow(color, vec3(1.0 / 2.2));
+
+    float alpha = 1.0;
+
+    #ifdef FXAA
+      alpha = dot(color, vec3(0.299, 0.587, 0.114));
+    #endif
+
+    imageStore(outputImage, texel, vec4(color, alpha));
+  }
+)";
+
+// A compact variant of FXAA which uses the luminance stored in the alpha channel of the input.
+const std::string FXAA_SHADER = COMMON + R"(
+  layout (binding = 2, rgba8) uniform writeonly image2D outputImage;
+
+  const float REDUCE_MIN = 1.0 / 128.0;
+  const float REDUCE_MUL = 1.0 / 8.0;
+  const float SPAN_MAX   = 8.0;
+
+  void main() {
+    ivec2 size = imageSize(outputImage);
+    ivec2 texel = ivec2(gl_GlobalInvocationID.xy);
+
+    if (any(greaterThanEqual(texel, size))) {
+      return;
+    }
+
+    vec2 pixel = 1.0 / vec2(size);
+    vec2 uv    = (vec2(texel) + 0.5) * pixel;
+
+    vec4  center = texelFetch(inputImage, texel, 0);
+    float lumaNW = textureLod(inputImage, uv + vec2(-1.0, -1.0) * pixel, 0).a;
+    float lumaNE = textureLod(inputImage, uv + vec2( 1.0, -1.0) * pixel, 0).a;
+    float lumaSW = textureLod(inputImage, uv + vec2(-1.0,  1.0) * pixel, 0).a;
+    float lumaSE = textureLod(inputImage, uv + vec2( 1.0,  1.0) * pixel, 0).a;
+    float lumaM  = center.a;
+
+    float lumaMin = min(lumaM, min(min(lumaNW, lumaNE), min(lumaSW, lumaSE)));
+    float lumaMax = max(lumaM, max(max(lumaNW, lumaNE), max(lumaSW, lumaSE)));
+
+    vec2 dir;
+    dir.x = -((lumaNW + lumaNE) - (lumaSW + lumaSE));
+    dir.y = ((lumaNW + lumaSW) - (lumaNE + lumaSE));
+
+    float dirReduce = max((lumaNW + lumaNE + lumaSW + lumaSE) * 0.25 * REDUCE_MUL, REDUCE_MIN);
+    float rcpDirMin = 1.0 / (min(abs(dir.x), abs(dir.y)) + dirReduce);
+    dir = clamp(dir * rcpDirMin, vec2(-SPAN_MAX), vec2(SPAN_MAX)) * pixel;
+
+    vec3 colorA = 0.5 * (textureLod(inputImage, uv + dir * (1.0 / 3.0 - 0.5), 0).rgb +
+                         textureLod(inputImage, uv + dir * (2.0 / 3.0 - 0.5), 0).rgb);
+    vec3 colorB = 0.5 * colorA + 0.25 * (textureLod(inputImage, uv - dir * 0.5, 0).rgb +
+                                         textureLod(inputImage, uv + dir * 0.5, 0).rgb);
+
+    float lumaB = dot(colorB, vec3(0.299, 0.587, 0.114));
+    vec3  color = (lumaB < lumaMin || lumaB > lumaMax) ? colorA : colorB;
+
+    imageStore(outputImage, texel, vec4(color, 1.0));
+  }
+)";
+
+uint32_t getGroupCount(uint32_t size, uint32_t groupSize) {
+  return (size + groupSize - 1) / groupSize;
+}
+
+void dispatch(CommandBuffer& cmd, TexturePtr const& target) {
+  cmd.dispatch(getGroupCount(target->mImageInfo.extent.width, 8),
+      getGroupCount(target->mImageInfo.extent.height, 8));
+}
+
+} // namespace
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+PostProcessor::PostProcessor(DevicePtr const& device)
+    : mDevice(device)
+    , mPrefilterShader(Shader::create(device))
+    , mDownsampleShader(Shader::create(device))
+    , mUpsampleShader(Shader::create(device))
+    , mFxaaShader(Shader::create(device)) {
+
+  ILLUSION_TRACE << "Creating PostProcessor." << std::endl;
+
+  mPrefilterShader->addModule(vk::ShaderStageFlagBits::eCompute,
+      GlslCode::create(DOWNSAMPLE_SHADER, "PostProcessor::prefilter", {"PREFILTER"}));
+  mDownsampleShader->addModule(vk::ShaderStageFlagBits::eCompute,
+      GlslCode::create(DOWNSAMPLE_SHADER, "PostProcessor::downsample"));
+  mUpsampleShader->addModule(vk::ShaderStageFlagBits::eCompute,
+      GlslCode::create(UPSAMPLE_SHADER, "PostProcessor::upsample"));
+  mFxaaShader->addModule(
+      vk::ShaderStageFlagBits::eCompute, GlslCode::create(FXAA_SHADER, "PostProcessor::fxaa"));
+
+  mSampler = mDevice->getSampler(Device::createSamplerInfo(vk::Filter::eLinear,
+      vk::SamplerMipmapMode::eNearest, vk::SamplerAddressMode::eClampToEdge));
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+PostProcessor::~PostProcessor() {
+  ILLUSION_TRACE << "Deleting PostProcessor." << std::endl;
+  releaseTargets();
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+TexturePtr const& PostProcessor::process(
+    CommandBuffer& cmd, TransientAllocator& allocator, BackedImagePtr const& input) {
+
+  glm::uvec2 extent(input->mImageInfo.extent.width, input->mImageInfo.extent.height);
+
+  // each bloom level has half the size of the previous one
+  uint32_t bloomLevels = 0;
+  if (mBloom) {
+    glm::uvec2 size = extent;
+    while (bloomLevels < mBloomLevels && size.x >= 2 && size.y >= 2) {
+      size /= 2u;
+      ++bloomLevels;
+    }
+  }
+
+  updateTargets(extent, bloomLevels);
+
+  PostProcessingUniforms uniforms;
+  uniforms.mExposure       = mExposure;
+  uniforms.mBloomThreshold = mBloomThreshold;
+  uniforms.mBloomIntensity = mBloomIntensity;
+
+  auto uniformData = allocator.addData(uniforms);
+
+  // the input has been written by a RenderPass, which is not tracked
+  cmd.transitionImageLayout(*input->mImage, vk::ImageLayout::eColorAttachmentOptimal,
+      vk::ImageLayout::eShaderReadOnlyOptimal, vk::PipelineStageFlagBits::eColorAttachmentOutput,
+      vk::PipelineStageFlagBits::eComputeShader, input->mViewInfo.subresourceRange);
+
+  input->mCurrentLayout = vk::ImageLayout::eShaderReadOnlyOptimal;
+
+  // the input is a BackedImage, it is sampled through a Texture sharing its vk::Image
+  auto inputTexture = std::make_shared<Texture>();
+  static_cast<BackedImage&>(*inputTexture) = *input;
+  inputTexture->mCurrentLayout             = vk::ImageLayout::eShaderReadOnlyOptimal;
+  inputTexture->mSampler                   = mSampler;
+
+  cmd.bindingState().setUniformBuffer(
+      uniformData.mBuffer, uniformData.mSize, uniformData.mOffset, 0, 0);
+
+  // the first bloom level is downsampled from the input, the bright parts are extracted on the fly
+  if (bloomLevels > 0) {
+    cmd.setShader(mPrefilterShader);
+
+    for (uint32_t i(0); i < bloomLevels; ++i) {
+      cmd.bindingState().setTexture(i == 0 ? inputTexture : mBloomTargets[i - 1].mTexture, 0, 1);
+      cmd.bindingState().setStorageImage(mBloomTargets[i].mTexture, 0, 2);
+      dispatch(cmd, mBloomTargets[i].mTexture);
+      cmd.setShader(mDownsampleShader);
+    }
+
+    // afterwards, each level is blurred and added to the next larger one
+    cmd.setShader(mUpsampleShader);
+
+    for (uint32_t i(bloomLevels - 1); i > 0; --i) {
+      cmd.bindingState().setTexture(mBloomTargets[i].mTexture, 0, 1);
+      cmd.bindingState().setStorageImage(mBloomTargets[i - 1].mTexture, 0, 2);
+      dispatch(cmd, mBloomTargets[i - 1].mTexture);
+    }
+  }
+
+  // all per-pixel operations are done in one pass; without FXAA it writes the output directly
+  uint32_t variant = 0;
+  variant |= bloomLevels > 0 ? COMPOSITE_BLOOM : 0;
+  variant |= mToneMapping ? COMPOSITE_TONE_MAPPING : 0;
+  variant |= mFxaa ? COMPOSITE_FXAA : 0;
+
+  auto const& composite = mFxaa ? mComposite.mTexture : mOutput.mTexture;
+
+  cmd.setShader(getCompositeShader(variant));
+  cmd.bindingState().setTexture(inputTexture, 0, 1);
+  cmd.bindingState().setStorageImage(composite, 0, 2);
+
+  if (bloomLevels > 0) {
+    cmd.bindingState().setTexture(mBloomTargets[0].mTexture, 0, 3);
+  }
+
+  dispatch(cmd, composite);
+
+  if (mFxaa) {
+    cmd.setShader(mFxaaShader);
+    cmd.bindingState().setTexture(mComposite.mTexture, 0, 1);
+    cmd.bindingState().setStorageImage(mOutput.mTexture, 0, 2);
+    dispatch(cmd, mOutput.mTexture);
+  }
+
+  cmd.bindingState().reset(0);
+
+  return mOutput.mTexture;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void PostProcessor::setExposure(float exposure) {
+  mExposure = exposure;
+}
+
+float PostProcessor::getExposure() const {
+  return mExposure;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void PostProcessor::setBloom(bool enable) {
+  mBloom = enable;
+}
+
+bool PostProcessor::getBloom() const {
+  return mBloom;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void PostProcessor::setBloomThreshold(float threshold) {
+  mBloomThreshold = threshold;
+}
+
+float PostProcessor::getBloomThreshold() const {
+  return mBloomThreshold;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void PostProcessor::setBloomIntensity(float intensity) {
+  mBloomIntensity = intensity;
+}
+
+float PostProcessor::getBloomIntensity() const {
+  return mBloomIntensity;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void PostProcessor::setBloomLevels(uint32_t levels) {
+  mBloomLevels = std::clamp(levels, 1u, MAX_BLOOM_LEVELS);
+}
+
+uint32_t PostProcessor::getBloomLevels() const {
+  return mBloomLevels;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void PostProcessor::setToneMapping(bool enable) {
+  mToneMapping = enable;
+}
+
+bool PostProcessor::getToneMapping() const {
+  return mToneMapping;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void PostProcessor::setFxaa(bool enable) {
+  mFxaa = enable;
+}
+
+bool PostProcessor::getFxaa() const {
+  return mFxaa;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void PostProcessor::updateTargets(glm::uvec2 const& extent, uint32_t bloomLevels) {
+  if (extent != mExtent) {
+    releaseTargets();
+    mExtent = extent;
+  }
+
+  // images which are not needed anymore are kept until the extent changes
+  if (!mOutput.mImage) {
+    mOutput = acquireTarget(vk::Format::eR8G8B8A8Unorm, extent);
+  }
+
+  if (mFxaa && !mComposite.mImage) {
+    mComposite = acquireTarget(vk::Format::eR8G8B8A8Unorm, extent);
+  }
+
+  for (uint32_t i(static_cast<uint32_t>(mBloomTargets.size())); i < bloomLevels; ++i) {
+    mBloomTargets.push_back(acquireTarget(
+        vk::Format::eR16G16B16A16Sfloat, glm::max(extent / (2u << i), glm::uvec2(1))));
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+PostProcessor::Target PostProcessor::acquireTarget(
+    vk::Format format, glm::uvec2 const& extent) const {
+
+  // all LDR images have the same usage, so that they can be exchanged in the RenderTargetPool
+  vk::ImageCreateInfo imageInfo;
+  imageInfo.imageType     = vk::ImageType::e2D;
+  imageInfo.format        = format;
+  imageInfo.extent.width  = extent.x;
+  imageInfo.extent.height = extent.y;
+  imageInfo.extent.depth  = 1;
+  imageInfo.mipLevels     = 1;
+  imageInfo.arrayLayers   = 1;
+  imageInfo.samples       = vk::SampleCountFlagBits::e1;
+  imageInfo.tiling        = vk::ImageTiling::eOptimal;
+  imageInfo.usage         = vk::ImageUsageFlagBits::eStorage | vk::ImageUsageFlagBits::eSampled |
+                            vk::ImageUsageFlagBits::eTransferSrc;
+  imageInfo.sharingMode   = vk::SharingMode::eExclusive;
+  imageInfo.initialLayout = vk::ImageLayout::eUndefined;
+
+  Target target;
+  target.mImage = mDevice->getRenderTargetPool()->acquire(imageInfo,
+      vk::ImageAspectFlagBits::eColor, vk::MemoryPropertyFlagBits::eDeviceLocal,
+      vk::ImageLayout::eGeneral);
+
+  // the pooled image is used through a Texture sharing its vk::Image; the content is undefined
+  target.mTexture = std::make_shared<Texture>();
+  static_cast<BackedImage&>(*target.mTexture) = *target.mImage;
+  target.mTexture->mCurrentLayout             = vk::ImageLayout::eUndefined;
+  target.mTexture->mSampler                   = mSampler;
+
+  return target;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void PostProcessor::releaseTargets() {
+  auto release = [this](Target& target) {
+    if (target.mImage) {
+      target.mImage->mCurrentLayout = target.mTexture->mCurrentLayout;
+      mDevice->getRenderTargetPool()->release(target.mImage);
+      target = Target();
+    }
+  };
+
+  for (auto& target : mBloomTargets) {
+    release(target);
+  }
+
+  mBloomTargets.clear();
+  release(mComposite);
+  release(mOutput);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+ShaderPtr const& PostProcessor::getCompositeShader(uint32_t variant) {
+  auto& shader = mCompositeShaders[variant];
+
+  if (!shader) {
+    std::set<std::string> defines;
+
+    if (variant & COMPOSITE_BLOOM) {
+      defines.insert("BLOOM");
+    }
+    if (variant & COMPOSITE_TONE_MAPPING) {
+      defines.insert("TONE_MAPPING");
+    }
+    if (variant & COMPOSITE_FXAA) {
+      defines.insert("FXAA");
+    }
+
+    shader = Shader::create(mDevice);
+    shader->addModule(vk::ShaderStageFlagBits::eCompute,
+        GlslCode::create(COMPOSITE_SHADER, "PostProcessor::composite", defines));
+  }
+
+  return shader;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+} // namespace Illusion::Graphics
@@ -0,0 +1,118 @@
+////////////////////////////////////////////////////////////////////////////////////////////////////
+//                                                                                                //
+//    _)  |  |            _)                This code may be used and modified under the terms    //
+//     |  |  |  |  | (_-<  |   _ \    \     of the MIT license. See the LICENSE file for details. //
+//    _| _| _| \_,_| ___/ _| \___/ _| _|    Copyright (c) 2018-2019 Simon Schneegans              //
+//                                                                                                //
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#ifndef ILLUSION_GRAPHICS_POST_PROCESSOR_HPP
+#define ILLUSION_GRAPHICS_POST_PROCESSOR_HPP
+
+#include "TransientAllocator.hpp"
+
+#include <glm/glm.hpp>
+#include <map>
+#include <vector>
+
+namespace Illusion::Graphics {
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// The PostProcessor turns an HDR color attachment into a displayable LDR image with compute      //
+// Shaders instead of one RenderPass per effect. All per-pixel operations (exposure, adding the   //
+// bloom, tone mapping, gamma correction and computing the luminance for FXAA) are fused into a   //
+// single composite dispatch; a Shader variant is compiled for each combination of enabled        //
+// effects. Only the bloom and FXAA need a neighbourhood of each pixel and get dispatches of      //
+// their own: the bright parts of the input are extracted while it is downsampled for the first   //
+// bloom level, the following levels are downsampled and then accumulated upwards again. FXAA     //
+// reads the luminance which the composite pass stored in the alpha channel and writes the final  //
+// image, so that the composite output and the FXAA output ping-pong between two images. All      //
+// intermediate images are storage images which are acquired from the RenderTargetPool of the     //
+// Device; they are kept until the extent of the input changes. As they are written each frame,   //
+// each frame in flight needs its own PostProcessor.                                              //
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+class PostProcessor {
+
+ public:
+  static constexpr uint32_t MAX_BLOOM_LEVELS = 8;
+
+  // Syntactic sugar to create a std::shared_ptr for this class
+  template <typename... Args>
+  static PostProcessorPtr create(Args&&... args) {
+    return std::make_shared<PostProcessor>(args...);
+  };
+
+  explicit PostProcessor(DevicePtr const& device);
+  virtual ~PostProcessor();
+
+  // Records all enabled effects. This has to be called outside of RenderPasses. The input has to
+  // be a single-sampled color attachment which has been written by a RenderPass, it is expected to
+  // be in vk::ImageLayout::eColorAttachmentOptimal and is left in
+  // vk::ImageLayout::eShaderReadOnlyOptimal. The returned R8G8B8A8Unorm Texture has the same extent
+  // as the input; it is valid until the next call and has to be transitioned with
+  // CommandBuffer::transitionImage() before it is used. This changes the current Shader of the
+  // CommandBuffer and resets the bindings of descriptor set 0.
+  TexturePtr const& process(
+      CommandBuffer& cmd, TransientAllocator& allocator, BackedImagePtr const& input);
+
+  // The input color is multiplied with the exposure before anything else.
+  void  setExposure(float exposure);
+  float getExposure() const;
+
+  // Pixels whose brightest channel (after the exposure) exceeds the threshold contribute to the
+  // bloom; the blurred result is multiplied with the intensity and added to the input. The number
+  // of levels limits the blur radius, it is clamped to [1, MAX_BLOOM_LEVELS].
+  void     setBloom(bool enable);
+  bool     getBloom() const;
+  void     setBloomThreshold(float threshold);
+  float    getBloomThreshold() const;
+  void     setBloomIntensity(float intensity);
+  float    getBloomIntensity() const;
+  void     setBloomLevels(uint32_t levels);
+  uint32_t getBloomLevels() const;
+
+  // When tone mapping is disabled, the color is clamped to [0, 1] before the gamma correction.
+  void setToneMapping(bool enable);
+  bool getToneMapping() const;
+
+  void setFxaa(bool enable);
+  bool getFxaa() const;
+
+ private:
+  struct Target {
+    BackedImagePtr mImage;
+    TexturePtr     mTexture;
+  };
+
+  void             updateTargets(glm::uvec2 const& extent, uint32_t bloomLevels);
+  Target           acquireTarget(vk::Format format, glm::uvec2 const& extent) const;
+  void             releaseTargets();
+  ShaderPtr const& getCompositeShader(uint32_t variant);
+
+  DevicePtr      mDevice;
+  vk::SamplerPtr mSampler;
+  ShaderPtr      mPrefilterShader;
+  ShaderPtr      mDownsampleShader;
+  ShaderPtr      mUpsampleShader;
+  ShaderPtr      mFxaaShader;
+
+  std::map<uint32_t, ShaderPtr> mCompositeShaders;
+
+  glm::uvec2          mExtent = glm::uvec2(0);
+  std::vector<Target> mBloomTargets;
+  Target              mComposite;
+  Target              mOutput;
+
+  float    mExposure       = 1.f;
+  bool     mBloom          = true;
+  float    mBloomThreshold = 1.f;
+  float    mBloomIntensity = 0.05f;
+  uint32_t mBloomLevels    = 5;
+  bool     mToneMapping    = true;
+  bool     mFxaa           = true;
+};
+
+} // namespace Illusion::Graphics
+
+#endif // ILLUSION_GRAPHICS_POST_PROCESSOR_HPP
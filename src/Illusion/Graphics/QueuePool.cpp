@@ -0,0 +1,199 @@
+////////////////////////////////////////////////////////////////////////////////////////////////////
+//                                                                                                //
+//    _)  |  |            _)                This code may be used and modified under the terms    //
+//     |  |  |  |  | (_-<  |   _ \    \     of the MIT license. See the LICENSE file for details. //
+//    _| _| _| \_,_| ___/ _| \___/ _| _|    Copyright (c) 2018-2019 Simon Schneegans              //
+//                                                                                                //
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include "QueuePool.hpp"
+
+#include "../Core/Logger.hpp"
+#include "PhysicalDevice.hpp"
+
+#include <algorithm>
+#include <iostream>
+#include <set>
+
+namespace Illusion::Graphics {
+
+namespace {
+
+std::set<uint32_t> getUsedFamilies(PhysicalDevicePtr const& physicalDevice) {
+  std::set<uint32_t> families;
+  for (auto type : {QueueType::eGeneric, QueueType::eCompute, QueueType::eTransfer}) {
+    families.insert(physicalDevice->getQueueFamily(type));
+  }
+  return families;
+}
+
+} // namespace
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+QueuePool::Lock::Lock(Entry& entry)
+    : mEntry(&entry)
+    , mLock(entry.mMutex) {
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+QueuePool::Lock::Lock(Entry& entry, std::unique_lock<std::mutex>&& lock)
+    : mEntry(&entry)
+    , mLock(std::move(lock)) {
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+vk::Queue const& QueuePool::Lock::operator*() const {
+  return mEntry->mQueue;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+vk::Queue const* QueuePool::Lock::operator->() const {
+  return &mEntry->mQueue;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+uint32_t QueuePool::Lock::getFamily() const {
+  return mEntry->mFamily;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+uint32_t QueuePool::Lock::getIndex() const {
+  return mEntry->mIndex;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+QueuePool::QueuePool(vk::DevicePtr const& device, PhysicalDevicePtr const& physicalDevice)
+    : mPhysicalDevice(physicalDevice) {
+
+  ILLUSION_TRACE << "Creating QueuePool." << std::endl;
+
+  auto properties = mPhysicalDevice->getQueueFamilyProperties();
+
+  for (uint32_t family : getUsedFamilies(mPhysicalDevice)) {
+    auto& entries = mFamilies[family];
+
+    for (uint32_t i(0); i < properties[family].queueCount; ++i) {
+      auto entry     = std::make_unique<Entry>();
+      entry->mQueue  = device->getQueue(family, i);
+      entry->mFamily = family;
+      entry->mIndex  = i;
+      entries.push_back(std::move(entry));
+    }
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+QueuePool::~QueuePool() {
+  ILLUSION_TRACE << "Deleting QueuePool." << std::endl;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+std::vector<vk::DeviceQueueCreateInfo> QueuePool::getQueueCreateInfos(
+    PhysicalDevicePtr const& physicalDevice, std::vector<float>& priorities) {
+
+  auto properties = physicalDevice->getQueueFamilyProperties();
+  auto families   = getUsedFamilies(physicalDevice);
+
+  // all queues have the same priority
+  uint32_t maxCount = 0;
+  for (uint32_t family : families) {
+    maxCount = std::max(maxCount, properties[family].queueCount);
+  }
+
+  priorities.assign(maxCount, 1.f);
+
+  std::vector<vk::DeviceQueueCreateInfo> infos;
+
+  for (uint32_t family : families) {
+    vk::DeviceQueueCreateInfo info;
+    info.queueFamilyIndex = family;
+    info.queueCount       = properties[family].queueCount;
+    info.pQueuePriorities = priorities.data();
+    infos.push_back(info);
+  }
+
+  return infos;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+uint32_t QueuePool::getQueueCount(QueueType type) const {
+  return static_cast<uint32_t>(getFamily(type).size());
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+vk::Queue const& QueuePool::getQueue(QueueType type) const {
+  return getQueue(type, mPhysicalDevice->getQueueIndex(type));
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+vk::Queue const& QueuePool::getQueue(QueueType type, uint32_t index) const {
+  return getFamily(type).at(index)->mQueue;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+QueuePool::Lock QueuePool::lock(QueueType type) const {
+  return lock(type, mPhysicalDevice->getQueueIndex(type));
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+QueuePool::Lock QueuePool::lock(QueueType type, uint32_t index) const {
+  return Lock(*getFamily(type).at(index));
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+QueuePool::Lock QueuePool::lockAny(QueueType type) const {
+  auto const& entries = getFamily(type);
+  uint32_t    count   = static_cast<uint32_t>(entries.size());
+  uint32_t    first   = mNextAny++;
+
+  for (uint32_t i(0); i < count; ++i) {
+    auto&                        entry = *entries[(first + i) % count];
+    std::unique_lock<std::mutex> lock(entry.mMutex, std::try_to_lock);
+
+    if (lock.owns_lock()) {
+      return Lock(entry, std::move(lock));
+    }
+  }
+
+  return Lock(*entries[first % count]);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+std::vector<QueuePool::Lock> QueuePool::lockAll() const {
+  std::vector<Lock> locks;
+
+  // the locks are always acquired in the same order, so this cannot dead-lock with itself
+  for (auto const& family : mFamilies) {
+    for (auto const& entry : family.second) {
+      locks.push_back(Lock(*entry));
+    }
+  }
+
+  return locks;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+std::vector<std::unique_ptr<QueuePool::Entry>> const& QueuePool::getFamily(QueueType type) const {
+  return mFamilies.at(mPhysicalDevice->getQueueFamily(type));
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+} // namespace Illusion::Graphics
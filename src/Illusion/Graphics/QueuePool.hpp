@@ -0,0 +1,113 @@
+////////////////////////////////////////////////////////////////////////////////////////////////////
+//                                                                                                //
+//    _)  |  |            _)                This code may be used and modified under the terms    //
+//     |  |  |  |  | (_-<  |   _ \    \     of the MIT license. See the LICENSE file for details. //
+//    _| _| _| \_,_| ___/ _| \___/ _| _|    Copyright (c) 2018-2019 Simon Schneegans              //
+//                                                                                                //
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#ifndef ILLUSION_GRAPHICS_QUEUE_POOL_HPP
+#define ILLUSION_GRAPHICS_QUEUE_POOL_HPP
+
+#include "fwd.hpp"
+
+#include <atomic>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace Illusion::Graphics {
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// The QueuePool contains all vk::Queues of the queue families which are used by the QueueTypes.  //
+// Many GPUs expose several compute and transfer queues; they are all created by the Device, so   //
+// that for example uploads of several threads can be submitted to independent hardware queues.   //
+// vk::Queues have to be externally synchronized, hence each vk::Queue has a mutex. Submissions   //
+// and presentations should only be done while holding a Lock returned by lock() or lockAny().    //
+// The queue with the index chosen by PhysicalDevice::getQueueIndex() is the one which is used by //
+// the Device, the CommandBuffers and the SubmissionBatcher for the respective QueueType.         //
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+class QueuePool {
+
+  struct Entry {
+    vk::Queue  mQueue;
+    uint32_t   mFamily = 0;
+    uint32_t   mIndex  = 0;
+    std::mutex mMutex;
+  };
+
+ public:
+  // Grants exclusive access to a vk::Queue while it exists. It can be used like a pointer.
+  class Lock {
+   public:
+    Lock(Lock&& other) = default;
+    Lock& operator=(Lock&& other) = default;
+
+    vk::Queue const& operator*() const;
+    vk::Queue const* operator->() const;
+
+    uint32_t getFamily() const;
+    uint32_t getIndex() const;
+
+   private:
+    friend class QueuePool;
+    explicit Lock(Entry& entry);
+    Lock(Entry& entry, std::unique_lock<std::mutex>&& lock);
+
+    Entry const*                 mEntry;
+    std::unique_lock<std::mutex> mLock;
+  };
+
+  // Syntactic sugar to create a std::shared_ptr for this class
+  template <typename... Args>
+  static QueuePoolPtr create(Args&&... args) {
+    return std::make_shared<QueuePool>(args...);
+  };
+
+  // Retrieves all queues of the families used by the QueueTypes from the given device. These have
+  // to be created by it, see getQueueCreateInfos().
+  QueuePool(vk::DevicePtr const& device, PhysicalDevicePtr const& physicalDevice);
+  virtual ~QueuePool();
+
+  // Returns one vk::DeviceQueueCreateInfo for each family used by the QueueTypes of the given
+  // PhysicalDevice, requesting all of its queues. The priorities have to be kept alive until the
+  // vk::Device has been created.
+  static std::vector<vk::DeviceQueueCreateInfo> getQueueCreateInfos(
+      PhysicalDevicePtr const& physicalDevice, std::vector<float>& priorities);
+
+  // The number of queues of the family used by the given QueueType.
+  uint32_t getQueueCount(QueueType type) const;
+
+  // Returns the queue with the given index of the family used by the QueueType. If the index is
+  // omitted, the one chosen by the PhysicalDevice is used. Do not submit to it without a Lock.
+  vk::Queue const& getQueue(QueueType type) const;
+  vk::Queue const& getQueue(QueueType type, uint32_t index) const;
+
+  // Locks a queue of the family used by the given QueueType. This blocks while another thread holds
+  // a Lock of the same queue. Again, the index chosen by the PhysicalDevice is used if omitted.
+  Lock lock(QueueType type) const;
+  Lock lock(QueueType type, uint32_t index) const;
+
+  // Locks any queue of the family used by the given QueueType. The queues are tried in a
+  // round-robin fashion, the first one which is not locked currently is returned. If all of them
+  // are locked, this blocks until the next one in turn is available. Submissions to different
+  // queues are not ordered; use this only for work which is synchronized with semaphores or fences.
+  Lock lockAny(QueueType type) const;
+
+  // Locks all queues, for example for vkDeviceWaitIdle.
+  std::vector<Lock> lockAll() const;
+
+ private:
+  std::vector<std::unique_ptr<Entry>> const& getFamily(QueueType type) const;
+
+  PhysicalDevicePtr mPhysicalDevice;
+
+  std::map<uint32_t, std::vector<std::unique_ptr<Entry>>> mFamilies;
+  mutable std::atomic<uint32_t>                            mNextAny{0};
+};
+
+} // namespace Illusion::Graphics
+
+#endif // ILLUSION_GRAPHICS_QUEUE_POOL_HPP
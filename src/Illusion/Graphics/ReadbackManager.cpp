@@ -0,0 +1,260 @@
+////////////////////////////////////////////////////////////////////////////////////////////////////
+//                                                                                                //
+//    _)  |  |            _)                This code may be used and modified under the terms    //
+//     |  |  |  |  | (_-<  |   _ \    \     of the MIT license. See the LICENSE file for details. //
+//    _| _| _| \_,_| ___/ _| \___/ _| _|    Copyright (c) 2018-2019 Simon Schneegans              //
+//                                                                                                //
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include "ReadbackManager.hpp"
+
+#include "../Core/Logger.hpp"
+#include "BackedBuffer.hpp"
+#include "BackedImage.hpp"
+#include "CommandBuffer.hpp"
+#include "Device.hpp"
+#include "PhysicalDevice.hpp"
+#include "Utils.hpp"
+
+#include <algorithm>
+#include <iostream>
+
+namespace Illusion::Graphics {
+
+namespace {
+
+// Buffer-image copies only write single aspects; depth values are stored in 16 or 32 bits.
+vk::DeviceSize getTexelSize(vk::Format format, vk::ImageAspectFlags aspect) {
+  if (aspect == vk::ImageAspectFlagBits::eStencil) {
+    return 1;
+  }
+
+  if (aspect == vk::ImageAspectFlagBits::eDepth) {
+    return format == vk::Format::eD16Unorm || format == vk::Format::eD16UnormS8Uint ? 2 : 4;
+  }
+
+  return Utils::getByteCount(format);
+}
+
+std::future<std::vector<uint8_t>> makeFuture(ReadbackManager::Callback& callback) {
+  auto promise = std::make_shared<std::promise<std::vector<uint8_t>>>();
+
+  // if the callback is destroyed without being invoked, the future reports a broken promise
+  callback = [promise](uint8_t const* data, vk::DeviceSize size) {
+    promise->set_value(std::vector<uint8_t>(data, data + size));
+  };
+
+  return promise->get_future();
+}
+
+} // namespace
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+ReadbackManager::ReadbackManager(DevicePtr const& device, vk::DeviceSize chunkSize)
+    : mDevice(device)
+    , mChunkSize(chunkSize) {
+
+  ILLUSION_TRACE << "Creating ReadbackManager." << std::endl;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+ReadbackManager::~ReadbackManager() {
+  ILLUSION_TRACE << "Deleting ReadbackManager." << std::endl;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void ReadbackManager::readBuffer(CommandBuffer& cmd, BackedBufferPtr const& buffer,
+    vk::DeviceSize offset, vk::DeviceSize size, Callback const& callback) {
+
+  auto read      = allocate(size, 4);
+  read.mCallback = callback;
+
+  cmd.copyBuffer(buffer, read.mChunk, {vk::BufferCopy(offset, read.mOffset, size)});
+
+  // the host read of resolve() has to wait for the copy; the barrier is flushed by end() at the
+  // latest
+  cmd.accessBuffer(read.mChunk, vk::PipelineStageFlagBits::eHost, vk::AccessFlagBits::eHostRead);
+
+  mReads.push_back(std::move(read));
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+std::future<std::vector<uint8_t>> ReadbackManager::readBuffer(CommandBuffer& cmd,
+    BackedBufferPtr const& buffer, vk::DeviceSize offset, vk::DeviceSize size) {
+
+  Callback callback;
+  auto     future = makeFuture(callback);
+  readBuffer(cmd, buffer, offset, size, callback);
+  return future;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void ReadbackManager::readImage(CommandBuffer& cmd, BackedImagePtr const& image,
+    glm::uvec2 const& offset, glm::uvec2 const& extent, Callback const& callback,
+    vk::ImageSubresourceLayers const& subresource) {
+
+  vk::Format format = image->mImageInfo.format;
+
+  if (Utils::isCompressedFormat(format)) {
+    throw std::runtime_error("Failed to read image: Compressed formats are not supported (" +
+                             vk::to_string(format) + ")!");
+  }
+
+  // the offsets of buffer-image copies have to be multiples of four and of the texel size
+  vk::DeviceSize texelSize = getTexelSize(format, subresource.aspectMask);
+  vk::DeviceSize size      = texelSize * extent.x * extent.y * subresource.layerCount;
+
+  auto read      = allocate(size, texelSize * 4);
+  read.mCallback = callback;
+
+  vk::BufferImageCopy info;
+  info.bufferOffset      = read.mOffset;
+  info.bufferRowLength   = 0;
+  info.bufferImageHeight = 0;
+  info.imageSubresource  = subresource;
+  info.imageOffset       = vk::Offset3D(offset.x, offset.y, 0);
+  info.imageExtent       = vk::Extent3D(extent.x, extent.y, 1);
+
+  cmd.copyImageToBuffer(image, read.mChunk, {info});
+  cmd.accessBuffer(read.mChunk, vk::PipelineStageFlagBits::eHost, vk::AccessFlagBits::eHostRead);
+
+  mReads.push_back(std::move(read));
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+std::future<std::vector<uint8_t>> ReadbackManager::readImage(CommandBuffer& cmd,
+    BackedImagePtr const& image, glm::uvec2 const& offset, glm::uvec2 const& extent,
+    vk::ImageSubresourceLayers const& subresource) {
+
+  Callback callback;
+  auto     future = makeFuture(callback);
+  readImage(cmd, image, offset, extent, callback, subresource);
+  return future;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void ReadbackManager::resolve() {
+
+  // Host-cached memory is usually not coherent, so the written ranges of the chunks have to be
+  // invalidated before they are read. The ranges have to be aligned to the nonCoherentAtomSize
+  // and are relative to the start of the vk::DeviceMemory block the chunk was sub-allocated from.
+  auto const& memoryProperties = mDevice->getPhysicalDevice()->getMemoryProperties();
+  auto atomSize = mDevice->getPhysicalDevice()->getProperties().limits.nonCoherentAtomSize;
+
+  std::vector<vk::MappedMemoryRange> ranges;
+
+  for (size_t i(0); i < mChunks.size() && i <= mCurrentChunk; ++i) {
+    auto const& chunk = mChunks[i];
+
+    if (memoryProperties.memoryTypes[chunk->mMemoryInfo.memoryTypeIndex].propertyFlags &
+        vk::MemoryPropertyFlagBits::eHostCoherent) {
+      continue;
+    }
+
+    vk::DeviceSize used = i < mCurrentChunk ? chunk->mBufferInfo.size : mCurrentOffset;
+    auto           end  = (chunk->mMemoryOffset + used + atomSize - 1) / atomSize * atomSize;
+
+    vk::MappedMemoryRange range;
+    range.memory = *chunk->mMemory;
+    range.offset = chunk->mMemoryOffset / atomSize * atomSize;
+    range.size   = end - range.offset;
+
+    // The rounded range may exceed a dedicated allocation.
+    if (end > chunk->mMemoryOffset + chunk->mMemoryInfo.allocationSize) {
+      range.size = VK_WHOLE_SIZE;
+    }
+
+    if (used > 0) {
+      ranges.push_back(range);
+    }
+  }
+
+  if (!ranges.empty()) {
+    mDevice->getHandle()->invalidateMappedMemoryRanges(ranges);
+  }
+
+  // the reads are moved out first, as the callbacks may record new reads
+  auto reads = std::move(mReads);
+  mReads.clear();
+
+  mCurrentChunk  = 0;
+  mCurrentOffset = 0;
+  mPendingBytes  = 0;
+
+  for (auto const& read : reads) {
+    read.mCallback(read.mChunk->mMappedData + read.mOffset, read.mSize);
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+uint32_t ReadbackManager::getChunkCount() const {
+  return static_cast<uint32_t>(mChunks.size());
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+vk::DeviceSize ReadbackManager::getPendingBytes() const {
+  return mPendingBytes;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+ReadbackManager::Read ReadbackManager::allocate(vk::DeviceSize size, vk::DeviceSize alignment) {
+
+  // Find the next chunk with enough space left. The remaining space of skipped chunks is wasted
+  // until the next resolve().
+  while (mCurrentChunk < mChunks.size()) {
+    vk::DeviceSize offset = (mCurrentOffset + alignment - 1) / alignment * alignment;
+
+    if (offset + size <= mChunks[mCurrentChunk]->mBufferInfo.size) {
+      Read result;
+      result.mChunk  = mChunks[mCurrentChunk];
+      result.mOffset = offset;
+      result.mSize   = size;
+
+      mCurrentOffset = offset + size;
+      mPendingBytes += size;
+
+      return result;
+    }
+
+    ++mCurrentChunk;
+    mCurrentOffset = 0;
+  }
+
+  // All chunks are full, create a new one.
+  mChunks.push_back(createChunk(std::max(mChunkSize, size)));
+
+  return allocate(size, alignment);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+BackedBufferPtr ReadbackManager::createChunk(vk::DeviceSize size) const {
+  ILLUSION_DEBUG << "Adding chunk of " << size << " bytes to ReadbackManager." << std::endl;
+
+  // Host-cached memory is much faster to read by the CPU than write-combined memory. Host visible
+  // memory is persistently mapped by the MemoryAllocator of the Device.
+  try {
+    return mDevice->createBackedBuffer(vk::BufferUsageFlagBits::eTransferDst,
+        vk::MemoryPropertyFlagBits::eHostCached | vk::MemoryPropertyFlagBits::eHostVisible, size);
+  } catch (std::exception const& e) {
+    ILLUSION_WARNING << "Failed to allocate host-cached memory for ReadbackManager (" << e.what()
+                     << "). Using host-coherent memory instead." << std::endl;
+  }
+
+  return mDevice->createBackedBuffer(vk::BufferUsageFlagBits::eTransferDst,
+      vk::MemoryPropertyFlagBits::eHostCoherent | vk::MemoryPropertyFlagBits::eHostVisible, size);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+} // namespace Illusion::Graphics
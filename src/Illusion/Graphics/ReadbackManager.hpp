@@ -0,0 +1,107 @@
+////////////////////////////////////////////////////////////////////////////////////////////////////
+//                                                                                                //
+//    _)  |  |            _)                This code may be used and modified under the terms    //
+//     |  |  |  |  | (_-<  |   _ \    \     of the MIT license. See the LICENSE file for details. //
+//    _| _| _| \_,_| ___/ _| \___/ _| _|    Copyright (c) 2018-2019 Simon Schneegans              //
+//                                                                                                //
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#ifndef ILLUSION_GRAPHICS_READBACK_MANAGER_HPP
+#define ILLUSION_GRAPHICS_READBACK_MANAGER_HPP
+
+#include "fwd.hpp"
+
+#include <functional>
+#include <future>
+#include <glm/glm.hpp>
+
+namespace Illusion::Graphics {
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// The ReadbackManager copies data from BackedBuffers and BackedImages to the host without        //
+// stalling the pipeline. The reads record a copy to persistently mapped chunks of host-cached    //
+// memory, which are used like the chunks of a TransientAllocator. Once the GPU has finished the  //
+// CommandBuffer, resolve() passes the data to the callbacks of the reads or to the returned      //
+// std::futures. Each Frame of the FrameContext has a ReadbackManager, which is resolved by       //
+// beginFrame() when the fence of the Frame has been signaled. So the data of a read recorded in  //
+// a frame is available getFrameCount() frames later, for example for screenshots, picking or the //
+// results of compute shaders. Without a FrameContext, a ReadbackManager should be used for each  //
+// CommandBuffer and resolved after waiting for its fence.                                        //
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+class ReadbackManager {
+
+ public:
+  // The data is only valid during the call.
+  typedef std::function<void(uint8_t const* data, vk::DeviceSize size)> Callback;
+
+  // Syntactic sugar to create a std::shared_ptr for this class
+  template <typename... Args>
+  static ReadbackManagerPtr create(Args&&... args) {
+    return std::make_shared<ReadbackManager>(args...);
+  };
+
+  // Chunks are created on demand; reads larger than the chunkSize get a chunk of their own. If the
+  // PhysicalDevice has no host-cached memory, host-coherent memory is used instead.
+  explicit ReadbackManager(DevicePtr const& device, vk::DeviceSize chunkSize = 1024 * 1024);
+  virtual ~ReadbackManager();
+
+  // Records a copy of the given range of the buffer, which needs the eTransferSrc usage. The
+  // callback is invoked by resolve(); the second version returns a std::future which becomes ready
+  // there instead. If the ReadbackManager is destroyed before, the future throws a
+  // std::future_error.
+  void readBuffer(CommandBuffer& cmd, BackedBufferPtr const& buffer, vk::DeviceSize offset,
+      vk::DeviceSize size, Callback const& callback);
+  std::future<std::vector<uint8_t>> readBuffer(CommandBuffer& cmd, BackedBufferPtr const& buffer,
+      vk::DeviceSize offset, vk::DeviceSize size);
+
+  // Records a copy of the given region of the image, which needs the eTransferSrc usage. The texels
+  // of each layer are tightly packed, row by row. Only one aspect can be read at once; for the
+  // stencil aspect, one byte per texel is returned. The image is transitioned to
+  // vk::ImageLayout::eTransferSrcOptimal. A std::runtime_error is thrown for compressed formats.
+  void readImage(CommandBuffer& cmd, BackedImagePtr const& image, glm::uvec2 const& offset,
+      glm::uvec2 const& extent, Callback const& callback,
+      vk::ImageSubresourceLayers const& subresource = {vk::ImageAspectFlagBits::eColor, 0, 0, 1});
+  std::future<std::vector<uint8_t>> readImage(CommandBuffer& cmd, BackedImagePtr const& image,
+      glm::uvec2 const& offset, glm::uvec2 const& extent,
+      vk::ImageSubresourceLayers const& subresource = {vk::ImageAspectFlagBits::eColor, 0, 0, 1});
+
+  // Invokes the callbacks and fulfills the futures of all reads recorded since the last call, in
+  // the order in which they were recorded. This must only be called once the GPU has finished the
+  // CommandBuffers of these reads. Afterwards, all chunks are available again.
+  void resolve();
+
+  // The number of chunks which have been created so far.
+  uint32_t getChunkCount() const;
+
+  // The number of bytes which are read by the reads recorded since the last resolve().
+  vk::DeviceSize getPendingBytes() const;
+
+ private:
+  struct Read {
+    BackedBufferPtr mChunk;
+    vk::DeviceSize  mOffset;
+    vk::DeviceSize  mSize;
+    Callback        mCallback;
+  };
+
+  // Returns a range of the given size in one of the chunks. The offset is a multiple of the given
+  // alignment.
+  Read allocate(vk::DeviceSize size, vk::DeviceSize alignment);
+
+  BackedBufferPtr createChunk(vk::DeviceSize size) const;
+
+  DevicePtr      mDevice;
+  vk::DeviceSize mChunkSize;
+
+  std::vector<BackedBufferPtr> mChunks;
+  size_t                       mCurrentChunk  = 0;
+  vk::DeviceSize               mCurrentOffset = 0;
+
+  std::vector<Read> mReads;
+  vk::DeviceSize    mPendingBytes = 0;
+};
+
+} // namespace Illusion::Graphics
+
+#endif // ILLUSION_GRAPHICS_READBACK_MANAGER_HPP
@@ -0,0 +1,928 @@
+////////////////////////////////////////////////////////////////////////////////////////////////////
+//                                                                                                //
+//    _)  |  |            _)                This code may be used and modified under the terms    //
+//     |  |  |  |  | (_-<  |   _ \    \     of the MIT license. See the LICENSE file for details. //
+//    _| _| _| \_,_| ___/ _| \___/ _| _|    Copyright (c) 2018-2019 Simon Schneegans              //
+//                                                                                                //
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include "RenderGraph.hpp"
+
+#include "../Core/Logger.hpp"
+#include "CommandBuffer.hpp"
+#include "DeletionQueue.hpp"
+#include "Device.hpp"
+#include "RenderPass.hpp"
+#include "Texture.hpp"
+#include "Utils.hpp"
+
+#include <algorithm>
+#include <set>
+
+namespace Illusion::Graphics {
+
+namespace {
+
+typedef RenderGraph::Pass::Access Access;
+typedef RenderGraph::Pass::Use    Use;
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+bool isWrite(Use const& use) {
+  return use.mAccess == Access::eColorAttachment || use.mAccess == Access::eDepthAttachment;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+bool needsContent(Use const& use) {
+  return !isWrite(use) || use.mLoadOp == vk::AttachmentLoadOp::eLoad;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+vk::ImageLayout getLayout(Use const& use) {
+  switch (use.mAccess) {
+  case Access::eColorAttachment:
+    return vk::ImageLayout::eColorAttachmentOptimal;
+  case Access::eDepthAttachment:
+    return vk::ImageLayout::eDepthStencilAttachmentOptimal;
+  default:
+    return vk::ImageLayout::eShaderReadOnlyOptimal;
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+vk::ImageUsageFlags getUsage(Use const& use) {
+  switch (use.mAccess) {
+  case Access::eColorAttachment:
+    return vk::ImageUsageFlagBits::eColorAttachment;
+  case Access::eDepthAttachment:
+    return vk::ImageUsageFlagBits::eDepthStencilAttachment;
+  case Access::eInputAttachment:
+    return vk::ImageUsageFlagBits::eInputAttachment;
+  default:
+    return vk::ImageUsageFlagBits::eSampled;
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+vk::PipelineStageFlags getStage(Use const& use) {
+  switch (use.mAccess) {
+  case Access::eColorAttachment:
+    return vk::PipelineStageFlagBits::eColorAttachmentOutput;
+  case Access::eDepthAttachment:
+    return vk::PipelineStageFlagBits::eEarlyFragmentTests |
+           vk::PipelineStageFlagBits::eLateFragmentTests;
+  case Access::eInputAttachment:
+    return vk::PipelineStageFlagBits::eFragmentShader;
+  default:
+    return vk::PipelineStageFlagBits::eVertexShader | vk::PipelineStageFlagBits::eFragmentShader;
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+vk::AccessFlags getWriteAccess(Use const& use) {
+  switch (use.mAccess) {
+  case Access::eColorAttachment:
+    return vk::AccessFlagBits::eColorAttachmentWrite;
+  case Access::eDepthAttachment:
+    return vk::AccessFlagBits::eDepthStencilAttachmentWrite;
+  default:
+    return vk::AccessFlags();
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+vk::AccessFlags getAccess(Use const& use) {
+  switch (use.mAccess) {
+  case Access::eColorAttachment:
+    return vk::AccessFlagBits::eColorAttachmentWrite | vk::AccessFlagBits::eColorAttachmentRead;
+  case Access::eDepthAttachment:
+    return vk::AccessFlagBits::eDepthStencilAttachmentWrite |
+           vk::AccessFlagBits::eDepthStencilAttachmentRead;
+  case Access::eInputAttachment:
+    return vk::AccessFlagBits::eInputAttachmentRead;
+  default:
+    return vk::AccessFlagBits::eShaderRead;
+  }
+}
+
+} // namespace
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+RenderGraph::Resource::Resource(std::string const& name)
+    : mName(name) {
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+RenderGraph::Resource::~Resource() {
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+std::string const& RenderGraph::Resource::getName() const {
+  return mName;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void RenderGraph::Resource::setFormat(vk::Format format) {
+  mFormat = format;
+  mDirty  = true;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+vk::Format RenderGraph::Resource::getFormat() const {
+  return mFormat;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void RenderGraph::Resource::setExtent(glm::uvec2 const& extent) {
+  if (mExtent != extent) {
+    mExtent = extent;
+    mDirty  = true;
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+glm::uvec2 const& RenderGraph::Resource::getExtent() const {
+  return mExtent;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+RenderGraph::Pass::Pass(std::string const& name)
+    : mName(name) {
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+RenderGraph::Pass::~Pass() {
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+std::string const& RenderGraph::Pass::getName() const {
+  return mName;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void RenderGraph::Pass::addColorAttachment(
+    ResourcePtr const& resource, vk::AttachmentLoadOp loadOp) {
+  mUses.push_back({resource, Access::eColorAttachment, loadOp});
+  mDirty = true;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void RenderGraph::Pass::addDepthAttachment(
+    ResourcePtr const& resource, vk::AttachmentLoadOp loadOp) {
+  for (auto const& use : mUses) {
+    if (use.mAccess == Access::eDepthAttachment) {
+      throw std::runtime_error(
+          "Failed to add depth attachment to pass \"" + mName + "\": There is already one!");
+    }
+  }
+
+  mUses.push_back({resource, Access::eDepthAttachment, loadOp});
+  mDirty = true;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void RenderGraph::Pass::addInputAttachment(ResourcePtr const& resource) {
+  mUses.push_back({resource, Access::eInputAttachment, vk::AttachmentLoadOp::eLoad});
+  mDirty = true;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void RenderGraph::Pass::addSampledImage(ResourcePtr const& resource) {
+  mUses.push_back({resource, Access::eSampled, vk::AttachmentLoadOp::eLoad});
+  mDirty = true;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void RenderGraph::Pass::setProcessCallback(
+    std::function<void(CommandBufferPtr const&)> const& callback) {
+  mProcessCallback = callback;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+std::vector<RenderGraph::Pass::Use> const& RenderGraph::Pass::getUses() const {
+  return mUses;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+RenderGraph::RenderGraph(DevicePtr const& device)
+    : mDevice(device) {
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+RenderGraph::~RenderGraph() {
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+RenderGraph::ResourcePtr RenderGraph::createResource(std::string const& name, vk::Format format) {
+  auto resource = Resource::create(name);
+  resource->setFormat(format);
+  mResources.push_back(resource);
+  mDirty = true;
+  return resource;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+RenderGraph::PassPtr RenderGraph::createPass(std::string const& name) {
+  auto pass = Pass::create(name);
+  mPasses.push_back(pass);
+  mDirty = true;
+  return pass;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void RenderGraph::setOutput(ResourcePtr const& resource) {
+  mOutput = resource;
+  mDirty  = true;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+RenderGraph::ResourcePtr const& RenderGraph::getOutput() const {
+  return mOutput;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void RenderGraph::setExtent(glm::uvec2 const& extent) {
+  if (mExtent != extent) {
+    mExtent = extent;
+    mDirty  = true;
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+glm::uvec2 const& RenderGraph::getExtent() const {
+  return mExtent;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void RenderGraph::process(CommandBufferPtr const& cmd) {
+  if (isDirty()) {
+    if (!mDevice->getDeletionQueue()->getEnabled()) {
+      mDevice->waitIdle();
+    }
+    compile();
+  }
+
+  for (auto const& group : mGroups) {
+    cmd->beginRenderPass(group.mRenderPass);
+
+    for (size_t i(0); i < group.mPasses.size(); ++i) {
+      if (i > 0) {
+        cmd->nextSubPass();
+      }
+
+      if (group.mPasses[i]->mProcessCallback) {
+        group.mPasses[i]->mProcessCallback(cmd);
+      }
+    }
+
+    cmd->endRenderPass();
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+TexturePtr RenderGraph::getTexture(ResourcePtr const& resource) const {
+  auto image = mResourceImages.find(resource);
+
+  if (image == mResourceImages.end()) {
+    return nullptr;
+  }
+
+  return mImages[image->second].mTexture;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+TexturePtr RenderGraph::getOutputTexture() const {
+  return getTexture(mOutput);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+uint32_t RenderGraph::getCulledPassCount() const {
+  return mCulledPassCount;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+uint32_t RenderGraph::getRenderPassCount() const {
+  return static_cast<uint32_t>(mGroups.size());
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+uint32_t RenderGraph::getTextureCount() const {
+  return static_cast<uint32_t>(mImages.size());
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+bool RenderGraph::isDirty() const {
+  if (mDirty) {
+    return true;
+  }
+
+  for (auto const& resource : mResources) {
+    if (resource->mDirty) {
+      return true;
+    }
+  }
+
+  for (auto const& pass : mPasses) {
+    if (pass->mDirty) {
+      return true;
+    }
+  }
+
+  return false;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void RenderGraph::compile() {
+  auto passes      = cullPasses();
+  mCulledPassCount = static_cast<uint32_t>(mPasses.size() - passes.size());
+
+  mergePasses(passes);
+  assignImages();
+  createRenderPasses();
+
+  for (auto const& resource : mResources) {
+    resource->mDirty = false;
+  }
+
+  for (auto const& pass : mPasses) {
+    pass->mDirty = false;
+  }
+
+  mDirty = false;
+
+  ILLUSION_DEBUG << "Compiled RenderGraph: " << passes.size() << " passes (" << mCulledPassCount
+                 << " culled) in " << mGroups.size() << " RenderPasses using " << mImages.size()
+                 << " Textures." << std::endl;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+std::vector<RenderGraph::PassPtr> RenderGraph::cullPasses() const {
+  if (!mOutput) {
+    throw std::runtime_error("Failed to compile RenderGraph: No output has been set!");
+  }
+
+  // The passes are visited in reverse order. A pass is required if it writes a Resource whose
+  // content is needed later on. Resources which are still needed at the beginning of the frame are
+  // read before they are written, their content is taken from the previous frame. Therefore all
+  // passes are visited a second time with these Resources.
+  std::vector<bool>     required(mPasses.size(), false);
+  std::set<ResourcePtr> needed;
+
+  for (int iteration(0); iteration < 2; ++iteration) {
+    needed.insert(mOutput);
+
+    for (size_t i(mPasses.size()); i-- > 0;) {
+      auto const& uses = mPasses[i]->mUses;
+
+      bool contributes = false;
+      for (auto const& use : uses) {
+        contributes |= isWrite(use) && needed.count(use.mResource) > 0;
+      }
+
+      if (!contributes) {
+        continue;
+      }
+
+      required[i] = true;
+
+      for (auto const& use : uses) {
+        if (!needsContent(use)) {
+          needed.erase(use.mResource);
+        }
+      }
+
+      for (auto const& use : uses) {
+        if (needsContent(use)) {
+          needed.insert(use.mResource);
+        }
+      }
+    }
+  }
+
+  std::vector<PassPtr>  passes;
+  std::set<ResourcePtr> written;
+
+  for (size_t i(0); i < mPasses.size(); ++i) {
+    if (required[i]) {
+      passes.push_back(mPasses[i]);
+
+      for (auto const& use : mPasses[i]->mUses) {
+        if (isWrite(use)) {
+          written.insert(use.mResource);
+        }
+      }
+    }
+  }
+
+  for (auto const& resource : needed) {
+    if (written.count(resource) == 0) {
+      throw std::runtime_error("Failed to compile RenderGraph: Resource \"" +
+                               resource->getName() + "\" is read but never written!");
+    }
+  }
+
+  return passes;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void RenderGraph::mergePasses(std::vector<PassPtr> const& passes) {
+  mGroups.clear();
+
+  for (auto const& pass : passes) {
+    if (mGroups.empty() || !canMerge(mGroups.back(), pass)) {
+      Group group;
+      group.mExtent = getExtent(pass);
+      mGroups.push_back(group);
+    }
+
+    mGroups.back().mPasses.push_back(pass);
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void RenderGraph::assignImages() {
+  mImages.clear();
+  mResourceImages.clear();
+
+  // Collect the uses of all Resources in the order of execution.
+  std::vector<ResourcePtr>                     resources;
+  std::map<ResourcePtr, std::vector<ImageUse>> uses;
+
+  for (uint32_t g(0); g < mGroups.size(); ++g) {
+    for (uint32_t s(0); s < mGroups[g].mPasses.size(); ++s) {
+      for (auto const& use : mGroups[g].mPasses[s]->mUses) {
+        if (uses.find(use.mResource) == uses.end()) {
+          resources.push_back(use.mResource);
+        }
+        uses[use.mResource].push_back({g, s, &use});
+      }
+    }
+  }
+
+  // Resources which are cleared before their first use may share a physical image with another
+  // Resource whose last use is in an earlier RenderPass.
+  for (auto const& resource : resources) {
+    auto const& resourceUses = uses[resource];
+    bool        isOutput     = resource == mOutput;
+    bool        persistent   = isOutput || needsContent(*resourceUses.front().mUse);
+    glm::uvec2  extent       = getExtent(resource);
+
+    uint32_t index = static_cast<uint32_t>(mImages.size());
+
+    if (!persistent) {
+      for (uint32_t i(0); i < mImages.size(); ++i) {
+        auto const& image = mImages[i];
+        if (!image.mPersistent && image.mFormat == resource->mFormat && image.mExtent == extent &&
+            image.mUses.back().mGroup < resourceUses.front().mGroup) {
+          index = i;
+          break;
+        }
+      }
+    }
+
+    if (index == mImages.size()) {
+      PhysicalImage image;
+      image.mFormat     = resource->mFormat;
+      image.mExtent     = extent;
+      image.mPersistent = persistent;
+      image.mIsOutput   = isOutput;
+      mImages.push_back(image);
+    }
+
+    auto& image = mImages[index];
+    image.mUses.insert(image.mUses.end(), resourceUses.begin(), resourceUses.end());
+
+    for (auto const& use : resourceUses) {
+      image.mUsage |= getUsage(*use.mUse);
+    }
+
+    mResourceImages[resource] = index;
+  }
+
+  for (auto& image : mImages) {
+
+    // eTransferSrc is required for blitting the output to the swapchain images.
+    if (image.mIsOutput) {
+      image.mUsage |= vk::ImageUsageFlagBits::eTransferSrc;
+    }
+
+    // Images which are cleared before their first use and only used as attachments of a single
+    // RenderPass are created by its Framebuffer, they may never leave on-chip memory.
+    vk::ImageUsageFlags attachmentUsage = vk::ImageUsageFlagBits::eColorAttachment |
+                                          vk::ImageUsageFlagBits::eDepthStencilAttachment |
+                                          vk::ImageUsageFlagBits::eInputAttachment;
+
+    uint32_t group       = image.mUses.front().mGroup;
+    bool     singleGroup = std::all_of(image.mUses.begin(), image.mUses.end(),
+        [group](ImageUse const& use) { return use.mGroup == group; });
+
+    // The first use has to write the image without loading it, else its content would be needed.
+    auto const& first     = *image.mUses.front().mUse;
+    bool        notLoaded = isWrite(first) && first.mLoadOp != vk::AttachmentLoadOp::eLoad;
+
+    image.mTransient = !image.mPersistent && !(image.mUsage & ~attachmentUsage) && singleGroup &&
+                       notLoaded;
+
+    if (image.mTransient) {
+      continue;
+    }
+
+    // The image is created in the layout it has at the end of each frame.
+    size_t lastAttachmentUse = image.mUses.size() - 1;
+    while (image.mUses[lastAttachmentUse].mUse->mAccess == Access::eSampled) {
+      --lastAttachmentUse;
+    }
+
+    auto range  = getUseRange(image, image.mUses[lastAttachmentUse].mGroup);
+    auto layout = getFinalLayout(image, range.second);
+
+    vk::ImageAspectFlags aspect;
+
+    if (Utils::isDepthOnlyFormat(image.mFormat)) {
+      aspect |= vk::ImageAspectFlagBits::eDepth;
+    } else if (Utils::isDepthStencilFormat(image.mFormat)) {
+      aspect |= vk::ImageAspectFlagBits::eDepth;
+      aspect |= vk::ImageAspectFlagBits::eStencil;
+    } else {
+      aspect |= vk::ImageAspectFlagBits::eColor;
+    }
+
+    vk::ImageCreateInfo imageInfo;
+    imageInfo.imageType     = vk::ImageType::e2D;
+    imageInfo.format        = image.mFormat;
+    imageInfo.extent.width  = image.mExtent.x;
+    imageInfo.extent.height = image.mExtent.y;
+    imageInfo.extent.depth  = 1;
+    imageInfo.mipLevels     = 1;
+    imageInfo.arrayLayers   = 1;
+    imageInfo.samples       = vk::SampleCountFlagBits::e1;
+    imageInfo.tiling        = vk::ImageTiling::eOptimal;
+    imageInfo.usage         = image.mUsage;
+    imageInfo.sharingMode   = vk::SharingMode::eExclusive;
+    imageInfo.initialLayout = vk::ImageLayout::eUndefined;
+
+    image.mTexture = mDevice->createTexture(
+        imageInfo, mDevice->createSamplerInfo(), vk::ImageViewType::e2D, aspect, layout);
+
+    // Sampled uses never change the layout, the descriptors are written with this one.
+    if (image.mUsage & vk::ImageUsageFlagBits::eSampled) {
+      image.mTexture->mCurrentLayout = vk::ImageLayout::eShaderReadOnlyOptimal;
+    }
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void RenderGraph::createRenderPasses() {
+  for (uint32_t g(0); g < mGroups.size(); ++g) {
+    auto& group = mGroups[g];
+
+    group.mRenderPass = RenderPass::create(mDevice);
+    group.mRenderPass->setExtent(group.mExtent);
+
+    // Collect the physical images which are used as attachments in this group.
+    std::vector<uint32_t>        attachments;
+    std::map<uint32_t, uint32_t> attachmentIndices;
+    std::set<uint32_t>           sampledImages;
+    bool                         hasInputAttachments = false;
+
+    for (auto const& pass : group.mPasses) {
+      for (auto const& use : pass->mUses) {
+        uint32_t image = mResourceImages.at(use.mResource);
+
+        if (use.mAccess == Access::eSampled) {
+          sampledImages.insert(image);
+        } else if (attachmentIndices.find(image) == attachmentIndices.end()) {
+          attachmentIndices[image] = static_cast<uint32_t>(attachments.size());
+          attachments.push_back(image);
+        }
+
+        hasInputAttachments |= use.mAccess == Access::eInputAttachment;
+      }
+    }
+
+    for (auto index : attachments) {
+      auto const& image = mImages[index];
+      auto        range = getUseRange(image, g);
+      auto const& first = *image.mUses[range.first].mUse;
+
+      RenderPass::Attachment attachment;
+      attachment.mFormat        = image.mFormat;
+      attachment.mImage         = image.mTexture;
+      attachment.mLoadOp        = isWrite(first) ? first.mLoadOp : vk::AttachmentLoadOp::eLoad;
+      attachment.mStoreOp       = getStoreOp(image, range.second);
+      attachment.mInitialLayout = getInitialLayout(image, range.first);
+      attachment.mFinalLayout   = getFinalLayout(image, range.second);
+      attachment.mTransient     = image.mTransient;
+      group.mRenderPass->addAttachment(attachment);
+    }
+
+    // The default subpass of the RenderPass is sufficient for single passes without input
+    // attachments.
+    if (group.mPasses.size() > 1 || hasInputAttachments) {
+      std::vector<RenderPass::SubPass> subPasses(group.mPasses.size());
+
+      for (size_t s(0); s < group.mPasses.size(); ++s) {
+        for (auto const& use : group.mPasses[s]->mUses) {
+          if (use.mAccess == Access::eSampled) {
+            continue;
+          }
+
+          uint32_t attachment = attachmentIndices[mResourceImages.at(use.mResource)];
+
+          if (use.mAccess == Access::eInputAttachment) {
+            subPasses[s].mInputAttachments.push_back(attachment);
+          } else {
+            subPasses[s].mOutputAttachments.push_back(attachment);
+          }
+        }
+      }
+
+      // Attachments have to be preserved by all subpasses between their first and their last use.
+      for (auto index : attachments) {
+        auto range = getUseRange(mImages[index], g);
+
+        for (uint32_t s(mImages[index].mUses[range.first].mSubPass);
+             s < mImages[index].mUses[range.second].mSubPass; ++s) {
+          bool used = false;
+          for (size_t u(range.first); u <= range.second; ++u) {
+            used |= mImages[index].mUses[u].mSubPass == s;
+          }
+
+          if (!used) {
+            subPasses[s].mPreserveAttachments.push_back(attachmentIndices[index]);
+          }
+        }
+      }
+
+      group.mRenderPass->setSubPasses(subPasses);
+    }
+
+    // Compute the dependencies between the subpasses and to the commands outside this RenderPass,
+    // including the RenderPasses of the previous and the next frame. All dependencies between the
+    // same subpasses are merged.
+    std::map<std::pair<uint32_t, uint32_t>, vk::SubpassDependency> dependencies;
+
+    auto addDependency = [&dependencies](uint32_t src, uint32_t dst,
+                             vk::PipelineStageFlags srcStage, vk::AccessFlags srcAccess,
+                             vk::PipelineStageFlags dstStage, vk::AccessFlags dstAccess) {
+      auto& dependency = dependencies[{src, dst}];
+      dependency.srcSubpass = src;
+      dependency.dstSubpass = dst;
+
+      dependency.srcStageMask  |= srcStage;
+      dependency.srcAccessMask |= srcAccess;
+      dependency.dstStageMask  |= dstStage;
+      dependency.dstAccessMask |= dstAccess;
+
+      if (src != VK_SUBPASS_EXTERNAL && dst != VK_SUBPASS_EXTERNAL) {
+        dependency.dependencyFlags |= vk::DependencyFlagBits::eByRegion;
+      }
+    };
+
+    std::vector<uint32_t> usedImages(attachments);
+    usedImages.insert(usedImages.end(), sampledImages.begin(), sampledImages.end());
+
+    for (auto index : usedImages) {
+      auto const& image = mImages[index];
+      auto const& uses  = image.mUses;
+      size_t      count = uses.size();
+      auto        range = getUseRange(image, g);
+
+      auto const& first    = uses[range.first];
+      auto const& last     = uses[range.second];
+      auto const& previous = uses[(range.first + count - 1) % count];
+      auto const& next     = uses[(range.second + 1) % count];
+
+      // The output is blitted to the swapchain after the last RenderPass of each frame.
+      bool isPresentedBefore = image.mIsOutput && range.first == 0;
+      bool isPresentedAfter  = image.mIsOutput && range.second == count - 1;
+
+      addDependency(VK_SUBPASS_EXTERNAL, first.mSubPass,
+          isPresentedBefore ? vk::PipelineStageFlagBits::eTransfer : getStage(*previous.mUse),
+          isPresentedBefore ? vk::AccessFlags() : getWriteAccess(*previous.mUse),
+          getStage(*first.mUse), getAccess(*first.mUse));
+
+      vk::PipelineStageFlags stages;
+      vk::AccessFlags        writes;
+
+      for (size_t u(range.first); u <= range.second; ++u) {
+        stages |= getStage(*uses[u].mUse);
+        writes |= getWriteAccess(*uses[u].mUse);
+
+        if (u < range.second && uses[u].mSubPass != uses[u + 1].mSubPass) {
+          addDependency(uses[u].mSubPass, uses[u + 1].mSubPass, getStage(*uses[u].mUse),
+              getWriteAccess(*uses[u].mUse), getStage(*uses[u + 1].mUse),
+              getAccess(*uses[u + 1].mUse));
+        }
+      }
+
+      addDependency(last.mSubPass, VK_SUBPASS_EXTERNAL, stages, writes,
+          isPresentedAfter ? vk::PipelineStageFlagBits::eTransfer : getStage(*next.mUse),
+          isPresentedAfter ? vk::AccessFlagBits::eTransferRead : getAccess(*next.mUse));
+    }
+
+    for (auto const& dependency : dependencies) {
+      group.mRenderPass->addDependency(dependency.second);
+    }
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+bool RenderGraph::canMerge(Group const& group, PassPtr const& pass) const {
+  if (getExtent(pass) != group.mExtent) {
+    return false;
+  }
+
+  std::set<ResourcePtr> attachments;
+  std::set<ResourcePtr> sampled;
+  ResourcePtr           depth;
+
+  for (auto const& other : group.mPasses) {
+    for (auto const& use : other->mUses) {
+      if (use.mAccess == Access::eSampled) {
+        sampled.insert(use.mResource);
+      } else {
+        attachments.insert(use.mResource);
+      }
+
+      if (use.mAccess == Access::eDepthAttachment) {
+        depth = use.mResource;
+      }
+    }
+  }
+
+  // Attachments keep their layout for the entire RenderPass, hence they cannot be sampled in the
+  // same RenderPass. Furthermore, all subpasses have to share the same depth attachment.
+  for (auto const& use : pass->mUses) {
+    if (use.mAccess == Access::eSampled && attachments.count(use.mResource) > 0) {
+      return false;
+    }
+
+    if (use.mAccess != Access::eSampled && sampled.count(use.mResource) > 0) {
+      return false;
+    }
+
+    if (use.mAccess == Access::eDepthAttachment && depth && depth != use.mResource) {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+glm::uvec2 RenderGraph::getExtent(ResourcePtr const& resource) const {
+  if (resource->mExtent == glm::uvec2(0)) {
+    return mExtent;
+  }
+
+  return resource->mExtent;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+glm::uvec2 RenderGraph::getExtent(PassPtr const& pass) const {
+  glm::uvec2 extent(0);
+
+  for (auto const& use : pass->mUses) {
+    if (use.mAccess == Access::eSampled) {
+      continue;
+    }
+
+    if (extent != glm::uvec2(0) && extent != getExtent(use.mResource)) {
+      throw std::runtime_error("Failed to compile RenderGraph: The attachments of pass \"" +
+                               pass->getName() + "\" have different extents!");
+    }
+
+    extent = getExtent(use.mResource);
+  }
+
+  if (extent == glm::uvec2(0)) {
+    throw std::runtime_error(
+        "Failed to compile RenderGraph: Pass \"" + pass->getName() + "\" has no attachments!");
+  }
+
+  return extent;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+vk::ImageLayout RenderGraph::getFinalLayout(PhysicalImage const& image, size_t lastUse) const {
+  auto const& uses = image.mUses;
+
+  if (image.mIsOutput && lastUse == uses.size() - 1) {
+    return vk::ImageLayout::eColorAttachmentOptimal;
+  }
+
+  // If the content is required by a use outside of this RenderPass, the image is transitioned to
+  // the layout of this use. Else it stays in its current layout.
+  auto const& next = uses[(lastUse + 1) % uses.size()];
+
+  if (next.mGroup != uses[lastUse].mGroup && needsContent(*next.mUse)) {
+    return getLayout(*next.mUse);
+  }
+
+  return getLayout(*uses[lastUse].mUse);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+vk::ImageLayout RenderGraph::getInitialLayout(PhysicalImage const& image, size_t firstUse) const {
+  auto const& uses = image.mUses;
+
+  if (!needsContent(*uses[firstUse].mUse)) {
+    return vk::ImageLayout::eUndefined;
+  }
+
+  // Sampled uses do not change the layout, hence the layout is defined by the last RenderPass
+  // which used the image as attachment. This may be the RenderPass of the previous frame.
+  for (size_t i(1); i <= uses.size(); ++i) {
+    size_t index = (firstUse + uses.size() - i) % uses.size();
+    if (uses[index].mUse->mAccess != Access::eSampled) {
+      return getFinalLayout(image, index);
+    }
+  }
+
+  return vk::ImageLayout::eUndefined;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+vk::AttachmentStoreOp RenderGraph::getStoreOp(PhysicalImage const& image, size_t lastUse) const {
+  auto const& uses = image.mUses;
+
+  if (image.mIsOutput && lastUse == uses.size() - 1) {
+    return vk::AttachmentStoreOp::eStore;
+  }
+
+  if (needsContent(*uses[(lastUse + 1) % uses.size()].mUse)) {
+    return vk::AttachmentStoreOp::eStore;
+  }
+
+  return vk::AttachmentStoreOp::eDontCare;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+std::pair<size_t, size_t> RenderGraph::getUseRange(
+    PhysicalImage const& image, uint32_t group) const {
+  size_t first = image.mUses.size();
+  size_t last  = 0;
+
+  for (size_t i(0); i < image.mUses.size(); ++i) {
+    if (image.mUses[i].mGroup == group) {
+      first = std::min(first, i);
+      last  = std::max(last, i);
+    }
+  }
+
+  return {first, last};
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+} // namespace Illusion::Graphics
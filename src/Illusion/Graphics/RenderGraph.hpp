@@ -0,0 +1,223 @@
+////////////////////////////////////////////////////////////////////////////////////////////////////
+//                                                                                                //
+//    _)  |  |            _)                This code may be used and modified under the terms    //
+//     |  |  |  |  | (_-<  |   _ \    \     of the MIT license. See the LICENSE file for details. //
+//    _| _| _| \_,_| ___/ _| \___/ _| _|    Copyright (c) 2018-2019 Simon Schneegans              //
+//                                                                                                //
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#ifndef ILLUSION_GRAPHICS_RENDER_GRAPH_HPP
+#define ILLUSION_GRAPHICS_RENDER_GRAPH_HPP
+
+#include "fwd.hpp"
+
+#include <functional>
+#include <glm/glm.hpp>
+#include <map>
+
+namespace Illusion::Graphics {
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// The RenderGraph schedules a frame which consists of several passes. Passes declare which       //
+// Resources they write as color or depth attachments and which they read as input attachments or //
+// sampled images. Resources are logical images; the RenderGraph decides how many physical        //
+// Textures are actually required. When process() is called for the first time (or after the      //
+// graph has been modified), the graph is compiled:                                               //
+// * Passes which do not contribute to the output Resource are culled.                            //
+// * Consecutive passes with the same extent are merged into subpasses of one RenderPass, as long //
+//   as they do not sample Resources which are written in the same RenderPass.                    //
+// * Resources whose lifetimes do not overlap share one physical Texture if they have the same    //
+//   format and extent. Resources which are loaded before they are written in a frame (for        //
+//   example for temporal effects) and the output Resource are never shared.                      //
+// * Load and store operations, initial and final image layouts as well as subpass dependencies   //
+//   are computed from the declared uses. Contents which are not used later are not stored.       //
+// * Physical images which are only used as attachments of one RenderPass are transient. They are //
+//   created by its Framebuffer in lazily allocated memory and have no Texture.                   //
+// The output Resource ends up in vk::ImageLayout::eColorAttachmentOptimal, hence the result of   //
+// getOutputTexture() can be passed directly to Window::present().                                //
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+class RenderGraph {
+
+ public:
+  class Resource {
+   public:
+    // Syntactic sugar to create a std::shared_ptr for this class
+    template <typename... Args>
+    static std::shared_ptr<Resource> create(Args&&... args) {
+      return std::make_shared<Resource>(args...);
+    };
+
+    explicit Resource(std::string const& name);
+    virtual ~Resource();
+
+    std::string const& getName() const;
+
+    void       setFormat(vk::Format format);
+    vk::Format getFormat() const;
+
+    // If the extent is zero (which is the default), the extent of the RenderGraph is used.
+    void              setExtent(glm::uvec2 const& extent);
+    glm::uvec2 const& getExtent() const;
+
+   private:
+    friend class RenderGraph;
+
+    std::string mName;
+    vk::Format  mFormat = vk::Format::eR8G8B8A8Unorm;
+    glm::uvec2  mExtent = {0, 0};
+    bool        mDirty  = true;
+  };
+
+  typedef std::shared_ptr<Resource> ResourcePtr;
+
+  class Pass {
+   public:
+    // Syntactic sugar to create a std::shared_ptr for this class
+    template <typename... Args>
+    static std::shared_ptr<Pass> create(Args&&... args) {
+      return std::make_shared<Pass>(args...);
+    };
+
+    explicit Pass(std::string const& name);
+    virtual ~Pass();
+
+    std::string const& getName() const;
+
+    // The Resource will be bound as color attachment. The order of the calls defines the output
+    // locations of the fragment shader. Use vk::AttachmentLoadOp::eLoad to draw on top of the
+    // previous content.
+    void addColorAttachment(
+        ResourcePtr const& resource, vk::AttachmentLoadOp loadOp = vk::AttachmentLoadOp::eClear);
+    void addDepthAttachment(
+        ResourcePtr const& resource, vk::AttachmentLoadOp loadOp = vk::AttachmentLoadOp::eClear);
+
+    // The Resource has to be bound with BindingState::setInputAttachment() in the callback.
+    void addInputAttachment(ResourcePtr const& resource);
+
+    // The Resource has to be bound with BindingState::setTexture() in the callback. Use
+    // RenderGraph::getTexture() to get the physical Texture.
+    void addSampledImage(ResourcePtr const& resource);
+
+    // The callback is called during RenderGraph::process() inside the RenderPass and subpass this
+    // Pass has been assigned to. The viewport and scissor have to be set by the callback.
+    void setProcessCallback(std::function<void(CommandBufferPtr const&)> const& callback);
+
+    // The declared uses, these are evaluated by the RenderGraph during compilation.
+    enum class Access { eColorAttachment, eDepthAttachment, eInputAttachment, eSampled };
+
+    struct Use {
+      ResourcePtr          mResource;
+      Access               mAccess;
+      vk::AttachmentLoadOp mLoadOp;
+    };
+
+    std::vector<Use> const& getUses() const;
+
+   private:
+    friend class RenderGraph;
+
+    std::string                                  mName;
+    std::vector<Use>                             mUses;
+    std::function<void(CommandBufferPtr const&)> mProcessCallback;
+    bool                                         mDirty = true;
+  };
+
+  typedef std::shared_ptr<Pass> PassPtr;
+
+  // Syntactic sugar to create a std::shared_ptr for this class
+  template <typename... Args>
+  static RenderGraphPtr create(Args&&... args) {
+    return std::make_shared<RenderGraph>(args...);
+  };
+
+  RenderGraph(DevicePtr const& device);
+  virtual ~RenderGraph();
+
+  // Passes are executed in the order of their creation.
+  ResourcePtr createResource(std::string const& name, vk::Format format);
+  PassPtr     createPass(std::string const& name);
+
+  // The output has to be written as color attachment by at least one Pass.
+  void               setOutput(ResourcePtr const& resource);
+  ResourcePtr const& getOutput() const;
+
+  void              setExtent(glm::uvec2 const& extent);
+  glm::uvec2 const& getExtent() const;
+
+  // Compiles the graph if required and records all Passes which have not been culled to the given
+  // primary CommandBuffer. When the graph is re-compiled, the physical Textures may be replaced;
+  // unless a FrameContext is used (see Device::getDeletionQueue()), the Device is waited for to
+  // become idle before.
+  void process(CommandBufferPtr const& cmd);
+
+  // Returns the physical Texture of the given Resource. This is only valid after process() has
+  // been called. nullptr is returned for Resources which are not used by any remaining Pass and
+  // for transient ones.
+  TexturePtr getTexture(ResourcePtr const& resource) const;
+  TexturePtr getOutputTexture() const;
+
+  // Some statistics of the last compilation.
+  uint32_t getCulledPassCount() const;
+  uint32_t getRenderPassCount() const;
+  uint32_t getTextureCount() const;
+
+ private:
+  // One use of a physical Texture. mGroup is the index of the RenderPass, mSubPass the index of the
+  // subpass in this RenderPass.
+  struct ImageUse {
+    uint32_t         mGroup;
+    uint32_t         mSubPass;
+    Pass::Use const* mUse;
+  };
+
+  struct PhysicalImage {
+    vk::Format            mFormat;
+    glm::uvec2            mExtent;
+    vk::ImageUsageFlags   mUsage;
+    bool                  mPersistent;
+    bool                  mIsOutput;
+    bool                  mTransient = false;
+    std::vector<ImageUse> mUses;
+    TexturePtr            mTexture;
+  };
+
+  struct Group {
+    std::vector<PassPtr> mPasses;
+    glm::uvec2           mExtent;
+    RenderPassPtr        mRenderPass;
+  };
+
+  bool isDirty() const;
+  void compile();
+
+  // The compilation steps.
+  std::vector<PassPtr> cullPasses() const;
+  void                 mergePasses(std::vector<PassPtr> const& passes);
+  void                 assignImages();
+  void                 createRenderPasses();
+
+  bool                      canMerge(Group const& group, PassPtr const& pass) const;
+  glm::uvec2                getExtent(ResourcePtr const& resource) const;
+  glm::uvec2                getExtent(PassPtr const& pass) const;
+  vk::ImageLayout           getFinalLayout(PhysicalImage const& image, size_t lastUse) const;
+  vk::ImageLayout           getInitialLayout(PhysicalImage const& image, size_t firstUse) const;
+  vk::AttachmentStoreOp     getStoreOp(PhysicalImage const& image, size_t lastUse) const;
+  std::pair<size_t, size_t> getUseRange(PhysicalImage const& image, uint32_t group) const;
+
+  DevicePtr                mDevice;
+  std::vector<ResourcePtr> mResources;
+  std::vector<PassPtr>     mPasses;
+  ResourcePtr              mOutput;
+  glm::uvec2               mExtent = {100, 100};
+  bool                     mDirty  = true;
+
+  std::vector<Group>              mGroups;
+  std::vector<PhysicalImage>      mImages;
+  std::map<ResourcePtr, uint32_t> mResourceImages;
+  uint32_t                        mCulledPassCount = 0;
+};
+
+} // namespace Illusion::Graphics
+
+#endif // ILLUSION_GRAPHICS_RENDER_GRAPH_HPP
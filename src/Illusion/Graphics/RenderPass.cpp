@@ -10,10 +10,12 @@
 
 #include "../Core/Logger.hpp"
 #include "CommandBuffer.hpp"
+#include "DeletionQueue.hpp"
 #include "PhysicalDevice.hpp"
 #include "Utils.hpp"
 #include "Window.hpp"
 
+#include <algorithm>
 #include <iostream>
 
 namespace Illusion::Graphics {
@@ -36,14 +38,63 @@ RenderPass::~RenderPass() {
 
 void RenderPass::init() {
   if (mAttachmentsDirty) {
-    mDevice->waitIdle();
+    // If a FrameContext is used, the old objects are destroyed once the GPU has finished with them.
+    if (!mDevice->getDeletionQueue()->getEnabled()) {
+      mDevice->waitIdle();
+    }
 
     mFramebuffer.reset();
     mRenderPass.reset();
 
-    mRenderPass = createRenderPass();
-    mFramebuffer =
-        std::make_shared<Framebuffer>(mDevice, mRenderPass, mExtent, mFrameBufferAttachmentFormats);
+    if (mDynamicRendering) {
+      if (!mDevice->getPhysicalDevice()->supportsDynamicRendering()) {
+        throw std::runtime_error(
+            "Failed to initialize RenderPass: VK_KHR_dynamic_rendering is not supported!");
+      }
+      if (!mSubPasses.empty()) {
+        throw std::runtime_error(
+            "Failed to initialize RenderPass: Subpasses cannot be used with dynamic rendering!");
+      }
+    } else {
+      mRenderPass = createRenderPass();
+    }
+
+    if (mShadingRateImage) {
+      if (!mDynamicRendering) {
+        throw std::runtime_error("Failed to initialize RenderPass: Shading rate images can only "
+                                 "be used with dynamic rendering!");
+      }
+      if (!mDevice->getPhysicalDevice()->supportsFragmentShadingRate()) {
+        throw std::runtime_error(
+            "Failed to initialize RenderPass: VK_KHR_fragment_shading_rate is not supported!");
+      }
+    }
+
+    if (mViewMask != 0) {
+      if (!mDevice->getPhysicalDevice()->supportsMultiview()) {
+        throw std::runtime_error(
+            "Failed to initialize RenderPass: VK_KHR_multiview is not supported!");
+      }
+      if (mLayerCount != 1) {
+        throw std::runtime_error(
+            "Failed to initialize RenderPass: A view mask cannot be used with several layers!");
+      }
+    }
+
+    std::vector<BackedImagePtr> images;
+    std::vector<bool>                    transient;
+    std::vector<vk::SampleCountFlagBits> samples;
+    for (auto const& attachment : mAttachments) {
+      images.push_back(attachment.mImage);
+      transient.push_back(attachment.mTransient);
+      samples.push_back(attachment.mSamples);
+    }
+
+    // with multiview, the views are the layers of the attachments
+    uint32_t layers = mViewMask != 0 ? getViewCount() : mLayerCount;
+
+    mFramebuffer = std::make_shared<Framebuffer>(mDevice, mRenderPass, mExtent,
+        mFrameBufferAttachmentFormats, images, transient, samples, layers, mViewMask != 0);
 
     mAttachmentsDirty = false;
   }
@@ -51,8 +102,58 @@ void RenderPass::init() {
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////
 
-void RenderPass::addAttachment(vk::Format format) {
-  mFrameBufferAttachmentFormats.push_back(format);
+void RenderPass::addAttachment(vk::Format format, bool transient) {
+  Attachment attachment;
+  attachment.mFormat    = format;
+  attachment.mTransient = transient;
+  addAttachment(attachment);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void RenderPass::addAttachment(Attachment const& attachment) {
+  if (attachment.mTransient && attachment.mLoadOp == vk::AttachmentLoadOp::eLoad) {
+    throw std::runtime_error(
+        "Failed to add attachment: The content of transient attachments cannot be loaded!");
+  }
+
+  mFrameBufferAttachmentFormats.push_back(attachment.mFormat);
+  mAttachments.push_back(attachment);
+
+  if (attachment.mClearValue) {
+    mClearValues.push_back(*attachment.mClearValue);
+  } else if (Utils::isDepthFormat(attachment.mFormat)) {
+    mClearValues.push_back(vk::ClearDepthStencilValue(1.f, 0u));
+  } else {
+    mClearValues.push_back(vk::ClearColorValue(std::array<float, 4>{{0.f, 0.f, 0.f, 0.f}}));
+  }
+
+  mAttachmentsDirty = true;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+std::vector<RenderPass::Attachment> const& RenderPass::getAttachments() const {
+  return mAttachments;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void RenderPass::setClearValue(uint32_t attachment, vk::ClearValue const& value) {
+  mAttachments.at(attachment).mClearValue = value;
+  mClearValues[attachment]                = value;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+std::vector<vk::ClearValue> const& RenderPass::getClearValues() const {
+  return mClearValues;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void RenderPass::addDependency(vk::SubpassDependency const& dependency) {
+  mDependencies.push_back(dependency);
   mAttachmentsDirty = true;
 }
 
@@ -65,6 +166,12 @@ void RenderPass::setSubPasses(std::vector<SubPass> const& subPasses) {
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////
 
+std::vector<RenderPass::SubPass> const& RenderPass::getSubPasses() const {
+  return mSubPasses;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
 void RenderPass::setExtent(glm::uvec2 const& extent) {
   if (mExtent != extent) {
     mExtent           = extent;
@@ -80,6 +187,85 @@ glm::uvec2 const& RenderPass::getExtent() const {
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////
 
+void RenderPass::setLayerCount(uint32_t count) {
+  if (mLayerCount != count) {
+    mLayerCount       = count;
+    mAttachmentsDirty = true;
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+uint32_t RenderPass::getLayerCount() const {
+  return mLayerCount;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void RenderPass::setViewMask(uint32_t mask) {
+  if (mViewMask != mask) {
+    mViewMask         = mask;
+    mAttachmentsDirty = true;
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+uint32_t RenderPass::getViewMask() const {
+  return mViewMask;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+uint32_t RenderPass::getViewCount() const {
+  uint32_t count = 0;
+  while (count < 32 && (mViewMask >> count) != 0) {
+    ++count;
+  }
+  return count;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void RenderPass::setDynamicRendering(bool enable) {
+  if (mDynamicRendering != enable) {
+    mDynamicRendering = enable;
+    mAttachmentsDirty = true;
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+bool RenderPass::getDynamicRendering() const {
+  return mDynamicRendering;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void RenderPass::setShadingRateImage(BackedImagePtr const& image, glm::uvec2 const& texelSize) {
+  // only toggling the image requires new pipelines, the image itself is bound when rendering
+  if (static_cast<bool>(mShadingRateImage) != static_cast<bool>(image)) {
+    mAttachmentsDirty = true;
+  }
+
+  mShadingRateImage     = image;
+  mShadingRateTexelSize = texelSize;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+BackedImagePtr const& RenderPass::getShadingRateImage() const {
+  return mShadingRateImage;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+glm::uvec2 const& RenderPass::getShadingRateTexelSize() const {
+  return mShadingRateTexelSize;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
 FramebufferPtr const& RenderPass::getFramebuffer() const {
   return mFramebuffer;
 }
@@ -92,6 +278,18 @@ vk::RenderPassPtr const& RenderPass::getHandle() const {
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////
 
+void RenderPass::setName(std::string const& name) {
+  mName = name;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+std::string const& RenderPass::getName() const {
+  return mName;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
 bool RenderPass::hasDepthAttachment() const {
   for (auto format : mFrameBufferAttachmentFormats) {
     if (Utils::isDepthFormat(format))
@@ -109,37 +307,84 @@ std::vector<vk::Format> const& RenderPass::getFrameBufferAttachmentFormats() con
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////
 
+std::vector<uint32_t> RenderPass::getColorAttachments() const {
+  std::vector<bool> isResolveAttachment(mAttachments.size(), false);
+  for (auto const& attachment : mAttachments) {
+    if (attachment.mResolveAttachment && *attachment.mResolveAttachment < mAttachments.size()) {
+      isResolveAttachment[*attachment.mResolveAttachment] = true;
+    }
+  }
+
+  std::vector<uint32_t> result;
+  for (uint32_t i(0); i < mAttachments.size(); ++i) {
+    if (!Utils::isDepthFormat(mAttachments[i].mFormat) && !isResolveAttachment[i]) {
+      result.push_back(i);
+    }
+  }
+
+  return result;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+std::optional<uint32_t> RenderPass::getDepthAttachment() const {
+  for (uint32_t i(0); i < mAttachments.size(); ++i) {
+    if (Utils::isDepthFormat(mAttachments[i].mFormat)) {
+      return i;
+    }
+  }
+
+  return std::nullopt;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+vk::SampleCountFlagBits RenderPass::getSampleCount() const {
+  vk::SampleCountFlagBits samples = vk::SampleCountFlagBits::e1;
+  for (auto const& attachment : mAttachments) {
+    samples = std::max(samples, attachment.mSamples);
+  }
+
+  return samples;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
 vk::RenderPassPtr RenderPass::createRenderPass() const {
 
   std::vector<vk::AttachmentDescription> attachments;
   std::vector<vk::AttachmentReference>   attachmentRefs;
   int                                    depthStencilAttachmentRef(-1);
 
-  for (size_t i(0); i < mFrameBufferAttachmentFormats.size(); ++i) {
+  for (size_t i(0); i < mAttachments.size(); ++i) {
     vk::AttachmentDescription attachment;
     vk::AttachmentReference   attachmentRef;
 
-    attachment.format        = mFrameBufferAttachmentFormats[i];
-    attachment.samples       = vk::SampleCountFlagBits::e1;
-    attachment.initialLayout = vk::ImageLayout::eUndefined;
-    attachment.loadOp        = vk::AttachmentLoadOp::eClear;
-    attachment.storeOp       = vk::AttachmentStoreOp::eStore;
+    attachment.format        = mAttachments[i].mFormat;
+    attachment.samples       = mAttachments[i].mSamples;
+    attachment.initialLayout = mAttachments[i].mInitialLayout;
+    attachment.loadOp        = mAttachments[i].mLoadOp;
+    attachment.storeOp       = mAttachments[i].mTransient ? vk::AttachmentStoreOp::eDontCare
+                                                          : mAttachments[i].mStoreOp;
 
     if (Utils::isColorFormat(attachment.format)) {
       attachment.stencilLoadOp  = vk::AttachmentLoadOp::eDontCare;
       attachment.stencilStoreOp = vk::AttachmentStoreOp::eDontCare;
-      attachment.finalLayout    = vk::ImageLayout::eColorAttachmentOptimal;
+      attachmentRef.layout      = vk::ImageLayout::eColorAttachmentOptimal;
     } else if (Utils::isDepthOnlyFormat(attachment.format)) {
       attachment.stencilLoadOp  = vk::AttachmentLoadOp::eDontCare;
       attachment.stencilStoreOp = vk::AttachmentStoreOp::eDontCare;
-      attachment.finalLayout    = vk::ImageLayout::eDepthStencilAttachmentOptimal;
+      attachmentRef.layout      = vk::ImageLayout::eDepthStencilAttachmentOptimal;
     } else {
-      attachment.stencilLoadOp  = vk::AttachmentLoadOp::eClear;
-      attachment.stencilStoreOp = vk::AttachmentStoreOp::eStore;
-      attachment.finalLayout    = vk::ImageLayout::eDepthStencilAttachmentOptimal;
+      attachment.stencilLoadOp  = attachment.loadOp;
+      attachment.stencilStoreOp = attachment.storeOp;
+      attachmentRef.layout      = vk::ImageLayout::eDepthStencilAttachmentOptimal;
     }
 
-    attachmentRef.layout     = attachment.finalLayout;
+    attachment.finalLayout = mAttachments[i].mFinalLayout == vk::ImageLayout::eUndefined
+                                 ? attachmentRef.layout
+                                 : mAttachments[i].mFinalLayout;
+
     attachmentRef.attachment = static_cast<uint32_t>(attachments.size());
 
     attachments.emplace_back(attachment);
@@ -150,12 +395,44 @@ vk::RenderPassPtr RenderPass::createRenderPass() const {
     }
   }
 
+  // multisampled color attachments may be resolved into single-sampled color attachments
+  std::vector<bool> isResolveAttachment(mAttachments.size(), false);
+  bool              hasResolveAttachments = false;
+
+  for (auto const& attachment : mAttachments) {
+    if (attachment.mResolveAttachment) {
+      uint32_t target = *attachment.mResolveAttachment;
+
+      if (target >= mAttachments.size() || attachment.mSamples == vk::SampleCountFlagBits::e1 ||
+          mAttachments[target].mSamples != vk::SampleCountFlagBits::e1 ||
+          !Utils::isColorFormat(attachment.mFormat) ||
+          !Utils::isColorFormat(mAttachments[target].mFormat)) {
+        throw std::runtime_error("Failed to create RenderPass: Only multisampled color "
+                                 "attachments can be resolved into single-sampled ones!");
+      }
+
+      isResolveAttachment[target] = true;
+      hasResolveAttachments       = true;
+    }
+  }
+
+  // returns VK_ATTACHMENT_UNUSED for color attachments which are not resolved
+  auto getResolveAttachmentRef = [&](uint32_t attachment) {
+    auto const& resolve = mAttachments[attachment].mResolveAttachment;
+    if (resolve) {
+      return vk::AttachmentReference(*resolve, vk::ImageLayout::eColorAttachmentOptimal);
+    }
+    return vk::AttachmentReference(VK_ATTACHMENT_UNUSED, vk::ImageLayout::eUndefined);
+  };
+
   // create default subpass if none are specified
   if (mSubPasses.size() == 0) {
     std::vector<vk::AttachmentReference> colorAttachmentRefs;
+    std::vector<vk::AttachmentReference> resolveAttachmentRefs;
     for (size_t i(0); i < attachmentRefs.size(); ++i) {
-      if ((int)i != depthStencilAttachmentRef) {
+      if ((int)i != depthStencilAttachmentRef && !isResolveAttachment[i]) {
         colorAttachmentRefs.push_back(attachmentRefs[i]);
+        resolveAttachmentRefs.push_back(getResolveAttachmentRef(static_cast<uint32_t>(i)));
       }
     }
 
@@ -164,6 +441,10 @@ vk::RenderPassPtr RenderPass::createRenderPass() const {
     subPass.colorAttachmentCount = static_cast<uint32_t>(colorAttachmentRefs.size());
     subPass.pColorAttachments    = colorAttachmentRefs.data();
 
+    if (hasResolveAttachments) {
+      subPass.pResolveAttachments = resolveAttachmentRefs.data();
+    }
+
     if (depthStencilAttachmentRef >= 0) {
       subPass.pDepthStencilAttachment = &attachmentRefs[depthStencilAttachmentRef];
     }
@@ -173,6 +454,17 @@ vk::RenderPassPtr RenderPass::createRenderPass() const {
     info.pAttachments    = attachments.data();
     info.subpassCount    = 1;
     info.pSubpasses      = &subPass;
+    info.dependencyCount = static_cast<uint32_t>(mDependencies.size());
+    info.pDependencies   = mDependencies.data();
+
+    vk::RenderPassMultiviewCreateInfoKHR multiviewInfo;
+    if (mViewMask != 0) {
+      multiviewInfo.subpassCount         = 1;
+      multiviewInfo.pViewMasks           = &mViewMask;
+      multiviewInfo.correlationMaskCount = 1;
+      multiviewInfo.pCorrelationMasks    = &mViewMask;
+      info.pNext                         = &multiviewInfo;
+    }
 
     return mDevice->createRenderPass(info);
   }
@@ -180,11 +472,14 @@ vk::RenderPassPtr RenderPass::createRenderPass() const {
   std::vector<vk::SubpassDescription>               subPasses(mSubPasses.size());
   std::vector<std::vector<vk::AttachmentReference>> inputAttachmentRefs(mSubPasses.size());
   std::vector<std::vector<vk::AttachmentReference>> outputAttachmentRefs(mSubPasses.size());
+  std::vector<std::vector<vk::AttachmentReference>> resolveAttachmentRefs(mSubPasses.size());
 
   for (size_t i(0); i < mSubPasses.size(); ++i) {
 
+    // input attachments are read in the fragment shader
     for (uint32_t attachment : mSubPasses[i].mInputAttachments) {
-      inputAttachmentRefs[i].push_back(attachmentRefs[attachment]);
+      inputAttachmentRefs[i].push_back(
+          {attachmentRefs[attachment].attachment, vk::ImageLayout::eShaderReadOnlyOptimal});
     }
 
     for (auto attachment : mSubPasses[i].mOutputAttachments) {
@@ -192,6 +487,7 @@ vk::RenderPassPtr RenderPass::createRenderPass() const {
         subPasses[i].pDepthStencilAttachment = &attachmentRefs[depthStencilAttachmentRef];
       } else {
         outputAttachmentRefs[i].push_back(attachmentRefs[attachment]);
+        resolveAttachmentRefs[i].push_back(getResolveAttachmentRef(attachment));
       }
     }
 
@@ -200,9 +496,17 @@ vk::RenderPassPtr RenderPass::createRenderPass() const {
     subPasses[i].pInputAttachments    = inputAttachmentRefs[i].data();
     subPasses[i].colorAttachmentCount = static_cast<uint32_t>(outputAttachmentRefs[i].size());
     subPasses[i].pColorAttachments    = outputAttachmentRefs[i].data();
+
+    if (hasResolveAttachments) {
+      subPasses[i].pResolveAttachments = resolveAttachmentRefs[i].data();
+    }
+
+    subPasses[i].preserveAttachmentCount =
+        static_cast<uint32_t>(mSubPasses[i].mPreserveAttachments.size());
+    subPasses[i].pPreserveAttachments = mSubPasses[i].mPreserveAttachments.data();
   }
 
-  std::vector<vk::SubpassDependency> dependencies;
+  std::vector<vk::SubpassDependency> dependencies(mDependencies);
   for (size_t dst(0); dst < mSubPasses.size(); ++dst) {
     for (auto src : mSubPasses[dst].mPreSubPasses) {
       vk::SubpassDependency dependency;
@@ -225,6 +529,18 @@ vk::RenderPassPtr RenderPass::createRenderPass() const {
   info.dependencyCount = static_cast<uint32_t>(dependencies.size());
   info.pDependencies   = dependencies.data();
 
+  // all subpasses render all views; the views are rendered with similar cameras, so implementations
+  // may share work between them as indicated by the correlation mask
+  std::vector<uint32_t>                viewMasks(mSubPasses.size(), mViewMask);
+  vk::RenderPassMultiviewCreateInfoKHR multiviewInfo;
+  if (mViewMask != 0) {
+    multiviewInfo.subpassCount         = static_cast<uint32_t>(viewMasks.size());
+    multiviewInfo.pViewMasks           = viewMasks.data();
+    multiviewInfo.correlationMaskCount = 1;
+    multiviewInfo.pCorrelationMasks    = &mViewMask;
+    info.pNext                         = &multiviewInfo;
+  }
+
   return mDevice->createRenderPass(info);
 }
 
@@ -14,6 +14,8 @@
 
 #include <functional>
 #include <glm/glm.hpp>
+#include <optional>
+#include <string>
 #include <unordered_map>
 
 namespace Illusion::Graphics {
@@ -28,6 +30,39 @@ class RenderPass {
     std::vector<uint32_t> mPreSubPasses;
     std::vector<uint32_t> mInputAttachments;
     std::vector<uint32_t> mOutputAttachments;
+
+    // Attachments which are not used by this subpass but whose content is required by a later one.
+    std::vector<uint32_t> mPreserveAttachments;
+  };
+
+  // If mImage is set, the Framebuffer will use it instead of creating a new image. It has to match
+  // mFormat and the extent of the RenderPass. If mFinalLayout is eUndefined, the attachment stays
+  // in eColorAttachmentOptimal or eDepthStencilAttachmentOptimal respectively.
+  // Set mTransient for attachments whose content is only needed inside the RenderPass, such as most
+  // depth buffers. The Framebuffer creates them with eTransientAttachment usage in lazily allocated
+  // memory if available, so tiled GPUs may keep them in on-chip memory only. Their content is never
+  // stored and cannot be loaded, hence mStoreOp is ignored and mLoadOp must not be eLoad.
+  // Use eDontCare as mLoadOp if each pixel is overwritten anyway (for example by a skybox) and as
+  // mStoreOp if the content is not needed afterwards; this saves a lot of memory bandwidth. The
+  // mClearValue is only used with eClear. If it is not set, color attachments are cleared to
+  // transparent black and depth attachments to a depth of one and a stencil value of zero.
+  // Attachments with more than one sample can be used for multisample anti-aliasing. If
+  // mResolveAttachment is set for a multisampled color attachment, it is resolved into the
+  // single-sampled color attachment with this index at the end of each subpass which writes it.
+  // This happens in the RenderPass, so on tiled GPUs the samples never leave on-chip memory if the
+  // multisampled attachment is transient. The resolve attachment is not written by the subpasses
+  // directly; its mLoadOp can be eDontCare. Depth attachments cannot be resolved.
+  struct Attachment {
+    vk::Format                    mFormat        = vk::Format::eUndefined;
+    BackedImagePtr                mImage         = nullptr;
+    vk::AttachmentLoadOp          mLoadOp        = vk::AttachmentLoadOp::eClear;
+    vk::AttachmentStoreOp         mStoreOp       = vk::AttachmentStoreOp::eStore;
+    vk::ImageLayout               mInitialLayout = vk::ImageLayout::eUndefined;
+    vk::ImageLayout               mFinalLayout   = vk::ImageLayout::eUndefined;
+    bool                          mTransient     = false;
+    std::optional<vk::ClearValue> mClearValue;
+    vk::SampleCountFlagBits       mSamples = vk::SampleCountFlagBits::e1;
+    std::optional<uint32_t>       mResolveAttachment;
   };
 
   // Syntactic sugar to create a std::shared_ptr for this class
@@ -41,28 +76,107 @@ class RenderPass {
 
   void init();
 
-  void                           addAttachment(vk::Format format);
+  // The first version adds an Attachment with default values. The second throws a
+  // std::runtime_error if a transient attachment should be loaded.
+  void                           addAttachment(vk::Format format, bool transient = false);
+  void                           addAttachment(Attachment const& attachment);
+  std::vector<Attachment> const& getAttachments() const;
   bool                           hasDepthAttachment() const;
   std::vector<vk::Format> const& getFrameBufferAttachmentFormats() const;
 
-  void setSubPasses(std::vector<SubPass> const& subPasses);
+  // The attachments which are written by the default subpass: all color attachments which are not
+  // the resolve attachment of another one, and the depth attachment (if any).
+  std::vector<uint32_t>   getColorAttachments() const;
+  std::optional<uint32_t> getDepthAttachment() const;
+
+  // The highest sample count of all attachments. The rasterization samples of the GraphicsState
+  // have to match the samples of the attachments written by a subpass.
+  vk::SampleCountFlagBits getSampleCount() const;
+
+  // The clear value of an attachment can be changed at any time, this does not require a new
+  // vk::RenderPass. getClearValues() contains one value for each attachment, it is used by
+  // CommandBuffer::beginRenderPass().
+  void setClearValue(uint32_t attachment, vk::ClearValue const& value);
+  std::vector<vk::ClearValue> const& getClearValues() const;
+
+  // Additional dependencies, for example from or to VK_SUBPASS_EXTERNAL. The dependencies given by
+  // the mPreSubPasses of the SubPasses are created automatically.
+  void addDependency(vk::SubpassDependency const& dependency);
+
+  void                        setSubPasses(std::vector<SubPass> const& subPasses);
+  std::vector<SubPass> const& getSubPasses() const;
 
   void              setExtent(glm::uvec2 const& extent);
   glm::uvec2 const& getExtent() const;
 
+  // With more than one layer, all attachments are layered and a geometry shader can select the
+  // layer it renders to with gl_Layer. This can be used to render several views, for example the
+  // cascades of a shadow map, in a single pass. The default is one layer.
+  void     setLayerCount(uint32_t count);
+  uint32_t getLayerCount() const;
+
+  // With a view mask other than zero, the RenderPass uses VK_KHR_multiview: each draw is broadcast
+  // to all views whose bit is set and the shaders can read the current view from gl_ViewIndex, for
+  // example to select the camera of the left or right eye. The attachments get one layer per view
+  // up to the highest bit set, all of them are rendered from a single command stream. This requires
+  // PhysicalDevice::supportsMultiview() and cannot be combined with setLayerCount(). The default
+  // is zero, which disables multiview.
+  void     setViewMask(uint32_t mask);
+  uint32_t getViewMask() const;
+
+  // The number of layers required for the view mask, this is zero if multiview is disabled.
+  uint32_t getViewCount() const;
+
+  // If enabled, no vk::RenderPass and no vk::Framebuffer are created. Instead, the CommandBuffer
+  // uses VK_KHR_dynamic_rendering with the image views of the attachments; their layouts are
+  // transitioned with barriers before and after. The pipelines only depend on the formats of the
+  // attachments, so RenderPasses with equal formats share them. This requires
+  // PhysicalDevice::supportsDynamicRendering(); subpasses and input attachments are not available
+  // in this mode. Resolve attachments use the average of the samples, hence integer formats
+  // cannot be resolved.
+  void setDynamicRendering(bool enable);
+  bool getDynamicRendering() const;
+
+  // In dynamic rendering mode, an image with vk::Format::eR8Uint and
+  // vk::ImageUsageFlagBits::eFragmentShadingRateAttachmentKHR can be used to shade regions of the
+  // attachments at a coarser rate. Each of its texels covers texelSize pixels and contains the
+  // shading rate of this region as (log2(width) << 2 | log2(height)), e.g. 5 for 2x2 pixels. The
+  // texelSize has to be in the range given by PhysicalDevice::getFragmentShadingRateProperties()
+  // and the image has to cover the extent of the RenderPass. All pipelines use the rate of the
+  // image then. The image is transitioned to eFragmentShadingRateAttachmentOptimalKHR by
+  // CommandBuffer::beginRenderPass(). This requires PhysicalDevice::supportsFragmentShadingRate().
+  // Pass nullptr to disable it again, which is the default.
+  void setShadingRateImage(BackedImagePtr const& image, glm::uvec2 const& texelSize);
+  BackedImagePtr const& getShadingRateImage() const;
+  glm::uvec2 const&     getShadingRateTexelSize() const;
+
+  // In dynamic rendering mode, the vk::RenderPass is nullptr and the Framebuffer has no handle.
   FramebufferPtr const&    getFramebuffer() const;
   vk::RenderPassPtr const& getHandle() const;
 
+  // The name is used to identify the RenderPass in the results of the PassStatistics.
+  void               setName(std::string const& name);
+  std::string const& getName() const;
+
  private:
   vk::RenderPassPtr createRenderPass() const;
 
-  DevicePtr               mDevice;
-  vk::RenderPassPtr       mRenderPass;
-  FramebufferPtr          mFramebuffer;
-  std::vector<vk::Format> mFrameBufferAttachmentFormats;
-  std::vector<SubPass>    mSubPasses;
-  bool                    mAttachmentsDirty = true;
-  glm::uvec2              mExtent           = {100, 100};
+  DevicePtr                          mDevice;
+  vk::RenderPassPtr                  mRenderPass;
+  FramebufferPtr                     mFramebuffer;
+  BackedImagePtr                     mShadingRateImage;
+  glm::uvec2                         mShadingRateTexelSize = {1, 1};
+  std::vector<vk::Format>            mFrameBufferAttachmentFormats;
+  std::vector<Attachment>            mAttachments;
+  std::vector<vk::ClearValue>        mClearValues;
+  std::vector<SubPass>               mSubPasses;
+  std::vector<vk::SubpassDependency> mDependencies;
+  bool                               mAttachmentsDirty = true;
+  bool                               mDynamicRendering = false;
+  glm::uvec2                         mExtent           = {100, 100};
+  uint32_t                           mLayerCount       = 1;
+  uint32_t                           mViewMask         = 0;
+  std::string                        mName             = "RenderPass";
 };
 
 } // namespace Illusion::Graphics
@@ -0,0 +1,135 @@
+////////////////////////////////////////////////////////////////////////////////////////////////////
+//                                                                                                //
+//    _)  |  |            _)                This code may be used and modified under the terms    //
+//     |  |  |  |  | (_-<  |   _ \    \     of the MIT license. See the LICENSE file for details. //
+//    _| _| _| \_,_| ___/ _| \___/ _| _|    Copyright (c) 2018-2019 Simon Schneegans              //
+//                                                                                                //
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include "RenderQueue.hpp"
+
+#include <array>
+#include <cstring>
+#include <utility>
+
+namespace Illusion::Graphics {
+
+namespace {
+
+// Non-negative floats keep their order when their bit patterns are compared as integers. As the
+// sign bit is zero, the result has 31 bits.
+uint32_t getDepthBits(float depth) {
+  if (!(depth > 0.f)) {
+    return 0;
+  }
+
+  uint32_t bits;
+  std::memcpy(&bits, &depth, sizeof(float));
+  return bits;
+}
+
+} // namespace
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+RenderQueue::RenderQueue() {
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+RenderQueue::~RenderQueue() {
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+uint64_t RenderQueue::getSortKey(Packet const& packet) {
+  uint64_t depth    = getDepthBits(packet.mDepth);
+  uint64_t pipeline = packet.mPipelineKey;
+  uint64_t material = packet.mMaterialKey;
+
+  // transparent: 1 | 31 bits inverted depth | 32 bits zero
+  // The stable sort keeps Packets at the same depth in insertion order; sorting them by state would
+  // change the result of blending.
+  if (packet.mTransparent) {
+    return (1ull << 63) | ((0x7fffffffull - depth) << 32);
+  }
+
+  // opaque:      0 | 16 bits pipeline | 16 bits material | 31 bits depth
+  return (pipeline << 47) | (material << 31) | depth;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void RenderQueue::add(Packet const& packet) {
+  mEntries.push_back({getSortKey(packet), static_cast<uint32_t>(mPackets.size())});
+  mPackets.push_back(packet);
+  mSorted = false;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void RenderQueue::sort() {
+  if (mSorted) {
+    return;
+  }
+
+  mScratch.resize(mEntries.size());
+
+  // least significant digit first radix sort with eight passes of eight bits each
+  for (uint32_t shift = 0; shift < 64; shift += 8) {
+    std::array<uint32_t, 256> offsets{};
+
+    for (auto const& entry : mEntries) {
+      ++offsets[(entry.mKey >> shift) & 0xff];
+    }
+
+    // if all keys share this digit, the pass would not change the order
+    if (offsets[(mEntries.front().mKey >> shift) & 0xff] == mEntries.size()) {
+      continue;
+    }
+
+    uint32_t offset = 0;
+    for (auto& count : offsets) {
+      std::swap(count, offset);
+      offset += count;
+    }
+
+    for (auto const& entry : mEntries) {
+      mScratch[offsets[(entry.mKey >> shift) & 0xff]++] = entry;
+    }
+
+    std::swap(mEntries, mScratch);
+  }
+
+  mSorted = true;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void RenderQueue::replay(CommandBuffer& cmd,
+    std::function<void(CommandBuffer& cmd, Packet const& packet)> const& record) {
+
+  sort();
+
+  for (auto const& entry : mEntries) {
+    record(cmd, mPackets[entry.mPacket]);
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void RenderQueue::clear() {
+  mPackets.clear();
+  mEntries.clear();
+  mSorted = true;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+uint32_t RenderQueue::getPacketCount() const {
+  return static_cast<uint32_t>(mPackets.size());
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+} // namespace Illusion::Graphics
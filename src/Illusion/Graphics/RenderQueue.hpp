@@ -0,0 +1,89 @@
+////////////////////////////////////////////////////////////////////////////////////////////////////
+//                                                                                                //
+//    _)  |  |            _)                This code may be used and modified under the terms    //
+//     |  |  |  |  | (_-<  |   _ \    \     of the MIT license. See the LICENSE file for details. //
+//    _| _| _| \_,_| ___/ _| \___/ _| _|    Copyright (c) 2018-2019 Simon Schneegans              //
+//                                                                                                //
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#ifndef ILLUSION_GRAPHICS_RENDER_QUEUE_HPP
+#define ILLUSION_GRAPHICS_RENDER_QUEUE_HPP
+
+#include "fwd.hpp"
+
+#include <functional>
+#include <vector>
+
+namespace Illusion::Graphics {
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// The RenderQueue collects draw Packets and records them in an order which minimizes state       //
+// changes. Each Packet is reduced to a 64-bit sort key: opaque Packets come first and are sorted //
+// by their pipeline key, then by their material key and finally front-to-back by their depth, so //
+// that the depth test rejects as many fragments as possible. Transparent Packets follow and are  //
+// sorted back-to-front by their depth only, as required for correct blending. The keys are       //
+// sorted with a stable radix sort, hence Packets with equal keys (for example transparent        //
+// Packets at the same depth) keep the order in which they were added. As the CommandBuffer skips //
+// redundant state changes, the callback given to replay() can simply set the full state of each  //
+// Packet. All methods have to be called by the same thread.                                      //
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+class RenderQueue {
+
+ public:
+  // mPipelineKey should identify the Shader and the GraphicsState of the draw, mMaterialKey its
+  // descriptor sets. Both are application defined. mDepth is the distance to the camera, negative
+  // values are treated as zero. mUserData is not used for sorting, it can be used by the replay()
+  // callback to find the draw, for example as an index.
+  struct Packet {
+    uint16_t mPipelineKey = 0;
+    uint16_t mMaterialKey = 0;
+    float    mDepth       = 0.f;
+    bool     mTransparent = false;
+    uint32_t mUserData    = 0;
+  };
+
+  // Syntactic sugar to create a std::shared_ptr for this class
+  template <typename... Args>
+  static RenderQueuePtr create(Args&&... args) {
+    return std::make_shared<RenderQueue>(args...);
+  };
+
+  RenderQueue();
+  virtual ~RenderQueue();
+
+  // Returns the 64-bit key which is used to sort the given Packet.
+  static uint64_t getSortKey(Packet const& packet);
+
+  // Adds a Packet to the queue.
+  void add(Packet const& packet);
+
+  // Sorts the Packets. This is done by replay() if required, but it can be called before in order
+  // to measure the time.
+  void sort();
+
+  // Calls the given function for each Packet in sorted order. It should set up the state for the
+  // Packet and record its draw call to the given CommandBuffer.
+  void replay(CommandBuffer& cmd,
+      std::function<void(CommandBuffer& cmd, Packet const& packet)> const& record);
+
+  // Removes all Packets; the allocated memory is kept for the next frame.
+  void clear();
+
+  uint32_t getPacketCount() const;
+
+ private:
+  struct Entry {
+    uint64_t mKey;
+    uint32_t mPacket;
+  };
+
+  std::vector<Packet> mPackets;
+  std::vector<Entry>  mEntries;
+  std::vector<Entry>  mScratch;
+  bool                mSorted = true;
+};
+
+} // namespace Illusion::Graphics
+
+#endif // ILLUSION_GRAPHICS_RENDER_QUEUE_HPP
@@ -0,0 +1,134 @@
+////////////////////////////////////////////////////////////////////////////////////////////////////
+//                                                                                                //
+//    _)  |  |            _)                This code may be used and modified under the terms    //
+//     |  |  |  |  | (_-<  |   _ \    \     of the MIT license. See the LICENSE file for details. //
+//    _| _| _| \_,_| ___/ _| \___/ _| _|    Copyright (c) 2018-2019 Simon Schneegans              //
+//                                                                                                //
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include "RenderTargetPool.hpp"
+
+#include "../Core/Logger.hpp"
+#include "BackedImage.hpp"
+#include "DeletionQueue.hpp"
+#include "Device.hpp"
+
+#include <iostream>
+
+namespace Illusion::Graphics {
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+RenderTargetPool::RenderTargetPool(Device const* device)
+    : mDevice(device) {
+
+  ILLUSION_TRACE << "Creating RenderTargetPool." << std::endl;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+RenderTargetPool::~RenderTargetPool() {
+  ILLUSION_TRACE << "Deleting RenderTargetPool." << std::endl;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+BackedImagePtr RenderTargetPool::acquire(vk::ImageCreateInfo const& info,
+    vk::ImageAspectFlags aspect, vk::MemoryPropertyFlags properties, vk::ImageLayout layout) {
+
+  if (info.imageType != vk::ImageType::e2D || info.mipLevels != 1 || info.arrayLayers != 1) {
+    throw std::runtime_error(
+        "Failed to acquire render target: Only 2D images with one level and layer are pooled!");
+  }
+
+  Key key(info.format, info.extent.width, info.extent.height,
+      static_cast<vk::ImageUsageFlags::MaskType>(info.usage), info.samples,
+      static_cast<vk::ImageAspectFlags::MaskType>(aspect),
+      static_cast<vk::MemoryPropertyFlags::MaskType>(properties));
+
+  std::unique_lock<std::mutex> lock(mMutex);
+
+  // Images which are still referenced elsewhere are skipped.
+  auto range = mFreeImages.equal_range(key);
+  for (auto it = range.first; it != range.second; ++it) {
+    if (it->second.mImage.use_count() == 1) {
+      auto image = it->second.mImage;
+      mFreeImages.erase(it);
+      mKeys[image.get()] = key;
+      return image;
+    }
+  }
+
+  lock.unlock();
+
+  auto image = mDevice->createBackedImage(info, vk::ImageViewType::e2D, aspect, properties, layout);
+
+  lock.lock();
+  mKeys[image.get()] = key;
+
+  return image;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void RenderTargetPool::release(BackedImagePtr const& image) {
+  Key key;
+
+  {
+    std::lock_guard<std::mutex> lock(mMutex);
+
+    auto it = mKeys.find(image.get());
+    if (it == mKeys.end()) {
+      throw std::runtime_error(
+          "Failed to release render target: The image has not been acquired from this pool!");
+    }
+
+    key = it->second;
+    mKeys.erase(it);
+  }
+
+  // The image may still be used by the GPU in the current frame.
+  std::weak_ptr<RenderTargetPool> weakThis(shared_from_this());
+
+  mDevice->getDeletionQueue()->push([weakThis, image, key]() {
+    auto self = weakThis.lock();
+    if (self) {
+      std::lock_guard<std::mutex> lock(self->mMutex);
+      self->mFreeImages.emplace(key, FreeImage{image, self->mFrameIndex});
+    }
+  });
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void RenderTargetPool::beginFrame(uint32_t maxUnusedFrames) {
+  std::lock_guard<std::mutex> lock(mMutex);
+
+  ++mFrameIndex;
+
+  for (auto it = mFreeImages.begin(); it != mFreeImages.end();) {
+    if (it->second.mReleaseFrame + maxUnusedFrames < mFrameIndex) {
+      it = mFreeImages.erase(it);
+    } else {
+      ++it;
+    }
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void RenderTargetPool::clear() {
+  std::lock_guard<std::mutex> lock(mMutex);
+  mFreeImages.clear();
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+uint32_t RenderTargetPool::getFreeCount() const {
+  std::lock_guard<std::mutex> lock(mMutex);
+  return static_cast<uint32_t>(mFreeImages.size());
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+} // namespace Illusion::Graphics
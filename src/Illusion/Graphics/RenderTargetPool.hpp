@@ -0,0 +1,89 @@
+////////////////////////////////////////////////////////////////////////////////////////////////////
+//                                                                                                //
+//    _)  |  |            _)                This code may be used and modified under the terms    //
+//     |  |  |  |  | (_-<  |   _ \    \     of the MIT license. See the LICENSE file for details. //
+//    _| _| _| \_,_| ___/ _| \___/ _| _|    Copyright (c) 2018-2019 Simon Schneegans              //
+//                                                                                                //
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#ifndef ILLUSION_GRAPHICS_RENDER_TARGET_POOL_HPP
+#define ILLUSION_GRAPHICS_RENDER_TARGET_POOL_HPP
+
+#include "fwd.hpp"
+
+#include <map>
+#include <mutex>
+#include <tuple>
+
+namespace Illusion::Graphics {
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// The RenderTargetPool recycles the BackedImages of Framebuffers. Images are keyed by their      //
+// format, extent, usage, sample count, aspect and memory properties. When a Framebuffer is       //
+// destroyed (for example because the extent of its RenderPass changed), its images are released  //
+// to the pool; once the GPU has finished the current frame, they can be acquired again by any    //
+// Framebuffer with matching attachments. This way resizing back and forth or recreating          //
+// RenderPasses does not allocate new memory each time.                                           //
+// Free images which have not been acquired during the last few frames are destroyed by           //
+// beginFrame(), so the images of old extents do not increase the peak memory usage for long. The //
+// content of an acquired image is undefined. All methods are thread-safe.                        //
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+class RenderTargetPool : public std::enable_shared_from_this<RenderTargetPool> {
+
+ public:
+  // Syntactic sugar to create a std::shared_ptr for this class
+  template <typename... Args>
+  static RenderTargetPoolPtr create(Args&&... args) {
+    return std::make_shared<RenderTargetPool>(args...);
+  };
+
+  // The RenderTargetPool is owned by the given Device, hence it only stores a raw pointer to it.
+  explicit RenderTargetPool(Device const* device);
+  virtual ~RenderTargetPool();
+
+  // Returns a free image which matches the given arguments or creates a new one with
+  // Device::createBackedImage(). Only two-dimensional images with one mipmap level and one layer
+  // are pooled.
+  BackedImagePtr acquire(vk::ImageCreateInfo const& info, vk::ImageAspectFlags aspect,
+      vk::MemoryPropertyFlags properties, vk::ImageLayout layout);
+
+  // Returns an image which has been created by acquire() to the pool. It becomes available again
+  // once the GPU has processed the current frame, see DeletionQueue. The image must not be used
+  // afterwards; if references to it are kept elsewhere, it is not acquired again until these are
+  // gone. If the pool is destroyed before, the image is simply destroyed. The pool must be owned by
+  // a std::shared_ptr.
+  void release(BackedImagePtr const& image);
+
+  // This is called by the FrameContext once per frame. Free images which have not been acquired
+  // during the given number of frames are destroyed.
+  void beginFrame(uint32_t maxUnusedFrames = 3);
+
+  // Destroys all free images.
+  void clear();
+
+  // The number of images which are currently free.
+  uint32_t getFreeCount() const;
+
+ private:
+  typedef std::tuple<vk::Format, uint32_t, uint32_t, vk::ImageUsageFlags::MaskType,
+      vk::SampleCountFlagBits, vk::ImageAspectFlags::MaskType, vk::MemoryPropertyFlags::MaskType>
+      Key;
+
+  struct FreeImage {
+    BackedImagePtr mImage;
+    uint64_t       mReleaseFrame;
+  };
+
+  Device const* mDevice;
+
+  // The keys of the images which are currently acquired.
+  std::multimap<Key, FreeImage>     mFreeImages;
+  std::map<BackedImage const*, Key> mKeys;
+  uint64_t                          mFrameIndex = 0;
+  mutable std::mutex                mMutex;
+};
+
+} // namespace Illusion::Graphics
+
+#endif // ILLUSION_GRAPHICS_RENDER_TARGET_POOL_HPP
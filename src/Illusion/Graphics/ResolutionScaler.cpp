@@ -0,0 +1,123 @@
+////////////////////////////////////////////////////////////////////////////////////////////////////
+//                                                                                                //
+//    _)  |  |            _)                This code may be used and modified under the terms    //
+//     |  |  |  |  | (_-<  |   _ \    \     of the MIT license. See the LICENSE file for details. //
+//    _| _| _| \_,_| ___/ _| \___/ _| _|    Copyright (c) 2018-2019 Simon Schneegans              //
+//                                                                                                //
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include "ResolutionScaler.hpp"
+
+#include "../Core/Logger.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+
+namespace Illusion::Graphics {
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+ResolutionScaler::ResolutionScaler(float targetTime, float minScale, float step)
+    : mTargetTime(targetTime)
+    , mMinScale(std::clamp(minScale, 0.f, 1.f))
+    , mStep(std::max(step, 0.01f)) {
+
+  ILLUSION_TRACE << "Creating ResolutionScaler." << std::endl;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+ResolutionScaler::~ResolutionScaler() {
+  ILLUSION_TRACE << "Deleting ResolutionScaler." << std::endl;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+bool ResolutionScaler::addGpuTime(double milliseconds) {
+
+  // the first frame after a change initializes the average
+  mAverageTime = mFrames == 0 ? milliseconds : mAverageTime * 0.9 + milliseconds * 0.1;
+
+  if (++mFrames < mCoolDown) {
+    return false;
+  }
+
+  float oldScale = mScale;
+
+  if (mAverageTime > mTargetTime) {
+    // the GPU time is roughly proportional to the number of pixels, so the scale of each axis is
+    // reduced by the square root of the ratio; this is rounded down to the next step
+    float scale = mScale * static_cast<float>(std::sqrt(mTargetTime / mAverageTime));
+    setScale(std::floor(scale / mStep) * mStep);
+  } else if (mAverageTime < mTargetTime * mHeadroom) {
+    setScale(mScale + mStep);
+  }
+
+  if (mScale == oldScale) {
+    return false;
+  }
+
+  mFrames = 0;
+  return true;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void ResolutionScaler::setHeadroom(float headroom) {
+  mHeadroom = headroom;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+float ResolutionScaler::getHeadroom() const {
+  return mHeadroom;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void ResolutionScaler::setCoolDown(uint32_t frames) {
+  mCoolDown = frames;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+uint32_t ResolutionScaler::getCoolDown() const {
+  return mCoolDown;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void ResolutionScaler::setTargetTime(float milliseconds) {
+  mTargetTime = milliseconds;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+float ResolutionScaler::getTargetTime() const {
+  return mTargetTime;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+float ResolutionScaler::getScale() const {
+  return mScale;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+glm::uvec2 ResolutionScaler::getExtent(glm::uvec2 const& extent) const {
+  return glm::max(glm::uvec2(glm::round(glm::vec2(extent) * mScale)), glm::uvec2(1));
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void ResolutionScaler::setScale(float scale) {
+  // the steps are rounded to avoid accumulating floating point errors
+  scale  = std::round(scale / mStep) * mStep;
+  mScale = std::clamp(scale, mMinScale, 1.f);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+} // namespace Illusion::Graphics
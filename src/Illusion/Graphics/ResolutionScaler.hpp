@@ -0,0 +1,79 @@
+////////////////////////////////////////////////////////////////////////////////////////////////////
+//                                                                                                //
+//    _)  |  |            _)                This code may be used and modified under the terms    //
+//     |  |  |  |  | (_-<  |   _ \    \     of the MIT license. See the LICENSE file for details. //
+//    _| _| _| \_,_| ___/ _| \___/ _| _|    Copyright (c) 2018-2019 Simon Schneegans              //
+//                                                                                                //
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#ifndef ILLUSION_GRAPHICS_RESOLUTION_SCALER_HPP
+#define ILLUSION_GRAPHICS_RESOLUTION_SCALER_HPP
+
+#include "fwd.hpp"
+
+#include <glm/glm.hpp>
+
+namespace Illusion::Graphics {
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// The ResolutionScaler implements dynamic resolution scaling: it chooses a scale for the extent  //
+// of the offscreen RenderPasses so that the GPU time of a frame stays below a given target. The  //
+// GPU times are smoothed with an exponential moving average. If this exceeds the target, the     //
+// scale is reduced at once, assuming that the GPU time is proportional to the number of pixels.  //
+// If there is plenty of headroom, it is increased by one step. The scale is a multiple of the    //
+// step size and it is changed at most once per cool-down period, so that the attachments of the  //
+// RenderPasses are not re-created every frame. Swapchain::present() upscales the smaller images  //
+// with a linear filter.                                                                          //
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+class ResolutionScaler {
+
+ public:
+  // Syntactic sugar to create a std::shared_ptr for this class
+  template <typename... Args>
+  static ResolutionScalerPtr create(Args&&... args) {
+    return std::make_shared<ResolutionScaler>(args...);
+  };
+
+  // The targetTime is given in milliseconds. The scale is always in [minScale, 1].
+  explicit ResolutionScaler(float targetTime = 14.f, float minScale = 0.5f, float step = 0.05f);
+  virtual ~ResolutionScaler();
+
+  // Adds the GPU time of a frame in milliseconds. This should be a frame which has been rendered
+  // with the current scale. Returns true if the scale has been changed.
+  bool addGpuTime(double milliseconds);
+
+  // The scale is only increased if the average GPU time is below this fraction of the target time.
+  // The default is 0.75.
+  void  setHeadroom(float headroom);
+  float getHeadroom() const;
+
+  // The number of frames after a change of the scale during which the scale is not changed again.
+  // The default is 30.
+  void     setCoolDown(uint32_t frames);
+  uint32_t getCoolDown() const;
+
+  void  setTargetTime(float milliseconds);
+  float getTargetTime() const;
+
+  float getScale() const;
+
+  // Returns the given extent multiplied with the current scale; this is at least one pixel.
+  glm::uvec2 getExtent(glm::uvec2 const& extent) const;
+
+ private:
+  void setScale(float scale);
+
+  float    mTargetTime;
+  float    mMinScale;
+  float    mStep;
+  float    mHeadroom    = 0.75f;
+  uint32_t mCoolDown    = 30;
+  float    mScale       = 1.f;
+  double   mAverageTime = 0.0;
+  uint32_t mFrames      = 0;
+};
+
+} // namespace Illusion::Graphics
+
+#endif // ILLUSION_GRAPHICS_RESOLUTION_SCALER_HPP
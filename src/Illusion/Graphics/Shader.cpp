@@ -10,11 +10,17 @@
 
 #include "../Core/File.hpp"
 #include "../Core/Logger.hpp"
+#include "../Core/ThreadPool.hpp"
 #include "Device.hpp"
 #include "PipelineReflection.hpp"
 #include "ShaderModule.hpp"
 #include "Window.hpp"
 
+#include <atomic>
+#include <chrono>
+#include <exception>
+#include <functional>
+#include <mutex>
 #include <spirv_glsl.hpp>
 
 namespace Illusion::Graphics {
@@ -24,20 +30,75 @@ const std::unordered_map<std::string, vk::ShaderStageFlagBits> glslExtensionMapp
     {".frag", vk::ShaderStageFlagBits::eFragment}, {".vert", vk::ShaderStageFlagBits::eVertex},
     {".geom", vk::ShaderStageFlagBits::eGeometry}, {".comp", vk::ShaderStageFlagBits::eCompute},
     {".tesc", vk::ShaderStageFlagBits::eTessellationControl},
-    {".tese", vk::ShaderStageFlagBits::eTessellationEvaluation}};
+    {".tese", vk::ShaderStageFlagBits::eTessellationEvaluation},
+    {".task", vk::ShaderStageFlagBits::eTaskEXT}, {".mesh", vk::ShaderStageFlagBits::eMeshEXT}};
 
 const std::unordered_map<std::string, vk::ShaderStageFlagBits> hlslExtensionMapping = {
     {".ps", vk::ShaderStageFlagBits::eFragment}, {".vs", vk::ShaderStageFlagBits::eVertex},
     {".gs", vk::ShaderStageFlagBits::eGeometry}, {".cs", vk::ShaderStageFlagBits::eCompute},
     {".hs", vk::ShaderStageFlagBits::eTessellationControl},
     {".ds", vk::ShaderStageFlagBits::eTessellationEvaluation}};
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+// All Shaders share one pool of worker threads with the other background tasks of the Graphics
+// module, so that they do not oversubscribe the cores together with a Core::JobSystem.
+Core::ThreadPool& getThreadPool() {
+  return Core::ThreadPool::getShared();
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+// Executes the given tasks on the worker threads. The returned future becomes ready once all of
+// them have finished. If a task throws, the first exception is stored in the future once all tasks
+// have finished.
+std::shared_future<void> runTasks(std::vector<std::function<void()>> const& tasks) {
+  struct State {
+    std::atomic<size_t> mRemaining;
+    std::promise<void>  mPromise;
+    std::mutex          mMutex;
+    std::exception_ptr  mException;
+  };
+
+  auto state        = std::make_shared<State>();
+  state->mRemaining = tasks.size();
+  auto future       = state->mPromise.get_future().share();
+
+  if (tasks.empty()) {
+    state->mPromise.set_value();
+  }
+
+  for (auto const& task : tasks) {
+    getThreadPool().enqueue([state, task]() {
+      try {
+        task();
+      } catch (...) {
+        std::lock_guard<std::mutex> lock(state->mMutex);
+        if (!state->mException) {
+          state->mException = std::current_exception();
+        }
+      }
+
+      if (--state->mRemaining == 0) {
+        if (state->mException) {
+          state->mPromise.set_exception(state->mException);
+        } else {
+          state->mPromise.set_value();
+        }
+      }
+    });
+  }
+
+  return future;
+}
+
 } // namespace
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////
 
 ShaderPtr Shader::createFromFiles(DevicePtr const& device,
     std::vector<std::string> const& fileNames, std::set<std::string> dynamicBuffers,
-    bool reloadOnChanges) {
+    bool reloadOnChanges, std::set<std::string> const& defines) {
 
   auto shader = Shader::create(device);
 
@@ -47,14 +108,16 @@ ShaderPtr Shader::createFromFiles(DevicePtr const& device,
     // first check whether the file has a glsl extension
     auto stage = glslExtensionMapping.find(extension);
     if (stage != glslExtensionMapping.end()) {
-      shader->addModule(stage->second, GlslFile::create(fileName, reloadOnChanges), dynamicBuffers);
+      shader->addModule(
+          stage->second, GlslFile::create(fileName, reloadOnChanges, defines), dynamicBuffers);
       continue;
     }
 
     // then check whether the file has a hlsl extension
     stage = hlslExtensionMapping.find(extension);
     if (stage != hlslExtensionMapping.end()) {
-      shader->addModule(stage->second, HlslFile::create(fileName, reloadOnChanges), dynamicBuffers);
+      shader->addModule(
+          stage->second, HlslFile::create(fileName, reloadOnChanges, defines), dynamicBuffers);
       continue;
     }
 
@@ -84,6 +147,38 @@ void Shader::addModule(vk::ShaderStageFlagBits stage, ShaderSourcePtr const& sou
   mDirty                 = true;
   mSources[stage]        = source;
   mDynamicBuffers[stage] = dynamicBuffers;
+
+  // a pending compilation does not contain this module; its results are simply ignored
+  mCompilation.reset();
+  mReloading.reset();
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+std::shared_future<void> Shader::prepareAsync() {
+  if (mCompilation) {
+    return mCompilation->mFuture;
+  }
+
+  if (!mDirty) {
+    return runTasks({});
+  }
+
+  mCompilation = compile({});
+
+  return mCompilation->mFuture;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void Shader::prepare(std::vector<ShaderPtr> const& shaders) {
+  for (auto const& shader : shaders) {
+    shader->prepareAsync();
+  }
+
+  for (auto const& shader : shaders) {
+    shader->reload();
+  }
 }
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -109,54 +204,151 @@ std::vector<DescriptorSetReflectionPtr> const& Shader::getDescriptorSetReflectio
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////
 
-void Shader::reload() {
+void Shader::setPerDrawSet(std::optional<uint32_t> set) {
+  mPerDrawSet = set;
 
-  // first check whether one of our modules needs to be reload (this is for example the case when
-  // the source file changed on disc)
-  for (auto const& m : mModules) {
-    if (m->requiresReload()) {
-      try {
-        m->reload();
-      } catch (std::runtime_error const& e) {
-        ILLUSION_ERROR << "Shader reloading failed. " << e.what() << std::endl;
-        m->resetReloadingRequired();
-      }
-    }
+  if (mReflection) {
+    usePushDescriptors(mReflection);
   }
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+std::optional<uint32_t> Shader::getPerDrawSet() const {
+  return mPerDrawSet;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void Shader::reload() {
 
   // A new module was added. Just recreate everything. This could be optimized to just recreate the
   // newly added modules, however there will be only very few cases were this method is called
   // before all modules are added anyways.
   if (mDirty) {
-    std::vector<ShaderModulePtr> modules;
 
-    auto reflection = std::make_shared<PipelineReflection>(mDevice);
+    // compile all modules in parallel, this does nothing if prepareAsync() has been called before
+    prepareAsync();
+    mCompilation->mFuture.wait();
 
-    try {
+    auto compilation = mCompilation;
+    mCompilation.reset();
 
-      // create modules
-      for (auto const& s : mSources) {
-        modules.emplace_back(
-            ShaderModule::create(mDevice, s.second, s.first, mDynamicBuffers[s.first]));
-      }
+    // setting mDirty to false even on errors to prevent multiple error prints
+    apply(*compilation, "Failed to compile shader: ");
+    mDirty = false;
 
-      // create reflection
-      for (auto const& module : modules) {
-        for (auto const& resource : module->getResources()) {
-          reflection->addResource(resource);
-        }
-      }
-    } catch (std::runtime_error const& e) {
-      ILLUSION_ERROR << "Failed to compile shader: " << e.what() << std::endl;
+    return;
+  }
+
+  // Check whether a reload which has been started by a previous call has finished. The current
+  // modules are used until then, and also if the new ones failed to compile.
+  if (mReloading) {
+    if (mReloading->mFuture.wait_for(std::chrono::seconds(0)) == std::future_status::ready) {
+      auto compilation = mReloading;
+      mReloading.reset();
+      apply(*compilation, "Shader reloading failed. ");
+    }
+
+    return;
+  }
+
+  // Then check whether one of our sources needs to be reloaded (this is for example the case when
+  // the source file changed on disc). The changed stages are compiled on the worker threads, the
+  // others are reused. The flags are reset right away, so changes during the compilation will
+  // cause another reload.
+  std::unordered_map<vk::ShaderStageFlagBits, ShaderModulePtr> unchangedModules;
+  bool                                                         changed = false;
+
+  for (auto const& m : mModules) {
+    unchangedModules[m->getStage()] = m;
+  }
 
-      // setting mDirty to false to prevent multiple error prints
-      mDirty = false;
-      return;
+  for (auto const& s : mSources) {
+    if (s.second->requiresReload()) {
+      s.second->resetReloadingRequired();
+      unchangedModules.erase(s.first);
+      changed = true;
     }
+  }
+
+  if (changed) {
+    mReloading = compile(unchangedModules);
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+std::shared_ptr<Shader::Compilation> Shader::compile(
+    std::unordered_map<vk::ShaderStageFlagBits, ShaderModulePtr> const& unchangedModules) {
+
+  auto compilation = std::make_shared<Compilation>();
+  compilation->mModules.resize(mSources.size());
+
+  std::vector<std::function<void()>> tasks;
+  size_t                             index = 0;
+
+  for (auto const& s : mSources) {
+    auto unchanged = unchangedModules.find(s.first);
+    if (unchanged != unchangedModules.end()) {
+      compilation->mModules[index++] = unchanged->second;
+      continue;
+    }
+
+    tasks.emplace_back([compilation, index = index++, device = mDevice, source = s.second,
+                           stage = s.first, dynamicBuffers = mDynamicBuffers[s.first]]() {
+      compilation->mModules[index] = ShaderModule::create(device, source, stage, dynamicBuffers);
+    });
+  }
+
+  compilation->mFuture = runTasks(tasks);
+
+  return compilation;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void Shader::apply(Compilation const& compilation, std::string const& errorMessage) {
+  auto reflection = std::make_shared<PipelineReflection>(mDevice);
+
+  try {
+    // rethrows the first exception of the worker threads
+    compilation.mFuture.get();
+
+    // create reflection
+    for (auto const& module : compilation.mModules) {
+      for (auto const& resource : module->getResources()) {
+        reflection->addResource(resource);
+      }
+    }
+  } catch (std::exception const& e) {
+    ILLUSION_ERROR << errorMessage << e.what() << std::endl;
+    return;
+  } catch (...) {
+    ILLUSION_ERROR << errorMessage << "Unknown error!" << std::endl;
+    return;
+  }
+
+  usePushDescriptors(reflection);
+
+  mReflection = reflection;
+  mModules    = compilation.mModules;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void Shader::usePushDescriptors(PipelineReflectionPtr const& reflection) const {
+
+  // without VK_KHR_push_descriptor, the per-draw set is a regular descriptor set
+  if (!mDevice->getPushDescriptorSetFunction()) {
+    return;
+  }
 
-    mReflection = reflection;
-    mModules    = modules;
-    mDirty      = false;
+  try {
+    reflection->setPushDescriptorSet(mPerDrawSet);
+  } catch (std::runtime_error const& e) {
+    ILLUSION_WARNING << e.what() << " It is used as a regular descriptor set." << std::endl;
+    reflection->setPushDescriptorSet(std::nullopt);
   }
 }
 
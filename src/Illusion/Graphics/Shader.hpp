@@ -13,7 +13,10 @@
 #include "DescriptorPool.hpp"
 #include "ShaderModule.hpp"
 
+#include <future>
 #include <map>
+#include <memory>
+#include <optional>
 #include <set>
 
 namespace Illusion::Graphics {
@@ -22,6 +25,13 @@ namespace Illusion::Graphics {
 // The Shader class stores multiple ShaderModules. Depending on the added ShaderModules, it can   //
 // be either a graphics or a compute shader. After all ShaderModules have been added, you can use //
 // getReflection() to generate a matching vk::PipelineLayout.                                     //
+// The stages are compiled and reflected in parallel on a pool of worker threads which is shared  //
+// by all Shaders. This happens lazily when the modules are accessed for the first time (usually  //
+// by the first draw call), unless prepareAsync() has been called before.                         //
+// When a source changed on disc (see ShaderFile), the changed stages are compiled again on the   //
+// worker threads while the current modules stay in use. The new modules replace the old ones     //
+// with the first access after all of them have been compiled successfully; if there are errors,  //
+// they are printed and the old modules are kept. Hence hot reloading never blocks the frame.     //
 ////////////////////////////////////////////////////////////////////////////////////////////////////
 
 class Shader {
@@ -35,9 +45,12 @@ class Shader {
   // .tesc / .hs: Tessellation Control Shader / Hull Shader
   // .tese / .ds: Tessellation Evaluation Shader / Domain Shader
   // .comp / .cs: Compute Shader
+  // .task:       Task Shader (VK_EXT_mesh_shader)
+  // .mesh:       Mesh Shader (VK_EXT_mesh_shader)
+  // The given defines are passed to all ShaderSources.
   static ShaderPtr createFromFiles(DevicePtr const& device,
       std::vector<std::string> const& fileNames, std::set<std::string> dynamicBuffers = {},
-      bool reloadOnChanges = true);
+      bool reloadOnChanges = true, std::set<std::string> const& defines = {});
 
   // Syntactic sugar to create a std::shared_ptr for this class
   template <typename... Args>
@@ -61,8 +74,19 @@ class Shader {
   void addModule(vk::ShaderStageFlagBits stage, ShaderSourcePtr const& source,
       std::set<std::string> const& dynamicBuffers = {});
 
+  // Starts compiling all stages on the worker threads and returns immediately. The returned future
+  // becomes ready once all stages have been compiled; the methods below will then not block
+  // anymore. This can be used to compile shaders during loading screens. Calling this again before
+  // the next addModule() returns the same future. If a stage fails to compile, get() rethrows the
+  // error while the methods below print it.
+  std::shared_future<void> prepareAsync();
+
+  // Compiles all stages of all given Shaders in parallel and waits until this is done.
+  static void prepare(std::vector<ShaderPtr> const& shaders);
+
   // Returns a vector of ShaderModules. These are allocated lazily by this call and can be queried
-  // for the actual Vulkan handle.
+  // for the actual Vulkan handle. If prepareAsync() has been called before, this waits until the
+  // compilation has finished.
   std::vector<ShaderModulePtr> const& getModules();
 
   // The PipelineReflection can be used to query information on all resources of the contained
@@ -73,12 +97,44 @@ class Shader {
   // DescriptorSetReflection can be used to create a corresponding vk::DescriptorSetLayout.
   std::vector<DescriptorSetReflectionPtr> const& getDescriptorSetReflections();
 
+  // Marks the given descriptor set as per-draw, which means that its bindings are expected to
+  // change for almost every draw call (for example the material textures of a glTF primitive). If
+  // VK_KHR_push_descriptor is available, the CommandBuffer pushes the descriptors of this set
+  // directly instead of allocating and writing a vk::DescriptorSet. The set must neither be
+  // bindless nor contain dynamic buffers, otherwise a warning is printed and it is used as a
+  // regular descriptor set. std::nullopt (the default) disables this.
+  void                    setPerDrawSet(std::optional<uint32_t> set);
+  std::optional<uint32_t> getPerDrawSet() const;
+
  private:
+  // The results of a compilation which has been started by prepareAsync() or by a reload. The
+  // worker threads write to different elements of mModules. If one of them fails, mFuture holds
+  // the exception.
+  struct Compilation {
+    std::vector<ShaderModulePtr> mModules;
+    std::shared_future<void>     mFuture;
+  };
+
   void reload();
 
+  // Starts compiling all stages on the worker threads, except for those given in unchangedModules
+  // which are reused as they are.
+  std::shared_ptr<Compilation> compile(
+      std::unordered_map<vk::ShaderStageFlagBits, ShaderModulePtr> const& unchangedModules);
+
+  // Creates the reflection of the compiled modules and replaces mModules and mReflection. If a
+  // stage failed to compile, the error is printed and the current modules are kept.
+  void apply(Compilation const& compilation, std::string const& errorMessage);
+
+  // Makes mPerDrawSet the push descriptor set of the given reflection, if possible.
+  void usePushDescriptors(PipelineReflectionPtr const& reflection) const;
+
   DevicePtr                    mDevice;
   std::vector<ShaderModulePtr> mModules;
   PipelineReflectionPtr        mReflection;
+  std::shared_ptr<Compilation> mCompilation;
+  std::shared_ptr<Compilation> mReloading;
+  std::optional<uint32_t>      mPerDrawSet;
 
   bool                                                               mDirty = false;
   std::unordered_map<vk::ShaderStageFlagBits, ShaderSourcePtr>       mSources;
@@ -139,6 +139,12 @@ void ShaderModule::reload() {
   info.codeSize = spirv.size() * 4;
   info.pCode    = spirv.data();
   mHandle       = mDevice->createShaderModule(info);
+
+  // 64 bit FNV-1a
+  mSpirvHash = 14695981039346656037ull;
+  for (uint32_t word : spirv) {
+    mSpirvHash = (mSpirvHash ^ word) * 1099511628211ull;
+  }
 }
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -155,12 +161,25 @@ vk::ShaderStageFlagBits ShaderModule::getStage() const {
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////
 
+uint64_t ShaderModule::getSpirvHash() const {
+  return mSpirvHash;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
 std::vector<PipelineResource> const& ShaderModule::getResources() const {
   return mResources;
 }
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////
 
+std::vector<ShaderModule::SpecializationConstant> const&
+ShaderModule::getSpecializationConstants() const {
+  return mSpecializationConstants;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
 void ShaderModule::createReflection(std::vector<uint32_t> const& spirv) {
   // Parse SPIRV binary.
   CustomCompiler                     compiler(spirv);
@@ -345,6 +364,21 @@ void ShaderModule::createReflection(std::vector<uint32_t> const& spirv) {
     mResources.push_back(pipelineResource);
   }
 
+  // Extract acceleration structures, they are only read by ray queries.
+  for (auto& resource : resources.acceleration_structures) {
+    const auto& spirType = compiler.get_type_from_variable(resource.id);
+
+    PipelineResource pipelineResource;
+    pipelineResource.mStages       = mStage;
+    pipelineResource.mResourceType = PipelineResource::ResourceType::eAccelerationStructure;
+    pipelineResource.mAccess       = vk::AccessFlagBits::eAccelerationStructureReadKHR;
+    pipelineResource.mSet     = compiler.get_decoration(resource.id, spv::DecorationDescriptorSet);
+    pipelineResource.mBinding = compiler.get_decoration(resource.id, spv::DecorationBinding);
+    pipelineResource.mArraySize = (spirType.array.size() == 0) ? 1 : spirType.array[0];
+    pipelineResource.mName      = resource.name;
+    mResources.push_back(pipelineResource);
+  }
+
   // Extract subpass inputs.
   for (auto& resource : resources.subpass_inputs) {
     PipelineResource pipelineResource;
@@ -383,6 +417,24 @@ void ShaderModule::createReflection(std::vector<uint32_t> const& spirv) {
     pipelineResource.mMembers      = ParseMembers(compiler, spirType);
     mResources.push_back(pipelineResource);
   }
+
+  // Extract specialization constants.
+  mSpecializationConstants.clear();
+  for (auto const& constant : compiler.get_specialization_constants()) {
+    const auto& spirType = compiler.get_type(compiler.get_constant(constant.id).constant_type);
+
+    auto it = spirvTypeToBaseType.find(spirType.basetype);
+    if (it == spirvTypeToBaseType.end())
+      continue;
+
+    SpecializationConstant specializationConstant;
+    specializationConstant.mName       = compiler.get_name(constant.id);
+    specializationConstant.mConstantID = constant.constant_id;
+    specializationConstant.mBaseType   = it->second;
+    specializationConstant.mSize =
+        spirType.basetype == spirv_cross::SPIRType::Boolean ? 4 : spirType.width / 8;
+    mSpecializationConstants.push_back(specializationConstant);
+  }
 }
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////
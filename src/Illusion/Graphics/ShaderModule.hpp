@@ -27,6 +27,15 @@ namespace Illusion::Graphics {
 
 class ShaderModule {
  public:
+  // A specialization constant declared by the module. mSize is the number of bytes the value
+  // occupies in a vk::SpecializationInfo; booleans use four bytes.
+  struct SpecializationConstant {
+    std::string                mName;
+    uint32_t                   mConstantID;
+    PipelineResource::BaseType mBaseType;
+    uint32_t                   mSize;
+  };
+
   // Syntactic sugar to create a std::shared_ptr for this class
   template <typename... Args>
   static ShaderModulePtr create(Args&&... args) {
@@ -61,17 +70,28 @@ class ShaderModule {
   // Get the shader stage this module was constructed for.
   vk::ShaderStageFlagBits getStage() const;
 
+  // Returns a hash of the SPIR-V code of the last reload(). Contrary to the handle, this is stable
+  // across application runs and is used to identify ShaderModules in pipeline manifests.
+  uint64_t getSpirvHash() const;
+
   // Gets reflection information.
   std::vector<PipelineResource> const& getResources() const;
 
+  // Returns all specialization constants of the module. This includes those which are used for the
+  // work group size of compute shaders (local_size_x_id etc.); they have no name.
+  std::vector<SpecializationConstant> const& getSpecializationConstants() const;
+
  private:
   void createReflection(std::vector<uint32_t> const& spirv);
 
   DevicePtr                     mDevice;
   vk::ShaderStageFlagBits       mStage;
   vk::ShaderModulePtr           mHandle;
+  uint64_t                      mSpirvHash = 0;
   std::vector<PipelineResource> mResources;
 
+  std::vector<SpecializationConstant> mSpecializationConstants;
+
   ShaderSourcePtr       mSource;
   std::set<std::string> mDynamicBuffers;
 };
@@ -9,16 +9,29 @@
 #include "ShaderSource.hpp"
 
 #include "../Core/File.hpp"
+#include "../Core/FileWatcher.hpp"
+#include "../Core/Hash.hpp"
 #include "../Core/Logger.hpp"
+#include "../Core/MappedFile.hpp"
+#include "../Core/filesystem.hpp"
 
 #include <SPIRV/GlslangToSpv.h>
 #include <StandAlone/DirStackFileIncluder.h>
 #include <StandAlone/ResourceLimits.h>
+#include <atomic>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <functional>
 #include <glslang/Include/ResourceLimits.h>
 #include <glslang/Include/ShHandle.h>
 #include <glslang/Include/revision.h>
 #include <glslang/OSDependent/osinclude.h>
 #include <glslang/Public/ShaderLang.h>
+#include <iomanip>
+#include <mutex>
+#include <spirv-tools/optimizer.hpp>
+#include <sstream>
 
 namespace Illusion::Graphics {
 
@@ -30,7 +43,15 @@ const std::unordered_map<vk::ShaderStageFlagBits, EShLanguage> shaderStageMappin
     {vk::ShaderStageFlagBits::eTessellationEvaluation, EShLangTessEvaluation},
     {vk::ShaderStageFlagBits::eGeometry, EShLangGeometry},
     {vk::ShaderStageFlagBits::eFragment, EShLangFragment},
-    {vk::ShaderStageFlagBits::eCompute, EShLangCompute}};
+    {vk::ShaderStageFlagBits::eCompute, EShLangCompute},
+    {vk::ShaderStageFlagBits::eTaskEXT, EShLangTask},
+    {vk::ShaderStageFlagBits::eMeshEXT, EShLangMesh}};
+
+// Task and mesh shaders of VK_EXT_mesh_shader require Spir-V 1.4, all other stages are compiled
+// for Vulkan 1.0.
+bool requiresSpirv14(vk::ShaderStageFlagBits stage) {
+  return stage == vk::ShaderStageFlagBits::eTaskEXT || stage == vk::ShaderStageFlagBits::eMeshEXT;
+}
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////
 
@@ -46,6 +67,7 @@ class Includer : public DirStackFileIncluder {
     }
 
     mIncludedFiles.push_back(result->headerName);
+    mIncludeHashes.push_back(Core::hashBytes(0, result->headerData, result->headerLength));
 
     return result;
   }
@@ -59,14 +81,269 @@ class Includer : public DirStackFileIncluder {
     return mIncludedFiles;
   }
 
+  // The hashes of the contents of the included files, in the same order as getIncludedFiles().
+  std::vector<uint64_t> const& getIncludeHashes() {
+    return mIncludeHashes;
+  }
+
  private:
   std::vector<Core::File> mIncludedFiles;
+  std::vector<uint64_t>   mIncludeHashes;
 };
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////
 
+// Cache files start with this magic number and version. The version has to be increased whenever
+// the file format or the compile options below change.
+const char     CACHE_MAGIC[8] = {'I', 'L', 'S', 'P', 'I', 'R', 'V', '\0'};
+const uint32_t CACHE_VERSION  = 1;
+
+struct CacheSettings {
+  std::mutex  mMutex;
+  std::string mDirectory;
+};
+
+CacheSettings& getCacheSettings() {
+  static CacheSettings settings;
+  return settings;
+}
+
+std::atomic<ShaderOptimization>& getDefaultOptimizationSetting() {
+  static std::atomic<ShaderOptimization> optimization(ShaderOptimization::eNone);
+  return optimization;
+}
+
+// All ShaderFiles with reloadOnChanges share this watcher and its thread.
+Core::FileWatcher& getFileWatcher() {
+  static Core::FileWatcher watcher;
+  return watcher;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+uint64_t getCacheKey(std::string const& code, std::string const& preamble,
+    std::string const& fileName, vk::ShaderStageFlagBits stage, EShMessages messages,
+    ShaderOptimization optimization) {
+
+  // the generator version changes whenever the Spir-V generation of glslang changes
+  std::string compilerVersion  = glslang::GetGlslVersionString();
+  int         generatorVersion = glslang::GetSpirvGeneratorVersion();
+
+  uint64_t key = Core::hashBytes(CACHE_VERSION, code.data(), code.size());
+  key          = Core::hashBytes(key, preamble.data(), preamble.size());
+  key          = Core::hashBytes(key, fileName.data(), fileName.size());
+  key          = Core::hashBytes(key, &stage, sizeof(stage));
+  key          = Core::hashBytes(key, &messages, sizeof(messages));
+  key          = Core::hashBytes(key, &optimization, sizeof(optimization));
+  key          = Core::hashBytes(key, compilerVersion.data(), compilerVersion.size());
+  key          = Core::hashBytes(key, &generatorVersion, sizeof(generatorVersion));
+
+  return key;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+// Returns true if the given cache file exists, matches the key and all included files still have
+// the same contents.
+bool readCache(std::string const& cacheFile, uint64_t key, std::vector<uint32_t>& spirv,
+    std::vector<Core::File>& includedFiles) {
+
+  Core::MappedFile file(cacheFile);
+  if (!file.isValid()) {
+    return false;
+  }
+
+  uint8_t const* data   = file.getData();
+  size_t         offset = 0;
+
+  auto read = [&](void* value, size_t size) {
+    if (offset + size > file.getSize()) {
+      return false;
+    }
+    std::memcpy(value, data + offset, size);
+    offset += size;
+    return true;
+  };
+
+  char     magic[8];
+  uint32_t version, includeCount;
+  uint64_t storedKey;
+
+  if (!read(magic, sizeof(magic)) || std::memcmp(magic, CACHE_MAGIC, sizeof(magic)) != 0 ||
+      !read(&version, sizeof(version)) || version != CACHE_VERSION ||
+      !read(&includeCount, sizeof(includeCount)) || !read(&storedKey, sizeof(storedKey)) ||
+      storedKey != key) {
+    return false;
+  }
+
+  std::vector<Core::File> files;
+
+  for (uint32_t i = 0; i < includeCount; ++i) {
+    uint32_t nameLength;
+    uint64_t hash;
+
+    if (!read(&nameLength, sizeof(nameLength)) || offset + nameLength > file.getSize()) {
+      return false;
+    }
+
+    std::string name(reinterpret_cast<char const*>(data + offset), nameLength);
+    offset += nameLength;
+
+    if (!read(&hash, sizeof(hash))) {
+      return false;
+    }
+
+    Core::MappedFile include(name);
+    if (!include.isValid() ||
+        Core::hashBytes(0, include.getData(), include.getSize()) != hash) {
+      return false;
+    }
+
+    files.emplace_back(name);
+  }
+
+  uint64_t wordCount;
+  if (!read(&wordCount, sizeof(wordCount)) ||
+      offset + wordCount * sizeof(uint32_t) > file.getSize()) {
+    return false;
+  }
+
+  spirv.resize(wordCount);
+  read(spirv.data(), wordCount * sizeof(uint32_t));
+  includedFiles = std::move(files);
+
+  return true;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+// The file is written to a temporary file first and then renamed, so that other processes which
+// use the same cache directory never see partially written files.
+void writeCache(std::string const& cacheFile, uint64_t key, std::vector<uint32_t> const& spirv,
+    Includer& includer) {
+
+  std::string tmpFile = Core::FileSystem::getTemporaryFileName(cacheFile);
+  bool        success = false;
+
+  {
+    std::ofstream stream(tmpFile, std::ios::out | std::ios::binary);
+
+    auto write = [&stream](void const* value, size_t size) {
+      stream.write(static_cast<char const*>(value), static_cast<std::streamsize>(size));
+    };
+
+    auto const& files        = includer.getIncludedFiles();
+    auto const& hashes       = includer.getIncludeHashes();
+    auto        includeCount = static_cast<uint32_t>(files.size());
+    auto        wordCount    = static_cast<uint64_t>(spirv.size());
+
+    write(CACHE_MAGIC, sizeof(CACHE_MAGIC));
+    write(&CACHE_VERSION, sizeof(CACHE_VERSION));
+    write(&includeCount, sizeof(includeCount));
+    write(&key, sizeof(key));
+
+    for (size_t i(0); i < files.size(); ++i) {
+      auto const& name       = files[i].getFileName();
+      auto        nameLength = static_cast<uint32_t>(name.size());
+      write(&nameLength, sizeof(nameLength));
+      write(name.data(), name.size());
+      write(&hashes[i], sizeof(uint64_t));
+    }
+
+    write(&wordCount, sizeof(wordCount));
+    write(spirv.data(), spirv.size() * sizeof(uint32_t));
+
+    success = static_cast<bool>(stream);
+  }
+
+  if (!success) {
+    ILLUSION_WARNING << "Failed to write Spir-V cache file " << tmpFile << "!" << std::endl;
+    std::remove(tmpFile.c_str());
+    return;
+  }
+
+  Core::FileSystem::replaceFile(tmpFile, cacheFile);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+// Runs the passes of spirv-tools for the given optimization. If the optimizer fails, a warning is
+// printed and the unoptimized code is returned.
+std::vector<uint32_t> optimize(std::vector<uint32_t> const& spirv, std::string const& fileName,
+    vk::ShaderStageFlagBits vkStage, ShaderOptimization optimization) {
+
+  if (optimization == ShaderOptimization::eNone || spirv.empty()) {
+    return spirv;
+  }
+
+  spvtools::Optimizer optimizer(
+      requiresSpirv14(vkStage) ? SPV_ENV_VULKAN_1_1_SPIRV_1_4 : SPV_ENV_VULKAN_1_0);
+
+  optimizer.SetMessageConsumer([&fileName](spv_message_level_t level, const char* source,
+                                   spv_position_t const& position, const char* message) {
+    if (level <= SPV_MSG_ERROR) {
+      ILLUSION_WARNING << "Failed to optimize " << fileName << ": " << message << std::endl;
+    }
+  });
+
+  if (optimization == ShaderOptimization::eDeadCodeElimination) {
+    optimizer.RegisterPass(spvtools::CreateDeadBranchElimPass())
+        .RegisterPass(spvtools::CreateEliminateDeadFunctionsPass())
+        .RegisterPass(spvtools::CreateAggressiveDCEPass())
+        .RegisterPass(spvtools::CreateDeadVariableEliminationPass())
+        .RegisterPass(spvtools::CreateEliminateDeadConstantPass())
+        .RegisterPass(spvtools::CreateCFGCleanupPass());
+  } else if (optimization == ShaderOptimization::ePerformance) {
+    optimizer.RegisterPerformancePasses();
+  } else if (optimization == ShaderOptimization::eSize) {
+    optimizer.RegisterSizePasses();
+  }
+
+  std::vector<uint32_t> optimized;
+  if (!optimizer.Run(spirv.data(), spirv.size(), &optimized)) {
+    return spirv;
+  }
+
+  ILLUSION_TRACE << "Optimized Spir-V code of " << fileName << " from " << spirv.size() << " to "
+                 << optimized.size() << " words." << std::endl;
+
+  return optimized;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+// Each of the given defines is added as "#define <name>" to the preamble of the code. The code is
+// optimized before it is stored in the cache.
 std::vector<uint32_t> compile(std::string const& code, std::string const& fileName,
-    vk::ShaderStageFlagBits vkStage, EShMessages messages, Includer& includer) {
+    std::set<std::string> const& defines, vk::ShaderStageFlagBits vkStage, EShMessages messages,
+    ShaderOptimization optimization, std::vector<Core::File>& includedFiles) {
+
+  std::string preamble = "#extension GL_GOOGLE_include_directive : require\n";
+  for (auto const& define : defines) {
+    preamble += "#define " + define + "\n";
+  }
+
+  std::string cacheDirectory = ShaderSource::getCacheDirectory();
+  std::string cacheFile;
+  uint64_t    key = 0;
+
+  if (!cacheDirectory.empty()) {
+    key = getCacheKey(code, preamble, fileName, vkStage, messages, optimization);
+
+    std::stringstream name;
+    name << cacheDirectory << "/" << std::hex << std::setw(16) << std::setfill('0') << key
+         << ".spv";
+    cacheFile = name.str();
+
+    std::vector<uint32_t> spirv;
+    if (readCache(cacheFile, key, spirv, includedFiles)) {
+      ILLUSION_TRACE << "Loaded Spir-V code of " << fileName << " from " << cacheFile << "."
+                     << std::endl;
+      return spirv;
+    }
+  }
+
+  Includer includer;
 
   glslang::InitializeProcess();
 
@@ -78,7 +355,12 @@ std::vector<uint32_t> compile(std::string const& code, std::string const& fileNa
   shader.setStringsWithLengthsAndNames(&codes, nullptr, &fileNames, 1);
   shader.setEntryPoint("main");
   shader.setSourceEntryPoint("main");
-  shader.setPreamble("#extension GL_GOOGLE_include_directive : require");
+  shader.setPreamble(preamble.c_str());
+
+  if (requiresSpirv14(vkStage)) {
+    shader.setEnvClient(glslang::EShClientVulkan, glslang::EShTargetVulkan_1_1);
+    shader.setEnvTarget(glslang::EShTargetSpv, glslang::EShTargetSpv_1_4);
+  }
 
   // Default built in resource limits.
   auto resourceLimits = glslang::DefaultTBuiltInResource;
@@ -111,6 +393,13 @@ std::vector<uint32_t> compile(std::string const& code, std::string const& fileNa
   // Shutdown glslang library.
   glslang::FinalizeProcess();
 
+  includedFiles = includer.getIncludedFiles();
+  spirv         = optimize(spirv, fileName, vkStage, optimization);
+
+  if (!cacheFile.empty()) {
+    writeCache(cacheFile, key, spirv, includer);
+  }
+
   return spirv;
 }
 
@@ -118,42 +407,98 @@ std::vector<uint32_t> compile(std::string const& code, std::string const& fileNa
 
 // -------------------------------------------------------------------------------------------------
 
-ShaderFile::ShaderFile(std::string const& fileName, bool reloadOnChanges)
-    : mFile(fileName)
-    , mReloadOnChanges(reloadOnChanges) {
+ShaderSource::ShaderSource()
+    : mOptimization(getDefaultOptimization()) {
 }
 
-bool ShaderFile::requiresReload() const {
-  if (!mReloadOnChanges) {
-    return false;
+void ShaderSource::setCacheDirectory(std::string const& directory) {
+  if (!directory.empty() && !Core::FileSystem::createDirectory(directory)) {
+    ILLUSION_WARNING << "Failed to create Spir-V cache directory " << directory << "!"
+                     << std::endl;
   }
 
-  if (mFile.changedOnDisc()) {
-    return true;
+  auto&                       settings = getCacheSettings();
+  std::lock_guard<std::mutex> lock(settings.mMutex);
+  settings.mDirectory = directory;
+}
+
+std::string ShaderSource::getCacheDirectory() {
+  auto&                       settings = getCacheSettings();
+  std::lock_guard<std::mutex> lock(settings.mMutex);
+  return settings.mDirectory;
+}
+
+void ShaderSource::setOptimization(ShaderOptimization optimization) {
+  mOptimization = optimization;
+}
+
+ShaderOptimization ShaderSource::getOptimization() const {
+  return mOptimization;
+}
+
+void ShaderSource::setDefaultOptimization(ShaderOptimization optimization) {
+  getDefaultOptimizationSetting() = optimization;
+}
+
+ShaderOptimization ShaderSource::getDefaultOptimization() {
+  return getDefaultOptimizationSetting();
+}
+
+// -------------------------------------------------------------------------------------------------
+
+ShaderFile::ShaderFile(
+    std::string const& fileName, bool reloadOnChanges, std::set<std::string> const& defines)
+    : mFile(fileName)
+    , mReloadOnChanges(reloadOnChanges)
+    , mDefines(defines) {
+
+  if (mReloadOnChanges) {
+    mFileWatch = getFileWatcher().watch(mFile.getFileName(), [this]() { mChanged = true; });
   }
+}
+
+ShaderFile::~ShaderFile() {
+  if (mReloadOnChanges) {
+    getFileWatcher().unwatch(mFileWatch);
 
-  for (auto const& f : mIncludedFiles) {
-    if (f.changedOnDisc()) {
-      return true;
+    for (auto watch : mIncludeWatches) {
+      getFileWatcher().unwatch(watch);
     }
   }
+}
 
-  return false;
+bool ShaderFile::requiresReload() const {
+  return mChanged;
 }
 
 void ShaderFile::resetReloadingRequired() {
-  mFile.resetChangedOnDisc();
+  mChanged = false;
+}
 
-  for (auto& f : mIncludedFiles) {
-    f.resetChangedOnDisc();
+void ShaderFile::watchIncludedFiles() {
+  if (!mReloadOnChanges) {
+    return;
+  }
+
+  for (auto watch : mIncludeWatches) {
+    getFileWatcher().unwatch(watch);
+  }
+
+  mIncludeWatches.clear();
+
+  for (auto const& file : mIncludedFiles) {
+    mIncludeWatches.push_back(
+        getFileWatcher().watch(file.getFileName(), [this]() { mChanged = true; }));
   }
 }
 
 // -------------------------------------------------------------------------------------------------
 
-ShaderCode::ShaderCode(std::string const& code, std::string const& name)
+ShaderCode::ShaderCode(
+    std::string const& code, std::string const& name, std::set<std::string> const& defines)
     : mCode(code)
-    , mName(name) {
+    , mName(name)
+    , mDefines(defines) {
 }
 
 bool ShaderCode::requiresReload() const {
@@ -165,59 +510,60 @@ void ShaderCode::resetReloadingRequired() {
 
 // -------------------------------------------------------------------------------------------------
 
-GlslFile::GlslFile(std::string const& fileName, bool reloadOnChanges)
-    : ShaderFile(fileName, reloadOnChanges) {
+GlslFile::GlslFile(
+    std::string const& fileName, bool reloadOnChanges, std::set<std::string> const& defines)
+    : ShaderFile(fileName, reloadOnChanges, defines) {
 }
 
 std::vector<uint32_t> GlslFile::getSpirv(vk::ShaderStageFlagBits stage) {
-  auto     code = mFile.getContent<std::string>();
-  Includer includer;
-  auto     spirv = compile(
-      code, mFile.getFileName(), stage, EShMessages(EShMsgSpvRules | EShMsgVulkanRules), includer);
-
-  mIncludedFiles = includer.getIncludedFiles();
-
+  auto code  = mFile.getContent<std::string>();
+  auto spirv = compile(code, mFile.getFileName(), mDefines, stage,
+      EShMessages(EShMsgSpvRules | EShMsgVulkanRules), getOptimization(), mIncludedFiles);
+  watchIncludedFiles();
   return spirv;
 }
 
 // -------------------------------------------------------------------------------------------------
 
-GlslCode::GlslCode(std::string const& code, std::string const& name)
-    : ShaderCode(code, name) {
+GlslCode::GlslCode(
+    std::string const& code, std::string const& name, std::set<std::string> const& defines)
+    : ShaderCode(code, name, defines) {
 }
 
 std::vector<uint32_t> GlslCode::getSpirv(vk::ShaderStageFlagBits stage) {
-  Includer includer;
-  return compile(mCode, mName, stage, EShMessages(EShMsgSpvRules | EShMsgVulkanRules), includer);
+  std::vector<Core::File> includedFiles;
+  return compile(mCode, mName, mDefines, stage, EShMessages(EShMsgSpvRules | EShMsgVulkanRules),
+      getOptimization(), includedFiles);
 }
 
 // -------------------------------------------------------------------------------------------------
 
-HlslFile::HlslFile(std::string const& fileName, bool reloadOnChanges)
-    : ShaderFile(fileName, reloadOnChanges) {
+HlslFile::HlslFile(
+    std::string const& fileName, bool reloadOnChanges, std::set<std::string> const& defines)
+    : ShaderFile(fileName, reloadOnChanges, defines) {
 }
 
 std::vector<uint32_t> HlslFile::getSpirv(vk::ShaderStageFlagBits stage) {
-  auto     code = mFile.getContent<std::string>();
-  Includer includer;
-  auto     spirv = compile(code, mFile.getFileName(), stage,
-      EShMessages(EShMsgSpvRules | EShMsgVulkanRules | EShMsgReadHlsl), includer);
-
-  mIncludedFiles = includer.getIncludedFiles();
-
+  auto code  = mFile.getContent<std::string>();
+  auto spirv = compile(code, mFile.getFileName(), mDefines, stage,
+      EShMessages(EShMsgSpvRules | EShMsgVulkanRules | EShMsgReadHlsl), getOptimization(),
+      mIncludedFiles);
+  watchIncludedFiles();
   return spirv;
 }
 
 // -------------------------------------------------------------------------------------------------
 
-HlslCode::HlslCode(std::string const& code, std::string const& name)
-    : ShaderCode(code, name) {
+HlslCode::HlslCode(
+    std::string const& code, std::string const& name, std::set<std::string> const& defines)
+    : ShaderCode(code, name, defines) {
 }
 
 std::vector<uint32_t> HlslCode::getSpirv(vk::ShaderStageFlagBits stage) {
-  Includer includer;
-  return compile(mCode, mName, stage,
-      EShMessages(EShMsgSpvRules | EShMsgVulkanRules | EShMsgReadHlsl), includer);
+  std::vector<Core::File> includedFiles;
+  return compile(mCode, mName, mDefines, stage,
+      EShMessages(EShMsgSpvRules | EShMsgVulkanRules | EShMsgReadHlsl), getOptimization(),
+      includedFiles);
 }
 
 // -------------------------------------------------------------------------------------------------
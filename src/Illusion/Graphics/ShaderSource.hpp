@@ -13,6 +13,8 @@
 
 #include "../Core/File.hpp"
 
+#include <atomic>
+#include <set>
 #include <variant>
 
 namespace Illusion::Graphics {
@@ -21,30 +23,93 @@ namespace Illusion::Graphics {
 // A ShaderSource is given to the Shader for each stage. Internally, the Shader class uses the    //
 // ShaderSource to construct ShaderModules for each stage.                                        //
 // A ShaderSource can be either inline code or a shader file on disc. It can contain GLSL, HLSL   //
-// or Spir-V code                                                                                 //
+// or Spir-V code. GLSL and HLSL sources can be given a set of defines; each of them is added as  //
+// "#define <name>" before the code is compiled. This can be used to create variants of shaders   //
+// (see ShaderVariants).                                                                          //
 ////////////////////////////////////////////////////////////////////////////////////////////////////
 
+// The passes of spirv-tools which are applied to the Spir-V code of compiled GLSL and HLSL
+// sources. Please note that unused resources may be removed from the code, hence the reflection
+// will not contain them either.
+enum class ShaderOptimization {
+  // The output of glslang is used as it is.
+  eNone,
+
+  // Removes unused functions, variables, constants and branches which are never taken.
+  eDeadCodeElimination,
+
+  // The passes of spirv-opt -O; this includes dead code elimination.
+  ePerformance,
+
+  // The passes of spirv-opt -Os. This results in the smallest code, which is also faster to load
+  // from the Spir-V cache.
+  eSize
+};
+
 // Abstract base class for all shader sources.
 class ShaderSource {
  public:
+  ShaderSource();
+  virtual ~ShaderSource() = default;
+
   virtual bool                  requiresReload() const                  = 0;
   virtual void                  resetReloadingRequired()                = 0;
   virtual std::vector<uint32_t> getSpirv(vk::ShaderStageFlagBits stage) = 0;
+
+  // If a cache directory is set, the Spir-V code of all compiled GLSL and HLSL sources is stored
+  // there. The files are named after a hash of the source code, the source name, the stage, the
+  // optimization and the version of glslang; each file also stores the contents hashes of all
+  // included files. When the same source is compiled again and the included files have not changed,
+  // the code is read from the cache and glslang is not invoked at all. The directory may be shared
+  // by several applications or machines. It is created if it does not exist. An empty string (the
+  // default) disables the cache. This is thread-safe.
+  static void        setCacheDirectory(std::string const& directory);
+  static std::string getCacheDirectory();
+
+  // The optimization which is applied when this source is compiled; it has no effect on Spir-V
+  // sources. Changes are used by the next compilation, for example when the source is reloaded.
+  // Sources use the default optimization at construction time. This is thread-safe.
+  void               setOptimization(ShaderOptimization optimization);
+  ShaderOptimization getOptimization() const;
+
+  // The optimization of new ShaderSources. The default is ShaderOptimization::eNone. This is
+  // thread-safe.
+  static void               setDefaultOptimization(ShaderOptimization optimization);
+  static ShaderOptimization getDefaultOptimization();
+
+ private:
+  std::atomic<ShaderOptimization> mOptimization;
 };
 
 // -------------------------------------------------------------------------------------------------
 
 // This (abstract) derived class for file based sources handles the reloading of changed files.
+// If reloadOnChanges is set, the file and all files it included when it was compiled last are
+// registered at a Core::FileWatcher shared by all ShaderFiles. The watcher marks the source as
+// changed from its background thread, hence requiresReload() does not access the file system.
 class ShaderFile : public ShaderSource {
  public:
-  ShaderFile(std::string const& fileName, bool reloadOnChanges);
+  ShaderFile(std::string const& fileName, bool reloadOnChanges,
+      std::set<std::string> const& defines = {});
+  virtual ~ShaderFile();
+
   bool requiresReload() const override;
   void resetReloadingRequired() override;
 
  protected:
+  // Registers the current mIncludedFiles at the file watcher. This should be called after each
+  // compilation.
+  void watchIncludedFiles();
+
   Core::File              mFile;
   bool                    mReloadOnChanges;
+  std::set<std::string>   mDefines;
   std::vector<Core::File> mIncludedFiles;
+
+ private:
+  std::atomic<bool>     mChanged = false;
+  uint32_t              mFileWatch = 0;
+  std::vector<uint32_t> mIncludeWatches;
 };
 
 // -------------------------------------------------------------------------------------------------
@@ -53,13 +118,15 @@ class ShaderFile : public ShaderSource {
 // always returns false.
 class ShaderCode : public ShaderSource {
  public:
-  ShaderCode(std::string const& code, std::string const& name);
+  ShaderCode(std::string const& code, std::string const& name,
+      std::set<std::string> const& defines = {});
   bool requiresReload() const override;
   void resetReloadingRequired() override;
 
  protected:
-  std::string mCode;
-  std::string mName;
+  std::string           mCode;
+  std::string           mName;
+  std::set<std::string> mDefines;
 };
 
 // -------------------------------------------------------------------------------------------------
@@ -72,7 +139,8 @@ class GlslFile : public ShaderFile {
     return std::make_shared<GlslFile>(args...);
   };
 
-  GlslFile(std::string const& fileName, bool reloadOnChanges = true);
+  GlslFile(std::string const& fileName, bool reloadOnChanges = true,
+      std::set<std::string> const& defines = {});
 
   std::vector<uint32_t> getSpirv(vk::ShaderStageFlagBits stage) override;
 };
@@ -87,7 +155,8 @@ class GlslCode : public ShaderCode {
     return std::make_shared<GlslCode>(args...);
   };
 
-  GlslCode(std::string const& code, std::string const& name);
+  GlslCode(std::string const& code, std::string const& name,
+      std::set<std::string> const& defines = {});
 
   std::vector<uint32_t> getSpirv(vk::ShaderStageFlagBits stage) override;
 };
@@ -102,7 +171,8 @@ class HlslFile : public ShaderFile {
     return std::make_shared<HlslFile>(args...);
   };
 
-  HlslFile(std::string const& fileName, bool reloadOnChanges = true);
+  HlslFile(std::string const& fileName, bool reloadOnChanges = true,
+      std::set<std::string> const& defines = {});
 
   std::vector<uint32_t> getSpirv(vk::ShaderStageFlagBits stage) override;
 };
@@ -117,7 +187,8 @@ class HlslCode : public ShaderCode {
     return std::make_shared<HlslCode>(args...);
   };
 
-  HlslCode(std::string const& code, std::string const& name);
+  HlslCode(std::string const& code, std::string const& name,
+      std::set<std::string> const& defines = {});
 
   std::vector<uint32_t> getSpirv(vk::ShaderStageFlagBits stage) override;
 };
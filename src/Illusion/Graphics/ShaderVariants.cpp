@@ -0,0 +1,119 @@
+////////////////////////////////////////////////////////////////////////////////////////////////////
+//                                                                                                //
+//    _)  |  |            _)                This code may be used and modified under the terms    //
+//     |  |  |  |  | (_-<  |   _ \    \     of the MIT license. See the LICENSE file for details. //
+//    _| _| _| \_,_| ___/ _| \___/ _| _|    Copyright (c) 2018-2019 Simon Schneegans              //
+//                                                                                                //
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include "ShaderVariants.hpp"
+
+#include "../Core/Logger.hpp"
+#include "Shader.hpp"
+
+#include <algorithm>
+
+namespace Illusion::Graphics {
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+ShaderVariants::ShaderVariants(DevicePtr const& device, std::vector<std::string> const& fileNames,
+    std::vector<std::string> const& keywords, std::set<std::string> const& dynamicBuffers,
+    bool reloadOnChanges)
+    : mDevice(device)
+    , mFileNames(fileNames)
+    , mKeywords(keywords)
+    , mDynamicBuffers(dynamicBuffers)
+    , mReloadOnChanges(reloadOnChanges) {
+
+  if (mKeywords.size() > 64) {
+    throw std::runtime_error("Failed to create ShaderVariants: There are more than 64 keywords!");
+  }
+
+  mValidBits = mKeywords.size() == 64 ? ~0ull : (1ull << mKeywords.size()) - 1;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+ShaderVariants::~ShaderVariants() {
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+uint64_t ShaderVariants::getMask(std::set<std::string> const& keywords) const {
+  uint64_t mask = 0;
+
+  for (auto const& keyword : keywords) {
+    auto it = std::find(mKeywords.begin(), mKeywords.end(), keyword);
+    if (it == mKeywords.end()) {
+      throw std::runtime_error("Failed to get shader variant: Unknown keyword " + keyword + "!");
+    }
+    mask |= 1ull << (it - mKeywords.begin());
+  }
+
+  return mask;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+ShaderPtr const& ShaderVariants::get(uint64_t mask) {
+  mask &= mValidBits;
+
+  auto cached = mShaders.find(mask);
+  if (cached != mShaders.end()) {
+    return cached->second;
+  }
+
+  std::set<std::string> defines;
+  for (size_t i(0); i < mKeywords.size(); ++i) {
+    if (mask & (1ull << i)) {
+      defines.insert(mKeywords[i]);
+    }
+  }
+
+  ILLUSION_TRACE << "Creating shader variant " << mask << " of " << mFileNames.front() << "."
+                 << std::endl;
+
+  auto shader =
+      Shader::createFromFiles(mDevice, mFileNames, mDynamicBuffers, mReloadOnChanges, defines);
+  shader->setPerDrawSet(mPerDrawSet);
+  shader->prepareAsync();
+
+  return mShaders.emplace(mask, shader).first->second;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+ShaderPtr const& ShaderVariants::get(std::set<std::string> const& keywords) {
+  return get(getMask(keywords));
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+std::vector<ShaderPtr> ShaderVariants::getShaders() const {
+  std::vector<ShaderPtr> shaders;
+  for (auto const& shader : mShaders) {
+    shaders.push_back(shader.second);
+  }
+  return shaders;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+std::vector<std::string> const& ShaderVariants::getKeywords() const {
+  return mKeywords;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void ShaderVariants::setPerDrawSet(std::optional<uint32_t> set) {
+  mPerDrawSet = set;
+
+  for (auto const& shader : mShaders) {
+    shader.second->setPerDrawSet(set);
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+} // namespace Illusion::Graphics
@@ -0,0 +1,80 @@
+////////////////////////////////////////////////////////////////////////////////////////////////////
+//                                                                                                //
+//    _)  |  |            _)                This code may be used and modified under the terms    //
+//     |  |  |  |  | (_-<  |   _ \    \     of the MIT license. See the LICENSE file for details. //
+//    _| _| _| \_,_| ___/ _| \___/ _| _|    Copyright (c) 2018-2019 Simon Schneegans              //
+//                                                                                                //
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#ifndef ILLUSION_GRAPHICS_SHADER_VARIANTS_HPP
+#define ILLUSION_GRAPHICS_SHADER_VARIANTS_HPP
+
+#include "fwd.hpp"
+
+#include <optional>
+#include <set>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace Illusion::Graphics {
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// ShaderVariants creates permutations of a Shader from the same source files. It is constructed  //
+// with a list of up to 64 feature keywords; a variant is identified by a bit mask where bit i    //
+// corresponds to the i-th keyword. When a variant is requested for the first time, a Shader is   //
+// created whose sources get a "#define <keyword>" for each set bit (see                          //
+// Shader::createFromFiles()). Its compilation is started on the worker threads right away, see   //
+// Shader::prepareAsync(). All variants are kept for the lifetime of the ShaderVariants.          //
+// This can be used to replace runtime branches of shaders by preprocessor conditions without     //
+// maintaining a separate file for each combination. All methods have to be called by the same    //
+// thread.                                                                                        //
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+class ShaderVariants {
+
+ public:
+  // Syntactic sugar to create a std::shared_ptr for this class
+  template <typename... Args>
+  static ShaderVariantsPtr create(Args&&... args) {
+    return std::make_shared<ShaderVariants>(args...);
+  };
+
+  // The parameters are passed to Shader::createFromFiles() for each variant. Throws a
+  // std::runtime_error if there are more than 64 keywords.
+  ShaderVariants(DevicePtr const& device, std::vector<std::string> const& fileNames,
+      std::vector<std::string> const& keywords, std::set<std::string> const& dynamicBuffers = {},
+      bool reloadOnChanges = true);
+  virtual ~ShaderVariants();
+
+  // Returns the mask of the given keywords. Throws a std::runtime_error if one of them has not been
+  // given at construction time.
+  uint64_t getMask(std::set<std::string> const& keywords) const;
+
+  // Returns the Shader for the given mask or keywords. It is created if it does not exist yet. Bits
+  // which do not correspond to a keyword are ignored.
+  ShaderPtr const& get(uint64_t mask);
+  ShaderPtr const& get(std::set<std::string> const& keywords);
+
+  // Returns all variants which have been created so far, for example for PipelineCache::prewarm().
+  std::vector<ShaderPtr> getShaders() const;
+
+  std::vector<std::string> const& getKeywords() const;
+
+  // Calls Shader::setPerDrawSet() for all existing and future variants.
+  void setPerDrawSet(std::optional<uint32_t> set);
+
+ private:
+  DevicePtr                               mDevice;
+  std::vector<std::string>                mFileNames;
+  std::vector<std::string>                mKeywords;
+  std::set<std::string>                   mDynamicBuffers;
+  bool                                    mReloadOnChanges;
+  uint64_t                                mValidBits;
+  std::optional<uint32_t>                 mPerDrawSet;
+  std::unordered_map<uint64_t, ShaderPtr> mShaders;
+};
+
+} // namespace Illusion::Graphics
+
+#endif // ILLUSION_GRAPHICS_SHADER_VARIANTS_HPP
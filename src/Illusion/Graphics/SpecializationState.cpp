@@ -0,0 +1,167 @@
+////////////////////////////////////////////////////////////////////////////////////////////////////
+//                                                                                                //
+//    _)  |  |            _)                This code may be used and modified under the terms    //
+//     |  |  |  |  | (_-<  |   _ \    \     of the MIT license. See the LICENSE file for details. //
+//    _| _| _| \_,_| ___/ _| \___/ _| _|    Copyright (c) 2018-2019 Simon Schneegans              //
+//                                                                                                //
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include "SpecializationState.hpp"
+
+#include "ShaderModule.hpp"
+
+#include <cstring>
+
+namespace Illusion::Graphics {
+
+namespace {
+
+template <typename T>
+void write(std::vector<uint8_t>& data, T const& value) {
+  size_t offset = data.size();
+  data.resize(offset + sizeof(T));
+  std::memcpy(data.data() + offset, &value, sizeof(T));
+}
+
+template <typename T>
+bool read(std::vector<uint8_t> const& data, size_t& offset, T& value) {
+  if (offset + sizeof(T) > data.size()) {
+    return false;
+  }
+  std::memcpy(&value, data.data() + offset, sizeof(T));
+  offset += sizeof(T);
+  return true;
+}
+
+} // namespace
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void SpecializationState::set(uint32_t constantID, bool value) {
+  mValues[constantID] = value ? VK_TRUE : VK_FALSE;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void SpecializationState::set(uint32_t constantID, int32_t value) {
+  std::memcpy(&mValues[constantID], &value, sizeof(uint32_t));
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void SpecializationState::set(uint32_t constantID, uint32_t value) {
+  mValues[constantID] = value;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void SpecializationState::set(uint32_t constantID, float value) {
+  std::memcpy(&mValues[constantID], &value, sizeof(uint32_t));
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void SpecializationState::reset(uint32_t constantID) {
+  mValues.erase(constantID);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void SpecializationState::clear() {
+  mValues.clear();
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+std::map<uint32_t, uint32_t> const& SpecializationState::getValues() const {
+  return mValues;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+SpecializationState SpecializationState::getSubset(
+    std::vector<ShaderModulePtr> const& modules) const {
+
+  SpecializationState subset;
+
+  if (mValues.empty()) {
+    return subset;
+  }
+
+  for (auto const& module : modules) {
+    for (auto const& constant : module->getSpecializationConstants()) {
+      auto value = mValues.find(constant.mConstantID);
+      if (value != mValues.end() && constant.mSize == sizeof(uint32_t)) {
+        subset.mValues[value->first] = value->second;
+      }
+    }
+  }
+
+  return subset;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+SpecializationState::Info SpecializationState::getInfo(ShaderModulePtr const& module) const {
+  Info info;
+
+  for (auto const& constant : module->getSpecializationConstants()) {
+    auto value = mValues.find(constant.mConstantID);
+    if (value != mValues.end() && constant.mSize == sizeof(uint32_t)) {
+      info.mEntries.emplace_back(constant.mConstantID,
+          static_cast<uint32_t>(info.mData.size() * sizeof(uint32_t)), sizeof(uint32_t));
+      info.mData.push_back(value->second);
+    }
+  }
+
+  return info;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+Core::BitHash SpecializationState::getHash() const {
+  Core::BitHash hash;
+
+  for (auto const& value : mValues) {
+    hash.push<32>(value.first);
+    hash.push<32>(value.second);
+  }
+
+  return hash;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void SpecializationState::serialize(std::vector<uint8_t>& data) const {
+  write(data, static_cast<uint32_t>(mValues.size()));
+
+  for (auto const& value : mValues) {
+    write(data, value.first);
+    write(data, value.second);
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+bool SpecializationState::deserialize(std::vector<uint8_t> const& data, size_t& offset) {
+  uint32_t count;
+  if (!read(data, offset, count)) {
+    return false;
+  }
+
+  mValues.clear();
+
+  for (uint32_t i(0); i < count; ++i) {
+    uint32_t constantID, value;
+    if (!read(data, offset, constantID) || !read(data, offset, value)) {
+      return false;
+    }
+    mValues[constantID] = value;
+  }
+
+  return true;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+} // namespace Illusion::Graphics
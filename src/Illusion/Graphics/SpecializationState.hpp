@@ -0,0 +1,78 @@
+////////////////////////////////////////////////////////////////////////////////////////////////////
+//                                                                                                //
+//    _)  |  |            _)                This code may be used and modified under the terms    //
+//     |  |  |  |  | (_-<  |   _ \    \     of the MIT license. See the LICENSE file for details. //
+//    _| _| _| \_,_| ___/ _| \___/ _| _|    Copyright (c) 2018-2019 Simon Schneegans              //
+//                                                                                                //
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#ifndef ILLUSION_GRAPHICS_SPECIALIZATION_STATE_HPP
+#define ILLUSION_GRAPHICS_SPECIALIZATION_STATE_HPP
+
+#include "fwd.hpp"
+
+#include "../Core/BitHash.hpp"
+
+#include <map>
+#include <vector>
+
+namespace Illusion::Graphics {
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// The SpecializationState stores values for specialization constants, identified by their        //
+// constant_id. It is used as a member of each CommandBuffer, the values are applied to all       //
+// pipelines created for draw and dispatch calls. A value is only used for the ShaderModules      //
+// which declare a constant with its id (see ShaderModule::getSpecializationConstants()), so      //
+// values do not cause additional pipelines for Shaders which do not use them. Constants without  //
+// a value keep the default given in the shader source.                                           //
+// Only 32 bit constants (bool, int, uint and float) are supported.                               //
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+class SpecializationState {
+ public:
+  // The data of a vk::SpecializationInfo.
+  struct Info {
+    std::vector<vk::SpecializationMapEntry> mEntries;
+    std::vector<uint32_t>                   mData;
+  };
+
+  // Sets the value of the constant with the given constant_id. Booleans are stored as VkBool32.
+  void set(uint32_t constantID, bool value);
+  void set(uint32_t constantID, int32_t value);
+  void set(uint32_t constantID, uint32_t value);
+  void set(uint32_t constantID, float value);
+
+  // Removes the value of the given constant, the default of the shader source will be used again.
+  void reset(uint32_t constantID);
+
+  // Removes all values.
+  void clear();
+
+  // Returns the values as raw 32 bit words.
+  std::map<uint32_t, uint32_t> const& getValues() const;
+
+  // Returns a state which only contains the values of constants declared by the given modules.
+  SpecializationState getSubset(std::vector<ShaderModulePtr> const& modules) const;
+
+  // Returns the vk::SpecializationInfo data for the given module. Only the constants declared by
+  // the module are included.
+  Info getInfo(ShaderModulePtr const& module) const;
+
+  // -----------------------------------------------------------------------------------------------
+  Core::BitHash getHash() const;
+
+  // Appends a binary representation of all values to the given data. This is used by the
+  // PipelineCache to store specializations in its manifest.
+  void serialize(std::vector<uint8_t>& data) const;
+
+  // Reads the values written by serialize() starting at the given offset. The offset is advanced
+  // accordingly. Returns false if the data is truncated; the state is undefined then.
+  bool deserialize(std::vector<uint8_t> const& data, size_t& offset);
+
+ private:
+  std::map<uint32_t, uint32_t> mValues;
+};
+
+} // namespace Illusion::Graphics
+
+#endif // ILLUSION_GRAPHICS_SPECIALIZATION_STATE_HPP
@@ -0,0 +1,383 @@
+////////////////////////////////////////////////////////////////////////////////////////////////////
+//                                                                                                //
+//    _)  |  |            _)                This code may be used and modified under the terms    //
+//     |  |  |  |  | (_-<  |   _ \    \     of the MIT license. See the LICENSE file for details. //
+//    _| _| _| \_,_| ___/ _| \___/ _| _|    Copyright (c) 2018-2019 Simon Schneegans              //
+//                                                                                                //
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include "SubmissionBatcher.hpp"
+
+#include "../Core/EnumCast.hpp"
+#include "../Core/Logger.hpp"
+#include "../Core/Tracer.hpp"
+#include "CommandBuffer.hpp"
+#include "DeletionQueue.hpp"
+#include "Device.hpp"
+#include "FrameStatistics.hpp"
+#include "PhysicalDevice.hpp"
+#include "QueuePool.hpp"
+#include "UploadManager.hpp"
+
+#include <iostream>
+
+namespace Illusion::Graphics {
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+SubmissionBatcher::SubmissionBatcher(Device const* device)
+    : mDevice(device) {
+
+  ILLUSION_TRACE << "Creating SubmissionBatcher." << std::endl;
+
+  if (mDevice->getPhysicalDevice()->supportsTimelineSemaphores()) {
+    auto const& vkDevice = mDevice->getHandle();
+
+    mGetSemaphoreCounterValue = (PFN_vkGetSemaphoreCounterValueKHR)vkDevice->getProcAddr(
+        "vkGetSemaphoreCounterValueKHR");
+    mWaitSemaphores = (PFN_vkWaitSemaphoresKHR)vkDevice->getProcAddr("vkWaitSemaphoresKHR");
+
+    for (auto& timeline : mTimelines) {
+      timeline.mSemaphore = mDevice->createTimelineSemaphore(0);
+    }
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+SubmissionBatcher::~SubmissionBatcher() {
+  ILLUSION_TRACE << "Deleting SubmissionBatcher." << std::endl;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+uint64_t SubmissionBatcher::enqueue(CommandBufferPtr const& cmd,
+    vk::ArrayProxy<const vk::Semaphore> const&          waitSemaphores,
+    vk::ArrayProxy<const vk::PipelineStageFlags> const& waitStages,
+    vk::ArrayProxy<const vk::Semaphore> const&          signalSemaphores) {
+
+  if (waitSemaphores.size() != waitStages.size()) {
+    throw std::runtime_error("Failed to enqueue CommandBuffer: The number of wait semaphores and "
+                             "wait stages does not match!");
+  }
+
+  std::unique_lock<std::mutex> lock(mMutex);
+
+  auto& timeline = mTimelines[Core::enumCast(cmd->getQueueType())];
+
+  Submission submission;
+  submission.mCmd         = *cmd->getHandle();
+  submission.mFirstWait   = static_cast<uint32_t>(timeline.mWaitSemaphores.size());
+  submission.mFirstSignal = static_cast<uint32_t>(timeline.mSignalSemaphores.size());
+
+  timeline.mWaitSemaphores.insert(
+      timeline.mWaitSemaphores.end(), waitSemaphores.begin(), waitSemaphores.end());
+  timeline.mWaitStages.insert(timeline.mWaitStages.end(), waitStages.begin(), waitStages.end());
+  timeline.mWaitValues.resize(timeline.mWaitSemaphores.size(), 0);
+
+  timeline.mWaitSemaphores.insert(timeline.mWaitSemaphores.end(),
+      timeline.mPendingWaitSemaphores.begin(), timeline.mPendingWaitSemaphores.end());
+  timeline.mWaitStages.insert(timeline.mWaitStages.end(), timeline.mPendingWaitStages.begin(),
+      timeline.mPendingWaitStages.end());
+  timeline.mWaitValues.insert(timeline.mWaitValues.end(), timeline.mPendingWaitValues.begin(),
+      timeline.mPendingWaitValues.end());
+
+  timeline.mPendingWaitSemaphores.clear();
+  timeline.mPendingWaitStages.clear();
+  timeline.mPendingWaitValues.clear();
+
+  timeline.mSignalSemaphores.insert(
+      timeline.mSignalSemaphores.end(), signalSemaphores.begin(), signalSemaphores.end());
+  timeline.mSignalValues.resize(timeline.mSignalSemaphores.size(), 0);
+
+  uint64_t value = timeline.mNextValue++;
+
+  // objects released from now on are not destroyed before this CommandBuffer has finished
+  mDevice->getDeletionQueue()->setEnqueuedValue(cmd->getQueueType(), value);
+
+  // each submission signals the timeline, so that the progress can be tracked per CommandBuffer
+  if (timeline.mSemaphore) {
+    timeline.mSignalSemaphores.push_back(*timeline.mSemaphore);
+    timeline.mSignalValues.push_back(value);
+  }
+
+  submission.mWaitCount =
+      static_cast<uint32_t>(timeline.mWaitSemaphores.size()) - submission.mFirstWait;
+  submission.mSignalCount =
+      static_cast<uint32_t>(timeline.mSignalSemaphores.size()) - submission.mFirstSignal;
+
+  timeline.mSubmissions.push_back(submission);
+  timeline.mCommandBuffers.push_back(cmd);
+
+  return value;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void SubmissionBatcher::addTimelineWait(
+    QueueType type, QueueType srcType, uint64_t value, vk::PipelineStageFlags stages) {
+
+  auto const& source = mTimelines[Core::enumCast(srcType)];
+
+  if (!source.mSemaphore) {
+    throw std::runtime_error(
+        "Failed to add timeline wait: VK_KHR_timeline_semaphore is not supported!");
+  }
+
+  std::unique_lock<std::mutex> lock(mMutex);
+
+  // a wait-before-signal is not allowed, the source value has to be submitted first
+  if (value > source.mSubmittedValue) {
+    flushImpl(srcType, nullptr);
+  }
+
+  auto& timeline = mTimelines[Core::enumCast(type)];
+  timeline.mPendingWaitSemaphores.push_back(*source.mSemaphore);
+  timeline.mPendingWaitStages.push_back(stages);
+  timeline.mPendingWaitValues.push_back(value);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+uint64_t SubmissionBatcher::flush(QueueType type, vk::Fence const& fence) {
+  uint64_t value;
+
+  {
+    std::unique_lock<std::mutex> lock(mMutex);
+    value = flushImpl(type, fence);
+  }
+
+  // the destruction functions are called without holding the lock
+  mDevice->getDeletionQueue()->releaseCompleted();
+
+  return value;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void SubmissionBatcher::flush() {
+  {
+    std::unique_lock<std::mutex> lock(mMutex);
+
+    for (size_t i(0); i < mTimelines.size(); ++i) {
+      flushImpl(static_cast<QueueType>(i), nullptr);
+    }
+  }
+
+  mDevice->getDeletionQueue()->releaseCompleted();
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+uint64_t SubmissionBatcher::getCompletedValue(QueueType type) {
+  std::unique_lock<std::mutex> lock(mMutex);
+  return getCompletedValueImpl(type);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+bool SubmissionBatcher::wait(QueueType type, uint64_t value, uint64_t timeout) {
+  ILLUSION_ZONE("SubmissionBatcher::wait");
+
+  std::unique_lock<std::mutex> lock(mMutex);
+
+  auto& timeline = mTimelines[Core::enumCast(type)];
+
+  if (value >= timeline.mNextValue) {
+    throw std::runtime_error("Failed to wait for value " + std::to_string(value) +
+                             ": It has not been enqueued yet!");
+  }
+
+  if (value > timeline.mSubmittedValue) {
+    flushImpl(type, nullptr);
+  }
+
+  if (value <= getCompletedValueImpl(type)) {
+    return true;
+  }
+
+  vk::Result result;
+
+  if (timeline.mSemaphore) {
+    vk::SemaphoreWaitInfoKHR info;
+    info.semaphoreCount = 1;
+    info.pSemaphores    = timeline.mSemaphore.get();
+    info.pValues        = &value;
+
+    lock.unlock();
+    result = static_cast<vk::Result>(mWaitSemaphores(*mDevice->getHandle(),
+        reinterpret_cast<VkSemaphoreWaitInfo*>(&info), timeout));
+  } else {
+    // the first fence whose value is at least the requested one; it is not recycled while it is
+    // referenced here
+    vk::FencePtr fence;
+    for (auto const& inFlight : timeline.mInFlightFences) {
+      if (inFlight.first >= value) {
+        fence = inFlight.second;
+        break;
+      }
+    }
+
+    lock.unlock();
+    result = mDevice->getHandle()->waitForFences(*fence, true, timeout);
+  }
+
+  if (result != vk::Result::eSuccess) {
+    return false;
+  }
+
+  // objects which have been waiting for the value can be destroyed now
+  lock.lock();
+  getCompletedValueImpl(type);
+  lock.unlock();
+
+  mDevice->getDeletionQueue()->releaseCompleted();
+
+  return true;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+vk::SemaphorePtr const& SubmissionBatcher::getTimelineSemaphore(QueueType type) const {
+  return mTimelines[Core::enumCast(type)].mSemaphore;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+uint64_t SubmissionBatcher::flushImpl(QueueType type, vk::Fence const& fence) {
+  ILLUSION_ZONE("SubmissionBatcher::flush");
+
+  auto& timeline = mTimelines[Core::enumCast(type)];
+
+  if (timeline.mSubmissions.empty()) {
+    if (fence) {
+      mDevice->getQueuePool()->lock(type)->submit(nullptr, fence);
+    }
+    return timeline.mSubmittedValue;
+  }
+
+  // Make sure that all pending uploads are submitted before; their barriers make the uploaded
+  // resources available to the CommandBuffers of this batch.
+  mDevice->getUploadManager()->flush();
+
+  size_t count = timeline.mSubmissions.size();
+  mSubmitInfos.resize(count);
+  mTimelineInfos.resize(count);
+
+  for (size_t i(0); i < count; ++i) {
+    auto const& submission = timeline.mSubmissions[i];
+
+    auto& info                = mSubmitInfos[i];
+    info                      = vk::SubmitInfo();
+    info.waitSemaphoreCount   = submission.mWaitCount;
+    info.pWaitSemaphores      = timeline.mWaitSemaphores.data() + submission.mFirstWait;
+    info.pWaitDstStageMask    = timeline.mWaitStages.data() + submission.mFirstWait;
+    info.commandBufferCount   = 1;
+    info.pCommandBuffers      = &submission.mCmd;
+    info.signalSemaphoreCount = submission.mSignalCount;
+    info.pSignalSemaphores    = timeline.mSignalSemaphores.data() + submission.mFirstSignal;
+
+    if (timeline.mSemaphore) {
+      auto& timelineInfo                     = mTimelineInfos[i];
+      timelineInfo                           = vk::TimelineSemaphoreSubmitInfoKHR();
+      timelineInfo.waitSemaphoreValueCount   = submission.mWaitCount;
+      timelineInfo.pWaitSemaphoreValues      = timeline.mWaitValues.data() + submission.mFirstWait;
+      timelineInfo.signalSemaphoreValueCount = submission.mSignalCount;
+      timelineInfo.pSignalSemaphoreValues = timeline.mSignalValues.data() + submission.mFirstSignal;
+
+      info.pNext = &timelineInfo;
+    }
+  }
+
+  uint64_t lastValue = timeline.mNextValue - 1;
+
+  // the timeline values have to be signaled in order, so always the same queue is used
+  auto queue = mDevice->getQueuePool()->lock(type);
+
+  if (timeline.mSemaphore) {
+    queue->submit(mSubmitInfos, fence);
+  } else {
+    vk::FencePtr batchFence;
+
+    if (timeline.mFreeFences.empty()) {
+      batchFence = mDevice->createFence(vk::FenceCreateFlags());
+    } else {
+      batchFence = timeline.mFreeFences.back();
+      timeline.mFreeFences.pop_back();
+    }
+
+    queue->submit(mSubmitInfos, *batchFence);
+    timeline.mInFlightFences.emplace_back(lastValue, batchFence);
+
+    // an empty submission signals the fence once all previously submitted work has finished
+    if (fence) {
+      queue->submit(nullptr, fence);
+    }
+  }
+
+  mDevice->getFrameStatistics()->add(&FrameStatistics::Counters::mSubmits);
+
+  timeline.mSubmittedValue = lastValue;
+
+  // the CommandBuffers of the batch have consecutive values ending at lastValue
+  uint64_t value = lastValue - count + 1;
+  for (auto& cmd : timeline.mCommandBuffers) {
+    timeline.mInFlightCommandBuffers.emplace_back(value++, std::move(cmd));
+  }
+
+  timeline.mSubmissions.clear();
+  timeline.mCommandBuffers.clear();
+  timeline.mWaitSemaphores.clear();
+  timeline.mWaitStages.clear();
+  timeline.mWaitValues.clear();
+  timeline.mSignalSemaphores.clear();
+  timeline.mSignalValues.clear();
+
+  // releases the CommandBuffers of previous batches which have finished in the meantime
+  getCompletedValueImpl(type);
+
+  return lastValue;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+uint64_t SubmissionBatcher::getCompletedValueImpl(QueueType type) {
+  auto& timeline = mTimelines[Core::enumCast(type)];
+
+  if (timeline.mSemaphore) {
+    uint64_t value = 0;
+    mGetSemaphoreCounterValue(*mDevice->getHandle(), *timeline.mSemaphore, &value);
+    timeline.mCompletedValue = value;
+  } else {
+    while (!timeline.mInFlightFences.empty()) {
+      auto const& inFlight = timeline.mInFlightFences.front();
+
+      if (mDevice->getHandle()->getFenceStatus(*inFlight.second) != vk::Result::eSuccess) {
+        break;
+      }
+
+      timeline.mCompletedValue = inFlight.first;
+
+      // fences which are waited for by wait() are not reused
+      if (inFlight.second.use_count() == 1) {
+        mDevice->getHandle()->resetFences(*inFlight.second);
+        timeline.mFreeFences.push_back(inFlight.second);
+      }
+
+      timeline.mInFlightFences.pop_front();
+    }
+  }
+
+  while (!timeline.mInFlightCommandBuffers.empty() &&
+         timeline.mInFlightCommandBuffers.front().first <= timeline.mCompletedValue) {
+    timeline.mInFlightCommandBuffers.pop_front();
+  }
+
+  mDevice->getDeletionQueue()->setCompletedValue(type, timeline.mCompletedValue);
+
+  return timeline.mCompletedValue;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+} // namespace Illusion::Graphics
@@ -0,0 +1,146 @@
+////////////////////////////////////////////////////////////////////////////////////////////////////
+//                                                                                                //
+//    _)  |  |            _)                This code may be used and modified under the terms    //
+//     |  |  |  |  | (_-<  |   _ \    \     of the MIT license. See the LICENSE file for details. //
+//    _| _| _| \_,_| ___/ _| \___/ _| _|    Copyright (c) 2018-2019 Simon Schneegans              //
+//                                                                                                //
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#ifndef ILLUSION_GRAPHICS_SUBMISSION_BATCHER_HPP
+#define ILLUSION_GRAPHICS_SUBMISSION_BATCHER_HPP
+
+#include "fwd.hpp"
+
+#include <array>
+#include <deque>
+#include <mutex>
+#include <vector>
+
+namespace Illusion::Graphics {
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// The SubmissionBatcher collects CommandBuffers together with the semaphores they wait for and   //
+// signal. flush() submits all CommandBuffers of one QueueType with a single vkQueueSubmit, one   //
+// vk::SubmitInfo per CommandBuffer. The arrays of the batches are reused, so enqueueing does not //
+// allocate once they have grown large enough.                                                    //
+// Each QueueType has a timeline of increasing values. enqueue() returns the value which is       //
+// reached once the CommandBuffer has finished execution. If VK_KHR_timeline_semaphore is         //
+// supported, each submission signals a timeline semaphore with its value, so the progress can be //
+// queried without fences and other QueueTypes can wait for a value with addTimelineWait(). Else  //
+// a vk::Fence is submitted with each batch; addTimelineWait() throws in this case. All methods   //
+// are thread-safe.                                                                               //
+// Submitted CommandBuffers are kept alive until the timeline has reached their value; this is    //
+// checked whenever a batch is flushed or the completed value is queried. The enqueued and        //
+// completed values are reported to the DeletionQueue of the Device, so that objects used by      //
+// these submissions are not destroyed before they have finished.                                 //
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+class SubmissionBatcher {
+
+ public:
+  // Syntactic sugar to create a std::shared_ptr for this class
+  template <typename... Args>
+  static SubmissionBatcherPtr create(Args&&... args) {
+    return std::make_shared<SubmissionBatcher>(args...);
+  };
+
+  // The SubmissionBatcher is owned by the given Device, hence it only stores a raw pointer to it.
+  explicit SubmissionBatcher(Device const* device);
+  virtual ~SubmissionBatcher();
+
+  // Adds the given CommandBuffer to the batch of its QueueType. It has to be ended already and is
+  // kept alive until it has finished execution. Each wait semaphore needs a corresponding wait stage.
+  // The returned value is reached on the timeline of the QueueType once the CommandBuffer has
+  // finished execution.
+  uint64_t enqueue(CommandBufferPtr const&              cmd,
+      vk::ArrayProxy<const vk::Semaphore> const&          waitSemaphores   = nullptr,
+      vk::ArrayProxy<const vk::PipelineStageFlags> const& waitStages       = nullptr,
+      vk::ArrayProxy<const vk::Semaphore> const&          signalSemaphores = nullptr);
+
+  // The next CommandBuffer enqueued for the given QueueType waits in the given stages until the
+  // timeline of srcType has reached the value. This requires VK_KHR_timeline_semaphore.
+  void addTimelineWait(
+      QueueType type, QueueType srcType, uint64_t value, vk::PipelineStageFlags stages);
+
+  // Submits all CommandBuffers enqueued for the given QueueType. The optional fence is signaled
+  // once all of them have finished execution. Pending uploads of the UploadManager are flushed
+  // before. Returns the last value of the timeline which has been submitted.
+  uint64_t flush(QueueType type, vk::Fence const& fence = nullptr);
+
+  // Flushes the batches of all QueueTypes.
+  void flush();
+
+  // Returns the last value of the timeline of the given QueueType which has been reached by the
+  // GPU. This does not block.
+  uint64_t getCompletedValue(QueueType type);
+
+  // Blocks until the timeline of the given QueueType has reached the value or the timeout (in
+  // nanoseconds) has elapsed; returns false in the latter case. The batch is flushed if the value
+  // has not been submitted yet.
+  bool wait(QueueType type, uint64_t value, uint64_t timeout = ~0);
+
+  // This is nullptr if VK_KHR_timeline_semaphore is not supported by the PhysicalDevice. It can be
+  // used to wait for the timeline in submissions which are not issued by this SubmissionBatcher.
+  vk::SemaphorePtr const& getTimelineSemaphore(QueueType type) const;
+
+ private:
+  struct Submission {
+    vk::CommandBuffer mCmd;
+    uint32_t          mFirstWait   = 0;
+    uint32_t          mWaitCount   = 0;
+    uint32_t          mFirstSignal = 0;
+    uint32_t          mSignalCount = 0;
+  };
+
+  struct Timeline {
+    vk::SemaphorePtr mSemaphore;
+    uint64_t         mNextValue      = 1;
+    uint64_t         mSubmittedValue = 0;
+    uint64_t         mCompletedValue = 0;
+
+    // The batch of enqueued CommandBuffers; the wait and signal values belong to the semaphores
+    // with the same index. Values of binary semaphores are ignored.
+    std::vector<Submission>             mSubmissions;
+    std::vector<CommandBufferPtr>       mCommandBuffers;
+    std::vector<vk::Semaphore>          mWaitSemaphores;
+    std::vector<vk::PipelineStageFlags> mWaitStages;
+    std::vector<uint64_t>               mWaitValues;
+    std::vector<vk::Semaphore>          mSignalSemaphores;
+    std::vector<uint64_t>               mSignalValues;
+
+    // Waits added by addTimelineWait() which are consumed by the next enqueue().
+    std::vector<vk::Semaphore>          mPendingWaitSemaphores;
+    std::vector<vk::PipelineStageFlags> mPendingWaitStages;
+    std::vector<uint64_t>               mPendingWaitValues;
+
+    // The CommandBuffers of submitted batches together with their timeline values. They are kept
+    // alive until the GPU has reached the value.
+    std::deque<std::pair<uint64_t, CommandBufferPtr>> mInFlightCommandBuffers;
+
+    // These are only used without VK_KHR_timeline_semaphore. The fences are recycled once the GPU
+    // has reached their value.
+    std::deque<std::pair<uint64_t, vk::FencePtr>> mInFlightFences;
+    std::vector<vk::FencePtr>                     mFreeFences;
+  };
+
+  uint64_t flushImpl(QueueType type, vk::Fence const& fence);
+  uint64_t getCompletedValueImpl(QueueType type);
+
+  Device const* mDevice;
+
+  PFN_vkGetSemaphoreCounterValueKHR mGetSemaphoreCounterValue = nullptr;
+  PFN_vkWaitSemaphoresKHR           mWaitSemaphores           = nullptr;
+
+  // One for each QueueType
+  std::array<Timeline, 3> mTimelines;
+
+  // These are reused by all flushes.
+  std::vector<vk::SubmitInfo>                     mSubmitInfos;
+  std::vector<vk::TimelineSemaphoreSubmitInfoKHR> mTimelineInfos;
+
+  std::mutex mMutex;
+};
+
+} // namespace Illusion::Graphics
+
+#endif // ILLUSION_GRAPHICS_SUBMISSION_BATCHER_HPP
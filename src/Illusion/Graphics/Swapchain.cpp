@@ -9,9 +9,13 @@
 #include "Swapchain.hpp"
 
 #include "../Core/Logger.hpp"
+#include "../Core/Timer.hpp"
+#include "../Core/Tracer.hpp"
 #include "BackedImage.hpp"
 #include "CommandBuffer.hpp"
 #include "PhysicalDevice.hpp"
+#include "QueuePool.hpp"
+#include "VulkanPtr.hpp"
 #include "Window.hpp"
 
 #include <iostream>
@@ -44,6 +48,36 @@ void Swapchain::setEnableVsync(bool enable) {
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////
 
+void Swapchain::setEnableRelaxedVsync(bool enable) {
+  if (enable != mEnableRelaxedVsync) {
+    mEnableRelaxedVsync = enable;
+    markDirty();
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void Swapchain::setImageCount(uint32_t count) {
+  if (count != mImageCount) {
+    mImageCount = count;
+    markDirty();
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+uint32_t Swapchain::getImageCount() const {
+  return static_cast<uint32_t>(mImages.size());
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+Swapchain::Timings const& Swapchain::getTimings() const {
+  return mTimings;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
 void Swapchain::markDirty() {
   mDirty = true;
 }
@@ -56,58 +90,64 @@ glm::uvec2 const& Swapchain::getExtent() const {
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////
 
-void Swapchain::present(BackedImagePtr const& image,
-    vk::SemaphorePtr const& renderFinishedSemaphore, vk::FencePtr const& signalFence) {
+vk::Format Swapchain::getFormat() const {
+  return mFormat.format;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
 
+bool Swapchain::supportsDirectRendering(BackedImagePtr const& image) {
   if (mDirty) {
-    mDevice->waitIdle();
-
-    // delete old one first
-    mSwapchain.reset();
-    mImageAvailableSemaphores.clear();
-    mCopyFinishedSemaphores.clear();
-    mPresentCommandBuffers.clear();
-
-    // then create new one
-    chooseExtent();
-    chooseFormat();
-    createSwapchain();
-
-    mImages = mDevice->getHandle()->getSwapchainImagesKHR(*mSwapchain);
-
-    auto cmd = std::make_shared<CommandBuffer>(mDevice);
-    cmd->begin(vk::CommandBufferUsageFlagBits::eOneTimeSubmit);
-    for (auto const& image : mImages) {
-      cmd->transitionImageLayout(image, vk::ImageLayout::eUndefined,
-          vk::ImageLayout::ePresentSrcKHR, vk::PipelineStageFlagBits::eTopOfPipe,
-          vk::PipelineStageFlagBits::eTransfer);
-    }
-    cmd->end();
-    cmd->submit();
-    cmd->waitIdle();
+    recreate();
+  }
 
-    createSemaphores();
-    createCommandBuffers();
+  glm::uvec2 extent(image->mImageInfo.extent.width, image->mImageInfo.extent.height);
 
-    mDirty = false;
-  }
+  return (mUsage & vk::ImageUsageFlagBits::eColorAttachment) &&
+         image->mImageInfo.format == mFormat.format && extent == mExtent &&
+         image->mImageInfo.samples == vk::SampleCountFlagBits::e1;
+}
 
-  mCurrentPresentIndex = (mCurrentPresentIndex + 1) % mImages.size();
+////////////////////////////////////////////////////////////////////////////////////////////////////
 
-  auto result =
-      mDevice->getHandle()->acquireNextImageKHR(*mSwapchain, std::numeric_limits<uint64_t>::max(),
-          *mImageAvailableSemaphores[mCurrentPresentIndex], nullptr, &mCurrentImageIndex);
+uint64_t Swapchain::getGeneration() const {
+  return mGeneration;
+}
 
-  if (result == vk::Result::eErrorOutOfDateKHR) {
-    // mark dirty and call this method again
-    mDirty = true;
-    present(image, renderFinishedSemaphore, signalFence);
-  }
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+BackedImagePtr const& Swapchain::acquireImage() {
+  acquireNextImage();
 
-  if (result != vk::Result::eSuccess && result != vk::Result::eSuboptimalKHR) {
-    ILLUSION_ERROR << "Suboptimal swap chain!" << std::endl;
+  if (!(mUsage & vk::ImageUsageFlagBits::eColorAttachment)) {
+    throw std::runtime_error("Failed to acquire swapchain image: The surface does not support "
+                             "rendering to the swapchain images!");
   }
 
+  return mBackedImages[mCurrentImageIndex];
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+vk::SemaphorePtr const& Swapchain::getImageAvailableSemaphore() const {
+  return mImageAvailableSemaphores[mCurrentPresentIndex];
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void Swapchain::present(vk::SemaphorePtr const& renderFinishedSemaphore) {
+  ILLUSION_ZONE("Swapchain::present");
+  presentCurrentImage(*renderFinishedSemaphore);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void Swapchain::present(BackedImagePtr const& image,
+    vk::SemaphorePtr const& renderFinishedSemaphore, vk::FencePtr const& signalFence) {
+  ILLUSION_ZONE("Swapchain::present");
+
+  acquireNextImage();
+
   // copy image ------------------------------------------------------------------------------------
   {
     auto const& cmd = mPresentCommandBuffers[mCurrentPresentIndex];
@@ -143,9 +183,10 @@ void Swapchain::present(BackedImagePtr const& image,
           vk::ImageLayout::eTransferDstOptimal, vk::PipelineStageFlagBits::eTransfer,
           vk::PipelineStageFlagBits::eTransfer);
       vk::ImageBlit info;
-      cmd->blitImage(*image->mImage, mImages[mCurrentImageIndex],
-          {image->mImageInfo.extent.width, image->mImageInfo.extent.height}, mExtent,
-          vk::Filter::eNearest);
+      // images which are rendered at a lower resolution are upscaled with bilinear filtering
+      glm::uvec2 extent(image->mImageInfo.extent.width, image->mImageInfo.extent.height);
+      cmd->blitImage(*image->mImage, mImages[mCurrentImageIndex], extent, mExtent,
+          extent == mExtent ? vk::Filter::eNearest : vk::Filter::eLinear);
       cmd->transitionImageLayout(*image->mImage, vk::ImageLayout::eTransferSrcOptimal,
           vk::ImageLayout::eColorAttachmentOptimal, vk::PipelineStageFlagBits::eTransfer,
           vk::PipelineStageFlagBits::eColorAttachmentOutput);
@@ -161,34 +202,109 @@ void Swapchain::present(BackedImagePtr const& image,
         {*mCopyFinishedSemaphores[mCurrentPresentIndex]}, *signalFence);
   }
 
-  // present on mOutputWindow ----------------------------------------------------------------------
-  {
-    vk::SwapchainKHR swapChains[]     = {*mSwapchain};
-    vk::Semaphore    waitSemaphores[] = {*mCopyFinishedSemaphores[mCurrentPresentIndex]};
-
-    vk::PresentInfoKHR presentInfo;
-    presentInfo.waitSemaphoreCount = 1;
-    presentInfo.pWaitSemaphores    = waitSemaphores;
-    presentInfo.swapchainCount     = 1;
-    presentInfo.pSwapchains        = swapChains;
-    presentInfo.pImageIndices      = &mCurrentImageIndex;
-
-    try {
-      result = mDevice->getQueue(QueueType::eGeneric).presentKHR(presentInfo);
-
-      if (result == vk::Result::eErrorOutOfDateKHR || result == vk::Result::eSuboptimalKHR) {
-        // when does this happen?
-        ILLUSION_ERROR << "out of date 1!" << std::endl;
-      } else if (result != vk::Result::eSuccess) {
-        // when does this happen?
-        ILLUSION_ERROR << "out of date 2!" << std::endl;
-      }
-    } catch (...) { mDirty = true; }
+  presentCurrentImage(*mCopyFinishedSemaphores[mCurrentPresentIndex]);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void Swapchain::recreate() {
+  mDevice->waitIdle();
+
+  // delete old one first
+  mBackedImages.clear();
+  mSwapchain.reset();
+  mImageAvailableSemaphores.clear();
+  mCopyFinishedSemaphores.clear();
+  mPresentCommandBuffers.clear();
+
+  // then create new one
+  chooseExtent();
+  chooseFormat();
+  createSwapchain();
+
+  mImages = mDevice->getHandle()->getSwapchainImagesKHR(*mSwapchain);
+
+  auto cmd = std::make_shared<CommandBuffer>(mDevice);
+  cmd->begin(vk::CommandBufferUsageFlagBits::eOneTimeSubmit);
+  for (auto const& image : mImages) {
+    cmd->transitionImageLayout(image, vk::ImageLayout::eUndefined, vk::ImageLayout::ePresentSrcKHR,
+        vk::PipelineStageFlagBits::eTopOfPipe, vk::PipelineStageFlagBits::eTransfer);
+  }
+  cmd->end();
+  cmd->submit();
+  cmd->waitIdle();
+
+  createBackedImages();
+  createSemaphores();
+  createCommandBuffers();
+
+  mDirty = false;
+  ++mGeneration;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void Swapchain::acquireNextImage() {
+  while (true) {
+    if (mDirty) {
+      recreate();
+    }
+
+    mCurrentPresentIndex = (mCurrentPresentIndex + 1) % mImages.size();
+
+    double waitStart = Core::Timer::getNow();
+
+    auto result =
+        mDevice->getHandle()->acquireNextImageKHR(*mSwapchain, std::numeric_limits<uint64_t>::max(),
+            *mImageAvailableSemaphores[mCurrentPresentIndex], nullptr, &mCurrentImageIndex);
+
+    mAcquireTime              = Core::Timer::getNow();
+    mTimings.mAcquireWaitTime = mAcquireTime - waitStart;
+
+    // re-create the swapchain and try again
+    if (result == vk::Result::eErrorOutOfDateKHR) {
+      mDirty = true;
+      continue;
+    }
+
+    if (result != vk::Result::eSuccess && result != vk::Result::eSuboptimalKHR) {
+      ILLUSION_ERROR << "Suboptimal swap chain!" << std::endl;
+    }
+
+    return;
   }
 }
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////
 
+void Swapchain::presentCurrentImage(vk::Semaphore const& waitSemaphore) {
+  vk::SwapchainKHR swapChains[]     = {*mSwapchain};
+  vk::Semaphore    waitSemaphores[] = {waitSemaphore};
+
+  vk::PresentInfoKHR presentInfo;
+  presentInfo.waitSemaphoreCount = 1;
+  presentInfo.pWaitSemaphores    = waitSemaphores;
+  presentInfo.swapchainCount     = 1;
+  presentInfo.pSwapchains        = swapChains;
+  presentInfo.pImageIndices      = &mCurrentImageIndex;
+
+  mTimings.mAcquireToPresentTime = Core::Timer::getNow() - mAcquireTime;
+
+  try {
+    auto result = mDevice->getQueuePool()->lock(QueueType::eGeneric)->presentKHR(presentInfo);
+
+    if (result == vk::Result::eErrorOutOfDateKHR || result == vk::Result::eSuboptimalKHR) {
+      // when does this happen?
+      ILLUSION_ERROR << "out of date 1!" << std::endl;
+    } else if (result != vk::Result::eSuccess) {
+      // when does this happen?
+      ILLUSION_ERROR << "out of date 2!" << std::endl;
+    }
+  } catch (...) { mDirty = true; }
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
 void Swapchain::chooseExtent() {
   auto capabilities = mDevice->getPhysicalDevice()->getSurfaceCapabilitiesKHR(*mSurface);
 
@@ -240,6 +356,15 @@ void Swapchain::createSwapchain() {
   // Fifo is actually required to be supported and is a decent choice for V-Sync
   vk::PresentModeKHR presentMode{vk::PresentModeKHR::eFifo};
 
+  if (mEnableVsync && mEnableRelaxedVsync) {
+    for (auto mode : presentModes) {
+      if (mode == vk::PresentModeKHR::eFifoRelaxed) {
+        presentMode = mode;
+        break;
+      }
+    }
+  }
+
   if (!mEnableVsync) {
     // Immediate is an option for no V-Sync but will result in tearing
     for (auto mode : presentModes) {
@@ -258,12 +383,26 @@ void Swapchain::createSwapchain() {
     }
   }
 
+  // The blit of present(image, ...) requires eTransferDst, direct rendering eColorAttachment. Only
+  // the supported usages are requested, supportsDirectRendering() reports the latter.
+  mUsage = capabilities.supportedUsageFlags &
+           (vk::ImageUsageFlagBits::eColorAttachment | vk::ImageUsageFlagBits::eTransferDst);
+
+  if (!(mUsage & vk::ImageUsageFlagBits::eTransferDst)) {
+    ILLUSION_WARNING << "The surface does not support blitting to the swapchain images!"
+                     << std::endl;
+  }
+
   // choose minimum image count
-  uint32_t imageCount = capabilities.minImageCount + 1;
+  uint32_t imageCount = mImageCount > 0 ? mImageCount : capabilities.minImageCount + 1;
+  imageCount          = std::max(imageCount, capabilities.minImageCount);
   if (capabilities.maxImageCount > 0 && imageCount > capabilities.maxImageCount) {
     imageCount = capabilities.maxImageCount;
   }
 
+  ILLUSION_TRACE << "Creating vk::SwapchainKHR with " << imageCount << " images and "
+                 << vk::to_string(presentMode) << "." << std::endl;
+
   vk::SwapchainCreateInfoKHR info;
   info.surface            = *mSurface;
   info.minImageCount      = imageCount;
@@ -272,13 +411,13 @@ void Swapchain::createSwapchain() {
   info.imageExtent.width  = mExtent.x;
   info.imageExtent.height = mExtent.y;
   info.imageArrayLayers   = 1;
-  info.imageUsage = vk::ImageUsageFlagBits::eColorAttachment | vk::ImageUsageFlagBits::eTransferDst;
-  info.preTransform     = capabilities.currentTransform;
-  info.compositeAlpha   = vk::CompositeAlphaFlagBitsKHR::eOpaque;
-  info.presentMode      = presentMode;
-  info.clipped          = true;
-  info.oldSwapchain     = nullptr; // this could be optimized
-  info.imageSharingMode = vk::SharingMode::eExclusive;
+  info.imageUsage         = mUsage;
+  info.preTransform       = capabilities.currentTransform;
+  info.compositeAlpha     = vk::CompositeAlphaFlagBitsKHR::eOpaque;
+  info.presentMode        = presentMode;
+  info.clipped            = true;
+  info.oldSwapchain       = nullptr; // this could be optimized
+  info.imageSharingMode   = vk::SharingMode::eExclusive;
 
   // this check should not be neccessary, but the validation layers complain
   // when only glfwGetPhysicalDevicePresentationSupport was used to check for
@@ -294,6 +433,42 @@ void Swapchain::createSwapchain() {
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////
 
+void Swapchain::createBackedImages() {
+  for (auto const& image : mImages) {
+    auto backedImage = std::make_shared<BackedImage>();
+
+    backedImage->mImageInfo.imageType     = vk::ImageType::e2D;
+    backedImage->mImageInfo.format        = mFormat.format;
+    backedImage->mImageInfo.extent.width  = mExtent.x;
+    backedImage->mImageInfo.extent.height = mExtent.y;
+    backedImage->mImageInfo.extent.depth  = 1;
+    backedImage->mImageInfo.mipLevels     = 1;
+    backedImage->mImageInfo.arrayLayers   = 1;
+    backedImage->mImageInfo.samples       = vk::SampleCountFlagBits::e1;
+    backedImage->mImageInfo.tiling        = vk::ImageTiling::eOptimal;
+    backedImage->mImageInfo.usage         = mUsage;
+
+    // the vk::Image is owned by the vk::SwapchainKHR, so it must not be destroyed
+    backedImage->mImage = VulkanPtr::create(image, [](vk::Image* obj) { delete obj; });
+
+    backedImage->mViewInfo.image                           = image;
+    backedImage->mViewInfo.viewType                        = vk::ImageViewType::e2D;
+    backedImage->mViewInfo.format                          = mFormat.format;
+    backedImage->mViewInfo.subresourceRange.aspectMask     = vk::ImageAspectFlagBits::eColor;
+    backedImage->mViewInfo.subresourceRange.baseMipLevel   = 0;
+    backedImage->mViewInfo.subresourceRange.levelCount     = 1;
+    backedImage->mViewInfo.subresourceRange.baseArrayLayer = 0;
+    backedImage->mViewInfo.subresourceRange.layerCount     = 1;
+
+    backedImage->mView          = mDevice->createImageView(backedImage->mViewInfo);
+    backedImage->mCurrentLayout = vk::ImageLayout::ePresentSrcKHR;
+
+    mBackedImages.push_back(backedImage);
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
 void Swapchain::createSemaphores() {
   for (auto const& i : mImages) {
     mImageAvailableSemaphores.push_back(mDevice->createSemaphore());
@@ -17,12 +17,30 @@ namespace Illusion::Graphics {
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////
 // This class is primarily as member of the Window class. It manages presentation of images on    //
-// the window's surface. The image given to the present() method will be blitted to the current   //
-// swapchain image.                                                                               //
+// the window's surface. There are two ways to present an image:                                  //
+// * The image given to present(image, ...) will be blitted to the current swapchain image. This  //
+//   works for any color format and resolution but costs a full-screen copy.                      //
+// * acquireImage() returns the next swapchain image which can be rendered directly, for example  //
+//   as RenderPass::Attachment::mImage. present(semaphore) presents it without any copy. This     //
+//   requires the output attachment to have the format returned by getFormat() and the surface to //
+//   support the color attachment usage; supportsDirectRendering() checks this for an image which //
+//   would be replaced by the swapchain image. FrameContext::acquireImage() uses it to choose     //
+//   between both ways automatically.                                                             //
 ////////////////////////////////////////////////////////////////////////////////////////////////////
 
 class Swapchain {
  public:
+  // Some timings of the last presented frame, in seconds.
+  struct Timings {
+    // The time the CPU was blocked in vkAcquireNextImageKHR.
+    double mAcquireWaitTime = 0.0;
+
+    // The time between the acquisition of the swapchain image and the call to vkQueuePresentKHR.
+    // When rendering directly into the swapchain images, this includes recording and submission of
+    // the frame.
+    double mAcquireToPresentTime = 0.0;
+  };
+
   // Syntactic sugar to create a std::shared_ptr for this class
   template <typename... Args>
   static SwapchainPtr create(Args&&... args) {
@@ -38,21 +56,72 @@ class Swapchain {
   // supported) are used.
   void setEnableVsync(bool enable);
 
+  // If enabled together with v-sync, vk::PresentModeKHR::eFifoRelaxed is used (if supported).
+  // Frames which miss a vertical blank are then presented immediately, which results in tearing
+  // instead of stuttering.
+  void setEnableRelaxedVsync(bool enable);
+
+  // The minimum number of swapchain images to request. Less images reduce the latency between
+  // rendering and display, more images increase the throughput. Zero (the default) requests one
+  // image more than the minimum supported by the surface. The value is clamped to the surface
+  // capabilities. This will trigger a re-creation of the Swapchain.
+  void setImageCount(uint32_t count);
+
+  // Returns the actual number of swapchain images. This is zero until the Swapchain has been
+  // created by acquireImage() or present().
+  uint32_t getImageCount() const;
+
+  Timings const& getTimings() const;
+
   // This will trigger a re-creation of the SwapChain. This is called by the Window on size changes.
   void markDirty();
 
   // Get the current size of the swapchain images.
   glm::uvec2 const& getExtent() const;
 
+  // Get the format of the swapchain images. This is valid once acquireImage() or present() has been
+  // called for the first time.
+  vk::Format getFormat() const;
+
+  // Returns true if the given image could be replaced by the swapchain images: it has the same
+  // format and size, is not multisampled and the surface supports rendering to the swapchain
+  // images. Else it has to be presented with present(image, ...). This creates the Swapchain if
+  // required.
+  bool supportsDirectRendering(BackedImagePtr const& image);
+
+  // This is incremented whenever the Swapchain is re-created. RenderPasses using the images of
+  // acquireImage() should be re-created when it changes.
+  uint64_t getGeneration() const;
+
+  // Acquires the next swapchain image for direct rendering. The returned image is in
+  // vk::ImageLayout::ePresentSrcKHR and has to be in this layout again when present() is called;
+  // use it as attachment with mFinalLayout set to ePresentSrcKHR. The CommandBuffer rendering to it
+  // has to wait for getImageAvailableSemaphore() at the eColorAttachmentOutput stage; hence the
+  // RenderPass should have an external dependency on this stage.
+  // The same BackedImages are returned until the Swapchain is re-created, so they can be used to
+  // cache RenderPasses as long as getGeneration() does not change. A std::runtime_error is thrown
+  // if the surface does not support rendering to the swapchain images.
+  BackedImagePtr const&   acquireImage();
+  vk::SemaphorePtr const& getImageAvailableSemaphore() const;
+
+  // Presents the image returned by the last call to acquireImage() once the given semaphore has
+  // been signaled.
+  void present(vk::SemaphorePtr const& renderFinishedSemaphore);
+
   // Blits the given image to one of the swapchain images. The operation will wait for the given
   // semaphore and will signal the given fence once it finishes.
   void present(BackedImagePtr const& image, vk::SemaphorePtr const& renderFinishedSemaphore,
       vk::FencePtr const& signalFence);
 
  private:
+  void recreate();
+  void acquireNextImage();
+  void presentCurrentImage(vk::Semaphore const& waitSemaphore);
+
   void chooseExtent();
   void chooseFormat();
   void createSwapchain();
+  void createBackedImages();
   void createSemaphores();
   void createCommandBuffers();
 
@@ -62,16 +131,24 @@ class Swapchain {
   vk::SurfaceFormatKHR mFormat;
   vk::SwapchainKHRPtr  mSwapchain;
 
-  std::vector<vk::Image> mImages;
-  uint32_t               mCurrentImageIndex = 0;
+  vk::ImageUsageFlags         mUsage;
+  std::vector<vk::Image>      mImages;
+  std::vector<BackedImagePtr> mBackedImages;
+  uint32_t                    mCurrentImageIndex = 0;
 
   std::vector<vk::SemaphorePtr> mImageAvailableSemaphores;
   std::vector<vk::SemaphorePtr> mCopyFinishedSemaphores;
   std::vector<CommandBufferPtr> mPresentCommandBuffers;
   uint32_t                      mCurrentPresentIndex = 0;
 
-  bool mEnableVsync = true;
-  bool mDirty       = true;
+  bool     mEnableVsync        = true;
+  bool     mEnableRelaxedVsync = false;
+  uint32_t mImageCount         = 0;
+  bool     mDirty              = true;
+  uint64_t mGeneration         = 0;
+
+  Timings mTimings;
+  double  mAcquireTime = 0.0;
 };
 
 } // namespace Illusion::Graphics
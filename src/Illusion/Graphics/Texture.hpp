@@ -11,27 +11,47 @@
 
 #include "BackedImage.hpp"
 #include "Device.hpp"
+#include "MipmapGenerator.hpp"
 
 namespace Illusion::Graphics {
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////
 // A Texture is a BackedImage and stores in addition a vk::Sampler with the corresponding         //
-// create-info object.                                                                            //
+// create-info object. The vk::Sampler is shared with all other Textures created with an equal    //
+// create-info object, see Device::getSampler().                                                  //
 ////////////////////////////////////////////////////////////////////////////////////////////////////
 
 struct Texture : public BackedImage {
   vk::SamplerPtr        mSampler;
   vk::SamplerCreateInfo mSamplerInfo;
 
+  // If the bindless mode of the Device is enabled, this is the index of the texture in the array of
+  // combined image samplers of the BindlessDescriptorSet. The index is released when mBindlessSlot
+  // is destroyed.
+  uint32_t              mBindlessIndex = ~0u;
+  std::shared_ptr<void> mBindlessSlot;
+
   // Returns the maximum mipmap level of a texture of the given size.
   static uint32_t getMaxMipmapLevels(uint32_t width, uint32_t height);
 
-  // This method will first try to load the given file with gli (DDS file format) and if that is
-  // impossible it will try using stb. If the file does not contain mipmaps and generateMipmaps is
-  // set to true, all mipmap levels will be created with linearly filtered blits.
+  // This method will first try to load the given file as KTX2 file, then with gli (DDS and KTX
+  // file formats) and if that is impossible it will try using stb. If the file does not contain
+  // mipmaps and generateMipmaps is set to true, all mipmap levels will be created with
+  // updateMipmaps().
+  // Block-compressed data (BC, ETC2 or ASTC) is uploaded as is; an exception is thrown if the
+  // PhysicalDevice does not support its format. Mipmaps cannot be generated for such files.
+  // If compressedFormat is one of the formats supported by TextureCompression::canCompress(),
+  // uncompressed 8-bit 2D images are compressed to this format at load time. Their mipmaps are
+  // then generated on the CPU. If the device does not support compressedFormat, a warning is
+  // printed and the image is loaded uncompressed.
   static TexturePtr createFromFile(DevicePtr const& device, std::string const& fileName,
       vk::SamplerCreateInfo samplerInfo = Device::createSamplerInfo(), bool generateMipmaps = true,
-      vk::ComponentMapping const& componentMapping = vk::ComponentMapping());
+      vk::ComponentMapping const& componentMapping = vk::ComponentMapping(),
+      vk::Format compressedFormat                  = vk::Format::eUndefined);
+
+  // The following four methods use compute shaders and wait until these have been executed. In
+  // order to compute all of them at once without blocking and to cache the results, use an
+  // IblBaker instead.
 
   // This will create a cubemap from an equirectangular panorama image. For example, you can
   // directly use the images from https://hdrihaven.com/ This is done with a compute shader.
@@ -53,9 +73,28 @@ struct Texture : public BackedImage {
   // This is done with a compute shader.
   static TexturePtr createBRDFLuT(DevicePtr const& device, uint32_t size);
 
-  // Regenerates all mipmap levels of the given texture.
-  // This is done with linearly filtered image blits.
-  static void updateMipmaps(DevicePtr const& device, TexturePtr const& texture);
+  // Regenerates all mipmap levels of the given texture with a temporary MipmapGenerator and waits
+  // until this is done. In order to record this into your own CommandBuffer (and to avoid
+  // compiling the shader on each call), use a MipmapGenerator directly.
+  static void updateMipmaps(DevicePtr const& device, TexturePtr const& texture,
+      MipmapFilter filter = MipmapFilter::eBox);
+
+  // Overwrites a region of the given mipmap level and array layers of the texture, for example to
+  // add glyphs to an atlas or to stream video frames, without recreating it. The data is copied to
+  // a range of the given TransientAllocator and a copy to the image is recorded into the
+  // CommandBuffer; hence this does not block and the data can be freed once this call returns.
+  // The allocator of the frame the CommandBuffer belongs to should be used, so that the staging
+  // range stays valid until the GPU has executed the copy. Its chunks need the
+  // vk::BufferUsageFlagBits::eTransferSrc usage (which is part of the default usage).
+  // The data has to be tightly packed, layer after layer; for block-compressed formats, offset
+  // and extent have to be multiples of the block size. This has to be called outside of
+  // RenderPasses. Afterwards, the region is in vk::ImageLayout::eTransferDstOptimal; when the
+  // texture is bound, it is transitioned automatically before the next dispatch, else use
+  // CommandBuffer::transitionImage(). A std::runtime_error is thrown if the texture was not
+  // created with the vk::ImageUsageFlagBits::eTransferDst usage.
+  static void update(CommandBuffer& cmd, TransientAllocator& allocator,
+      TexturePtr const& texture, vk::Offset3D const& offset, vk::Extent3D const& extent,
+      const void* data, uint32_t mipLevel = 0, uint32_t baseLayer = 0, uint32_t layerCount = 1);
 };
 
 } // namespace Illusion::Graphics
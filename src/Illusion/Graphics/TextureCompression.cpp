@@ -0,0 +1,377 @@
+////////////////////////////////////////////////////////////////////////////////////////////////////
+//                                                                                                //
+//    _)  |  |            _)                This code may be used and modified under the terms    //
+//     |  |  |  |  | (_-<  |   _ \    \     of the MIT license. See the LICENSE file for details. //
+//    _| _| _| \_,_| ___/ _| \___/ _| _|    Copyright (c) 2018-2019 Simon Schneegans              //
+//                                                                                                //
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include "TextureCompression.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <stdexcept>
+
+namespace Illusion::Graphics::TextureCompression {
+
+namespace {
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+// The number of power iterations used for finding the principal axis of the colors of a block.
+const int cPowerIterations = 8;
+
+// The 16 pixels of a 4x4 block, as RGBA values.
+typedef std::array<std::array<uint8_t, 4>, 16> Block;
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+// Returns the size of one 4x4 block in the given format or zero if the format is not supported.
+size_t getBlockSize(vk::Format format) {
+  switch (format) {
+  case vk::Format::eBc1RgbUnormBlock:
+  case vk::Format::eBc1RgbSrgbBlock:
+  case vk::Format::eBc1RgbaUnormBlock:
+  case vk::Format::eBc1RgbaSrgbBlock:
+  case vk::Format::eBc4UnormBlock:
+    return 8;
+  case vk::Format::eBc3UnormBlock:
+  case vk::Format::eBc3SrgbBlock:
+  case vk::Format::eBc5UnormBlock:
+    return 16;
+  default:
+    return 0;
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+// Blocks at the right and bottom border of images whose size is not a multiple of four are filled
+// by repeating the last column and row.
+void loadBlock(uint8_t const* pixels, uint32_t width, uint32_t height, uint32_t blockX,
+    uint32_t blockY, Block& block) {
+
+  for (uint32_t y = 0; y < 4; ++y) {
+    uint32_t py = std::min(blockY * 4 + y, height - 1);
+
+    for (uint32_t x = 0; x < 4; ++x) {
+      uint32_t px = std::min(blockX * 4 + x, width - 1);
+      std::memcpy(block[y * 4 + x].data(), pixels + (py * width + px) * 4, 4);
+    }
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+uint16_t encodeRGB565(std::array<float, 3> const& color) {
+  auto quantize = [](float value, int bits) {
+    int maximum = (1 << bits) - 1;
+    return static_cast<uint16_t>(
+        std::clamp(static_cast<int>(std::round(value / 255.f * maximum)), 0, maximum));
+  };
+
+  return static_cast<uint16_t>(
+      (quantize(color[0], 5) << 11) | (quantize(color[1], 6) << 5) | quantize(color[2], 5));
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+// The decoded color is required for choosing the indices of the pixels.
+std::array<int, 3> decodeRGB565(uint16_t color) {
+  int r = (color >> 11) & 31;
+  int g = (color >> 5) & 63;
+  int b = color & 31;
+  return {(r << 3) | (r >> 2), (g << 2) | (g >> 4), (b << 3) | (b >> 2)};
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+// Writes eight bytes: two RGB565 end points and a 2-bit index for each pixel. The end points are
+// ordered so that the four-color mode is used.
+void encodeColorBlock(Block const& block, uint8_t* result) {
+
+  // find the mean and the covariance of the colors
+  std::array<float, 3> mean = {0.f, 0.f, 0.f};
+  for (auto const& p : block) {
+    for (int c = 0; c < 3; ++c) {
+      mean[c] += p[c] / 16.f;
+    }
+  }
+
+  std::array<std::array<float, 3>, 3> covariance{};
+  for (auto const& p : block) {
+    for (int i = 0; i < 3; ++i) {
+      for (int j = 0; j < 3; ++j) {
+        covariance[i][j] += (p[i] - mean[i]) * (p[j] - mean[j]);
+      }
+    }
+  }
+
+  // the principal axis is the dominant eigenvector of the covariance matrix
+  std::array<float, 3> axis = {1.f, 1.f, 1.f};
+  for (int i = 0; i < cPowerIterations; ++i) {
+    std::array<float, 3> next{};
+    for (int r = 0; r < 3; ++r) {
+      for (int c = 0; c < 3; ++c) {
+        next[r] += covariance[r][c] * axis[c];
+      }
+    }
+
+    float length = std::sqrt(next[0] * next[0] + next[1] * next[1] + next[2] * next[2]);
+    if (length < 1e-6f) {
+      break;
+    }
+
+    for (int c = 0; c < 3; ++c) {
+      axis[c] = next[c] / length;
+    }
+  }
+
+  // the end points are the extremes of the projection of the colors onto the axis
+  float minT = 0.f, maxT = 0.f;
+  for (auto const& p : block) {
+    float t = (p[0] - mean[0]) * axis[0] + (p[1] - mean[1]) * axis[1] + (p[2] - mean[2]) * axis[2];
+    minT    = std::min(minT, t);
+    maxT    = std::max(maxT, t);
+  }
+
+  std::array<float, 3> end0, end1;
+  for (int c = 0; c < 3; ++c) {
+    end0[c] = mean[c] + axis[c] * maxT;
+    end1[c] = mean[c] + axis[c] * minT;
+  }
+
+  uint16_t color0 = encodeRGB565(end0);
+  uint16_t color1 = encodeRGB565(end1);
+
+  if (color0 < color1) {
+    std::swap(color0, color1);
+  }
+
+  uint32_t indices = 0;
+
+  // if both end points are equal, all pixels use the first one
+  if (color0 != color1) {
+    auto c0 = decodeRGB565(color0);
+    auto c1 = decodeRGB565(color1);
+
+    std::array<std::array<int, 3>, 4> palette;
+    for (int c = 0; c < 3; ++c) {
+      palette[0][c] = c0[c];
+      palette[1][c] = c1[c];
+      palette[2][c] = (2 * c0[c] + c1[c]) / 3;
+      palette[3][c] = (c0[c] + 2 * c1[c]) / 3;
+    }
+
+    for (uint32_t i = 0; i < 16; ++i) {
+      uint32_t best         = 0;
+      int      bestDistance = std::numeric_limits<int>::max();
+
+      for (uint32_t j = 0; j < 4; ++j) {
+        int distance = 0;
+        for (int c = 0; c < 3; ++c) {
+          int d = block[i][c] - palette[j][c];
+          distance += d * d;
+        }
+
+        if (distance < bestDistance) {
+          best         = j;
+          bestDistance = distance;
+        }
+      }
+
+      indices |= best << (i * 2);
+    }
+  }
+
+  result[0] = static_cast<uint8_t>(color0 & 0xff);
+  result[1] = static_cast<uint8_t>(color0 >> 8);
+  result[2] = static_cast<uint8_t>(color1 & 0xff);
+  result[3] = static_cast<uint8_t>(color1 >> 8);
+
+  for (int i = 0; i < 4; ++i) {
+    result[4 + i] = static_cast<uint8_t>((indices >> (i * 8)) & 0xff);
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+// Writes eight bytes: two end points and a 3-bit index for each pixel. The end points are ordered
+// so that the eight-value mode is used.
+void encodeChannelBlock(Block const& block, int channel, uint8_t* result) {
+  uint8_t minValue = 255, maxValue = 0;
+  for (auto const& p : block) {
+    minValue = std::min(minValue, p[channel]);
+    maxValue = std::max(maxValue, p[channel]);
+  }
+
+  uint64_t indices = 0;
+
+  // if both end points are equal, all pixels use the first one
+  if (minValue != maxValue) {
+    std::array<int, 8> palette;
+    palette[0] = maxValue;
+    palette[1] = minValue;
+    for (int i = 2; i < 8; ++i) {
+      palette[i] = ((8 - i) * maxValue + (i - 1) * minValue) / 7;
+    }
+
+    for (uint32_t i = 0; i < 16; ++i) {
+      uint64_t best         = 0;
+      int      bestDistance = 256;
+
+      for (uint32_t j = 0; j < 8; ++j) {
+        int distance = std::abs(block[i][channel] - palette[j]);
+
+        if (distance < bestDistance) {
+          best         = j;
+          bestDistance = distance;
+        }
+      }
+
+      indices |= best << (i * 3);
+    }
+  }
+
+  result[0] = maxValue;
+  result[1] = minValue;
+
+  for (int i = 0; i < 6; ++i) {
+    result[2 + i] = static_cast<uint8_t>((indices >> (i * 8)) & 0xff);
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+} // namespace
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+uint32_t appendMipmaps(std::vector<uint8_t>& pixels, uint32_t width, uint32_t height) {
+  uint32_t levels = static_cast<uint32_t>(std::floor(std::log2(std::max(width, height)))) + 1;
+
+  size_t size = 0;
+  for (uint32_t i = 0; i < levels; ++i) {
+    size += std::max(width >> i, 1u) * std::max(height >> i, 1u) * 4;
+  }
+
+  pixels.resize(size);
+
+  uint8_t* src       = pixels.data();
+  uint32_t srcWidth  = width;
+  uint32_t srcHeight = height;
+
+  for (uint32_t i = 1; i < levels; ++i) {
+    uint8_t* dst       = src + srcWidth * srcHeight * 4;
+    uint32_t dstWidth  = std::max(srcWidth / 2, 1u);
+    uint32_t dstHeight = std::max(srcHeight / 2, 1u);
+
+    for (uint32_t y = 0; y < dstHeight; ++y) {
+      uint32_t y0 = std::min(y * 2, srcHeight - 1);
+      uint32_t y1 = std::min(y * 2 + 1, srcHeight - 1);
+
+      for (uint32_t x = 0; x < dstWidth; ++x) {
+        uint32_t x0 = std::min(x * 2, srcWidth - 1);
+        uint32_t x1 = std::min(x * 2 + 1, srcWidth - 1);
+
+        for (uint32_t c = 0; c < 4; ++c) {
+          uint32_t sum = src[(y0 * srcWidth + x0) * 4 + c] + src[(y0 * srcWidth + x1) * 4 + c] +
+                         src[(y1 * srcWidth + x0) * 4 + c] + src[(y1 * srcWidth + x1) * 4 + c];
+          dst[(y * dstWidth + x) * 4 + c] = static_cast<uint8_t>((sum + 2) / 4);
+        }
+      }
+    }
+
+    src       = dst;
+    srcWidth  = dstWidth;
+    srcHeight = dstHeight;
+  }
+
+  return levels;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+bool canCompress(vk::Format format) {
+  return getBlockSize(format) > 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+bool isOpaque(uint8_t const* pixels, uint32_t width, uint32_t height) {
+  for (size_t i = 0; i < static_cast<size_t>(width) * height; ++i) {
+    if (pixels[i * 4 + 3] != 255) {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+size_t getSize(vk::Format format, uint32_t width, uint32_t height, uint32_t levels) {
+  size_t size = 0;
+
+  for (uint32_t i = 0; i < levels; ++i) {
+    size_t blocksX = (std::max(width >> i, 1u) + 3) / 4;
+    size_t blocksY = (std::max(height >> i, 1u) + 3) / 4;
+    size += blocksX * blocksY * getBlockSize(format);
+  }
+
+  return size;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+std::vector<uint8_t> compress(vk::Format format, uint8_t const* pixels, uint32_t width,
+    uint32_t height, uint32_t levels) {
+
+  size_t blockSize = getBlockSize(format);
+
+  if (blockSize == 0) {
+    throw std::runtime_error(
+        "Failed to compress image: Unsupported format " + vk::to_string(format) + "!");
+  }
+
+  std::vector<uint8_t> result(getSize(format, width, height, levels));
+
+  uint8_t* dst = result.data();
+  Block    block;
+
+  for (uint32_t i = 0; i < levels; ++i) {
+    uint32_t levelWidth  = std::max(width >> i, 1u);
+    uint32_t levelHeight = std::max(height >> i, 1u);
+
+    for (uint32_t y = 0; y < (levelHeight + 3) / 4; ++y) {
+      for (uint32_t x = 0; x < (levelWidth + 3) / 4; ++x) {
+        loadBlock(pixels, levelWidth, levelHeight, x, y, block);
+
+        if (format == vk::Format::eBc4UnormBlock) {
+          encodeChannelBlock(block, 0, dst);
+        } else if (format == vk::Format::eBc5UnormBlock) {
+          encodeChannelBlock(block, 0, dst);
+          encodeChannelBlock(block, 1, dst + 8);
+        } else if (blockSize == 16) {
+          encodeChannelBlock(block, 3, dst);
+          encodeColorBlock(block, dst + 8);
+        } else {
+          encodeColorBlock(block, dst);
+        }
+
+        dst += blockSize;
+      }
+    }
+
+    pixels += static_cast<size_t>(levelWidth) * levelHeight * 4;
+  }
+
+  return result;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+} // namespace Illusion::Graphics::TextureCompression
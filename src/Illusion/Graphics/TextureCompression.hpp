@@ -0,0 +1,54 @@
+////////////////////////////////////////////////////////////////////////////////////////////////////
+//                                                                                                //
+//    _)  |  |            _)                This code may be used and modified under the terms    //
+//     |  |  |  |  | (_-<  |   _ \    \     of the MIT license. See the LICENSE file for details. //
+//    _| _| _| \_,_| ___/ _| \___/ _| _|    Copyright (c) 2018-2019 Simon Schneegans              //
+//                                                                                                //
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#ifndef ILLUSION_GRAPHICS_TEXTURE_COMPRESSION_HPP
+#define ILLUSION_GRAPHICS_TEXTURE_COMPRESSION_HPP
+
+#include <vulkan/vulkan.hpp>
+
+#include <cstdint>
+#include <vector>
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// These functions convert eR8G8B8A8Unorm images to block-compressed formats on the CPU. Each     //
+// 4x4 block is encoded with the end points of the principal axis of its colors (BC1 and the      //
+// color part of BC3) or with the minimum and the maximum of the channel (BC4, BC5 and the alpha  //
+// part of BC3). This is much faster than an exhaustive search and good enough for textures which //
+// are compressed at load time.                                                                   //
+// The images are stored as produced by appendMipmaps(): all mipmap levels down to 1x1 pixels,    //
+// tightly packed one after another. The functions do not share any state, so they can be called  //
+// by several threads at the same time.                                                           //
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+namespace Illusion::Graphics::TextureCompression {
+
+// Appends all mipmap levels of the given eR8G8B8A8Unorm image down to 1x1 pixels to pixels. They
+// are computed with a box filter. Returns the total number of levels.
+uint32_t appendMipmaps(std::vector<uint8_t>& pixels, uint32_t width, uint32_t height);
+
+// Returns true if compress() supports the given format. These are the BC1, BC3, BC4 and BC5
+// formats, both in their unorm and (where available) their sRGB variants.
+bool canCompress(vk::Format format);
+
+// Returns true if all pixels of the given eR8G8B8A8Unorm image have an alpha value of 255; this
+// can be used to choose between BC1 and BC3.
+bool isOpaque(uint8_t const* pixels, uint32_t width, uint32_t height);
+
+// Returns the size in bytes of an image in the given block-compressed format (which has to be
+// supported by canCompress()) including all of its mipmap levels.
+size_t getSize(vk::Format format, uint32_t width, uint32_t height, uint32_t levels);
+
+// Compresses all mipmap levels of the given eR8G8B8A8Unorm image to the given format. Throws a
+// std::runtime_error if the format is not supported by canCompress(). For BC4, the red channel is
+// used; for BC5, the red and the green channel.
+std::vector<uint8_t> compress(vk::Format format, uint8_t const* pixels, uint32_t width,
+    uint32_t height, uint32_t levels);
+
+} // namespace Illusion::Graphics::TextureCompression
+
+#endif // ILLUSION_GRAPHICS_TEXTURE_COMPRESSION_HPP
@@ -0,0 +1,297 @@
+////////////////////////////////////////////////////////////////////////////////////////////////////
+//                                                                                                //
+//    _)  |  |            _)                This code may be used and modified under the terms    //
+//     |  |  |  |  | (_-<  |   _ \    \     of the MIT license. See the LICENSE file for details. //
+//    _| _| _| \_,_| ___/ _| \___/ _| _|    Copyright (c) 2018-2019 Simon Schneegans              //
+//                                                                                                //
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include "TextureStreamer.hpp"
+
+#include "Device.hpp"
+#include "Texture.hpp"
+#include "Utils.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+#include <string>
+
+namespace Illusion::Graphics {
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+TextureStreamer::TextureStreamer(DevicePtr const& device, vk::DeviceSize budget,
+    uint32_t tailResolution, uint32_t evictionDelay)
+    : mDevice(device)
+    , mBudget(budget)
+    , mTailResolution(tailResolution)
+    , mEvictionDelay(evictionDelay) {
+
+  mStats.mBudget = budget;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+TextureStreamer::~TextureStreamer() = default;
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+uint32_t TextureStreamer::add(
+    Source const& source, std::function<void(TexturePtr const&)> const& onChanged) {
+
+  Entry entry;
+  entry.mSource      = source;
+  entry.mOnChanged   = onChanged;
+  entry.mActive      = true;
+  entry.mLastRequest = mFrame;
+
+  auto const&  info        = source.mImageInfo;
+  vk::Extent2D blockExtent = Utils::getBlockExtent(info.format);
+  uint8_t      blockSize   = Utils::getBlockByteCount(info.format);
+
+  entry.mLevelOffsets.push_back(0);
+  entry.mTailLevel = info.mipLevels - 1;
+
+  for (uint32_t i = 0; i < info.mipLevels; ++i) {
+    uint32_t width  = std::max(info.extent.width >> i, 1u);
+    uint32_t height = std::max(info.extent.height >> i, 1u);
+    uint32_t depth  = std::max(info.extent.depth >> i, 1u);
+
+    vk::DeviceSize blocksX = (width + blockExtent.width - 1) / blockExtent.width;
+    vk::DeviceSize blocksY = (height + blockExtent.height - 1) / blockExtent.height;
+    entry.mLevelOffsets.push_back(
+        entry.mLevelOffsets.back() + blocksX * blocksY * depth * info.arrayLayers * blockSize);
+
+    if (std::max(width, height) <= mTailResolution) {
+      entry.mTailLevel = std::min(entry.mTailLevel, i);
+    }
+  }
+
+  if (entry.mLevelOffsets.back() > source.mSize) {
+    throw std::runtime_error("Failed to add texture to TextureStreamer: The source contains " +
+                             std::to_string(source.mSize) + " instead of " +
+                             std::to_string(entry.mLevelOffsets.back()) + " bytes!");
+  }
+
+  entry.mRequestedLevel = entry.mTailLevel;
+
+  // reuse the slots of removed Textures
+  auto slot = std::find_if(
+      mEntries.begin(), mEntries.end(), [](Entry const& e) { return !e.mActive; });
+  auto handle = static_cast<uint32_t>(slot - mEntries.begin());
+
+  if (slot == mEntries.end()) {
+    mEntries.push_back(std::move(entry));
+  } else {
+    *slot = std::move(entry);
+  }
+
+  setFirstLevel(mEntries[handle], mEntries[handle].mTailLevel);
+
+  return handle;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void TextureStreamer::remove(uint32_t handle) {
+  mEntries[handle] = Entry();
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void TextureStreamer::request(uint32_t handle, float resolution) {
+  auto& entry = mEntries[handle];
+
+  if (!entry.mActive) {
+    return;
+  }
+
+  auto const& extent    = entry.mSource.mImageInfo.extent;
+  float       maxExtent = static_cast<float>(std::max(extent.width, extent.height));
+  uint32_t    level     = 0;
+
+  if (resolution < maxExtent) {
+    level = static_cast<uint32_t>(std::floor(std::log2(maxExtent / std::max(resolution, 1.f))));
+  }
+
+  level = std::min(level, entry.mTailLevel);
+
+  // the first request of a frame replaces the requests of the previous frames
+  if (entry.mLastRequest != mFrame) {
+    entry.mRequestedLevel = level;
+    entry.mLastRequest    = mFrame;
+  } else {
+    entry.mRequestedLevel = std::min(entry.mRequestedLevel, level);
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void TextureStreamer::update(vk::DeviceSize maxUploadBytes) {
+  mStats.mUploadedBytes = 0;
+  mStats.mEvictions     = 0;
+
+  vk::DeviceSize      residentBytes = 0;
+  std::vector<size_t> upgrades, victims;
+
+  for (size_t i(0); i < mEntries.size(); ++i) {
+    auto const& entry = mEntries[i];
+
+    if (!entry.mActive) {
+      continue;
+    }
+
+    residentBytes += getResidentBytes(entry, entry.mFirstLevel);
+
+    uint32_t desired = getDesiredLevel(entry);
+    if (desired < entry.mFirstLevel) {
+      upgrades.push_back(i);
+    } else if (desired > entry.mFirstLevel) {
+      victims.push_back(i);
+    }
+  }
+
+  // The least recently requested Textures lose their surplus levels first. The most recently
+  // requested Textures get their levels first; of these, the ones which miss the most levels.
+  std::sort(victims.begin(), victims.end(),
+      [this](size_t a, size_t b) { return mEntries[a].mLastRequest < mEntries[b].mLastRequest; });
+
+  std::sort(upgrades.begin(), upgrades.end(), [this](size_t a, size_t b) {
+    auto const& entryA = mEntries[a];
+    auto const& entryB = mEntries[b];
+    if (entryA.mLastRequest != entryB.mLastRequest) {
+      return entryA.mLastRequest > entryB.mLastRequest;
+    }
+    return entryA.mFirstLevel - getDesiredLevel(entryA) >
+           entryB.mFirstLevel - getDesiredLevel(entryB);
+  });
+
+  size_t nextVictim = 0;
+
+  auto evict = [&]() {
+    auto& victim = mEntries[victims[nextVictim++]];
+    residentBytes -= getResidentBytes(victim, victim.mFirstLevel);
+    setFirstLevel(victim, getDesiredLevel(victim));
+    residentBytes += getResidentBytes(victim, victim.mFirstLevel);
+    ++mStats.mEvictions;
+  };
+
+  // this is only required if the budget has been reduced
+  while (residentBytes > mBudget && nextVictim < victims.size()) {
+    evict();
+  }
+
+  for (size_t i : upgrades) {
+    if (mStats.mUploadedBytes >= maxUploadBytes) {
+      break;
+    }
+
+    auto&          entry   = mEntries[i];
+    uint32_t       level   = getDesiredLevel(entry);
+    vk::DeviceSize current = getResidentBytes(entry, entry.mFirstLevel);
+
+    while (residentBytes - current + getResidentBytes(entry, level) > mBudget &&
+           nextVictim < victims.size()) {
+      evict();
+    }
+
+    // if there is still not enough memory, fewer levels are uploaded
+    while (level < entry.mFirstLevel &&
+           residentBytes - current + getResidentBytes(entry, level) > mBudget) {
+      ++level;
+    }
+
+    if (level < entry.mFirstLevel) {
+      setFirstLevel(entry, level);
+      residentBytes += getResidentBytes(entry, level) - current;
+    }
+  }
+
+  mStats.mTextureCount   = 0;
+  mStats.mResidentLevels = 0;
+  mStats.mTotalLevels    = 0;
+  mStats.mResidentBytes  = residentBytes;
+  mStats.mRequestedBytes = 0;
+  mStats.mBudget         = mBudget;
+
+  for (auto const& entry : mEntries) {
+    if (entry.mActive) {
+      ++mStats.mTextureCount;
+      mStats.mResidentLevels += entry.mSource.mImageInfo.mipLevels - entry.mFirstLevel;
+      mStats.mTotalLevels += entry.mSource.mImageInfo.mipLevels;
+      mStats.mRequestedBytes += getResidentBytes(entry, getDesiredLevel(entry));
+    }
+  }
+
+  ++mFrame;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void TextureStreamer::setBudget(vk::DeviceSize budget) {
+  mBudget = budget;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+vk::DeviceSize TextureStreamer::getBudget() const {
+  return mBudget;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+TextureStreamer::Stats const& TextureStreamer::getStats() const {
+  return mStats;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+vk::DeviceSize TextureStreamer::getResidentBytes(Entry const& entry, uint32_t firstLevel) const {
+  return entry.mLevelOffsets.back() - entry.mLevelOffsets[firstLevel];
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+uint32_t TextureStreamer::getDesiredLevel(Entry const& entry) const {
+  if (mFrame - entry.mLastRequest > mEvictionDelay) {
+    return entry.mTailLevel;
+  }
+
+  return entry.mRequestedLevel;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void TextureStreamer::setFirstLevel(Entry& entry, uint32_t firstLevel) {
+  auto const& source = entry.mSource;
+
+  vk::ImageCreateInfo imageInfo = source.mImageInfo;
+  imageInfo.extent.width        = std::max(imageInfo.extent.width >> firstLevel, 1u);
+  imageInfo.extent.height       = std::max(imageInfo.extent.height >> firstLevel, 1u);
+  imageInfo.extent.depth        = std::max(imageInfo.extent.depth >> firstLevel, 1u);
+  imageInfo.mipLevels -= firstLevel;
+
+  vk::SamplerCreateInfo samplerInfo = source.mSamplerInfo;
+  samplerInfo.maxLod                = static_cast<float>(imageInfo.mipLevels);
+
+  vk::ImageViewType viewType = imageInfo.imageType == vk::ImageType::e3D
+                                   ? vk::ImageViewType::e3D
+                                   : vk::ImageViewType::e2D;
+
+  vk::DeviceSize offset = entry.mLevelOffsets[firstLevel];
+  vk::DeviceSize size   = entry.mLevelOffsets.back() - offset;
+
+  auto texture = mDevice->createTexture(imageInfo, samplerInfo, viewType,
+      vk::ImageAspectFlagBits::eColor, vk::ImageLayout::eShaderReadOnlyOptimal,
+      vk::ComponentMapping(), size, source.mData + offset);
+
+  entry.mFirstLevel = firstLevel;
+  mStats.mUploadedBytes += size;
+
+  entry.mOnChanged(texture);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+} // namespace Illusion::Graphics
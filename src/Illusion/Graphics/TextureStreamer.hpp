@@ -0,0 +1,129 @@
+////////////////////////////////////////////////////////////////////////////////////////////////////
+//                                                                                                //
+//    _)  |  |            _)                This code may be used and modified under the terms    //
+//     |  |  |  |  | (_-<  |   _ \    \     of the MIT license. See the LICENSE file for details. //
+//    _| _| _| \_,_| ___/ _| \___/ _| _|    Copyright (c) 2018-2019 Simon Schneegans              //
+//                                                                                                //
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#ifndef ILLUSION_GRAPHICS_TEXTURE_STREAMER_HPP
+#define ILLUSION_GRAPHICS_TEXTURE_STREAMER_HPP
+
+#include "fwd.hpp"
+
+#include <functional>
+#include <memory>
+#include <vector>
+
+namespace Illusion::Graphics {
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// The TextureStreamer keeps the complete mipmap chains of its Textures in host memory, but only  //
+// the levels which are actually required are resident on the device. When a Texture is added,    //
+// only the levels up to the given tail resolution are uploaded. Afterwards, the users report the //
+// resolution at which each Texture is seen on screen with request(). update() then replaces the  //
+// Textures by versions with more levels as long as the budget permits. If it does not, levels    //
+// of the least recently requested Textures are evicted first; they fall back down to their mip   //
+// tail if they have not been requested for some time.                                            //
+// As Vulkan does not allow adding levels to an existing image (without sparse residency), each   //
+// change creates a new Texture; the old one is released through the DeletionQueue of the Device. //
+// The users are notified with a callback, so that they can replace their references. All         //
+// methods have to be called by the same thread.                                                  //
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+class TextureStreamer {
+
+ public:
+  // The complete mipmap chain of a Texture. All levels are tightly packed, starting with the
+  // largest one; mImageInfo describes all of them. mOwner keeps mData alive as long as the Texture
+  // is registered.
+  struct Source {
+    vk::ImageCreateInfo   mImageInfo;
+    vk::SamplerCreateInfo mSamplerInfo;
+    uint8_t const*        mData = nullptr;
+    vk::DeviceSize        mSize = 0;
+    std::shared_ptr<void> mOwner;
+  };
+
+  // These are updated by update(). The byte counts refer to the texel data of the levels.
+  struct Stats {
+    uint32_t       mTextureCount   = 0;
+    uint32_t       mResidentLevels = 0;
+    uint32_t       mTotalLevels    = 0;
+    vk::DeviceSize mResidentBytes  = 0;
+    vk::DeviceSize mRequestedBytes = 0; // if all requested levels were resident
+    vk::DeviceSize mBudget         = 0;
+    vk::DeviceSize mUploadedBytes  = 0; // during the last update()
+    uint32_t       mEvictions      = 0; // during the last update()
+  };
+
+  // Syntactic sugar to create a std::shared_ptr for this class
+  template <typename... Args>
+  static TextureStreamerPtr create(Args&&... args) {
+    return std::make_shared<TextureStreamer>(args...);
+  };
+
+  // The budget limits the bytes of all resident levels. The levels up to tailResolution pixels
+  // (the mip tail) are always resident, even if this exceeds the budget. Textures which have not
+  // been requested for more than evictionDelay calls to update() fall back to their mip tail when
+  // memory is required.
+  TextureStreamer(DevicePtr const& device, vk::DeviceSize budget = 256 * 1024 * 1024,
+      uint32_t tailResolution = 64, uint32_t evictionDelay = 60);
+  virtual ~TextureStreamer();
+
+  // Creates a Texture with the mip tail of the given source and passes it to onChanged. This is
+  // called again whenever the Texture is replaced. The returned handle can be used for request()
+  // and remove().
+  uint32_t add(Source const& source, std::function<void(TexturePtr const&)> const& onChanged);
+
+  // Releases the source of the given Texture. The current Texture stays valid, but onChanged is
+  // not called anymore.
+  void remove(uint32_t handle);
+
+  // Reports that the given Texture is currently seen with about resolution pixels along its larger
+  // side. Several requests for the same Texture before the next update() are combined.
+  void request(uint32_t handle, float resolution);
+
+  // Evicts levels if the budget is exceeded and uploads requested levels. This should be called
+  // once a frame. At most maxUploadBytes are uploaded per call, but each Texture is always updated
+  // completely.
+  void update(vk::DeviceSize maxUploadBytes = 16 * 1024 * 1024);
+
+  void           setBudget(vk::DeviceSize budget);
+  vk::DeviceSize getBudget() const;
+
+  Stats const& getStats() const;
+
+ private:
+  struct Entry {
+    Source                                 mSource;
+    std::function<void(TexturePtr const&)> mOnChanged;
+    std::vector<vk::DeviceSize>            mLevelOffsets; // one more than there are levels
+    uint32_t                               mTailLevel      = 0;
+    uint32_t                               mFirstLevel     = 0; // the largest resident level
+    uint32_t                               mRequestedLevel = 0;
+    uint64_t                               mLastRequest    = 0;
+    bool                                   mActive         = false;
+  };
+
+  // Returns the bytes of the levels starting at firstLevel.
+  vk::DeviceSize getResidentBytes(Entry const& entry, uint32_t firstLevel) const;
+
+  // Returns the level which should be resident for the given entry in the current frame.
+  uint32_t getDesiredLevel(Entry const& entry) const;
+
+  // Creates a new Texture with the levels starting at firstLevel and passes it to the callback.
+  void setFirstLevel(Entry& entry, uint32_t firstLevel);
+
+  DevicePtr          mDevice;
+  vk::DeviceSize     mBudget;
+  uint32_t           mTailResolution;
+  uint32_t           mEvictionDelay;
+  uint64_t           mFrame = 0;
+  std::vector<Entry> mEntries;
+  Stats              mStats;
+};
+
+} // namespace Illusion::Graphics
+
+#endif // ILLUSION_GRAPHICS_TEXTURE_STREAMER_HPP
@@ -0,0 +1,119 @@
+////////////////////////////////////////////////////////////////////////////////////////////////////
+//                                                                                                //
+//    _)  |  |            _)                This code may be used and modified under the terms    //
+//     |  |  |  |  | (_-<  |   _ \    \     of the MIT license. See the LICENSE file for details. //
+//    _| _| _| \_,_| ___/ _| \___/ _| _|    Copyright (c) 2018-2019 Simon Schneegans              //
+//                                                                                                //
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include "TransientAllocator.hpp"
+
+#include "../Core/Logger.hpp"
+#include "BackedBuffer.hpp"
+#include "Device.hpp"
+#include "PhysicalDevice.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+
+namespace Illusion::Graphics {
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+TransientAllocator::TransientAllocator(DevicePtr const& device, vk::DeviceSize chunkSize,
+    vk::DeviceSize alignment, vk::BufferUsageFlags usage)
+    : mDevice(device)
+    , mChunkSize(chunkSize)
+    , mAlignment(alignment)
+    , mUsage(usage) {
+
+  ILLUSION_TRACE << "Creating TransientAllocator." << std::endl;
+
+  if (mAlignment == 0) {
+    auto const& limits = mDevice->getPhysicalDevice()->getProperties().limits;
+    mAlignment =
+        std::max(limits.minUniformBufferOffsetAlignment, limits.minStorageBufferOffsetAlignment);
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+TransientAllocator::~TransientAllocator() {
+  ILLUSION_TRACE << "Deleting TransientAllocator." << std::endl;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+TransientAllocator::Allocation TransientAllocator::allocate(vk::DeviceSize size) {
+
+  // Find the next chunk with enough space left. The remaining space of skipped chunks is wasted
+  // until the next reset().
+  while (mCurrentChunk < mChunks.size()) {
+    vk::DeviceSize offset = (mCurrentOffset + mAlignment - 1) / mAlignment * mAlignment;
+
+    if (offset + size <= mChunks[mCurrentChunk]->mBufferInfo.size) {
+      Allocation result;
+      result.mBuffer = mChunks[mCurrentChunk];
+      result.mOffset = offset;
+      result.mSize   = size;
+      result.mData   = result.mBuffer->mMappedData + offset;
+
+      mCurrentOffset = offset + size;
+      mAllocatedBytes += size;
+
+      return result;
+    }
+
+    ++mCurrentChunk;
+    mCurrentOffset = 0;
+  }
+
+  // All chunks are full, create a new one.
+  mChunks.push_back(createChunk(std::max(mChunkSize, size)));
+
+  return allocate(size);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+TransientAllocator::Allocation TransientAllocator::addData(
+    uint8_t const* data, vk::DeviceSize size) {
+  auto result = allocate(size);
+  std::memcpy(result.mData, data, size);
+  return result;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void TransientAllocator::reset() {
+  mCurrentChunk   = 0;
+  mCurrentOffset  = 0;
+  mAllocatedBytes = 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+uint32_t TransientAllocator::getChunkCount() const {
+  return static_cast<uint32_t>(mChunks.size());
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+vk::DeviceSize TransientAllocator::getAllocatedBytes() const {
+  return mAllocatedBytes;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+BackedBufferPtr TransientAllocator::createChunk(vk::DeviceSize size) const {
+  ILLUSION_DEBUG << "Adding chunk of " << size << " bytes to TransientAllocator." << std::endl;
+
+  // host visible memory is persistently mapped by the MemoryAllocator of the Device
+  return mDevice->createBackedBuffer(mUsage,
+      vk::MemoryPropertyFlagBits::eHostCoherent | vk::MemoryPropertyFlagBits::eHostVisible, size);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+} // namespace Illusion::Graphics
@@ -0,0 +1,91 @@
+////////////////////////////////////////////////////////////////////////////////////////////////////
+//                                                                                                //
+//    _)  |  |            _)                This code may be used and modified under the terms    //
+//     |  |  |  |  | (_-<  |   _ \    \     of the MIT license. See the LICENSE file for details. //
+//    _| _| _| \_,_| ___/ _| \___/ _| _|    Copyright (c) 2018-2019 Simon Schneegans              //
+//                                                                                                //
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#ifndef ILLUSION_GRAPHICS_TRANSIENT_ALLOCATOR_HPP
+#define ILLUSION_GRAPHICS_TRANSIENT_ALLOCATOR_HPP
+
+#include "fwd.hpp"
+
+namespace Illusion::Graphics {
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// The TransientAllocator is a linear allocator for data which is written once per frame, such as //
+// uniform data of a camera or the joint matrices of skins. The data is written to persistently   //
+// mapped, host-coherent BackedBuffers (the chunks). When a chunk is full, the next one is used;  //
+// if there is none, a new chunk is created. Hence the allocator never runs out of memory. Data   //
+// larger than the chunk size gets a chunk of its own.                                            //
+// reset() makes all chunks available again, so it should be called once the GPU has finished     //
+// the frame which used the data. The FrameContext does this in beginFrame().                     //
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+class TransientAllocator {
+
+ public:
+  // A range in one of the chunks. mBuffer and mOffset can be passed directly to
+  // BindingState::setDynamicUniformBuffer() or BindingState::setUniformBuffer().
+  struct Allocation {
+    BackedBufferPtr mBuffer;
+    vk::DeviceSize  mOffset = 0;
+    vk::DeviceSize  mSize   = 0;
+    uint8_t*        mData   = nullptr;
+  };
+
+  // Syntactic sugar to create a std::shared_ptr for this class
+  template <typename... Args>
+  static TransientAllocatorPtr create(Args&&... args) {
+    return std::make_shared<TransientAllocator>(args...);
+  };
+
+  // If alignment is zero, the maximum of minUniformBufferOffsetAlignment and
+  // minStorageBufferOffsetAlignment of the PhysicalDevice is used. By default, the chunks can be
+  // used as uniform, storage and indirect buffers and as staging source of Texture::update().
+  TransientAllocator(DevicePtr const& device, vk::DeviceSize chunkSize = 1024 * 1024,
+      vk::DeviceSize       alignment = 0,
+      vk::BufferUsageFlags usage     = vk::BufferUsageFlagBits::eUniformBuffer |
+                                   vk::BufferUsageFlagBits::eStorageBuffer |
+                                   vk::BufferUsageFlagBits::eIndirectBuffer |
+                                   vk::BufferUsageFlagBits::eTransferSrc);
+  virtual ~TransientAllocator();
+
+  // Returns an aligned range of the given size. The memory is not initialized.
+  Allocation allocate(vk::DeviceSize size);
+
+  // Allocates a range and copies the given data into it.
+  Allocation addData(uint8_t const* data, vk::DeviceSize size);
+
+  template <typename T>
+  Allocation addData(T const& data) {
+    return addData(reinterpret_cast<uint8_t const*>(&data), sizeof(data));
+  }
+
+  // All chunks are available again after this call. Previous Allocations must not be used anymore.
+  void reset();
+
+  // The number of chunks which have been created so far.
+  uint32_t getChunkCount() const;
+
+  // The number of bytes which have been allocated since the last reset().
+  vk::DeviceSize getAllocatedBytes() const;
+
+ private:
+  BackedBufferPtr createChunk(vk::DeviceSize size) const;
+
+  DevicePtr            mDevice;
+  vk::DeviceSize       mChunkSize;
+  vk::DeviceSize       mAlignment;
+  vk::BufferUsageFlags mUsage;
+
+  std::vector<BackedBufferPtr> mChunks;
+  size_t                       mCurrentChunk   = 0;
+  vk::DeviceSize               mCurrentOffset  = 0;
+  vk::DeviceSize               mAllocatedBytes = 0;
+};
+
+} // namespace Illusion::Graphics
+
+#endif // ILLUSION_GRAPHICS_TRANSIENT_ALLOCATOR_HPP
@@ -0,0 +1,483 @@
+////////////////////////////////////////////////////////////////////////////////////////////////////
+//                                                                                                //
+//    _)  |  |            _)                This code may be used and modified under the terms    //
+//     |  |  |  |  | (_-<  |   _ \    \     of the MIT license. See the LICENSE file for details. //
+//    _| _| _| \_,_| ___/ _| \___/ _| _|    Copyright (c) 2018-2019 Simon Schneegans              //
+//                                                                                                //
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include "UploadManager.hpp"
+
+#include "../Core/Logger.hpp"
+#include "../Core/Tracer.hpp"
+#include "BackedBuffer.hpp"
+#include "BackedImage.hpp"
+#include "Device.hpp"
+#include "FrameStatistics.hpp"
+#include "PhysicalDevice.hpp"
+#include "QueuePool.hpp"
+#include "Utils.hpp"
+
+#include <iostream>
+#include <numeric>
+
+namespace Illusion::Graphics {
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+UploadManager::UploadManager(Device const* device, vk::DeviceSize stagingSize)
+    : mDevice(device)
+    , mStagingSize(stagingSize) {
+
+  ILLUSION_TRACE << "Creating UploadManager." << std::endl;
+
+  // Uploads may be issued by any thread, hence the per-thread vk::CommandPools of the Device cannot
+  // be used. These pools are protected by mMutex.
+  for (auto type : {QueueType::eTransfer, QueueType::eGeneric}) {
+    vk::CommandPoolCreateInfo info;
+    info.queueFamilyIndex = mDevice->getPhysicalDevice()->getQueueFamily(type);
+    info.flags            = vk::CommandPoolCreateFlagBits::eTransient;
+
+    auto pool = mDevice->createCommandPool(info);
+
+    if (type == QueueType::eTransfer) {
+      mTransferPool = pool;
+    } else {
+      mGenericPool = pool;
+    }
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+UploadManager::~UploadManager() {
+  ILLUSION_TRACE << "Deleting UploadManager." << std::endl;
+
+  wait(mNextTicket);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+UploadManager::Ticket UploadManager::uploadToBuffer(BackedBufferPtr const& buffer,
+    vk::DeviceSize dataSize, const void* data, vk::DeviceSize dstOffset) {
+  ILLUSION_ZONE("UploadManager::uploadToBuffer");
+
+  std::unique_lock<std::mutex> lock(mMutex);
+
+  auto staging = stage(dataSize, data, 4);
+  auto cmd     = getTransferCmd();
+
+  vk::BufferCopy region;
+  region.srcOffset = staging.second;
+  region.dstOffset = dstOffset;
+  region.size      = dataSize;
+  cmd->copyBuffer(staging.first, *buffer->mBuffer, 1, &region);
+
+  uint32_t srcFamily = mDevice->getPhysicalDevice()->getQueueFamily(QueueType::eTransfer);
+  uint32_t dstFamily = mDevice->getPhysicalDevice()->getQueueFamily(QueueType::eGeneric);
+
+  vk::BufferMemoryBarrier barrier;
+  barrier.buffer = *buffer->mBuffer;
+  barrier.offset = dstOffset;
+  barrier.size   = dataSize;
+
+  if (srcFamily != dstFamily && buffer->mBufferInfo.sharingMode == vk::SharingMode::eExclusive) {
+
+    // release on the transfer queue...
+    barrier.srcAccessMask       = vk::AccessFlagBits::eTransferWrite;
+    barrier.srcQueueFamilyIndex = srcFamily;
+    barrier.dstQueueFamilyIndex = dstFamily;
+    cmd->pipelineBarrier(vk::PipelineStageFlagBits::eTransfer,
+        vk::PipelineStageFlagBits::eBottomOfPipe, vk::DependencyFlagBits(), nullptr, barrier,
+        nullptr);
+
+    // ... and acquire on the generic queue
+    barrier.srcAccessMask = vk::AccessFlags();
+    barrier.dstAccessMask = vk::AccessFlagBits::eMemoryRead;
+    getAcquireCmd()->pipelineBarrier(vk::PipelineStageFlagBits::eTopOfPipe,
+        vk::PipelineStageFlagBits::eAllCommands, vk::DependencyFlagBits(), nullptr, barrier,
+        nullptr);
+
+  } else {
+    barrier.srcAccessMask       = vk::AccessFlagBits::eTransferWrite;
+    barrier.dstAccessMask       = vk::AccessFlagBits::eMemoryRead;
+    barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    cmd->pipelineBarrier(vk::PipelineStageFlagBits::eTransfer,
+        vk::PipelineStageFlagBits::eAllCommands, vk::DependencyFlagBits(), nullptr, barrier,
+        nullptr);
+  }
+
+  mCurrentBatch.mBuffers.push_back(buffer);
+
+  return mNextTicket;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+UploadManager::Ticket UploadManager::uploadToImage(BackedImagePtr const& image,
+    vk::ImageAspectFlags aspectMask, vk::ImageLayout layout, vk::DeviceSize dataSize,
+    const void* data) {
+  ILLUSION_ZONE("UploadManager::uploadToImage");
+
+  std::unique_lock<std::mutex> lock(mMutex);
+
+  // The buffer offset of a copy has to be a multiple of the texel (or block) size and of four.
+  vk::DeviceSize blockSize = Utils::getBlockByteCount(image->mImageInfo.format);
+  vk::DeviceSize alignment =
+      std::lcm(std::lcm<vk::DeviceSize>(4, std::max<vk::DeviceSize>(blockSize, 1)),
+          mDevice->getPhysicalDevice()->getProperties().limits.optimalBufferCopyOffsetAlignment);
+
+  auto staging = stage(dataSize, data, alignment);
+  recordImageCopy(image, aspectMask, layout, dataSize, staging.first, staging.second);
+
+  return mNextTicket;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+UploadManager::Ticket UploadManager::copyToImage(BackedBufferPtr const& buffer,
+    vk::DeviceSize srcOffset, BackedImagePtr const& image, vk::ImageAspectFlags aspectMask,
+    vk::ImageLayout layout, vk::DeviceSize dataSize) {
+  ILLUSION_ZONE("UploadManager::copyToImage");
+
+  vk::DeviceSize blockSize = Utils::getBlockByteCount(image->mImageInfo.format);
+
+  if (srcOffset % std::lcm<vk::DeviceSize>(4, std::max<vk::DeviceSize>(blockSize, 1)) != 0) {
+    throw std::runtime_error("Failed to copy buffer to image: Source offset " +
+                             std::to_string(srcOffset) + " is not properly aligned!");
+  }
+
+  if (srcOffset + dataSize > buffer->mBufferInfo.size) {
+    throw std::runtime_error("Failed to copy buffer to image: Source range exceeds the buffer!");
+  }
+
+  std::unique_lock<std::mutex> lock(mMutex);
+
+  recordImageCopy(image, aspectMask, layout, dataSize, *buffer->mBuffer, srcOffset);
+  mCurrentBatch.mBuffers.push_back(buffer);
+  mDevice->getFrameStatistics()->add(&FrameStatistics::Counters::mUploadedBytes, dataSize);
+
+  return mNextTicket;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+UploadManager::Ticket UploadManager::transitionImage(
+    BackedImagePtr const& image, vk::ImageAspectFlags aspectMask, vk::ImageLayout layout) {
+
+  std::unique_lock<std::mutex> lock(mMutex);
+
+  if (image->mCurrentLayout == layout) {
+    return 0;
+  }
+
+  vk::ImageMemoryBarrier barrier;
+  barrier.srcQueueFamilyIndex         = VK_QUEUE_FAMILY_IGNORED;
+  barrier.dstQueueFamilyIndex         = VK_QUEUE_FAMILY_IGNORED;
+  barrier.image                       = *image->mImage;
+  barrier.subresourceRange.levelCount = image->mImageInfo.mipLevels;
+  barrier.subresourceRange.layerCount = image->mImageInfo.arrayLayers;
+  barrier.subresourceRange.aspectMask = aspectMask;
+  barrier.oldLayout                   = image->mCurrentLayout;
+  barrier.newLayout                   = layout;
+  barrier.dstAccessMask = vk::AccessFlagBits::eMemoryRead | vk::AccessFlagBits::eMemoryWrite;
+
+  getAcquireCmd()->pipelineBarrier(vk::PipelineStageFlagBits::eTopOfPipe,
+      vk::PipelineStageFlagBits::eAllCommands, vk::DependencyFlagBits(), nullptr, nullptr,
+      barrier);
+
+  image->mCurrentLayout = layout;
+  mCurrentBatch.mImages.push_back(image);
+
+  return mNextTicket;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void UploadManager::flush() {
+  std::unique_lock<std::mutex> lock(mMutex);
+  flushImpl();
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+bool UploadManager::isComplete(Ticket ticket) {
+  std::unique_lock<std::mutex> lock(mMutex);
+  reclaim();
+  return ticket <= mCompletedTicket;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void UploadManager::wait(Ticket ticket) {
+  std::unique_lock<std::mutex> lock(mMutex);
+
+  if (ticket >= mNextTicket) {
+    flushImpl();
+  }
+
+  while (mCompletedTicket < ticket && !mInFlightBatches.empty()) {
+    mDevice->getHandle()->waitForFences(*mInFlightBatches.front().mFence, true, ~0);
+    reclaim();
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+vk::CommandBufferPtr const& UploadManager::getTransferCmd() {
+  if (!mCurrentBatch.mTransferCmd) {
+    mCurrentBatch.mTransferCmd = mDevice->allocateCommandBuffer(mTransferPool);
+    mCurrentBatch.mTransferCmd->begin({vk::CommandBufferUsageFlagBits::eOneTimeSubmit});
+  }
+
+  return mCurrentBatch.mTransferCmd;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+vk::CommandBufferPtr const& UploadManager::getAcquireCmd() {
+  if (!mCurrentBatch.mAcquireCmd) {
+    mCurrentBatch.mAcquireCmd = mDevice->allocateCommandBuffer(mGenericPool);
+    mCurrentBatch.mAcquireCmd->begin({vk::CommandBufferUsageFlagBits::eOneTimeSubmit});
+  }
+
+  return mCurrentBatch.mAcquireCmd;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void UploadManager::recordImageCopy(BackedImagePtr const& image, vk::ImageAspectFlags aspectMask,
+    vk::ImageLayout layout, vk::DeviceSize dataSize, vk::Buffer src, vk::DeviceSize srcOffset) {
+
+  auto cmd = getTransferCmd();
+
+  // Block-compressed images are copied in whole blocks.
+  auto const&    imageInfo   = image->mImageInfo;
+  vk::Extent2D   blockExtent = Utils::getBlockExtent(imageInfo.format);
+  vk::DeviceSize blockSize   = Utils::getBlockByteCount(imageInfo.format);
+
+  vk::ImageMemoryBarrier barrier;
+  barrier.srcQueueFamilyIndex         = VK_QUEUE_FAMILY_IGNORED;
+  barrier.dstQueueFamilyIndex         = VK_QUEUE_FAMILY_IGNORED;
+  barrier.image                       = *image->mImage;
+  barrier.subresourceRange.levelCount = imageInfo.mipLevels;
+  barrier.subresourceRange.layerCount = imageInfo.arrayLayers;
+  barrier.subresourceRange.aspectMask = aspectMask;
+  barrier.oldLayout                   = image->mCurrentLayout;
+  barrier.newLayout                   = vk::ImageLayout::eTransferDstOptimal;
+  barrier.dstAccessMask               = vk::AccessFlagBits::eTransferWrite;
+
+  cmd->pipelineBarrier(vk::PipelineStageFlagBits::eTopOfPipe, vk::PipelineStageFlagBits::eTransfer,
+      vk::DependencyFlagBits(), nullptr, nullptr, barrier);
+
+  std::vector<vk::BufferImageCopy> infos;
+  uint64_t                         offset    = 0;
+  uint32_t                         mipWidth  = imageInfo.extent.width;
+  uint32_t                         mipHeight = imageInfo.extent.height;
+  uint32_t                         mipDepth  = imageInfo.extent.depth;
+
+  // the data contains all layers of a level before the next level
+  for (uint32_t i = 0; i < imageInfo.mipLevels; ++i) {
+    uint64_t blocksX = (mipWidth + blockExtent.width - 1) / blockExtent.width;
+    uint64_t blocksY = (mipHeight + blockExtent.height - 1) / blockExtent.height;
+    uint64_t size    = blocksX * blocksY * mipDepth * imageInfo.arrayLayers * blockSize;
+
+    if (offset + size > dataSize) {
+      break;
+    }
+
+    vk::BufferImageCopy info;
+    info.imageSubresource.aspectMask     = aspectMask;
+    info.imageSubresource.mipLevel       = i;
+    info.imageSubresource.baseArrayLayer = 0;
+    info.imageSubresource.layerCount     = imageInfo.arrayLayers;
+    info.imageExtent.width               = mipWidth;
+    info.imageExtent.height              = mipHeight;
+    info.imageExtent.depth               = mipDepth;
+    info.bufferOffset                    = srcOffset + offset;
+
+    infos.push_back(info);
+
+    offset += size;
+    mipWidth  = std::max(mipWidth / 2, 1u);
+    mipHeight = std::max(mipHeight / 2, 1u);
+    mipDepth  = std::max(mipDepth / 2, 1u);
+  }
+
+  cmd->copyBufferToImage(src, *image->mImage, vk::ImageLayout::eTransferDstOptimal, infos);
+
+  uint32_t srcFamily = mDevice->getPhysicalDevice()->getQueueFamily(QueueType::eTransfer);
+  uint32_t dstFamily = mDevice->getPhysicalDevice()->getQueueFamily(QueueType::eGeneric);
+
+  barrier.oldLayout     = vk::ImageLayout::eTransferDstOptimal;
+  barrier.newLayout     = layout;
+  barrier.srcAccessMask = vk::AccessFlagBits::eTransferWrite;
+
+  if (srcFamily != dstFamily && imageInfo.sharingMode == vk::SharingMode::eExclusive) {
+
+    // release on the transfer queue...
+    barrier.dstAccessMask       = vk::AccessFlags();
+    barrier.srcQueueFamilyIndex = srcFamily;
+    barrier.dstQueueFamilyIndex = dstFamily;
+    cmd->pipelineBarrier(vk::PipelineStageFlagBits::eTransfer,
+        vk::PipelineStageFlagBits::eBottomOfPipe, vk::DependencyFlagBits(), nullptr, nullptr,
+        barrier);
+
+    // ... and acquire on the generic queue
+    barrier.srcAccessMask = vk::AccessFlags();
+    barrier.dstAccessMask = vk::AccessFlagBits::eMemoryRead;
+    getAcquireCmd()->pipelineBarrier(vk::PipelineStageFlagBits::eTopOfPipe,
+        vk::PipelineStageFlagBits::eAllCommands, vk::DependencyFlagBits(), nullptr, nullptr,
+        barrier);
+
+  } else {
+    barrier.dstAccessMask = vk::AccessFlagBits::eMemoryRead;
+    cmd->pipelineBarrier(vk::PipelineStageFlagBits::eTransfer,
+        vk::PipelineStageFlagBits::eAllCommands, vk::DependencyFlagBits(), nullptr, nullptr,
+        barrier);
+  }
+
+  image->mCurrentLayout = layout;
+  mCurrentBatch.mImages.push_back(image);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+std::pair<vk::Buffer, vk::DeviceSize> UploadManager::stage(
+    vk::DeviceSize dataSize, const void* data, vk::DeviceSize alignment) {
+
+  // Large uploads get a temporary staging buffer which is kept alive by the batch. Its data is
+  // counted as uploaded bytes by createBackedBuffer().
+  if (dataSize > mStagingSize / 2) {
+    auto stagingBuffer = mDevice->createBackedBuffer(vk::BufferUsageFlagBits::eTransferSrc,
+        vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent,
+        dataSize, data);
+    mCurrentBatch.mBuffers.push_back(stagingBuffer);
+    return {*stagingBuffer->mBuffer, 0};
+  }
+
+  if (!mStagingBuffer) {
+    mStagingBuffer = mDevice->createBackedBuffer(vk::BufferUsageFlagBits::eTransferSrc,
+        vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent,
+        mStagingSize);
+  }
+
+  // The ring is empty if head and tail are equal. Therefore the head may never catch up with the
+  // tail when wrapping around.
+  while (true) {
+    reclaim();
+
+    vk::DeviceSize offset = (mStagingHead + alignment - 1) / alignment * alignment;
+    bool           fits   = false;
+
+    if (mStagingHead >= mStagingTail) {
+      if (offset + dataSize <= mStagingSize) {
+        fits = true;
+      } else if (dataSize < mStagingTail) {
+        offset = 0;
+        fits   = true;
+      }
+    } else if (offset + dataSize < mStagingTail) {
+      fits = true;
+    }
+
+    if (fits) {
+      std::memcpy(mStagingBuffer->mMappedData + offset, data, dataSize);
+      mStagingHead = offset + dataSize;
+      mDevice->getFrameStatistics()->add(&FrameStatistics::Counters::mUploadedBytes, dataSize);
+      return {*mStagingBuffer->mBuffer, offset};
+    }
+
+    // The ring is full - the current batch has to be submitted and we have to wait for the
+    // oldest batch to finish.
+    if (mInFlightBatches.empty()) {
+      flushImpl();
+    }
+
+    mDevice->getHandle()->waitForFences(*mInFlightBatches.front().mFence, true, ~0);
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void UploadManager::flushImpl() {
+  ILLUSION_ZONE("UploadManager::flush");
+
+  if (!mCurrentBatch.mTransferCmd && !mCurrentBatch.mAcquireCmd) {
+    return;
+  }
+
+  Batch batch   = std::move(mCurrentBatch);
+  mCurrentBatch = Batch();
+
+  batch.mTicket     = mNextTicket++;
+  batch.mStagingEnd = mStagingHead;
+  batch.mFence      = mDevice->createFence(vk::FenceCreateFlags());
+
+  if (batch.mTransferCmd) {
+    batch.mTransferCmd->end();
+
+    vk::SubmitInfo info;
+    info.commandBufferCount = 1;
+    info.pCommandBuffers    = batch.mTransferCmd.get();
+
+    if (batch.mAcquireCmd) {
+      batch.mSemaphore          = mDevice->createSemaphore();
+      info.signalSemaphoreCount = 1;
+      info.pSignalSemaphores    = batch.mSemaphore.get();
+    }
+
+    // any transfer queue can be used, the acquire waits for the semaphore and the batches are
+    // reclaimed by their fences
+    mDevice->getQueuePool()
+        ->lockAny(QueueType::eTransfer)
+        ->submit(info, batch.mAcquireCmd ? vk::Fence() : *batch.mFence);
+  }
+
+  if (batch.mAcquireCmd) {
+    batch.mAcquireCmd->end();
+
+    vk::PipelineStageFlags waitStage = vk::PipelineStageFlagBits::eAllCommands;
+
+    vk::SubmitInfo info;
+    info.commandBufferCount = 1;
+    info.pCommandBuffers    = batch.mAcquireCmd.get();
+
+    if (batch.mSemaphore) {
+      info.waitSemaphoreCount = 1;
+      info.pWaitSemaphores    = batch.mSemaphore.get();
+      info.pWaitDstStageMask  = &waitStage;
+    }
+
+    mDevice->getQueuePool()->lock(QueueType::eGeneric)->submit(info, *batch.mFence);
+  }
+
+  mInFlightBatches.push_back(std::move(batch));
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void UploadManager::reclaim() {
+  while (!mInFlightBatches.empty()) {
+    auto const& batch = mInFlightBatches.front();
+
+    if (mDevice->getHandle()->getFenceStatus(*batch.mFence) != vk::Result::eSuccess) {
+      break;
+    }
+
+    mStagingTail     = batch.mStagingEnd;
+    mCompletedTicket = batch.mTicket;
+    mInFlightBatches.pop_front();
+  }
+
+  // Rewind the ring if it's empty, this reduces the number of wrap-arounds.
+  if (mInFlightBatches.empty() && mStagingHead == mStagingTail) {
+    mStagingHead = 0;
+    mStagingTail = 0;
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+} // namespace Illusion::Graphics
@@ -0,0 +1,131 @@
+////////////////////////////////////////////////////////////////////////////////////////////////////
+//                                                                                                //
+//    _)  |  |            _)                This code may be used and modified under the terms    //
+//     |  |  |  |  | (_-<  |   _ \    \     of the MIT license. See the LICENSE file for details. //
+//    _| _| _| \_,_| ___/ _| \___/ _| _|    Copyright (c) 2018-2019 Simon Schneegans              //
+//                                                                                                //
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#ifndef ILLUSION_GRAPHICS_UPLOAD_MANAGER_HPP
+#define ILLUSION_GRAPHICS_UPLOAD_MANAGER_HPP
+
+#include "fwd.hpp"
+
+#include <deque>
+#include <mutex>
+
+namespace Illusion::Graphics {
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// The UploadManager is used by the Device to upload data to device-local BackedBuffers and       //
+// BackedImages without stalling. Data is copied to a persistently mapped staging ring buffer and //
+// the copy commands are collected in a batch which is submitted to the QueueType::eTransfer      //
+// queue. If the transfer queue belongs to a different family, the ownership of the resources is  //
+// transferred to the QueueType::eGeneric family afterwards.                                      //
+// Each upload returns a Ticket which can be used to query or wait for the completion of the      //
+// upload. The pending batch is flushed automatically whenever a CommandBuffer is submitted, as   //
+// the release and acquire barriers are submitted before, no further synchronization is required  //
+// for using uploaded resources on the generic queue.                                             //
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+class UploadManager {
+
+ public:
+  // A Ticket of zero is always complete.
+  typedef uint64_t Ticket;
+
+  // Syntactic sugar to create a std::shared_ptr for this class
+  template <typename... Args>
+  static UploadManagerPtr create(Args&&... args) {
+    return std::make_shared<UploadManager>(args...);
+  };
+
+  // The UploadManager is owned by the given Device, hence it only stores a raw pointer to it.
+  // Uploads larger than half of the stagingSize will use a temporary staging buffer.
+  explicit UploadManager(Device const* device, vk::DeviceSize stagingSize = 32 * 1024 * 1024);
+  virtual ~UploadManager();
+
+  // Copies the given data to the staging ring and records a copy to the buffer. The data can be
+  // freed once this call returns.
+  Ticket uploadToBuffer(BackedBufferPtr const& buffer, vk::DeviceSize dataSize, const void* data,
+      vk::DeviceSize dstOffset = 0);
+
+  // Uploads all mipmap levels contained in data and transitions the image to the given layout.
+  // The mCurrentLayout of the image is updated immediately.
+  Ticket uploadToImage(BackedImagePtr const& image, vk::ImageAspectFlags aspectMask,
+      vk::ImageLayout layout, vk::DeviceSize dataSize, const void* data);
+
+  // Like uploadToImage(), but the data is read directly from the given buffer, starting at
+  // srcOffset. This skips the copy to the staging ring, for example for buffers which wrap host
+  // memory imported with Device::importHostBuffer(). The buffer is kept alive until the copy has
+  // finished, its content must not change before. A std::runtime_error is thrown if the srcOffset
+  // is not a multiple of four and of the texel size or if the range exceeds the buffer.
+  Ticket copyToImage(BackedBufferPtr const& buffer, vk::DeviceSize srcOffset,
+      BackedImagePtr const& image, vk::ImageAspectFlags aspectMask, vk::ImageLayout layout,
+      vk::DeviceSize dataSize);
+
+  // Records a layout transition of the image on the generic queue. The mCurrentLayout of the image
+  // is updated immediately.
+  Ticket transitionImage(
+      BackedImagePtr const& image, vk::ImageAspectFlags aspectMask, vk::ImageLayout layout);
+
+  // Submits all recorded uploads. This is called by CommandBuffer::submit(), so usually there is no
+  // need to call this manually.
+  void flush();
+
+  // Returns true when the GPU has finished the upload associated with the given Ticket.
+  bool isComplete(Ticket ticket);
+
+  // Blocks until the GPU has finished the upload associated with the given Ticket. This flushes the
+  // pending batch if required.
+  void wait(Ticket ticket);
+
+ private:
+  struct Batch {
+    Ticket               mTicket = 0;
+    vk::CommandBufferPtr mTransferCmd;
+    vk::CommandBufferPtr mAcquireCmd;
+    vk::SemaphorePtr     mSemaphore;
+    vk::FencePtr         mFence;
+    vk::DeviceSize       mStagingEnd = 0;
+
+    // Target resources and temporary staging buffers are kept alive until the batch is finished.
+    std::vector<BackedBufferPtr> mBuffers;
+    std::vector<BackedImagePtr>  mImages;
+  };
+
+  vk::CommandBufferPtr const& getTransferCmd();
+  vk::CommandBufferPtr const& getAcquireCmd();
+
+  // Records the copy of all mipmap levels contained in dataSize bytes of src and the transition to
+  // the given layout. mMutex has to be locked.
+  void recordImageCopy(BackedImagePtr const& image, vk::ImageAspectFlags aspectMask,
+      vk::ImageLayout layout, vk::DeviceSize dataSize, vk::Buffer src, vk::DeviceSize srcOffset);
+
+  // Copies the data to the staging memory and returns the buffer and the offset which should be
+  // used as copy source.
+  std::pair<vk::Buffer, vk::DeviceSize> stage(
+      vk::DeviceSize dataSize, const void* data, vk::DeviceSize alignment);
+
+  void flushImpl();
+  void reclaim();
+
+  Device const*      mDevice;
+  vk::CommandPoolPtr mTransferPool;
+  vk::CommandPoolPtr mGenericPool;
+  vk::DeviceSize     mStagingSize;
+  BackedBufferPtr    mStagingBuffer;
+  vk::DeviceSize     mStagingHead = 0;
+  vk::DeviceSize     mStagingTail = 0;
+
+  Batch             mCurrentBatch;
+  std::deque<Batch> mInFlightBatches;
+  Ticket            mNextTicket      = 1;
+  Ticket            mCompletedTicket = 0;
+
+  std::mutex mMutex;
+};
+
+} // namespace Illusion::Graphics
+
+#endif // ILLUSION_GRAPHICS_UPLOAD_MANAGER_HPP
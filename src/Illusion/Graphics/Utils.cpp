@@ -405,4 +405,96 @@ uint8_t getByteCount(vk::Format format) {
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////
 
+bool isCompressedFormat(vk::Format format) {
+  // all block-compressed formats of Vulkan 1.0 are in one contiguous range
+  auto value = static_cast<VkFormat>(format);
+  return value >= VK_FORMAT_BC1_RGB_UNORM_BLOCK && value <= VK_FORMAT_ASTC_12x12_SRGB_BLOCK;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+vk::Extent2D getBlockExtent(vk::Format format) {
+  switch (format) {
+  case vk::Format::eAstc5x4UnormBlock:
+  case vk::Format::eAstc5x4SrgbBlock:
+    return {5, 4};
+  case vk::Format::eAstc5x5UnormBlock:
+  case vk::Format::eAstc5x5SrgbBlock:
+    return {5, 5};
+  case vk::Format::eAstc6x5UnormBlock:
+  case vk::Format::eAstc6x5SrgbBlock:
+    return {6, 5};
+  case vk::Format::eAstc6x6UnormBlock:
+  case vk::Format::eAstc6x6SrgbBlock:
+    return {6, 6};
+  case vk::Format::eAstc8x5UnormBlock:
+  case vk::Format::eAstc8x5SrgbBlock:
+    return {8, 5};
+  case vk::Format::eAstc8x6UnormBlock:
+  case vk::Format::eAstc8x6SrgbBlock:
+    return {8, 6};
+  case vk::Format::eAstc8x8UnormBlock:
+  case vk::Format::eAstc8x8SrgbBlock:
+    return {8, 8};
+  case vk::Format::eAstc10x5UnormBlock:
+  case vk::Format::eAstc10x5SrgbBlock:
+    return {10, 5};
+  case vk::Format::eAstc10x6UnormBlock:
+  case vk::Format::eAstc10x6SrgbBlock:
+    return {10, 6};
+  case vk::Format::eAstc10x8UnormBlock:
+  case vk::Format::eAstc10x8SrgbBlock:
+    return {10, 8};
+  case vk::Format::eAstc10x10UnormBlock:
+  case vk::Format::eAstc10x10SrgbBlock:
+    return {10, 10};
+  case vk::Format::eAstc12x10UnormBlock:
+  case vk::Format::eAstc12x10SrgbBlock:
+    return {12, 10};
+  case vk::Format::eAstc12x12UnormBlock:
+  case vk::Format::eAstc12x12SrgbBlock:
+    return {12, 12};
+  default:
+    break;
+  }
+
+  // all BC, ETC2 and EAC formats and ASTC 4x4 use blocks of 4x4 texels
+  if (isCompressedFormat(format)) {
+    return {4, 4};
+  }
+
+  return {1, 1};
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+uint8_t getBlockByteCount(vk::Format format) {
+  switch (format) {
+  case vk::Format::eBc1RgbUnormBlock:
+  case vk::Format::eBc1RgbSrgbBlock:
+  case vk::Format::eBc1RgbaUnormBlock:
+  case vk::Format::eBc1RgbaSrgbBlock:
+  case vk::Format::eBc4UnormBlock:
+  case vk::Format::eBc4SnormBlock:
+  case vk::Format::eEtc2R8G8B8UnormBlock:
+  case vk::Format::eEtc2R8G8B8SrgbBlock:
+  case vk::Format::eEtc2R8G8B8A1UnormBlock:
+  case vk::Format::eEtc2R8G8B8A1SrgbBlock:
+  case vk::Format::eEacR11UnormBlock:
+  case vk::Format::eEacR11SnormBlock:
+    return 8;
+  default:
+    break;
+  }
+
+  // all other block-compressed formats use 128 bit per block
+  if (isCompressedFormat(format)) {
+    return 16;
+  }
+
+  return getByteCount(format);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
 } // namespace Illusion::Graphics::Utils
@@ -20,6 +20,12 @@ bool    isDepthOnlyFormat(vk::Format format);
 bool    isDepthStencilFormat(vk::Format format);
 uint8_t getByteCount(vk::Format format);
 
+// Block-compressed formats (BC, ETC2, EAC and ASTC) store blocks of several texels. For all other
+// formats, the block extent is 1x1 and getBlockByteCount() is the same as getByteCount().
+bool         isCompressedFormat(vk::Format format);
+vk::Extent2D getBlockExtent(vk::Format format);
+uint8_t      getBlockByteCount(vk::Format format);
+
 } // namespace Illusion::Graphics::Utils
 
 #endif // ILLUSION_GRAPHICS_UTILS_HPP
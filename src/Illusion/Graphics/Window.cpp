@@ -9,6 +9,7 @@
 #include "Window.hpp"
 
 #include "../Core/Logger.hpp"
+#include "../Core/Timer.hpp"
 #include "Instance.hpp"
 #include "Swapchain.hpp"
 
@@ -18,11 +19,21 @@
 
 namespace Illusion::Graphics {
 
+namespace {
+
+// If pQueueEvents is set and processEvents() is not called for a while, further events are kept in
+// a std::deque until there is space again. Fast mouse movements generate several hundred events
+// per second.
+const size_t EVENT_QUEUE_SIZE = 4096;
+
+} // namespace
+
 ////////////////////////////////////////////////////////////////////////////////////////////////////
 
 Window::Window(InstancePtr const& instance, DevicePtr const& device)
     : mInstance(instance)
-    , mDevice(device) {
+    , mDevice(device)
+    , mEventQueue(EVENT_QUEUE_SIZE) {
 
   ILLUSION_TRACE << "Creating Window." << std::endl;
 
@@ -93,6 +104,20 @@ Window::Window(InstancePtr const& instance, DevicePtr const& device)
     return true;
   });
 
+  pRelaxedVsync.onChange().connect([this](bool relaxed) {
+    if (mSwapchain) {
+      mSwapchain->setEnableRelaxedVsync(relaxed);
+    }
+    return true;
+  });
+
+  pSwapchainImageCount.onChange().connect([this](uint32_t count) {
+    if (mSwapchain) {
+      mSwapchain->setImageCount(count);
+    }
+    return true;
+  });
+
   pTitle.onChange().connect([this](std::string const& title) {
     if (mWindow) {
       glfwSetWindowTitle(mWindow, title.c_str());
@@ -140,46 +165,65 @@ void Window::open() {
     pLockAspect.touch();
     pHideCursor.touch();
     pVsync.touch();
+    pRelaxedVsync.touch();
+    pSwapchainImageCount.touch();
     pCursor.touch();
 
     glfwSetWindowUserPointer(mWindow, this);
 
     glfwSetWindowCloseCallback(mWindow, [](GLFWwindow* w) {
-      auto window(static_cast<Window*>(glfwGetWindowUserPointer(w)));
-      window->sOnClose.emit();
+      auto  window(static_cast<Window*>(glfwGetWindowUserPointer(w)));
+      Event event;
+      event.mType = Event::Type::eClose;
+      window->dispatch(event);
     });
 
     glfwSetFramebufferSizeCallback(mWindow, [](GLFWwindow* w, int width, int height) {
-      auto window(static_cast<Window*>(glfwGetWindowUserPointer(w)));
-      window->pExtent = glm::uvec2(width, height);
-      // issuing this here reduces flickering during resize but may result in more swapchain
-      // recreations than abolutely neccessary
-      window->mSwapchain->markDirty();
+      auto  window(static_cast<Window*>(glfwGetWindowUserPointer(w)));
+      Event event;
+      event.mType   = Event::Type::eResize;
+      event.mExtent = glm::uvec2(width, height);
+      window->dispatch(event);
     });
 
     glfwSetKeyCallback(mWindow, [](GLFWwindow* w, int key, int scancode, int action, int mods) {
-      auto window(static_cast<Window*>(glfwGetWindowUserPointer(w)));
-      window->sOnKeyEvent.emit(Input::KeyEvent(key, scancode, action, mods));
+      auto  window(static_cast<Window*>(glfwGetWindowUserPointer(w)));
+      Event event;
+      event.mType     = Event::Type::eKey;
+      event.mKeyEvent = Input::KeyEvent(key, scancode, action, mods);
+      window->dispatch(event);
     });
 
     glfwSetCursorPosCallback(mWindow, [](GLFWwindow* w, double x, double y) {
-      auto window(static_cast<Window*>(glfwGetWindowUserPointer(w)));
-      window->sOnMouseEvent.emit(Input::MouseEvent(static_cast<int>(x), static_cast<int>(y)));
+      auto  window(static_cast<Window*>(glfwGetWindowUserPointer(w)));
+      Event event;
+      event.mType       = Event::Type::eMouse;
+      event.mMouseEvent = Input::MouseEvent(static_cast<int>(x), static_cast<int>(y));
+      window->dispatch(event);
     });
 
     glfwSetMouseButtonCallback(mWindow, [](GLFWwindow* w, int button, int action, int /*mods*/) {
-      auto window(static_cast<Window*>(glfwGetWindowUserPointer(w)));
-      window->sOnMouseEvent.emit(Input::MouseEvent(button, action == GLFW_PRESS));
+      auto  window(static_cast<Window*>(glfwGetWindowUserPointer(w)));
+      Event event;
+      event.mType       = Event::Type::eMouse;
+      event.mMouseEvent = Input::MouseEvent(button, action == GLFW_PRESS);
+      window->dispatch(event);
     });
 
     glfwSetScrollCallback(mWindow, [](GLFWwindow* w, double /*x*/, double y) {
-      auto window(static_cast<Window*>(glfwGetWindowUserPointer(w)));
-      window->sOnMouseEvent.emit(Input::MouseEvent(static_cast<int>(y * 10.0)));
+      auto  window(static_cast<Window*>(glfwGetWindowUserPointer(w)));
+      Event event;
+      event.mType       = Event::Type::eMouse;
+      event.mMouseEvent = Input::MouseEvent(static_cast<int>(y * 10.0));
+      window->dispatch(event);
     });
 
     glfwSetCharModsCallback(mWindow, [](GLFWwindow* w, unsigned c, int mods) {
-      auto window(static_cast<Window*>(glfwGetWindowUserPointer(w)));
-      window->sOnKeyEvent.emit(Input::KeyEvent(c, mods));
+      auto  window(static_cast<Window*>(glfwGetWindowUserPointer(w)));
+      Event event;
+      event.mType     = Event::Type::eKey;
+      event.mKeyEvent = Input::KeyEvent(c, mods);
+      window->dispatch(event);
     });
 
   } else {
@@ -205,14 +249,42 @@ bool Window::shouldClose() const {
 ////////////////////////////////////////////////////////////////////////////////////////////////////
 
 void Window::update() {
+  pumpEvents();
+  processEvents();
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void Window::pumpEvents(double timeout) {
+  flushOverflowEvents();
+
   if (mWindow) {
-    glfwPollEvents();
+    if (timeout > 0.0) {
+      glfwWaitEventsTimeout(timeout);
+    } else {
+      glfwPollEvents();
+    }
     updateJoysticks();
   }
 }
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////
 
+void Window::processEvents() {
+  Event event;
+  while (mEventQueue.pop(event)) {
+    emit(event);
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+double Window::getEventTime() const {
+  return mEventTime;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
 bool Window::keyPressed(Input::Key key) const {
   if (!mWindow) {
     return false;
@@ -257,6 +329,36 @@ glm::vec2 Window::getCursorPos() const {
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////
 
+SwapchainPtr const& Window::getSwapchain() const {
+  return mSwapchain;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+vk::Format Window::getSwapchainFormat() const {
+  return mSwapchain->getFormat();
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+BackedImagePtr const& Window::acquireImage() {
+  return mSwapchain->acquireImage();
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+vk::SemaphorePtr const& Window::getImageAvailableSemaphore() const {
+  return mSwapchain->getImageAvailableSemaphore();
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void Window::present(vk::SemaphorePtr const& renderFinishedSemaphore) {
+  mSwapchain->present(renderFinishedSemaphore);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
 void Window::present(BackedImagePtr const& image, vk::SemaphorePtr const& renderFinishedSemaphore,
     vk::FencePtr const& signalFence) {
   mSwapchain->present(image, renderFinishedSemaphore, signalFence);
@@ -304,8 +406,12 @@ void Window::updateJoysticks() {
         }
 
         if (std::abs(axisValue - mJoystickAxisCache[joy][axis]) > changedThreshold) {
-          Input::JoystickAxisId axisId(static_cast<Input::JoystickAxisId>(axis));
-          sOnJoystickAxisChanged.emit(joyId, axisId, axisValue);
+          Event event;
+          event.mType         = Event::Type::eJoystickAxis;
+          event.mJoystick     = joyId;
+          event.mJoystickAxis = static_cast<Input::JoystickAxisId>(axis);
+          event.mAxisValue    = axisValue;
+          dispatch(event);
           mJoystickAxisCache[joy][axis] = axisValue;
         }
       }
@@ -313,15 +419,19 @@ void Window::updateJoysticks() {
       int  buttonCount(0);
       auto buttonArray(glfwGetJoystickButtons(joy, &buttonCount));
       for (int button(0); button < buttonCount; ++button) {
-        Input::JoystickButtonId buttonId(static_cast<Input::JoystickButtonId>(button));
-        int                     buttonValue(static_cast<int>(buttonArray[button]));
+        int buttonValue(static_cast<int>(buttonArray[button]));
 
         if (buttonValue != mJoystickButtonCache[joy][button]) {
+          Event event;
+          event.mJoystick       = joyId;
+          event.mJoystickButton = static_cast<Input::JoystickButtonId>(button);
 
           if (buttonValue == 0) {
-            sOnJoystickButtonReleased.emit(joyId, buttonId);
+            event.mType = Event::Type::eJoystickButtonRelease;
+            dispatch(event);
           } else if (buttonValue == 1) {
-            sOnJoystickButtonPressed.emit(joyId, buttonId);
+            event.mType = Event::Type::eJoystickButtonPress;
+            dispatch(event);
           }
 
           mJoystickButtonCache[joy][button] = buttonValue;
@@ -333,4 +443,85 @@ void Window::updateJoysticks() {
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////
 
+void Window::dispatch(Event event) {
+  event.mTime = Core::Timer::getNow();
+
+  if (!pQueueEvents()) {
+    emit(event);
+    return;
+  }
+
+  // Events must not overtake those which are still waiting for space in the queue.
+  flushOverflowEvents();
+
+  if (mOverflowEvents.empty() && mEventQueue.push(event)) {
+    return;
+  }
+
+  if (!mOverflowEvents.empty()) {
+    auto& last = mOverflowEvents.back();
+
+    bool mouseMoves = last.mType == Event::Type::eMouse && event.mType == Event::Type::eMouse &&
+                      last.mMouseEvent.mType == Input::MouseEvent::Type::eMove &&
+                      event.mMouseEvent.mType == Input::MouseEvent::Type::eMove;
+
+    bool axisChanges = last.mType == Event::Type::eJoystickAxis &&
+                       event.mType == Event::Type::eJoystickAxis &&
+                       last.mJoystick == event.mJoystick &&
+                       last.mJoystickAxis == event.mJoystickAxis;
+
+    if (mouseMoves || axisChanges) {
+      last = event;
+      return;
+    }
+  }
+
+  mOverflowEvents.push_back(event);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void Window::flushOverflowEvents() {
+  while (!mOverflowEvents.empty() && mEventQueue.push(mOverflowEvents.front())) {
+    mOverflowEvents.pop_front();
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void Window::emit(Event const& event) {
+  mEventTime = event.mTime;
+
+  switch (event.mType) {
+  case Event::Type::eKey:
+    sOnKeyEvent.emit(event.mKeyEvent);
+    break;
+  case Event::Type::eMouse:
+    sOnMouseEvent.emit(event.mMouseEvent);
+    break;
+  case Event::Type::eJoystickAxis:
+    sOnJoystickAxisChanged.emit(event.mJoystick, event.mJoystickAxis, event.mAxisValue);
+    break;
+  case Event::Type::eJoystickButtonPress:
+    sOnJoystickButtonPressed.emit(event.mJoystick, event.mJoystickButton);
+    break;
+  case Event::Type::eJoystickButtonRelease:
+    sOnJoystickButtonReleased.emit(event.mJoystick, event.mJoystickButton);
+    break;
+  case Event::Type::eResize:
+    pExtent = event.mExtent;
+    // issuing this here reduces flickering during resize but may result in more swapchain
+    // recreations than abolutely neccessary
+    if (mSwapchain) {
+      mSwapchain->markDirty();
+    }
+    break;
+  case Event::Type::eClose:
+    sOnClose.emit();
+    break;
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
 } // namespace Illusion::Graphics
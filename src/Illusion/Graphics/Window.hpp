@@ -10,10 +10,13 @@
 #define ILLUSION_GRAPHICS_WINDOW_HPP
 
 #include "../Core/Property.hpp"
+#include "../Core/SPSCQueue.hpp"
 #include "../Input/KeyEvent.hpp"
 #include "../Input/MouseEvent.hpp"
 #include "Device.hpp"
 
+#include <deque>
+
 struct GLFWwindow;
 struct GLFWcursor;
 
@@ -23,6 +26,11 @@ namespace Illusion::Graphics {
 // The window is the place were you can draw stuff to. It is implemented using glfw. Its public   //
 // interface makes extensive use of Signals and Properties you can connect to. All Signals will   //
 // be emitted from the update() method.                                                           //
+// GLFW only allows to poll events on the main thread. In order to keep input handling out of the //
+// critical path of the frames, the frames can be rendered on another thread while the main       //
+// thread calls pumpEvents() in a loop. With pQueueEvents, the events are then stored with a      //
+// timestamp in a lock-free queue; the render thread emits the Signals by calling processEvents() //
+// as late as possible, for example right before the camera is updated.                           //
 ////////////////////////////////////////////////////////////////////////////////////////////////////
 
 class Window {
@@ -42,6 +50,14 @@ class Window {
   // Setting this value triggers a re-creation of the Swapchain.
   Core::Bool pVsync = false;
 
+  // If set together with pVsync, vk::PresentModeKHR::eFifoRelaxed is used (if supported). Setting
+  // this value triggers a re-creation of the Swapchain.
+  Core::Bool pRelaxedVsync = false;
+
+  // The minimum number of swapchain images, zero chooses a reasonable default. Use two images for
+  // the lowest latency with v-sync. Setting this value triggers a re-creation of the Swapchain.
+  Core::UInt32 pSwapchainImageCount = 0;
+
   // Shows or hides the mouse cursor when it hovers the Window.
   Core::Bool pHideCursor = false;
 
@@ -52,6 +68,14 @@ class Window {
   enum class Cursor { ePointer, eIBeam, eCross, eHand, eHResize, eVResize };
   Core::Property<Cursor> pCursor = Cursor::ePointer;
 
+  // If set, pumpEvents() stores the events in a queue instead of emitting the Signals directly;
+  // processEvents() emits them. This includes resizes (pExtent) and sOnClose. Set this before
+  // another thread calls processEvents(). Changing pTitle, pFullscreen, pCursor or pHideCursor
+  // calls GLFW, which is only allowed on the thread calling pumpEvents(). Hence these must not be
+  // set by the Signal handlers in this mode, as they are called by the thread calling
+  // processEvents().
+  Core::Bool pQueueEvents = false;
+
   // signals ---------------------------------------------------------------------------------------
 
   // You can use these Signals to react to input events.
@@ -80,9 +104,25 @@ class Window {
   void open();
 
   // Call this once a frame. This method will actually lead to the emission of the Signals of the
-  // Window if a corresponding event occurred.
+  // Window if a corresponding event occurred. It is the same as pumpEvents() followed by
+  // processEvents().
   void update();
 
+  // Polls the events of GLFW and the joysticks. If the timeout is greater than zero, this waits up
+  // to timeout seconds for an event first. Without pQueueEvents, the Signals are emitted directly.
+  // This must only be called from the main thread.
+  void pumpEvents(double timeout = 0.0);
+
+  // Emits the Signals of all events which have been queued by pumpEvents() since the last call, in
+  // the order in which they occurred. This may be called from another thread than pumpEvents(),
+  // but only from one.
+  void processEvents();
+
+  // While a Signal of an input event is emitted, this returns the Core::Timer::getNow() time at
+  // which the event was received from GLFW. So handlers can account for the time an event spent
+  // in the queue, for example when integrating camera movements.
+  double getEventTime() const;
+
   // You should call this method regularly as well. It will return true when the user clicked the
   // close button in the title bar or pressed Alt+F4 or something similar. Normally you should call
   // close() (or the destructor) in this case.
@@ -93,7 +133,8 @@ class Window {
 
   // Returns true if the given key is currently held down. This should only be used for continuous
   // input - if you are interested in key-press events you should rather use the Signals of this
-  // class.
+  // class. Like the methods below, this queries GLFW directly, so it has to be called from the
+  // thread which calls pumpEvents().
   bool keyPressed(Input::Key key) const;
 
   // Returns true if the given mouse buttons is currently held down. This should only be used for
@@ -107,6 +148,17 @@ class Window {
   // Returns the current mouse pointer position.
   glm::vec2 getCursorPos() const;
 
+  // This is nullptr until open() has been called. It can be used to query the timings of the last
+  // presented frame, for example.
+  SwapchainPtr const& getSwapchain() const;
+
+  // These are forwarded to the internal Swapchain. They can be used to render directly into the
+  // swapchain images, see Swapchain::acquireImage() for details.
+  vk::Format              getSwapchainFormat() const;
+  BackedImagePtr const&   acquireImage();
+  vk::SemaphorePtr const& getImageAvailableSemaphore() const;
+  void                    present(vk::SemaphorePtr const& renderFinishedSemaphore);
+
   // This is forwarded to the internal Swapchain. The given image will be blitted to one of the
   // swapchain images. The operation will wait for the given semaphore and will signal the given
   // fence once it finishes.
@@ -114,8 +166,38 @@ class Window {
       vk::FencePtr const& signalFence);
 
  private:
+  // An event of GLFW or a joystick. Only the members for the given type are used.
+  struct Event {
+    enum class Type {
+      eKey,
+      eMouse,
+      eJoystickAxis,
+      eJoystickButtonPress,
+      eJoystickButtonRelease,
+      eResize,
+      eClose
+    };
+
+    Type                    mType = Type::eKey;
+    double                  mTime = 0.0;
+    Input::KeyEvent         mKeyEvent;
+    Input::MouseEvent       mMouseEvent;
+    Input::JoystickId       mJoystick       = Input::JoystickId::eJoystick0;
+    Input::JoystickAxisId   mJoystickAxis   = Input::JoystickAxisId::eJoystickAxis0;
+    Input::JoystickButtonId mJoystickButton = Input::JoystickButtonId::eJoystickButton0;
+    float                   mAxisValue      = 0.f;
+    glm::uvec2              mExtent;
+  };
+
   void updateJoysticks();
 
+  // Timestamps the event and queues it if pQueueEvents is set, else it is emitted immediately.
+  void dispatch(Event event);
+  void emit(Event const& event);
+
+  // Moves as many events from mOverflowEvents to mEventQueue as fit.
+  void flushOverflowEvents();
+
   InstancePtr mInstance;
   DevicePtr   mDevice;
   GLFWwindow* mWindow = nullptr;
@@ -124,6 +206,14 @@ class Window {
   vk::SurfaceKHRPtr mSurface;
   SwapchainPtr      mSwapchain;
 
+  // pumpEvents() is the producer, processEvents() the consumer. Events which do not fit into the
+  // queue are kept in mOverflowEvents, which is only accessed by the producer. Consecutive mouse
+  // moves and changes of the same joystick axis are merged there, all other events are kept. Hence
+  // no event is lost, even if processEvents() is not called for a long time.
+  Core::SPSCQueue<Event> mEventQueue;
+  std::deque<Event>      mOverflowEvents;
+  double                 mEventTime = 0.0;
+
   std::array<std::array<float, Core::enumCast(Input::JoystickAxisId::eJoystickAxisNum)>,
       Core::enumCast(Input::JoystickId::eJoystickNum)>
       mJoystickAxisCache;
@@ -15,90 +15,172 @@ namespace Illusion::Graphics {
 
 enum class QueueType { eGeneric = 0, eCompute = 1, eTransfer = 2 };
 
+// The MemoryAllocator accounts its allocations in these categories. See Device::createBackedImage()
+// and Device::createBackedBuffer() for how they are chosen.
+enum class MemoryCategory {
+  eTexture      = 0,
+  eRenderTarget = 1,
+  eGeometry     = 2,
+  eStaging      = 3,
+  eOther        = 4
+};
+
+struct AccelerationStructure;
 struct BackedBuffer;
 struct BackedImage;
 struct Texture;
 
+class AssetManager;
+class BindlessDescriptorSet;
 class CoherentUniformBuffer;
 class CommandBuffer;
+class DeletionQueue;
 class DescriptorPool;
 class DescriptorSetReflection;
 class Device;
+class FrameContext;
+class FrameStatistics;
 class Framebuffer;
+class GeometryArena;
 class GlslShader;
+class GpuProfiler;
+class IblBaker;
 class Instance;
+class LightClusterer;
+class MemoryAllocator;
+class MipmapGenerator;
+class PassStatistics;
 class PhysicalDevice;
+class PipelineCache;
 class PipelineReflection;
+class PipelineState;
+class PostProcessor;
+class QueuePool;
+class ReadbackManager;
+class RenderGraph;
 class RenderPass;
+class RenderQueue;
+class RenderTargetPool;
+class ResolutionScaler;
 class Shader;
 class ShaderModule;
 class ShaderSource;
+class ShaderVariants;
+class SubmissionBatcher;
 class Swapchain;
+class TextureStreamer;
+class TransientAllocator;
+class UploadManager;
 class Window;
 
-typedef std::shared_ptr<BackedBuffer> BackedBufferPtr;
-typedef std::shared_ptr<BackedImage>  BackedImagePtr;
-typedef std::shared_ptr<Texture>      TexturePtr;
+typedef std::shared_ptr<AccelerationStructure> AccelerationStructurePtr;
+typedef std::shared_ptr<BackedBuffer>          BackedBufferPtr;
+typedef std::shared_ptr<BackedImage>           BackedImagePtr;
+typedef std::shared_ptr<Texture>               TexturePtr;
 
+typedef std::shared_ptr<AssetManager>            AssetManagerPtr;
+typedef std::shared_ptr<BindlessDescriptorSet>   BindlessDescriptorSetPtr;
 typedef std::shared_ptr<CoherentUniformBuffer>   CoherentUniformBufferPtr;
 typedef std::shared_ptr<CommandBuffer>           CommandBufferPtr;
+typedef std::shared_ptr<DeletionQueue>           DeletionQueuePtr;
 typedef std::shared_ptr<DescriptorPool>          DescriptorPoolPtr;
 typedef std::shared_ptr<DescriptorSetReflection> DescriptorSetReflectionPtr;
 typedef std::shared_ptr<Device>                  DevicePtr;
+typedef std::shared_ptr<FrameContext>            FrameContextPtr;
+typedef std::shared_ptr<FrameStatistics>         FrameStatisticsPtr;
 typedef std::shared_ptr<Framebuffer>             FramebufferPtr;
+typedef std::shared_ptr<GeometryArena>           GeometryArenaPtr;
 typedef std::shared_ptr<GlslShader>              GlslShaderPtr;
+typedef std::shared_ptr<GpuProfiler>             GpuProfilerPtr;
+typedef std::shared_ptr<IblBaker>                IblBakerPtr;
 typedef std::shared_ptr<Instance>                InstancePtr;
+typedef std::shared_ptr<LightClusterer>          LightClustererPtr;
+typedef std::shared_ptr<MemoryAllocator>         MemoryAllocatorPtr;
+typedef std::shared_ptr<MipmapGenerator>         MipmapGeneratorPtr;
+typedef std::shared_ptr<PassStatistics>          PassStatisticsPtr;
 typedef std::shared_ptr<PhysicalDevice>          PhysicalDevicePtr;
+typedef std::shared_ptr<PipelineCache>           PipelineCachePtr;
 typedef std::shared_ptr<PipelineReflection>      PipelineReflectionPtr;
+typedef std::shared_ptr<PipelineState>           PipelineStatePtr;
+typedef std::shared_ptr<PostProcessor>           PostProcessorPtr;
+typedef std::shared_ptr<QueuePool>               QueuePoolPtr;
+typedef std::shared_ptr<ReadbackManager>         ReadbackManagerPtr;
+typedef std::shared_ptr<RenderGraph>             RenderGraphPtr;
 typedef std::shared_ptr<RenderPass>              RenderPassPtr;
+typedef std::shared_ptr<RenderQueue>             RenderQueuePtr;
+typedef std::shared_ptr<RenderTargetPool>        RenderTargetPoolPtr;
+typedef std::shared_ptr<ResolutionScaler>        ResolutionScalerPtr;
 typedef std::shared_ptr<Shader>                  ShaderPtr;
 typedef std::shared_ptr<ShaderModule>            ShaderModulePtr;
 typedef std::shared_ptr<ShaderSource>            ShaderSourcePtr;
+typedef std::shared_ptr<ShaderVariants>          ShaderVariantsPtr;
+typedef std::shared_ptr<SubmissionBatcher>       SubmissionBatcherPtr;
 typedef std::shared_ptr<Swapchain>               SwapchainPtr;
+typedef std::shared_ptr<TextureStreamer>         TextureStreamerPtr;
+typedef std::shared_ptr<TransientAllocator>      TransientAllocatorPtr;
+typedef std::shared_ptr<UploadManager>           UploadManagerPtr;
 typedef std::shared_ptr<Window>                  WindowPtr;
 
 namespace Gltf {
+class Bvh;
+class Culler;
 class Model;
+class ModelInstance;
+class Morpher;
+class RayTracingScene;
+class ShadowMap;
 struct Animation;
+struct BoundingBox;
+struct DrawList;
+struct InstanceGroup;
 struct Material;
 struct Mesh;
 struct Node;
 struct Skin;
 
-typedef std::shared_ptr<Animation> AnimationPtr;
-typedef std::shared_ptr<Material>  MaterialPtr;
-typedef std::shared_ptr<Mesh>      MeshPtr;
-typedef std::shared_ptr<Model>     ModelPtr;
-typedef std::shared_ptr<Node>      NodePtr;
-typedef std::shared_ptr<Skin>      SkinPtr;
+typedef std::shared_ptr<Animation>       AnimationPtr;
+typedef std::shared_ptr<Bvh>             BvhPtr;
+typedef std::shared_ptr<Culler>          CullerPtr;
+typedef std::shared_ptr<Material>        MaterialPtr;
+typedef std::shared_ptr<Mesh>            MeshPtr;
+typedef std::shared_ptr<Model>           ModelPtr;
+typedef std::shared_ptr<ModelInstance>   ModelInstancePtr;
+typedef std::shared_ptr<Morpher>         MorpherPtr;
+typedef std::shared_ptr<Node>            NodePtr;
+typedef std::shared_ptr<RayTracingScene> RayTracingScenePtr;
+typedef std::shared_ptr<ShadowMap>       ShadowMapPtr;
+typedef std::shared_ptr<Skin>            SkinPtr;
 } // namespace Gltf
 
 } // namespace Illusion::Graphics
 
 namespace vk {
 
-typedef std::shared_ptr<vk::Buffer>                 BufferPtr;
-typedef std::shared_ptr<vk::CommandBuffer>          CommandBufferPtr;
-typedef std::shared_ptr<vk::CommandPool>            CommandPoolPtr;
-typedef std::shared_ptr<vk::DebugReportCallbackEXT> DebugReportCallbackEXTPtr;
-typedef std::shared_ptr<vk::DescriptorPool>         DescriptorPoolPtr;
-typedef std::shared_ptr<vk::DescriptorSet>          DescriptorSetPtr;
-typedef std::shared_ptr<vk::DescriptorSetLayout>    DescriptorSetLayoutPtr;
-typedef std::shared_ptr<vk::Device>                 DevicePtr;
-typedef std::shared_ptr<vk::DeviceMemory>           DeviceMemoryPtr;
-typedef std::shared_ptr<vk::Fence>                  FencePtr;
-typedef std::shared_ptr<vk::Framebuffer>            FramebufferPtr;
-typedef std::shared_ptr<vk::Image>                  ImagePtr;
-typedef std::shared_ptr<vk::ImageView>              ImageViewPtr;
-typedef std::shared_ptr<vk::Instance>               InstancePtr;
-typedef std::shared_ptr<vk::Pipeline>               PipelinePtr;
-typedef std::shared_ptr<vk::PipelineLayout>         PipelineLayoutPtr;
-typedef std::shared_ptr<vk::RenderPass>             RenderPassPtr;
-typedef std::shared_ptr<vk::Sampler>                SamplerPtr;
-typedef std::shared_ptr<vk::Semaphore>              SemaphorePtr;
-typedef std::shared_ptr<vk::ShaderModule>           ShaderModulePtr;
-typedef std::shared_ptr<vk::SurfaceKHR>             SurfaceKHRPtr;
-typedef std::shared_ptr<vk::SwapchainKHR>           SwapchainKHRPtr;
+typedef std::shared_ptr<vk::AccelerationStructureKHR> AccelerationStructureKHRPtr;
+typedef std::shared_ptr<vk::Buffer>                   BufferPtr;
+typedef std::shared_ptr<vk::CommandBuffer>            CommandBufferPtr;
+typedef std::shared_ptr<vk::CommandPool>              CommandPoolPtr;
+typedef std::shared_ptr<vk::DebugReportCallbackEXT>   DebugReportCallbackEXTPtr;
+typedef std::shared_ptr<vk::DescriptorPool>           DescriptorPoolPtr;
+typedef std::shared_ptr<vk::DescriptorSet>            DescriptorSetPtr;
+typedef std::shared_ptr<vk::DescriptorSetLayout>      DescriptorSetLayoutPtr;
+typedef std::shared_ptr<vk::Device>                   DevicePtr;
+typedef std::shared_ptr<vk::DeviceMemory>             DeviceMemoryPtr;
+typedef std::shared_ptr<vk::Fence>                    FencePtr;
+typedef std::shared_ptr<vk::Framebuffer>              FramebufferPtr;
+typedef std::shared_ptr<vk::Image>                    ImagePtr;
+typedef std::shared_ptr<vk::ImageView>                ImageViewPtr;
+typedef std::shared_ptr<vk::Instance>                 InstancePtr;
+typedef std::shared_ptr<vk::Pipeline>                 PipelinePtr;
+typedef std::shared_ptr<vk::PipelineCache>            PipelineCachePtr;
+typedef std::shared_ptr<vk::PipelineLayout>           PipelineLayoutPtr;
+typedef std::shared_ptr<vk::QueryPool>                QueryPoolPtr;
+typedef std::shared_ptr<vk::RenderPass>               RenderPassPtr;
+typedef std::shared_ptr<vk::Sampler>                  SamplerPtr;
+typedef std::shared_ptr<vk::Semaphore>                SemaphorePtr;
+typedef std::shared_ptr<vk::ShaderModule>             ShaderModulePtr;
+typedef std::shared_ptr<vk::SurfaceKHR>               SurfaceKHRPtr;
+typedef std::shared_ptr<vk::SwapchainKHR>             SwapchainKHRPtr;
 
 } // namespace vk
 
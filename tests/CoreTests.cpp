@@ -0,0 +1,114 @@
+////////////////////////////////////////////////////////////////////////////////////////////////////
+//                                                                                                //
+//    _)  |  |            _)                This code may be used and modified under the terms    //
+//     |  |  |  |  | (_-<  |   _ \    \     of the MIT license. See the LICENSE file for details. //
+//    _| _| _| \_,_| ___/ _| \___/ _| _|    Copyright (c) 2018-2019 Simon Schneegans              //
+//                                                                                                //
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include "Test.hpp"
+
+#include <Illusion/Core/FPSCounter.hpp>
+#include <Illusion/Core/Signal.hpp>
+
+#include <atomic>
+#include <thread>
+
+using namespace Illusion;
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void Core_FPSCounterStopsHitchesAtLowerFrameRate() {
+  Core::FPSCounter counter(100, false);
+
+  uint64_t signaled = 0;
+  counter.sOnHitch.connect([&signaled](double, double) {
+    ++signaled;
+    return true;
+  });
+
+  // a steady 60 fps does not cause any hitches
+  for (int i = 0; i < 100; ++i) {
+    counter.addPresentInterval(1000.0 / 60.0);
+  }
+
+  ILLUSION_CHECK(counter.getHitchCount() == 0);
+
+  // after a lasting drop to 25 fps, only the first few frames are reported
+  for (int i = 0; i < 100; ++i) {
+    counter.addPresentInterval(1000.0 / 25.0);
+  }
+
+  uint64_t hitches = counter.getHitchCount();
+  ILLUSION_CHECK(hitches > 0 && hitches < 10);
+  ILLUSION_CHECK(signaled == hitches);
+
+  for (int i = 0; i < 100; ++i) {
+    counter.addPresentInterval(1000.0 / 25.0);
+  }
+
+  ILLUSION_CHECK(counter.getHitchCount() == hitches);
+
+  // single long frames are still detected
+  counter.addPresentInterval(200.0);
+  ILLUSION_CHECK(counter.getHitchCount() == hitches + 1);
+}
+
+ILLUSION_TEST(Core_FPSCounterStopsHitchesAtLowerFrameRate);
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void Core_SignalDisconnectsFromCallbacks() {
+  Core::Signal<int> signal;
+
+  int sum = 0;
+  signal.connect([&sum](int value) {
+    sum += value;
+    return sum < 3;
+  });
+
+  for (int i = 0; i < 5; ++i) {
+    signal.emit(1);
+  }
+
+  ILLUSION_CHECK(sum == 3);
+}
+
+ILLUSION_TEST(Core_SignalDisconnectsFromCallbacks);
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void Core_SignalEmitsWhileConnecting() {
+  Core::Signal<int> signal;
+
+  std::atomic<int>  calls{0};
+  std::atomic<bool> done{false};
+
+  signal.connect([&calls](int) {
+    ++calls;
+    return true;
+  });
+
+  // the emitting thread reads the vectors which the main thread keeps replacing
+  std::thread emitter([&]() {
+    while (!done) {
+      signal.emit(0);
+    }
+  });
+
+  for (int i = 0; i < 10000; ++i) {
+    int id = signal.connect([](int) { return true; });
+    signal.disconnect(id);
+  }
+
+  done = true;
+  emitter.join();
+
+  int before = calls;
+  signal.emit(0);
+  ILLUSION_CHECK(calls == before + 1);
+}
+
+ILLUSION_TEST(Core_SignalEmitsWhileConnecting);
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
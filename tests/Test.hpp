@@ -0,0 +1,54 @@
+////////////////////////////////////////////////////////////////////////////////////////////////////
+//                                                                                                //
+//    _)  |  |            _)                This code may be used and modified under the terms    //
+//     |  |  |  |  | (_-<  |   _ \    \     of the MIT license. See the LICENSE file for details. //
+//    _| _| _| \_,_| ___/ _| \___/ _| _|    Copyright (c) 2018-2019 Simon Schneegans              //
+//                                                                                                //
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#ifndef ILLUSION_TESTS_TEST_HPP
+#define ILLUSION_TESTS_TEST_HPP
+
+#include <functional>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace Illusion::Tests {
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// A minimal test harness without external dependencies. A test is a function which checks its    //
+// expectations with ILLUSION_CHECK; a failing check throws and aborts the test:                  //
+// void Core_Something() {                                                                        //
+//   ILLUSION_CHECK(something() == 42);                                                           //
+// }                                                                                              //
+// ILLUSION_TEST(Core_Something);                                                                 //
+// The runner executes all registered tests and returns a non-zero exit code if any test failed,  //
+// so that it can be registered with CTest.                                                       //
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+struct TestInfo {
+  std::string           mName;
+  std::function<void()> mFunction;
+};
+
+// Adds a test to the global list; use ILLUSION_TEST instead.
+bool registerTest(std::string const& name, std::function<void()> const& function);
+
+// Returns all registered tests, sorted by name.
+std::vector<TestInfo> getTests();
+
+} // namespace Illusion::Tests
+
+#define ILLUSION_TEST(function)                                                                    \
+  static bool function##Registered = Illusion::Tests::registerTest(#function, function)
+
+#define ILLUSION_CHECK(condition)                                                                  \
+  if (!(condition)) {                                                                              \
+    std::ostringstream message;                                                                    \
+    message << __FILE__ << ":" << __LINE__ << ": " << #condition;                                  \
+    throw std::runtime_error(message.str());                                                       \
+  }
+
+#endif // ILLUSION_TESTS_TEST_HPP
@@ -0,0 +1,61 @@
+////////////////////////////////////////////////////////////////////////////////////////////////////
+//                                                                                                //
+//    _)  |  |            _)                This code may be used and modified under the terms    //
+//     |  |  |  |  | (_-<  |   _ \    \     of the MIT license. See the LICENSE file for details. //
+//    _| _| _| \_,_| ___/ _| \___/ _| _|    Copyright (c) 2018-2019 Simon Schneegans              //
+//                                                                                                //
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include "Test.hpp"
+
+#include <algorithm>
+#include <iostream>
+
+namespace Illusion::Tests {
+
+namespace {
+
+std::vector<TestInfo>& getRegistry() {
+  static std::vector<TestInfo> registry;
+  return registry;
+}
+
+} // namespace
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+bool registerTest(std::string const& name, std::function<void()> const& function) {
+  getRegistry().push_back({name, function});
+  return true;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+std::vector<TestInfo> getTests() {
+  auto tests = getRegistry();
+  std::sort(tests.begin(), tests.end(),
+      [](TestInfo const& a, TestInfo const& b) { return a.mName < b.mName; });
+  return tests;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+} // namespace Illusion::Tests
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+int main() {
+  int failed = 0;
+
+  for (auto const& test : Illusion::Tests::getTests()) {
+    try {
+      test.mFunction();
+      std::cout << "[  OK  ] " << test.mName << std::endl;
+    } catch (std::exception const& e) {
+      std::cout << "[FAILED] " << test.mName << ": " << e.what() << std::endl;
+      ++failed;
+    }
+  }
+
+  return failed == 0 ? 0 : 1;
+}